@@ -0,0 +1,84 @@
+// Builds the SPIFFS image contents for the device from public/.
+//
+// - Assets other than HTML pages are renamed to name.<hash>.ext and the
+//   pages' references are rewritten, so the firmware can let browsers cache
+//   them for good.
+// - Text files are stored gzipped only (the firmware serves the .gz).
+// - An "etags" manifest lists the served path and the content hash of each
+//   file, which the firmware answers If-None-Match from.
+//
+// Usage: node build.js <output dir>
+
+const crypto = require('crypto');
+const fs = require('fs');
+const path = require('path');
+const zlib = require('zlib');
+
+const PUBLIC_DIR = path.join(__dirname, 'public');
+const COMPRESS = new Set(['.html', '.css', '.js', '.json', '.svg', '.ttf']);
+const HASH_LEN = 8;
+// SPIFFS object names, including the leading slash and any ".gz".
+const NAME_MAX = 31;
+
+function hash(data) {
+  return crypto.createHash('sha256').update(data).digest('hex');
+}
+
+function walk(dir, base = '') {
+  return fs.readdirSync(dir, { withFileTypes: true }).flatMap((entry) => {
+    const rel = `${base}/${entry.name}`;
+    return entry.isDirectory() ? walk(path.join(dir, entry.name), rel) : [rel];
+  });
+}
+
+function build(outDir) {
+  const files = walk(PUBLIC_DIR).map((rel) => ({
+    rel,
+    data: fs.readFileSync(path.join(PUBLIC_DIR, rel)),
+  }));
+
+  // Pages keep their names; everything they reference gets a hashed one.
+  const renames = new Map();
+  for (const file of files) {
+    const ext = path.extname(file.rel);
+    if (ext === '.html') {
+      continue;
+    }
+    const stem = file.rel.slice(0, -ext.length);
+    const served = `${stem}.${hash(file.data).slice(0, HASH_LEN)}${ext}`;
+    renames.set(file.rel, served);
+    file.rel = served;
+  }
+  for (const file of files) {
+    if (path.extname(file.rel) !== '.html') {
+      continue;
+    }
+    let text = file.data.toString('utf8');
+    for (const [from, to] of renames) {
+      text = text.split(`"${from}"`).join(`"${to}"`);
+    }
+    file.data = Buffer.from(text, 'utf8');
+  }
+
+  fs.rmSync(outDir, { recursive: true, force: true });
+  fs.mkdirSync(outDir, { recursive: true });
+  const manifest = [];
+  for (const file of files) {
+    const gzip = COMPRESS.has(path.extname(file.rel));
+    const stored = gzip ? `${file.rel}.gz` : file.rel;
+    if (stored.length > NAME_MAX) {
+      throw new Error(`${stored}: name longer than ${NAME_MAX} characters`);
+    }
+    const body = gzip ? zlib.gzipSync(file.data, { level: 9 }) : file.data;
+    fs.mkdirSync(path.dirname(path.join(outDir, stored)), { recursive: true });
+    fs.writeFileSync(path.join(outDir, stored), body);
+    manifest.push(`${hash(body).slice(0, 16)} ${file.rel}`);
+  }
+  fs.writeFileSync(path.join(outDir, 'etags'), `${manifest.join('\n')}\n`);
+}
+
+if (process.argv.length !== 3) {
+  console.error('usage: node build.js <output dir>');
+  process.exit(1);
+}
+build(path.resolve(process.argv[2]));
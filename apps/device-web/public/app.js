@@ -23,6 +23,9 @@ const apSsid = el('apSsid');
 const audioEnabled = el('audioEnabled');
 const audioMode = el('audioMode');
 const audioUrl = el('audioUrl');
+const audioFormat = el('audioFormat');
+const audioChannels = el('audioChannels');
+const audioDecimation = el('audioDecimation');
 const audioSampleRate = el('audioSampleRate');
 const audioStreamUrl = el('audioStreamUrl');
 const audioPushFields = el('audioPushFields');
@@ -40,6 +43,7 @@ const rebootLoading = el('rebootLoading');
 const rebootError = el('rebootError');
 
 let deviceTarget = null;
+let streamPort = null;
 let statsInterval = null;
 let statsHistory = [];
 // Audio stats polling configuration
@@ -86,10 +90,17 @@ async function loadAudioStats() {
     renderStatusGrid(el('audioStats'), [
       { label: 'Mic Callbacks (last 60s)', value: tapDelta.toLocaleString() },
       { label: 'Stream Writes (last 60s)', value: writesDelta.toLocaleString() },
-      { label: 'Write Failures (last 60s)', value: failedDelta.toLocaleString() },
+      { label: 'Pull Overruns (last 60s)', value: failedDelta.toLocaleString() },
       { label: 'Read Calls (last 60s)', value: readsDelta.toLocaleString() },
       { label: 'Data Streamed (last 60s)', value: `${(bytesDelta / 1024).toFixed(1)} KB` },
       { label: 'Status', value: stats.pullEnabled ? '✓ Active' : '✗ Inactive' },
+      { label: 'Pull Clients (active / slots)', value: `${(stats.pullClients ?? []).filter((c) => c.active).length} / ${(stats.pullClients ?? []).length}` },
+      { label: 'Pull Drops oldest / newest', value: `${(stats.pullDropOldest ?? 0).toLocaleString()} / ${(stats.pullDropNewest ?? 0).toLocaleString()}` },
+      { label: 'Push Connects / Dropped', value: `${(stats.pushConnects ?? 0).toLocaleString()} / ${(stats.pushDropped ?? 0).toLocaleString()}` },
+      { label: 'DMA Overflows (total)', value: (stats.mic?.dmaOverflows ?? 0).toLocaleString() },
+      { label: 'Chunk Time avg/max', value: stats.mic ? `${stats.mic.chunkUs.avg.toFixed(0)} / ${stats.mic.chunkUs.max} µs` : '-' },
+      { label: 'Detector Taps Dropped', value: (stats.detection?.tapsDropped ?? 0).toLocaleString() },
+      { label: 'DC Offset L/R', value: stats.mic?.dcOffset ? `${stats.mic.dcOffset.left} / ${stats.mic.dcOffset.right}${stats.mic.dcOffset.calibrated ? '' : ' (not calibrated)'}` : '-' },
     ]);
   } catch (err) {
     console.error('Failed to load stats:', err);
@@ -159,8 +170,12 @@ function setPill(elm, ok, okText, warnText) {
 
 function buildStreamUrl() {
   // Use current page location if deviceTarget is not set
-  const baseUrl = deviceTarget || `${window.location.protocol}//${window.location.host}`;
-  return `${baseUrl.replace(/\/$/, '')}/api/v1/audio/stream.wav`;
+  const base = new URL(deviceTarget || window.location.href);
+  // Streams are served by a second server on the port the device reports.
+  if (streamPort) {
+    base.port = String(streamPort);
+  }
+  return `${base.origin}/api/v1/audio/stream.wav`;
 }
 
 function updateAudioModeView() {
@@ -170,6 +185,11 @@ function updateAudioModeView() {
   const isPull = audioMode.value === 'pull';
   audioPushFields.classList.toggle('hidden', isPull);
   audioPullFields.classList.toggle('hidden', !isPull);
+  if (audioUrl) {
+    audioUrl.placeholder = audioMode.value === 'rtp'
+      ? 'receiver-host:5004'
+      : 'https://your-server.com/upload';
+  }
   if (audioStreamUrl) {
     audioStreamUrl.value = buildStreamUrl() || 'Unknown';
   }
@@ -223,20 +243,31 @@ async function loadWifiStatus() {
   }
 }
 
+function renderScan(ssids) {
+  ssidList.innerHTML = '';
+  ssids.forEach((ssid) => {
+    const li = document.createElement('li');
+    li.textContent = ssid;
+    li.addEventListener('click', () => {
+      ssidInput.value = ssid;
+    });
+    ssidList.appendChild(li);
+  });
+}
+
+// The device answers from its scan cache; a refresh runs in the background
+// and is polled for, so the page never holds an HTTP worker during a scan.
 async function scanWifi() {
   setError(scanError, null);
-  ssidList.innerHTML = '';
   setLoading(scanLoading, true);
   try {
-    const data = await api('/api/v1/wifi/scan');
-    data.ssids.forEach((ssid) => {
-      const li = document.createElement('li');
-      li.textContent = ssid;
-      li.addEventListener('click', () => {
-        ssidInput.value = ssid;
-      });
-      ssidList.appendChild(li);
-    });
+    let data = await api('/api/v1/wifi/scan?refresh=1');
+    renderScan(data.ssids);
+    for (let i = 0; data.scanning && i < 20; i++) {
+      await new Promise((resolve) => setTimeout(resolve, 500));
+      data = await api('/api/v1/wifi/scan');
+    }
+    renderScan(data.ssids);
   } catch (err) {
     setError(scanError, err);
   } finally {
@@ -287,8 +318,9 @@ async function loadStreamConfig() {
   setLoading(audioLoading, true);
   try {
     const data = await api('/api/v1/audio/stream');
+    streamPort = data.streamPort || null;
     const rawMode = data.mode || '';
-    const mode = rawMode === 'pull' || rawMode === 'push' ? rawMode : 'push';
+    const mode = ['pull', 'push', 'events', 'rtp'].includes(rawMode) ? rawMode : 'push';
     if (audioMode) {
       audioMode.value = mode;
     }
@@ -298,6 +330,15 @@ async function loadStreamConfig() {
     if (audioUrl) {
       audioUrl.value = data.uploadUrl || '';
     }
+    if (audioFormat) {
+      audioFormat.value = data.format === 'adpcm' ? 'adpcm' : 'pcm';
+    }
+    if (audioChannels) {
+      audioChannels.value = data.channels || 'stereo';
+    }
+    if (audioDecimation) {
+      audioDecimation.value = String(data.decimation || 1);
+    }
     updateAudioModeView();
 
     if (mode === 'pull' && data.enabled) {
@@ -307,10 +348,12 @@ async function loadStreamConfig() {
       const streamUrl = buildStreamUrl() || '—';
       const urlRow = mode === 'pull'
         ? { label: 'Stream URL', value: streamUrl }
-        : { label: 'Upload URL', value: data.uploadUrl || '—' };
+        : { label: mode === 'rtp' ? 'RTP Target' : 'Upload URL', value: data.uploadUrl || '—' };
       renderStatusGrid(el('audioStats'), [
         { label: 'Status', value: data.enabled ? 'Enabled' : 'Disabled' },
         { label: 'Mode', value: mode.toUpperCase() },
+        { label: 'Format', value: (data.format || 'pcm').toUpperCase() },
+        { label: 'Channels', value: data.channels || 'stereo' },
         urlRow,
       ]);
     }
@@ -343,6 +386,9 @@ async function saveStreamConfig() {
         enabled: audioEnabled ? audioEnabled.value === 'true' : false,
         mode: audioMode ? audioMode.value.trim() : 'push',
         uploadUrl: audioUrl ? audioUrl.value.trim() : '',
+        format: audioFormat ? audioFormat.value : 'pcm',
+        channels: audioChannels ? audioChannels.value : 'stereo',
+        decimation: audioDecimation ? Number(audioDecimation.value) : 1,
       }),
     });
     await loadStreamConfig();
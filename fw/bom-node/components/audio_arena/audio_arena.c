@@ -0,0 +1,170 @@
+#include "audio_arena.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "metrics.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "ARENA";
+
+#define ARENA_ALIGN 8
+#define ARENA_MAX_OWNERS 16
+
+#if defined(CONFIG_SPIRAM)
+#define ARENA_LARGE_CAPS (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#else
+#define ARENA_LARGE_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#endif
+
+typedef struct {
+  const char *name;
+  uint32_t caps;
+  size_t size;
+  uint8_t *base;
+  size_t used;
+  size_t overflow; // bytes served from the heap because the block was full
+} arena_block;
+
+typedef struct {
+  const char *owner;
+  audio_arena_region region;
+  size_t bytes;
+} arena_owner;
+
+static arena_block s_blocks[AUDIO_ARENA_REGION_COUNT] = {
+    [AUDIO_ARENA_INTERNAL] = {.name = "internal",
+                              .caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+                              .size = CONFIG_AUDIO_ARENA_INTERNAL_KB * 1024},
+    [AUDIO_ARENA_LARGE] = {.name = "large",
+                           .caps = ARENA_LARGE_CAPS,
+                           .size = CONFIG_AUDIO_ARENA_LARGE_KB * 1024},
+};
+static arena_owner s_owners[ARENA_MAX_OWNERS];
+static int s_owner_count = 0;
+static bool s_initialized = false;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void arena_collect(metrics_out *out, void *ctx);
+static metrics_collector s_collector =
+    METRICS_COLLECTOR_INIT(arena_collect, NULL);
+
+static void arena_collect(metrics_out *out, void *ctx) {
+  (void)ctx;
+  metrics_out_family(out, "audio_arena_bytes", "gauge",
+                     "Audio arena reservation and use per region");
+  for (int i = 0; i < AUDIO_ARENA_REGION_COUNT; i++) {
+    const arena_block *b = &s_blocks[i];
+    static const char *const states[] = {"reserved", "used", "overflow"};
+    const size_t values[] = {b->base ? b->size : 0, b->used, b->overflow};
+    for (int k = 0; k < 3; k++) {
+      char labels[48];
+      snprintf(labels, sizeof(labels), "region=\"%s\",state=\"%s\"", b->name,
+               states[k]);
+      metrics_out_uint(out, "audio_arena_bytes", labels, values[k]);
+    }
+  }
+}
+
+void audio_arena_init(void) {
+  if (s_initialized) {
+    return;
+  }
+  s_initialized = true;
+  for (int i = 0; i < AUDIO_ARENA_REGION_COUNT; i++) {
+    arena_block *b = &s_blocks[i];
+    if (b->size == 0) {
+      continue;
+    }
+    b->base = heap_caps_aligned_alloc(ARENA_ALIGN, b->size, b->caps);
+    if (!b->base) {
+      ESP_LOGE(TAG, "Cannot reserve %u B of %s RAM, using the heap",
+               (unsigned)b->size, b->name);
+    }
+  }
+  metrics_register(&s_collector.base);
+}
+
+// Callers hold s_mux.
+static void arena_account(const char *owner, audio_arena_region region,
+                          size_t bytes) {
+  for (int i = 0; i < s_owner_count; i++) {
+    if (s_owners[i].region == region && strcmp(s_owners[i].owner, owner) == 0) {
+      s_owners[i].bytes += bytes;
+      return;
+    }
+  }
+  if (s_owner_count < ARENA_MAX_OWNERS) {
+    s_owners[s_owner_count++] =
+        (arena_owner){.owner = owner, .region = region, .bytes = bytes};
+  }
+}
+
+void *audio_arena_alloc(audio_arena_region region, size_t size,
+                        const char *owner) {
+  if ((unsigned)region >= AUDIO_ARENA_REGION_COUNT || size == 0) {
+    return NULL;
+  }
+  owner = owner ? owner : "?";
+  arena_block *b = &s_blocks[region];
+  const size_t rounded = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+  void *p = NULL;
+  portENTER_CRITICAL(&s_mux);
+  if (b->base && rounded <= b->size - b->used) {
+    p = b->base + b->used;
+    b->used += rounded;
+    arena_account(owner, region, rounded);
+  }
+  portEXIT_CRITICAL(&s_mux);
+
+  if (p) {
+    memset(p, 0, size);
+    return p;
+  }
+  ESP_LOGW(TAG, "%s RAM arena full, %s takes %u B from the heap", b->name,
+           owner, (unsigned)size);
+  p = heap_caps_calloc(1, size, b->caps);
+  if (p) {
+    portENTER_CRITICAL(&s_mux);
+    b->overflow += size;
+    portEXIT_CRITICAL(&s_mux);
+  }
+  return p;
+}
+
+void *audio_arena_slot_get(audio_arena_slot *slot, audio_arena_region region,
+                           size_t size, const char *owner) {
+  if (!slot) {
+    return NULL;
+  }
+  if (slot->ptr && size <= slot->cap) {
+    memset(slot->ptr, 0, size);
+    return slot->ptr;
+  }
+  void *p = audio_arena_alloc(region, size, owner);
+  if (p) {
+    slot->ptr = p;
+    slot->cap = size;
+  }
+  return p;
+}
+
+void audio_arena_log(void) {
+  for (int i = 0; i < AUDIO_ARENA_REGION_COUNT; i++) {
+    const arena_block *b = &s_blocks[i];
+    ESP_LOGI(TAG, "%s: %u of %u B used, %u B overflowed to the heap", b->name,
+             (unsigned)b->used, b->base ? (unsigned)b->size : 0,
+             (unsigned)b->overflow);
+    for (int k = 0; k < s_owner_count; k++) {
+      if (s_owners[k].region == (audio_arena_region)i) {
+        ESP_LOGI(TAG, "  %-18s %6u B", s_owners[k].owner,
+                 (unsigned)s_owners[k].bytes);
+      }
+    }
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef AUDIO_ARENA_H
+#define AUDIO_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Start-up arena for the audio pipeline's buffers.
+//
+// audio_arena_init() reserves the whole budget in one pass, one block per
+// region, before anything else has fragmented the heap. The audio
+// components then carve their buffers out of it with a bump pointer;
+// nothing is returned, so once the pipeline is running no buffer is
+// allocated from or freed to the heap. Buffers that are replaced on a
+// reconfiguration live in slots, which are only grown when the new size
+// does not fit.
+//
+//   AUDIO_ARENA_INTERNAL: internal RAM, for state touched per sample or per
+//                         tap (rings, detector, queues).
+//   AUDIO_ARENA_LARGE:    PSRAM when the build has it, internal RAM
+//                         otherwise, for chunk pools and history buffers
+//                         that are touched once per chunk.
+//
+// The sizes come from CONFIG_AUDIO_ARENA_INTERNAL_KB and _LARGE_KB; the
+// start-up log and the audio_arena_bytes metric show how much is used. A
+// request that does not fit is served from the heap with a warning, so a
+// budget that is too small costs fragmentation, not audio.
+
+typedef enum {
+  AUDIO_ARENA_INTERNAL,
+  AUDIO_ARENA_LARGE,
+  AUDIO_ARENA_REGION_COUNT,
+} audio_arena_region;
+
+// Reserves both regions; later calls do nothing. Call first in app_main.
+void audio_arena_init(void);
+
+// Zeroed, 8-byte aligned. NULL only when the heap fallback fails too.
+void *audio_arena_alloc(audio_arena_region region, size_t size,
+                        const char *owner);
+
+typedef struct {
+  void *ptr;
+  size_t cap;
+} audio_arena_slot;
+
+// A zeroed buffer of `size` bytes in `slot`, reusing its memory when it is
+// big enough. Growing abandons the old buffer to the arena.
+void *audio_arena_slot_get(audio_arena_slot *slot, audio_arena_region region,
+                           size_t size, const char *owner);
+
+// Logs each region's use and the owners of its buffers.
+void audio_arena_log(void);
+
+#endif
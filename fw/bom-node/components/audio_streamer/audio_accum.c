@@ -0,0 +1,53 @@
+#include "audio_accum.h"
+
+void audio_accum_init(audio_accum *acc, int16_t *data, size_t capacity) {
+  acc->data = data;
+  acc->capacity = capacity;
+  acc->frames = 0;
+  acc->first_index = 0;
+  acc->next_index = 0;
+}
+
+// Appends `frames` frames from the planar tap to the partial chunk, two
+// frames per step.
+static inline void accum_append(audio_accum *acc, const int16_t *left,
+                                const int16_t *right, size_t frames) {
+  int16_t *dst = &acc->data[acc->frames * 2];
+  size_t i = 0;
+  for (; i + 2 <= frames; i += 2) {
+    dst[0] = left[i];
+    dst[1] = right[i];
+    dst[2] = left[i + 1];
+    dst[3] = right[i + 1];
+    dst += 4;
+  }
+  if (i < frames) {
+    dst[0] = left[i];
+    dst[1] = right[i];
+  }
+  acc->frames += frames;
+}
+
+void audio_accum_push(audio_accum *acc, const int16_t *left,
+                      const int16_t *right, size_t length, uint64_t index,
+                      audio_accum_full_fn full, void *ctx) {
+  if (acc->frames > 0 && index != acc->next_index) {
+    acc->frames = 0;
+  }
+  acc->next_index = index + length;
+
+  size_t done = 0;
+  while (done < length) {
+    if (acc->frames == 0) {
+      acc->first_index = index + done;
+    }
+    const size_t room = acc->capacity - acc->frames;
+    const size_t n = length - done < room ? length - done : room;
+    accum_append(acc, &left[done], &right[done], n);
+    done += n;
+    if (acc->frames == acc->capacity) {
+      acc->data = full(acc->data, acc->first_index, ctx);
+      acc->frames = 0;
+    }
+  }
+}
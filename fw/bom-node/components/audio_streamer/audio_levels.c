@@ -0,0 +1,118 @@
+#include "audio_levels.h"
+
+#include <math.h>
+#include <string.h>
+
+void audio_levels_init(audio_levels *lv, uint32_t block_samples) {
+  memset(lv, 0, sizeof(*lv));
+  lv->block_samples = block_samples > 0 ? block_samples : 1;
+}
+
+void audio_levels_push(audio_levels *lv, const int16_t *left,
+                       const int16_t *right, size_t length, uint64_t index,
+                       audio_levels_block_fn full, void *ctx) {
+  audio_levels_sum *cur = &lv->cur;
+  if (cur->samples > 0 && index != lv->next_index) {
+    memset(cur, 0, sizeof(*cur));
+  }
+  size_t i = 0;
+  while (i < length) {
+    if (cur->samples == 0) {
+      cur->first_index = index + i;
+    }
+    size_t n = lv->block_samples - cur->samples;
+    if (n > length - i) {
+      n = length - i;
+    }
+    const int16_t *src[AUDIO_LEVELS_CHANNELS] = {left + i, right + i};
+    for (int ch = 0; ch < AUDIO_LEVELS_CHANNELS; ch++) {
+      // Squares of 16-bit samples fit 31 bits, so a block of up to 2^32
+      // samples cannot carry out of the 64-bit sum.
+      uint64_t sum = 0;
+      uint32_t peak = cur->peak[ch];
+      for (size_t k = 0; k < n; k++) {
+        const int32_t s = src[ch][k];
+        const uint32_t mag = (uint32_t)(s < 0 ? -s : s);
+        sum += (uint64_t)(mag * mag);
+        peak = mag > peak ? mag : peak;
+      }
+      cur->sum_sq[ch] += sum;
+      cur->peak[ch] = peak;
+    }
+    cur->samples += (uint32_t)n;
+    i += n;
+    if (cur->samples == lv->block_samples) {
+      full(cur, ctx);
+      memset(cur, 0, sizeof(*cur));
+    }
+  }
+  lv->next_index = index + length;
+}
+
+bool audio_levels_merge(audio_levels_sum *dst, const audio_levels_sum *src) {
+  if (dst->samples == 0) {
+    *dst = *src;
+    return true;
+  }
+  if (src->first_index != dst->first_index + dst->samples) {
+    return false;
+  }
+  for (int ch = 0; ch < AUDIO_LEVELS_CHANNELS; ch++) {
+    dst->sum_sq[ch] += src->sum_sq[ch];
+    dst->peak[ch] = src->peak[ch] > dst->peak[ch] ? src->peak[ch]
+                                                  : dst->peak[ch];
+  }
+  dst->samples += src->samples;
+  return true;
+}
+
+int16_t audio_levels_cdb(float magnitude) {
+  if (!(magnitude > 0.0f)) {
+    return AUDIO_LEVELS_SILENT_CDB;
+  }
+  const float cdb = 2000.0f * log10f(magnitude / 32768.0f);
+  if (cdb <= (float)AUDIO_LEVELS_SILENT_CDB) {
+    return AUDIO_LEVELS_SILENT_CDB;
+  }
+  // A peak of -32768 is the only level above full scale.
+  return (int16_t)lrintf(cdb > 0.0f ? 0.0f : cdb);
+}
+
+static void put_le16(uint8_t *dst, uint16_t val) {
+  dst[0] = (uint8_t)val;
+  dst[1] = (uint8_t)(val >> 8);
+}
+
+static void put_le32(uint8_t *dst, uint32_t val) {
+  put_le16(dst, (uint16_t)val);
+  put_le16(dst + 2, (uint16_t)(val >> 16));
+}
+
+size_t audio_levels_encode(const audio_levels_sum *sum,
+                           const uint16_t floor[AUDIO_LEVELS_CHANNELS],
+                           uint32_t seq, uint16_t window_ms, uint8_t *out) {
+  out[0] = AUDIO_LEVELS_VERSION;
+  out[1] = AUDIO_LEVELS_CHANNELS;
+  put_le16(out + 2, window_ms);
+  put_le32(out + 4, seq);
+  put_le32(out + 8, (uint32_t)sum->first_index);
+  put_le32(out + 12, (uint32_t)(sum->first_index >> 32));
+  for (int ch = 0; ch < AUDIO_LEVELS_CHANNELS; ch++) {
+    const float rms =
+        sum->samples > 0
+            ? sqrtf((float)((double)sum->sum_sq[ch] / (double)sum->samples))
+            : 0.0f;
+    const int16_t rms_cdb = audio_levels_cdb(rms);
+    const int16_t peak_cdb = audio_levels_cdb((float)sum->peak[ch]);
+    // Silence has no crest factor; report 0 dB rather than the difference
+    // of two clamped levels.
+    const int16_t crest_cdb =
+        rms > 0.0f ? (int16_t)(peak_cdb - rms_cdb) : 0;
+    uint8_t *p = out + 16 + 8 * ch;
+    put_le16(p, (uint16_t)rms_cdb);
+    put_le16(p + 2, (uint16_t)peak_cdb);
+    put_le16(p + 4, (uint16_t)crest_cdb);
+    put_le16(p + 6, (uint16_t)audio_levels_cdb((float)floor[ch]));
+  }
+  return AUDIO_LEVELS_FRAME_BYTES;
+}
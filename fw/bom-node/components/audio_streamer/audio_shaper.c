@@ -0,0 +1,194 @@
+#include "audio_shaper.h"
+
+#include <math.h>
+#include <string.h>
+
+// Kaiser's design formulas for the window and, with
+// AUDIO_SHAPER_TAPS_PER_PHASE, the transition width in cycles per input
+// sample times the decimation. The stopband starts at the output Nyquist
+// rate.
+#define SHAPER_STOPBAND_DB 70.0
+#define SHAPER_KAISER_BETA (0.1102 * (SHAPER_STOPBAND_DB - 8.7))
+#define SHAPER_TRANSITION                                                      \
+  ((SHAPER_STOPBAND_DB - 8.0) / (14.357 * AUDIO_SHAPER_TAPS_PER_PHASE))
+
+#define SHAPER_MODES (int)(sizeof(s_channel_names) / sizeof(s_channel_names[0]))
+
+static const char *const s_channel_names[] = {
+    [AUDIO_CHANNELS_STEREO] = "stereo",
+    [AUDIO_CHANNELS_LEFT] = "left",
+    [AUDIO_CHANNELS_RIGHT] = "right",
+    [AUDIO_CHANNELS_MONO] = "mono",
+};
+
+bool audio_shaper_parse_channels(const char *name, audio_channel_mode *out) {
+  if (name == NULL) {
+    return false;
+  }
+  if (name[0] == '\0') {
+    *out = AUDIO_CHANNELS_STEREO;
+    return true;
+  }
+  for (int i = 0; i < SHAPER_MODES; i++) {
+    if (strcmp(name, s_channel_names[i]) == 0) {
+      *out = (audio_channel_mode)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *audio_shaper_channels_name(audio_channel_mode mode) {
+  return (int)mode >= 0 && (int)mode < SHAPER_MODES
+             ? s_channel_names[mode]
+             : s_channel_names[AUDIO_CHANNELS_STEREO];
+}
+
+// Zeroth-order modified Bessel function, by its power series.
+static double bessel_i0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 32; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+    if (term < sum * 1e-12) {
+      break;
+    }
+  }
+  return sum;
+}
+
+static void design_lowpass(audio_shaper *sh) {
+  const int taps = sh->taps;
+  const double fc = (0.5 - SHAPER_TRANSITION / 2.0) / sh->decimation;
+  const double i0_beta = bessel_i0(SHAPER_KAISER_BETA);
+  double h[AUDIO_SHAPER_MAX_TAPS];
+  double sum = 0.0;
+  for (int n = 0; n < taps; n++) {
+    const double t = n - sh->delay;
+    const double sinc =
+        t == 0.0 ? 2.0 * fc : sin(2.0 * M_PI * fc * t) / (M_PI * t);
+    const double r = t / sh->delay;
+    h[n] = sinc * bessel_i0(SHAPER_KAISER_BETA * sqrt(1.0 - r * r)) / i0_beta;
+    sum += h[n];
+  }
+  // Unity gain at DC after rounding: the centre tap takes up the slack.
+  int32_t qsum = 0;
+  for (int n = 0; n < taps; n++) {
+    sh->coef[n] = (int16_t)lrint(h[n] / sum * 32768.0);
+    qsum += sh->coef[n];
+  }
+  sh->coef[sh->delay] = (int16_t)(sh->coef[sh->delay] + (32768 - qsum));
+}
+
+bool audio_shaper_init(audio_shaper *sh, audio_channel_mode mode,
+                       int decimation) {
+  if (decimation < 1 || decimation > AUDIO_SHAPER_MAX_DECIMATION) {
+    return false;
+  }
+  memset(sh, 0, sizeof(*sh));
+  sh->mode = mode;
+  sh->channels = mode == AUDIO_CHANNELS_STEREO ? 2 : 1;
+  sh->decimation = decimation;
+  if (decimation > 1) {
+    sh->taps = AUDIO_SHAPER_TAPS_PER_PHASE * decimation + 1;
+    sh->delay = (sh->taps - 1) / 2;
+    design_lowpass(sh);
+  }
+  return true;
+}
+
+void audio_shaper_reset(audio_shaper *sh) {
+  memset(sh->hist, 0, sizeof(sh->hist));
+  sh->pos = 0;
+  sh->started = false;
+}
+
+uint64_t audio_shaper_out_index(const audio_shaper *sh, uint64_t index) {
+  if (sh->decimation == 1) {
+    return index;
+  }
+  const uint64_t m = (uint64_t)sh->decimation;
+  const uint64_t next = (index + m - 1) / m * m;
+  return next > (uint64_t)sh->delay ? next - (uint64_t)sh->delay : 0;
+}
+
+static inline void pick(audio_channel_mode mode, const int16_t *frame,
+                        int16_t *s) {
+  switch (mode) {
+  case AUDIO_CHANNELS_LEFT:
+    s[0] = frame[0];
+    break;
+  case AUDIO_CHANNELS_RIGHT:
+    s[0] = frame[1];
+    break;
+  case AUDIO_CHANNELS_MONO:
+    s[0] = (int16_t)(((int32_t)frame[0] + frame[1]) >> 1);
+    break;
+  default:
+    s[0] = frame[0];
+    s[1] = frame[1];
+    break;
+  }
+}
+
+static inline int16_t fir(const int16_t *coef, const int16_t *x, int taps) {
+  int32_t acc = 1 << 14;
+  for (int j = 0; j < taps; j++) {
+    acc += (int32_t)coef[j] * x[j];
+  }
+  acc >>= 15;
+  if (acc > INT16_MAX)
+    acc = INT16_MAX;
+  if (acc < INT16_MIN)
+    acc = INT16_MIN;
+  return (int16_t)acc;
+}
+
+size_t audio_shaper_run(audio_shaper *sh, const int16_t *interleaved,
+                        size_t frames, uint64_t index, int16_t *out) {
+  if (frames == 0) {
+    return 0;
+  }
+  if (!sh->started || index != sh->next_index) {
+    audio_shaper_reset(sh);
+    sh->phase = (int)(index % (uint64_t)sh->decimation);
+    sh->started = true;
+  }
+  sh->next_index = index + frames;
+
+  const int channels = sh->channels;
+  if (sh->decimation == 1) {
+    if (sh->mode == AUDIO_CHANNELS_STEREO) {
+      memcpy(out, interleaved, frames * 2 * sizeof(int16_t));
+    } else {
+      for (size_t f = 0; f < frames; f++) {
+        pick(sh->mode, &interleaved[2 * f], &out[f]);
+      }
+    }
+    return frames;
+  }
+
+  const int taps = sh->taps;
+  size_t made = 0;
+  for (size_t f = 0; f < frames; f++) {
+    int16_t s[2];
+    pick(sh->mode, &interleaved[2 * f], s);
+    for (int c = 0; c < channels; c++) {
+      sh->hist[c][sh->pos] = s[c];
+      sh->hist[c][sh->pos + taps] = s[c];
+    }
+    sh->pos = sh->pos + 1 == taps ? 0 : sh->pos + 1;
+    // Only the phase that is kept is filtered.
+    if (sh->phase == 0) {
+      for (int c = 0; c < channels; c++) {
+        out[made * channels + c] = fir(sh->coef, &sh->hist[c][sh->pos], taps);
+      }
+      made++;
+    }
+    if (++sh->phase == sh->decimation) {
+      sh->phase = 0;
+    }
+  }
+  return made;
+}
@@ -1,53 +1,222 @@
 #include "audio_streamer.h"
 
+#include "audio_accum.h"
+#include "audio_arena.h"
+#include "audio_shaper.h"
 #include "audio_wav.h"
+#include "esp_crt_bundle.h"
 #include "esp_http_client.h"
 #include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_random.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/semphr.h"
-#include "freertos/stream_buffer.h"
 #include "freertos/task.h"
+#include "esp_timer.h"
+#include "ima_adpcm.h"
+#include "metrics.h"
+#include "trace.h"
+#include "lwip/netdb.h"
+#include "lwip/sockets.h"
 #include "mic_input.h"
+#include "rtp_packetizer.h"
+#include "sdkconfig.h"
+#include "wifi_perf.h"
 
+#include <errno.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 
 static const char *TAG = "AUDIO_STREAM";
 
 #define STREAM_CHUNK_FRAMES 480
-#define STREAM_QUEUE_LENGTH 8
+// Chunks live in a fixed pool; the push queue and the free list carry only
+// pointers. One chunk is being filled by the tap callback, the rest can be
+// queued, so the queue depth is the pool size.
+#define STREAM_POOL_CHUNKS  CONFIG_AUDIO_STREAM_POOL_CHUNKS
 #define STREAM_TASK_STACK   6144
-#define STREAM_TASK_PRIO    5
+#define STREAM_TASK_PRIO    CONFIG_AUDIO_STREAM_TASK_PRIORITY
+#define STREAM_TASK_CORE    CONFIG_AUDIO_STREAM_TASK_CORE
 #define STREAM_RETRY_MS     1000
-#define PULL_STREAM_BUFFER_BYTES 16384
+#define STREAM_RETRY_MAX_MS 30000
+#define PULL_RING_CHUNKS    CONFIG_AUDIO_STREAM_PULL_RING_CHUNKS
+#define PULL_MAX_CLIENTS    CONFIG_AUDIO_STREAM_PULL_CLIENTS
+#ifdef CONFIG_AUDIO_STREAM_PULL_DROP_NEWEST
+#define PULL_DROP_NEWEST 1
+#else
+#define PULL_DROP_NEWEST 0
+#endif
+// Taps per callback; with the default 30-sample tap one batch is one chunk.
+#define STREAM_BATCH_TAPS 16
+
+#define STREAM_FRAME_BYTES (2 * sizeof(int16_t))
+#define STREAM_CHUNK_BYTES (STREAM_CHUNK_FRAMES * STREAM_FRAME_BYTES)
+// Push writes coalesce as many whole chunks as fit in this many TCP segments
+// (with the default 1440-byte MSS: 3 chunks = 5760 B = 4 segments), sent as
+// one HTTP chunk with a single write.
+#define STREAM_PUSH_SEGMENTS 4
+#define STREAM_PUSH_CHUNKS                                                     \
+  ((STREAM_PUSH_SEGMENTS * CONFIG_LWIP_TCP_MSS) / STREAM_CHUNK_BYTES)
+// Longest a queued chunk waits for the rest of its write to fill.
+#define STREAM_PUSH_LINGER_MS 40
+// Room for the "<hex size>\r\n" chunk header in front of the payload.
+#define STREAM_CHUNK_HDR_MAX 8
+#define STREAM_RTP_HOST_MAX  64
+
+_Static_assert(STREAM_PUSH_CHUNKS >= 1, "TCP MSS smaller than one chunk");
+_Static_assert((PULL_RING_CHUNKS & (PULL_RING_CHUNKS - 1)) == 0,
+               "pull ring size must be a power of two");
 
 typedef struct {
   size_t bytes;
+  uint64_t sample_index; // mic sample counter of the first frame
   int16_t data[STREAM_CHUNK_FRAMES * 2];
 } audio_chunk_t;
 
-static QueueHandle_t s_queue = NULL;
-static StreamBufferHandle_t s_pull_stream = NULL;
+static QueueHandle_t s_queue = NULL; // filled chunks for the push task
+static QueueHandle_t s_free = NULL;  // empty chunks for the tap callback
+// The pool and the pull ring are touched once per chunk, so they live in the
+// large arena (PSRAM when fitted).
+static audio_chunk_t *s_pool = NULL;
+// Broadcast ring for pull clients, indexed by a free-running chunk sequence
+// number. The tap callback is the only writer: it announces the sequence it
+// is about to overwrite in s_pull_writing, copies the chunk in and then
+// publishes it through s_pull_head. Readers copy without a lock and check
+// s_pull_writing afterwards to detect that they were lapped mid-copy.
+static int16_t (*s_pull_ring)[STREAM_CHUNK_FRAMES * 2] = NULL;
+static uint64_t s_pull_index[PULL_RING_CHUNKS]; // sample_index of each slot
+static _Atomic uint32_t s_pull_head = 0;    // chunks published
+static _Atomic uint32_t s_pull_writing = 0; // chunks written or in progress
+
+struct audio_pull_client {
+  _Atomic bool active;
+  // Next chunk to read. Published after each copy so the drop-newest writer
+  // can tell which slots are still unread.
+  _Atomic uint32_t seq;
+  size_t offset;   // bytes of it already read
+  SemaphoreHandle_t ready; // given by the tap callback for every chunk
+  uint32_t read_bytes;
+  uint32_t overruns;
+  uint32_t skipped_chunks;
+  uint32_t held_chunks; // written by the tap callback
+  // Fixed when the client attaches; each client shapes and encodes what it
+  // reads, so the ring itself stays full-rate stereo PCM.
+  audio_stream_layout_t layout;
+  audio_shaper shaper;
+  ima_adpcm_encoder enc;
+  uint64_t enc_index;  // label of the encoder's first pending frame
+  uint64_t next_index; // ring index the last read ended at
+  int16_t shaped[STREAM_CHUNK_FRAMES * 2]; // shaper output, per ring chunk
+};
+
+static audio_pull_client s_pull_clients[PULL_MAX_CLIENTS];
 static TaskHandle_t s_task = NULL;
 static SemaphoreHandle_t s_cfg_mutex = NULL;
 static SemaphoreHandle_t s_pull_mutex = NULL;
 static audio_config_t s_config = {0};
 static volatile bool s_push_enabled = false;
+static volatile bool s_rtp_enabled = false;
 static volatile bool s_pull_enabled = false;
-static bool s_pull_in_use = false;
+static atomic_bool s_paused = false; // push and RTP held off for an update
+// Push and RTP hold the Wi-Fi streaming profile while configured; pull
+// clients hold it while attached (see wifi_perf.h).
+static bool s_radio_held = false;
 static bool s_need_reconnect = false;
 static int s_tap_size = 0;
 static int s_sample_rate = 0;
-static audio_chunk_t s_accum_chunk = {0};
-static size_t s_accum_frames = 0;
-static volatile uint32_t s_tap_calls = 0;
-static volatile uint32_t s_stream_writes = 0;
-static volatile uint32_t s_accum_full = 0;
-static volatile uint32_t s_send_failed = 0;
-static volatile uint32_t s_read_calls = 0;
-static volatile uint32_t s_read_bytes = 0;
+// The accumulation stage belongs to the tap callback (the reader task): only
+// it touches the partial chunk. Other tasks ask for the partial chunk to be
+// dropped through s_accum_reset, which the callback takes before its next
+// append.
+static audio_chunk_t *s_accum_chunk = NULL;
+static audio_accum s_accum;
+static atomic_bool s_accum_reset = false;
+// Set when the mic was reconfigured; the push connection restarts with a new
+// WAV header and pull readers end their response.
+static volatile bool s_format_changed = false;
+static volatile uint32_t s_format_epoch = 0;
+// Counters are per-core sharded (see metrics.h): the tap callback, the
+// stream tasks and every pull client's task update them without a lock.
+static metrics_counter s_tap_calls =
+    METRICS_COUNTER_INIT("audio_stream_taps_total", "Mic taps seen by the streamer.");
+static metrics_counter s_accum_full = METRICS_COUNTER_INIT(
+    "audio_stream_chunks_total", "480-frame chunks accumulated from the mic.");
+static metrics_counter s_stream_writes = METRICS_COUNTER_INIT(
+    "audio_stream_pull_writes_total", "Chunks written to the pull ring.");
+static metrics_counter s_pull_drop_oldest = METRICS_COUNTER_INIT(
+    "audio_stream_pull_drop_oldest_total", "Chunks skipped by lapped pull clients.");
+static metrics_counter s_pull_drop_newest = METRICS_COUNTER_INIT(
+    "audio_stream_pull_drop_newest_total", "Chunks not written to a full pull ring.");
+static metrics_counter s_read_calls =
+    METRICS_COUNTER_INIT("audio_stream_pull_reads_total", "Pull client reads.");
+static metrics_counter s_read_bytes =
+    METRICS_COUNTER_INIT("audio_stream_pull_bytes_total", "Bytes read by pull clients.");
+static metrics_counter s_push_writes = METRICS_COUNTER_INIT(
+    "audio_stream_push_writes_total", "Coalesced HTTP chunk frames sent.");
+static metrics_counter s_push_bytes =
+    METRICS_COUNTER_INIT("audio_stream_push_bytes_total", "Audio bytes pushed.");
+static metrics_counter s_push_connects = METRICS_COUNTER_INIT(
+    "audio_stream_push_connects_total", "Push and RTP connections opened.");
+static metrics_counter s_push_reused = METRICS_COUNTER_INIT(
+    "audio_stream_push_reused_total", "Push uploads started on a kept connection.");
+static metrics_counter s_push_dropped = METRICS_COUNTER_INIT(
+    "audio_stream_push_dropped_total", "Chunks lost to a full push queue.");
+static metrics_counter s_push_gaps = METRICS_COUNTER_INIT(
+    "audio_stream_push_gaps_total", "Uploads restarted to keep the stamp exact.");
+static metrics_counter s_rtp_packets =
+    METRICS_COUNTER_INIT("audio_stream_rtp_packets_total", "RTP datagrams sent.");
+static metrics_counter s_rtp_bytes =
+    METRICS_COUNTER_INIT("audio_stream_rtp_bytes_total", "RTP bytes sent, with headers.");
+static metrics_counter s_rtp_dropped = METRICS_COUNTER_INIT(
+    "audio_stream_rtp_dropped_total", "RTP datagrams the stack had no room for.");
+static metrics_counter s_rtp_gaps = METRICS_COUNTER_INIT(
+    "audio_stream_rtp_gaps_total", "Discontinuities marked in the RTP stream.");
+static metrics_counter *const s_counters[] = {
+    &s_tap_calls,     &s_accum_full,     &s_stream_writes, &s_pull_drop_oldest,
+    &s_pull_drop_newest, &s_read_calls,  &s_read_bytes,    &s_push_writes,
+    &s_push_bytes,    &s_push_connects,  &s_push_dropped,  &s_push_gaps,
+    &s_rtp_packets,   &s_rtp_bytes,      &s_rtp_dropped,   &s_rtp_gaps,
+    &s_push_reused,
+};
+static metrics_histogram s_push_write_us =
+    METRICS_HISTOGRAM_INIT("audio_stream_push_write_us",
+                           "Time to write one push frame to the socket.", 250,
+                           1000, 2500, 5000, 10000, 25000, 100000);
+// One HTTP chunk frame: header, coalesced PCM payload, trailing CRLF. The
+// push task owns it; unsent payload survives a reconnect. Declared as int16
+// so the payload can be read back as samples by the encoder.
+static int16_t s_push_frame[(STREAM_CHUNK_HDR_MAX +
+                             STREAM_PUSH_CHUNKS * STREAM_CHUNK_BYTES + 2) /
+                            sizeof(int16_t)];
+// ADPCM frame built from the PCM payload when the push format asks for it;
+// a mono payload holds twice the frames.
+static char s_push_coded[STREAM_CHUNK_HDR_MAX +
+                         IMA_ADPCM_MAX_BYTES(STREAM_PUSH_CHUNKS *
+                                             STREAM_CHUNK_FRAMES * 2) +
+                         2];
+static ima_adpcm_encoder s_push_enc;
+// The push client outlives single uploads (push task only). A finished
+// upload leaves its keep-alive connection open for the next one, so a
+// restart after a gap or a config change costs no new TCP or TLS handshake;
+// after a dropped connection the TLS session saved in the client's
+// transport is resumed with an abbreviated handshake. Released when push
+// stops or the URL changes.
+static esp_http_client_handle_t s_push_http = NULL;
+static char s_push_url[AUDIO_URL_MAX_LEN];
+static bool s_push_reusable = false; // the last upload ended cleanly
+static audio_shaper s_push_shaper;
+// RTP mode, owned by the push task. lwIP copies a datagram into its own
+// pbuf before send() returns, so the packetizer's one preformatted packet
+// is free again for the next one at once.
+static rtp_packetizer s_rtp;
+static audio_shaper s_rtp_shaper;
+static int16_t s_rtp_shaped[STREAM_CHUNK_FRAMES * 2];
+static int s_rtp_sock = -1;
+static mic_subscription *s_tap_sub = NULL;
 
 static bool audio_streamer_mode_push(const char *mode) {
   if (mode == NULL) {
@@ -58,6 +227,13 @@ static bool audio_streamer_mode_push(const char *mode) {
          (strcmp(mode, "http_stream") == 0);
 }
 
+static bool audio_streamer_mode_rtp(const char *mode) {
+  if (mode == NULL) {
+    return false;
+  }
+  return strcmp(mode, "rtp") == 0;
+}
+
 static bool audio_streamer_mode_pull(const char *mode) {
   if (mode == NULL) {
     return false;
@@ -65,49 +241,135 @@ static bool audio_streamer_mode_pull(const char *mode) {
   return (strcmp(mode, "pull") == 0) || (strcmp(mode, "http_pull") == 0);
 }
 
+static audio_stream_format_t audio_streamer_config_format(
+    const audio_config_t *cfg) {
+  audio_stream_format_t format = AUDIO_STREAM_PCM;
+  audio_streamer_parse_format(cfg->format, &format);
+  return format;
+}
+
+void audio_streamer_config_layout(const audio_config_t *cfg,
+                                  audio_stream_layout_t *out) {
+  out->format = audio_streamer_config_format(cfg);
+  out->channel_mode = AUDIO_CHANNELS_STEREO;
+  audio_shaper_parse_channels(cfg->channels, &out->channel_mode);
+  out->channels = out->channel_mode == AUDIO_CHANNELS_STEREO ? 2 : 1;
+  out->decimation = cfg->decimation >= 1 &&
+                            cfg->decimation <= AUDIO_SHAPER_MAX_DECIMATION
+                        ? cfg->decimation
+                        : 1;
+  out->sample_rate = s_sample_rate / out->decimation;
+}
+
 static bool audio_streamer_should_push(const audio_config_t *cfg) {
   return cfg->enabled && audio_streamer_mode_push(cfg->mode) &&
          cfg->upload_url[0] != '\0';
 }
 
+static bool audio_streamer_should_rtp(const audio_config_t *cfg) {
+  return cfg->enabled && audio_streamer_mode_rtp(cfg->mode) &&
+         cfg->upload_url[0] != '\0';
+}
+
 static bool audio_streamer_should_pull(const audio_config_t *cfg) {
   return cfg->enabled && audio_streamer_mode_pull(cfg->mode);
 }
 
-static void audio_streamer_on_tap(const int16_t *tap_left,
-                                  const int16_t *tap_right, void *ctx) {
-  (void)ctx;
-  s_tap_calls++;
-  if ((!s_push_enabled && !s_pull_enabled) || s_tap_size <= 0) {
-    s_accum_frames = 0;
+// With drop-newest, a slot may only be reused once every attached client
+// has read it; the chunk is discarded otherwise and charged to the clients
+// holding the slot.
+static bool audio_streamer_pull_slot_free(uint32_t seq) {
+  bool reusable = true;
+  for (int i = 0; i < PULL_MAX_CLIENTS; i++) {
+    audio_pull_client *client = &s_pull_clients[i];
+    if (atomic_load_explicit(&client->active, memory_order_relaxed) &&
+        seq - atomic_load_explicit(&client->seq, memory_order_acquire) >
+            PULL_RING_CHUNKS - 1) {
+      client->held_chunks++;
+      reusable = false;
+    }
+  }
+  return reusable;
+}
+
+// Writes one chunk into the broadcast ring and wakes every attached client.
+// Never waits: with drop-oldest a client that has not kept up is lapped and
+// notices it on its next read; with drop-newest the chunk is dropped.
+static void audio_streamer_pull_publish(const audio_chunk_t *chunk) {
+  const uint32_t seq = atomic_load_explicit(&s_pull_head, memory_order_relaxed);
+  if (PULL_DROP_NEWEST && !audio_streamer_pull_slot_free(seq)) {
+    metrics_counter_inc(&s_pull_drop_newest);
     return;
   }
+  atomic_store_explicit(&s_pull_writing, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  memcpy(s_pull_ring[seq & (PULL_RING_CHUNKS - 1)], chunk->data, chunk->bytes);
+  s_pull_index[seq & (PULL_RING_CHUNKS - 1)] = chunk->sample_index;
+  atomic_store_explicit(&s_pull_head, seq + 1, memory_order_release);
+  metrics_counter_inc(&s_stream_writes);
 
-  for (int i = 0; i < s_tap_size; i++) {
-    s_accum_chunk.data[s_accum_frames * 2] = tap_left[i];
-    s_accum_chunk.data[s_accum_frames * 2 + 1] = tap_right[i];
-    s_accum_frames++;
+  for (int i = 0; i < PULL_MAX_CLIENTS; i++) {
+    if (atomic_load_explicit(&s_pull_clients[i].active,
+                             memory_order_relaxed)) {
+      xSemaphoreGive(s_pull_clients[i].ready);
+    }
+  }
+}
 
-    if (s_accum_frames >= STREAM_CHUNK_FRAMES) {
-      s_accum_full++;
-      s_accum_chunk.bytes = STREAM_CHUNK_FRAMES * 2 * sizeof(int16_t);
-      if (s_push_enabled && s_queue) {
-        if (xQueueSend(s_queue, &s_accum_chunk, 0) != pdTRUE) {
-          // Drop chunk when queue is full to keep the mic reader unblocked.
-        }
-      }
-      if (s_pull_enabled && s_pull_stream) {
-        size_t sent = xStreamBufferSend(s_pull_stream, s_accum_chunk.data, 
-                                        s_accum_chunk.bytes, pdMS_TO_TICKS(10));
-        if (sent == s_accum_chunk.bytes) {
-          s_stream_writes++;
-        } else {
-          s_send_failed++;
-        }
-      }
-      s_accum_frames = 0;
+// Publishes the full partial chunk. Pull readers get a copy under the ring's
+// seqlock; push and RTP get the buffer itself through the queue, which
+// orders the writes before the consumer sees them.
+static int16_t *audio_streamer_accum_publish(int16_t *data,
+                                             uint64_t first_index, void *ctx) {
+  (void)data;
+  (void)ctx;
+  metrics_counter_inc(&s_accum_full);
+  s_accum_chunk->sample_index = first_index;
+  s_accum_chunk->bytes = STREAM_CHUNK_BYTES;
+  if (s_pull_enabled) {
+    audio_streamer_pull_publish(s_accum_chunk);
+  }
+  if (s_push_enabled || s_rtp_enabled) {
+    // Hand the chunk over only once a replacement is secured; otherwise
+    // keep filling the same one. Either way the reader never blocks.
+    audio_chunk_t *next = NULL;
+    if (xQueueReceive(s_free, &next, 0) != pdTRUE) {
+      metrics_counter_inc(&s_push_dropped);
+    } else if (xQueueSend(s_queue, &s_accum_chunk, 0) != pdTRUE) {
+      xQueueSend(s_free, &next, 0);
+      metrics_counter_inc(&s_push_dropped);
+    } else {
+      TRACE_INSTANT(TRACE_CHUNK_QUEUE_SEND,
+                    (uint32_t)s_accum_chunk->sample_index);
+      s_accum_chunk = next;
     }
   }
+  return s_accum_chunk->data;
+}
+
+static void audio_streamer_on_tap(const mic_tap_view *tap, void *ctx) {
+  (void)ctx;
+  metrics_counter_inc(&s_tap_calls);
+  if (atomic_exchange_explicit(&s_accum_reset, false, memory_order_acquire)) {
+    audio_accum_drop(&s_accum);
+  }
+  audio_accum_push(&s_accum, tap->left, tap->right, (size_t)tap->length,
+                   tap->sample_index, audio_streamer_accum_publish, NULL);
+}
+
+// Mic config listener; runs on the reader task, like audio_streamer_on_tap.
+static void audio_streamer_on_mic_config(const mic_config *cfg, uint32_t epoch,
+                                         void *ctx) {
+  (void)ctx;
+  s_tap_size = cfg->tap_size;
+  s_sample_rate = cfg->sampling_freq;
+  // Frames accumulated at the old rate must not be sent under the new one.
+  audio_accum_drop(&s_accum);
+  s_format_epoch = epoch;
+  s_format_changed = true;
+  if (s_task) {
+    xTaskNotifyGive(s_task);
+  }
 }
 
 static void audio_streamer_copy_config(audio_config_t *out, bool *need_reconnect) {
@@ -121,89 +383,524 @@ static void audio_streamer_copy_config(audio_config_t *out, bool *need_reconnect
   }
 }
 
+static void audio_streamer_current_layout(audio_stream_layout_t *out) {
+  audio_config_t cfg = {0};
+  audio_streamer_copy_config(&cfg, NULL);
+  audio_streamer_config_layout(&cfg, out);
+}
+
+// Returns every queued chunk to the free list (a plain reset would leak
+// them).
+static void audio_streamer_drain_queue(void) {
+  audio_chunk_t *chunk = NULL;
+  while (xQueueReceive(s_queue, &chunk, 0) == pdTRUE) {
+    xQueueSend(s_free, &chunk, 0);
+  }
+}
+
+static bool audio_streamer_write_all(esp_http_client_handle_t client,
+                                     const char *buf, int len) {
+  while (len > 0) {
+    int written = esp_http_client_write(client, buf, len);
+    if (written <= 0) {
+      return false;
+    }
+    buf += written;
+    len -= written;
+  }
+  return true;
+}
+
+// Sends `len` bytes already placed at `payload` as one chunked-encoding
+// frame. `payload` must have STREAM_CHUNK_HDR_MAX bytes of room in front of
+// it and 2 bytes behind it.
+static bool audio_streamer_write_frame(esp_http_client_handle_t client,
+                                       char *payload, size_t len) {
+  char hdr[STREAM_CHUNK_HDR_MAX + 1];
+  int hlen = snprintf(hdr, sizeof(hdr), "%X\r\n", (unsigned)len);
+  if (hlen <= 0 || hlen > STREAM_CHUNK_HDR_MAX) {
+    return false;
+  }
+  memcpy(payload - hlen, hdr, hlen);
+  payload[len] = '\r';
+  payload[len + 1] = '\n';
+  return audio_streamer_write_all(client, payload - hlen, hlen + len + 2);
+}
+
+// Ends the upload. A graceful end reads the server's answer, which leaves a
+// keep-alive connection ready for the next upload; otherwise, or when that
+// fails, the connection is closed but the client and its TLS session kept.
+static void audio_streamer_disconnect(esp_http_client_handle_t *client,
+                                      bool graceful) {
+  if (*client == NULL) {
+    return;
+  }
+  s_push_reusable = false;
+  // Terminating zero-length chunk ends the upload cleanly.
+  if (graceful && audio_streamer_write_all(*client, "0\r\n\r\n", 5) &&
+      esp_http_client_fetch_headers(*client) >= 0) {
+    const int status = esp_http_client_get_status_code(*client);
+    int flushed = 0;
+    s_push_reusable =
+        esp_http_client_flush_response(*client, &flushed) == ESP_OK;
+    if (status < 200 || status >= 300) {
+      ESP_LOGW(TAG, "Push upload answered with status %d", status);
+    }
+  }
+  if (!s_push_reusable) {
+    esp_http_client_close(*client);
+  }
+  *client = NULL;
+}
+
+// Frees the push client, its connection and TLS session.
+static void audio_streamer_push_release(esp_http_client_handle_t *client) {
+  audio_streamer_disconnect(client, true);
+  if (s_push_http) {
+    esp_http_client_close(s_push_http);
+    esp_http_client_cleanup(s_push_http);
+    s_push_http = NULL;
+  }
+  s_push_reusable = false;
+}
+
+// The push client for `url`, created on first use or when the URL changed.
+static esp_http_client_handle_t audio_streamer_push_client(const char *url) {
+  if (s_push_http && strcmp(s_push_url, url) == 0) {
+    return s_push_http;
+  }
+  esp_http_client_handle_t none = NULL;
+  audio_streamer_push_release(&none);
+  esp_http_client_config_t http_cfg = {
+      .url = url,
+      .method = HTTP_METHOD_POST,
+      .timeout_ms = 5000,
+      .keep_alive_enable = true,
+      // Only consulted for https:// URLs.
+      .crt_bundle_attach = esp_crt_bundle_attach,
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+      .save_client_session = true,
+#endif
+  };
+  s_push_http = esp_http_client_init(&http_cfg);
+  if (!s_push_http) {
+    ESP_LOGE(TAG, "Failed to init http client");
+    return NULL;
+  }
+  strncpy(s_push_url, url, sizeof(s_push_url) - 1);
+  s_push_url[sizeof(s_push_url) - 1] = '\0';
+  esp_http_client_set_header(s_push_http, "Content-Type", "audio/wav");
+  return s_push_http;
+}
+
+// Stamp for a stream whose first frame is sample `index`.
+static void audio_streamer_stamp(uint64_t index, audio_wav_stamp *out) {
+  out->sample_index = index;
+  out->uptime_us = mic_sample_time_us(index);
+  out->unix_us = mic_sample_unix_us(index);
+}
+
+// Opens an upload whose WAV header stamps sample `start` as its first frame.
+static esp_http_client_handle_t
+audio_streamer_connect(const audio_config_t *cfg,
+                       const audio_stream_layout_t *layout, uint64_t start) {
+  esp_http_client_handle_t client = audio_streamer_push_client(cfg->upload_url);
+  if (!client) {
+    return NULL;
+  }
+  char header_frame[STREAM_CHUNK_HDR_MAX + AUDIO_WAV_STREAM_HEADER_MAX + 2];
+  audio_wav_stamp stamp;
+  audio_streamer_stamp(start, &stamp);
+  const size_t header_len = audio_streamer_build_header(
+      layout, &stamp, (uint8_t *)&header_frame[STREAM_CHUNK_HDR_MAX]);
+
+  // A kept connection the server has meanwhile closed fails on first use;
+  // that attempt is repeated once on a fresh connection.
+  const bool reused = s_push_reusable;
+  s_push_reusable = false;
+  for (int attempt = reused ? 0 : 1; attempt < 2; attempt++) {
+    // A length of -1 makes the client send "Transfer-Encoding: chunked";
+    // the frames themselves are built by audio_streamer_write_frame().
+    esp_err_t err = esp_http_client_open(client, -1);
+    if (err == ESP_OK &&
+        audio_streamer_write_frame(client, &header_frame[STREAM_CHUNK_HDR_MAX],
+                                   header_len)) {
+      metrics_counter_inc(attempt == 0 ? &s_push_reused : &s_push_connects);
+      return client;
+    }
+    esp_http_client_close(client);
+    if (attempt == 1) {
+      ESP_LOGW(TAG, "HTTP open failed: %s",
+               err != ESP_OK ? esp_err_to_name(err) : "WAV header not sent");
+    }
+  }
+  return NULL;
+}
+
+// Waits out the current reconnect delay and doubles it. A config change
+// notifies the task and cuts the wait short.
+static void audio_streamer_backoff(uint32_t *backoff_ms) {
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(*backoff_ms));
+  *backoff_ms = *backoff_ms >= STREAM_RETRY_MAX_MS / 2 ? STREAM_RETRY_MAX_MS
+                                                       : *backoff_ms * 2;
+}
+
+// Returns a chunk taken from the queue but not yet sent to the free list.
+static void audio_streamer_release(audio_chunk_t **chunk) {
+  if (*chunk) {
+    xQueueSend(s_free, chunk, 0);
+    *chunk = NULL;
+  }
+}
+
+// Opens a connected UDP socket to "host:port", optionally prefixed with
+// "rtp://" or "udp://". Returns -1 on failure.
+static int audio_streamer_rtp_open(const char *url) {
+  if (strncmp(url, "rtp://", 6) == 0 || strncmp(url, "udp://", 6) == 0) {
+    url += 6;
+  }
+  const char *colon = strrchr(url, ':');
+  if (!colon || colon == url || colon[1] == '\0' ||
+      (size_t)(colon - url) >= STREAM_RTP_HOST_MAX) {
+    ESP_LOGE(TAG, "RTP target must be host:port, got \"%s\"", url);
+    return -1;
+  }
+  char host[STREAM_RTP_HOST_MAX];
+  memcpy(host, url, colon - url);
+  host[colon - url] = '\0';
+
+  const struct addrinfo hints = {
+      .ai_family = AF_INET,
+      .ai_socktype = SOCK_DGRAM,
+  };
+  struct addrinfo *res = NULL;
+  if (getaddrinfo(host, colon + 1, &hints, &res) != 0 || !res) {
+    ESP_LOGW(TAG, "RTP target %s did not resolve", host);
+    return -1;
+  }
+  int sock = socket(res->ai_family, res->ai_socktype, 0);
+  if (sock >= 0 && connect(sock, res->ai_addr, res->ai_addrlen) != 0) {
+    close(sock);
+    sock = -1;
+  }
+  freeaddrinfo(res);
+  if (sock < 0) {
+    ESP_LOGW(TAG, "RTP socket failed: errno %d", errno);
+    return -1;
+  }
+  metrics_counter_inc(&s_push_connects);
+  ESP_LOGI(TAG, "RTP stream to %s:%s", host, colon + 1);
+  return sock;
+}
+
+static void audio_streamer_rtp_close(void) {
+  if (s_rtp_sock >= 0) {
+    close(s_rtp_sock);
+    s_rtp_sock = -1;
+  }
+}
+
+// Never blocks: a packet the stack has no room for is dropped, as a late
+// one would be by the receiver anyway.
+static void audio_streamer_rtp_send(const rtp_packet *pkt, void *ctx) {
+  (void)ctx;
+  if (send(s_rtp_sock, pkt->data, pkt->len, MSG_DONTWAIT) < 0) {
+    metrics_counter_inc(&s_rtp_dropped);
+    return;
+  }
+  metrics_counter_inc(&s_rtp_packets);
+  metrics_counter_add(&s_rtp_bytes, pkt->len);
+}
+
+// Full CPU clock while a frame is encoded and sent, never while the task
+// waits for audio; NULL without CONFIG_PM_ENABLE.
+static esp_pm_lock_handle_t s_pm_lock = NULL;
+
+static inline void audio_streamer_pm_acquire(void) {
+  if (s_pm_lock) {
+    esp_pm_lock_acquire(s_pm_lock);
+  }
+}
+
+static inline void audio_streamer_pm_release(void) {
+  if (s_pm_lock) {
+    esp_pm_lock_release(s_pm_lock);
+  }
+}
+
+// One pass of the RTP mode: packetizes the queued chunks as they arrive.
+// Unlike the HTTP upload there is nothing to restart at a gap; the
+// packetizer marks it and the receiver sees the missing sequence numbers.
+static void audio_streamer_rtp_step(const audio_config_t *cfg, bool reopen,
+                                    uint32_t *backoff_ms) {
+  if (s_rtp_sock >= 0 && reopen) {
+    audio_streamer_rtp_close();
+  }
+  if (s_rtp_sock < 0) {
+    s_rtp_sock = audio_streamer_rtp_open(cfg->upload_url);
+    if (s_rtp_sock < 0) {
+      audio_streamer_drain_queue();
+      audio_streamer_backoff(backoff_ms);
+      return;
+    }
+    *backoff_ms = STREAM_RETRY_MS;
+    audio_stream_layout_t layout;
+    audio_streamer_config_layout(cfg, &layout);
+    const bool adpcm = layout.format == AUDIO_STREAM_ADPCM;
+    uint8_t pt = RTP_PT_L16_DYNAMIC;
+    if (adpcm) {
+      pt = RTP_PT_ADPCM_DYNAMIC;
+    } else if (layout.sample_rate == 44100) {
+      pt = layout.channels == 2 ? RTP_PT_L16_44100_STEREO
+                                : RTP_PT_L16_44100_MONO;
+    }
+    audio_shaper_init(&s_rtp_shaper, layout.channel_mode, layout.decimation);
+    rtp_packetizer_init(&s_rtp, pt, esp_random(), adpcm, layout.channels);
+  }
+
+  audio_chunk_t *chunk = NULL;
+  if (xQueueReceive(s_queue, &chunk, pdMS_TO_TICKS(500)) != pdTRUE) {
+    // Stalled input: what is packed so far should not wait for it.
+    rtp_packetizer_flush(&s_rtp, audio_streamer_rtp_send, NULL);
+    return;
+  }
+  audio_streamer_pm_acquire();
+  // The RTP clock runs at the stream rate, one tick per shaped frame.
+  audio_shaper *sh = &s_rtp_shaper;
+  const size_t frames = chunk->bytes / STREAM_FRAME_BYTES;
+  const uint64_t tick = (chunk->sample_index + sh->decimation - 1) /
+                        (uint64_t)sh->decimation;
+  const int16_t *pcm = chunk->data;
+  size_t made = frames;
+  if (!audio_shaper_is_identity(sh)) {
+    made = audio_shaper_run(sh, chunk->data, frames, chunk->sample_index,
+                            s_rtp_shaped);
+    pcm = s_rtp_shaped;
+  }
+  const uint32_t gaps = s_rtp.gaps;
+  rtp_packetizer_push(&s_rtp, pcm, made, tick, audio_streamer_rtp_send, NULL);
+  metrics_counter_add(&s_rtp_gaps, s_rtp.gaps - gaps);
+  audio_streamer_release(&chunk);
+  audio_streamer_pm_release();
+}
+
 static void audio_streamer_task(void *arg) {
   (void)arg;
-  audio_chunk_t chunk = {0};
+  // A chunk that does not continue the stream is held back for the next
+  // connection, so every upload is gap-free from its stamped first frame.
+  audio_chunk_t *held = NULL;
   esp_http_client_handle_t client = NULL;
+  char *const payload = (char *)s_push_frame + STREAM_CHUNK_HDR_MAX;
+  char *const coded = &s_push_coded[STREAM_CHUNK_HDR_MAX];
+  // Fixed per stream, while payload for it is pending.
+  audio_stream_layout_t layout = {0};
+  const size_t capacity = STREAM_PUSH_CHUNKS * STREAM_CHUNK_BYTES;
+  size_t pending = 0;
+  uint64_t payload_index = 0; // sample index of payload[0]
+  uint64_t next_index = 0;    // index the stream continues at
+  uint32_t backoff_ms = STREAM_RETRY_MS;
 
   while (true) {
     audio_config_t cfg = {0};
     bool need_reconnect = false;
     audio_streamer_copy_config(&cfg, &need_reconnect);
+    const bool format_changed = s_format_changed;
+    if (format_changed) {
+      s_format_changed = false;
+      need_reconnect = true;
+    }
 
-    if (!audio_streamer_should_push(&cfg)) {
-      if (client) {
-        esp_http_client_close(client);
-        esp_http_client_cleanup(client);
-        client = NULL;
-      }
-      if (s_queue) {
-        xQueueReset(s_queue);
+    const bool paused = atomic_load(&s_paused);
+    if (!paused && audio_streamer_should_rtp(&cfg)) {
+      audio_streamer_push_release(&client);
+      audio_streamer_release(&held);
+      pending = 0;
+      if (format_changed) {
+        audio_streamer_drain_queue();
       }
-      s_accum_frames = 0;
+      audio_streamer_rtp_step(&cfg, need_reconnect, &backoff_ms);
+      continue;
+    }
+    audio_streamer_rtp_close();
+
+    if (paused || !audio_streamer_should_push(&cfg)) {
+      audio_streamer_push_release(&client);
+      audio_streamer_release(&held);
+      audio_streamer_drain_queue();
+      pending = 0;
+      backoff_ms = STREAM_RETRY_MS;
+      atomic_store_explicit(&s_accum_reset, true, memory_order_release);
       ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(500));
       continue;
     }
 
+    if (format_changed) {
+      // Queued audio was captured at the old rate.
+      audio_streamer_release(&held);
+      audio_streamer_drain_queue();
+      pending = 0;
+    }
     if (client && need_reconnect) {
-      esp_http_client_close(client);
-      esp_http_client_cleanup(client);
-      client = NULL;
-      if (s_queue) {
-        xQueueReset(s_queue);
-      }
-      s_accum_frames = 0;
+      audio_streamer_disconnect(&client, true);
     }
 
     if (!client) {
-      esp_http_client_config_t http_cfg = {
-          .url = cfg.upload_url,
-          .method = HTTP_METHOD_POST,
-          .timeout_ms = 5000,
-      };
-      client = esp_http_client_init(&http_cfg);
-      if (!client) {
-        ESP_LOGE(TAG, "Failed to init http client");
-        vTaskDelay(pdMS_TO_TICKS(STREAM_RETRY_MS));
+      // The queue and any unsent payload are kept across reconnects; once
+      // the queue is full the tap callback drops the newest chunks.
+      // A new connection is a new WAV stream; the encoder starts over. Its
+      // header is stamped with the first frame it will carry, so wait for
+      // one.
+      if (pending == 0 && !held &&
+          xQueueReceive(s_queue, &held, pdMS_TO_TICKS(500)) != pdTRUE) {
         continue;
       }
-      esp_http_client_set_header(client, "Content-Type", "audio/wav");
-      esp_http_client_set_header(client, "Transfer-Encoding", "chunked");
-
-      esp_err_t err = esp_http_client_open(client, 0);
-      if (err != ESP_OK) {
-        ESP_LOGW(TAG, "HTTP open failed: %s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
-        client = NULL;
-        vTaskDelay(pdMS_TO_TICKS(STREAM_RETRY_MS));
-        continue;
+      if (pending == 0) {
+        audio_streamer_config_layout(&cfg, &layout);
+        audio_shaper_init(&s_push_shaper, layout.channel_mode,
+                          layout.decimation);
+        next_index = held->sample_index;
       }
-
-      uint8_t wav_header[44] = {0};
-      audio_wav_build_header(wav_header, s_sample_rate);
-      int written = esp_http_client_write(client, (const char *)wav_header,
-                                           sizeof(wav_header));
-      if (written <= 0) {
-        ESP_LOGW(TAG, "Failed to send WAV header");
-        esp_http_client_close(client);
-        esp_http_client_cleanup(client);
-        client = NULL;
-        vTaskDelay(pdMS_TO_TICKS(STREAM_RETRY_MS));
+      const uint64_t start =
+          pending ? payload_index
+                  : audio_shaper_out_index(&s_push_shaper, held->sample_index);
+      ima_adpcm_init(&s_push_enc, layout.channels);
+      client = audio_streamer_connect(&cfg, &layout, start);
+      if (!client) {
+        audio_streamer_backoff(&backoff_ms);
         continue;
       }
     }
 
-    if (xQueueReceive(s_queue, &chunk, pdMS_TO_TICKS(500)) == pdTRUE) {
-      int written =
-          esp_http_client_write(client, (const char *)chunk.data, chunk.bytes);
-      if (written <= 0) {
-        ESP_LOGW(TAG, "HTTP write failed");
-        esp_http_client_close(client);
-        esp_http_client_cleanup(client);
-        client = NULL;
-        vTaskDelay(pdMS_TO_TICKS(STREAM_RETRY_MS));
+    // Coalesce: block for the first chunk, then linger briefly for more.
+    TickType_t wait = pending || held ? 0 : pdMS_TO_TICKS(500);
+    bool lingering = false;
+    bool gap = false;
+    TickType_t deadline = 0;
+    const size_t frame_bytes = layout.channels * sizeof(int16_t);
+    const size_t chunk_out =
+        audio_shaper_max_out(&s_push_shaper, STREAM_CHUNK_FRAMES) * frame_bytes;
+    while (pending + chunk_out <= capacity) {
+      if (!held) {
+        if (xQueueReceive(s_queue, &held, wait) != pdTRUE) {
+          break;
+        }
+        TRACE_INSTANT(TRACE_CHUNK_QUEUE_RECEIVE,
+                      (uint32_t)held->sample_index);
+      }
+      if (held->sample_index != next_index) {
+        // Dropped or reset audio: the rest goes out on a new connection.
+        gap = true;
+        break;
       }
+      // Shaping into the payload (a plain copy for full-rate stereo) is the
+      // only copy a chunk sees after the tap callback; the chunk goes
+      // straight back to the pool.
+      if (pending == 0) {
+        payload_index =
+            audio_shaper_out_index(&s_push_shaper, held->sample_index);
+      }
+      const size_t frames = held->bytes / STREAM_FRAME_BYTES;
+      pending += audio_shaper_run(&s_push_shaper, held->data, frames,
+                                  held->sample_index,
+                                  (int16_t *)(payload + pending)) *
+                 frame_bytes;
+      next_index += frames;
+      audio_streamer_release(&held);
+      if (!lingering) {
+        lingering = true;
+        deadline = xTaskGetTickCount() + pdMS_TO_TICKS(STREAM_PUSH_LINGER_MS);
+      }
+      const int32_t left = (int32_t)(deadline - xTaskGetTickCount());
+      wait = left > 0 ? (TickType_t)left : 0;
+    }
+    if (pending == 0 && !gap) {
+      continue;
+    }
+
+    // ADPCM frames only carry whole blocks; frames short of one stay in the
+    // encoder for the next write.
+    audio_streamer_pm_acquire();
+    char *frame = payload;
+    size_t frame_len = pending;
+    if (layout.format == AUDIO_STREAM_ADPCM) {
+      frame = coded;
+      frame_len = ima_adpcm_encode(&s_push_enc, (const int16_t *)payload,
+                                   pending / frame_bytes, (uint8_t *)coded);
+    }
+    const int64_t write_start = esp_timer_get_time();
+    TRACE_BEGIN(TRACE_HTTP_WRITE, frame_len);
+    const bool written =
+        frame_len == 0 || audio_streamer_write_frame(client, frame, frame_len);
+    TRACE_END(TRACE_HTTP_WRITE, frame_len);
+    audio_streamer_pm_release();
+    if (!written) {
+      ESP_LOGW(TAG, "HTTP write failed, reconnecting in %lu ms",
+               (unsigned long)backoff_ms);
+      audio_streamer_disconnect(&client, false);
+      audio_streamer_backoff(&backoff_ms);
+      continue;
+    }
+    if (frame_len > 0) {
+      metrics_histogram_observe(&s_push_write_us,
+                                (uint32_t)(esp_timer_get_time() - write_start));
+      metrics_counter_inc(&s_push_writes);
+      metrics_counter_add(&s_push_bytes, frame_len);
     }
+    pending = 0;
+    backoff_ms = STREAM_RETRY_MS;
+    if (gap) {
+      metrics_counter_inc(&s_push_gaps);
+      audio_streamer_disconnect(&client, true);
+    }
+  }
+}
+
+// Fields a connected push or RTP stream is built from. Turning the stream
+// on or off and the capture rate (see audio_streamer_on_mic_config) do not
+// need a new connection.
+#define STREAM_RECONNECT_FIELDS                                                \
+  (AUDIO_CONFIG_MODE | AUDIO_CONFIG_UPLOAD_URL | AUDIO_CONFIG_FORMAT |         \
+   AUDIO_CONFIG_CHANNELS | AUDIO_CONFIG_DECIMATION)
+
+static void audio_streamer_on_config(const audio_config_t *config,
+                                     uint32_t changed, void *ctx) {
+  (void)ctx;
+  if (!s_cfg_mutex) {
+    return;
+  }
+
+  // Only a short copy holds the mutex; a diff skipped here would be lost.
+  xSemaphoreTake(s_cfg_mutex, portMAX_DELAY);
+  s_config = *config;
+  s_push_enabled = audio_streamer_should_push(&s_config);
+  s_rtp_enabled = audio_streamer_should_rtp(&s_config);
+  s_pull_enabled = audio_streamer_should_pull(&s_config);
+  if (changed & STREAM_RECONNECT_FIELDS) {
+    s_need_reconnect = true;
+  }
+
+  ESP_LOGI(TAG, "Config updated: mode=%s, format=%s, enabled=%d, push=%d, pull=%d, reconnect=%d",
+           s_config.mode, s_config.format, s_config.enabled, s_push_enabled, s_pull_enabled,
+           (changed & STREAM_RECONNECT_FIELDS) != 0);
+
+  xSemaphoreGive(s_cfg_mutex);
+
+  const bool sending = s_push_enabled || s_rtp_enabled;
+  if (sending != s_radio_held) {
+    s_radio_held = sending;
+    wifi_perf_stream_hold(sending);
+  }
+
+  bool active = s_push_enabled || s_rtp_enabled || s_pull_enabled;
+  if (active != mic_subscription_enabled(s_tap_sub)) {
+    // A stale partial chunk is dropped on the next enable; the reader owns
+    // s_accum, so it is cleared there rather than here.
+    atomic_store_explicit(&s_accum_reset, true, memory_order_release);
+    mic_subscription_set_enabled(s_tap_sub, active);
+  }
+
+  if (s_task) {
+    xTaskNotifyGive(s_task);
   }
 }
 
@@ -219,59 +916,87 @@ void audio_streamer_init(void) {
 
   ESP_LOGI(TAG, "Initializing audio streamer: tap_size=%d, sample_rate=%d", s_tap_size, s_sample_rate);
 
+  for (size_t i = 0; i < sizeof(s_counters) / sizeof(s_counters[0]); i++) {
+    metrics_register(&s_counters[i]->base);
+  }
+  metrics_register(&s_push_write_us.base);
+
   s_cfg_mutex = xSemaphoreCreateMutex();
   s_pull_mutex = xSemaphoreCreateMutex();
-  s_queue = xQueueCreate(STREAM_QUEUE_LENGTH, sizeof(audio_chunk_t));
-  s_pull_stream = xStreamBufferCreate(PULL_STREAM_BUFFER_BYTES, 1);
+  s_queue = xQueueCreate(STREAM_POOL_CHUNKS, sizeof(audio_chunk_t *));
+  s_free = xQueueCreate(STREAM_POOL_CHUNKS, sizeof(audio_chunk_t *));
+  s_pool = audio_arena_alloc(AUDIO_ARENA_LARGE,
+                             STREAM_POOL_CHUNKS * sizeof(audio_chunk_t),
+                             "stream_pool");
+  s_pull_ring = audio_arena_alloc(AUDIO_ARENA_LARGE,
+                                  PULL_RING_CHUNKS * sizeof(s_pull_ring[0]),
+                                  "pull_ring");
+  if (!s_pool || !s_pull_ring) {
+    ESP_LOGE(TAG, "Failed to allocate the chunk pool");
+    return;
+  }
+  s_accum_chunk = &s_pool[0];
+  audio_accum_init(&s_accum, s_accum_chunk->data, STREAM_CHUNK_FRAMES);
+  if (s_free) {
+    for (int i = 1; i < STREAM_POOL_CHUNKS; i++) {
+      audio_chunk_t *chunk = &s_pool[i];
+      xQueueSend(s_free, &chunk, 0);
+    }
+  }
+  bool clients_ok = true;
+  for (int i = 0; i < PULL_MAX_CLIENTS; i++) {
+    s_pull_clients[i].ready = xSemaphoreCreateBinary();
+    clients_ok = clients_ok && s_pull_clients[i].ready;
+  }
   
-  ESP_LOGI(TAG, "Created objects: mutex=%p, pull_mutex=%p, queue=%p, stream=%p",
-           (void*)s_cfg_mutex, (void*)s_pull_mutex, (void*)s_queue, (void*)s_pull_stream);
+  ESP_LOGI(TAG, "Created objects: mutex=%p, pull_mutex=%p, queue=%p, pull clients=%d",
+           (void*)s_cfg_mutex, (void*)s_pull_mutex, (void*)s_queue, PULL_MAX_CLIENTS);
   
-  if (!s_cfg_mutex || !s_pull_mutex || !s_queue || !s_pull_stream) {
+  if (!s_cfg_mutex || !s_pull_mutex || !s_queue || !s_free || !clients_ok) {
     ESP_LOGE(TAG, "Failed to create synchronization objects");
   }
   
-  audio_config_t cfg_init = audio_config_get();
-  s_config = cfg_init;
+  audio_config_get(&s_config);
   s_push_enabled = audio_streamer_should_push(&s_config);
+  s_rtp_enabled = audio_streamer_should_rtp(&s_config);
   s_pull_enabled = audio_streamer_should_pull(&s_config);
   s_need_reconnect = true;
 
-  ESP_LOGI(TAG, "Audio config: mode=%s, enabled=%d, push=%d, pull=%d", 
-           s_config.mode, s_config.enabled, s_push_enabled, s_pull_enabled);
+  ESP_LOGI(TAG, "Audio config: mode=%s, format=%s, enabled=%d, push=%d, pull=%d", 
+           s_config.mode, s_config.format, s_config.enabled, s_push_enabled, s_pull_enabled);
 
-  if (!mic_add_tap_callback(audio_streamer_on_tap, NULL)) {
-    ESP_LOGE(TAG, "Failed to add microphone tap callback; audio streaming may not receive data from the microphone");
+  // The subscription only runs while pushing or pulling; idle streaming
+  // costs the mic reader nothing.
+  const mic_subscriber_cfg sub_cfg = {
+      .cb = audio_streamer_on_tap,
+      .name = "streamer",
+      .batch_taps = STREAM_BATCH_TAPS,
+      .enabled = s_push_enabled || s_rtp_enabled || s_pull_enabled,
+  };
+  s_tap_sub = mic_subscribe(&sub_cfg);
+  if (!s_tap_sub) {
+    ESP_LOGE(TAG, "Failed to subscribe to microphone taps; audio streaming may not receive data from the microphone");
   }
-
-  xTaskCreatePinnedToCore(audio_streamer_task, "audio_stream",
-                          STREAM_TASK_STACK, NULL, STREAM_TASK_PRIO, &s_task, 0);
-}
-
-void audio_streamer_apply_config(const audio_config_t *config) {
-  if (!config || !s_cfg_mutex) {
-    return;
+  s_format_epoch = mic_config_epoch();
+  if (!mic_add_config_listener(audio_streamer_on_mic_config, NULL)) {
+    ESP_LOGE(TAG, "Failed to register mic config listener; a runtime sample rate change will not restart the stream");
   }
 
-  if (xSemaphoreTake(s_cfg_mutex, pdMS_TO_TICKS(20)) == pdTRUE) {
-    s_config = *config;
-    s_push_enabled = audio_streamer_should_push(&s_config);
-    s_pull_enabled = audio_streamer_should_pull(&s_config);
-    s_need_reconnect = true;
-    
-    ESP_LOGI(TAG, "Config updated: mode=%s, enabled=%d, push=%d, pull=%d", 
-             s_config.mode, s_config.enabled, s_push_enabled, s_pull_enabled);
-    
-    xSemaphoreGive(s_cfg_mutex);
-  } else {
-    ESP_LOGW(TAG, "Config update skipped (busy)");
-    return;
+  if (!audio_config_subscribe(audio_streamer_on_config, NULL)) {
+    ESP_LOGE(TAG, "Failed to subscribe to audio config; changes apply after a reboot");
   }
 
-  if (!s_pull_enabled && s_pull_stream) {
-    xStreamBufferReset(s_pull_stream);
+  if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "audio_stream",
+                         &s_pm_lock) != ESP_OK) {
+    s_pm_lock = NULL;
   }
+  xTaskCreatePinnedToCore(audio_streamer_task, "audio_stream",
+                          STREAM_TASK_STACK, NULL, STREAM_TASK_PRIO, &s_task,
+                          STREAM_TASK_CORE);
+}
 
+void audio_streamer_pause(bool paused) {
+  atomic_store(&s_paused, paused);
   if (s_task) {
     xTaskNotifyGive(s_task);
   }
@@ -281,55 +1006,299 @@ bool audio_streamer_pull_enabled(void) {
   return s_pull_enabled;
 }
 
-bool audio_streamer_pull_claim(void) {
+audio_pull_client *audio_streamer_pull_open(void) {
   if (!s_pull_mutex) {
-    return false;
+    return NULL;
   }
+  audio_stream_layout_t layout;
+  audio_streamer_current_layout(&layout);
   if (xSemaphoreTake(s_pull_mutex, portMAX_DELAY) != pdTRUE) {
-    return false;
+    return NULL;
   }
-  if (s_pull_in_use) {
-    xSemaphoreGive(s_pull_mutex);
-    return false;
+  audio_pull_client *client = NULL;
+  for (int i = 0; i < PULL_MAX_CLIENTS; i++) {
+    if (!atomic_load(&s_pull_clients[i].active) && s_pull_clients[i].ready) {
+      client = &s_pull_clients[i];
+      break;
+    }
   }
-  s_pull_in_use = true;
-  if (s_pull_stream) {
-    xStreamBufferReset(s_pull_stream);
+  if (client) {
+    atomic_store(&client->seq,
+                 atomic_load_explicit(&s_pull_head, memory_order_acquire));
+    client->offset = 0;
+    client->read_bytes = 0;
+    client->overruns = 0;
+    client->skipped_chunks = 0;
+    client->held_chunks = 0;
+    client->layout = layout;
+    audio_shaper_init(&client->shaper, layout.channel_mode, layout.decimation);
+    ima_adpcm_init(&client->enc, layout.channels);
+    client->next_index = 0;
+    // Drop a wake-up left over from the previous client in this slot.
+    xSemaphoreTake(client->ready, 0);
+    atomic_store(&client->active, true);
   }
   xSemaphoreGive(s_pull_mutex);
-  return true;
+  if (client) {
+    wifi_perf_stream_hold(true);
+  }
+  return client;
 }
 
-void audio_streamer_pull_release(void) {
-  if (!s_pull_mutex) {
+void audio_streamer_pull_close(audio_pull_client *client) {
+  if (!client || !s_pull_mutex) {
     return;
   }
   if (xSemaphoreTake(s_pull_mutex, portMAX_DELAY) == pdTRUE) {
-    s_pull_in_use = false;
+    const bool was_active = atomic_exchange(&client->active, false);
     xSemaphoreGive(s_pull_mutex);
+    if (was_active) {
+      wifi_perf_stream_hold(false);
+    }
   }
 }
 
-size_t audio_streamer_pull_read(uint8_t *buf, size_t len, TickType_t timeout) {
-  if (!s_pull_stream || !buf || len == 0) {
+// Moves a lapped client to the live edge, so it costs the writer and the
+// other clients nothing. Only reachable with drop-oldest. A partly encoded
+// ADPCM block or filter history would straddle the gap (or hold torn
+// samples) and is dropped.
+static void audio_streamer_pull_skip(audio_pull_client *client,
+                                     uint32_t from) {
+  const uint32_t head =
+      atomic_load_explicit(&s_pull_head, memory_order_acquire);
+  client->overruns++;
+  client->skipped_chunks += head - from;
+  client->offset = 0;
+  ima_adpcm_reset(&client->enc);
+  audio_shaper_reset(&client->shaper);
+  atomic_store_explicit(&client->seq, head, memory_order_release);
+  metrics_counter_add(&s_pull_drop_oldest, head - from);
+}
+
+size_t audio_streamer_pull_read(audio_pull_client *client, uint8_t *buf,
+                                size_t len, TickType_t timeout,
+                                uint64_t *first_index) {
+  if (!client || !buf) {
+    return 0;
+  }
+  // Ring bytes to take: whole frames only, so skipping ahead never splits a
+  // frame, and no more than shape into `len` (ADPCM: encode into it).
+  audio_shaper *sh = &client->shaper;
+  const bool adpcm = client->layout.format == AUDIO_STREAM_ADPCM;
+  const bool identity = audio_shaper_is_identity(sh);
+  const size_t out_frame_bytes = (size_t)sh->channels * sizeof(int16_t);
+  const size_t out_frames =
+      adpcm ? (len / IMA_ADPCM_BLOCK_BYTES) * (size_t)client->enc.block_frames
+            : len / out_frame_bytes;
+  const size_t want =
+      out_frames * (size_t)sh->decimation * STREAM_FRAME_BYTES;
+  if (want == 0) {
+    return 0;
+  }
+  metrics_counter_inc(&s_read_calls);
+
+  // Only this client's task moves its cursor.
+  const uint32_t first =
+      atomic_load_explicit(&client->seq, memory_order_relaxed);
+  uint32_t head = atomic_load_explicit(&s_pull_head, memory_order_acquire);
+  if (head == first) {
+    xSemaphoreTake(client->ready, timeout);
+    head = atomic_load_explicit(&s_pull_head, memory_order_acquire);
+  }
+  if (head == first) {
+    return 0;
+  }
+  // The writer's next slot is the oldest one, so one chunk less than the
+  // ring is readable.
+  if (head - first > PULL_RING_CHUNKS - 1) {
+    audio_streamer_pull_skip(client, first);
+    return 0;
+  }
+
+  // One read covers consecutive samples only: it stops where the ring's
+  // indices jump (chunks dropped before they reached the ring), so the
+  // first index stamps all of it.
+  uint32_t seq = first;
+  size_t offset = client->offset;
+  size_t used = 0;
+  size_t got = 0;
+  const uint64_t start = s_pull_index[first & (PULL_RING_CHUNKS - 1)] +
+                         offset / STREAM_FRAME_BYTES;
+  uint64_t block_index = client->enc_index;
+  if (adpcm && client->enc.frames > 0 && start != client->next_index) {
+    ima_adpcm_reset(&client->enc); // the partial block would straddle a gap
+  }
+  if (adpcm && client->enc.frames == 0) {
+    block_index = audio_shaper_out_index(sh, start);
+  }
+  uint64_t expect = start - offset / STREAM_FRAME_BYTES;
+  while (used < want && seq != head) {
+    if (s_pull_index[seq & (PULL_RING_CHUNKS - 1)] != expect) {
+      break;
+    }
+    size_t n = STREAM_CHUNK_BYTES - offset;
+    if (n > want - used) {
+      n = want - used;
+    }
+    const int16_t *src =
+        &s_pull_ring[seq & (PULL_RING_CHUNKS - 1)][offset / sizeof(int16_t)];
+    size_t made = n / STREAM_FRAME_BYTES;
+    if (!identity) {
+      made = audio_shaper_run(sh, src, made,
+                              expect + offset / STREAM_FRAME_BYTES,
+                              client->shaped);
+      src = client->shaped;
+    }
+    if (adpcm) {
+      got += ima_adpcm_encode(&client->enc, src, made, buf + got);
+    } else {
+      memcpy(buf + got, src, made * out_frame_bytes);
+      got += made * out_frame_bytes;
+    }
+    used += n;
+    offset += n;
+    if (offset == STREAM_CHUNK_BYTES) {
+      offset = 0;
+      seq++;
+      expect += STREAM_CHUNK_FRAMES;
+    }
+  }
+
+  // The samples read are intact unless the writer has since started on the
+  // sequence that reuses the slot of `first`.
+  atomic_thread_fence(memory_order_acquire);
+  const uint32_t writing =
+      atomic_load_explicit(&s_pull_writing, memory_order_relaxed);
+  if (writing - first > PULL_RING_CHUNKS) {
+    audio_streamer_pull_skip(client, first);
     return 0;
   }
-  s_read_calls++;
-  size_t got = xStreamBufferReceive(s_pull_stream, buf, len, timeout);
-  s_read_bytes += got;
+
+  client->offset = offset;
+  atomic_store_explicit(&client->seq, seq, memory_order_release);
+  client->next_index = start + used / STREAM_FRAME_BYTES;
+  if (adpcm) {
+    // Blocks out of this read begin at the frame the encoder held first.
+    client->enc_index = audio_shaper_out_index(sh, client->next_index) -
+                        (uint64_t)client->enc.frames * sh->decimation;
+  }
+  if (first_index) {
+    *first_index = adpcm ? block_index : audio_shaper_out_index(sh, start);
+  }
+  client->read_bytes += got;
+  metrics_counter_add(&s_read_bytes, got);
   return got;
 }
 
+bool audio_streamer_pull_stamp(audio_pull_client *client,
+                               audio_wav_stamp *out, TickType_t timeout) {
+  if (!client || !out) {
+    return false;
+  }
+  const uint32_t seq = atomic_load_explicit(&client->seq, memory_order_relaxed);
+  if (atomic_load_explicit(&s_pull_head, memory_order_acquire) == seq) {
+    xSemaphoreTake(client->ready, timeout);
+  }
+  const uint32_t head = atomic_load_explicit(&s_pull_head, memory_order_acquire);
+  if (head == seq || head - seq > PULL_RING_CHUNKS - 1) {
+    return false;
+  }
+  const uint64_t index = s_pull_index[seq & (PULL_RING_CHUNKS - 1)];
+  // Lapped while reading the slot: the index may belong to a newer chunk.
+  atomic_thread_fence(memory_order_acquire);
+  if (atomic_load_explicit(&s_pull_writing, memory_order_relaxed) - seq >
+      PULL_RING_CHUNKS) {
+    return false;
+  }
+  audio_streamer_stamp(
+      audio_shaper_out_index(&client->shaper,
+                             index + client->offset / STREAM_FRAME_BYTES),
+      out);
+  return true;
+}
+
 int audio_streamer_sample_rate(void) {
   return s_sample_rate;
 }
 
+bool audio_streamer_parse_format(const char *name,
+                                 audio_stream_format_t *out) {
+  if (name == NULL) {
+    return false;
+  }
+  if (strcmp(name, "pcm") == 0 || name[0] == '\0') {
+    *out = AUDIO_STREAM_PCM;
+    return true;
+  }
+  if (strcmp(name, "adpcm") == 0) {
+    *out = AUDIO_STREAM_ADPCM;
+    return true;
+  }
+  return false;
+}
+
+audio_stream_layout_t audio_streamer_pull_layout(
+    const audio_pull_client *client) {
+  audio_stream_layout_t layout;
+  if (client) {
+    return client->layout;
+  }
+  audio_streamer_current_layout(&layout);
+  return layout;
+}
+
+size_t audio_streamer_build_header(const audio_stream_layout_t *layout,
+                                   const audio_wav_stamp *stamp,
+                                   uint8_t *out) {
+  if (layout->format == AUDIO_STREAM_ADPCM) {
+    return audio_wav_build_adpcm_header(
+        out, layout->sample_rate, layout->channels, IMA_ADPCM_BLOCK_BYTES,
+        IMA_ADPCM_BLOCK_FRAMES(layout->channels), stamp);
+  }
+  return audio_wav_build_header(out, layout->sample_rate, layout->channels,
+                                stamp);
+}
+
+uint32_t audio_streamer_format_epoch(void) {
+  return s_format_epoch;
+}
+
 void audio_streamer_get_stats(audio_streamer_stats_t *stats) {
   if (!stats) return;
-  stats->tap_calls = s_tap_calls;
-  stats->stream_writes = s_stream_writes;
-  stats->send_failed = s_send_failed;
-  stats->read_calls = s_read_calls;
-  stats->read_bytes = s_read_bytes;
+  stats->tap_calls = metrics_counter_read32(&s_tap_calls);
+  stats->stream_writes = metrics_counter_read32(&s_stream_writes);
+  stats->pull_drop_oldest = metrics_counter_read32(&s_pull_drop_oldest);
+  stats->pull_drop_newest = metrics_counter_read32(&s_pull_drop_newest);
+  stats->send_failed = stats->pull_drop_oldest + stats->pull_drop_newest;
+  stats->read_calls = metrics_counter_read32(&s_read_calls);
+  stats->read_bytes = metrics_counter_read32(&s_read_bytes);
   stats->pull_enabled = s_pull_enabled;
+  stats->push_writes = metrics_counter_read32(&s_push_writes);
+  stats->push_bytes = metrics_counter_read32(&s_push_bytes);
+  stats->push_connects = metrics_counter_read32(&s_push_connects);
+  stats->push_dropped = metrics_counter_read32(&s_push_dropped);
+  stats->push_gaps = metrics_counter_read32(&s_push_gaps);
+  stats->rtp_packets = metrics_counter_read32(&s_rtp_packets);
+  stats->rtp_bytes = metrics_counter_read32(&s_rtp_bytes);
+  stats->rtp_dropped = metrics_counter_read32(&s_rtp_dropped);
+  stats->rtp_gaps = metrics_counter_read32(&s_rtp_gaps);
+  audio_streamer_current_layout(&stats->layout);
+  for (int i = 0; i < PULL_MAX_CLIENTS; i++) {
+    const audio_pull_client *client = &s_pull_clients[i];
+    stats->pull_clients[i].active = atomic_load(&client->active);
+    stats->pull_clients[i].read_bytes = client->read_bytes;
+    stats->pull_clients[i].overruns = client->overruns;
+    stats->pull_clients[i].skipped_chunks = client->skipped_chunks;
+    stats->pull_clients[i].held_chunks = client->held_chunks;
+  }
+}
+
+#ifdef AUDIO_STREAMER_TESTING
+void audio_streamer_test_on_tap(const mic_tap_view *tap) {
+  if (s_accum_chunk == NULL) {
+    s_accum_chunk = &s_pool[0];
+    audio_accum_init(&s_accum, s_accum_chunk->data, STREAM_CHUNK_FRAMES);
+  }
+  audio_streamer_on_tap(tap, NULL);
 }
+#endif
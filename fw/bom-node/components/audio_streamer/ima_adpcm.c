@@ -0,0 +1,112 @@
+#include "ima_adpcm.h"
+
+#include <string.h>
+
+static const int16_t step_table[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,
+    19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+    337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+    876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+    5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int8_t index_table[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+void ima_adpcm_init(ima_adpcm_encoder *enc, int channels) {
+  memset(enc, 0, sizeof(*enc));
+  enc->channels = channels == 1 ? 1 : 2;
+  enc->block_frames = IMA_ADPCM_BLOCK_FRAMES(enc->channels);
+}
+
+void ima_adpcm_reset(ima_adpcm_encoder *enc) {
+  ima_adpcm_init(enc, enc->channels);
+}
+
+// One 4-bit code, updating the channel's predictor the same way the decoder
+// will, so encoder and decoder never drift apart.
+static inline uint8_t encode_sample(ima_adpcm_encoder *enc, int ch,
+                                    int32_t sample) {
+  int32_t step = step_table[enc->index[ch]];
+  int32_t diff = sample - enc->predictor[ch];
+  uint8_t code = 0;
+  if (diff < 0) {
+    code = 8;
+    diff = -diff;
+  }
+
+  int32_t delta = step >> 3;
+  if (diff >= step) {
+    code |= 4;
+    diff -= step;
+    delta += step;
+  }
+  step >>= 1;
+  if (diff >= step) {
+    code |= 2;
+    diff -= step;
+    delta += step;
+  }
+  step >>= 1;
+  if (diff >= step) {
+    code |= 1;
+    delta += step;
+  }
+
+  int32_t pred = enc->predictor[ch] + ((code & 8) ? -delta : delta);
+  if (pred > INT16_MAX)
+    pred = INT16_MAX;
+  if (pred < INT16_MIN)
+    pred = INT16_MIN;
+  enc->predictor[ch] = pred;
+
+  int index = enc->index[ch] + index_table[code & 7];
+  if (index < 0)
+    index = 0;
+  if (index > 88)
+    index = 88;
+  enc->index[ch] = (int8_t)index;
+  return code;
+}
+
+size_t ima_adpcm_encode(ima_adpcm_encoder *enc, const int16_t *interleaved,
+                        size_t frames, uint8_t *out) {
+  const int channels = enc->channels;
+  size_t written = 0;
+  for (size_t f = 0; f < frames; f++) {
+    const int16_t *frame = &interleaved[f * channels];
+    if (enc->frames == 0) {
+      // The block header carries the first frame verbatim.
+      for (int ch = 0; ch < channels; ch++) {
+        uint8_t *hdr = &enc->block[4 * ch];
+        enc->predictor[ch] = frame[ch];
+        hdr[0] = (uint8_t)((uint16_t)frame[ch] & 0xff);
+        hdr[1] = (uint8_t)((uint16_t)frame[ch] >> 8);
+        hdr[2] = (uint8_t)enc->index[ch];
+        hdr[3] = 0;
+      }
+    } else {
+      // Eight codes per channel per group, first code in the low nibble.
+      const int i = enc->frames - 1;
+      uint8_t *group = &enc->block[4 * channels + (i >> 3) * 4 * channels];
+      for (int ch = 0; ch < channels; ch++) {
+        const uint8_t code = encode_sample(enc, ch, frame[ch]);
+        uint8_t *byte = &group[4 * ch + ((i & 7) >> 1)];
+        if ((i & 1) == 0) {
+          *byte = code;
+        } else {
+          *byte |= (uint8_t)(code << 4);
+        }
+      }
+    }
+
+    if (++enc->frames == enc->block_frames) {
+      memcpy(out + written, enc->block, IMA_ADPCM_BLOCK_BYTES);
+      written += IMA_ADPCM_BLOCK_BYTES;
+      enc->frames = 0;
+    }
+  }
+  return written;
+}
@@ -0,0 +1,37 @@
+#ifndef AUDIO_ACCUM_H
+#define AUDIO_ACCUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The streamer's accumulation stage: planar mic taps interleaved into
+// fixed-size chunks of consecutive frames. It runs in the tap callback (the
+// reader task), so it never allocates or waits; a full chunk is handed to a
+// callback that returns the buffer to fill next.
+
+typedef struct {
+  int16_t *data;        // chunk being filled, `capacity` stereo frames
+  size_t capacity;
+  size_t frames;        // filled so far
+  uint64_t first_index; // mic sample counter of data[0]
+  uint64_t next_index;  // index the partial chunk continues at
+} audio_accum;
+
+// Takes chunk `data`, whose first frame is mic sample `first_index`, and
+// returns the buffer for the next one (`data` again to refill it).
+typedef int16_t *(*audio_accum_full_fn)(int16_t *data, uint64_t first_index,
+                                        void *ctx);
+
+void audio_accum_init(audio_accum *acc, int16_t *data, size_t capacity);
+
+// Drops the partial chunk.
+static inline void audio_accum_drop(audio_accum *acc) { acc->frames = 0; }
+
+// Appends `length` frames starting at mic sample `index`. A chunk holds
+// consecutive samples only, so its first index stamps all of it: input that
+// does not continue the partial chunk drops it first.
+void audio_accum_push(audio_accum *acc, const int16_t *left,
+                      const int16_t *right, size_t length, uint64_t index,
+                      audio_accum_full_fn full, void *ctx);
+
+#endif
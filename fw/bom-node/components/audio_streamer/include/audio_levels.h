@@ -0,0 +1,79 @@
+#ifndef AUDIO_LEVELS_H
+#define AUDIO_LEVELS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Level-meter summaries of the stereo mic stream: per channel the sum of
+// squares and the peak magnitude over consecutive samples, from which RMS,
+// peak and crest factor are derived. The meter splits the stream into
+// blocks of a fixed number of samples in the tap callback (the reader
+// task), so it never allocates or waits; longer windows are merged from
+// consecutive blocks by whoever serves them.
+
+#define AUDIO_LEVELS_CHANNELS 2 // left, right
+
+typedef struct {
+  uint64_t sum_sq[AUDIO_LEVELS_CHANNELS];
+  uint32_t peak[AUDIO_LEVELS_CHANNELS]; // largest |s|, up to 32768
+  uint32_t samples;                     // per channel
+  uint64_t first_index;                 // mic sample counter of the first
+} audio_levels_sum;
+
+typedef struct {
+  audio_levels_sum cur;   // block being filled
+  uint32_t block_samples; // per channel
+  uint64_t next_index;    // index the partial block continues at
+} audio_levels;
+
+// Takes a completed block; runs inside audio_levels_push().
+typedef void (*audio_levels_block_fn)(const audio_levels_sum *block,
+                                      void *ctx);
+
+void audio_levels_init(audio_levels *lv, uint32_t block_samples);
+
+// Appends `length` samples per channel starting at mic sample `index`.
+// Blocks hold consecutive samples only: input that does not continue the
+// partial block drops it first.
+void audio_levels_push(audio_levels *lv, const int16_t *left,
+                       const int16_t *right, size_t length, uint64_t index,
+                       audio_levels_block_fn full, void *ctx);
+
+// Adds `src` to `dst`, which must then end where `src` starts; an empty
+// `dst` (no samples) takes `src` as it is. Returns false and leaves `dst`
+// unchanged when `src` does not continue it.
+bool audio_levels_merge(audio_levels_sum *dst, const audio_levels_sum *src);
+
+// Levels in hundredths of a dB relative to digital full scale (32768), so a
+// full-scale sine reads -301 RMS and 0 peak. Silence, and anything below,
+// reads AUDIO_LEVELS_SILENT_CDB.
+#define AUDIO_LEVELS_SILENT_CDB (-12000)
+
+int16_t audio_levels_cdb(float magnitude);
+
+/*
+ * Binary frame of one summary, all fields little-endian:
+ *
+ *   0  u8   version (AUDIO_LEVELS_VERSION)
+ *   1  u8   channels (AUDIO_LEVELS_CHANNELS), left first
+ *   2  u16  window length [ms]
+ *   4  u32  summary sequence number; a jump is summaries not delivered
+ *   8  u64  mic sample index of the window's first sample
+ *  16       per channel, i16 each in 0.01 dB FS (audio_levels_cdb()):
+ *           RMS, peak, crest factor (peak - RMS, in dB), detector noise
+ *           floor
+ *
+ * The window length is nominal: a window spans a whole number of the
+ * meter's blocks, and the sample rate rounds their length.
+ */
+#define AUDIO_LEVELS_VERSION 1
+#define AUDIO_LEVELS_FRAME_BYTES (16 + 8 * AUDIO_LEVELS_CHANNELS)
+
+// Writes the frame of `sum` to `out`, with `floor` the noise floor
+// magnitude of each channel; returns AUDIO_LEVELS_FRAME_BYTES.
+size_t audio_levels_encode(const audio_levels_sum *sum,
+                           const uint16_t floor[AUDIO_LEVELS_CHANNELS],
+                           uint32_t seq, uint16_t window_ms, uint8_t *out);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef AUDIO_SHAPER_H
+#define AUDIO_SHAPER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Per-stream channel selection and integer decimation of the interleaved
+// 16-bit stereo mic audio, run by each stream on its own task before
+// encoding.
+//
+// Decimation by M uses a Kaiser-windowed sinc low-pass of
+// AUDIO_SHAPER_TAPS_PER_PHASE * M + 1 taps (about 70 dB stopband from 0.5 of
+// the output rate, flat to about 0.37 of it), evaluated in polyphase form:
+// only every M-th output is computed, so the cost per input frame is the
+// same for every M. Output frames fall on the mic sample indices that are
+// multiples of M; each is labelled with the index at the centre of its
+// filter span, so stamps and sample indices stay exact across the filter
+// delay.
+
+#define AUDIO_SHAPER_MAX_DECIMATION 4
+#define AUDIO_SHAPER_TAPS_PER_PHASE 32
+#define AUDIO_SHAPER_MAX_TAPS                                                  \
+  (AUDIO_SHAPER_TAPS_PER_PHASE * AUDIO_SHAPER_MAX_DECIMATION + 1)
+
+typedef enum {
+  AUDIO_CHANNELS_STEREO = 0,
+  AUDIO_CHANNELS_LEFT = 1,
+  AUDIO_CHANNELS_RIGHT = 2,
+  AUDIO_CHANNELS_MONO = 3, // (left + right) / 2
+} audio_channel_mode;
+
+typedef struct {
+  audio_channel_mode mode;
+  int channels;   // output channels, 1 or 2
+  int decimation; // 1 passes the rate through
+  int taps;       // 0 without decimation
+  int delay;      // filter delay in input frames, (taps - 1) / 2
+  int pos;        // history slot the next frame goes to
+  int phase;      // input frames since the last output, mod decimation
+  bool started;
+  uint64_t next_index; // input index that continues the history
+  int16_t coef[AUDIO_SHAPER_MAX_TAPS]; // Q15, unity DC gain
+  // Each frame is stored twice, `taps` apart, so the newest `taps` frames
+  // are always contiguous.
+  int16_t hist[2][2 * AUDIO_SHAPER_MAX_TAPS];
+} audio_shaper;
+
+// Maps a channel mode name ("stereo", "left", "right", "mono"; empty means
+// stereo). Returns false and leaves `out` alone for an unknown name.
+bool audio_shaper_parse_channels(const char *name, audio_channel_mode *out);
+const char *audio_shaper_channels_name(audio_channel_mode mode);
+
+// Returns false for a decimation outside 1..AUDIO_SHAPER_MAX_DECIMATION.
+bool audio_shaper_init(audio_shaper *sh, audio_channel_mode mode,
+                       int decimation);
+
+// Forgets the filter history, as at a gap in the input.
+void audio_shaper_reset(audio_shaper *sh);
+
+static inline bool audio_shaper_is_identity(const audio_shaper *sh) {
+  return sh->mode == AUDIO_CHANNELS_STEREO && sh->decimation == 1;
+}
+
+// Most output frames `frames` input frames can make.
+static inline size_t audio_shaper_max_out(const audio_shaper *sh,
+                                          size_t frames) {
+  return (frames + sh->decimation - 1) / sh->decimation;
+}
+
+// Label of the first output frame made from input that starts at mic
+// sample `index`.
+uint64_t audio_shaper_out_index(const audio_shaper *sh, uint64_t index);
+
+// Shapes `frames` consecutive input frames, the first of which is mic sample
+// `index`, into `out` (room for audio_shaper_max_out() frames of `channels`
+// samples). Input that does not continue the previous call restarts the
+// filter. Returns the output frames written.
+size_t audio_shaper_run(audio_shaper *sh, const int16_t *interleaved,
+                        size_t frames, uint64_t index, int16_t *out);
+
+#endif
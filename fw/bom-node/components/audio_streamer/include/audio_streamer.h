@@ -1,26 +1,132 @@
 #pragma once
 
 #include "audio_config.h"
+#include "audio_shaper.h"
+#include "audio_wav.h"
 #include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+// Starts the push task and subscribes to audio config changes.
 void audio_streamer_init(void);
-void audio_streamer_apply_config(const audio_config_t *config);
+// Closes the push or RTP stream and drops its audio until unpaused, e.g.
+// while an update is written (ota_set_swap_hook). Pull clients are not
+// affected.
+void audio_streamer_pause(bool paused);
 bool audio_streamer_pull_enabled(void);
-bool audio_streamer_pull_claim(void);
-void audio_streamer_pull_release(void);
-size_t audio_streamer_pull_read(uint8_t *buf, size_t len, TickType_t timeout);
+
+// Stream encodings, selected by audio_config_t.format. The audio is PCM up
+// to the ring; push and each pull client encode on their own task.
+typedef enum {
+  AUDIO_STREAM_PCM = 0,   // WAV format 1, 16-bit stereo
+  AUDIO_STREAM_ADPCM = 1, // WAV format 0x11, IMA ADPCM, about 4:1
+} audio_stream_format_t;
+
+// Maps a format name ("pcm", "adpcm"; empty means pcm). Returns false and
+// leaves `out` alone for an unknown name.
+bool audio_streamer_parse_format(const char *name, audio_stream_format_t *out);
+
+// What one stream carries, fixed when it starts: the encoding, which
+// channels (audio_config_t.channels) and the rate divider
+// (audio_config_t.decimation, see audio_shaper.h). Narrower streams cost
+// less bandwidth and less encoding and sending CPU; the mic and the ring
+// stay stereo at the full rate.
+typedef struct {
+  audio_stream_format_t format;
+  audio_channel_mode channel_mode;
+  int channels;    // 1 or 2
+  int decimation;  // 1..AUDIO_SHAPER_MAX_DECIMATION
+  int sample_rate; // stream rate: mic rate / decimation, rounded down
+} audio_stream_layout_t;
+
+// The layout `config` asks for at the current mic rate; out-of-range
+// settings fall back to stereo at the full rate.
+void audio_streamer_config_layout(const audio_config_t *config,
+                                  audio_stream_layout_t *out);
+
+// Writes the WAV header for `layout` into `out` (room for
+// AUDIO_WAV_STREAM_HEADER_MAX) and returns its length. With a stamp the
+// header records when the first frame was captured. Push uploads are
+// restarted at any gap in the audio, so their stamp holds for the whole
+// upload.
+size_t audio_streamer_build_header(const audio_stream_layout_t *layout,
+                                   const audio_wav_stamp *stamp, uint8_t *out);
+
+// Pull clients read one shared broadcast ring, each at its own cursor. The
+// mic audio is written to the ring once however many clients are attached;
+// the mic callback never waits for a client. What happens when one falls a
+// full ring behind depends on CONFIG_AUDIO_STREAM_PULL_DROP: drop-oldest
+// skips that client ahead to live audio, drop-newest discards incoming
+// chunks until it has caught up.
+typedef struct audio_pull_client audio_pull_client;
+
+// Attaches a client at the live edge of the ring, in the configured layout,
+// which it keeps until closed. Returns NULL when all
+// CONFIG_AUDIO_STREAM_PULL_CLIENTS slots are taken.
+audio_pull_client *audio_streamer_pull_open(void);
+void audio_streamer_pull_close(audio_pull_client *client);
+// The client's layout; the configured one for NULL.
+audio_stream_layout_t audio_streamer_pull_layout(
+    const audio_pull_client *client);
+// Reads up to `len` bytes in the client's layout: whole frames of
+// interleaved 16-bit samples, or whole ADPCM blocks (`len` of at least one
+// block). Waits up to `timeout` when the client has caught up; returns 0 on
+// timeout, after skipping ahead, or while an ADPCM block is still filling.
+// The bytes of one read are consecutive samples; `first_index` (optional)
+// receives the mic sample index of the first frame they hold, so a gap
+// shows up as a jump between reads. With decimation, consecutive frames
+// are `decimation` indices apart.
+size_t audio_streamer_pull_read(audio_pull_client *client, uint8_t *buf,
+                                size_t len, TickType_t timeout,
+                                uint64_t *first_index);
+// Stamps the next frame the client will read, waiting up to `timeout` for
+// it to be captured. Call before the first read to stamp the WAV header; a
+// client that is later skipped ahead (see overruns) loses frames behind
+// that stamp. Returns false on timeout or when the client was lapped.
+bool audio_streamer_pull_stamp(audio_pull_client *client,
+                               audio_wav_stamp *out, TickType_t timeout);
 int audio_streamer_sample_rate(void);
+// Changes whenever the mic is reconfigured; a pull reader that started at an
+// older value is receiving audio that no longer matches its WAV header.
+uint32_t audio_streamer_format_epoch(void);
+
+typedef struct {
+  bool active;
+  uint32_t read_bytes;
+  uint32_t overruns;       // times the client was lapped and skipped ahead
+  uint32_t skipped_chunks; // chunks it never received because of that
+  uint32_t held_chunks;    // drop-newest: chunks discarded while it lagged
+} audio_pull_client_stats_t;
 
 typedef struct {
   uint32_t tap_calls;
-  uint32_t stream_writes;
-  uint32_t send_failed;
+  uint32_t stream_writes; // chunks written to the pull ring
+  uint32_t send_failed;   // pull chunks dropped, under either policy
+  uint32_t pull_drop_oldest; // chunks skipped by lapped clients, summed
+  uint32_t pull_drop_newest; // chunks not written to a full ring
   uint32_t read_calls;
   uint32_t read_bytes;
   bool pull_enabled;
+  uint32_t push_writes;   // coalesced HTTP chunk frames sent
+  uint32_t push_bytes;    // audio payload bytes sent
+  uint32_t push_connects; // successful connections, including reconnects
+  uint32_t push_dropped;  // chunks lost to a full push queue
+  uint32_t push_gaps;     // uploads restarted to keep the stamp exact
+  uint32_t rtp_packets;   // RTP datagrams sent
+  uint32_t rtp_bytes;     // including the RTP headers
+  uint32_t rtp_dropped;   // datagrams the stack had no room for
+  uint32_t rtp_gaps;      // discontinuities marked in the RTP stream
+  audio_stream_layout_t layout; // configured for new streams
+  audio_pull_client_stats_t pull_clients[CONFIG_AUDIO_STREAM_PULL_CLIENTS];
 } audio_streamer_stats_t;
 
 void audio_streamer_get_stats(audio_streamer_stats_t *stats);
+
+#ifdef AUDIO_STREAMER_TESTING
+#include "mic_input.h"
+// Test-only: runs the tap callback on `tap` without a subscription or
+// streamer task. With push and pull off it only fills stream chunks.
+void audio_streamer_test_on_tap(const mic_tap_view *tap);
+#endif
@@ -0,0 +1,46 @@
+#ifndef IMA_ADPCM_H
+#define IMA_ADPCM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming IMA ADPCM encoder for interleaved 16-bit mono or stereo,
+// producing the block layout of WAVE format 0x11: per block, one 4-byte
+// header per channel (first sample verbatim, step index) followed by 4-byte
+// groups of eight 4-bit codes, alternating between channels. About 4:1
+// against PCM.
+#define IMA_ADPCM_MAX_CHANNELS 2
+#define IMA_ADPCM_BLOCK_BYTES  512
+#define IMA_ADPCM_BLOCK_FRAMES(channels)                                       \
+  (((IMA_ADPCM_BLOCK_BYTES - 4 * (channels)) * 8) / (4 * (channels)) + 1)
+
+// Output bound for encoding at most `frames` frames in one call, whatever
+// part of a block the encoder already holds and whatever its channel count.
+#define IMA_ADPCM_MAX_BYTES(frames)                                            \
+  ((((frames) + IMA_ADPCM_BLOCK_FRAMES(IMA_ADPCM_MAX_CHANNELS) - 1) /          \
+    IMA_ADPCM_BLOCK_FRAMES(IMA_ADPCM_MAX_CHANNELS)) *                          \
+   IMA_ADPCM_BLOCK_BYTES)
+
+typedef struct {
+  int channels;
+  int block_frames;                     // IMA_ADPCM_BLOCK_FRAMES(channels)
+  int32_t predictor[IMA_ADPCM_MAX_CHANNELS];
+  int8_t index[IMA_ADPCM_MAX_CHANNELS];
+  int frames;                           // frames in the block being built
+  uint8_t block[IMA_ADPCM_BLOCK_BYTES]; // block being built
+} ima_adpcm_encoder;
+
+// Starts a stream of 1 or 2 channels.
+void ima_adpcm_init(ima_adpcm_encoder *enc, int channels);
+
+// Starts a new stream with the same channels; a partially built block is
+// discarded.
+void ima_adpcm_reset(ima_adpcm_encoder *enc);
+
+// Encodes `frames` frames and writes every block completed by them to `out`
+// (room for IMA_ADPCM_MAX_BYTES(frames)). Returns the bytes written, always
+// a multiple of IMA_ADPCM_BLOCK_BYTES; the rest stays in the encoder.
+size_t ima_adpcm_encode(ima_adpcm_encoder *enc, const int16_t *interleaved,
+                        size_t frames, uint8_t *out);
+
+#endif
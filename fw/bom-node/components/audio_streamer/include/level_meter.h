@@ -0,0 +1,53 @@
+#pragma once
+
+#include "audio_levels.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Level meter: a tap subscriber that sums the stereo mic stream into
+// LEVEL_METER_BLOCK_MS blocks (audio_levels.h) and keeps the most recent
+// LEVEL_METER_RING_BLOCKS in a ring, each with the detector's noise floor
+// at its end. Consumers merge consecutive blocks into windows of their own
+// length, so any number of them costs the reader one pass over the
+// samples. The subscription only runs while someone holds the meter.
+
+#define LEVEL_METER_BLOCK_MS 50
+#define LEVEL_METER_WINDOW_MIN_MS LEVEL_METER_BLOCK_MS
+#define LEVEL_METER_WINDOW_MAX_MS 1000
+#define LEVEL_METER_RING_BLOCKS 32 // 1.6 s
+
+typedef struct {
+  audio_levels_sum sum;
+  uint16_t floor[AUDIO_LEVELS_CHANNELS]; // impulse_detector_noise_floor()
+  uint32_t seq;                          // from 0 since boot
+} level_meter_block;
+
+// Runs on the reader task after each block is published; keep it to a
+// task notification.
+typedef void (*level_meter_cb)(void *ctx);
+
+// Subscribes to the taps, disabled. Call after mic_init().
+void level_meter_init(void);
+// Set before the first level_meter_acquire().
+void level_meter_set_listener(level_meter_cb cb, void *ctx);
+
+// The meter runs while acquired at least once; a fresh start drops the
+// block that was filling when it stopped.
+void level_meter_acquire(void);
+void level_meter_release(void);
+
+// Sequence number of the next block to be published.
+uint32_t level_meter_next_seq(void);
+
+// Copies block *cursor into `out` and advances the cursor past it. A
+// cursor the ring has lapped skips to the oldest block kept, so out->seq
+// shows the jump. Returns false when no block at or after *cursor has been
+// published yet.
+bool level_meter_read(uint32_t *cursor, level_meter_block *out);
+
+typedef struct {
+  uint32_t holders; // level_meter_acquire() minus level_meter_release()
+  uint32_t blocks;  // published since boot
+} level_meter_stats_t;
+
+void level_meter_get_stats(level_meter_stats_t *stats);
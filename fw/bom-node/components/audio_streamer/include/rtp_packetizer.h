@@ -0,0 +1,77 @@
+#ifndef RTP_PACKETIZER_H
+#define RTP_PACKETIZER_H
+
+#include "ima_adpcm.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Cuts interleaved 16-bit mono or stereo into RTP packets (RFC 3550) that
+// fit one 802.11 frame without IP fragmentation: L16 (network byte order,
+// RFC 3551) or one WAV-layout IMA ADPCM block per packet.
+//
+// Sequence number and timestamp come from the stream's sample counter: the
+// timestamp is the low 32 bits of the first frame's index, and packets cover
+// a fixed grid of the counter, so the sequence number is the grid cell and
+// dropped audio shows up as missing sequence numbers. The first packet after
+// a gap carries the marker bit.
+
+#define RTP_HEADER_BYTES 12
+// 960 B of stereo L16 payload: 5.4 ms at 44.1 kHz.
+#define RTP_PCM_FRAMES   240
+#define RTP_PACKET_BYTES (RTP_HEADER_BYTES + RTP_PCM_FRAMES * 4)
+
+_Static_assert(IMA_ADPCM_BLOCK_BYTES <= RTP_PCM_FRAMES * 4,
+               "an ADPCM block must fit a packet");
+
+// Static payload types of L16 at 44.1 kHz; other rates and ADPCM use
+// dynamic types, to be bound by the receiver's SDP.
+#define RTP_PT_L16_44100_STEREO 10
+#define RTP_PT_L16_44100_MONO   11
+#define RTP_PT_L16_DYNAMIC      96
+#define RTP_PT_ADPCM_DYNAMIC    97
+
+typedef struct {
+  size_t len; // header plus payload
+  uint8_t data[RTP_PACKET_BYTES];
+} rtp_packet;
+
+// Gets each finished packet; the packet is reused once it returns.
+typedef void (*rtp_emit_fn)(const rtp_packet *pkt, void *ctx);
+
+typedef struct {
+  bool adpcm;
+  int channels;
+  bool started;
+  bool marker;          // set on the next packet
+  uint64_t origin;      // index the sequence grid is anchored at
+  uint64_t next_index;  // index the input continues at
+  uint32_t packet_no;   // grid cell of the last packet sent
+  bool sent_any;
+  uint64_t pkt_index;   // index of the packet's first frame
+  size_t pkt_frames;    // PCM frames in `pkt`
+  rtp_packet pkt;       // header fields fixed at init
+  ima_adpcm_encoder enc;
+  uint64_t enc_index;   // index of the encoder's first pending frame
+  uint32_t packets;
+  uint32_t gaps;        // discontinuities in the input
+} rtp_packetizer;
+
+// Preformats the packet header for `payload_type` and `ssrc`, for input of
+// 1 or 2 `channels`.
+void rtp_packetizer_init(rtp_packetizer *p, uint8_t payload_type,
+                         uint32_t ssrc, bool adpcm, int channels);
+
+// Adds `frames` frames whose first is sample `index` and emits every packet
+// they complete. Input that does not continue the previous call ends the
+// packet in progress early (PCM) or drops the partial block (ADPCM).
+void rtp_packetizer_push(rtp_packetizer *p, const int16_t *interleaved,
+                         size_t frames, uint64_t index, rtp_emit_fn emit,
+                         void *ctx);
+
+// Emits a partly filled PCM packet, e.g. when the input stalls. ADPCM only
+// goes out in whole blocks.
+void rtp_packetizer_flush(rtp_packetizer *p, rtp_emit_fn emit, void *ctx);
+
+#endif
@@ -0,0 +1,120 @@
+#include "level_meter.h"
+#include "detector.h"
+#include "mic_input.h"
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+static const char *TAG = "LEVEL_METER";
+
+// Taps per callback: about 5 ms of audio at 44.1 kHz, well inside a block.
+#define LEVEL_METER_BATCH_TAPS 8
+
+static mic_subscription *s_sub = NULL;
+static level_meter_cb s_listener = NULL;
+static void *s_listener_ctx = NULL;
+static _Atomic uint32_t s_holders = 0;
+
+// Reader task only.
+static audio_levels s_levels;
+static uint32_t s_epoch = UINT32_MAX;
+
+// Written by the reader task; the mutex keeps a copied block whole.
+static level_meter_block s_ring[LEVEL_METER_RING_BLOCKS];
+static _Atomic uint32_t s_published = 0;
+static portMUX_TYPE s_ring_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void level_meter_on_block(const audio_levels_sum *block, void *ctx) {
+  (void)ctx;
+  const uint32_t seq = atomic_load_explicit(&s_published, memory_order_relaxed);
+  level_meter_block *slot = &s_ring[seq % LEVEL_METER_RING_BLOCKS];
+  uint16_t floor[AUDIO_LEVELS_CHANNELS];
+  impulse_detector_noise_floor(floor);
+
+  taskENTER_CRITICAL(&s_ring_mux);
+  slot->sum = *block;
+  memcpy(slot->floor, floor, sizeof(floor));
+  slot->seq = seq;
+  atomic_store_explicit(&s_published, seq + 1, memory_order_relaxed);
+  taskEXIT_CRITICAL(&s_ring_mux);
+
+  if (s_listener) {
+    s_listener(s_listener_ctx);
+  }
+}
+
+static void level_meter_on_tap(const mic_tap_view *tap, void *ctx) {
+  (void)ctx;
+  if (tap->epoch != s_epoch) {
+    // A new rate changes the block length.
+    const mic_config *cfg = mic_get_config();
+    const int64_t block =
+        (int64_t)cfg->sampling_freq * LEVEL_METER_BLOCK_MS / 1000;
+    audio_levels_init(&s_levels, (uint32_t)block);
+    s_epoch = tap->epoch;
+  }
+  audio_levels_push(&s_levels, tap->left, tap->right, (size_t)tap->length,
+                    tap->sample_index, level_meter_on_block, NULL);
+}
+
+void level_meter_init(void) {
+  if (s_sub) {
+    return;
+  }
+  const mic_subscriber_cfg sub_cfg = {
+      .cb = level_meter_on_tap,
+      .name = "level_meter",
+      .batch_taps = LEVEL_METER_BATCH_TAPS,
+      .enabled = false,
+  };
+  s_sub = mic_subscribe(&sub_cfg);
+  if (!s_sub) {
+    ESP_LOGE(TAG, "Failed to subscribe to microphone taps");
+  }
+}
+
+void level_meter_set_listener(level_meter_cb cb, void *ctx) {
+  s_listener_ctx = ctx;
+  s_listener = cb;
+}
+
+void level_meter_acquire(void) {
+  if (atomic_fetch_add(&s_holders, 1) == 0 && s_sub) {
+    mic_subscription_set_enabled(s_sub, true);
+  }
+}
+
+void level_meter_release(void) {
+  if (atomic_fetch_sub(&s_holders, 1) == 1 && s_sub) {
+    mic_subscription_set_enabled(s_sub, false);
+  }
+}
+
+uint32_t level_meter_next_seq(void) {
+  return atomic_load_explicit(&s_published, memory_order_relaxed);
+}
+
+bool level_meter_read(uint32_t *cursor, level_meter_block *out) {
+  bool found = false;
+  taskENTER_CRITICAL(&s_ring_mux);
+  const uint32_t next =
+      atomic_load_explicit(&s_published, memory_order_relaxed);
+  if (next != *cursor) {
+    if (next - *cursor > LEVEL_METER_RING_BLOCKS) {
+      *cursor = next - LEVEL_METER_RING_BLOCKS;
+    }
+    *out = s_ring[*cursor % LEVEL_METER_RING_BLOCKS];
+    (*cursor)++;
+    found = true;
+  }
+  taskEXIT_CRITICAL(&s_ring_mux);
+  return found;
+}
+
+void level_meter_get_stats(level_meter_stats_t *stats) {
+  stats->holders = atomic_load(&s_holders);
+  stats->blocks = level_meter_next_seq();
+}
@@ -0,0 +1,131 @@
+#include "rtp_packetizer.h"
+
+#include <string.h>
+
+#define RTP_VERSION_BYTE 0x80 // V=2, no padding, extension or CSRCs
+#define RTP_MARKER       0x80
+
+static inline void put_be16(uint8_t *dst, uint16_t val) {
+  dst[0] = (uint8_t)(val >> 8);
+  dst[1] = (uint8_t)val;
+}
+
+static inline void put_be32(uint8_t *dst, uint32_t val) {
+  dst[0] = (uint8_t)(val >> 24);
+  dst[1] = (uint8_t)(val >> 16);
+  dst[2] = (uint8_t)(val >> 8);
+  dst[3] = (uint8_t)val;
+}
+
+void rtp_packetizer_init(rtp_packetizer *p, uint8_t payload_type,
+                         uint32_t ssrc, bool adpcm, int channels) {
+  memset(p, 0, sizeof(*p));
+  p->adpcm = adpcm;
+  p->channels = channels == 1 ? 1 : 2;
+  p->pkt.data[0] = RTP_VERSION_BYTE;
+  p->pkt.data[1] = payload_type & 0x7f;
+  put_be32(&p->pkt.data[8], ssrc);
+  ima_adpcm_init(&p->enc, p->channels);
+}
+
+// Grid cell `cell` of a packet starting at `index`. A cell already used (a
+// gap inside one) takes the next number, so sequence numbers never repeat.
+static void emit_packet(rtp_packetizer *p, uint64_t index, size_t payload_len,
+                        uint32_t cell, rtp_emit_fn emit, void *ctx) {
+  if (p->sent_any && (int32_t)(cell - p->packet_no) <= 0) {
+    cell = p->packet_no + 1;
+  }
+  uint8_t *hdr = p->pkt.data;
+  hdr[1] = (uint8_t)((hdr[1] & 0x7f) | (p->marker ? RTP_MARKER : 0));
+  put_be16(&hdr[2], (uint16_t)cell);
+  put_be32(&hdr[4], (uint32_t)index);
+  p->pkt.len = RTP_HEADER_BYTES + payload_len;
+  emit(&p->pkt, ctx);
+  p->packet_no = cell;
+  p->sent_any = true;
+  p->marker = false;
+  p->packets++;
+}
+
+void rtp_packetizer_flush(rtp_packetizer *p, rtp_emit_fn emit, void *ctx) {
+  if (p->adpcm || p->pkt_frames == 0) {
+    return;
+  }
+  emit_packet(p, p->pkt_index, p->pkt_frames * 2 * p->channels,
+              (uint32_t)((p->pkt_index - p->origin) / RTP_PCM_FRAMES), emit,
+              ctx);
+  p->pkt_frames = 0;
+}
+
+static void push_pcm(rtp_packetizer *p, const int16_t *in, size_t frames,
+                     uint64_t index, rtp_emit_fn emit, void *ctx) {
+  while (frames > 0) {
+    if (p->pkt_frames == 0) {
+      p->pkt_index = index;
+    }
+    // Packets end on the grid, so a late start makes a short first packet.
+    const size_t room =
+        RTP_PCM_FRAMES - (size_t)((index - p->origin) % RTP_PCM_FRAMES);
+    const size_t n = frames < room ? frames : room;
+    const size_t samples = n * p->channels;
+    uint8_t *out =
+        &p->pkt.data[RTP_HEADER_BYTES + p->pkt_frames * 2 * p->channels];
+    for (size_t i = 0; i < samples; i++) {
+      put_be16(&out[2 * i], (uint16_t)in[i]);
+    }
+    p->pkt_frames += n;
+    in += samples;
+    index += n;
+    frames -= n;
+    if (n == room) {
+      rtp_packetizer_flush(p, emit, ctx);
+    }
+  }
+}
+
+static void push_adpcm(rtp_packetizer *p, const int16_t *in, size_t frames,
+                       uint64_t index, rtp_emit_fn emit, void *ctx) {
+  while (frames > 0) {
+    if (p->enc.frames == 0) {
+      p->enc_index = index;
+    }
+    // At most one block completes per call, straight into the packet.
+    const size_t room = (size_t)(p->enc.block_frames - p->enc.frames);
+    const size_t n = frames < room ? frames : room;
+    const size_t bytes =
+        ima_adpcm_encode(&p->enc, in, n, &p->pkt.data[RTP_HEADER_BYTES]);
+    in += n * p->channels;
+    index += n;
+    frames -= n;
+    if (bytes > 0) {
+      emit_packet(p, p->enc_index, bytes,
+                  (uint32_t)((p->enc_index - p->origin) /
+                             (uint64_t)p->enc.block_frames),
+                  emit, ctx);
+    }
+  }
+}
+
+void rtp_packetizer_push(rtp_packetizer *p, const int16_t *interleaved,
+                         size_t frames, uint64_t index, rtp_emit_fn emit,
+                         void *ctx) {
+  if (frames == 0) {
+    return;
+  }
+  if (!p->started) {
+    p->started = true;
+    p->origin = index;
+    p->marker = true;
+  } else if (index != p->next_index) {
+    p->gaps++;
+    rtp_packetizer_flush(p, emit, ctx);
+    ima_adpcm_reset(&p->enc);
+    p->marker = true;
+  }
+  p->next_index = index + frames;
+  if (p->adpcm) {
+    push_adpcm(p, interleaved, frames, index, emit, ctx);
+  } else {
+    push_pcm(p, interleaved, frames, index, emit, ctx);
+  }
+}
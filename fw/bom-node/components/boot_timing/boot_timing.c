@@ -0,0 +1,91 @@
+#include "boot_timing.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "metrics.h"
+
+static const char *TAG = "BOOT";
+
+static const char *const s_names[BOOT_STAGE_COUNT] = {
+    [BOOT_STAGE_CORE] = "core",
+    [BOOT_STAGE_CAPTURE] = "capture",
+    [BOOT_STAGE_FIRST_SAMPLE] = "first_sample",
+    [BOOT_STAGE_DETECTOR_LIVE] = "detector_live",
+    [BOOT_STAGE_WIFI_STARTED] = "wifi_started",
+    [BOOT_STAGE_WIFI_IP] = "wifi_ip",
+    [BOOT_STAGE_SPIFFS] = "spiffs",
+    [BOOT_STAGE_WEBSERVER] = "webserver",
+    [BOOT_STAGE_OTA] = "ota",
+};
+
+// 0 while unmarked; esp_timer never reads 0 once the app is running.
+static _Atomic int64_t s_marks[BOOT_STAGE_COUNT];
+
+static void boot_collect(metrics_out *out, void *ctx);
+static metrics_collector s_collector =
+    METRICS_COLLECTOR_INIT(boot_collect, NULL);
+
+static void boot_collect(metrics_out *out, void *ctx) {
+  (void)ctx;
+  metrics_out_family(out, "boot_stage_seconds", "gauge",
+                     "Time from application start to each boot stage");
+  for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+    const int64_t us = boot_timing_get_us((boot_stage)i);
+    if (us < 0) {
+      continue;
+    }
+    char labels[32];
+    snprintf(labels, sizeof(labels), "stage=\"%s\"", s_names[i]);
+    metrics_out_double(out, "boot_stage_seconds", labels, us / 1e6);
+  }
+}
+
+void boot_timing_init(void) { metrics_register(&s_collector.base); }
+
+void boot_timing_mark(boot_stage stage) {
+  if ((unsigned)stage >= BOOT_STAGE_COUNT) {
+    return;
+  }
+  int64_t expected = 0;
+  const int64_t now = esp_timer_get_time();
+  if (atomic_compare_exchange_strong(&s_marks[stage], &expected,
+                                     now > 0 ? now : 1)) {
+    ESP_LOGI(TAG, "%s at %lld ms", s_names[stage], (long long)(now / 1000));
+  }
+}
+
+int64_t boot_timing_get_us(boot_stage stage) {
+  if ((unsigned)stage >= BOOT_STAGE_COUNT) {
+    return -1;
+  }
+  const int64_t us = atomic_load(&s_marks[stage]);
+  return us > 0 ? us : -1;
+}
+
+const char *boot_timing_name(boot_stage stage) {
+  return (unsigned)stage < BOOT_STAGE_COUNT ? s_names[stage] : "unknown";
+}
+
+void boot_timing_log(void) {
+  // A handful of stages: selection order is fine.
+  bool shown[BOOT_STAGE_COUNT] = {false};
+  for (;;) {
+    int next = -1;
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+      if (!shown[i] && boot_timing_get_us((boot_stage)i) >= 0 &&
+          (next < 0 || s_marks[i] < s_marks[next])) {
+        next = i;
+      }
+    }
+    if (next < 0) {
+      return;
+    }
+    shown[next] = true;
+    ESP_LOGI(TAG, "  %-14s %6lld ms", s_names[next],
+             (long long)(boot_timing_get_us((boot_stage)next) / 1000));
+  }
+}
@@ -0,0 +1,39 @@
+#ifndef BOOT_TIMING_H
+#define BOOT_TIMING_H
+
+#include <stdint.h>
+
+// Boot milestones, as esp_timer time since the application started.
+//
+// Each stage is marked by the module that reaches it; only the first mark
+// counts, so a mark may sit on a path that runs again later (reconnects,
+// restarts of a task). Marks are lock-free and safe from any task.
+
+typedef enum {
+  BOOT_STAGE_CORE,          // NVS, netif and the default event loop
+  BOOT_STAGE_CAPTURE,       // I2S reader started
+  BOOT_STAGE_FIRST_SAMPLE,  // first DMA chunk committed to the mic ring
+  BOOT_STAGE_DETECTOR_LIVE, // first detection over a full window
+  BOOT_STAGE_WIFI_STARTED,  // esp_wifi_start() returned
+  BOOT_STAGE_WIFI_IP,       // station got its first IP address
+  BOOT_STAGE_SPIFFS,        // web assets mounted
+  BOOT_STAGE_WEBSERVER,     // HTTP server accepting requests
+  BOOT_STAGE_OTA,           // update check started
+  BOOT_STAGE_COUNT
+} boot_stage;
+
+// Registers the boot_stage_seconds metric family.
+void boot_timing_init(void);
+
+void boot_timing_mark(boot_stage stage);
+
+// Time of the mark [us], or -1 while the stage has not been reached.
+int64_t boot_timing_get_us(boot_stage stage);
+
+// Metric label and JSON key of the stage, e.g. "first_sample".
+const char *boot_timing_name(boot_stage stage);
+
+// Logs every stage reached so far, in order of time.
+void boot_timing_log(void);
+
+#endif
@@ -0,0 +1,81 @@
+#include "event_classifier.h"
+
+#include <math.h>
+#include <string.h>
+
+// The blob is read field by field, as it may sit at any alignment; the
+// target and the host tests are both little-endian.
+typedef struct {
+  const uint8_t *p;
+  size_t left;
+} blob_reader;
+
+static bool blob_take(blob_reader *r, void *dst, size_t len) {
+  if (r->left < len) {
+    return false;
+  }
+  memcpy(dst, r->p, len);
+  r->p += len;
+  r->left -= len;
+  return true;
+}
+
+bool event_classifier_load(event_classifier *c, const void *blob, size_t len) {
+  blob_reader r = {.p = blob, .left = len};
+  uint32_t magic = 0, hidden = 0;
+  if (!blob_take(&r, &magic, sizeof(magic)) ||
+      !blob_take(&r, &hidden, sizeof(hidden)) ||
+      magic != EVENT_CLASSIFIER_MAGIC || hidden < 1 ||
+      hidden > EVENT_CLASSIFIER_MAX_HIDDEN ||
+      len != EVENT_CLASSIFIER_BLOB_BYTES(hidden)) {
+    return false;
+  }
+  c->hidden = (int)hidden;
+  blob_take(&r, c->in_offset, sizeof(c->in_offset));
+  blob_take(&r, c->in_scale, sizeof(c->in_scale));
+  blob_take(&r, &c->m1, sizeof(c->m1));
+  blob_take(&r, &c->m2, sizeof(c->m2));
+  blob_take(&r, &c->threshold, sizeof(c->threshold));
+  blob_take(&r, &c->b2, sizeof(c->b2));
+  blob_take(&r, c->b1, hidden * sizeof(c->b1[0]));
+  blob_take(&r, c->w1, hidden * sizeof(c->w1[0]));
+  blob_take(&r, c->w2, hidden * sizeof(c->w2[0]));
+  for (int i = 0; i < EVENT_CLASSIFIER_INPUTS; i++) {
+    if (!(c->in_scale[i] != 0.0f)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static int32_t saturate(float v, int32_t lo, int32_t hi) {
+  const float r = roundf(v);
+  return r < (float)lo ? lo : r > (float)hi ? hi : (int32_t)r;
+}
+
+float event_classifier_score(const event_classifier *c,
+                             const event_features *f) {
+  float x[EVENT_CLASSIFIER_INPUTS];
+  for (int b = 0; b < EVENT_FEATURE_BANDS; b++) {
+    x[b] = f->band_db[b];
+  }
+  x[EVENT_FEATURE_BANDS] = f->centroid_hz / 1000.0f;
+  x[EVENT_FEATURE_BANDS + 1] = f->rise_us / 1000.0f;
+  x[EVENT_FEATURE_BANDS + 2] = f->peak_to_rms_db;
+
+  int8_t xq[EVENT_CLASSIFIER_INPUTS];
+  for (int i = 0; i < EVENT_CLASSIFIER_INPUTS; i++) {
+    xq[i] = (int8_t)saturate((x[i] - c->in_offset[i]) / c->in_scale[i], -128,
+                             127);
+  }
+
+  int32_t out = c->b2;
+  for (int j = 0; j < c->hidden; j++) {
+    int32_t acc = c->b1[j];
+    for (int i = 0; i < EVENT_CLASSIFIER_INPUTS; i++) {
+      acc += (int32_t)c->w1[j][i] * xq[i];
+    }
+    out += (int32_t)c->w2[j] * saturate((float)acc * c->m1, 0, 127);
+  }
+  return (float)out * c->m2;
+}
@@ -0,0 +1,133 @@
+#include "event_features.h"
+
+#include <math.h>
+
+#define FEATURE_PI 3.14159265358979323846f
+#define FEATURE_FLOOR_DB (-120.0f)
+#define ONSET_FRACTION 0.1f
+
+// In-place radix-2 FFT of `n` interleaved complex floats, the layout and
+// ordering esp-dsp's dsps_fft2r_fc32 uses. Twiddles come from one sin/cos
+// per stage and a rotation recurrence; at n = 1024 that stays well within
+// what the band levels below resolve.
+static void fft_radix2(float *data, int n) {
+  for (int i = 1, j = 0; i < n; i++) {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j |= bit;
+    if (i < j) {
+      const float re = data[2 * i], im = data[2 * i + 1];
+      data[2 * i] = data[2 * j];
+      data[2 * i + 1] = data[2 * j + 1];
+      data[2 * j] = re;
+      data[2 * j + 1] = im;
+    }
+  }
+  for (int len = 2; len <= n; len <<= 1) {
+    const float angle = -2.0f * FEATURE_PI / (float)len;
+    const float step_re = cosf(angle), step_im = sinf(angle);
+    const int half = len >> 1;
+    float w_re = 1.0f, w_im = 0.0f;
+    for (int k = 0; k < half; k++) {
+      for (int i = k; i < n; i += len) {
+        float *a = &data[2 * i];
+        float *b = &data[2 * (i + half)];
+        const float t_re = b[0] * w_re - b[1] * w_im;
+        const float t_im = b[0] * w_im + b[1] * w_re;
+        b[0] = a[0] - t_re;
+        b[1] = a[1] - t_im;
+        a[0] += t_re;
+        a[1] += t_im;
+      }
+      const float next = w_re * step_re - w_im * step_im;
+      w_im = w_re * step_im + w_im * step_re;
+      w_re = next;
+    }
+  }
+}
+
+static float to_db(float ratio) {
+  if (ratio <= 0.0f) {
+    return FEATURE_FLOOR_DB;
+  }
+  const float db = 10.0f * log10f(ratio);
+  return db < FEATURE_FLOOR_DB ? FEATURE_FLOOR_DB : db;
+}
+
+// Samples from the onset to the peak at `peak`, walking back until the
+// magnitude has stayed below the onset level for more than `gap` samples.
+static int rise_samples(const int16_t *x, int peak, float threshold,
+                        int gap) {
+  int onset = peak;
+  for (int i = peak - 1; i >= 0 && onset - i <= gap; i--) {
+    if (fabsf((float)x[i]) >= threshold) {
+      onset = i;
+    }
+  }
+  return peak - onset;
+}
+
+void event_features_compute(const int16_t *x, int n, int sample_rate,
+                            float *work, event_features *out) {
+  const int fft_n = EVENT_FEATURE_FFT_N;
+  n = n < 0 ? 0 : n > fft_n ? fft_n : n;
+  const float rate = sample_rate > 0 ? (float)sample_rate : 1.0f;
+
+  int peak = 0;
+  float peak_mag = 0.0f;
+  double sum_sq = 0.0;
+  float window_sq = 0.0f;
+  for (int i = 0; i < n; i++) {
+    const float s = (float)x[i] / 32768.0f;
+    const float mag = fabsf(s);
+    if (mag > peak_mag) {
+      peak_mag = mag;
+      peak = i;
+    }
+    sum_sq += (double)s * s;
+    const float w =
+        n > 1 ? 0.5f - 0.5f * cosf(2.0f * FEATURE_PI * i / (float)(n - 1))
+              : 1.0f;
+    window_sq += w * w;
+    work[2 * i] = s * w;
+    work[2 * i + 1] = 0.0f;
+  }
+  for (int i = n; i < fft_n; i++) {
+    work[2 * i] = 0.0f;
+    work[2 * i + 1] = 0.0f;
+  }
+
+  const int gap = sample_rate >= 1000 ? sample_rate / 1000 : 1;
+  out->rise_us = (float)rise_samples(x, peak, peak_mag * 32768.0f *
+                                                  ONSET_FRACTION,
+                                     gap) *
+                 1e6f / rate;
+  const float rms = n > 0 ? sqrtf((float)(sum_sq / n)) : 0.0f;
+  out->peak_to_rms_db = rms > 0.0f ? 20.0f * log10f(peak_mag / rms) : 0.0f;
+
+  fft_radix2(work, fft_n);
+
+  // By Parseval, a unit sine under this window puts N * sum(w^2) / 4 into
+  // the bins of one half of the spectrum.
+  const float full_scale = (float)fft_n * window_sq / 4.0f;
+  const float bin_hz = rate / (float)fft_n;
+  double total = 0.0, weighted = 0.0;
+  for (int band = 0; band < EVENT_FEATURE_BANDS; band++) {
+    const int hi = (fft_n / 2) >> (EVENT_FEATURE_BANDS - 1 - band);
+    const int lo = band == 0 ? 1 : (fft_n / 2) >> (EVENT_FEATURE_BANDS - band);
+    double energy = 0.0;
+    for (int k = lo; k < hi; k++) {
+      const float e = work[2 * k] * work[2 * k] +
+                      work[2 * k + 1] * work[2 * k + 1];
+      energy += e;
+      weighted += (double)e * k;
+    }
+    total += energy;
+    out->band_db[band] =
+        full_scale > 0.0f ? to_db((float)(energy / full_scale))
+                          : FEATURE_FLOOR_DB;
+  }
+  out->centroid_hz = total > 0.0 ? (float)(weighted / total) * bin_hz : 0.0f;
+}
@@ -0,0 +1,338 @@
+#include "event_log.h"
+
+#include <string.h>
+
+// Bump the last byte when the sector or record layout changes; sectors of an
+// older layout then fail the magic check and read as erased.
+#define SECTOR_MAGIC 0x474c5605u // "\x05VLG"
+#define ERASED_WORD 0xffffffffu
+#define PAYLOAD_SIZE (EVENT_LOG_SECTOR_SIZE - EVENT_LOG_HEADER_SIZE)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t seq;
+  uint16_t count;   // records in the sector
+  uint16_t used;    // payload bytes, a multiple of 4
+  uint32_t crc;     // CRC-32 of the payload
+  uint32_t drained; // ERASED_WORD until every record has been consumed
+} sector_header;
+
+_Static_assert(sizeof(sector_header) == EVENT_LOG_HEADER_SIZE,
+               "sector header layout");
+
+static inline uint32_t pad4(size_t len) { return (uint32_t)((len + 3u) & ~3u); }
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len) {
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1u)));
+    }
+  }
+  return ~crc;
+}
+
+static inline uint32_t sector_offset(uint32_t sector) {
+  return sector * EVENT_LOG_SECTOR_SIZE;
+}
+
+static inline uint32_t next_sector(const event_log *log, uint32_t sector) {
+  return sector + 1 == log->sectors ? 0 : sector + 1;
+}
+
+static bool read_header(event_log *log, uint32_t sector, sector_header *h) {
+  return log->flash.read(log->flash.ctx, sector_offset(sector), h,
+                         sizeof(*h)) == 0;
+}
+
+static bool header_valid(const sector_header *h) {
+  return h->magic == SECTOR_MAGIC && h->count > 0 && h->used <= PAYLOAD_SIZE &&
+         (uint32_t)h->count * EVENT_LOG_RECORD_HEADER_SIZE <= h->used;
+}
+
+// Valid and not yet drained: the sector still holds records to replay.
+static bool header_live(const sector_header *h) {
+  return header_valid(h) && h->drained == ERASED_WORD;
+}
+
+static enum event_log_state mark_drained(event_log *log, uint32_t sector) {
+  sector_header h;
+  if (!read_header(log, sector, &h)) {
+    return EVENT_LOG_ERR_FLASH;
+  }
+  if (!header_live(&h)) {
+    return EVENT_LOG_OK;
+  }
+  // NOR flash can clear bits without an erase.
+  const uint32_t zero = 0;
+  return log->flash.write(log->flash.ctx,
+                          sector_offset(sector) +
+                              offsetof(sector_header, drained),
+                          &zero, sizeof(zero)) == 0
+             ? EVENT_LOG_OK
+             : EVENT_LOG_ERR_FLASH;
+}
+
+// Checksums the payload through the (still empty) stage buffer.
+static bool payload_intact(event_log *log, uint32_t sector,
+                           const sector_header *h) {
+  if (log->flash.read(log->flash.ctx,
+                      sector_offset(sector) + EVENT_LOG_HEADER_SIZE, log->stage,
+                      h->used) != 0) {
+    return false;
+  }
+  return crc32_update(0, log->stage, h->used) == h->crc;
+}
+
+enum event_log_state event_log_open(event_log *log, const event_log_flash *flash,
+                                    uint32_t sectors) {
+  if (!log || !flash || !flash->read || !flash->write ||
+      !flash->erase_sector || sectors < 2) {
+    return EVENT_LOG_ERR_INVALID_ARG;
+  }
+  memset(log, 0, sizeof(*log));
+  log->flash = *flash;
+  log->sectors = sectors;
+
+  // Newest sector by sequence number, drained or not.
+  bool any = false;
+  uint32_t max_seq = 0;
+  for (uint32_t s = 0; s < sectors; s++) {
+    sector_header h;
+    if (!read_header(log, s, &h)) {
+      return EVENT_LOG_ERR_FLASH;
+    }
+    if (header_valid(&h) && (!any || h.seq > max_seq)) {
+      any = true;
+      max_seq = h.seq;
+      log->head = s;
+    }
+  }
+  if (!any) {
+    log->head = sectors - 1;
+    log->next_seq = 1;
+    log->tail.sector = log->head;
+    return EVENT_LOG_OK;
+  }
+  log->next_seq = max_seq + 1;
+
+  // Sectors are written in ring order, so the oldest follows the head. The
+  // first live one is the tail; live sectors past it make up the backlog.
+  bool found = false;
+  log->tail.sector = log->head;
+  for (uint32_t i = 1; i <= sectors; i++) {
+    const uint32_t s = (log->head + i) % sectors;
+    sector_header h;
+    if (!read_header(log, s, &h)) {
+      return EVENT_LOG_ERR_FLASH;
+    }
+    if (!header_live(&h)) {
+      continue;
+    }
+    if (!payload_intact(log, s, &h)) {
+      log->corrupt++;
+      if (mark_drained(log, s) != EVENT_LOG_OK) {
+        return EVENT_LOG_ERR_FLASH;
+      }
+      continue;
+    }
+    if (!found) {
+      found = true;
+      // Positioned before the sector so event_log_next() enters it.
+      log->tail.sector = s == 0 ? sectors - 1 : s - 1;
+    }
+    log->tail.left += h.count;
+  }
+  return EVENT_LOG_OK;
+}
+
+enum event_log_state event_log_flush(event_log *log) {
+  if (!log) {
+    return EVENT_LOG_ERR_INVALID_ARG;
+  }
+  if (log->stage_count == 0) {
+    return EVENT_LOG_OK;
+  }
+
+  const uint32_t w = next_sector(log, log->head);
+  event_log_cursor *tail = &log->tail;
+  if (tail->left > 0) {
+    // Full ring: the sector to erase is the one the tail is in, or the one
+    // it is about to enter.
+    const bool done = tail->index >= tail->count;
+    uint32_t victim_unread = 0;
+    if (!done && tail->sector == w) {
+      victim_unread = (uint32_t)(tail->count - tail->index);
+    } else if (done && next_sector(log, tail->sector) == w) {
+      sector_header h;
+      if (!read_header(log, w, &h)) {
+        return EVENT_LOG_ERR_FLASH;
+      }
+      victim_unread = header_live(&h) ? h.count : 0;
+    } else {
+      victim_unread = UINT32_MAX; // not the victim
+    }
+    if (victim_unread != UINT32_MAX) {
+      if (victim_unread > tail->left) {
+        victim_unread = tail->left;
+      }
+      log->lost += victim_unread;
+      log->overwrites++;
+      tail->left -= victim_unread;
+      // Done with w before it is rewritten; the walk resumes after it.
+      tail->sector = w;
+      tail->index = 0;
+      tail->offset = 0;
+      tail->count = 0;
+    }
+  }
+
+  const uint32_t base = sector_offset(w);
+  if (log->flash.erase_sector(log->flash.ctx, base) != 0 ||
+      log->flash.write(log->flash.ctx, base + EVENT_LOG_HEADER_SIZE, log->stage,
+                       log->stage_used) != 0) {
+    return EVENT_LOG_ERR_FLASH;
+  }
+  // The header goes last and leaves `drained` erased.
+  const sector_header h = {
+      .magic = SECTOR_MAGIC,
+      .seq = log->next_seq,
+      .count = log->stage_count,
+      .used = log->stage_used,
+      .crc = crc32_update(0, log->stage, log->stage_used),
+      .drained = ERASED_WORD,
+  };
+  if (log->flash.write(log->flash.ctx, base, &h,
+                       offsetof(sector_header, drained)) != 0) {
+    return EVENT_LOG_ERR_FLASH;
+  }
+
+  log->head = w;
+  log->next_seq++;
+  if (tail->left == 0) {
+    tail->sector = w == 0 ? log->sectors - 1 : w - 1;
+    tail->index = 0;
+    tail->offset = 0;
+    tail->count = 0;
+  }
+  tail->left += log->stage_count;
+  log->stage_used = 0;
+  log->stage_count = 0;
+  return EVENT_LOG_OK;
+}
+
+enum event_log_state event_log_append(event_log *log, const void *data,
+                                      size_t len) {
+  if (!log || (!data && len)) {
+    return EVENT_LOG_ERR_INVALID_ARG;
+  }
+  if (len > EVENT_LOG_MAX_RECORD) {
+    return EVENT_LOG_ERR_TOO_LARGE;
+  }
+  const uint32_t need = EVENT_LOG_RECORD_HEADER_SIZE + pad4(len);
+  if (log->stage_used + need > PAYLOAD_SIZE) {
+    const enum event_log_state err = event_log_flush(log);
+    if (err != EVENT_LOG_OK) {
+      return err;
+    }
+  }
+  uint8_t *dst = &log->stage[log->stage_used];
+  const uint16_t hdr[2] = {(uint16_t)len, 0xffff};
+  memcpy(dst, hdr, sizeof(hdr));
+  memcpy(dst + EVENT_LOG_RECORD_HEADER_SIZE, data, len);
+  memset(dst + EVENT_LOG_RECORD_HEADER_SIZE + len, 0xff, pad4(len) - len);
+  log->stage_used += need;
+  log->stage_count++;
+  return EVENT_LOG_OK;
+}
+
+void event_log_rewind(const event_log *log, event_log_cursor *cursor) {
+  *cursor = log->tail;
+  cursor->consumed = 0;
+  cursor->overwrites = log->overwrites;
+}
+
+enum event_log_state event_log_next(event_log *log, event_log_cursor *cursor,
+                                    void *buf, size_t cap, size_t *len) {
+  if (!log || !cursor || (!buf && cap)) {
+    return EVENT_LOG_ERR_INVALID_ARG;
+  }
+  // A cursor with count 0 has not entered `sector` yet; otherwise move on
+  // once its records are used up. Sectors that are not live are skipped.
+  for (uint32_t guard = 0; cursor->left > 0 && cursor->index >= cursor->count;
+       guard++) {
+    if (guard == log->sectors) {
+      cursor->left = 0;
+      break;
+    }
+    cursor->sector = next_sector(log, cursor->sector);
+    cursor->index = 0;
+    cursor->offset = 0;
+    cursor->count = 0;
+    sector_header h;
+    if (!read_header(log, cursor->sector, &h)) {
+      return EVENT_LOG_ERR_FLASH;
+    }
+    if (header_live(&h)) {
+      cursor->count = h.count;
+    }
+  }
+  if (cursor->left == 0) {
+    return EVENT_LOG_EMPTY;
+  }
+
+  const uint32_t base = sector_offset(cursor->sector) + EVENT_LOG_HEADER_SIZE;
+  uint16_t hdr[2];
+  if (log->flash.read(log->flash.ctx, base + cursor->offset, hdr,
+                      sizeof(hdr)) != 0) {
+    return EVENT_LOG_ERR_FLASH;
+  }
+  const size_t rec_len = hdr[0];
+  const bool fits = rec_len <= cap;
+  if (fits && log->flash.read(log->flash.ctx,
+                              base + cursor->offset +
+                                  EVENT_LOG_RECORD_HEADER_SIZE,
+                              buf, rec_len) != 0) {
+    return EVENT_LOG_ERR_FLASH;
+  }
+  cursor->offset += EVENT_LOG_RECORD_HEADER_SIZE + pad4(rec_len);
+  cursor->index++;
+  cursor->left--;
+  cursor->consumed++;
+  if (len) {
+    *len = rec_len;
+  }
+  return fits ? EVENT_LOG_OK : EVENT_LOG_ERR_TOO_LARGE;
+}
+
+enum event_log_state event_log_commit(event_log *log,
+                                      const event_log_cursor *cursor) {
+  if (!log || !cursor) {
+    return EVENT_LOG_ERR_INVALID_ARG;
+  }
+  if (cursor->overwrites != log->overwrites) {
+    return EVENT_LOG_ERR_STALE;
+  }
+  // Every sector between the two positions has been read to the end; the
+  // cursor's own sector only once its last record is behind it.
+  uint32_t s = log->tail.sector;
+  bool entered = log->tail.count > 0;
+  while (s != cursor->sector) {
+    if (entered && mark_drained(log, s) != EVENT_LOG_OK) {
+      return EVENT_LOG_ERR_FLASH;
+    }
+    s = next_sector(log, s);
+    entered = true;
+  }
+  if (cursor->count > 0 && cursor->index >= cursor->count &&
+      mark_drained(log, s) != EVENT_LOG_OK) {
+    return EVENT_LOG_ERR_FLASH;
+  }
+  // Records flushed since the cursor was taken are still ahead of it.
+  const uint32_t left = log->tail.left - cursor->consumed;
+  log->tail = *cursor;
+  log->tail.left = left;
+  log->tail.consumed = 0;
+  return EVENT_LOG_OK;
+}
@@ -0,0 +1,973 @@
+#include "event_uploader.h"
+
+#include "audio_arena.h"
+#include "audio_wav.h"
+#include "cJSON.h"
+#include "detector.h"
+#include "event_classifier.h"
+#include "event_features.h"
+#include "esp_crt_bundle.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "event_log.h"
+#include "metrics.h"
+#include "mic_history.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include "wifi_config.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+static const char *TAG = "EVENT_UPLOAD";
+
+#define EVENT_QUEUE_EVENTS CONFIG_EVENT_UPLOAD_QUEUE_EVENTS
+#define EVENT_BATCH_EVENTS CONFIG_EVENT_UPLOAD_BATCH_EVENTS
+#define EVENT_BATCH_MS     CONFIG_EVENT_UPLOAD_BATCH_MS
+#define EVENT_TASK_STACK   6144
+#define EVENT_TASK_PRIO    CONFIG_EVENT_UPLOAD_TASK_PRIORITY
+#define EVENT_TASK_CORE    CONFIG_EVENT_UPLOAD_TASK_CORE
+#define EVENT_RETRY_MS     1000
+#define EVENT_RETRY_MAX_MS 60000
+// The detector clamps its event window to this many samples per channel.
+#define EVENT_CLIP_MAX_FRAMES (TAP_COUNT * TAP_SIZE)
+#define EVENT_BOUNDARY     "bomchecker-event-batch"
+#define EVENT_PART_HDR_MAX 192
+// History clips are sent in pieces of this many frames.
+#define EVENT_PIECE_FRAMES 256
+#define EVENT_HISTORY_POLL_MS 20
+// Wall-clock times before this (2020-01-01) mean the clock was never set.
+#define EVENT_UNIX_VALID_S 1577836800LL
+#define EVENT_LOG_PARTITION "evlog"
+#define EVENT_LOG_SUBTYPE   0x40
+#if CONFIG_EVENT_UPLOAD_PAYLOAD_CLIP
+#define EVENT_SEND_FEATURES 0
+#else
+#define EVENT_SEND_FEATURES 1
+#endif
+#if CONFIG_EVENT_UPLOAD_PAYLOAD_FEATURES
+#define EVENT_SEND_CLIPS 0
+#else
+#define EVENT_SEND_CLIPS 1
+#endif
+#if CONFIG_EVENT_CLASSIFIER
+#define EVENT_CLASSIFY 1
+#else
+#define EVENT_CLASSIFY 0
+#endif
+// The classifier scores the feature vector whether or not it is uploaded.
+#define EVENT_NEED_FEATURES (EVENT_SEND_FEATURES || EVENT_CLASSIFY)
+#ifdef CONFIG_EVENT_UPLOAD_REPLAY_MS
+#define EVENT_REPLAY_MS CONFIG_EVENT_UPLOAD_REPLAY_MS
+#else
+#define EVENT_REPLAY_MS 0
+#endif
+
+typedef struct {
+  uint32_t boot_id; // tells apart seq numbers of events logged across reboots
+  uint32_t seq;
+  uint64_t peak_index;
+  uint64_t window_start;
+  int frames;
+  int pre_samples;
+  int sample_rate;
+  uint8_t fired;
+  bool offset_valid;
+  int32_t lr_offset;
+  uint32_t level_left;
+  uint32_t level_right;
+  uint32_t det_level;
+  uint32_t hits; // detections coalesced into the event
+  float det_rms;
+  float det_energy;
+  int64_t uptime_us;
+  int64_t unix_ms; // 0 while the wall clock is not set
+  int64_t peak_us; // capture time of peak_index, esp_timer clock
+  int64_t peak_unix_us; // the same on the wall clock, 0 while unset
+  bool has_features; // set once the upload task ran the feature stage
+  event_features features;
+  bool classified; // scored by the second stage; only kept ones go out
+  float score;
+  // The full clip, still in the mic history; clip_frames drops to 0 once it
+  // is not, and pcm is sent instead.
+  uint32_t clip_epoch;
+  uint64_t clip_start;
+  int clip_frames;
+  int16_t pcm[EVENT_CLIP_MAX_FRAMES * 2]; // interleaved L/R, WAV order
+} event_slot_t;
+
+// Same pointer-passing scheme as the push chunk pool: the detector takes a
+// slot from s_free, fills it and queues it on s_filled for the task.
+static event_slot_t *s_slots = NULL;
+static QueueHandle_t s_free = NULL;
+static QueueHandle_t s_filled = NULL;
+// Feature stage scratch, upload task only: one channel of the analysis
+// window (plus room for the other, which mic_history_read() also fills)
+// and the FFT buffer.
+static int16_t *s_feature_pcm = NULL;
+static float *s_feature_work = NULL;
+static TaskHandle_t s_task = NULL;
+static SemaphoreHandle_t s_cfg_mutex = NULL;
+static char s_url[AUDIO_URL_MAX_LEN];
+static volatile bool s_enabled = false;
+static uint32_t s_seq = 0; // detection task only
+static uint32_t s_boot_id = 0;
+static event_log *s_log = NULL; // upload task only, once mounted
+static volatile uint32_t s_queued = 0;
+static volatile uint32_t s_dropped = 0;
+static volatile uint32_t s_uploaded = 0;
+static volatile uint32_t s_batches = 0;
+static volatile uint32_t s_failures = 0;
+static volatile int s_last_status = -1;
+static volatile uint32_t s_stored = 0;
+static volatile uint32_t s_replayed = 0;
+static volatile uint32_t s_rejected = 0;
+// Upload task only, once loaded.
+static event_classifier s_model;
+static bool s_model_ready = false;
+
+static metrics_counter classifier_passed = METRICS_COUNTER_INIT(
+    "event_classifier_passed_total", "Events the classifier forwarded.");
+static metrics_counter classifier_rejected = METRICS_COUNTER_INIT(
+    "event_classifier_rejected_total", "Events the classifier dropped.");
+static metrics_histogram classifier_us = METRICS_HISTOGRAM_INIT(
+    "event_classifier_us", "Classifier inference time per event.", 5, 10, 20,
+    50, 100, 200, 500);
+
+bool event_uploader_mode(const char *mode) {
+  return mode != NULL && strcmp(mode, "events") == 0;
+}
+
+static bool event_uploader_should_run(const audio_config_t *cfg) {
+  return cfg->enabled && event_uploader_mode(cfg->mode) &&
+         cfg->upload_url[0] != '\0';
+}
+
+// Runs on the detection task: copy the window and return.
+static void event_uploader_on_event(const impulse_event *event, void *ctx) {
+  (void)ctx;
+  if (!s_enabled) {
+    return;
+  }
+  event_slot_t *slot = NULL;
+  if (xQueueReceive(s_free, &slot, 0) != pdTRUE) {
+    s_dropped++;
+    return;
+  }
+
+  const impulse_stereo_result *hit = event->hit;
+  int frames = event->window_length;
+  if (frames > EVENT_CLIP_MAX_FRAMES) {
+    frames = EVENT_CLIP_MAX_FRAMES;
+  }
+  slot->boot_id = s_boot_id;
+  slot->seq = s_seq++;
+  slot->peak_index = event->peak_index;
+  slot->window_start = event->window_start;
+  slot->frames = frames;
+  slot->pre_samples = event->pre_samples;
+  slot->sample_rate = event->sample_rate;
+  slot->fired = hit->fired;
+  slot->offset_valid = hit->offset_valid;
+  slot->lr_offset = hit->lr_offset;
+  slot->level_left = (hit->fired & IMPULSE_CH_LEFT) ? hit->left.level : 0;
+  slot->level_right = (hit->fired & IMPULSE_CH_RIGHT) ? hit->right.level : 0;
+  slot->det_level = event->criteria->det_level;
+  slot->hits = event->hits;
+  slot->det_rms = event->criteria->det_rms;
+  slot->det_energy = event->criteria->det_energy;
+  slot->uptime_us = event->detected_us;
+  slot->peak_us = event->peak_us;
+  slot->peak_unix_us = event->peak_unix_us;
+  slot->has_features = false;
+  slot->classified = false;
+  slot->clip_epoch = event->epoch;
+  slot->clip_start = event->clip_start;
+  slot->clip_frames = event->clip_length;
+
+  struct timeval tv;
+  slot->unix_ms = 0;
+  if (gettimeofday(&tv, NULL) == 0 && tv.tv_sec >= EVENT_UNIX_VALID_S) {
+    slot->unix_ms = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+  }
+
+  for (int i = 0; i < frames; i++) {
+    slot->pcm[2 * i] = event->left[i];
+    slot->pcm[2 * i + 1] = event->right[i];
+  }
+  // s_filled is as deep as the pool, so this cannot fail.
+  xQueueSend(s_filled, &slot, 0);
+  s_queued++;
+}
+
+// Either the history clip or the window copied on detection.
+static int event_frames(const event_slot_t *ev) {
+  return ev->clip_frames > 0 ? ev->clip_frames : ev->frames;
+}
+
+static uint64_t event_start(const event_slot_t *ev) {
+  return ev->clip_frames > 0 ? ev->clip_start : ev->window_start;
+}
+
+// Polls until [start, start + length) of the event's history epoch is
+// captured; bounded in case capture stops, by the range length plus a second.
+static mic_history_state event_uploader_wait_history(const event_slot_t *ev,
+                                                     uint64_t start,
+                                                     int length) {
+  const int rate = ev->sample_rate > 0 ? ev->sample_rate : 1;
+  const int64_t range_ms = (int64_t)length * 1000 / rate;
+  const TickType_t deadline =
+      xTaskGetTickCount() + pdMS_TO_TICKS(range_ms + 1000);
+  mic_history_state st;
+  while ((st = mic_history_check(ev->clip_epoch, start, length)) ==
+             MIC_HISTORY_PENDING &&
+         (int32_t)(deadline - xTaskGetTickCount()) > 0) {
+    vTaskDelay(pdMS_TO_TICKS(EVENT_HISTORY_POLL_MS));
+  }
+  return st;
+}
+
+// The feature stage looks at the louder of the channels that fired.
+static bool event_feature_left(const event_slot_t *ev) {
+  return ev->level_left >= ev->level_right;
+}
+
+// Computes the features over the analysis window around the peak: from the
+// history while it holds the window (waiting for it to be captured when
+// `wait`), otherwise from whatever part of the copied window overlaps it.
+static void event_uploader_analyze(event_slot_t *ev, bool wait) {
+  int16_t *x = s_feature_pcm;
+  int16_t *other = s_feature_pcm + EVENT_FEATURE_FFT_N;
+  const bool left = event_feature_left(ev);
+  const uint64_t start = ev->peak_index > EVENT_FEATURE_PRE
+                             ? ev->peak_index - EVENT_FEATURE_PRE
+                             : 0;
+  const uint64_t end = start + EVENT_FEATURE_FFT_N;
+
+  int n = 0;
+  if (ev->clip_frames > 0) {
+    const uint64_t clip_end = ev->clip_start + (uint64_t)ev->clip_frames;
+    const uint64_t from = start > ev->clip_start ? start : ev->clip_start;
+    const uint64_t to = end < clip_end ? end : clip_end;
+    const int len = to > from ? (int)(to - from) : 0;
+    if (len > 0 &&
+        (!wait || event_uploader_wait_history(ev, from, len) ==
+                      MIC_HISTORY_OK) &&
+        mic_history_read(ev->clip_epoch, from, len, left ? x : other,
+                         left ? other : x) == MIC_HISTORY_OK) {
+      n = len;
+    }
+  }
+  if (n == 0) {
+    const uint64_t win_end = ev->window_start + (uint64_t)ev->frames;
+    const uint64_t from = start > ev->window_start ? start : ev->window_start;
+    const uint64_t to = end < win_end ? end : win_end;
+    const int offset = (int)(from - ev->window_start);
+    n = to > from ? (int)(to - from) : 0;
+    for (int k = 0; k < n; k++) {
+      x[k] = ev->pcm[2 * (offset + k) + (left ? 0 : 1)];
+    }
+  }
+  event_features_compute(x, n, ev->sample_rate, s_feature_work,
+                         &ev->features);
+  ev->has_features = true;
+}
+
+// Waits until the history clips of the batch are captured (the post-event
+// part lies in the future at detection time), falls back to the window for
+// those that are gone, and runs the feature stage on events that have not
+// been through it.
+static void event_uploader_resolve_clips(event_slot_t *const *batch,
+                                         int count) {
+  for (int i = 0; i < count; i++) {
+    event_slot_t *ev = batch[i];
+    if (EVENT_SEND_CLIPS && ev->clip_frames > 0 &&
+        event_uploader_wait_history(ev, ev->clip_start, ev->clip_frames) !=
+            MIC_HISTORY_OK) {
+      ESP_LOGW(TAG, "Clip of event %lu left the history, sending %d frames",
+               (unsigned long)ev->seq, ev->frames);
+      ev->clip_frames = 0;
+    }
+    if (EVENT_NEED_FEATURES && !ev->has_features) {
+      event_uploader_analyze(ev, true);
+    }
+  }
+}
+
+// One decimal is all the features resolve, and it keeps the record short.
+static double event_feature_value(float v) {
+  return round((double)v * 10.0) / 10.0;
+}
+
+static void event_uploader_add_features(cJSON *item, const event_slot_t *ev) {
+  cJSON *features = cJSON_AddObjectToObject(item, "features");
+  cJSON *bands = features ? cJSON_AddArrayToObject(features, "bandsDb") : NULL;
+  if (!bands) {
+    return;
+  }
+  for (int b = 0; b < EVENT_FEATURE_BANDS; b++) {
+    const double db = event_feature_value(ev->features.band_db[b]);
+    cJSON_AddItemToArray(bands, cJSON_CreateNumber(db));
+  }
+  cJSON_AddStringToObject(features, "channel",
+                          event_feature_left(ev) ? "L" : "R");
+  cJSON_AddNumberToObject(features, "centroidHz",
+                          event_feature_value(ev->features.centroid_hz));
+  cJSON_AddNumberToObject(features, "riseUs",
+                          event_feature_value(ev->features.rise_us));
+  cJSON_AddNumberToObject(features, "peakToRmsDb",
+                          event_feature_value(ev->features.peak_to_rms_db));
+}
+
+static char *event_uploader_build_json(event_slot_t *const *batch, int count) {
+  cJSON *root = cJSON_CreateArray();
+  if (!root) {
+    return NULL;
+  }
+  for (int i = 0; i < count; i++) {
+    const event_slot_t *ev = batch[i];
+    cJSON *item = cJSON_CreateObject();
+    if (!item) {
+      cJSON_Delete(root);
+      return NULL;
+    }
+    char clip[12];
+    snprintf(clip, sizeof(clip), "clip%d", i);
+    cJSON_AddNumberToObject(item, "bootId", ev->boot_id);
+    cJSON_AddNumberToObject(item, "seq", ev->seq);
+    cJSON_AddNumberToObject(item, "peakIndex", (double)ev->peak_index);
+    cJSON_AddNumberToObject(item, "windowStart", (double)event_start(ev));
+    cJSON_AddNumberToObject(item, "preSamples",
+                            (double)(ev->peak_index - event_start(ev)));
+    cJSON_AddNumberToObject(item, "frames", event_frames(ev));
+    cJSON_AddNumberToObject(item, "sampleRate", ev->sample_rate);
+    cJSON_AddStringToObject(
+        item, "channels",
+        ev->fired == (IMPULSE_CH_LEFT | IMPULSE_CH_RIGHT) ? "LR"
+        : (ev->fired & IMPULSE_CH_LEFT)                   ? "L"
+                                                          : "R");
+    if (ev->offset_valid) {
+      cJSON_AddNumberToObject(item, "lrOffset", ev->lr_offset);
+    } else {
+      cJSON_AddNullToObject(item, "lrOffset");
+    }
+    cJSON_AddNumberToObject(item, "levelLeft", ev->level_left);
+    cJSON_AddNumberToObject(item, "levelRight", ev->level_right);
+    cJSON_AddNumberToObject(item, "detLevel", ev->det_level);
+    cJSON_AddNumberToObject(item, "hits", ev->hits);
+    cJSON_AddNumberToObject(item, "detRms", ev->det_rms);
+    cJSON_AddNumberToObject(item, "detEnergy", ev->det_energy);
+    cJSON_AddNumberToObject(item, "uptimeMs", (double)(ev->uptime_us / 1000));
+    if (ev->unix_ms) {
+      cJSON_AddNumberToObject(item, "unixMs", (double)ev->unix_ms);
+    } else {
+      cJSON_AddNullToObject(item, "unixMs");
+    }
+    // Sample-accurate, unlike the detection time above: nodes synced to the
+    // same SNTP server can be compared on peakUnixUs.
+    cJSON_AddNumberToObject(item, "peakUs", (double)ev->peak_us);
+    if (ev->peak_unix_us) {
+      cJSON_AddNumberToObject(item, "peakUnixUs", (double)ev->peak_unix_us);
+    } else {
+      cJSON_AddNullToObject(item, "peakUnixUs");
+    }
+    if (EVENT_SEND_FEATURES && ev->has_features) {
+      event_uploader_add_features(item, ev);
+    }
+    if (ev->classified) {
+      cJSON_AddNumberToObject(item, "score", event_feature_value(ev->score));
+    }
+    if (EVENT_SEND_CLIPS) {
+      cJSON_AddStringToObject(item, "clip", clip);
+    }
+    cJSON_AddItemToArray(root, item);
+  }
+  char *json = cJSON_PrintUnformatted(root);
+  cJSON_Delete(root);
+  return json;
+}
+
+// Part headers are formatted twice, once to size the body for
+// Content-Length and once to send them.
+static int event_uploader_part_header(char *buf, size_t cap, int clip,
+                                      const event_slot_t *ev) {
+  if (clip < 0) {
+    return snprintf(buf, cap,
+                    "--" EVENT_BOUNDARY "\r\n"
+                    "Content-Disposition: form-data; name=\"events\"\r\n"
+                    "Content-Type: application/json\r\n\r\n");
+  }
+  return snprintf(buf, cap,
+                  "--" EVENT_BOUNDARY "\r\n"
+                  "Content-Disposition: form-data; name=\"clip%d\"; "
+                  "filename=\"event-%lu.wav\"\r\n"
+                  "Content-Type: audio/wav\r\n\r\n",
+                  clip, (unsigned long)ev->seq);
+}
+
+static size_t event_uploader_clip_bytes(const event_slot_t *ev) {
+  return AUDIO_WAV_HEADER_BYTES +
+         (size_t)event_frames(ev) * 2 * sizeof(int16_t);
+}
+
+static bool event_uploader_write_all(esp_http_client_handle_t client,
+                                     const char *buf, int len) {
+  while (len > 0) {
+    int written = esp_http_client_write(client, buf, len);
+    if (written <= 0) {
+      return false;
+    }
+    buf += written;
+    len -= written;
+  }
+  return true;
+}
+
+// Interleaves a history clip into the body piece by piece. Fails when the
+// reader laps the clip mid-send; the batch is then retried with the window.
+static bool event_uploader_write_clip(esp_http_client_handle_t client,
+                                      event_slot_t *ev) {
+  static int16_t left[EVENT_PIECE_FRAMES];
+  static int16_t right[EVENT_PIECE_FRAMES];
+  static int16_t piece[EVENT_PIECE_FRAMES * 2];
+  for (int done = 0; done < ev->clip_frames;) {
+    int n = ev->clip_frames - done;
+    n = n < EVENT_PIECE_FRAMES ? n : EVENT_PIECE_FRAMES;
+    if (mic_history_read(ev->clip_epoch, ev->clip_start + (uint64_t)done, n,
+                         left, right) != MIC_HISTORY_OK) {
+      ESP_LOGW(TAG, "Clip of event %lu overwritten during upload",
+               (unsigned long)ev->seq);
+      ev->clip_frames = 0;
+      return false;
+    }
+    for (int k = 0; k < n; k++) {
+      piece[2 * k] = left[k];
+      piece[2 * k + 1] = right[k];
+    }
+    if (!event_uploader_write_all(client, (const char *)piece,
+                                  n * 2 * (int)sizeof(int16_t))) {
+      return false;
+    }
+    done += n;
+  }
+  return true;
+}
+
+static const char k_closing[] = "--" EVENT_BOUNDARY "--\r\n";
+
+// Sends one batch; returns the HTTP status, or -1 when it never got one.
+static int event_uploader_post(const char *url, event_slot_t *const *batch,
+                               int count) {
+  event_uploader_resolve_clips(batch, count);
+  char *json = event_uploader_build_json(batch, count);
+  if (!json) {
+    ESP_LOGE(TAG, "Failed to build event JSON");
+    return -1;
+  }
+  const int json_len = (int)strlen(json);
+
+  char part[EVENT_PART_HDR_MAX];
+  int total = event_uploader_part_header(part, sizeof(part), -1, NULL) +
+              json_len + 2;
+  for (int i = 0; EVENT_SEND_CLIPS && i < count; i++) {
+    total += event_uploader_part_header(part, sizeof(part), i, batch[i]) +
+             (int)event_uploader_clip_bytes(batch[i]) + 2;
+  }
+  total += (int)sizeof(k_closing) - 1;
+
+  esp_http_client_config_t http_cfg = {
+      .url = url,
+      .method = HTTP_METHOD_POST,
+      .timeout_ms = 10000,
+      .crt_bundle_attach = esp_crt_bundle_attach,
+  };
+  esp_http_client_handle_t client = esp_http_client_init(&http_cfg);
+  if (!client) {
+    free(json);
+    return -1;
+  }
+  esp_http_client_set_header(client, "Content-Type",
+                             "multipart/form-data; boundary=" EVENT_BOUNDARY);
+
+  int status = -1;
+  esp_err_t err = esp_http_client_open(client, total);
+  bool ok = err == ESP_OK;
+  if (!ok) {
+    ESP_LOGW(TAG, "HTTP open failed: %s", esp_err_to_name(err));
+  }
+
+  int len = event_uploader_part_header(part, sizeof(part), -1, NULL);
+  ok = ok && event_uploader_write_all(client, part, len) &&
+       event_uploader_write_all(client, json, json_len) &&
+       event_uploader_write_all(client, "\r\n", 2);
+  for (int i = 0; EVENT_SEND_CLIPS && ok && i < count; i++) {
+    event_slot_t *ev = batch[i];
+    uint8_t wav[AUDIO_WAV_HEADER_BYTES];
+    audio_wav_build_clip_header(wav, ev->sample_rate,
+                                (uint32_t)event_frames(ev));
+    len = event_uploader_part_header(part, sizeof(part), i, ev);
+    ok = event_uploader_write_all(client, part, len) &&
+         event_uploader_write_all(client, (const char *)wav, sizeof(wav));
+    if (ok && ev->clip_frames > 0) {
+      ok = event_uploader_write_clip(client, ev);
+    } else if (ok) {
+      ok = event_uploader_write_all(
+          client, (const char *)ev->pcm,
+          (int)(event_uploader_clip_bytes(ev) - sizeof(wav)));
+    }
+    ok = ok && event_uploader_write_all(client, "\r\n", 2);
+  }
+  ok = ok && event_uploader_write_all(client, k_closing,
+                                      (int)sizeof(k_closing) - 1);
+
+  if (ok && esp_http_client_fetch_headers(client) >= 0) {
+    status = esp_http_client_get_status_code(client);
+    int flushed = 0;
+    esp_http_client_flush_response(client, &flushed);
+  }
+  esp_http_client_close(client);
+  esp_http_client_cleanup(client);
+  free(json);
+  return status;
+}
+
+static void event_uploader_release(event_slot_t **batch, int *count) {
+  for (int i = 0; i < *count; i++) {
+    xQueueSend(s_free, &batch[i], 0);
+  }
+  *count = 0;
+}
+
+#if CONFIG_EVENT_UPLOAD_FLASH_LOG
+// A slot is logged as its bytes up to the end of its clip, so a layout
+// change of event_slot_t needs a new event_log sector magic.
+_Static_assert(offsetof(event_slot_t, pcm) +
+                       EVENT_CLIP_MAX_FRAMES * 2 * sizeof(int16_t) <=
+                   EVENT_LOG_MAX_RECORD,
+               "an event must fit one flash log sector");
+
+static int event_log_part_read(void *ctx, uint32_t offset, void *dst,
+                               size_t len) {
+  return esp_partition_read(ctx, offset, dst, len) == ESP_OK ? 0 : -1;
+}
+
+static int event_log_part_write(void *ctx, uint32_t offset, const void *src,
+                                size_t len) {
+  return esp_partition_write(ctx, offset, src, len) == ESP_OK ? 0 : -1;
+}
+
+static int event_log_part_erase(void *ctx, uint32_t offset) {
+  return esp_partition_erase_range(ctx, offset, EVENT_LOG_SECTOR_SIZE) == ESP_OK
+             ? 0
+             : -1;
+}
+#endif
+
+// Loaded on the upload task before the first event is scored; without a
+// valid model, events are forwarded unscored.
+static void event_uploader_open_model(void) {
+#if CONFIG_EVENT_CLASSIFIER
+  static bool tried = false;
+  if (tried) {
+    return;
+  }
+  tried = true;
+  FILE *f = fopen(CONFIG_EVENT_CLASSIFIER_MODEL_PATH, "rb");
+  if (!f) {
+    ESP_LOGW(TAG, "No classifier model at %s, events are not filtered",
+             CONFIG_EVENT_CLASSIFIER_MODEL_PATH);
+    return;
+  }
+  // One byte over the largest model, so an oversized file fails the load.
+  const size_t cap =
+      EVENT_CLASSIFIER_BLOB_BYTES(EVENT_CLASSIFIER_MAX_HIDDEN) + 1;
+  uint8_t *blob = malloc(cap);
+  const size_t len = blob ? fread(blob, 1, cap, f) : 0;
+  fclose(f);
+  s_model_ready = blob && event_classifier_load(&s_model, blob, len);
+  free(blob);
+  if (!s_model_ready) {
+    ESP_LOGE(TAG, "Invalid classifier model %s (%u B)",
+             CONFIG_EVENT_CLASSIFIER_MODEL_PATH, (unsigned)len);
+    return;
+  }
+  ESP_LOGI(TAG, "Classifier: %d hidden units, threshold %.2f",
+           s_model.hidden, (double)s_model.threshold);
+#endif
+}
+
+// Scores the events of the batch not scored yet and releases those below
+// the model's threshold. Returns how many are left in `batch`, in order.
+static int event_uploader_classify(event_slot_t **batch, int count) {
+  event_uploader_open_model();
+  if (!s_model_ready) {
+    return count;
+  }
+  int kept = 0;
+  for (int i = 0; i < count; i++) {
+    event_slot_t *ev = batch[i];
+    if (!ev->classified) {
+      if (!ev->has_features) {
+        event_uploader_analyze(ev, true);
+      }
+      const int64_t start = esp_timer_get_time();
+      ev->score = event_classifier_score(&s_model, &ev->features);
+      metrics_histogram_observe(&classifier_us,
+                                (uint32_t)(esp_timer_get_time() - start));
+      ev->classified = true;
+      if (ev->score < s_model.threshold) {
+        metrics_counter_inc(&classifier_rejected);
+        s_rejected++;
+        xQueueSend(s_free, &ev, 0);
+        continue;
+      }
+      metrics_counter_inc(&classifier_passed);
+    }
+    batch[kept++] = ev;
+  }
+  return kept;
+}
+
+// Mounted on the upload task the first time the mode runs; without the
+// partition, batches that fail stay in RAM and are retried from there.
+static void event_uploader_open_log(void) {
+#if CONFIG_EVENT_UPLOAD_FLASH_LOG
+  static bool tried = false;
+  if (tried) {
+    return;
+  }
+  tried = true;
+  const esp_partition_t *part = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, EVENT_LOG_SUBTYPE, EVENT_LOG_PARTITION);
+  if (!part) {
+    ESP_LOGW(TAG, "No \"%s\" partition, events are not kept offline",
+             EVENT_LOG_PARTITION);
+    return;
+  }
+  event_log *log = calloc(1, sizeof(*log));
+  if (!log) {
+    ESP_LOGE(TAG, "Failed to allocate the event log");
+    return;
+  }
+  const event_log_flash flash = {
+      .read = event_log_part_read,
+      .write = event_log_part_write,
+      .erase_sector = event_log_part_erase,
+      .ctx = (void *)part,
+  };
+  const enum event_log_state err =
+      event_log_open(log, &flash, part->size / EVENT_LOG_SECTOR_SIZE);
+  if (err != EVENT_LOG_OK) {
+    ESP_LOGE(TAG, "Event log mount failed (%d)", err);
+    free(log);
+    return;
+  }
+  ESP_LOGI(TAG, "Event log: %lu sectors, %lu events pending, %lu corrupt",
+           (unsigned long)log->sectors,
+           (unsigned long)event_log_pending(log),
+           (unsigned long)log->corrupt);
+  s_log = log;
+#endif
+}
+
+static size_t event_record_bytes(const event_slot_t *slot) {
+  return offsetof(event_slot_t, pcm) +
+         (size_t)slot->frames * 2 * sizeof(int16_t);
+}
+
+// Moves a batch that could not be delivered to the flash log and frees its
+// slots for new detections.
+static void event_uploader_spill(event_slot_t **batch, int *count) {
+  for (int i = 0; i < *count; i++) {
+    // The history has moved on by the time the log is replayed; take the
+    // features while it may still hold the analysis window.
+    if (EVENT_NEED_FEATURES && !batch[i]->has_features) {
+      event_uploader_analyze(batch[i], false);
+    }
+    batch[i]->clip_frames = 0;
+    if (event_log_append(s_log, batch[i], event_record_bytes(batch[i])) ==
+        EVENT_LOG_OK) {
+      s_stored++;
+    } else {
+      s_dropped++;
+    }
+  }
+  // On failure the records stay staged and go out with the next flush.
+  const enum event_log_state err = event_log_flush(s_log);
+  if (err != EVENT_LOG_OK) {
+    ESP_LOGW(TAG, "Event log flush failed (%d)", err);
+  }
+  event_uploader_release(batch, count);
+}
+
+// Reads the oldest logged events into free slots.
+static int event_uploader_load_backlog(event_slot_t **batch,
+                                       event_log_cursor *cursor) {
+  event_log_rewind(s_log, cursor);
+  int count = 0;
+  event_slot_t *slot = NULL;
+  while (count < EVENT_BATCH_EVENTS &&
+         xQueueReceive(s_free, &slot, 0) == pdTRUE) {
+    size_t len = 0;
+    const enum event_log_state st =
+        event_log_next(s_log, cursor, slot, sizeof(*slot), &len);
+    if (st == EVENT_LOG_OK && len >= offsetof(event_slot_t, pcm) &&
+        slot->frames >= 0 && slot->frames <= EVENT_CLIP_MAX_FRAMES &&
+        len == event_record_bytes(slot)) {
+      batch[count++] = slot;
+      continue;
+    }
+    xQueueSend(s_free, &slot, 0);
+    if (st == EVENT_LOG_EMPTY || st == EVENT_LOG_ERR_FLASH) {
+      break;
+    }
+    s_dropped++; // malformed record, skipped
+  }
+  return count;
+}
+
+static void event_uploader_task(void *arg) {
+  (void)arg;
+  event_slot_t *batch[EVENT_BATCH_EVENTS];
+  int count = 0;
+  uint32_t backoff_ms = EVENT_RETRY_MS;
+  TickType_t next_replay = 0;
+  char url[AUDIO_URL_MAX_LEN];
+
+  while (true) {
+    if (!s_enabled) {
+      // Events detected before the mode was switched off are discarded;
+      // the flash backlog is kept for when it comes back.
+      s_dropped += count + uxQueueMessagesWaiting(s_filled);
+      event_uploader_release(batch, &count);
+      event_slot_t *slot = NULL;
+      while (xQueueReceive(s_filled, &slot, 0) == pdTRUE) {
+        xQueueSend(s_free, &slot, 0);
+      }
+      backoff_ms = EVENT_RETRY_MS;
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+      continue;
+    }
+    event_uploader_open_log();
+
+    const bool online = is_wifi_connected();
+    const bool backlog = online && s_log && event_log_pending(s_log) > 0;
+
+    // Block for the first event, or until the next replay is due, then give
+    // later ones up to EVENT_BATCH_MS to join it. A batch kept from a failed
+    // POST is resent at once.
+    TickType_t wait = count ? 0 : pdMS_TO_TICKS(1000);
+    if (!count && backlog) {
+      const int32_t due = (int32_t)(next_replay - xTaskGetTickCount());
+      wait = due <= 0 ? 0 : (TickType_t)due < wait ? (TickType_t)due : wait;
+    }
+    TickType_t deadline = 0;
+    bool lingering = false;
+    while (count < EVENT_BATCH_EVENTS &&
+           xQueueReceive(s_filled, &batch[count], wait) == pdTRUE) {
+      count++;
+      if (!lingering) {
+        lingering = true;
+        deadline = xTaskGetTickCount() + pdMS_TO_TICKS(EVENT_BATCH_MS);
+      }
+      const int32_t left = (int32_t)(deadline - xTaskGetTickCount());
+      wait = left > 0 ? (TickType_t)left : 0;
+    }
+
+    if (EVENT_CLASSIFY && count > 0) {
+      count = event_uploader_classify(batch, count);
+    }
+
+    // Live events go first; the backlog is replayed one batch per
+    // EVENT_REPLAY_MS while nothing new is waiting.
+    bool replay = false;
+    event_log_cursor cursor;
+    if (count == 0) {
+      if (!backlog || (int32_t)(next_replay - xTaskGetTickCount()) > 0) {
+        continue;
+      }
+      count = event_uploader_load_backlog(batch, &cursor);
+      if (count == 0) {
+        if (cursor.consumed > 0) {
+          event_log_commit(s_log, &cursor); // only skipped records
+        }
+        continue;
+      }
+      replay = true;
+    } else if (!online && s_log) {
+      event_uploader_spill(batch, &count);
+      continue;
+    }
+
+    if (xSemaphoreTake(s_cfg_mutex, portMAX_DELAY) == pdTRUE) {
+      memcpy(url, s_url, sizeof(url));
+      xSemaphoreGive(s_cfg_mutex);
+    }
+    const int status = event_uploader_post(url, batch, count);
+    s_last_status = status;
+    if (status >= 200 && status < 300) {
+      s_uploaded += count;
+      s_batches++;
+      if (replay) {
+        s_replayed += count;
+        const enum event_log_state err = event_log_commit(s_log, &cursor);
+        if (err != EVENT_LOG_OK) {
+          // Overwritten meanwhile; the survivors are sent again.
+          ESP_LOGW(TAG, "Event log commit failed (%d)", err);
+        }
+        next_replay = xTaskGetTickCount() + pdMS_TO_TICKS(EVENT_REPLAY_MS);
+      }
+      event_uploader_release(batch, &count);
+      backoff_ms = EVENT_RETRY_MS;
+      continue;
+    }
+
+    s_failures++;
+    if (replay) {
+      event_uploader_release(batch, &count); // still in the log
+    } else if (s_log) {
+      event_uploader_spill(batch, &count);
+    }
+    ESP_LOGW(TAG, "Upload failed (status %d), retrying in %lu ms", status,
+             (unsigned long)backoff_ms);
+    // A config change notifies the task and cuts the wait short.
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(backoff_ms));
+    backoff_ms = backoff_ms >= EVENT_RETRY_MAX_MS / 2 ? EVENT_RETRY_MAX_MS
+                                                      : backoff_ms * 2;
+  }
+}
+
+// Slots are only allocated once the mode is used; most nodes stream.
+static bool event_uploader_alloc_slots(void) {
+  if (s_slots) {
+    return true;
+  }
+  if (EVENT_NEED_FEATURES) {
+    if (!s_feature_pcm) {
+      s_feature_pcm = audio_arena_alloc(
+          AUDIO_ARENA_LARGE, 2 * EVENT_FEATURE_FFT_N * sizeof(int16_t),
+          "event_features");
+    }
+    if (!s_feature_work) {
+      s_feature_work = audio_arena_alloc(
+          AUDIO_ARENA_LARGE, EVENT_FEATURE_WORK_FLOATS * sizeof(float),
+          "event_features");
+    }
+    if (!s_feature_pcm || !s_feature_work) {
+      ESP_LOGE(TAG, "Failed to allocate the feature stage");
+      return false;
+    }
+  }
+  // Clips are copied in once and read once by the uploader: large arena.
+  s_slots = audio_arena_alloc(AUDIO_ARENA_LARGE,
+                              EVENT_QUEUE_EVENTS * sizeof(event_slot_t),
+                              "event_slots");
+  if (!s_slots) {
+    ESP_LOGE(TAG, "Failed to allocate %d event slots (%u B)",
+             EVENT_QUEUE_EVENTS,
+             (unsigned)(EVENT_QUEUE_EVENTS * sizeof(event_slot_t)));
+    return false;
+  }
+  for (int i = 0; i < EVENT_QUEUE_EVENTS; i++) {
+    event_slot_t *slot = &s_slots[i];
+    xQueueSend(s_free, &slot, 0);
+  }
+  return true;
+}
+
+// Fields event_uploader_should_run() and the POST target depend on.
+#define EVENT_CONFIG_FIELDS                                                    \
+  (AUDIO_CONFIG_MODE | AUDIO_CONFIG_UPLOAD_URL | AUDIO_CONFIG_ENABLED)
+
+static void event_uploader_apply_config(const audio_config_t *config) {
+  if (!config || !s_cfg_mutex) {
+    return;
+  }
+  bool run = event_uploader_should_run(config);
+  if (run && !event_uploader_alloc_slots()) {
+    run = false;
+  }
+  xSemaphoreTake(s_cfg_mutex, portMAX_DELAY);
+  strncpy(s_url, config->upload_url, sizeof(s_url) - 1);
+  s_url[sizeof(s_url) - 1] = '\0';
+  xSemaphoreGive(s_cfg_mutex);
+  s_enabled = run;
+  ESP_LOGI(TAG, "Event upload %s", run ? "enabled" : "disabled");
+  if (s_task) {
+    xTaskNotifyGive(s_task);
+  }
+}
+
+static void event_uploader_on_config(const audio_config_t *config,
+                                     uint32_t changed, void *ctx) {
+  (void)ctx;
+  if (changed & EVENT_CONFIG_FIELDS) {
+    event_uploader_apply_config(config);
+  }
+}
+
+void event_uploader_init(void) {
+  s_boot_id = esp_random();
+  if (EVENT_CLASSIFY) {
+    metrics_register(&classifier_passed.base);
+    metrics_register(&classifier_rejected.base);
+    metrics_register(&classifier_us.base);
+  }
+  s_cfg_mutex = xSemaphoreCreateMutex();
+  s_free = xQueueCreate(EVENT_QUEUE_EVENTS, sizeof(event_slot_t *));
+  s_filled = xQueueCreate(EVENT_QUEUE_EVENTS, sizeof(event_slot_t *));
+  if (!s_cfg_mutex || !s_free || !s_filled) {
+    ESP_LOGE(TAG, "Failed to create synchronization objects");
+    return;
+  }
+
+  if (xTaskCreatePinnedToCore(event_uploader_task, "event_upload",
+                              EVENT_TASK_STACK, NULL, EVENT_TASK_PRIO, &s_task,
+                              EVENT_TASK_CORE) != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create event upload task");
+    s_task = NULL;
+    return;
+  }
+
+  audio_config_t cfg;
+  audio_config_get(&cfg);
+  event_uploader_apply_config(&cfg);
+  if (!audio_config_subscribe(event_uploader_on_config, NULL)) {
+    ESP_LOGE(TAG, "Failed to subscribe to audio config; changes apply after a reboot");
+  }
+  if (!impulse_detector_add_event_listener(event_uploader_on_event, NULL)) {
+    ESP_LOGE(TAG, "No detector listener slot left");
+  }
+}
+
+void event_uploader_get_stats(event_uploader_stats_t *stats) {
+  if (!stats) {
+    return;
+  }
+  stats->enabled = s_enabled;
+  stats->queued = s_queued;
+  stats->dropped = s_dropped;
+  stats->uploaded = s_uploaded;
+  stats->batches = s_batches;
+  stats->failures = s_failures;
+  stats->last_status = s_last_status;
+  stats->stored = s_stored;
+  stats->replayed = s_replayed;
+  stats->rejected = s_rejected;
+  const event_log *log = s_log;
+  stats->log_ready = log != NULL;
+  stats->backlog = log ? event_log_pending(log) : 0;
+  stats->log_lost = log ? log->lost : 0;
+}
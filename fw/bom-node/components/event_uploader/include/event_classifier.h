@@ -0,0 +1,58 @@
+#ifndef EVENT_CLASSIFIER_H
+#define EVENT_CLASSIFIER_H
+
+#include "event_features.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Optional second stage behind the median detector: a small int8 network
+// over an event's features (event_features.h) that tells impulses worth an
+// upload from the door slams and tool drops the detector criteria let through.
+// One hidden ReLU layer and a single logit; the size cap keeps inference
+// under a thousand multiply-accumulates, so its cost per event is bounded.
+//
+// Inputs, in order: the octave band levels, the centroid in kHz, the rise time
+// in ms and the peak-to-RMS ratio in dB. Each is quantized as
+// clamp(round((x - in_offset) / in_scale), -128, 127).
+// hidden[j] = clamp(round((b1[j] + sum_i w1[j][i] * x_q[i]) * m1), 0, 127)
+// logit     = (b2 + sum_j w2[j] * hidden[j]) * m2
+// An event is forwarded when logit >= threshold.
+//
+// The model blob is little-endian, without padding:
+//   u32 magic (EVENT_CLASSIFIER_MAGIC), u32 hidden,
+//   f32 in_offset[INPUTS], f32 in_scale[INPUTS], f32 m1, f32 m2,
+//   f32 threshold, i32 b2, i32 b1[hidden], i8 w1[hidden][INPUTS],
+//   i8 w2[hidden]
+
+#define EVENT_CLASSIFIER_INPUTS (EVENT_FEATURE_BANDS + 3)
+#define EVENT_CLASSIFIER_MAX_HIDDEN 32
+#define EVENT_CLASSIFIER_MAGIC 0x314d5645u // "EVM1"
+
+typedef struct {
+  int hidden;
+  float in_offset[EVENT_CLASSIFIER_INPUTS];
+  float in_scale[EVENT_CLASSIFIER_INPUTS];
+  float m1;
+  float m2;
+  float threshold;
+  int32_t b2;
+  int32_t b1[EVENT_CLASSIFIER_MAX_HIDDEN];
+  int8_t w1[EVENT_CLASSIFIER_MAX_HIDDEN][EVENT_CLASSIFIER_INPUTS];
+  int8_t w2[EVENT_CLASSIFIER_MAX_HIDDEN];
+} event_classifier;
+
+// Bytes of a blob with `hidden` units.
+#define EVENT_CLASSIFIER_BLOB_BYTES(hidden)                                    \
+  (8 + 4 * (2 * EVENT_CLASSIFIER_INPUTS + 4) +                                 \
+   (size_t)(hidden) * (4 + EVENT_CLASSIFIER_INPUTS + 1))
+
+// False, leaving `c` unusable, for a wrong magic, a hidden layer outside
+// 1..EVENT_CLASSIFIER_MAX_HIDDEN, a zero input scale or a size mismatch.
+bool event_classifier_load(event_classifier *c, const void *blob, size_t len);
+
+float event_classifier_score(const event_classifier *c,
+                             const event_features *f);
+
+#endif
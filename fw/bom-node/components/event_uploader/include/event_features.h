@@ -0,0 +1,35 @@
+#ifndef EVENT_FEATURES_H
+#define EVENT_FEATURES_H
+
+#include <stdint.h>
+
+// Compact description of one event, computed by the upload task over an
+// EVENT_FEATURE_FFT_N-sample window of one channel around the peak, so the
+// backend can classify events without decoding (or even receiving) audio.
+
+#define EVENT_FEATURE_FFT_N 1024 // power of two
+#define EVENT_FEATURE_BANDS 8    // octaves, the top one ending at fs / 2
+// Samples of the analysis window ahead of the peak.
+#define EVENT_FEATURE_PRE (EVENT_FEATURE_FFT_N / 4)
+// Scratch event_features_compute() needs: one complex float per FFT bin.
+#define EVENT_FEATURE_WORK_FLOATS (2 * EVENT_FEATURE_FFT_N)
+
+typedef struct {
+  // Energy per octave band, dB relative to a full-scale sine in the band.
+  // Band k spans bins [N/2 >> (BANDS - k), N/2 >> (BANDS - 1 - k)); band 0
+  // starts above DC.
+  float band_db[EVENT_FEATURE_BANDS];
+  float centroid_hz;    // energy-weighted mean frequency, DC excluded
+  float rise_us;        // onset (10 % of the peak magnitude) to the peak
+  float peak_to_rms_db; // crest factor over the window
+} event_features;
+
+// `n` <= EVENT_FEATURE_FFT_N samples, Hann-windowed and zero-padded to the
+// FFT length. The peak is the largest magnitude in `x`; the onset is the
+// earliest sample before it reaching 10 % of that, with no gap of more than
+// a millisecond below it. A silent window gives every band -120 dB and zero
+// for the rest.
+void event_features_compute(const int16_t *x, int n, int sample_rate,
+                            float *work, event_features *out);
+
+#endif
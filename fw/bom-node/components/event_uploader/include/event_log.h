@@ -0,0 +1,104 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Append-only ring log of variable-length records on raw NOR flash, used to
+// keep events across Wi-Fi outages and reboots.
+//
+// Records are staged in RAM and written one whole sector at a time (payload
+// first, header last, so a torn write leaves an unreadable sector rather than
+// a bad one). Each 20-byte sector header holds a sequence number, a record
+// count and a payload checksum; mounting reads only those headers, so the
+// headers are the index. When the ring is full the oldest sector is erased
+// and its unread records are counted as lost.
+//
+// Replay is at least once: commit programs a "drained" word in each sector
+// the read position has left, so after a reboot the records before the read
+// position in a half-read sector are read again.
+
+#define EVENT_LOG_SECTOR_SIZE 4096
+#define EVENT_LOG_HEADER_SIZE 20
+#define EVENT_LOG_RECORD_HEADER_SIZE 4
+// Largest record that fits a sector on its own.
+#define EVENT_LOG_MAX_RECORD                                                   \
+  (EVENT_LOG_SECTOR_SIZE - EVENT_LOG_HEADER_SIZE - EVENT_LOG_RECORD_HEADER_SIZE)
+
+enum event_log_state {
+  EVENT_LOG_OK = 0,
+  EVENT_LOG_ERR_INVALID_ARG = -400, // NULL pointer or bad geometry
+  EVENT_LOG_ERR_TOO_LARGE = -401,   // record over EVENT_LOG_MAX_RECORD
+  EVENT_LOG_ERR_FLASH = -402,       // a flash callback failed
+  EVENT_LOG_ERR_STALE = -403,       // cursor predates an overwrite of the tail
+  EVENT_LOG_EMPTY = -404            // no more records behind the cursor
+};
+
+// Flash access; offsets are from the start of the log area. Each callback
+// returns 0 on success. erase_sector erases EVENT_LOG_SECTOR_SIZE bytes.
+typedef struct {
+  int (*read)(void *ctx, uint32_t offset, void *dst, size_t len);
+  int (*write)(void *ctx, uint32_t offset, const void *src, size_t len);
+  int (*erase_sector)(void *ctx, uint32_t offset);
+  void *ctx;
+} event_log_flash;
+
+// Read position. Obtained from event_log_rewind(), advanced by
+// event_log_next() and made durable by event_log_commit().
+typedef struct {
+  uint32_t sector;  // sector holding the next record
+  uint16_t index;   // records of `sector` already behind the cursor
+  uint16_t offset;  // payload offset of the next record in `sector`
+  uint16_t count;   // records in `sector`
+  uint32_t left;     // records still ahead of the cursor
+  uint32_t consumed; // records read since event_log_rewind()
+  uint32_t overwrites; // event_log.overwrites when the cursor was taken
+} event_log_cursor;
+
+typedef struct {
+  event_log_flash flash;
+  uint32_t sectors;
+  uint32_t head;      // sector written last
+  uint32_t next_seq;  // sequence number of the next sector written
+  event_log_cursor tail; // oldest unconsumed record
+  uint32_t overwrites;   // times the tail sector was erased for new data
+  uint32_t lost;         // unread records erased by overwrites
+  uint32_t corrupt;      // sectors skipped on a bad header or checksum
+  uint16_t stage_used;   // payload bytes in `stage`
+  uint16_t stage_count;  // records in `stage`
+  uint8_t stage[EVENT_LOG_SECTOR_SIZE];
+} event_log;
+
+// Mounts `sectors` sectors (>= 2) of flash, finding the newest sector and the
+// oldest unconsumed record from the sector headers.
+enum event_log_state event_log_open(event_log *log, const event_log_flash *flash,
+                                    uint32_t sectors);
+
+// Stages one record; a full stage is flushed first.
+enum event_log_state event_log_append(event_log *log, const void *data,
+                                      size_t len);
+
+// Writes staged records to the next sector. Call at the end of a batch.
+enum event_log_state event_log_flush(event_log *log);
+
+// Records on flash not yet committed as consumed (staged ones excluded).
+static inline uint32_t event_log_pending(const event_log *log) {
+  return log->tail.left;
+}
+
+// Cursor at the oldest unconsumed record.
+void event_log_rewind(const event_log *log, event_log_cursor *cursor);
+
+// Copies the record at `cursor` into `buf`, stores its length in `len` and
+// advances the cursor. Returns EVENT_LOG_EMPTY when no record is left, and
+// EVENT_LOG_ERR_TOO_LARGE when the record is longer than `cap`; it is then
+// skipped, so one bad record cannot stall replay.
+enum event_log_state event_log_next(event_log *log, event_log_cursor *cursor,
+                                    void *buf, size_t cap, size_t *len);
+
+// Marks every record before `cursor` consumed.
+enum event_log_state event_log_commit(event_log *log,
+                                      const event_log_cursor *cursor);
+
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "audio_config.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Audio mode "events": instead of streaming, every detected impulse is
+// queued with its pre/post window as a WAV clip and POSTed to upload_url in
+// batches, as multipart/form-data: an "events" part with a JSON array of
+// event records, then one audio/wav part per event, named by the record's
+// "clip" field.
+//
+// CONFIG_EVENT_UPLOAD_PAYLOAD adds a "features" object to each record
+// (event_features.h): "bandsDb", eight octave band levels ending at
+// sampleRate / 2, "centroidHz", "riseUs" and "peakToRmsDb", computed on the
+// upload task over the "channel" that fired louder. With features only, no
+// WAV parts are sent and records carry no "clip".
+//
+// With CONFIG_EVENT_CLASSIFIER, events are scored by an int8 network over
+// those features (event_classifier.h) before they are batched; only those at
+// or above the model's threshold are uploaded, with their "score".
+//
+// Batches that cannot be delivered (Wi-Fi down, POST failed) go to a flash
+// ring log (see event_log.h) and are replayed at a limited rate once uploads
+// succeed again.
+
+// Registers the detector's event listener, starts the upload task and
+// follows audio config changes. Call before impulse_detector_start().
+void event_uploader_init(void);
+bool event_uploader_mode(const char *mode);
+
+typedef struct {
+  bool enabled;
+  uint32_t queued;   // events accepted from the detector
+  uint32_t dropped;  // events lost to a full queue or a disabled mode
+  uint32_t uploaded; // events the server acknowledged (2xx)
+  uint32_t batches;  // successful POSTs
+  uint32_t failures; // failed POSTs; their events are logged or retried
+  int last_status;   // HTTP status of the last POST, or -1
+  bool log_ready;    // flash log mounted
+  uint32_t stored;   // events written to the flash log
+  uint32_t replayed; // logged events uploaded later
+  uint32_t rejected; // events the second-stage classifier dropped
+  uint32_t backlog;  // logged events still to replay
+  uint32_t log_lost; // logged events overwritten before replay
+} event_uploader_stats_t;
+
+void event_uploader_get_stats(event_uploader_stats_t *stats);
@@ -4,11 +4,18 @@
  * This function configures and starts the impulse detector for both
  * left and right channels. It:
  *  - Reads the microphone configuration via mic_get_config().
- *  - Computes the pre/post event window within the stored tap buffer.
- *  - Initializes the internal impulse_detector instances.
- *  - Registers impulse_detection_on_tap as the microphone tap callback.
+ *  - Computes the pre/post event window around a detected peak.
+ *  - Initializes the stereo impulse detector for the mic geometry
+ *    (specialised path for MEDIAN_GEOMETRIES entries, generic otherwise).
+ *  - Creates and pins the impulse_detection_task FreeRTOS task (core and
+ *    priority from the "Task placement" Kconfig menu).
+ *  - Subscribes impulse_detection_on_tap to the microphone taps. It
+ *    only queues the tap view on a lock-free SPSC queue and wakes the task;
+ *    all detector work runs on the detection task, off the reader's core.
+ *  - Registers a mic config listener: after a runtime reconfiguration the
+ *    detection task rebuilds the detector for the new geometry and drops
+ *    taps captured under the previous configuration.
  *  - Starts the microphone stream using mic_start().
- *  - Creates and pins the impulse_detection_task FreeRTOS task.
  *
  * Usage requirements:
  *  - mic_init() must be called successfully before calling this function,
@@ -16,125 +23,630 @@
  *
  * Side effects:
  *  - Starts audio capture.
- *  - Spawns a background task that continuously processes tap data and
- *    logs when an impulse is detected.
+ *  - Spawns a background task that continuously processes tap data,
+ *    coalesces hits within the refractory window, snapshots the event window
+ *    of the strongest one from the microphone ring and, once the window has
+ *    passed, logs the impulse and hands it to the event listener, if set.
  */
 
 #include "detector.h"
+#include "audio_arena.h"
+#include "boot_timing.h"
+#include "impulse_coalesce.h"
+#include "median_bench.h"
 #include "median_detection.h"
+#include "metrics.h"
+#include "trace.h"
+#include "mic_history.h"
 #include "mic_input.h"
+#include "spsc_queue.h"
 
 #include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/semphr.h"
 #include "freertos/task.h"
 
+#include <math.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 static const char *TAG = "IMPULSE";
 
-enum { MAX_EVENT_SAMPLES = TAP_COUNT * TAP_SIZE };
+#define DETECTION_TASK_STACK 8192
+#define DETECTION_TASK_PRIO CONFIG_IMPULSE_DETECTION_TASK_PRIORITY
+#define DETECTION_TASK_CORE CONFIG_IMPULSE_DETECTION_TASK_CORE
+// Queued views must still be in the mic ring when they are consumed, so the
+// queue is no deeper than the ring's headroom.
+#define DETECTION_QUEUE_TAPS MIC_RING_HEADROOM_TAPS
+// Closed groups waiting for the tail of their window. With a short
+// refractory window one impulse can close a group every few taps while
+// the first one's window is still coming in.
+#define DETECTION_CLOSED_GROUPS 8
+#ifdef CONFIG_IMPULSE_DETECTION_REFRACTORY_MS
+#define DETECTION_REFRACTORY_MS CONFIG_IMPULSE_DETECTION_REFRACTORY_MS
+#else
+#define DETECTION_REFRACTORY_MS 0
+#endif
 
-static impulse_detector detL;
-static impulse_detector detR;
-static SemaphoreHandle_t detection_sem = NULL;
+// The event buffers hold the detector window of the largest geometry that
+// has a specialised instance; a window is further limited to what the mic
+// ring retains for the geometry in use (impulse_detection_configure()).
+#define DETECTION_GEOM_SPAN(tc, ts) char span_##tc##x##ts[(tc) * (ts)];
+typedef union {
+  char span_default[TAP_COUNT * TAP_SIZE];
+  MEDIAN_GEOMETRIES(DETECTION_GEOM_SPAN)
+} detection_geometry_spans;
+#undef DETECTION_GEOM_SPAN
+enum { MAX_EVENT_SAMPLES = sizeof(detection_geometry_spans) };
+
+static impulse_stereo_detector det;
+// Detector state is hot, touched every tap: internal RAM (audio_arena.h).
+static audio_arena_slot det_slot;
+static uint32_t det_epoch = 0;
+static spsc_queue tap_queue;
+static TaskHandle_t detection_task = NULL;
+// Full CPU clock while the queue drains; NULL without CONFIG_PM_ENABLE.
+static esp_pm_lock_handle_t detection_pm_lock = NULL;
+static mic_subscription *tap_sub = NULL;
+static metrics_counter taps_dropped = METRICS_COUNTER_INIT(
+    "impulse_taps_dropped_total", "Taps the reader could not queue for the detector.");
+static metrics_counter detector_resets =
+    METRICS_COUNTER_INIT("impulse_resets_total", "Detector restarts after lost taps.");
+static metrics_counter detections =
+    METRICS_COUNTER_INIT("impulse_detections_total", "Impulses detected.");
+static metrics_counter hits_coalesced = METRICS_COUNTER_INIT(
+    "impulse_hits_coalesced_total", "Hits merged into an earlier detection.");
+static metrics_counter windows_lost = METRICS_COUNTER_INIT(
+    "impulse_windows_lost_total", "Detections whose window had left the mic ring.");
+static metrics_histogram tap_us = METRICS_HISTOGRAM_INIT(
+    "impulse_tap_us", "Detector time per tap, add and detect.", 25, 50, 100, 200,
+    400, 800, 1600);
 static int16_t arrL[MAX_EVENT_SAMPLES];
 static int16_t arrR[MAX_EVENT_SAMPLES];
-static int wanted_window_start = 0;
+// The full clip around a peak, read later from the history, and the part
+// of it around the peak that is snapshot from the mic ring on the hit.
+static int clip_pre_samples = 0;
+static int clip_length = 0;
+static int wanted_pre_samples = 0;
 static int wanted_window_length = 0;
+static int det_sample_rate = 0;
+typedef struct {
+  impulse_event_cb cb;
+  void *ctx;
+} event_listener_slot;
+// Filled before impulse_detector_start(), read only by the detection task.
+static event_listener_slot event_listeners[IMPULSE_MAX_EVENT_LISTENERS];
+static int event_listener_count = 0;
+// The open hit group: its strongest hit so far, and the event built for it
+// with the window in arrL/arrR. group_ready is false when that window could
+// not be taken; the group is still counted once it closes.
+static impulse_coalescer coalescer;
+static impulse_stereo_result group_hit;
+static impulse_event group_event;
+static bool group_ready = false;
+// The strongest hit's window is not fully captured yet; see
+// impulse_detection_take_window().
+static bool group_window_pending = false;
+static uint64_t group_peak_index = 0;
+// Groups that closed before their window was captured, oldest first; each
+// is reported once its window is in (impulse_detection_take_closed()).
+// Their windows end before the open group's, so they never hold the event
+// buffers while the open group does.
+typedef struct {
+  impulse_stereo_result hit;
+  uint64_t peak_index; // group_peak_index
+  impulse_coalesced_hit merged;
+} closed_group;
+static closed_group closed_groups[DETECTION_CLOSED_GROUPS];
+static int closed_head = 0;
+static int closed_count = 0;
+
+// Posted by the mic config listener, consumed by the detection task.
+static mic_config pending_cfg;
+static uint32_t pending_epoch = 0;
+static _Atomic bool cfg_pending = false;
+// The noise energy sums the second criterion compares against (noise_sq,
+// median_detection.h), per channel, as of the last tap; 0 while the window
+// is filling. Copied raw on the detection path, the roots are taken by
+// impulse_detector_noise_floor().
+static uint64_t noise_sq_published[2];
+static uint16_t noise_tap_size = 1;
+static portMUX_TYPE noise_mux = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE pending_mux = portMUX_INITIALIZER_UNLOCKED;
 
-static void impulse_detection_on_tap(const int16_t *tap_left,
-                                     const int16_t *tap_right, void *ctx) {
+static void impulse_detection_on_tap(const mic_tap_view *tap, void *ctx) {
   (void)ctx;
-  if (tap_left == NULL || tap_right == NULL) {
+  if (tap == NULL || tap->left == NULL || tap->right == NULL) {
     ESP_LOGE(TAG, "tap callback received NULL buffer");
     return;
   }
-  impulse_add_tap(&detL, tap_left);
-  impulse_add_tap(&detR, tap_right);
-  if (detection_sem != NULL) {
-    xSemaphoreGive(detection_sem);
+  // Runs on the reader task: hand the view over and return immediately.
+  if (!spsc_push(&tap_queue, tap)) {
+    metrics_counter_inc(&taps_dropped);
+  } else {
+    TRACE_INSTANT(TRACE_TAP_QUEUE_SEND, (uint32_t)tap->sample_index);
+  }
+  if (detection_task != NULL) {
+    xTaskNotifyGive(detection_task);
+  }
+}
+
+// Builds the detector and event window for `cfg`; runs before the task
+// starts and afterwards only on the detection task.
+static bool impulse_detection_configure(const mic_config *cfg) {
+  impulse_detector_cfg det_cfg = IMPULSE_DETECTOR_CFG_DEFAULT();
+  det_cfg.tap_count = (uint16_t)cfg->num_taps;
+  det_cfg.tap_size = (uint16_t)cfg->tap_size;
+  det_cfg.refractory = (uint32_t)((int64_t)DETECTION_REFRACTORY_MS *
+                                  cfg->sampling_freq / 1000);
+  const size_t det_bytes = impulse_stereo_detector_storage_size(&det_cfg);
+
+  void *storage = audio_arena_slot_get(&det_slot, AUDIO_ARENA_INTERNAL,
+                                       det_bytes, "detector");
+  if (storage == NULL) {
+    ESP_LOGE(TAG, "Failed to allocate detector storage (%u B)",
+             (unsigned)det_bytes);
+    return false;
+  }
+  if (impulse_stereo_detector_init(&det, &det_cfg, storage,
+                                   det_slot.cap) != IMPULSE_DET_OK) {
+    ESP_LOGE(TAG, "Unsupported detector geometry: num_taps=%d tap_size=%d",
+             cfg->num_taps, cfg->tap_size);
+    return false;
+  }
+  ESP_LOGI(TAG, "Detector %dx%d (%s path)", cfg->num_taps, cfg->tap_size,
+           impulse_stereo_detector_is_specialised(&det) ? "specialised"
+                                                         : "generic");
+  impulse_coalesce_init(&coalescer, det_cfg.refractory);
+
+  det_sample_rate = cfg->sampling_freq;
+  // The snapshot is taken up to a full tap queue behind the reader, so of
+  // what the ring retains for this geometry only the part beyond that lag
+  // is safe to ask for.
+  int window_limit =
+      mic_retained_samples(cfg) - DETECTION_QUEUE_TAPS * cfg->tap_size;
+  if (window_limit > MAX_EVENT_SAMPLES) {
+    window_limit = MAX_EVENT_SAMPLES;
+  }
+  int pre = (int)((int64_t)cfg->pre_event_ms * cfg->sampling_freq / 1000);
+  int length = (int)((int64_t)(cfg->pre_event_ms + cfg->post_event_ms) *
+                     cfg->sampling_freq / 1000);
+  // Clips that fit the snapshot need no history.
+  const int history = mic_history_samples();
+  if (length > window_limit && length > history) {
+    const int limit = history > window_limit ? history : window_limit;
+    ESP_LOGW(TAG, "Event clip %d exceeds the %s, clamping to %d", length,
+             history > window_limit ? "history" : "snapshot", limit);
+    pre = (int)((int64_t)pre * limit / length);
+    length = limit;
+  }
+  clip_pre_samples = pre;
+  clip_length = length;
+
+  // The snapshot keeps the peak: at most half the window ahead of it.
+  wanted_pre_samples = pre < window_limit / 2 ? pre : window_limit / 2;
+  wanted_window_length = length - (pre - wanted_pre_samples);
+  if (wanted_window_length > window_limit) {
+    wanted_window_length = window_limit;
   }
+  ESP_LOGI(TAG, "Event clip %d samples (%d before the peak), snapshot %d",
+           clip_length, clip_pre_samples, wanted_window_length);
+  return true;
+}
+
+// Anchor the event on the channel that saw the impulse first, and rank it
+// by the strongest channel.
+static uint64_t impulse_detection_anchor(const impulse_stereo_result *hit) {
+  if (hit->fired == (IMPULSE_CH_LEFT | IMPULSE_CH_RIGHT)) {
+    return hit->left.peak_index < hit->right.peak_index
+               ? hit->left.peak_index
+               : hit->right.peak_index;
+  }
+  return (hit->fired & IMPULSE_CH_LEFT) ? hit->left.peak_index
+                                        : hit->right.peak_index;
+}
+
+static uint32_t impulse_detection_level(const impulse_stereo_result *hit) {
+  const uint32_t l = (hit->fired & IMPULSE_CH_LEFT) ? hit->left.level : 0;
+  const uint32_t r = (hit->fired & IMPULSE_CH_RIGHT) ? hit->right.level : 0;
+  return l > r ? l : r;
+}
+
+static bool impulse_detection_window_captured(uint64_t peak_index) {
+  const uint64_t start = peak_index - (uint64_t)wanted_pre_samples;
+  return start + (uint64_t)wanted_window_length <= mic_captured_samples();
+}
+
+// Copies the window around `peak_index` into arrL/arrR and builds its
+// event in group_event. False, counting a lost window, when the ring no
+// longer holds it.
+static bool impulse_detection_snapshot(const impulse_stereo_result *hit,
+                                       uint64_t peak_index) {
+  const uint64_t start = peak_index - (uint64_t)wanted_pre_samples;
+  // The absolute index keeps the slice exact even if the reader has moved
+  // on since the detector was fed.
+  if (!mic_snapshot(start, wanted_window_length, arrL, arrR)) {
+    ESP_LOGW(TAG, "Event window no longer in mic ring: start=%llu len=%d",
+             (unsigned long long)start, wanted_window_length);
+    metrics_counter_inc(&windows_lost);
+    return false;
+  }
+
+  // A clip reaching back before the stream start is cut there.
+  const int clip_pre = peak_index < (uint64_t)clip_pre_samples
+                           ? (int)peak_index
+                           : clip_pre_samples;
+  group_event = (impulse_event){
+      .hit = hit,
+      .peak_index = peak_index,
+      .peak_level = impulse_detection_level(hit),
+      .window_start = start,
+      .window_length = wanted_window_length,
+      .pre_samples = wanted_pre_samples,
+      .left = arrL,
+      .right = arrR,
+      .epoch = det_epoch,
+      .clip_start = peak_index - (uint64_t)clip_pre,
+      .clip_length = clip_length > wanted_window_length
+                         ? clip_length - (clip_pre_samples - clip_pre)
+                         : 0,
+      .sample_rate = det_sample_rate,
+      .peak_us = mic_sample_time_us(peak_index),
+      .peak_unix_us = mic_sample_unix_us(peak_index),
+      .detected_us = esp_timer_get_time(),
+      .criteria = &det.core.cfg,
+  };
+  return true;
+}
+
+// Logs a closed group and hands its event, in group_event when `ready`, to
+// the listeners.
+static void impulse_detection_report(const impulse_stereo_result *hit,
+                                     const impulse_coalesced_hit *merged,
+                                     bool ready) {
+  metrics_counter_inc(&detections);
+  metrics_counter_add(&hits_coalesced, merged->hits - 1);
+
+  const uint8_t fired = hit->fired;
+  const char *channels = fired == (IMPULSE_CH_LEFT | IMPULSE_CH_RIGHT) ? "LR"
+                         : (fired & IMPULSE_CH_LEFT)                   ? "L"
+                                                                       : "R";
+  ESP_LOGI(TAG,
+           ">>> IMPULSE DETECTED <<< (sample %llu, level %lu, channels %s, "
+           "R-L %ld, %lu hits)",
+           (unsigned long long)merged->peak_index, (unsigned long)merged->level,
+           channels, hit->offset_valid ? (long)hit->lr_offset : 0L,
+           (unsigned long)merged->hits);
+
+  if (ready) {
+    group_event.hits = merged->hits;
+    for (int k = 0; k < event_listener_count; k++) {
+      event_listeners[k].cb(&group_event, event_listeners[k].ctx);
+    }
+  }
+}
+
+// Reports the closed groups whose windows are in, oldest first. `drop`
+// reports the rest without their window: before a reset or a
+// reconfiguration it will not be captured under this configuration.
+static void impulse_detection_take_closed(bool drop) {
+  while (closed_count > 0) {
+    closed_group *g = &closed_groups[closed_head];
+    const uint64_t peak_index = g->peak_index;
+    bool ready = false;
+    if (impulse_detection_window_captured(peak_index)) {
+      ready = impulse_detection_snapshot(&g->hit, peak_index);
+    } else if (drop) {
+      metrics_counter_inc(&windows_lost);
+    } else {
+      return;
+    }
+    impulse_detection_report(&g->hit, &g->merged, ready);
+    closed_head = (closed_head + 1) % DETECTION_CLOSED_GROUPS;
+    closed_count--;
+  }
+}
+
+// Takes the open group's window from the mic ring once its end has been
+// captured. A detector that keeps pace with the reader can confirm a peak
+// before the post-peak half of the window is in; the snapshot then waits
+// for a later tap.
+static void impulse_detection_take_window(void) {
+  // Closed groups' windows end first; they are reported before this one
+  // takes the event buffers.
+  impulse_detection_take_closed(false);
+  if (closed_count > 0 ||
+      !impulse_detection_window_captured(group_peak_index)) {
+    return;
+  }
+  group_window_pending = false;
+  group_ready = impulse_detection_snapshot(&group_hit, group_peak_index);
+}
+
+// A hit that became the strongest of its group: take its window as soon as
+// it is captured, while it is still in the mic ring, and keep the event
+// until the group closes.
+static void impulse_detection_capture(const impulse_stereo_result *hit,
+                                      uint64_t peak_index) {
+  group_hit = *hit;
+  group_ready = false;
+  group_window_pending = false;
+
+  // Audio is copied only on a hit, and only the pre/post slice around the
+  // peak.
+  if (peak_index < (uint64_t)wanted_pre_samples) {
+    ESP_LOGW(TAG, "Impulse too close to stream start for pre-event window");
+    return;
+  }
+  group_peak_index = peak_index;
+  group_window_pending = true;
+  impulse_detection_take_window();
+}
+
+// Reports the open group once `horizon`, the lowest peak index a later
+// detection can have, has left its refractory window; UINT64_MAX closes it
+// regardless, before a reset or a reconfiguration. A group whose window is
+// still coming in is reported later, by impulse_detection_take_closed().
+static void impulse_detection_flush(uint64_t horizon) {
+  const bool drop = horizon == UINT64_MAX;
+  if (drop) {
+    impulse_detection_take_closed(true);
+  }
+  impulse_coalesced_hit merged;
+  if (!impulse_coalesce_flush(&coalescer, horizon, &merged)) {
+    return;
+  }
+  if (group_window_pending) {
+    group_window_pending = false;
+    if (!drop && closed_count < DETECTION_CLOSED_GROUPS) {
+      closed_group *g = &closed_groups[(closed_head + closed_count) %
+                                       DETECTION_CLOSED_GROUPS];
+      g->hit = group_hit;
+      g->peak_index = group_peak_index;
+      g->merged = merged;
+      closed_count++;
+      return;
+    }
+    if (!drop) {
+      ESP_LOGW(TAG, "Too many detections waiting for their window");
+    }
+    metrics_counter_inc(&windows_lost);
+  }
+  impulse_detection_report(&group_hit, &merged, group_ready);
+  group_ready = false;
+}
+
+// Runs on the mic reader task before any tap of the new epoch is delivered,
+// so the detection task sees the flag before it pops such a tap.
+static void impulse_detection_on_config(const mic_config *cfg, uint32_t epoch,
+                                        void *ctx) {
+  (void)ctx;
+  portENTER_CRITICAL(&pending_mux);
+  pending_cfg = *cfg;
+  pending_epoch = epoch;
+  atomic_store(&cfg_pending, true);
+  portEXIT_CRITICAL(&pending_mux);
+  if (detection_task != NULL) {
+    xTaskNotifyGive(detection_task);
+  }
+}
+
+static void impulse_detection_apply_pending(void) {
+  mic_config cfg;
+  portENTER_CRITICAL(&pending_mux);
+  cfg = pending_cfg;
+  const uint32_t epoch = pending_epoch;
+  atomic_store(&cfg_pending, false);
+  portEXIT_CRITICAL(&pending_mux);
+
+  // The open group's event carries the old epoch; report it first.
+  impulse_detection_flush(UINT64_MAX);
+  if (impulse_detection_configure(&cfg)) {
+    det_epoch = epoch;
+  } else {
+    // Keep dropping taps until a usable configuration arrives.
+    ESP_LOGE(TAG, "Detection paused until the next mic reconfiguration");
+  }
+  metrics_counter_inc(&detector_resets);
+}
+
+static void impulse_detection_publish_noise(void) {
+  const bool full = det.core.count == det.core.cfg.tap_count;
+  portENTER_CRITICAL(&noise_mux);
+  for (int ch = 0; ch < 2; ch++) {
+    noise_sq_published[ch] = full ? det.core.noise_sq[ch] : 0;
+  }
+  noise_tap_size = det.core.cfg.tap_size;
+  portEXIT_CRITICAL(&noise_mux);
 }
 
 static void impulse_detection_task(void *arg) {
   (void)arg;
-  bool detectedL = false;
-  bool detectedR = false;
+  impulse_stereo_result hit;
+  mic_tap_view tap;
+  uint64_t next_index = 0;
+  uint32_t dropped_seen = 0;
+  bool live = false; // a full window was seen
 
-  vTaskDelay(pdMS_TO_TICKS(200));
-  ESP_LOGI(TAG, "Initialization finished");
+  ESP_LOGI(TAG, "Detection task running on core %d", xPortGetCoreID());
 
   while (1) {
-    if (xSemaphoreTake(detection_sem, portMAX_DELAY) != pdTRUE) {
-      continue;
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (detection_pm_lock) {
+      esp_pm_lock_acquire(detection_pm_lock);
     }
 
-    mic_save_event(arrL, arrR);
+    while (spsc_pop(&tap_queue, &tap)) {
+      TRACE_INSTANT(TRACE_TAP_QUEUE_RECEIVE, (uint32_t)tap.sample_index);
+      if (atomic_load(&cfg_pending)) {
+        impulse_detection_apply_pending();
+      }
+      if (tap.epoch != det_epoch) {
+        continue; // captured under a previous mic configuration
+      }
+      // The window must be contiguous; after dropped taps start over.
+      if (tap.sample_index != next_index && det.core.count > 0) {
+        uint32_t dropped = metrics_counter_read32(&taps_dropped);
+        ESP_LOGW(TAG, "Detector fell behind (%lu taps dropped), resetting",
+                 (unsigned long)(dropped - dropped_seen));
+        dropped_seen = dropped;
+        impulse_detection_flush(UINT64_MAX);
+        impulse_stereo_detector_reset(&det);
+        metrics_counter_inc(&detector_resets);
+      }
+      next_index = tap.sample_index + (uint64_t)tap.length;
 
-    detectedL = impulse_run_detection(&detL);
-    detectedR = false;
-    if (!detectedL) {
-      detectedR = impulse_run_detection(&detR);
-    }
+      const int64_t tap_start = esp_timer_get_time();
+      TRACE_BEGIN(TRACE_IMPULSE_ADD_TAP, (uint32_t)tap.sample_index);
+      impulse_stereo_add_tap(&det, tap.left, tap.right, tap.sample_index);
+      TRACE_END(TRACE_IMPULSE_ADD_TAP, (uint32_t)tap.sample_index);
+      if (!mic_range_retained(tap.sample_index)) {
+        // The reader overwrote the tap while it was being read.
+        ESP_LOGW(TAG, "Tap %llu overwritten while queued, resetting",
+                 (unsigned long long)tap.sample_index);
+        impulse_detection_flush(UINT64_MAX);
+        impulse_stereo_detector_reset(&det);
+        metrics_counter_inc(&detector_resets);
+        continue;
+      }
 
-    if (detectedL || detectedR) {
-      ESP_LOGI(TAG, ">>> IMPULSE DETECTED <<<");
-      detectedL = false;
-      detectedR = false;
-
-      const int arr_len = MAX_EVENT_SAMPLES;
-      if (!((wanted_window_start >= 0) &&
-            (wanted_window_start + wanted_window_length <= arr_len))) {
-        ESP_LOGE(TAG,
-                 "Window out of bounds: start=%d, length=%d, array size=%d",
-                 wanted_window_start, wanted_window_length, arr_len);
+      TRACE_BEGIN(TRACE_IMPULSE_DETECT, 0);
+      const bool found = impulse_stereo_run_detection(&det, &hit);
+      TRACE_END(TRACE_IMPULSE_DETECT, found);
+      if (!live && det.core.count == det.core.cfg.tap_count) {
+        live = true;
+        boot_timing_mark(BOOT_STAGE_DETECTOR_LIVE);
+      }
+      impulse_detection_publish_noise();
+      metrics_histogram_observe(&tap_us,
+                                (uint32_t)(esp_timer_get_time() - tap_start));
+      impulse_detection_take_closed(false);
+      if (group_window_pending) {
+        impulse_detection_take_window();
       }
+      if (found) {
+        const uint64_t peak_index = impulse_detection_anchor(&hit);
+        impulse_detection_flush(peak_index);
+        if (impulse_coalesce_add(&coalescer, peak_index,
+                                 impulse_detection_level(&hit))) {
+          impulse_detection_capture(&hit, peak_index);
+        }
+      }
+      impulse_detection_flush(impulse_coalesce_horizon(
+          det.core.newest_index, det.core.cfg.tap_count,
+          det.core.cfg.tap_size));
+    }
+    if (detection_pm_lock) {
+      esp_pm_lock_release(detection_pm_lock);
     }
   }
 }
 
 void impulse_detector_start(void) {
+  if (detection_task != NULL) {
+    ESP_LOGW(TAG, "Impulse detection already running");
+    return;
+  }
+  metrics_register(&taps_dropped.base);
+  metrics_register(&detector_resets.base);
+  metrics_register(&detections.base);
+  metrics_register(&hits_coalesced.base);
+  metrics_register(&windows_lost.base);
+  metrics_register(&tap_us.base);
   const mic_config *cfg = mic_get_config();
   if (cfg == NULL) {
     ESP_LOGE(TAG, "mic_get_config failed; call mic_init first");
     return;
   }
-  if ((cfg->num_taps != TAP_COUNT) || (cfg->tap_size != TAP_SIZE)) {
-    ESP_LOGE(TAG,
-             "mic config mismatch: num_taps=%d tap_size=%d "
-             "(expected %d/%d)",
-             cfg->num_taps, cfg->tap_size, TAP_COUNT, TAP_SIZE);
+  if (!mic_add_config_listener(impulse_detection_on_config, NULL)) {
+    ESP_LOGE(TAG, "Failed to register mic config listener");
+    return;
+  }
+  // Registered first, so a reconfiguration after this read is not missed.
+  det_epoch = mic_config_epoch();
+  if (!impulse_detection_configure(cfg)) {
     return;
   }
 
-  wanted_window_start = ((cfg->num_taps * cfg->tap_size) / 2) -
-                        (cfg->pre_event_ms * cfg->sampling_freq / 1000);
-  ESP_LOGI(TAG, "wws - %d", wanted_window_start);
-
-  wanted_window_length =
-      (cfg->pre_event_ms + cfg->post_event_ms) * cfg->sampling_freq / 1000;
-  ESP_LOGI(TAG, "wwl - %d", wanted_window_length);
+#ifdef CONFIG_IMPULSE_DETECTION_BENCHMARK
+  impulse_detection_run_benchmark();
+#endif
 
-  impulse_detection_init(&detL);
-  impulse_detection_init(&detR);
+  if (tap_queue.slots == NULL &&
+      !spsc_attach(&tap_queue, sizeof(mic_tap_view), DETECTION_QUEUE_TAPS,
+                   audio_arena_alloc(AUDIO_ARENA_INTERNAL,
+                                     spsc_storage_bytes(sizeof(mic_tap_view),
+                                                        DETECTION_QUEUE_TAPS),
+                                     "tap_queue"))) {
+    ESP_LOGE(TAG, "Failed to allocate tap queue");
+    return;
+  }
 
-  if (detection_sem == NULL) {
-    detection_sem = xSemaphoreCreateBinary();
-    if (detection_sem == NULL) {
-      ESP_LOGE(TAG, "Failed to create detection semaphore");
-      return;
-    }
+  if (detection_pm_lock == NULL &&
+      esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "impulse_detection",
+                         &detection_pm_lock) != ESP_OK) {
+    detection_pm_lock = NULL;
   }
-  mic_add_tap_callback(impulse_detection_on_tap, NULL);
-  mic_start();
 
   BaseType_t task_result = xTaskCreatePinnedToCore(
-      impulse_detection_task, "impulse_detection", 8192, NULL, 5, NULL, 0);
+      impulse_detection_task, "impulse_detection", DETECTION_TASK_STACK, NULL,
+      DETECTION_TASK_PRIO, &detection_task, DETECTION_TASK_CORE);
   if (task_result != pdPASS) {
     ESP_LOGE(TAG, "Failed to create impulse_detection task (error=%d)",
              (int)task_result);
+    detection_task = NULL;
+    return;
+  }
+
+  const mic_subscriber_cfg sub_cfg = {
+      .cb = impulse_detection_on_tap,
+      .name = "detector",
+      .batch_taps = 1,
+      .enabled = true,
+  };
+  tap_sub = mic_subscribe(&sub_cfg);
+  if (tap_sub == NULL) {
+    ESP_LOGE(TAG, "Failed to subscribe to microphone taps");
+    return;
+  }
+  mic_start();
+}
+
+bool impulse_detector_add_event_listener(impulse_event_cb cb, void *ctx) {
+  if (cb == NULL || event_listener_count >= IMPULSE_MAX_EVENT_LISTENERS) {
+    return false;
+  }
+  event_listeners[event_listener_count].cb = cb;
+  event_listeners[event_listener_count].ctx = ctx;
+  event_listener_count++;
+  return true;
+}
+
+void impulse_detector_noise_floor(uint16_t out[2]) {
+  uint64_t sq[2];
+  portENTER_CRITICAL(&noise_mux);
+  sq[0] = noise_sq_published[0];
+  sq[1] = noise_sq_published[1];
+  const float ts = (float)noise_tap_size;
+  portEXIT_CRITICAL(&noise_mux);
+  for (int ch = 0; ch < 2; ch++) {
+    // The mean of the fourth powers, back to a magnitude.
+    out[ch] = (uint16_t)sqrtf(sqrtf((float)sq[ch] / ts));
+  }
+}
+
+void impulse_detector_get_stats(impulse_detector_stats *out) {
+  if (out == NULL) {
+    return;
   }
+  out->taps_dropped = metrics_counter_read32(&taps_dropped);
+  out->resets = metrics_counter_read32(&detector_resets);
+  out->detections = metrics_counter_read32(&detections);
+  out->coalesced = metrics_counter_read32(&hits_coalesced);
+  out->windows_lost = metrics_counter_read32(&windows_lost);
 }
@@ -1,6 +1,65 @@
 #ifndef DETECTOR_H
 #define DETECTOR_H
 
+#include "median_detection.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
 void impulse_detector_start(void);
 
+// A confirmed impulse and the pre/post event window around it. Hits closer
+// than CONFIG_IMPULSE_DETECTION_REFRACTORY_MS to the first one of a group are
+// coalesced (impulse_coalesce.h) into one event, for the strongest of them.
+// The window copied into left/right is bounded by the mic ring; a longer clip
+// is only described, as a range the listener reads from the history
+// (mic_history.h) once it has been captured.
+typedef struct {
+  const impulse_stereo_result *hit; // the strongest hit of the group
+  uint64_t peak_index;   // earliest peak of the channels that fired
+  uint32_t peak_level;   // highest level of the channels that fired
+  uint32_t hits;         // detections coalesced into this event, >= 1
+  uint64_t window_start; // absolute sample index of left[0] / right[0]
+  int window_length;     // samples per channel
+  int pre_samples;       // samples of the window before peak_index
+  const int16_t *left;   // valid only during the callback
+  const int16_t *right;
+  uint32_t epoch;        // mic_config_epoch() of all the indices here
+  uint64_t clip_start;   // the whole pre/post clip, absolute sample index
+  int clip_length;       // samples per channel; 0 when the window is all
+  int sample_rate;
+  int64_t peak_us;       // capture time of peak_index, mic_sample_time_us()
+  int64_t peak_unix_us;  // the same on the wall clock; 0 while unset
+  int64_t detected_us;   // esp_timer time the detector confirmed it
+  const impulse_detector_cfg *criteria; // thresholds in effect
+} impulse_event;
+
+// Runs on the detection task for every impulse whose window could be
+// snapshot from the mic ring; must copy what it keeps and return quickly.
+typedef void (*impulse_event_cb)(const impulse_event *event, void *ctx);
+
+#define IMPULSE_MAX_EVENT_LISTENERS 2
+
+// Listeners are called in the order they were added. Add them before
+// impulse_detector_start(); returns false when all
+// IMPULSE_MAX_EVENT_LISTENERS slots are taken.
+bool impulse_detector_add_event_listener(impulse_event_cb cb, void *ctx);
+
+typedef struct {
+  uint32_t taps_dropped; // taps the reader could not queue (detector behind)
+  uint32_t resets;       // window restarts: dropped/overwritten taps, mic
+                         // reconfigurations
+  uint32_t detections;   // events, after coalescing
+  uint32_t coalesced;    // further hits merged into those events
+  uint32_t windows_lost; // detections whose window had left the mic ring
+} impulse_detector_stats;
+
+void impulse_detector_get_stats(impulse_detector_stats *out);
+
+// The noise floor of each channel (left, right) the detector is currently
+// measuring impulses against, as a sample magnitude: the fourth root of the
+// mean fourth power of its column medians. 0 while the window is filling,
+// e.g. after a reset. Safe to call from any task.
+void impulse_detector_noise_floor(uint16_t out[2]);
+
 #endif
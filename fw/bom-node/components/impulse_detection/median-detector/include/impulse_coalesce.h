@@ -0,0 +1,90 @@
+#ifndef IMPULSE_COALESCE_H
+#define IMPULSE_COALESCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Refractory window over detector hits, shared by the firmware and the host
+// runners so both count the same events. One impulse crossing the window can
+// fire on several consecutive taps; the first hit opens a group, every hit
+// whose peak lies less than `refractory` samples after the first one joins
+// it, and the group is reported once, as its strongest hit (the earliest on
+// a tie), when no later hit can join any more.
+//
+// Per detection pass a caller with a hit first flushes at the hit's peak
+// index, which closes a group the hit cannot join, and adds it; every pass
+// then flushes with the horizon of the next one. With refractory = 0 each
+// hit is its own group and comes out of the flush of the pass that found it.
+
+typedef struct {
+  uint64_t peak_index; // absolute sample index of the strongest peak
+  uint32_t level;      // its level, in the detector's units
+  uint32_t hits;       // detections merged into it, >= 1
+} impulse_coalesced_hit;
+
+typedef struct {
+  uint32_t refractory; // samples after a group's first peak
+  bool open;
+  uint64_t start; // peak index of the open group's first hit
+  impulse_coalesced_hit best;
+} impulse_coalescer;
+
+static inline void impulse_coalesce_init(impulse_coalescer *c,
+                                         uint32_t refractory) {
+  c->refractory = refractory;
+  c->open = false;
+  c->start = 0;
+  c->best.peak_index = 0;
+  c->best.level = 0;
+  c->best.hits = 0;
+}
+
+// Lowest peak index the pass after the one whose newest tap starts at
+// `newest_index` can report: the middle tap then starts one tap later.
+static inline uint64_t impulse_coalesce_horizon(uint64_t newest_index,
+                                                uint16_t tap_count,
+                                                uint16_t tap_size) {
+  const uint64_t behind =
+      (uint64_t)(tap_count - 1 - tap_count / 2) * (uint64_t)tap_size;
+  const uint64_t next = newest_index + tap_size;
+  return next > behind ? next - behind : 0;
+}
+
+// Adds a hit just flushed at its own peak index. Returns true when it became
+// the representative of its group, i.e. when a caller keeping per-hit data
+// (a snapshot, the per-channel result) should replace what it holds.
+static inline bool impulse_coalesce_add(impulse_coalescer *c,
+                                        uint64_t peak_index, uint32_t level) {
+  if (!c->open) {
+    c->open = true;
+    c->start = peak_index;
+    c->best.peak_index = peak_index;
+    c->best.level = level;
+    c->best.hits = 1;
+    return true;
+  }
+  c->best.hits++;
+  if (level > c->best.level) {
+    c->best.peak_index = peak_index;
+    c->best.level = level;
+    return true;
+  }
+  return false;
+}
+
+// Closes the open group once `horizon` has left its refractory window; pass
+// UINT64_MAX to close it regardless (end of input, detector reset). Returns
+// true with the merged hit in `out` when a group was closed.
+static inline bool impulse_coalesce_flush(impulse_coalescer *c,
+                                          uint64_t horizon,
+                                          impulse_coalesced_hit *out) {
+  if (!c->open || (horizon >= c->start &&
+                   horizon - c->start < (uint64_t)c->refractory)) {
+    return false;
+  }
+  c->open = false;
+  *out = c->best;
+  return true;
+}
+
+#endif
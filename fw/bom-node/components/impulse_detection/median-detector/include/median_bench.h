@@ -0,0 +1,11 @@
+#ifndef MEDIAN_BENCH_H
+#define MEDIAN_BENCH_H
+
+// Measures per-tap cost of the sorted-column update for TAP_COUNT 31, 63 and
+// 127, comparing the linear scan/shift it replaced with the binary-search
+// update from median_sorted_col.h, then the per-tap cost of two mono
+// detectors against one stereo detector. Results are logged; built only with
+// CONFIG_IMPULSE_DETECTION_BENCHMARK.
+void impulse_detection_run_benchmark(void);
+
+#endif
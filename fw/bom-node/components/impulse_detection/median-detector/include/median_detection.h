@@ -1,9 +1,21 @@
 #ifndef IMPULSE_DETECTION_H
 #define IMPULSE_DETECTION_H
 
+// Median-based impulse detector shared by the firmware (impulse_detection
+// component) and the host `peak` library in scripts/median-filter. The code
+// has no ESP-IDF dependencies and never allocates: storage for the tap
+// history and the sorted columns is supplied by the caller.
+//
+// Geometry is a runtime setting. Every geometry listed in MEDIAN_GEOMETRIES
+// is additionally compiled as a specialised instance with constant loop
+// bounds and is picked automatically whenever the configuration matches; any
+// other geometry runs through the generic path.
+
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+// Default geometry; also the geometry of the specialised fast path.
 #ifndef TAP_COUNT
 #define TAP_COUNT 31
 #endif
@@ -12,6 +24,26 @@
 #define TAP_SIZE 30
 #endif
 
+// Specialised geometries. Builds generate median_geometries.h from a list
+// (CONFIG_IMPULSE_DETECTION_GEOMETRIES in the firmware, MEDIAN_GEOMETRIES in
+// scripts/median-filter) via median_geometries.cmake; without it only the
+// default geometry is specialised.
+#ifdef MEDIAN_HAVE_GENERATED_GEOMETRIES
+#include "median_geometries.h"
+#endif
+#ifndef MEDIAN_GEOMETRIES
+#define MEDIAN_GEOMETRIES(X) X(TAP_COUNT, TAP_SIZE)
+#endif
+
+// Channels a single detector state can carry (mono or interleaved stereo).
+#define IMPULSE_MAX_CHANNELS 2
+
+// Upper bound for tap_size; the before/after medians of the energy criterion
+// use stack buffers of this length.
+#ifndef IMPULSE_MAX_TAP_SIZE
+#define IMPULSE_MAX_TAP_SIZE 128
+#endif
+
 // DET_LEVEL represents the squared amplitude threshold for impulse detection.
 // Units: (amplitude)^2, typically derived from the squared value of the input
 // signal. Calibration: Set based on expected signal amplitude; increase to
@@ -36,31 +68,184 @@
 #define DET_ENERGY 0.4f
 #endif
 
+// DET_REFRACTORY is the hit coalescing window in samples (impulse_coalesce.h):
+// hits whose peaks lie closer than this to the first hit of a group are
+// reported as one event. The detector itself does not use it; the runners
+// that turn hits into events do. 0 reports every hit.
+#ifndef DET_REFRACTORY
+#define DET_REFRACTORY 0
+#endif
+
+enum impulse_det_state {
+  IMPULSE_DET_OK = 0,
+  IMPULSE_DET_ERR_INVALID_ARG = -300,     // NULL pointer or bad geometry
+  IMPULSE_DET_ERR_BUFFER_TOO_SMALL = -301 // storage smaller than required
+};
+
+// Detector geometry, thresholds and hit coalescing window.
+typedef struct {
+  uint16_t tap_count;  // taps in the sliding window (>= 3)
+  uint16_t tap_size;   // samples per tap (1 .. IMPULSE_MAX_TAP_SIZE)
+  uint32_t det_level;  // see DET_LEVEL
+  float det_rms;       // see DET_RMS
+  float det_energy;    // see DET_ENERGY
+  uint32_t refractory; // see DET_REFRACTORY
+} impulse_detector_cfg;
+
+#define IMPULSE_DETECTOR_CFG_DEFAULT()                                         \
+  {                                                                            \
+    .tap_count = TAP_COUNT, .tap_size = TAP_SIZE, .det_level = DET_LEVEL,      \
+    .det_rms = DET_RMS, .det_energy = DET_ENERGY,                              \
+    .refractory = DET_REFRACTORY,                                              \
+  }
+
+// Number of uint32_t words of storage needed for a mono geometry (double it
+// for an impulse_stereo_detector); usable in constant expressions for static
+// buffers. Tap history and sorted columns, plus the peak of every tap, all
+// as 16-bit magnitudes.
+#define IMPULSE_DETECTOR_STORAGE_WORDS(tap_count, tap_size)                    \
+  ((2u * (size_t)(tap_count) * (size_t)(tap_size) + (size_t)(tap_count) +     \
+    1u) /                                                                      \
+   2u)
+
 // Data structure for the median-based impulse detection algorithm. This
 // structure maintains a circular buffer of "taps"(signal segments) and their
 // corresponding sorted values to facilitate real - time median filtering.
 typedef struct {
-  // Circular buffer of squared signal samples. Organized as [TAP_COUNT]
-  // segments, each containing [TAP_SIZE] samples. The total sliding
-  // window size is TAP_COUNT *TAP_SIZE samples.
-  uint32_t taps[TAP_COUNT][TAP_SIZE];
+  impulse_detector_cfg cfg;
+
+  // Circular buffer of sample magnitudes |s|. Organized as [tap_count]
+  // segments, each containing [tap_size] samples of `channels` interleaved
+  // values. The total sliding window size is tap_count * tap_size samples.
+  // Magnitudes order like the squared energies the thresholds use; values
+  // are squared only where they meet a threshold.
+  uint16_t *taps;
 
-  // Matrix of sorted samples used for fast median calculation.
-  // Each column[i] contains TAP_COUNT sorted samples from the i-th position of
-  // all currently stored taps.
-  uint32_t sorted_cols[TAP_SIZE][TAP_COUNT];
+  // Matrix of sorted magnitudes used for fast median calculation.
+  // Each column [(i * channels + ch) * tap_count ...] contains tap_count
+  // sorted samples from the i-th position of channel ch of all currently
+  // stored taps.
+  uint16_t *sorted_cols;
+
+  // Largest magnitude of each stored tap, [tap][ch]. The detection pass
+  // skips the window when the middle tap's peak cannot clear det_level.
+  uint16_t *tap_max;
+
+  // Per channel, the sum over tap positions of the squared column median
+  // energy (the median magnitude to the fourth power): the noise energy of
+  // the second criterion. Kept up to date by add_tap
+  // once the window is full.
+  uint64_t noise_sq[IMPULSE_MAX_CHANNELS];
 
   // Index of the most recently written tap in the circular buffer.
   uint16_t head;
 
-  // Number of taps currently stored (up to TAP_COUNT).
+  // Number of taps currently stored (up to tap_count).
   uint16_t count;
+
+  // Specialised instance serving cfg (1-based position in MEDIAN_GEOMETRIES),
+  // or 0 for the generic path.
+  uint8_t geometry;
+
+  // 1 for impulse_detector, 2 inside impulse_stereo_detector.
+  uint8_t channels;
+
+  // Absolute sample index (as reported by mic_tap_view) of the first sample
+  // of the most recently added tap.
+  uint64_t newest_index;
 } impulse_detector;
 
-void impulse_detection_init(impulse_detector *det);
+// Where a confirmed impulse sits in the input stream.
+typedef struct {
+  // Absolute sample index of the peak.
+  uint64_t peak_index;
+  // Peak offset from the oldest sample in the detection window.
+  int32_t window_offset;
+  // Squared peak magnitude above the noise median.
+  uint32_t level;
+} impulse_result;
+
+// Left and right channel in one state: both channels share the window,
+// geometry dispatch and ring bookkeeping, and their middle taps are evaluated
+// in a single pass instead of two mono detectors walking separate matrices.
+typedef struct {
+  impulse_detector core;
+} impulse_stereo_detector;
+
+#define IMPULSE_CH_LEFT 0x1
+#define IMPULSE_CH_RIGHT 0x2
+
+typedef struct {
+  // IMPULSE_CH_* mask of the channels that confirmed an impulse.
+  uint8_t fired;
+  // Per-channel positions; valid only for channels set in `fired`.
+  impulse_result left;
+  impulse_result right;
+  // Right minus left position, in samples, of the strongest middle-tap
+  // excursion of each channel; valid when both channels had one, even if
+  // only one of them fired. Bounded by +-tap_size.
+  bool offset_valid;
+  int32_t lr_offset;
+} impulse_stereo_result;
+
+// True if tap_count x tap_size has a specialised instance in this build.
+bool impulse_geometry_is_specialised(uint16_t tap_count, uint16_t tap_size);
+
+// Tap size that keeps the tap duration of `base_tap_size` samples at
+// `base_rate` when running at `sample_rate`. A specialised geometry with
+// `tap_count` taps within 25 % of the exact value is preferred, so rate
+// changes keep a fast path.
+uint16_t impulse_tap_size_for_rate(int sample_rate, int base_rate,
+                                   uint16_t base_tap_size, uint16_t tap_count);
+
+static inline bool impulse_detector_is_specialised(const impulse_detector *det) {
+  return det->geometry != 0;
+}
+
+// Bytes of storage impulse_detector_init() needs for `cfg`.
+size_t impulse_detector_storage_size(const impulse_detector_cfg *cfg);
 
-void impulse_add_tap(impulse_detector *det, const int16_t *samples);
+// Binds `det` to caller-owned `storage` (uint32_t aligned) and clears it.
+enum impulse_det_state impulse_detector_init(impulse_detector *det,
+                                             const impulse_detector_cfg *cfg,
+                                             void *storage,
+                                             size_t storage_size);
 
-bool impulse_run_detection(impulse_detector *det);
+// Drops all taps; geometry, thresholds and storage are kept.
+void impulse_detector_reset(impulse_detector *det);
+
+void impulse_add_tap(impulse_detector *det, const int16_t *samples,
+                     uint64_t sample_index);
+
+// Returns true on a confirmed impulse; `result` (optional) receives its
+// position.
+bool impulse_run_detection(impulse_detector *det, impulse_result *result);
+
+size_t impulse_stereo_detector_storage_size(const impulse_detector_cfg *cfg);
+
+enum impulse_det_state
+impulse_stereo_detector_init(impulse_stereo_detector *det,
+                             const impulse_detector_cfg *cfg, void *storage,
+                             size_t storage_size);
+
+void impulse_stereo_detector_reset(impulse_stereo_detector *det);
+
+void impulse_stereo_add_tap(impulse_stereo_detector *det, const int16_t *left,
+                            const int16_t *right, uint64_t sample_index);
+
+// Returns true if at least one channel confirmed an impulse.
+bool impulse_stereo_run_detection(impulse_stereo_detector *det,
+                                  impulse_stereo_result *result);
+
+static inline bool
+impulse_stereo_detector_is_specialised(const impulse_stereo_detector *det) {
+  return impulse_detector_is_specialised(&det->core);
+}
+
+#ifdef MEDIAN_DETECTION_TESTING
+// Test-only: route `det` (or a stereo detector's core) through the generic
+// runtime-geometry path.
+void median_test_force_generic(impulse_detector *det);
+#endif
 
 #endif
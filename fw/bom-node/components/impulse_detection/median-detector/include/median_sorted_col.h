@@ -0,0 +1,66 @@
+#ifndef MEDIAN_SORTED_COL_H
+#define MEDIAN_SORTED_COL_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Primitives for the per-position sorted columns of the median detector.
+// Each column holds the values of one tap position across all stored taps in
+// ascending order; the noise median is read straight from the middle.
+
+// Column values are sample magnitudes |s|, 0 .. 32768. Squaring is monotonic
+// on them, so they sort, and select medians, exactly like the squared
+// energies the thresholds are defined on, in half the memory.
+typedef uint16_t sorted_col_val;
+
+// First index in arr[0..n) whose value is >= val.
+static inline uint16_t sorted_col_lower_bound(const sorted_col_val *arr,
+                                              uint16_t n, sorted_col_val val) {
+  uint16_t lo = 0, hi = n;
+  while (lo < hi) {
+    uint16_t mid = (uint16_t)((lo + hi) >> 1);
+    if (arr[mid] < val) {
+      lo = (uint16_t)(mid + 1);
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// Inserts val into arr[0..n); the caller guarantees room for n + 1 values.
+static inline void sorted_col_insert(sorted_col_val *arr, uint16_t n,
+                                     sorted_col_val val) {
+  uint16_t pos = sorted_col_lower_bound(arr, n, val);
+  memmove(&arr[pos + 1], &arr[pos], (size_t)(n - pos) * sizeof(*arr));
+  arr[pos] = val;
+}
+
+// Replaces one occurrence of old_val with new_val in arr[0..n), keeping the
+// column sorted. The evicted slot is found by binary search; the values
+// between it and the new slot then move by one, so the cost is the log2(n)
+// search plus the distance travelled rather than two full scans. If old_val
+// is not present the column is left unchanged.
+static inline void sorted_col_replace(sorted_col_val *arr, uint16_t n,
+                                      sorted_col_val old_val,
+                                      sorted_col_val new_val) {
+  uint16_t i = sorted_col_lower_bound(arr, n, old_val);
+  if (i >= n || arr[i] != old_val) {
+    return;
+  }
+
+  if (new_val > old_val) {
+    while (i + 1 < n && arr[i + 1] < new_val) {
+      arr[i] = arr[i + 1];
+      i++;
+    }
+  } else {
+    while (i > 0 && arr[i - 1] > new_val) {
+      arr[i] = arr[i - 1];
+      i--;
+    }
+  }
+  arr[i] = new_val;
+}
+
+#endif
@@ -0,0 +1,200 @@
+#include "median_bench.h"
+#include "median_detection.h"
+#include "median_sorted_col.h"
+
+#include "sdkconfig.h"
+
+#ifdef CONFIG_IMPULSE_DETECTION_BENCHMARK
+
+#include "esp_cpu.h"
+#include "esp_log.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "IMPULSE_BENCH";
+
+#define BENCH_TAPS 512
+
+// Column update as it was before median_sorted_col.h: linear search for the
+// evicted value, shift left, linear search for the new slot, shift right.
+static uint16_t legacy_remove(sorted_col_val *arr, uint16_t n,
+                              sorted_col_val val) {
+  uint16_t idx = n;
+  for (uint16_t i = 0; i < n; i++) {
+    if (arr[i] == val) {
+      idx = i;
+      break;
+    }
+  }
+  if (idx == n) {
+    return n;
+  }
+  for (uint16_t i = idx; i + 1 < n; i++) {
+    arr[i] = arr[i + 1];
+  }
+  return n - 1;
+}
+
+static void legacy_insert(sorted_col_val *arr, uint16_t n, sorted_col_val val) {
+  uint16_t pos = 0;
+  while (pos < n && arr[pos] <= val)
+    pos++;
+  for (int i = (int)n; i > (int)pos; i--) {
+    arr[i] = arr[i - 1];
+  }
+  arr[pos] = val;
+}
+
+static inline sorted_col_val bench_value(uint32_t *seed) {
+  *seed = *seed * 1664525u + 1013904223u;
+  int32_t s = (int16_t)(*seed >> 16) >> 4; // quiet-ish noise with outliers
+  if ((*seed & 0xff) == 0) {
+    s *= 16;
+  }
+  return (sorted_col_val)(s < 0 ? -s : s);
+}
+
+typedef struct {
+  uint16_t n;
+  sorted_col_val *hist; // [n][TAP_SIZE], oldest value per position
+  sorted_col_val *cols; // [TAP_SIZE][n], sorted
+} bench_state;
+
+static bool bench_state_init(bench_state *st, uint16_t n, uint32_t seed) {
+  st->n = n;
+  st->hist = malloc((size_t)n * TAP_SIZE * sizeof(sorted_col_val));
+  st->cols = malloc((size_t)n * TAP_SIZE * sizeof(sorted_col_val));
+  if (!st->hist || !st->cols) {
+    free(st->hist);
+    free(st->cols);
+    return false;
+  }
+  for (uint16_t t = 0; t < n; t++) {
+    for (uint16_t i = 0; i < TAP_SIZE; i++) {
+      sorted_col_val v = bench_value(&seed);
+      st->hist[(size_t)t * TAP_SIZE + i] = v;
+      sorted_col_insert(&st->cols[(size_t)i * n], t, v);
+    }
+  }
+  return true;
+}
+
+static void bench_state_free(bench_state *st) {
+  free(st->hist);
+  free(st->cols);
+}
+
+static uint32_t bench_run(bench_state *st, bool legacy, uint32_t seed) {
+  const uint16_t n = st->n;
+  uint32_t cycles = 0;
+  for (int k = 0; k < BENCH_TAPS; k++) {
+    sorted_col_val *old = &st->hist[(size_t)(k % n) * TAP_SIZE];
+    sorted_col_val fresh[TAP_SIZE];
+    for (uint16_t i = 0; i < TAP_SIZE; i++) {
+      fresh[i] = bench_value(&seed);
+    }
+
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    for (uint16_t i = 0; i < TAP_SIZE; i++) {
+      sorted_col_val *col = &st->cols[(size_t)i * n];
+      if (legacy) {
+        uint16_t m = legacy_remove(col, n, old[i]);
+        legacy_insert(col, m, fresh[i]);
+      } else {
+        sorted_col_replace(col, n, old[i], fresh[i]);
+      }
+      old[i] = fresh[i];
+    }
+    cycles += esp_cpu_get_cycle_count() - t0;
+  }
+  return cycles;
+}
+
+// Full add + detect cost per tap of two mono detectors against one stereo
+// detector on the same noise.
+static void bench_stereo(void) {
+  impulse_detector_cfg cfg = IMPULSE_DETECTOR_CFG_DEFAULT();
+  const size_t mono = impulse_detector_storage_size(&cfg);
+  uint8_t *buf = malloc(4 * mono);
+  if (buf == NULL) {
+    ESP_LOGE(TAG, "Out of memory for stereo benchmark");
+    return;
+  }
+  impulse_detector det_l, det_r;
+  impulse_stereo_detector st;
+  impulse_detector_init(&det_l, &cfg, buf, mono);
+  impulse_detector_init(&det_r, &cfg, buf + mono, mono);
+  impulse_stereo_detector_init(&st, &cfg, buf + 2 * mono, 2 * mono);
+
+  uint32_t seed = 3;
+  uint32_t mono_cycles = 0, stereo_cycles = 0;
+  int16_t left[TAP_SIZE], right[TAP_SIZE];
+  for (int k = 0; k < BENCH_TAPS; k++) {
+    for (uint16_t i = 0; i < TAP_SIZE; i++) {
+      left[i] = (int16_t)bench_value(&seed);
+      right[i] = (int16_t)bench_value(&seed);
+    }
+    uint64_t idx = (uint64_t)k * TAP_SIZE;
+    impulse_result r;
+    impulse_stereo_result sr;
+
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    impulse_add_tap(&det_l, left, idx);
+    impulse_add_tap(&det_r, right, idx);
+    impulse_run_detection(&det_l, &r);
+    impulse_run_detection(&det_r, &r);
+    uint32_t t1 = esp_cpu_get_cycle_count();
+    impulse_stereo_add_tap(&st, left, right, idx);
+    impulse_stereo_run_detection(&st, &sr);
+    uint32_t t2 = esp_cpu_get_cycle_count();
+
+    mono_cycles += t1 - t0;
+    stereo_cycles += t2 - t1;
+  }
+  ESP_LOGI(TAG,
+           "Detector %dx%d: 2x mono %lu cycles/tap, stereo %lu cycles/tap",
+           TAP_COUNT, TAP_SIZE, (unsigned long)(mono_cycles / BENCH_TAPS),
+           (unsigned long)(stereo_cycles / BENCH_TAPS));
+  free(buf);
+}
+
+void impulse_detection_run_benchmark(void) {
+  static const uint16_t sizes[] = {31, 63, 127};
+
+  ESP_LOGI(TAG, "Sorted-column update, TAP_SIZE=%d, %d taps per run:", TAP_SIZE,
+           BENCH_TAPS);
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    bench_state a, b;
+    if (!bench_state_init(&a, sizes[s], 42) ||
+        !bench_state_init(&b, sizes[s], 42)) {
+      ESP_LOGE(TAG, "Out of memory for TAP_COUNT=%u", sizes[s]);
+      return;
+    }
+
+    uint32_t legacy = bench_run(&a, true, 7);
+    uint32_t fast = bench_run(&b, false, 7);
+    bool match =
+        memcmp(a.cols, b.cols,
+               (size_t)sizes[s] * TAP_SIZE * sizeof(sorted_col_val)) == 0;
+
+    ESP_LOGI(TAG,
+             " - TAP_COUNT=%3u: linear %lu cycles/tap, binary search %lu "
+             "cycles/tap (%s)",
+             sizes[s], (unsigned long)(legacy / BENCH_TAPS),
+             (unsigned long)(fast / BENCH_TAPS),
+             match ? "identical columns" : "COLUMN MISMATCH");
+
+    bench_state_free(&a);
+    bench_state_free(&b);
+  }
+
+  bench_stereo();
+}
+
+#else
+
+void impulse_detection_run_benchmark(void) {}
+
+#endif
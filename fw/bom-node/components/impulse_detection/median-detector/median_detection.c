@@ -1,210 +1,485 @@
 #include "median_detection.h"
+#include "median_sorted_col.h"
 
-#include <math.h>
 #include <string.h>
 
-static uint16_t remove_value_sorted(uint32_t *arr, uint16_t n, uint32_t val) {
-  uint16_t idx = n;
-  for (uint16_t i = 0; i < n; i++) {
-    if (arr[i] == val) {
-      idx = i;
-      break;
-    }
-  }
+// The kernels below take the geometry as explicit arguments and are forced
+// inline into a switch with one case per MEDIAN_GEOMETRIES entry passing
+// constants, so the compiler emits a specialised copy with constant loop
+// bounds and strength-reduced modulo for each; the default case passes the
+// runtime configuration. They also take the channel count: stereo
+// detectors keep L and R interleaved ([tap][sample][ch] history and
+// [sample][ch][tap_count] sorted columns), so the middle-tap evaluation reads
+// both channels in one pass. Column updates walk one channel at a time, which
+// measured faster than alternating channels per sample.
+#define MEDIAN_ALWAYS_INLINE static inline __attribute__((always_inline))
+
+enum {
+  MEDIAN_GEOM_GENERIC = 0,
+#define MEDIAN_GEOM_ENUM(tc, ts) MEDIAN_GEOM_##tc##x##ts,
+  MEDIAN_GEOMETRIES(MEDIAN_GEOM_ENUM)
+#undef MEDIAN_GEOM_ENUM
+};
+
+static uint8_t geometry_id(uint16_t tap_count, uint16_t tap_size) {
+#define MEDIAN_GEOM_MATCH(tc, ts)                                              \
+  if (tap_count == (tc) && tap_size == (ts))                                   \
+    return MEDIAN_GEOM_##tc##x##ts;
+  MEDIAN_GEOMETRIES(MEDIAN_GEOM_MATCH)
+#undef MEDIAN_GEOM_MATCH
+  return MEDIAN_GEOM_GENERIC;
+}
 
-  if (idx == n) {
-    return n;
+// Expands MEDIAN_KERNEL(tc, ts) once per specialised geometry plus once with
+// the runtime geometry; define MEDIAN_KERNEL at the call site.
+#define MEDIAN_GEOM_CASE(tc, ts)                                               \
+  case MEDIAN_GEOM_##tc##x##ts:                                                \
+    MEDIAN_KERNEL((tc), (ts));
+#define MEDIAN_DISPATCH(det)                                                   \
+  switch ((det)->geometry) {                                                   \
+    MEDIAN_GEOMETRIES(MEDIAN_GEOM_CASE)                                        \
+  default:                                                                     \
+    MEDIAN_KERNEL((det)->cfg.tap_count, (det)->cfg.tap_size);                  \
   }
 
-  for (uint16_t i = idx; i + 1 < n; i++) {
-    arr[i] = arr[i + 1];
-  }
-  return n - 1;
+bool impulse_geometry_is_specialised(uint16_t tap_count, uint16_t tap_size) {
+  return geometry_id(tap_count, tap_size) != MEDIAN_GEOM_GENERIC;
 }
 
-static uint16_t insert_value_sorted(uint32_t *arr, uint16_t n,
-                                    uint16_t capacity, uint32_t val) {
-  if (n >= capacity) {
-    return n;
+uint16_t impulse_tap_size_for_rate(int sample_rate, int base_rate,
+                                   uint16_t base_tap_size, uint16_t tap_count) {
+  if (sample_rate <= 0 || base_rate <= 0 || base_tap_size == 0) {
+    return base_tap_size;
   }
-
-  uint16_t pos = 0;
-  while (pos < n && arr[pos] <= val)
-    pos++;
-
-  for (int i = (int)n; i > (int)pos; i--) {
-    arr[i] = arr[i - 1];
+  int64_t scaled =
+      ((int64_t)base_tap_size * sample_rate + base_rate / 2) / base_rate;
+  int exact = (int)(scaled < 1 ? 1
+                    : scaled > IMPULSE_MAX_TAP_SIZE ? IMPULSE_MAX_TAP_SIZE
+                                                    : scaled);
+
+  int best = exact;
+  int best_dist = exact / 4 + 1; // accept up to 25 % away
+#define MEDIAN_GEOM_NEAREST(tc, ts)                                            \
+  if (tap_count == (tc)) {                                                     \
+    int dist = (ts) > exact ? (ts) - exact : exact - (ts);                     \
+    if (dist < best_dist) {                                                    \
+      best = (ts);                                                             \
+      best_dist = dist;                                                        \
+    }                                                                          \
   }
-  arr[pos] = val;
-  return n + 1;
+  MEDIAN_GEOMETRIES(MEDIAN_GEOM_NEAREST)
+#undef MEDIAN_GEOM_NEAREST
+  return (uint16_t)best;
 }
 
-static inline uint16_t oldest_index(const impulse_detector *det) {
-  if (det->count < TAP_COUNT)
+MEDIAN_ALWAYS_INLINE uint16_t oldest_index(const impulse_detector *det,
+                                           const uint16_t tc) {
+  if (det->count < tc)
     return 0;
-  return (uint16_t)((det->head + 1) % TAP_COUNT);
+  return (uint16_t)((det->head + 1) % tc);
 }
 
-static inline uint16_t tap_index_by_age_from_oldest(const impulse_detector *det,
-                                                    uint16_t age) {
-  uint16_t o = oldest_index(det);
-  return (uint16_t)((o + age) % TAP_COUNT);
+MEDIAN_ALWAYS_INLINE uint16_t tap_index_by_age_from_oldest(
+    const impulse_detector *det, uint16_t age, const uint16_t tc) {
+  uint16_t o = oldest_index(det, tc);
+  return (uint16_t)((o + age) % tc);
 }
 
-static inline uint16_t middle_tap_index(const impulse_detector *det) {
-  uint16_t mid_age = (uint16_t)(TAP_COUNT / 2);
-  return tap_index_by_age_from_oldest(det, mid_age);
+MEDIAN_ALWAYS_INLINE sorted_col_val get_P_global(const impulse_detector *det,
+                                           int32_t g, uint8_t ch,
+                                           const uint16_t tc, const uint16_t ts,
+                                           const uint8_t nch) {
+  uint16_t age = (uint16_t)(g / ts);
+  uint16_t off = (uint16_t)(g % ts);
+  uint16_t tix = tap_index_by_age_from_oldest(det, age, tc);
+  return det->taps[((size_t)tix * ts + off) * nch + ch];
 }
 
-static inline uint32_t get_P_global(const impulse_detector *det, int32_t g) {
-  uint16_t age = (uint16_t)(g / TAP_SIZE);
-  uint16_t off = (uint16_t)(g % TAP_SIZE);
-  uint16_t tix = tap_index_by_age_from_oldest(det, age);
-  return det->taps[tix][off];
+static size_t storage_bytes(const impulse_detector_cfg *cfg, uint8_t nch) {
+  if (cfg == NULL) {
+    return 0;
+  }
+  return nch * IMPULSE_DETECTOR_STORAGE_WORDS(cfg->tap_count, cfg->tap_size) *
+         sizeof(uint32_t);
 }
 
-void impulse_detection_init(impulse_detector *det) {
+static enum impulse_det_state
+detector_init(impulse_detector *det, const impulse_detector_cfg *cfg,
+              void *storage, size_t storage_size, uint8_t nch) {
+  if (det == NULL || cfg == NULL || storage == NULL) {
+    return IMPULSE_DET_ERR_INVALID_ARG;
+  }
+  if (cfg->tap_count < 3 || cfg->tap_size == 0 ||
+      cfg->tap_size > IMPULSE_MAX_TAP_SIZE) {
+    return IMPULSE_DET_ERR_INVALID_ARG;
+  }
+  if (storage_size < storage_bytes(cfg, nch)) {
+    return IMPULSE_DET_ERR_BUFFER_TOO_SMALL;
+  }
+
   memset(det, 0, sizeof(*det));
+  det->cfg = *cfg;
+  det->channels = nch;
+  det->taps = (uint16_t *)storage;
+  det->sorted_cols =
+      det->taps + (size_t)nch * cfg->tap_count * cfg->tap_size;
+  det->tap_max =
+      det->sorted_cols + (size_t)nch * cfg->tap_count * cfg->tap_size;
+  det->geometry = geometry_id(cfg->tap_count, cfg->tap_size);
+  impulse_detector_reset(det);
+  return IMPULSE_DET_OK;
+}
+
+size_t impulse_detector_storage_size(const impulse_detector_cfg *cfg) {
+  return storage_bytes(cfg, 1);
+}
+
+enum impulse_det_state impulse_detector_init(impulse_detector *det,
+                                             const impulse_detector_cfg *cfg,
+                                             void *storage,
+                                             size_t storage_size) {
+  return detector_init(det, cfg, storage, storage_size, 1);
+}
+
+void impulse_detector_reset(impulse_detector *det) {
+  memset(det->taps, 0,
+         det->channels *
+             IMPULSE_DETECTOR_STORAGE_WORDS(det->cfg.tap_count,
+                                            det->cfg.tap_size) *
+             sizeof(uint32_t));
   det->head = 0;
   det->count = 0;
+  det->newest_index = 0;
+  memset(det->noise_sq, 0, sizeof(det->noise_sq));
 }
 
-void impulse_add_tap(impulse_detector *det, const int16_t *samples) {
-  uint16_t write_idx;
-  if (det->count == 0) {
-    write_idx = 0;
-  } else {
-    write_idx = (uint16_t)((det->head + 1) % TAP_COUNT);
+size_t impulse_stereo_detector_storage_size(const impulse_detector_cfg *cfg) {
+  return storage_bytes(cfg, 2);
+}
+
+enum impulse_det_state
+impulse_stereo_detector_init(impulse_stereo_detector *det,
+                             const impulse_detector_cfg *cfg, void *storage,
+                             size_t storage_size) {
+  if (det == NULL) {
+    return IMPULSE_DET_ERR_INVALID_ARG;
   }
+  return detector_init(&det->core, cfg, storage, storage_size, 2);
+}
 
-  bool full = (det->count == TAP_COUNT);
+void impulse_stereo_detector_reset(impulse_stereo_detector *det) {
+  impulse_detector_reset(&det->core);
+}
 
-  for (uint16_t i = 0; i < TAP_SIZE; i++) {
+#ifdef MEDIAN_DETECTION_TESTING
+void median_test_force_generic(impulse_detector *det) {
+  det->geometry = MEDIAN_GEOM_GENERIC;
+}
+#endif
 
-    uint32_t old_val = det->taps[write_idx][i];
-    int32_t s = samples[i];
-    uint32_t new_val = (uint32_t)((int64_t)s * (int64_t)s);
+// Magnitude as stored in the taps and columns; |INT16_MIN| still fits.
+static inline sorted_col_val magnitude(int16_t s) {
+  return (sorted_col_val)(s < 0 ? -(int32_t)s : (int32_t)s);
+}
 
-    det->taps[write_idx][i] = new_val;
+static inline uint32_t squared(sorted_col_val m) {
+  return (uint32_t)m * (uint32_t)m;
+}
 
-    uint32_t *col = det->sorted_cols[i];
+// Sum of the squared column median energies of channel `ch`, from scratch.
+MEDIAN_ALWAYS_INLINE uint64_t noise_sq_impl(const impulse_detector *det,
+                                            uint8_t ch, const uint16_t tc,
+                                            const uint16_t ts,
+                                            const uint8_t nch) {
+  uint64_t sum = 0;
+  for (uint16_t i = 0; i < ts; i++) {
+    uint64_t m =
+        squared(det->sorted_cols[((size_t)i * nch + ch) * tc + tc / 2]);
+    sum += m * m;
+  }
+  return sum;
+}
 
-    if (!full) {
-      col[det->count] = new_val;
-      uint16_t n = det->count;
-      int j = (int)n - 1;
-      while (j >= 0 && col[j] > new_val) {
-        col[j + 1] = col[j];
-        j--;
+MEDIAN_ALWAYS_INLINE void add_tap_impl(impulse_detector *det,
+                                       const int16_t *const *samples,
+                                       uint64_t sample_index,
+                                       const uint16_t tc, const uint16_t ts,
+                                       const uint8_t nch) {
+  uint16_t write_idx;
+  if (det->count == 0) {
+    write_idx = 0;
+  } else {
+    write_idx = (uint16_t)((det->head + 1) % tc);
+  }
+
+  bool full = (det->count == tc);
+  sorted_col_val *tap = &det->taps[(size_t)write_idx * ts * nch];
+
+  for (uint8_t ch = 0; ch < nch; ch++) {
+    sorted_col_val peak = 0;
+    // Wraps like the from-scratch sum would, so the two always agree.
+    uint64_t noise_sq = det->noise_sq[ch];
+    for (uint16_t i = 0; i < ts; i++) {
+      sorted_col_val old_val = tap[(size_t)i * nch + ch];
+      sorted_col_val new_val = magnitude(samples[ch][i]);
+
+      tap[(size_t)i * nch + ch] = new_val;
+      peak = new_val > peak ? new_val : peak;
+
+      sorted_col_val *col = &det->sorted_cols[((size_t)i * nch + ch) * tc];
+
+      if (!full) {
+        sorted_col_insert(col, det->count, new_val);
+      } else {
+        // Most replacements leave the median where it was.
+        const uint64_t med_old = squared(col[tc / 2]);
+        sorted_col_replace(col, tc, old_val, new_val);
+        const uint64_t med_new = squared(col[tc / 2]);
+        if (med_new != med_old) {
+          noise_sq += med_new * med_new - med_old * med_old;
+        }
       }
-      col[j + 1] = new_val;
-    } else {
-      uint16_t n = TAP_COUNT;
-      n = remove_value_sorted(col, n, old_val);
-      (void)insert_value_sorted(col, n, TAP_COUNT, new_val);
     }
+    det->tap_max[(size_t)write_idx * nch + ch] = peak;
+    det->noise_sq[ch] = noise_sq;
   }
 
   det->head = write_idx;
-  if (det->count < TAP_COUNT)
+  det->newest_index = sample_index;
+  if (det->count < tc) {
     det->count++;
+    if (det->count == tc) {
+      // The medians are only defined from here on.
+      for (uint8_t ch = 0; ch < nch; ch++) {
+        det->noise_sq[ch] = noise_sq_impl(det, ch, tc, ts, nch);
+      }
+    }
+  }
 }
 
-static inline uint32_t noise_median_at(const impulse_detector *det,
-                                       uint16_t i) {
-  return det->sorted_cols[i][TAP_COUNT / 2];
+void impulse_add_tap(impulse_detector *det, const int16_t *samples,
+                     uint64_t sample_index) {
+  const int16_t *const chans[1] = {samples};
+#define MEDIAN_KERNEL(tc, ts)                                                  \
+  {                                                                            \
+    add_tap_impl(det, chans, sample_index, tc, ts, 1);                         \
+    return;                                                                    \
+  }
+  MEDIAN_DISPATCH(det)
+#undef MEDIAN_KERNEL
 }
 
-static void sort_insertion_u32(uint32_t *arr, uint16_t n) {
-  for (uint16_t i = 1; i < n; i++) {
-    uint32_t key = arr[i];
-    int j = (int)i - 1;
-    while (j >= 0 && arr[j] > key) {
-      arr[j + 1] = arr[j];
-      j--;
-    }
-    arr[j + 1] = key;
+void impulse_stereo_add_tap(impulse_stereo_detector *det, const int16_t *left,
+                            const int16_t *right, uint64_t sample_index) {
+  const int16_t *const chans[2] = {left, right};
+#define MEDIAN_KERNEL(tc, ts)                                                  \
+  {                                                                            \
+    add_tap_impl(&det->core, chans, sample_index, tc, ts, 2);                  \
+    return;                                                                    \
   }
+  MEDIAN_DISPATCH(&det->core)
+#undef MEDIAN_KERNEL
+}
+
+static inline void swap_val(sorted_col_val *a, sorted_col_val *b) {
+  sorted_col_val t = *a;
+  *a = *b;
+  *b = t;
 }
 
-static uint32_t median_u32(uint32_t *arr, uint16_t n) {
+// Element n / 2 of arr[0..n) in ascending order (the value a full sort would
+// put there), by quickselect: about 2n comparisons instead of the n^2 / 4 of
+// an insertion sort. Reorders arr.
+static sorted_col_val median_val(sorted_col_val *arr, uint16_t n) {
   if (n == 0)
     return 0;
-  sort_insertion_u32(arr, n);
-  return arr[n / 2];
+  const int k = n / 2;
+  int lo = 0, hi = n - 1;
+  while (hi > lo) {
+    // Median of three as the pivot, left at arr[hi].
+    const int mid = lo + (hi - lo) / 2;
+    if (arr[mid] < arr[lo])
+      swap_val(&arr[mid], &arr[lo]);
+    if (arr[hi] < arr[lo])
+      swap_val(&arr[hi], &arr[lo]);
+    if (arr[mid] < arr[hi])
+      swap_val(&arr[mid], &arr[hi]);
+    const sorted_col_val pivot = arr[hi];
+    int store = lo;
+    for (int i = lo; i < hi; i++) {
+      if (arr[i] < pivot) {
+        swap_val(&arr[i], &arr[store]);
+        store++;
+      }
+    }
+    swap_val(&arr[store], &arr[hi]);
+    if (store == k)
+      return arr[k];
+    if (store < k)
+      lo = store + 1;
+    else
+      hi = store - 1;
+  }
+  return arr[k];
 }
 
-static uint16_t gather_window(const impulse_detector *det, int32_t start_g,
-                              int32_t end_g, uint32_t *out) {
+MEDIAN_ALWAYS_INLINE uint16_t gather_window(const impulse_detector *det,
+                                            int32_t start_g, int32_t end_g,
+                                            uint8_t ch, sorted_col_val *out,
+                                            const uint16_t tc,
+                                            const uint16_t ts,
+                                            const uint8_t nch) {
   uint16_t n = 0;
   for (int32_t g = start_g; g < end_g; g++) {
-    out[n++] = get_P_global(det, g);
+    out[n++] = get_P_global(det, g, ch, tc, ts, nch);
   }
   return n;
 }
 
-bool impulse_run_detection(impulse_detector *det) {
-  if (det->count < TAP_COUNT) {
+// Second and third criterion for one channel whose mid-tap maximum `val` at
+// `pos` already passed the first one.
+MEDIAN_ALWAYS_INLINE bool confirm_impl(const impulse_detector *det,
+                                       uint32_t val, int32_t pos, uint8_t ch,
+                                       impulse_result *result,
+                                       const uint16_t tc, const uint16_t ts,
+                                       const uint8_t nch) {
+  // second criterion: val > det_rms * rms(noise), squared so no square root
+  // is taken; both sides are non-negative when det_rms is.
+  const float rms = det->cfg.det_rms;
+  if (rms > 0.0f && (float)val * (float)val <=
+                        rms * rms * ((float)det->noise_sq[ch] / (float)ts)) {
     return false;
   }
 
-  uint16_t mid_idx = middle_tap_index(det);
-  const uint32_t *mid_tap = det->taps[mid_idx];
+  const uint16_t mid_age = (uint16_t)(tc / 2);
+  int32_t global_pos = (int32_t)mid_age * (int32_t)ts + pos;
 
-  uint64_t sum_noise_sq = 0;
+  sorted_col_val bufB[IMPULSE_MAX_TAP_SIZE];
+  sorted_col_val bufA[IMPULSE_MAX_TAP_SIZE];
 
-  uint32_t val = 0;
-  int32_t pos = -1;
-  uint32_t noise[TAP_SIZE];
+  uint16_t lenB = gather_window(det, global_pos, global_pos + (int32_t)ts, ch,
+                                bufB, tc, ts, nch);
 
-  for (int16_t i = 0; i < TAP_SIZE; i++) {
-    noise[i] = noise_median_at(det, i);
+  uint16_t lenA = gather_window(det, global_pos - (int32_t)ts, global_pos, ch,
+                                bufA, tc, ts, nch);
 
-    uint32_t diff = (mid_tap[i] > noise[i]) ? (mid_tap[i] - noise[i]) : 0;
-    if (diff > val) {
-      val = diff;
-      pos = i;
+  // The median of the magnitudes squared is the median of the energies.
+  uint32_t medB = squared(median_val(bufB, lenB));
+  uint32_t medA = squared(median_val(bufA, lenA));
+
+  // third criterion
+  if ((float)medB > (float)medA * det->cfg.det_energy) {
+    if (result) {
+      uint64_t oldest =
+          det->newest_index - (uint64_t)(tc - 1) * (uint64_t)ts;
+      result->peak_index = oldest + (uint64_t)global_pos;
+      result->window_offset = global_pos;
+      result->level = val;
     }
+    return true;
   }
 
-  if (pos < 0)
-    return false;
-
-  // first criterion
-  if (val <= DET_LEVEL) {
-    return false;
-  }
+  return false;
+}
 
-  for (uint16_t i = 0; i < TAP_SIZE; i++) {
-    sum_noise_sq += (uint64_t)noise[i] * (uint64_t)noise[i];
+// Evaluates the middle tap of every channel in one pass over the sample
+// positions. Returns a bit mask of the channels that fired; `results`
+// (optional, nch entries) receives their positions and `peak_pos` (optional,
+// nch entries) the mid-tap argmax of every channel, or -1.
+MEDIAN_ALWAYS_INLINE uint8_t run_detection_impl(impulse_detector *det,
+                                                impulse_result *results,
+                                                int32_t *peak_pos,
+                                                const uint16_t tc,
+                                                const uint16_t ts,
+                                                const uint8_t nch) {
+  if (det->count < tc) {
+    return 0;
   }
 
-  float rms_noise = sqrtf((float)sum_noise_sq / (float)TAP_SIZE);
+  const uint16_t mid_age = (uint16_t)(tc / 2);
+  uint16_t mid_idx = tap_index_by_age_from_oldest(det, mid_age, tc);
 
-  // second criterion
-  if ((float)val <= DET_RMS * rms_noise) {
-    return false;
+  // Pre-gate: a sample's excursion above the median is at most the sample,
+  // so when no channel's middle-tap peak clears det_level nothing can fire.
+  // This is the common, quiet case.
+  const sorted_col_val *mid_max = &det->tap_max[(size_t)mid_idx * nch];
+  bool open = false;
+  for (uint8_t ch = 0; ch < nch; ch++) {
+    open = open || squared(mid_max[ch]) > det->cfg.det_level;
+  }
+  if (!open) {
+    for (uint8_t ch = 0; peak_pos && ch < nch; ch++) {
+      peak_pos[ch] = -1;
+    }
+    return 0;
   }
 
-  uint16_t mid_age = (uint16_t)(TAP_COUNT / 2);
-  int32_t global_pos = (int32_t)mid_age * (int32_t)TAP_SIZE + pos;
+  const sorted_col_val *mid_tap = &det->taps[(size_t)mid_idx * ts * nch];
 
-  uint32_t bufB[TAP_SIZE];
-  uint32_t bufA[TAP_SIZE];
+  uint32_t val[IMPULSE_MAX_CHANNELS] = {0};
+  int32_t pos[IMPULSE_MAX_CHANNELS] = {-1, -1};
 
-  uint16_t lenB =
-      gather_window(det, global_pos, global_pos + (int32_t)TAP_SIZE, bufB);
+  for (uint16_t i = 0; i < ts; i++) {
+    for (uint8_t ch = 0; ch < nch; ch++) {
+      sorted_col_val n =
+          det->sorted_cols[((size_t)i * nch + ch) * tc + tc / 2];
+      sorted_col_val p = mid_tap[(size_t)i * nch + ch];
 
-  uint16_t lenA =
-      gather_window(det, global_pos - (int32_t)TAP_SIZE, global_pos, bufA);
+      uint32_t diff = (p > n) ? squared(p) - squared(n) : 0;
+      if (diff > val[ch]) {
+        val[ch] = diff;
+        pos[ch] = i;
+      }
+    }
+  }
 
-  uint32_t medB = median_u32(bufB, lenB);
-  uint32_t medA = median_u32(bufA, lenA);
+  uint8_t fired = 0;
+  for (uint8_t ch = 0; ch < nch; ch++) {
+    if (peak_pos) {
+      peak_pos[ch] = pos[ch];
+    }
+    // first criterion
+    if (pos[ch] < 0 || val[ch] <= det->cfg.det_level) {
+      continue;
+    }
+    if (confirm_impl(det, val[ch], pos[ch], ch, results ? &results[ch] : NULL,
+                     tc, ts, nch)) {
+      fired |= (uint8_t)(1u << ch);
+    }
+  }
+  return fired;
+}
 
-  // third criterion
-  if ((float)medB > (float)medA * DET_ENERGY) {
-    return true;
+bool impulse_run_detection(impulse_detector *det, impulse_result *result) {
+#define MEDIAN_KERNEL(tc, ts)                                                  \
+  return run_detection_impl(det, result, NULL, tc, ts, 1) != 0;
+  MEDIAN_DISPATCH(det)
+#undef MEDIAN_KERNEL
+}
+
+bool impulse_stereo_run_detection(impulse_stereo_detector *det,
+                                  impulse_stereo_result *result) {
+  impulse_result hits[2] = {{0}};
+  int32_t peak_pos[2];
+  uint8_t fired = 0;
+#define MEDIAN_KERNEL(tc, ts)                                                  \
+  {                                                                            \
+    fired = run_detection_impl(&det->core, hits, peak_pos, tc, ts, 2);         \
+    break;                                                                     \
   }
+  MEDIAN_DISPATCH(&det->core)
+#undef MEDIAN_KERNEL
 
-  return false;
+  if (fired == 0) {
+    return false;
+  }
+  if (result) {
+    result->fired = fired;
+    result->left = hits[0];
+    result->right = hits[1];
+    result->offset_valid = peak_pos[0] >= 0 && peak_pos[1] >= 0;
+    result->lr_offset =
+        result->offset_valid ? peak_pos[1] - peak_pos[0] : 0;
+  }
+  return true;
 }
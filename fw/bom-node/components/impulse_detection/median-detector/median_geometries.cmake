@@ -0,0 +1,41 @@
+# Generates median_geometries.h for the shared median detector.
+#
+#   median_generate_geometries(<spec> <out_dir>)
+#
+# <spec> lists the geometries that get a specialised, constant-bound detector
+# instance, e.g. "31x30 31x16" (<tap_count>x<tap_size>, separated by spaces or
+# commas). Any other geometry still works through the generic path.
+function(median_generate_geometries spec out_dir)
+    string(REPLACE "," " " spec "${spec}")
+    separate_arguments(items UNIX_COMMAND "${spec}")
+
+    set(body "")
+    set(seen "")
+    foreach(item IN LISTS items)
+        if(NOT item MATCHES "^([0-9]+)x([0-9]+)$")
+            message(FATAL_ERROR
+                "Invalid detector geometry '${item}', expected <taps>x<size>")
+        endif()
+        set(taps ${CMAKE_MATCH_1})
+        set(size ${CMAKE_MATCH_2})
+        if(taps LESS 3 OR size LESS 1 OR size GREATER 128)
+            message(FATAL_ERROR
+                "Detector geometry '${item}' out of range (taps >= 3, 1 <= size <= 128)")
+        endif()
+        if("${taps}x${size}" IN_LIST seen)
+            continue()
+        endif()
+        list(APPEND seen "${taps}x${size}")
+        string(APPEND body " \\\n  X(${taps}, ${size})")
+    endforeach()
+
+    set(content "// Generated by median_geometries.cmake - do not edit.\n")
+    string(APPEND content "#ifndef MEDIAN_GEOMETRIES_H\n#define MEDIAN_GEOMETRIES_H\n\n")
+    string(APPEND content "#define MEDIAN_GEOMETRIES(X)${body}\n\n#endif\n")
+
+    # Only touch the header when it changes so dependants do not rebuild.
+    file(WRITE "${out_dir}/median_geometries.h.tmp" "${content}")
+    configure_file("${out_dir}/median_geometries.h.tmp"
+                   "${out_dir}/median_geometries.h" COPYONLY)
+    message(STATUS "Median detector geometries: ${seen}")
+endfunction()
@@ -0,0 +1,148 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_cpu.h"
+#include "sdkconfig.h"
+#define METRICS_SHARDS CONFIG_FREERTOS_NUMBER_OF_CORES
+#else
+#define METRICS_SHARDS 2
+#endif
+
+// Process-wide metrics registry with a Prometheus text exposition.
+//
+// Counters and histogram buckets are sharded per core: an increment is one
+// relaxed atomic add on the caller's core's 32-bit slot, so the cores never
+// race on one word and no lock is taken. The scraper folds each
+// slot's change since the previous scrape into a 64-bit total, so totals do
+// not wrap as long as a scrape comes before one slot advances by 2^32.
+//
+// Metrics are statically allocated by their owner and registered once at
+// start-up. A metric sharing the name of a registered one (a family told
+// apart by labels) is placed right after it. For values that already live
+// elsewhere, a collector writes samples at scrape time instead.
+
+#define METRICS_HISTOGRAM_MAX_BUCKETS 12
+
+typedef enum {
+  METRICS_COUNTER,
+  METRICS_GAUGE,
+  METRICS_HISTOGRAM,
+  METRICS_COLLECTOR,
+} metrics_type;
+
+typedef struct metrics_out metrics_out;
+typedef void (*metrics_collect_fn)(metrics_out *out, void *ctx);
+
+typedef struct metrics_metric {
+  const char *name;
+  const char *help;
+  const char *labels; // e.g. "method=\"get\"", or NULL
+  metrics_type type;
+  struct metrics_metric *next;
+} metrics_metric;
+
+typedef struct {
+  _Atomic uint32_t slot[METRICS_SHARDS];
+  uint32_t seen[METRICS_SHARDS]; // slot values at the last fold
+  uint64_t total;
+} metrics_shard;
+
+typedef struct {
+  metrics_metric base;
+  metrics_shard value;
+} metrics_counter;
+
+typedef struct {
+  metrics_metric base;
+  _Atomic int32_t value;
+} metrics_gauge;
+
+typedef struct {
+  metrics_metric base;
+  int edges;                                        // upper bounds in use
+  uint32_t le[METRICS_HISTOGRAM_MAX_BUCKETS];       // inclusive, ascending
+  metrics_shard bucket[METRICS_HISTOGRAM_MAX_BUCKETS + 1]; // last: +Inf
+  metrics_shard sum;
+} metrics_histogram;
+
+typedef struct {
+  metrics_metric base;
+  metrics_collect_fn fn;
+  void *ctx;
+} metrics_collector;
+
+#define METRICS_COUNTER_INIT(name_, help_)                                     \
+  {.base = {.name = (name_), .help = (help_), .type = METRICS_COUNTER}}
+#define METRICS_COUNTER_LABELED_INIT(name_, help_, labels_)                    \
+  {.base = {.name = (name_),                                                   \
+            .help = (help_),                                                   \
+            .labels = (labels_),                                               \
+            .type = METRICS_COUNTER}}
+#define METRICS_GAUGE_INIT(name_, help_)                                       \
+  {.base = {.name = (name_), .help = (help_), .type = METRICS_GAUGE}}
+// Bucket upper bounds follow the help text, ascending.
+#define METRICS_HISTOGRAM_INIT(name_, help_, ...)                              \
+  {.base = {.name = (name_), .help = (help_), .type = METRICS_HISTOGRAM},     \
+   .edges = sizeof((uint32_t[]){__VA_ARGS__}) / sizeof(uint32_t),              \
+   .le = {__VA_ARGS__}}
+#define METRICS_COLLECTOR_INIT(fn_, ctx_)                                      \
+  {.base = {.type = METRICS_COLLECTOR}, .fn = (fn_), .ctx = (ctx_)}
+
+static inline int metrics_core(void) {
+#ifdef ESP_PLATFORM
+  return (int)esp_cpu_get_core_id();
+#else
+  return 0;
+#endif
+}
+
+// Adds a metric to the registry; a metric already registered is ignored.
+void metrics_register(metrics_metric *m);
+
+static inline void metrics_shard_add(metrics_shard *s, uint32_t n) {
+  atomic_fetch_add_explicit(&s->slot[metrics_core()], n, memory_order_relaxed);
+}
+
+static inline void metrics_counter_add(metrics_counter *c, uint32_t n) {
+  metrics_shard_add(&c->value, n);
+}
+
+static inline void metrics_counter_inc(metrics_counter *c) {
+  metrics_shard_add(&c->value, 1);
+}
+
+// Sum of the slots, modulo 2^32: for callers that keep 32-bit counters.
+uint32_t metrics_counter_read32(const metrics_counter *c);
+
+static inline void metrics_gauge_set(metrics_gauge *g, int32_t v) {
+  atomic_store_explicit(&g->value, v, memory_order_relaxed);
+}
+
+static inline void metrics_gauge_add(metrics_gauge *g, int32_t n) {
+  atomic_fetch_add_explicit(&g->value, n, memory_order_relaxed);
+}
+
+void metrics_histogram_observe(metrics_histogram *h, uint32_t v);
+
+// Text exposition, written through `sink` one line at a time. Folding
+// updates the totals, so only one scrape may run at a time.
+typedef void (*metrics_sink_fn)(const char *data, size_t len, void *ctx);
+void metrics_expose(metrics_sink_fn sink, void *ctx);
+
+// For collectors: a family header, then its samples. `labels` may be NULL.
+void metrics_out_family(metrics_out *out, const char *name, const char *type,
+                        const char *help);
+void metrics_out_uint(metrics_out *out, const char *name, const char *labels,
+                      uint64_t value);
+void metrics_out_int(metrics_out *out, const char *name, const char *labels,
+                     int64_t value);
+void metrics_out_double(metrics_out *out, const char *name, const char *labels,
+                        double value);
+
+#endif
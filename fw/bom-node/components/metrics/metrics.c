@@ -0,0 +1,199 @@
+#include "metrics.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+#define METRICS_LOCK() taskENTER_CRITICAL(&s_lock)
+#define METRICS_UNLOCK() taskEXIT_CRITICAL(&s_lock)
+#else
+#define METRICS_LOCK()
+#define METRICS_UNLOCK()
+#endif
+
+#define METRICS_LINE_MAX 192
+
+struct metrics_out {
+  metrics_sink_fn sink;
+  void *ctx;
+};
+
+static metrics_metric *s_head = NULL;
+static metrics_metric *s_tail = NULL;
+
+void metrics_register(metrics_metric *m) {
+  METRICS_LOCK();
+  if (m->next == NULL && m != s_tail) {
+    // Joins its family, so components registering concurrently at start-up
+    // cannot split one.
+    metrics_metric *after = s_tail;
+    if (m->name) {
+      for (metrics_metric *it = s_head; it; it = it->next) {
+        if (it->name && strcmp(it->name, m->name) == 0) {
+          after = it;
+        }
+      }
+    }
+    if (!after) {
+      s_head = m;
+    } else {
+      m->next = after->next;
+      after->next = m;
+    }
+    if (after == s_tail) {
+      s_tail = m;
+    }
+  }
+  METRICS_UNLOCK();
+}
+
+uint32_t metrics_counter_read32(const metrics_counter *c) {
+  uint32_t sum = 0;
+  for (int i = 0; i < METRICS_SHARDS; i++) {
+    sum += atomic_load_explicit(&c->value.slot[i], memory_order_relaxed);
+  }
+  return sum;
+}
+
+void metrics_histogram_observe(metrics_histogram *h, uint32_t v) {
+  int b = 0;
+  while (b < h->edges && v > h->le[b]) {
+    b++;
+  }
+  metrics_shard_add(&h->bucket[b], 1);
+  metrics_shard_add(&h->sum, v);
+}
+
+// Only the scraper folds, so `seen` and `total` need no atomics.
+static uint64_t fold(metrics_shard *s) {
+  for (int i = 0; i < METRICS_SHARDS; i++) {
+    const uint32_t now =
+        atomic_load_explicit(&s->slot[i], memory_order_relaxed);
+    s->total += (uint32_t)(now - s->seen[i]);
+    s->seen[i] = now;
+  }
+  return s->total;
+}
+
+__attribute__((format(printf, 2, 3))) static void out_line(metrics_out *out, const char *fmt, ...) {
+  char line[METRICS_LINE_MAX];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(line, sizeof(line), fmt, ap);
+  va_end(ap);
+  if (n < 0) {
+    return;
+  }
+  if ((size_t)n >= sizeof(line)) {
+    // Cut, but keep the line a line.
+    n = sizeof(line) - 1;
+    line[n - 1] = '\n';
+  }
+  out->sink(line, (size_t)n, out->ctx);
+}
+
+void metrics_out_family(metrics_out *out, const char *name, const char *type,
+                        const char *help) {
+  if (help) {
+    out_line(out, "# HELP %s %s\n", name, help);
+  }
+  out_line(out, "# TYPE %s %s\n", name, type);
+}
+
+void metrics_out_uint(metrics_out *out, const char *name, const char *labels,
+                      uint64_t value) {
+  if (labels) {
+    out_line(out, "%s{%s} %" PRIu64 "\n", name, labels, value);
+  } else {
+    out_line(out, "%s %" PRIu64 "\n", name, value);
+  }
+}
+
+void metrics_out_int(metrics_out *out, const char *name, const char *labels,
+                     int64_t value) {
+  if (labels) {
+    out_line(out, "%s{%s} %" PRId64 "\n", name, labels, value);
+  } else {
+    out_line(out, "%s %" PRId64 "\n", name, value);
+  }
+}
+
+void metrics_out_double(metrics_out *out, const char *name, const char *labels,
+                        double value) {
+  if (labels) {
+    out_line(out, "%s{%s} %.9g\n", name, labels, value);
+  } else {
+    out_line(out, "%s %.9g\n", name, value);
+  }
+}
+
+static void expose_histogram(metrics_out *out, metrics_histogram *h) {
+  const char *name = h->base.name;
+  const char *labels = h->base.labels;
+  const char *sep = labels ? "," : "";
+  labels = labels ? labels : "";
+  uint64_t cumulative = 0;
+  for (int b = 0; b <= h->edges; b++) {
+    cumulative += fold(&h->bucket[b]);
+    if (b < h->edges) {
+      out_line(out, "%s_bucket{%s%sle=\"%" PRIu32 "\"} %" PRIu64 "\n", name,
+               labels, sep, h->le[b], cumulative);
+    } else {
+      out_line(out, "%s_bucket{%s%sle=\"+Inf\"} %" PRIu64 "\n", name, labels,
+               sep, cumulative);
+    }
+  }
+  const char *plain = h->base.labels;
+  char sum_name[METRICS_LINE_MAX / 2];
+  snprintf(sum_name, sizeof(sum_name), "%s_sum", name);
+  metrics_out_uint(out, sum_name, plain, fold(&h->sum));
+  snprintf(sum_name, sizeof(sum_name), "%s_count", name);
+  metrics_out_uint(out, sum_name, plain, cumulative);
+}
+
+void metrics_expose(metrics_sink_fn sink, void *ctx) {
+  metrics_out out = {.sink = sink, .ctx = ctx};
+  METRICS_LOCK();
+  metrics_metric *m = s_head;
+  METRICS_UNLOCK();
+
+  // Registration only appends, so the list can be walked unlocked.
+  const char *family = NULL;
+  for (; m; m = m->next) {
+    if (m->type == METRICS_COLLECTOR) {
+      metrics_collector *c = (metrics_collector *)m;
+      c->fn(&out, c->ctx);
+      family = NULL;
+      continue;
+    }
+    if (!family || strcmp(family, m->name) != 0) {
+      static const char *const types[] = {
+          [METRICS_COUNTER] = "counter",
+          [METRICS_GAUGE] = "gauge",
+          [METRICS_HISTOGRAM] = "histogram",
+      };
+      metrics_out_family(&out, m->name, types[m->type], m->help);
+      family = m->name;
+    }
+    switch (m->type) {
+    case METRICS_COUNTER:
+      metrics_out_uint(&out, m->name, m->labels,
+                       fold(&((metrics_counter *)m)->value));
+      break;
+    case METRICS_GAUGE:
+      metrics_out_int(&out, m->name, m->labels,
+                      atomic_load_explicit(&((metrics_gauge *)m)->value,
+                                           memory_order_relaxed));
+      break;
+    case METRICS_HISTOGRAM:
+      expose_histogram(&out, (metrics_histogram *)m);
+      break;
+    default:
+      break;
+    }
+  }
+}
@@ -0,0 +1,74 @@
+#include "dma_tuner.h"
+
+#include <string.h>
+
+static int clamp_desc(const dma_tuner *t, int desc) {
+  if (desc < t->min_desc)
+    return t->min_desc;
+  if (desc > t->max_desc)
+    return t->max_desc;
+  return desc;
+}
+
+static void window_start(dma_tuner *t, uint32_t overflows) {
+  t->chunks = 0;
+  t->lag_max_us = 0;
+  t->lag_known = true;
+  t->overflows = overflows;
+}
+
+void dma_tuner_init(dma_tuner *t, int desc_num, int min_desc, int max_desc,
+                    uint32_t period_us, uint32_t overflows) {
+  memset(t, 0, sizeof(*t));
+  t->min_desc = (uint16_t)min_desc;
+  t->max_desc = (uint16_t)(max_desc < min_desc ? min_desc : max_desc);
+  t->desc_num = (uint16_t)clamp_desc(t, desc_num);
+  t->period_us = period_us;
+  window_start(t, overflows);
+}
+
+int dma_tuner_chunk(dma_tuner *t, int32_t lag_us, uint32_t overflows) {
+  if (lag_us < 0) {
+    t->lag_known = false;
+  } else if ((uint32_t)lag_us > t->lag_max_us) {
+    t->lag_max_us = (uint32_t)lag_us;
+  }
+  // Lost audio does not wait for the window to end.
+  const bool lost = overflows != t->overflows;
+  if (!lost && ++t->chunks < DMA_TUNER_WINDOW_CHUNKS) {
+    return t->desc_num;
+  }
+
+  int want = t->desc_num;
+  const int used = dma_tuner_buffers_for(t->lag_max_us, t->period_us);
+  if (lost) {
+    want = t->desc_num + DMA_TUNER_OVERFLOW_STEP;
+    if (used + DMA_TUNER_MARGIN > want) {
+      want = used + DMA_TUNER_MARGIN;
+    }
+    t->calm_windows = 0;
+  } else if (used + DMA_TUNER_MARGIN > t->desc_num) {
+    want = used + DMA_TUNER_MARGIN;
+    t->calm_windows = 0;
+  } else if (t->lag_known && used + 2 * DMA_TUNER_MARGIN < t->desc_num) {
+    if (++t->calm_windows >= DMA_TUNER_CALM_WINDOWS) {
+      want = t->desc_num - 1;
+      t->calm_windows = 0;
+    }
+  } else {
+    t->calm_windows = 0;
+  }
+  window_start(t, overflows);
+  return clamp_desc(t, want);
+}
+
+void dma_tuner_resized(dma_tuner *t, int desc_num, uint32_t period_us,
+                       uint32_t overflows) {
+  if (desc_num != t->desc_num || period_us != t->period_us) {
+    t->resizes++;
+  }
+  t->desc_num = (uint16_t)clamp_desc(t, desc_num);
+  t->period_us = period_us;
+  t->calm_windows = 0;
+  window_start(t, overflows);
+}
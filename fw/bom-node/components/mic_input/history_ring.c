@@ -0,0 +1,52 @@
+#include "history_ring.h"
+
+#include <assert.h>
+
+void history_ring_attach(history_ring *h, int16_t *storage, int samples) {
+  rb_attach(&h->left, storage, samples);
+  rb_attach(&h->right, storage + samples, samples);
+  history_ring_reset(h, 0);
+}
+
+void history_ring_reset(history_ring *h, uint64_t index) {
+  h->left.head = 0;
+  h->right.head = 0;
+  h->base = index;
+  h->head = index;
+  h->writing = index;
+}
+
+history_ring_state history_ring_check(const history_ring *h, uint64_t start,
+                                      int length) {
+  const uint64_t cap = (uint64_t)history_ring_capacity(h);
+  if (length < 0 || (uint64_t)length > cap || start < h->base ||
+      start + cap < h->writing) {
+    return HISTORY_RING_LOST;
+  }
+  if (start + (uint64_t)length > h->head) {
+    return HISTORY_RING_PENDING;
+  }
+  return HISTORY_RING_OK;
+}
+
+void history_ring_begin(history_ring *h, int count) {
+  assert(count >= 0 && count <= history_ring_capacity(h));
+  h->writing = h->head + (uint64_t)count;
+}
+
+void history_ring_store(history_ring *h, const int16_t *left,
+                        const int16_t *right, int count) {
+  rb_push_block(&h->left, left, count);
+  rb_push_block(&h->right, right, count);
+}
+
+void history_ring_end(history_ring *h) { h->head = h->writing; }
+
+void history_ring_read(const history_ring *h, uint64_t start, int length,
+                       int16_t *out_left, int16_t *out_right) {
+  // Ring position 0 is where the writer stood at the reset.
+  const int pos =
+      (int)((start - h->base) % (uint64_t)history_ring_capacity(h));
+  rb_copy_from(&h->left, out_left, pos, length);
+  rb_copy_from(&h->right, out_right, pos, length);
+}
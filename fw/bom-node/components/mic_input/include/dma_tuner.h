@@ -0,0 +1,59 @@
+#ifndef DMA_TUNER_H
+#define DMA_TUNER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Picks the number of I2S DMA buffers from what the reader measures. The
+// queue has to bridge the longest time the reader is away from its read:
+// processing a chunk, running the tap callbacks, being preempted. More
+// buffers are more headroom; fewer are less memory and, once the reader
+// falls behind, less audio queued between capture and the taps.
+//
+// The reader reports each read's lag, the capture-to-arrival delay of its
+// last frame (from the sample clock fit), and the DMA overflow count. Every
+// DMA_TUNER_WINDOW_CHUNKS reads the worst lag is turned into the buffers it
+// kept occupied: an overflow or a margin below DMA_TUNER_MARGIN grows the
+// queue at once, DMA_TUNER_CALM_WINDOWS windows with more than twice the
+// margin spare shrink it by one.
+
+#define DMA_TUNER_WINDOW_CHUNKS 128 // 1.5 s of 510-frame reads at 44.1 kHz
+#define DMA_TUNER_MARGIN 2          // spare buffers kept beyond the worst lag
+#define DMA_TUNER_CALM_WINDOWS 8
+#define DMA_TUNER_OVERFLOW_STEP 2   // buffers added after lost audio
+
+typedef struct {
+  uint16_t min_desc, max_desc;
+  uint16_t desc_num;      // in effect
+  uint32_t period_us;     // audio per buffer
+  // Current window.
+  uint32_t chunks;
+  uint32_t lag_max_us;
+  bool lag_known;         // every read of the window had a lag
+  uint32_t overflows;     // count at the start of the window
+  uint16_t calm_windows;
+  uint32_t resizes;
+} dma_tuner;
+
+// Starts with `desc_num` buffers of `period_us` each, kept within
+// min_desc .. max_desc. `overflows` is the source's current count.
+void dma_tuner_init(dma_tuner *t, int desc_num, int min_desc, int max_desc,
+                    uint32_t period_us, uint32_t overflows);
+
+// Accounts one read. `lag_us` is negative while the lag is unknown (clock
+// not locked); such a window can grow the queue on overflows but never
+// shrinks it. Returns the buffer count wanted from now on; when it differs
+// from the one in effect the caller rebuilds the queue and, whether that
+// worked or not, reports the outcome with dma_tuner_resized().
+int dma_tuner_chunk(dma_tuner *t, int32_t lag_us, uint32_t overflows);
+
+// The queue now has `desc_num` buffers of `period_us`; starts a new window.
+void dma_tuner_resized(dma_tuner *t, int desc_num, uint32_t period_us,
+                       uint32_t overflows);
+
+// Buffers a lag of `lag_us` keeps occupied, the one being filled included.
+static inline int dma_tuner_buffers_for(uint32_t lag_us, uint32_t period_us) {
+  return period_us ? (int)((lag_us + period_us - 1) / period_us) + 1 : 1;
+}
+
+#endif
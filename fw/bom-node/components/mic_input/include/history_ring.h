@@ -0,0 +1,52 @@
+#ifndef HISTORY_RING_H
+#define HISTORY_RING_H
+
+#include "ring_buffer.h"
+
+#include <stdint.h>
+
+// Stereo ring addressed by absolute sample index, for ranges far longer than
+// the mic ring. One writer appends whole blocks; readers copy any retained
+// range out. Writes are bracketed by history_ring_begin()/_end() so a reader
+// that checks before and after its copy can tell that it was lapped: the
+// caller serialises those index updates and the checks (mic_history.c holds
+// a spinlock for just that), while the copies themselves run unlocked.
+typedef struct {
+  rb_struct left;
+  rb_struct right;
+  uint64_t base;    // absolute index of the first sample since the reset
+  uint64_t head;    // one past the newest committed sample
+  uint64_t writing; // one past the newest sample being written
+} history_ring;
+
+typedef enum {
+  HISTORY_RING_OK,
+  HISTORY_RING_PENDING, // the range ends past the newest committed sample
+  HISTORY_RING_LOST,    // part of it is older than the retained span
+} history_ring_state;
+
+// `storage` holds 2 * samples int16_t, one plane per channel.
+void history_ring_attach(history_ring *h, int16_t *storage, int samples);
+// Empties the ring; the next block appended starts at `index`.
+void history_ring_reset(history_ring *h, uint64_t index);
+static inline int history_ring_capacity(const history_ring *h) {
+  return h->left.size;
+}
+
+history_ring_state history_ring_check(const history_ring *h, uint64_t start,
+                                      int length);
+
+// Writer: announce `count` samples, copy them, then publish them.
+// Requires count <= capacity.
+void history_ring_begin(history_ring *h, int count);
+void history_ring_store(history_ring *h, const int16_t *left,
+                        const int16_t *right, int count);
+void history_ring_end(history_ring *h);
+
+// Copies [start, start + length) per channel. Only meaningful for a range
+// history_ring_check() reported OK; check again afterwards, a LOST result
+// means the writer overwrote part of the copy.
+void history_ring_read(const history_ring *h, uint64_t start, int length,
+                       int16_t *out_left, int16_t *out_right);
+
+#endif
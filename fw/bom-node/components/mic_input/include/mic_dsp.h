@@ -0,0 +1,94 @@
+#ifndef MIC_DSP_H
+#define MIC_DSP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Block DSP kernels for the I2S reader. One call processes a whole DMA chunk
+// of interleaved 32-bit stereo frames into two 16-bit planes, so the reader
+// loop no longer pays per-sample call/branch/modulo overhead.
+
+typedef enum {
+  // One-pole DC blocker: y[n] = x[n] - x[n-1] + R * y[n-1], R in Q31.
+  MIC_DC_ONE_POLE = 0,
+  // 2nd-order Butterworth high-pass, direct form I, coefficients in Q30.
+  MIC_DC_BIQUAD_HPF = 1,
+} mic_dc_filter_type;
+
+// Bits below the 16-bit sample the high-resolution input keeps from the
+// 32-bit I2S slot; the microphones deliver 24.
+#define MIC_DSP_HIGH_RES_BITS 8
+
+// Output gain in Q12; MIC_DSP_GAIN_UNITY is 0 dB.
+#define MIC_DSP_GAIN_FRAC 12
+#define MIC_DSP_GAIN_UNITY (1 << MIC_DSP_GAIN_FRAC)
+
+// The output history is kept in Q14 so the feedback term no longer truncates
+// to whole LSBs each sample (which left a DC bias of up to 1 / (1 - R) LSB);
+// the output is scaled by the gain, rounded and saturated to int16. The
+// input is in 16-bit LSBs, or with MIC_DSP_HIGH_RES_BITS fractional bits in
+// high-resolution mode (same headroom: Q14 leaves four times full scale).
+typedef struct {
+  uint8_t type;    // mic_dc_filter_type
+  uint8_t in_frac; // fractional input bits: 0 or MIC_DSP_HIGH_RES_BITS
+  int32_t gain;    // Q12 (MIC_DSP_GAIN_FRAC)
+  int32_t b0;   // biquad: b0 = -b1 / 2 = b2 (Q30)
+  int32_t a1;   // one-pole: R (Q31); biquad: a1 (Q30)
+  int32_t a2;   // biquad: a2 (Q30)
+  int32_t x1, x2;
+  int32_t y1, y2; // Q14
+} mic_dc_filter;
+
+// Sample rates with precomputed coefficients for the cutoff the component
+// is built with (MIC_DC_TABLE_FC_HZ, from CONFIG_MIC_DC_BLOCK_FREQ_HZ).
+// Other rates and cutoffs are computed at init with the same series
+// expansions, without libm.
+#define MIC_DC_TABLE_RATES(X)                                                  \
+  X(8000) X(11025) X(16000) X(22050) X(32000) X(44100) X(48000)
+
+// Sets coefficients for cutoff `fc_hz` (<= 0 selects 20 Hz) at rate `fs` and
+// clears the history. Returns true when the coefficients came from the
+// precomputed table.
+bool mic_dc_filter_init(mic_dc_filter *st, int fs, int fc_hz,
+                        mic_dc_filter_type type);
+
+// mic_dc_filter_init() sets 16-bit input at unity gain. `high_res` keeps
+// MIC_DSP_HIGH_RES_BITS more of each slot through the offset and the DC
+// blocker, so the signal is rounded to 16 bits once, after the gain, instead
+// of on input; `gain_q12` scales the output before it is narrowed (below
+// unity it leaves headroom for the filter's overshoot on loud impulses).
+// Clears the history, whose scale changes.
+void mic_dc_filter_set_output(mic_dc_filter *st, bool high_res,
+                              int32_t gain_q12);
+
+// 10^(db / 20) in Q12 for whole dB, without libm; `db` is clamped to
+// [-24, 24].
+int32_t mic_dsp_gain_q12(int db);
+
+// Moves the filter's input history by `delta` 16-bit LSBs, so that changing
+// the DC offset added to its input by `delta` causes no transient at the
+// output.
+void mic_dc_filter_shift(mic_dc_filter *st, int32_t delta);
+
+// Deinterleave (L = odd slot, R = even slot), take the upper 16 bits (or 24
+// in high-resolution mode), add the per-channel DC offset (in 32 bits, so a
+// large offset cannot wrap the sample), run the DC blocker and apply the
+// gain on `frames` frames. Both filters must be of the same type, resolution
+// and gain; they are dispatched once per call. `out_left` / `out_right` must
+// hold at least `frames` samples each.
+void mic_dsp_process_chunk(const int32_t *interleaved, int frames,
+                           int16_t offset_left, int16_t offset_right,
+                           mic_dc_filter *dcf_left, mic_dc_filter *dcf_right,
+                           int16_t *out_left, int16_t *out_right);
+
+// Adds the raw upper-16-bit samples of `frames` frames to the per-channel
+// sums, for DC offset calibration. Unrolled four frames per iteration.
+void mic_dsp_sum_chunk(const int32_t *interleaved, int frames,
+                       int64_t *sum_left, int64_t *sum_right);
+
+// Compares the block kernels with the original per-sample reader loop on a
+// synthetic chunk and logs cycles per frame. Only built with
+// CONFIG_MIC_DSP_BENCHMARK.
+void mic_dsp_run_benchmark(int tap_size);
+
+#endif
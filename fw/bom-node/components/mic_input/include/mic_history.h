@@ -0,0 +1,42 @@
+#ifndef MIC_HISTORY_H
+#define MIC_HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Multi-second record of the processed microphone stream, independent of
+// the detector window. A tap subscriber block-copies every batch into a
+// ring in the large audio arena (PSRAM when fitted), sized for
+// CONFIG_MIC_HISTORY_MS at MIC_HISTORY_MAX_RATE. Readers never hold up the
+// reader task: they copy without a lock and find out afterwards whether they
+// were lapped. A mic reconfiguration starts the history over.
+
+#define MIC_HISTORY_MAX_RATE 48000
+
+typedef enum {
+  MIC_HISTORY_OK,
+  MIC_HISTORY_PENDING, // the range is not fully captured yet
+  MIC_HISTORY_LOST,    // overwritten, from another epoch, or no history
+} mic_history_state;
+
+// Reserves the ring and subscribes it to the taps. Call after mic_init()
+// and before mic_start(); a no-op returning false when CONFIG_MIC_HISTORY_MS
+// is 0 or the memory is not there.
+bool mic_history_start(void);
+
+// Samples per channel the history retains; 0 when it is not running.
+int mic_history_samples(void);
+
+// Whether [start_index, start_index + length) of `epoch` can be read now.
+mic_history_state mic_history_check(uint32_t epoch, uint64_t start_index,
+                                    int length);
+
+// Copies `length` samples per channel from absolute index `start_index`,
+// captured under mic_config_epoch() `epoch`. The output is only valid for
+// MIC_HISTORY_OK; a PENDING range becomes readable once the reader has
+// caught up with its end.
+mic_history_state mic_history_read(uint32_t epoch, uint64_t start_index,
+                                   int length, int16_t *out_left,
+                                   int16_t *out_right);
+
+#endif
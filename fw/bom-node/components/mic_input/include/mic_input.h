@@ -3,6 +3,8 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "esp_err.h"
+#include "sdkconfig.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -10,24 +12,70 @@
 #define I2S_WS_IO GPIO_NUM_18
 #define I2S_DIN_IO GPIO_NUM_21
 
-#define DMA_DESC_NUM 14
+// DMA buffers at start; with MIC_DMA_ADAPTIVE the reader moves the count
+// between MIC_DMA_DESC_MIN and MIC_DMA_DESC_MAX (see dma_tuner.h).
+#define DMA_DESC_NUM CONFIG_MIC_DMA_DESC_NUM
+#if CONFIG_MIC_DMA_ADAPTIVE
+#define MIC_DMA_ADAPTIVE 1
+#define MIC_DMA_DESC_MIN CONFIG_MIC_DMA_DESC_MIN
+#define MIC_DMA_DESC_MAX CONFIG_MIC_DMA_DESC_MAX
+#else
+#define MIC_DMA_ADAPTIVE 0
+#define MIC_DMA_DESC_MIN DMA_DESC_NUM
+#define MIC_DMA_DESC_MAX DMA_DESC_NUM
+#endif
 // CHUNK_FRAMES is set to 511 due to DMA buffer constraints on the hardware.
 // 511 is the maximum number of frames that can be processed in one chunk
-// without exceeding DMA limits.
+// without exceeding DMA limits. The buffers hold mic_dma_frames() frames, the
+// largest whole number of taps that fits, and the reader reads one at a time.
 #define CHUNK_FRAMES 511
 #define READ_BUFFER_BYTES (CHUNK_FRAMES * 8)
 // 1 frame = L(32b) + R(32b) = 8 B
 
+// Frames per DMA buffer and read for `tap_size`: a whole number of taps, so
+// each read completes the taps it holds (1 <= tap_size <= CHUNK_FRAMES).
+static inline int mic_dma_frames(int tap_size) {
+  return CHUNK_FRAMES - CHUNK_FRAMES % tap_size;
+}
+
 // DC offset correction values for left and right microphone channels.
 // Units: ADC counts.
 // These values were determined empirically by measuring the average DC bias
 // present on each channel during calibration with no input signal.
 // They are needed to remove the DC component from the microphone signal,
 // ensuring accurate audio processing and event detection.
+// They are only the starting point on a unit that has never been calibrated:
+// the reader measures the actual bias over the first MIC_DC_CAL_CHUNKS DMA
+// chunks and then tracks it (see mic_get_dc_offset()).
 
 #define DC_OFFSET_LEFT 3500
 #define DC_OFFSET_RIGHT 3000
 
+// Startup calibration length in DMA chunks; 0 keeps the configured offsets.
+#ifndef MIC_DC_CAL_CHUNKS
+#define MIC_DC_CAL_CHUNKS CONFIG_MIC_DC_CAL_CHUNKS
+#endif
+
+// After calibration the mean of every MIC_DC_TRACK_CHUNKS chunks pulls the
+// offset 1 / 2^MIC_DC_TRACK_SHIFT of the way towards it.
+#ifndef MIC_DC_TRACK_CHUNKS
+#define MIC_DC_TRACK_CHUNKS 128
+#endif
+
+#ifndef MIC_DC_TRACK_SHIFT
+#define MIC_DC_TRACK_SHIFT 3
+#endif
+
+// The DC listener is told again once the tracked offset has moved this far
+// from the value it was last given.
+#ifndef MIC_DC_NOTIFY_DELTA
+#define MIC_DC_NOTIFY_DELTA 32
+#endif
+
+// Offsets are clamped to this magnitude so an offset-corrected sample always
+// fits the DC filter's headroom.
+#define MIC_DC_OFFSET_LIMIT 16384
+
 // DC_BLOCK_FREQ_HZ sets the cutoff frequency for the high-pass filter used to
 // remove DC offset from the microphone signal. The value was increased from 20
 // Hz to 100 Hz to more aggressively filter out low-frequency noise and DC
@@ -35,19 +83,37 @@
 // the algorithm's sensitivity to short, transient impulses by reducing baseline
 // fluctuations, but may attenuate very low-frequency events. 100 Hz was chosen
 // as a balance between effective DC removal and preserving relevant impulse
-// features.
-#define DC_BLOCK_FREQ_HZ 100
+// features. Set through CONFIG_MIC_DC_BLOCK_FREQ_HZ ("Microphone" menu),
+// which also selects the rate table mic_dsp.c is built with.
+#define DC_BLOCK_FREQ_HZ CONFIG_MIC_DC_BLOCK_FREQ_HZ
+
+#ifdef CONFIG_MIC_DC_FILTER_BIQUAD
+#define DC_BLOCK_FILTER MIC_DC_BIQUAD_HPF
+#else
+#define DC_BLOCK_FILTER MIC_DC_ONE_POLE
+#endif
+
+// Input resolution and gain of the DC blocker (mic_dc_filter_set_output()),
+// from CONFIG_MIC_DSP_HIGH_RES and CONFIG_MIC_GAIN_DB.
+#ifdef CONFIG_MIC_DSP_HIGH_RES
+#define DC_BLOCK_HIGH_RES true
+#else
+#define DC_BLOCK_HIGH_RES false
+#endif
+#define DC_BLOCK_GAIN_DB CONFIG_MIC_GAIN_DB
 
 #ifndef MIC_SAMPLING_FREQUENCY
 #define MIC_SAMPLING_FREQUENCY 44100
 #endif
 
+// Event clip around the peak; windows longer than the detector's are read
+// from the history (mic_history.h). Set in the "Microphone" Kconfig menu.
 #ifndef MIC_PRE_EVENT_MS
-#define MIC_PRE_EVENT_MS 10
+#define MIC_PRE_EVENT_MS CONFIG_MIC_PRE_EVENT_MS
 #endif
 
 #ifndef MIC_POST_EVENT_MS
-#define MIC_POST_EVENT_MS 10
+#define MIC_POST_EVENT_MS CONFIG_MIC_POST_EVENT_MS
 #endif
 
 #ifndef MIC_DEFAULT_NUM_TAPS
@@ -58,16 +124,24 @@
 #define MIC_DEFAULT_TAP_SIZE 30
 #endif
 
+// Extra taps kept in the ring beyond num_taps so consumers that lag the
+// reader (e.g. an event snapshot taken after detection) can still reach the
+// samples they refer to.
+#ifndef MIC_RING_HEADROOM_TAPS
+#define MIC_RING_HEADROOM_TAPS 16
+#endif
+
 #ifndef MIC_READER_TASK_STACK
 #define MIC_READER_TASK_STACK 8192
 #endif
 
+// Placement comes from the "Task placement" Kconfig menu.
 #ifndef MIC_READER_TASK_PRIORITY
-#define MIC_READER_TASK_PRIORITY 5
+#define MIC_READER_TASK_PRIORITY CONFIG_MIC_READER_TASK_PRIORITY
 #endif
 
 #ifndef MIC_READER_TASK_CORE
-#define MIC_READER_TASK_CORE 0
+#define MIC_READER_TASK_CORE CONFIG_MIC_READER_TASK_CORE
 #endif
 
 typedef struct {
@@ -80,14 +154,176 @@ typedef struct {
 
 void mic_init(const mic_config *mic_cnfg);
 void mic_init_default(void);
+// Starts the reader task; later calls are no-ops, so every consumer may call
+// it once its callbacks are registered.
 void mic_start(void);
 const mic_config *mic_get_config(void);
+
+// Switches to a new sampling rate / tap geometry without a reboot. Once the
+// reader is running the change is applied on the reader task between two
+// DMA chunks: the I2S channels are stopped and reclocked, the ring is
+// reallocated for the new geometry and the DC filters are re-initialised.
+// The returned status only covers validation; config listeners learn when
+// the new configuration is live. Before mic_start() it applies immediately.
+// Audio captured under the old configuration is no longer reachable through
+// mic_snapshot() afterwards.
+esp_err_t mic_reconfigure(const mic_config *cfg);
+
+// DC offset added to the raw samples of each channel [ADC counts].
+typedef struct {
+  int16_t left;
+  int16_t right;
+  bool calibrated; // measured on this boot rather than configured
+} mic_dc_offset;
+
+// Sets the offsets to start from, e.g. the last calibration restored from
+// NVS. Call before mic_start(); startup calibration still runs and refines
+// them.
+void mic_set_dc_offset(int16_t left, int16_t right);
+void mic_get_dc_offset(mic_dc_offset *out);
+
+// Called on the reader task when startup calibration completes and whenever
+// tracking has moved the offsets by MIC_DC_NOTIFY_DELTA since the previous
+// call. Must not block; defer persisting the values to another task.
+typedef void (*mic_dc_listener)(const mic_dc_offset *off, void *ctx);
+void mic_set_dc_listener(mic_dc_listener cb, void *ctx);
+
+// Incremented by every applied mic_reconfigure(); 0 for the configuration
+// given to mic_init().
+uint32_t mic_config_epoch(void);
+
+// Called on the reader task after a reconfiguration took effect and before
+// the first tap captured under it is delivered. Must not block.
+typedef void (*mic_config_listener)(const mic_config *cfg, uint32_t epoch,
+                                    void *ctx);
+
+#define MIC_MAX_CONFIG_LISTENERS 4
+
+// Returns false when all MIC_MAX_CONFIG_LISTENERS slots are taken.
+bool mic_add_config_listener(mic_config_listener cb, void *ctx);
 void mic_reader_task(void *arg);
 void mic_save_event(int16_t *out_left_mic, int16_t *out_right_mic);
 
-typedef void (*mic_tap_callback)(const int16_t *tap_left,
-                                 const int16_t *tap_right, void *ctx);
-void mic_set_tap_callback(mic_tap_callback cb, void *ctx);
-bool mic_add_tap_callback(mic_tap_callback cb, void *ctx);
+// Total number of samples per channel committed to the ring so far; the
+// absolute index one past the newest sample.
+uint64_t mic_captured_samples(void);
+
+// Samples per channel the ring retains behind its head under `cfg`:
+// (num_taps + MIC_RING_HEADROOM_TAPS) * tap_size.
+int mic_retained_samples(const mic_config *cfg);
+
+// Copies `length` samples per channel starting at absolute sample index
+// `start_index`. Returns false if part of the range has not been captured yet
+// or has already been overwritten (the ring retains mic_retained_samples()).
+bool mic_snapshot(uint64_t start_index, int length, int16_t *out_left,
+                  int16_t *out_right);
+
+// Estimated esp_timer time [us] at which absolute sample `index` was
+// captured, from a drift-tracking fit of DMA arrival times to the sample
+// counter (see sample_clock.h). Valid for past and near-future indices; 0
+// before the first chunk. The estimate is within a few hundred us of the
+// true capture time once mic_stats.clock_locked is set.
+int64_t mic_sample_time_us(uint64_t index);
+
+// The same instant on the wall clock [us since the Unix epoch]; 0 while the
+// wall clock is not set (no SNTP sync yet).
+int64_t mic_sample_unix_us(uint64_t index);
+
+// True while the samples from absolute index `start_index` on are still in
+// the ring. Check it after reading through a view kept past its callback: a
+// true result means the reader did not overwrite anything during the read.
+// Ranges from before the last reconfiguration are never retained.
+bool mic_range_retained(uint64_t start_index);
+
+// Read-only view of one or more consecutive taps inside the microphone's
+// planar ring. The pointers stay valid for the duration of the callback;
+// after that the samples remain in place until the ring wraps over them, so
+// a view may be handed to another task and consumed there as long as
+// mic_range_retained(sample_index) holds (the ring retains
+// MIC_RING_HEADROOM_TAPS taps beyond num_taps for such consumers). A
+// reconfiguration retires the ring, but its storage is only released by the
+// next one, so a view of the previous epoch is still safe to read (and then
+// fails mic_range_retained()).
+typedef struct {
+  const int16_t *left;
+  const int16_t *right;
+  int length;            // samples per channel, a multiple of tap_size
+  uint64_t sample_index; // absolute index of left[0] / right[0] since start
+  int64_t time_us;       // mic_sample_time_us(sample_index)
+  uint32_t epoch;        // mic_config_epoch() the samples were captured in
+} mic_tap_view;
+
+typedef void (*mic_tap_callback)(const mic_tap_view *tap, void *ctx);
+
+#define MIC_MAX_SUBSCRIBERS 8
+
+typedef struct mic_subscription mic_subscription;
+
+typedef struct {
+  mic_tap_callback cb;
+  void *ctx;
+  const char *name;    // reported in mic_stats; must outlive the subscription
+  uint16_t batch_taps; // taps per call, 1 .. MIC_RING_HEADROOM_TAPS (0 = 1)
+  uint16_t decimation; // deliver one batch out of every N (0 = every batch)
+  bool enabled;        // initial state
+} mic_subscriber_cfg;
+
+// Registers a tap consumer; callbacks run on the reader task. A batch is
+// delivered once its last tap is captured, as one view, except that a batch
+// crossing the end of the ring arrives as two views. Disabled subscribers
+// are skipped without being visited. Returns NULL when all
+// MIC_MAX_SUBSCRIBERS slots are taken or cfg is invalid.
+mic_subscription *mic_subscribe(const mic_subscriber_cfg *cfg);
+
+// Removes the subscription. Once this returns the callback is not running
+// and will not be called again, so its context may be freed. Must not be
+// called from a tap callback.
+void mic_unsubscribe(mic_subscription *sub);
+
+// Takes effect from the next tap; re-enabling starts a fresh batch.
+void mic_subscription_set_enabled(mic_subscription *sub, bool enabled);
+bool mic_subscription_enabled(const mic_subscription *sub);
+
+// Upper bucket edges [us] of the per-callback duration histogram; the last
+// bucket counts everything at or above the final edge.
+#define MIC_CB_HIST_EDGES_US {5, 10, 25, 50, 100, 250, 500}
+#define MIC_CB_HIST_BUCKETS 8
+
+typedef struct {
+  const char *name;
+  uint32_t calls;
+  uint32_t max_us;
+  uint64_t total_us;
+  uint32_t hist[MIC_CB_HIST_BUCKETS];
+} mic_callback_stats;
+
+// Reader pipeline telemetry since mic_start(). Chunk times cover one DMA
+// read's processing (DSP, ring commit and all tap callbacks), measured with
+// esp_timer; a reader away from its read for longer than the DMA queue
+// (dma_desc_num * dma_frames frames) shows up as dma_overflows. The read lag
+// is how long the last frame of a read waited for it: the DMA hand-off plus
+// whatever the queue held, measured once the sample clock is locked.
+typedef struct {
+  uint32_t chunks;
+  uint32_t dma_overflows; // I2S on_recv_q_ovf events: audio was lost
+  const char *source;     // mic_source name, see mic_source.h
+  uint32_t chunk_us_min;
+  uint32_t chunk_us_max;
+  uint64_t chunk_us_total;
+  uint16_t dma_desc_num;    // DMA buffers now
+  uint16_t dma_frames;      // frames per buffer and read
+  uint32_t dma_resizes;     // queue rebuilds by the adaptive mode
+  uint32_t read_lag_us;     // last read
+  uint32_t read_lag_us_max;
+  uint32_t subscribed_mask; // slots of `callbacks` in use
+  uint32_t active_mask;     // subset currently enabled
+  float clock_ppm;          // sample clock deviation from nominal
+  uint32_t clock_relocks;   // re-anchors on stalls or lost audio
+  bool clock_locked;        // timestamps have converged
+  mic_callback_stats callbacks[MIC_MAX_SUBSCRIBERS];
+} mic_stats;
+
+// Consistent snapshot of the reader telemetry, updated once per chunk.
+void mic_get_stats(mic_stats *out);
 
 #endif
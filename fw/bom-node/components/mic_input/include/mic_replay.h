@@ -0,0 +1,54 @@
+#ifndef MIC_REPLAY_H
+#define MIC_REPLAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Sample generation for the replay and synthetic mic sources
+// (mic_source.h), kept free of FreeRTOS and file I/O so it runs on the host.
+// Both produce the reader's DMA layout: interleaved 32-bit frames, the
+// 16-bit sample in the upper half of each slot, left in the odd slot (see
+// mic_dsp_process_chunk()).
+
+typedef struct {
+  int sample_rate;
+  int channels;         // 1 or 2
+  uint32_t data_offset; // file offset of the first frame
+  // Bytes of audio; 0 when the header leaves it open (a stream header, or
+  // a file whose sizes were never patched), meaning up to the end of file.
+  uint32_t data_bytes;
+} mic_replay_wav;
+
+// Parses a 16-bit PCM RIFF/WAVE header from the first `len` bytes of a
+// file, skipping chunks other than "fmt " and "data" (the stamp's "bext",
+// "LIST"). Returns false for other formats, or when "data" does not start
+// within `len`.
+bool mic_replay_parse_wav(const uint8_t *buf, size_t len, mic_replay_wav *out);
+
+// Expands `frames` frames of interleaved 16-bit PCM with `channels`
+// channels (mono goes to both) into DMA frames. `pcm` may be the start of
+// `out` itself: the frames are expanded last to first.
+void mic_replay_pack_frames(const int16_t *pcm, int channels, int frames,
+                            int32_t *out);
+
+typedef struct {
+  uint32_t period_frames; // impulse spacing
+  uint32_t lag_frames;    // right channel behind the left
+  int32_t peak;           // impulse amplitude
+  int32_t noise;          // background noise amplitude
+  int32_t decay_q15;      // per-sample envelope factor
+  uint32_t pos;           // frames since the last left impulse
+  int32_t env_left, env_right;
+  uint32_t seed;
+} mic_synth;
+
+// A decaying noise burst every `period_ms` on both channels, the right
+// `lag_us` behind, over white background noise. The sequence depends on the
+// parameters only, so two runs feed the pipeline identical audio.
+void mic_synth_init(mic_synth *s, int sample_rate, int period_ms, int lag_us,
+                    int peak, int noise, int decay_ms);
+
+void mic_synth_fill(mic_synth *s, int32_t *out, int frames);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef MIC_SOURCE_H
+#define MIC_SOURCE_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Where the reader task gets its DMA chunks from. Everything after the read
+// (DC tracking, the DSP kernel, the ring, taps, the history and the sample
+// clock) is the same for every source, so the streamer, detector and other
+// subscribers run unchanged on replayed or synthetic audio.
+//
+// - mic_source_i2s: the microphones.
+// - mic_source_wav: a 16-bit PCM WAV file, e.g. one recorded by the SD
+//   recorder or pulled from stream.wav, replayed in a loop.
+// - mic_source_synth: decaying noise bursts at a fixed period over
+//   background noise, the same sequence on every run.
+//
+// The replay sources deliver in real time, or, with
+// CONFIG_MIC_SOURCE_MAX_SPEED, as fast as the reader takes them: the
+// pipeline then runs at its throughput ceiling, and subscribers that cannot
+// keep up show it in their drop counters. The sample clock, fitted to chunk
+// arrivals, then runs fast as well.
+
+typedef struct {
+  const char *name;
+  // Samples carry the microphones' DC bias, so the calibrated offsets are
+  // passed to the DC listener (mic_set_dc_listener()).
+  bool raw;
+  // Called once from mic_init(), before the reader starts.
+  esp_err_t (*open)(int sampling_freq);
+  // Called by the reader between two reads.
+  esp_err_t (*set_rate)(int sampling_freq);
+  // Blocks for up to CHUNK_FRAMES frames in the layout of
+  // mic_dsp_process_chunk() and returns how many were read; 0 when nothing
+  // is available yet, after a bounded wait.
+  int (*read)(int32_t *frames, int max_frames);
+  // Chunks lost before they were read; NULL when the source cannot lose any.
+  uint32_t (*overflows)(void);
+  // Sizes the DMA queue as `desc_num` buffers of `frame_num` (at most
+  // CHUNK_FRAMES) frames. Before open() it only sets the geometry open()
+  // uses; later it is called by the reader between two reads and may drop the
+  // audio in flight. NULL when the source has no DMA queue.
+  esp_err_t (*set_dma)(int desc_num, int frame_num);
+} mic_source;
+
+extern const mic_source mic_source_i2s;
+extern const mic_source mic_source_wav;
+extern const mic_source mic_source_synth;
+
+// The source picked in the "Microphone" Kconfig menu (CONFIG_MIC_SOURCE_*).
+const mic_source *mic_source_default(void);
+
+// Replaces the source mic_init() opens; call before mic_init(). NULL goes
+// back to mic_source_default().
+void mic_set_source(const mic_source *source);
+
+// The source in use.
+const mic_source *mic_get_source(void);
+
+#endif
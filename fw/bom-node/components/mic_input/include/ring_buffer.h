@@ -1,17 +1,43 @@
 #ifndef RING_BUFFER_H
 #define RING_BUFFER_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 typedef struct {
   int16_t *data;
   int size;
   int head;
+  int mask;   // size - 1 when size is a power of two, otherwise 0
+  bool owned; // data was allocated by rb_init and is released by rb_free
 } rb_struct;
 
 void rb_init(rb_struct *rb, int samples);
+// Rounds `samples` up to the next power of two so indexing is a mask.
+void rb_init_pow2(rb_struct *rb, int samples);
+// Use caller-provided storage instead of allocating; rb_free leaves it alone.
+void rb_attach(rb_struct *rb, int16_t *storage, int samples);
 void rb_free(rb_struct *rb);
 void rb_push(rb_struct *rb, int16_t value);
+// Appends `count` samples with at most two memcpy calls. If `count` exceeds
+// the ring size only the newest `size` samples are kept.
+void rb_push_block(rb_struct *rb, const int16_t *src, int count);
+
+// In-place writers: fill up to rb_writable() samples at rb_write_ptr(), then
+// publish them with rb_commit(). No data is copied.
+static inline int16_t *rb_write_ptr(const rb_struct *rb) {
+  return &rb->data[rb->head];
+}
+static inline int rb_writable(const rb_struct *rb) {
+  return rb->size - rb->head;
+}
+void rb_commit(rb_struct *rb, int count);
+// Copies `count` samples starting at ring position `start` (0 <= start < size)
+// into `out_arr` with at most two memcpy calls. Requires count <= size.
+void rb_copy_from(const rb_struct *rb, int16_t *out_arr, int start, int count);
+// Copies the `count` samples that end `offset` samples before the head into
+// `out_arr`, oldest first, with at most two memcpy calls.
+// Requires offset + count <= size.
 void rb_copy_tail(const rb_struct *rb, int16_t *out_arr, int offset, int count);
 
 #endif
@@ -0,0 +1,63 @@
+#ifndef SAMPLE_CLOCK_H
+#define SAMPLE_CLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Maps absolute sample indices to esp_timer time. The I2S clock and the
+// timer crystal drift apart by tens of ppm, so the sample period is
+// estimated from chunk arrival times instead of taken from the nominal rate.
+//
+// An arrival lags the capture of the chunk's last sample by scheduling and
+// DMA-queue delay, which is never negative, so each window of
+// SAMPLE_CLOCK_WINDOW arrivals contributes only its earliest one (least
+// delayed) to a PI loop correcting phase and period.
+
+#define SAMPLE_CLOCK_WINDOW 64
+// An arrival this far off the prediction (a stall, an overflowed DMA queue,
+// a restarted channel) re-anchors the clock instead of steering it.
+#define SAMPLE_CLOCK_RELOCK_US 20000
+// Period estimates are kept within this distance of nominal.
+#define SAMPLE_CLOCK_MAX_PPM 1000
+
+typedef struct {
+  double nominal_us;     // 1e6 / nominal rate
+  double period_us;      // estimated time per sample
+  uint64_t anchor_index; // sample index with a known time
+  double anchor_us;
+  double window_min_us;  // earliest residual of the current window
+  uint32_t window_n;
+  uint32_t windows;      // windows applied since the last (re)anchor
+  uint32_t relocks;
+  bool anchored;
+} sample_clock;
+
+// Starts over for `sample_rate` [index increments per second]; the first
+// update anchors the clock.
+void sample_clock_reset(sample_clock *clk, double sample_rate);
+
+// Re-anchors on the next update, keeping the period estimate. For callers
+// that know indices and time fell out of step (e.g. dropped audio).
+void sample_clock_unlock(sample_clock *clk);
+
+// Samples up to (not including) `index` were captured when the chunk
+// ending there arrived at `now_us`.
+void sample_clock_update(sample_clock *clk, uint64_t index, int64_t now_us);
+
+// Estimated capture time of sample `index`; 0 before the first update.
+int64_t sample_clock_time_us(const sample_clock *clk, uint64_t index);
+
+// Converged: enough windows since the last anchor for the period to settle.
+static inline bool sample_clock_locked(const sample_clock *clk) {
+  return clk->windows >= 32;
+}
+
+// Estimated deviation of the sample clock from nominal, positive when
+// samples arrive faster than nominal.
+static inline double sample_clock_ppm(const sample_clock *clk) {
+  return clk->period_us > 0.0
+             ? (clk->nominal_us / clk->period_us - 1.0) * 1e6
+             : 0.0;
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock-free single-producer/single-consumer queue of fixed-size elements.
+// One task (or ISR) may push and one other task may pop concurrently without
+// locks or critical sections; the indices run freely and the capacity is a
+// power of two so slots are found with a mask.
+typedef struct {
+  uint8_t *slots;
+  size_t elem_size;
+  uint32_t mask;         // capacity - 1
+  _Atomic uint32_t head; // next slot the producer writes
+  _Atomic uint32_t tail; // next slot the consumer reads
+  bool owned;            // slots were allocated by spsc_init
+} spsc_queue;
+
+// Allocates room for `capacity` elements, rounded up to a power of two.
+bool spsc_init(spsc_queue *q, size_t elem_size, uint32_t capacity);
+// Bytes of storage spsc_attach() needs for `capacity` elements; 0 for an
+// invalid size.
+size_t spsc_storage_bytes(size_t elem_size, uint32_t capacity);
+// As spsc_init, in caller-provided storage; spsc_free leaves it alone.
+bool spsc_attach(spsc_queue *q, size_t elem_size, uint32_t capacity,
+                 void *storage);
+void spsc_free(spsc_queue *q);
+
+static inline uint32_t spsc_capacity(const spsc_queue *q) {
+  return q->mask + 1;
+}
+
+// Producer side. Copies `elem` in; returns false when the queue is full.
+bool spsc_push(spsc_queue *q, const void *elem);
+
+// Consumer side. Copies the oldest element out; returns false when empty.
+bool spsc_pop(spsc_queue *q, void *elem);
+
+// Number of queued elements; exact only when called from either end.
+uint32_t spsc_count(spsc_queue *q);
+
+#endif
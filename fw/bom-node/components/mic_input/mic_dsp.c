@@ -0,0 +1,295 @@
+#include "mic_dsp.h"
+
+#include <stddef.h>
+
+#ifndef MIC_DC_TABLE_FC_HZ
+#define MIC_DC_TABLE_FC_HZ 100
+#endif
+
+// Coefficients are built from constant expressions so the table below is
+// folded by the compiler; the same macros serve the runtime fallback. The
+// series are truncated where the error drops below one Q31 step for
+// w = 2*pi*fc/fs <= 0.4 (fc <= 500 Hz at 8 kHz).
+#define DSP_PI 3.14159265358979323846
+#define DSP_SQRT2 1.41421356237309504880
+
+// exp(-w), Taylor series to w^8 in Horner form.
+#define DSP_EXP_NEG(w)                                                         \
+  (1.0 - (w) * (1.0 - (w) / 2.0 * (1.0 - (w) / 3.0 * (1.0 - (w) / 4.0 *       \
+   (1.0 - (w) / 5.0 * (1.0 - (w) / 6.0 * (1.0 - (w) / 7.0 *                    \
+   (1.0 - (w) / 8.0))))))))
+
+// tan(x), series to x^9.
+#define DSP_TAN(x)                                                             \
+  ((x) * (1.0 + (x) * (x) * (1.0 / 3.0 + (x) * (x) * (2.0 / 15.0 +            \
+   (x) * (x) * (17.0 / 315.0 + (x) * (x) * (62.0 / 2835.0))))))
+
+#define DSP_Q(v, bits)                                                         \
+  ((int32_t)((v) * (double)(1LL << (bits)) + ((v) >= 0 ? 0.5 : -0.5)))
+
+#define DC_ONE_POLE_R(fs, fc) DSP_EXP_NEG(2.0 * DSP_PI * (fc) / (fs))
+
+// Bilinear-transformed Butterworth high-pass, K = tan(pi * fc / fs).
+#define DC_BQ_K(fs, fc) DSP_TAN(DSP_PI * (fc) / (fs))
+#define DC_BQ_NORM(k) (1.0 / (1.0 + DSP_SQRT2 * (k) + (k) * (k)))
+#define DC_BQ_B0(k) DC_BQ_NORM(k)
+#define DC_BQ_A1(k) (2.0 * ((k) * (k) - 1.0) * DC_BQ_NORM(k))
+#define DC_BQ_A2(k) ((1.0 - DSP_SQRT2 * (k) + (k) * (k)) * DC_BQ_NORM(k))
+
+#define DC_Q_ONE_POLE 31
+#define DC_Q_BIQUAD 30
+#define DC_Y_FRAC 14
+
+typedef struct {
+  int32_t fs;
+  int32_t one_pole_r;
+  int32_t b0, a1, a2;
+} dc_coeffs;
+
+#define DC_TABLE_ENTRY(fs)                                                     \
+  {(fs), DSP_Q(DC_ONE_POLE_R(fs, MIC_DC_TABLE_FC_HZ), DC_Q_ONE_POLE),          \
+   DSP_Q(DC_BQ_B0(DC_BQ_K(fs, MIC_DC_TABLE_FC_HZ)), DC_Q_BIQUAD),              \
+   DSP_Q(DC_BQ_A1(DC_BQ_K(fs, MIC_DC_TABLE_FC_HZ)), DC_Q_BIQUAD),              \
+   DSP_Q(DC_BQ_A2(DC_BQ_K(fs, MIC_DC_TABLE_FC_HZ)), DC_Q_BIQUAD)},
+
+static const dc_coeffs dc_table[] = {MIC_DC_TABLE_RATES(DC_TABLE_ENTRY)};
+
+bool mic_dc_filter_init(mic_dc_filter *st, int fs, int fc_hz,
+                        mic_dc_filter_type type) {
+  if (fc_hz <= 0)
+    fc_hz = 20;
+
+  dc_coeffs c = {0};
+  bool tabulated = false;
+  if (fc_hz == MIC_DC_TABLE_FC_HZ) {
+    for (size_t i = 0; i < sizeof(dc_table) / sizeof(dc_table[0]); i++) {
+      if (dc_table[i].fs == fs) {
+        c = dc_table[i];
+        tabulated = true;
+        break;
+      }
+    }
+  }
+  if (!tabulated) {
+    const double r = DC_ONE_POLE_R((double)fs, (double)fc_hz);
+    const double k = DC_BQ_K((double)fs, (double)fc_hz);
+    c.one_pole_r = DSP_Q(r, DC_Q_ONE_POLE);
+    c.b0 = DSP_Q(DC_BQ_B0(k), DC_Q_BIQUAD);
+    c.a1 = DSP_Q(DC_BQ_A1(k), DC_Q_BIQUAD);
+    c.a2 = DSP_Q(DC_BQ_A2(k), DC_Q_BIQUAD);
+  }
+
+  st->type = (uint8_t)type;
+  st->in_frac = 0;
+  st->gain = MIC_DSP_GAIN_UNITY;
+  if (type == MIC_DC_BIQUAD_HPF) {
+    st->b0 = c.b0;
+    st->a1 = c.a1;
+    st->a2 = c.a2;
+  } else {
+    st->b0 = 0;
+    st->a1 = c.one_pole_r;
+    st->a2 = 0;
+  }
+  st->x1 = st->x2 = 0;
+  st->y1 = st->y2 = 0;
+  return tabulated;
+}
+
+void mic_dc_filter_set_output(mic_dc_filter *st, bool high_res,
+                              int32_t gain_q12) {
+  st->in_frac = high_res ? MIC_DSP_HIGH_RES_BITS : 0;
+  st->gain = gain_q12 > 0 ? gain_q12 : MIC_DSP_GAIN_UNITY;
+  st->x1 = st->x2 = 0;
+  st->y1 = st->y2 = 0;
+}
+
+int32_t mic_dsp_gain_q12(int db) {
+  // 10^(1/20), applied once per dB.
+  const double step = 1.12201845430196343559;
+  db = db < -24 ? -24 : db > 24 ? 24 : db;
+  double g = 1.0;
+  for (int i = 0; i < (db < 0 ? -db : db); i++) {
+    g = db < 0 ? g / step : g * step;
+  }
+  return DSP_Q(g, MIC_DSP_GAIN_FRAC);
+}
+
+void mic_dc_filter_shift(mic_dc_filter *st, int32_t delta) {
+  st->x1 += delta * (1 << st->in_frac);
+  st->x2 += delta * (1 << st->in_frac);
+}
+
+// The kernels are instantiated per input resolution and for unity gain, so
+// the inner loops see both as constants.
+#define DSP_ALWAYS_INLINE static inline __attribute__((always_inline))
+
+DSP_ALWAYS_INLINE int16_t dc_out(int32_t y, int32_t gain, const bool unity) {
+  if (!unity) {
+    const int shift = DC_Y_FRAC + MIC_DSP_GAIN_FRAC;
+    const int64_t g = ((int64_t)y * gain + (1LL << (shift - 1))) >> shift;
+    return (int16_t)(g > INT16_MAX ? INT16_MAX : g < INT16_MIN ? INT16_MIN : g);
+  }
+  int32_t v = (y + (1 << (DC_Y_FRAC - 1))) >> DC_Y_FRAC;
+  if (v > INT16_MAX)
+    v = INT16_MAX;
+  if (v < INT16_MIN)
+    v = INT16_MIN;
+  return (int16_t)v;
+}
+
+// The offset is added after the sample is taken to 16 (or 24) bits, without
+// wrapping back to int16 (which the original reader path did).
+DSP_ALWAYS_INLINE int32_t dc_in(int32_t slot, int32_t offset,
+                                const int in_frac) {
+  return (slot >> (16 - in_frac)) + offset * (1 << in_frac);
+}
+#define DC_IN_LEFT(buf, i, off, frac) dc_in((buf)[2 * (i) + 1], (off), (frac))
+#define DC_IN_RIGHT(buf, i, off, frac) dc_in((buf)[2 * (i) + 0], (off), (frac))
+
+DSP_ALWAYS_INLINE void
+process_one_pole(const int32_t *interleaved, int frames, int16_t offset_left,
+                 int16_t offset_right, mic_dc_filter *dcf_left,
+                 mic_dc_filter *dcf_right, int16_t *out_left,
+                 int16_t *out_right, const int in_frac, const bool unity) {
+  // Filter state lives in registers for the whole chunk; both channels are
+  // handled in one pass so the two independent recurrences overlap in the
+  // pipeline instead of serialising on the y1 dependency.
+  int32_t xl1 = dcf_left->x1, yl1 = dcf_left->y1;
+  int32_t xr1 = dcf_right->x1, yr1 = dcf_right->y1;
+  const int32_t Rl = dcf_left->a1, Rr = dcf_right->a1;
+  const int32_t gl = dcf_left->gain, gr = dcf_right->gain;
+  const int64_t half = 1LL << (DC_Q_ONE_POLE - 1);
+
+  for (int i = 0; i < frames; i++) {
+    int32_t xl = DC_IN_LEFT(interleaved, i, offset_left, in_frac);
+    int32_t xr = DC_IN_RIGHT(interleaved, i, offset_right, in_frac);
+
+    int32_t yl = (xl - xl1) * (1 << (DC_Y_FRAC - in_frac)) +
+                 (int32_t)(((int64_t)Rl * yl1 + half) >> DC_Q_ONE_POLE);
+    int32_t yr = (xr - xr1) * (1 << (DC_Y_FRAC - in_frac)) +
+                 (int32_t)(((int64_t)Rr * yr1 + half) >> DC_Q_ONE_POLE);
+    xl1 = xl;
+    yl1 = yl;
+    xr1 = xr;
+    yr1 = yr;
+
+    out_left[i] = dc_out(yl, gl, unity);
+    out_right[i] = dc_out(yr, gr, unity);
+  }
+
+  dcf_left->x1 = xl1;
+  dcf_left->y1 = yl1;
+  dcf_right->x1 = xr1;
+  dcf_right->y1 = yr1;
+}
+
+DSP_ALWAYS_INLINE void
+process_biquad(const int32_t *interleaved, int frames, int16_t offset_left,
+               int16_t offset_right, mic_dc_filter *dcf_left,
+               mic_dc_filter *dcf_right, int16_t *out_left, int16_t *out_right,
+               const int in_frac, const bool unity) {
+  // High-pass numerator is b0 * (1 - 2z^-1 + z^-2), so the input side costs
+  // a single multiply per channel.
+  int32_t xl1 = dcf_left->x1, xl2 = dcf_left->x2;
+  int32_t yl1 = dcf_left->y1, yl2 = dcf_left->y2;
+  int32_t xr1 = dcf_right->x1, xr2 = dcf_right->x2;
+  int32_t yr1 = dcf_right->y1, yr2 = dcf_right->y2;
+  const int32_t b0l = dcf_left->b0, a1l = dcf_left->a1, a2l = dcf_left->a2;
+  const int32_t b0r = dcf_right->b0, a1r = dcf_right->a1, a2r = dcf_right->a2;
+  const int32_t gl = dcf_left->gain, gr = dcf_right->gain;
+  const int64_t half = 1LL << (DC_Q_BIQUAD - 1);
+  const int64_t in_scale = 1 << (DC_Y_FRAC - in_frac);
+
+  for (int i = 0; i < frames; i++) {
+    int32_t xl = DC_IN_LEFT(interleaved, i, offset_left, in_frac);
+    int32_t xr = DC_IN_RIGHT(interleaved, i, offset_right, in_frac);
+
+    int64_t accl = ((int64_t)b0l * (xl - 2 * xl1 + xl2)) * in_scale -
+                   (int64_t)a1l * yl1 - (int64_t)a2l * yl2;
+    int64_t accr = ((int64_t)b0r * (xr - 2 * xr1 + xr2)) * in_scale -
+                   (int64_t)a1r * yr1 - (int64_t)a2r * yr2;
+    int32_t yl = (int32_t)((accl + half) >> DC_Q_BIQUAD);
+    int32_t yr = (int32_t)((accr + half) >> DC_Q_BIQUAD);
+    xl2 = xl1;
+    xl1 = xl;
+    yl2 = yl1;
+    yl1 = yl;
+    xr2 = xr1;
+    xr1 = xr;
+    yr2 = yr1;
+    yr1 = yr;
+
+    out_left[i] = dc_out(yl, gl, unity);
+    out_right[i] = dc_out(yr, gr, unity);
+  }
+
+  dcf_left->x1 = xl1;
+  dcf_left->x2 = xl2;
+  dcf_left->y1 = yl1;
+  dcf_left->y2 = yl2;
+  dcf_right->x1 = xr1;
+  dcf_right->x2 = xr2;
+  dcf_right->y1 = yr1;
+  dcf_right->y2 = yr2;
+}
+
+#define DSP_KERNEL(name, kernel, in_frac, unity)                                \
+  static void name(const int32_t *in, int frames, int16_t off_l,               \
+                   int16_t off_r, mic_dc_filter *dcf_l, mic_dc_filter *dcf_r,  \
+                   int16_t *out_l, int16_t *out_r) {                           \
+    kernel(in, frames, off_l, off_r, dcf_l, dcf_r, out_l, out_r, (in_frac),    \
+           (unity));                                                           \
+  }
+
+DSP_KERNEL(one_pole_16, process_one_pole, 0, true)
+DSP_KERNEL(one_pole_16_gain, process_one_pole, 0, false)
+DSP_KERNEL(one_pole_24, process_one_pole, MIC_DSP_HIGH_RES_BITS, true)
+DSP_KERNEL(one_pole_24_gain, process_one_pole, MIC_DSP_HIGH_RES_BITS, false)
+DSP_KERNEL(biquad_16, process_biquad, 0, true)
+DSP_KERNEL(biquad_16_gain, process_biquad, 0, false)
+DSP_KERNEL(biquad_24, process_biquad, MIC_DSP_HIGH_RES_BITS, true)
+DSP_KERNEL(biquad_24_gain, process_biquad, MIC_DSP_HIGH_RES_BITS, false)
+
+typedef void (*dsp_kernel_fn)(const int32_t *, int, int16_t, int16_t,
+                              mic_dc_filter *, mic_dc_filter *, int16_t *,
+                              int16_t *);
+
+// [type][high resolution][gain]
+static const dsp_kernel_fn dsp_kernels[2][2][2] = {
+    {{one_pole_16, one_pole_16_gain}, {one_pole_24, one_pole_24_gain}},
+    {{biquad_16, biquad_16_gain}, {biquad_24, biquad_24_gain}},
+};
+
+void mic_dsp_process_chunk(const int32_t *interleaved, int frames,
+                           int16_t offset_left, int16_t offset_right,
+                           mic_dc_filter *dcf_left, mic_dc_filter *dcf_right,
+                           int16_t *out_left, int16_t *out_right) {
+  const int type = dcf_left->type == MIC_DC_BIQUAD_HPF;
+  const int high_res = dcf_left->in_frac != 0;
+  const int gain = dcf_left->gain != MIC_DSP_GAIN_UNITY;
+  dsp_kernels[type][high_res][gain](interleaved, frames, offset_left,
+                                    offset_right, dcf_left, dcf_right,
+                                    out_left, out_right);
+}
+
+void mic_dsp_sum_chunk(const int32_t *interleaved, int frames,
+                       int64_t *sum_left, int64_t *sum_right) {
+  // 32-bit partial sums cannot overflow within one DMA chunk (<= 65536
+  // frames of 16-bit samples); four of them break the add dependency chain.
+  int32_t l0 = 0, l1 = 0, r0 = 0, r1 = 0;
+  int i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    const int32_t *f = &interleaved[2 * i];
+    l0 += (f[1] >> 16) + (f[5] >> 16);
+    r0 += (f[0] >> 16) + (f[4] >> 16);
+    l1 += (f[3] >> 16) + (f[7] >> 16);
+    r1 += (f[2] >> 16) + (f[6] >> 16);
+  }
+  for (; i < frames; i++) {
+    l0 += interleaved[2 * i + 1] >> 16;
+    r0 += interleaved[2 * i + 0] >> 16;
+  }
+  *sum_left += (int64_t)l0 + l1;
+  *sum_right += (int64_t)r0 + r1;
+}
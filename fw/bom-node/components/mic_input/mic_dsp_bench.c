@@ -0,0 +1,147 @@
+#include "mic_dsp.h"
+#include "mic_input.h"
+
+#include "sdkconfig.h"
+
+#ifdef CONFIG_MIC_DSP_BENCHMARK
+
+#include "esp_cpu.h"
+#include "esp_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "MIC_DSP";
+
+#define BENCH_ROUNDS 32
+
+static int32_t bench_in[CHUNK_FRAMES * 2];
+static int16_t bench_ref_l[CHUNK_FRAMES], bench_ref_r[CHUNK_FRAMES];
+static int16_t bench_blk_l[CHUNK_FRAMES], bench_blk_r[CHUNK_FRAMES];
+
+// The original Q15 one-pole update, truncating the feedback term to whole
+// LSBs every sample.
+typedef struct {
+  int32_t x1, y1, R;
+} legacy_dc_filter;
+
+static inline int16_t legacy_dc_block_sample(legacy_dc_filter *st, int16_t x) {
+  int32_t xn = (int32_t)x;
+  int32_t yn = xn - st->x1 + ((st->R * st->y1) >> 15);
+  st->x1 = xn;
+  st->y1 = yn;
+  return (int16_t)yn;
+}
+
+// Copy of the reader loop body as it was before the block kernel: one frame
+// per iteration with the tap index derived through `%`.
+static void __attribute__((noinline))
+legacy_process(const int32_t *buf, int n, int tap_size, legacy_dc_filter *dcfL,
+               legacy_dc_filter *dcfR, int16_t *outL, int16_t *outR) {
+  int16_t tapL[tap_size];
+  int16_t tapR[tap_size];
+  int taps = 0;
+
+  for (int i = 0; i < n; i++) {
+    int16_t xL = (int16_t)(buf[2 * i + 1] >> 16) + DC_OFFSET_LEFT;
+    int16_t xR = (int16_t)(buf[2 * i + 0] >> 16) + DC_OFFSET_RIGHT;
+
+    tapL[i % tap_size] = legacy_dc_block_sample(dcfL, xL);
+    tapR[i % tap_size] = legacy_dc_block_sample(dcfR, xR);
+
+    if ((i + 1) % tap_size == 0) {
+      memcpy(&outL[taps * tap_size], tapL, tap_size * sizeof(int16_t));
+      memcpy(&outR[taps * tap_size], tapR, tap_size * sizeof(int16_t));
+      taps++;
+    }
+  }
+}
+
+static uint32_t bench_block(mic_dc_filter_type type, bool high_res,
+                            int gain_db) {
+  mic_dc_filter l, r;
+  mic_dc_filter_init(&l, MIC_SAMPLING_FREQUENCY, DC_BLOCK_FREQ_HZ, type);
+  mic_dc_filter_set_output(&l, high_res, mic_dsp_gain_q12(gain_db));
+  r = l;
+  uint32_t cycles = 0;
+  for (int k = 0; k < BENCH_ROUNDS; k++) {
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    mic_dsp_process_chunk(bench_in, CHUNK_FRAMES, DC_OFFSET_LEFT,
+                          DC_OFFSET_RIGHT, &l, &r, bench_blk_l, bench_blk_r);
+    cycles += esp_cpu_get_cycle_count() - t0;
+  }
+  return cycles;
+}
+
+static void log_cycles(const char *label, uint32_t cycles) {
+  const uint32_t frames = CHUNK_FRAMES * BENCH_ROUNDS;
+  ESP_LOGI(TAG, " - %-16s %lu cycles/chunk, %lu.%02lu cycles/frame", label,
+           (unsigned long)(cycles / BENCH_ROUNDS),
+           (unsigned long)(cycles / frames),
+           (unsigned long)((cycles % frames) * 100 / frames));
+}
+
+void mic_dsp_run_benchmark(int tap_size) {
+  uint32_t seed = 0x1234567u;
+  for (int i = 0; i < CHUNK_FRAMES * 2; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    bench_in[i] = (int32_t)seed;
+  }
+
+  mic_dc_filter probe;
+  mic_dc_filter_init(&probe, MIC_SAMPLING_FREQUENCY, DC_BLOCK_FREQ_HZ,
+                     MIC_DC_ONE_POLE);
+  // Same pole as the Q31 filter, rounded to the legacy Q15 coefficient.
+  legacy_dc_filter ref_l = {0, 0, (probe.a1 + (1 << 15)) >> 16};
+  legacy_dc_filter ref_r = ref_l;
+
+  uint32_t legacy_cycles = 0;
+  for (int k = 0; k < BENCH_ROUNDS; k++) {
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    legacy_process(bench_in, CHUNK_FRAMES, tap_size, &ref_l, &ref_r,
+                   bench_ref_l, bench_ref_r);
+    legacy_cycles += esp_cpu_get_cycle_count() - t0;
+  }
+  const uint32_t one_pole_cycles = bench_block(MIC_DC_ONE_POLE, false, 0);
+
+  // The one-pole kernel differs from the legacy loop by the rounding of the
+  // feedback term (the legacy truncation drifts by up to 1 / (1 - R) LSB) and
+  // by saturating where the legacy output wraps; clipped samples are skipped.
+  const int checked = (CHUNK_FRAMES / tap_size) * tap_size;
+  int max_diff = 0;
+  for (int i = 0; i < checked; i++) {
+    if (bench_blk_l[i] != INT16_MAX && bench_blk_l[i] != INT16_MIN) {
+      int d = abs(bench_ref_l[i] - bench_blk_l[i]);
+      if (d > max_diff)
+        max_diff = d;
+    }
+    if (bench_blk_r[i] != INT16_MAX && bench_blk_r[i] != INT16_MIN) {
+      int d = abs(bench_ref_r[i] - bench_blk_r[i]);
+      if (d > max_diff)
+        max_diff = d;
+    }
+  }
+
+  const uint32_t biquad_cycles = bench_block(MIC_DC_BIQUAD_HPF, false, 0);
+  // The configured resolution, with a gain so the scaling stage is timed.
+  const uint32_t one_pole_hr_cycles =
+      bench_block(MIC_DC_ONE_POLE, DC_BLOCK_HIGH_RES, -6);
+  const uint32_t biquad_hr_cycles =
+      bench_block(MIC_DC_BIQUAD_HPF, DC_BLOCK_HIGH_RES, -6);
+
+  ESP_LOGI(TAG, "DSP benchmark (%d frames x %d rounds, tap %d, fc %d Hz):",
+           CHUNK_FRAMES, BENCH_ROUNDS, tap_size, DC_BLOCK_FREQ_HZ);
+  log_cycles("per-sample loop:", legacy_cycles);
+  log_cycles("one-pole block:", one_pole_cycles);
+  log_cycles("biquad block:", biquad_cycles);
+  log_cycles("one-pole -6 dB:", one_pole_hr_cycles);
+  log_cycles("biquad -6 dB:", biquad_hr_cycles);
+  ESP_LOGI(TAG, " - one-pole vs legacy: max |diff| %d LSB (unclipped)",
+           max_diff);
+}
+
+#else
+
+void mic_dsp_run_benchmark(int tap_size) { (void)tap_size; }
+
+#endif
@@ -0,0 +1,115 @@
+#include "mic_history.h"
+#include "audio_arena.h"
+#include "history_ring.h"
+#include "mic_input.h"
+
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+
+#include <stddef.h>
+
+static const char *TAG = "MIC_HISTORY";
+
+#ifdef CONFIG_MIC_HISTORY_MS
+#define MIC_HISTORY_MS CONFIG_MIC_HISTORY_MS
+#else
+#define MIC_HISTORY_MS 0
+#endif
+// Half the reader's headroom per copy: few calls, and the views are still
+// fresh when they arrive.
+#define MIC_HISTORY_BATCH_TAPS (MIC_RING_HEADROOM_TAPS / 2)
+
+static history_ring s_ring;
+static uint32_t s_epoch = 0;
+static bool s_running = false;
+static mic_subscription *s_sub = NULL;
+// Guards the ring indices and s_epoch only; samples are copied outside it.
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Runs on the reader task.
+static void mic_history_on_tap(const mic_tap_view *tap, void *ctx) {
+  (void)ctx;
+  portENTER_CRITICAL(&s_mux);
+  // A new epoch, or a gap after a subscription reset, starts over.
+  if (tap->epoch != s_epoch || tap->sample_index != s_ring.head) {
+    s_epoch = tap->epoch;
+    history_ring_reset(&s_ring, tap->sample_index);
+  }
+  history_ring_begin(&s_ring, tap->length);
+  portEXIT_CRITICAL(&s_mux);
+
+  history_ring_store(&s_ring, tap->left, tap->right, tap->length);
+
+  portENTER_CRITICAL(&s_mux);
+  history_ring_end(&s_ring);
+  portEXIT_CRITICAL(&s_mux);
+}
+
+bool mic_history_start(void) {
+  if (s_running) {
+    return true;
+  }
+  const int samples =
+      (int)((int64_t)MIC_HISTORY_MS * MIC_HISTORY_MAX_RATE / 1000);
+  if (samples <= 0) {
+    return false;
+  }
+  int16_t *storage = audio_arena_alloc(
+      AUDIO_ARENA_LARGE, 2 * (size_t)samples * sizeof(int16_t), "mic_history");
+  if (storage == NULL) {
+    ESP_LOGE(TAG, "No memory for %d ms of history", MIC_HISTORY_MS);
+    return false;
+  }
+  history_ring_attach(&s_ring, storage, samples);
+  s_epoch = mic_config_epoch();
+
+  const mic_subscriber_cfg sub_cfg = {
+      .cb = mic_history_on_tap,
+      .name = "history",
+      .batch_taps = MIC_HISTORY_BATCH_TAPS,
+      .enabled = true,
+  };
+  s_sub = mic_subscribe(&sub_cfg);
+  if (s_sub == NULL) {
+    ESP_LOGE(TAG, "Failed to subscribe to microphone taps");
+    return false;
+  }
+  s_running = true;
+  ESP_LOGI(TAG, "%d samples per channel (%d ms at %d Hz)", samples,
+           MIC_HISTORY_MS, MIC_HISTORY_MAX_RATE);
+  return true;
+}
+
+int mic_history_samples(void) {
+  return s_running ? history_ring_capacity(&s_ring) : 0;
+}
+
+mic_history_state mic_history_check(uint32_t epoch, uint64_t start_index,
+                                    int length) {
+  if (!s_running) {
+    return MIC_HISTORY_LOST;
+  }
+  portENTER_CRITICAL(&s_mux);
+  const history_ring_state st =
+      epoch != s_epoch ? HISTORY_RING_LOST
+                       : history_ring_check(&s_ring, start_index, length);
+  portEXIT_CRITICAL(&s_mux);
+  return st == HISTORY_RING_OK        ? MIC_HISTORY_OK
+         : st == HISTORY_RING_PENDING ? MIC_HISTORY_PENDING
+                                      : MIC_HISTORY_LOST;
+}
+
+mic_history_state mic_history_read(uint32_t epoch, uint64_t start_index,
+                                   int length, int16_t *out_left,
+                                   int16_t *out_right) {
+  mic_history_state st = mic_history_check(epoch, start_index, length);
+  if (st != MIC_HISTORY_OK) {
+    return st;
+  }
+  // The base only moves on a reset, which also changes the epoch or
+  // overwrites the range, so the check below catches it.
+  history_ring_read(&s_ring, start_index, length, out_left, out_right);
+  st = mic_history_check(epoch, start_index, length);
+  return st == MIC_HISTORY_OK ? MIC_HISTORY_OK : MIC_HISTORY_LOST;
+}
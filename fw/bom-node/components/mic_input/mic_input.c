@@ -1,123 +1,283 @@
 #include "mic_input.h"
+#include "audio_arena.h"
+#include "dma_tuner.h"
+#include "mic_dsp.h"
 #include "ring_buffer.h"
-
-#include "driver/gpio.h"
-#include "driver/i2s_std.h"
-#include "driver/i2s_types.h"
+#include "mic_source.h"
+#include "sample_clock.h"
+#include "boot_timing.h"
 
 #include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "metrics.h"
+#include "trace.h"
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
-#include <math.h>
+#include <assert.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
 static const char *TAG = "MIC";
 
 static mic_config mic_cfg;
+// Both channel planes share one arena buffer; the DSP kernel writes
+// processed samples straight into it and taps are handed out as views. A
+// reconfiguration switches to the other slot: consumers may still be reading
+// old-epoch views from the ring it replaced, so that one is only reused by
+// the next.
+static audio_arena_slot ring_slots[2];
+static int ring_slot = 0;
 static rb_struct rb_left, rb_right;
-i2s_chan_handle_t rx_channel = NULL, tx_channel = NULL;
+static uint64_t tap_sample_index = 0;
+// Absolute index of ring position 0: where the current ring started filling.
+static uint64_t ring_base_index = 0;
+static uint32_t config_epoch = 0;
+// Guards tap_sample_index and, together with it, the ring geometry
+// (rb_left/rb_right, ring_base_index, config_epoch, mic_cfg), which change
+// only on reconfiguration.
+static portMUX_TYPE tap_index_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Sample index to esp_timer mapping. The reader steers its own copy and
+// publishes it under tap_index_mux once per chunk, so other tasks evaluate
+// the fit outside the critical section.
+static sample_clock reader_clock;
+static sample_clock published_clock;
+static uint32_t clock_overflows = 0; // dma_overflows at the last clock update
+
+// Wall-clock times before this are an unset clock.
+#define MIC_UNIX_VALID_S 1577836800LL
+// Set before mic_init() or picked there; fixed afterwards.
+static const mic_source *source = NULL;
 static bool mic_initialized = false;
-#define MIC_TAP_MAX_CALLBACKS 4
-static mic_tap_callback tap_cbs[MIC_TAP_MAX_CALLBACKS] = {0};
-static void *tap_cb_ctxs[MIC_TAP_MAX_CALLBACKS] = {0};
-static int tap_cb_count = 0;
+static TaskHandle_t reader_task = NULL;
+// Full CPU clock for one chunk's processing; NULL without CONFIG_PM_ENABLE.
+// The I2S driver holds its own APB lock, so the DMA timing is unaffected.
+static esp_pm_lock_handle_t reader_pm_lock = NULL;
 
-static int32_t i2s_read_buffer[CHUNK_FRAMES * 2];
+// A configuration posted by mic_reconfigure() for the reader to apply.
+static mic_config pending_cfg;
+static _Atomic bool reconfig_pending = false;
+static portMUX_TYPE pending_mux = portMUX_INITIALIZER_UNLOCKED;
 
 typedef struct {
-  int32_t x1;
-  int32_t y1;
-  int32_t R;
-} dc_filter;
-
-static dc_filter dcfL = {0}, dcfR = {0};
-
-static inline int16_t dc_block_sample(dc_filter *st, int16_t x) {
-  int32_t xn = (int32_t)x;
-  int32_t yn = xn - st->x1 + ((st->R * st->y1) >> 15);
-  st->x1 = xn;
-  st->y1 = yn;
-  return (int16_t)yn;
+  mic_config_listener cb;
+  void *ctx;
+} mic_listener_slot;
+
+static mic_listener_slot listeners[MIC_MAX_CONFIG_LISTENERS];
+static _Atomic int listener_count = 0;
+static portMUX_TYPE listeners_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Reset requests from other tasks, applied by the reader before the next
+// delivery.
+#define SUB_RESET_BATCH 0x1
+#define SUB_RESET_STATS 0x2
+
+struct mic_subscription {
+  mic_tap_callback cb;
+  void *ctx;
+  const char *name;
+  uint16_t batch_taps;
+  uint16_t decimation;
+  _Atomic uint8_t reset;
+  bool in_use; // guarded by subs_mux
+
+  // Reader-only batching state.
+  uint16_t batch_pos;   // taps of the current batch seen so far
+  uint16_t seg_taps;    // taps in the current contiguous segment
+  uint16_t skip;        // batches still to skip before the next delivery
+  bool deliver;         // current batch is delivered
+  uint64_t seg_start;   // absolute index of the segment's first sample
+};
+
+static struct mic_subscription subs[MIC_MAX_SUBSCRIBERS];
+static portMUX_TYPE subs_mux = portMUX_INITIALIZER_UNLOCKED;
+static _Atomic uint32_t subscribed_mask = 0;
+// The reader walks only the set bits, so idle subscribers cost nothing.
+static _Atomic uint32_t active_mask = 0;
+// Odd while the reader is delivering a chunk; lets mic_unsubscribe() wait
+// for an in-flight callback.
+static _Atomic uint32_t reader_pass = 0;
+
+static int32_t read_buffer[CHUNK_FRAMES * 2];
+// Frames of the tap at the ring head filled so far; a read that ends inside
+// a tap leaves it there for the next one. Reader only.
+static int tap_fill = 0;
+
+// DMA queue geometry, written by the reader (or before it exists).
+static int dma_frames = CHUNK_FRAMES;
+static int dma_desc = DMA_DESC_NUM;
+#if MIC_DMA_ADAPTIVE
+static dma_tuner dma_tune;
+#endif
+
+static mic_dc_filter dcfL = {0}, dcfR = {0};
+
+// Both channels' DC blockers for `fs`, with the configured resolution and
+// gain. Returns false when the coefficients were computed at runtime.
+static bool mic_dc_filters_init(int fs) {
+  const bool tabulated =
+      mic_dc_filter_init(&dcfL, fs, DC_BLOCK_FREQ_HZ, DC_BLOCK_FILTER);
+  mic_dc_filter_init(&dcfR, fs, DC_BLOCK_FREQ_HZ, DC_BLOCK_FILTER);
+  const int32_t gain = mic_dsp_gain_q12(DC_BLOCK_GAIN_DB);
+  mic_dc_filter_set_output(&dcfL, DC_BLOCK_HIGH_RES, gain);
+  mic_dc_filter_set_output(&dcfR, DC_BLOCK_HIGH_RES, gain);
+  return tabulated;
 }
 
-static void dc_block_init(dc_filter *st, int fs, int fc_hz) {
-  if (fc_hz <= 0)
-    fc_hz = 20;
-  float R0 = expf(-2.0f * 3.1416f * (float)fc_hz / (float)fs);
-  int32_t R = (int32_t)(R0 * 32768.0f + 0.5f);
-  if (R > 32767)
-    R = 32767;
-  if (R < 0)
-    R = 0;
-  st->x1 = 0;
-  st->y1 = 0;
-  st->R = R;
+// Offsets applied by the reader; published copy for other tasks under dc_mux.
+static int32_t dc_off_l = DC_OFFSET_LEFT, dc_off_r = DC_OFFSET_RIGHT;
+static mic_dc_offset dc_published = {DC_OFFSET_LEFT, DC_OFFSET_RIGHT, false};
+static portMUX_TYPE dc_mux = portMUX_INITIALIZER_UNLOCKED;
+static mic_dc_listener dc_listener = NULL;
+static void *dc_listener_ctx = NULL;
+
+// Reader-only calibration / tracking accumulator.
+static struct {
+  int64_t sum_l, sum_r;
+  uint32_t frames;
+  uint32_t chunks;
+  bool calibrated;
+  int16_t notified_l, notified_r;
+} dc_track;
+
+// The reader accumulates into reader_stats and publishes a copy once per
+// chunk; readers of mic_get_stats() only ever see the published copy.
+static mic_stats reader_stats;
+static mic_stats published_stats;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static const uint32_t cb_hist_edges_us[] = MIC_CB_HIST_EDGES_US;
+
+static void mic_collect(metrics_out *out, void *ctx);
+static metrics_collector mic_collector = METRICS_COLLECTOR_INIT(mic_collect,
+                                                                NULL);
+
+static uint32_t source_overflows(void) {
+  return source->overflows ? source->overflows() : 0;
 }
 
-static inline int16_t int_shift(int32_t s) { return (int16_t)(s >> 16); }
-
-void mic_init(const mic_config *cfg) {
-  mic_cfg = *cfg;
-  mic_initialized = true;
+static void stats_record_callback(mic_callback_stats *st, uint32_t us) {
+  st->calls++;
+  st->total_us += us;
+  if (us > st->max_us) {
+    st->max_us = us;
+  }
+  int b = 0;
+  while (b < MIC_CB_HIST_BUCKETS - 1 && us >= cb_hist_edges_us[b]) {
+    b++;
+  }
+  st->hist[b]++;
+}
 
-  const int samples = mic_cfg.num_taps * mic_cfg.tap_size;
-  rb_init(&rb_left, samples);
-  rb_init(&rb_right, samples);
+static void stats_record_chunk(uint32_t us, int32_t lag_us) {
+  mic_stats *st = &reader_stats;
+  if (lag_us >= 0) {
+    st->read_lag_us = (uint32_t)lag_us;
+    if (st->read_lag_us > st->read_lag_us_max) {
+      st->read_lag_us_max = st->read_lag_us;
+    }
+  }
+  st->dma_desc_num = (uint16_t)dma_desc;
+  st->dma_frames = (uint16_t)dma_frames;
+  if (st->chunks == 0 || us < st->chunk_us_min) {
+    st->chunk_us_min = us;
+  }
+  if (us > st->chunk_us_max) {
+    st->chunk_us_max = us;
+  }
+  st->chunk_us_total += us;
+  if (st->chunks++ == 0) {
+    boot_timing_mark(BOOT_STAGE_FIRST_SAMPLE);
+  }
+  st->dma_overflows = source_overflows();
+  st->source = source->name;
+  st->subscribed_mask = atomic_load(&subscribed_mask);
+  st->active_mask = atomic_load(&active_mask);
+  st->clock_ppm = (float)sample_clock_ppm(&reader_clock);
+  st->clock_relocks = reader_clock.relocks;
+  st->clock_locked = sample_clock_locked(&reader_clock);
+
+  portENTER_CRITICAL(&stats_mux);
+  published_stats = *st;
+  portEXIT_CRITICAL(&stats_mux);
+}
 
-  i2s_chan_config_t chan_cfg = {
-      .id = I2S_NUM_0,
-      .role = I2S_ROLE_MASTER,
-      .dma_desc_num = DMA_DESC_NUM,
-      .dma_frame_num = CHUNK_FRAMES,
-      .auto_clear = true,
-  };
+// One spare tap slot past the retained history: taps are always committed
+// whole at the head, and a tap a read leaves unfinished (tap_fill) is
+// filtered into the slot and committed once the next read completes it.
+static int ring_samples_for(const mic_config *cfg) {
+  return mic_retained_samples(cfg) + cfg->tap_size;
+}
 
-  // NOTE: I2S RX was returning zeros unless TX was also enabled, so we
-  // create+enable both channels.
-  ESP_ERROR_CHECK(i2s_new_channel(&chan_cfg, &tx_channel, &rx_channel));
-
-  i2s_std_slot_config_t slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(
-      I2S_DATA_BIT_WIDTH_32BIT, I2S_SLOT_MODE_STEREO);
-  slot_cfg.slot_bit_width = I2S_SLOT_BIT_WIDTH_32BIT;
-  slot_cfg.slot_mask = I2S_STD_SLOT_BOTH;
-
-  i2s_std_config_t std_cfg = {
-      .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(mic_cfg.sampling_freq),
-      .slot_cfg = slot_cfg,
-      .gpio_cfg =
-          {
-              .mclk = I2S_GPIO_UNUSED,
-              .bclk = GPIO_NUM_19,
-              .ws = GPIO_NUM_18,
-              .dout = I2S_GPIO_UNUSED,
-              .din = GPIO_NUM_21,
-              .invert_flags =
-                  {
-                      .mclk_inv = false,
-                      .bclk_inv = false,
-                      .ws_inv = false,
-                  },
-          },
-  };
+int mic_retained_samples(const mic_config *cfg) {
+  return (cfg->num_taps + MIC_RING_HEADROOM_TAPS) * cfg->tap_size;
+}
 
-  ESP_ERROR_CHECK(i2s_channel_init_std_mode(tx_channel, &std_cfg));
-  ESP_ERROR_CHECK(i2s_channel_init_std_mode(rx_channel, &std_cfg));
+// Every frame read is committed eventually, so the counter runs at the I2S
+// rate. Callers hold tap_index_mux or run before the reader starts.
+static void clock_reset(const mic_config *cfg) {
+  sample_clock_reset(&reader_clock, (double)cfg->sampling_freq);
+  published_clock = reader_clock;
+}
 
-  // keep TX enabled – see note above
-  ESP_ERROR_CHECK(i2s_channel_enable(tx_channel));
-  ESP_ERROR_CHECK(i2s_channel_enable(rx_channel));
+#if MIC_DMA_ADAPTIVE
+// Audio held by one DMA buffer [us].
+static uint32_t dma_period_us(void) {
+  return (uint32_t)((int64_t)dma_frames * 1000000 / mic_cfg.sampling_freq);
+}
+#endif
 
-  int fc = DC_BLOCK_FREQ_HZ;
-  dc_block_init(&dcfL, mic_cfg.sampling_freq, fc);
-  dc_block_init(&dcfR, mic_cfg.sampling_freq, fc);
+void mic_init(const mic_config *cfg) {
+  mic_cfg = *cfg;
+  mic_initialized = true;
+  metrics_register(&mic_collector.base);
+
+  const int samples = ring_samples_for(&mic_cfg);
+  int16_t *storage = audio_arena_slot_get(&ring_slots[ring_slot],
+                                          AUDIO_ARENA_INTERNAL,
+                                          2 * samples * sizeof(int16_t), "mic_ring");
+  assert(storage != NULL);
+  rb_attach(&rb_left, storage, samples);
+  rb_attach(&rb_right, storage + samples, samples);
+  clock_reset(&mic_cfg);
+
+  if (source == NULL) {
+    source = mic_source_default();
+  }
+  dma_frames = mic_dma_frames(mic_cfg.tap_size);
+  if (source->set_dma) {
+    ESP_ERROR_CHECK(source->set_dma(dma_desc, dma_frames));
+  }
+  ESP_ERROR_CHECK(source->open(mic_cfg.sampling_freq));
+#if MIC_DMA_ADAPTIVE
+  dma_tuner_init(&dma_tune, dma_desc, MIC_DMA_DESC_MIN, MIC_DMA_DESC_MAX,
+                 dma_period_us(), source_overflows());
+#endif
+
+  if (!mic_dc_filters_init(mic_cfg.sampling_freq)) {
+    ESP_LOGW(TAG, "No precomputed DC filter for %d Hz, computed at init",
+             mic_cfg.sampling_freq);
+  }
 
-  ESP_LOGI(TAG, "I2S initialized");
+  ESP_LOGI(TAG, "Mic source: %s", source->name);
   ESP_LOGI(TAG, " - Sampling frequency - %d Hz", mic_cfg.sampling_freq);
   ESP_LOGI(TAG, " - Buffer size - %d samples", samples);
+  ESP_LOGI(TAG, " - DMA - %d x %d frames%s", dma_desc, dma_frames,
+           MIC_DMA_ADAPTIVE ? ", adaptive" : "");
+  ESP_LOGI(TAG, " - DSP input - %d bits, gain %d dB",
+           DC_BLOCK_HIGH_RES ? 16 + MIC_DSP_HIGH_RES_BITS : 16,
+           DC_BLOCK_GAIN_DB);
+
+#ifdef CONFIG_MIC_DSP_BENCHMARK
+  mic_dsp_run_benchmark(mic_cfg.tap_size);
+#endif
 }
 
 void mic_init_default(void) {
@@ -137,11 +297,44 @@ void mic_start(void) {
     ESP_LOGE(TAG, "mic_start called before mic_init");
     return;
   }
+  if (reader_task != NULL) {
+    return;
+  }
+  if (reader_pm_lock == NULL &&
+      esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "mic_reader",
+                         &reader_pm_lock) != ESP_OK) {
+    reader_pm_lock = NULL;
+  }
+
+  if (xTaskCreatePinnedToCore(mic_reader_task, "mic_reader",
+                              MIC_READER_TASK_STACK, NULL,
+                              MIC_READER_TASK_PRIORITY, &reader_task,
+                              MIC_READER_TASK_CORE) != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create mic_reader task");
+    reader_task = NULL;
+  }
+}
 
-  xTaskCreatePinnedToCore(mic_reader_task, "mic_reader",
-                          MIC_READER_TASK_STACK, NULL,
-                          MIC_READER_TASK_PRIORITY, NULL,
-                          MIC_READER_TASK_CORE);
+const mic_source *mic_source_default(void) {
+#if CONFIG_MIC_SOURCE_WAV
+  return &mic_source_wav;
+#elif CONFIG_MIC_SOURCE_SYNTH
+  return &mic_source_synth;
+#else
+  return &mic_source_i2s;
+#endif
+}
+
+void mic_set_source(const mic_source *src) {
+  if (mic_initialized) {
+    ESP_LOGE(TAG, "mic_set_source called after mic_init");
+    return;
+  }
+  source = src;
+}
+
+const mic_source *mic_get_source(void) {
+  return source ? source : mic_source_default();
 }
 
 const mic_config *mic_get_config(void) {
@@ -151,75 +344,664 @@ const mic_config *mic_get_config(void) {
   return &mic_cfg;
 }
 
-void mic_set_tap_callback(mic_tap_callback cb, void *ctx) {
-  tap_cb_count = 0;
-  if (cb != NULL) {
-    tap_cbs[0] = cb;
-    tap_cb_ctxs[0] = ctx;
-    tap_cb_count = 1;
+// Runs on the reader task (or before it exists), between two chunks.
+static void mic_apply_config(const mic_config *cfg) {
+  const int samples = ring_samples_for(cfg);
+  const int next_slot = ring_slot ^ 1;
+  int16_t *storage = audio_arena_slot_get(&ring_slots[next_slot],
+                                          AUDIO_ARENA_INTERNAL,
+                                          2 * samples * sizeof(int16_t), "mic_ring");
+  if (storage == NULL) {
+    ESP_LOGE(TAG, "Reconfigure failed: no memory for %d-sample ring",
+             samples);
+    return;
   }
+
+  if (cfg->sampling_freq != mic_cfg.sampling_freq) {
+    ESP_ERROR_CHECK(source->set_rate(cfg->sampling_freq));
+  }
+  // Buffers stay aligned to whole taps where the queue can be rebuilt; on
+  // failure the source keeps the previous queue, and the reader carries
+  // partial taps across reads of that size.
+  const int frames = mic_dma_frames(cfg->tap_size);
+  if (frames != dma_frames && source->set_dma) {
+    const esp_err_t err = source->set_dma(dma_desc, frames);
+    if (err == ESP_OK) {
+      dma_frames = frames;
+    } else {
+      ESP_LOGW(TAG, "DMA buffers %d -> %d frames failed, keeping %d: %s",
+               dma_frames, frames, dma_frames, esp_err_to_name(err));
+    }
+  } else {
+    dma_frames = frames;
+  }
+
+  ring_slot = next_slot;
+
+  portENTER_CRITICAL(&tap_index_mux);
+  mic_cfg = *cfg;
+  rb_attach(&rb_left, storage, samples);
+  rb_attach(&rb_right, storage + samples, samples);
+  ring_base_index = tap_sample_index;
+  // The unfinished tap belonged to the old ring.
+  tap_fill = 0;
+  const uint32_t epoch = ++config_epoch;
+  // A new rate, and the channel restart leaves a gap in arrivals anyway.
+  clock_reset(cfg);
+  portEXIT_CRITICAL(&tap_index_mux);
+
+  mic_dc_filters_init(cfg->sampling_freq);
+#if MIC_DMA_ADAPTIVE
+  dma_tuner_resized(&dma_tune, dma_desc, dma_period_us(), source_overflows());
+#endif
+
+  // Partial batches refer to the old ring.
+  uint32_t mask = atomic_load(&subscribed_mask);
+  while (mask) {
+    const int k = __builtin_ctz(mask);
+    mask &= mask - 1;
+    atomic_fetch_or(&subs[k].reset, SUB_RESET_BATCH);
+  }
+
+  ESP_LOGI(TAG, "Reconfigured (epoch %lu): %d Hz, %dx%d taps, %d samples",
+           (unsigned long)epoch, cfg->sampling_freq, cfg->num_taps,
+           cfg->tap_size, samples);
+
+  const int count = atomic_load(&listener_count);
+  for (int k = 0; k < count; k++) {
+    listeners[k].cb(&mic_cfg, epoch, listeners[k].ctx);
+  }
+}
+
+esp_err_t mic_reconfigure(const mic_config *cfg) {
+  if (!mic_initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  // A tap must fit into one DMA chunk.
+  if (cfg == NULL || cfg->sampling_freq <= 0 || cfg->num_taps <= 0 ||
+      cfg->tap_size <= 0 || cfg->tap_size > CHUNK_FRAMES ||
+      cfg->pre_event_ms < 0 || cfg->post_event_ms < 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (reader_task == NULL) {
+    mic_apply_config(cfg);
+    return ESP_OK;
+  }
+  portENTER_CRITICAL(&pending_mux);
+  pending_cfg = *cfg;
+  atomic_store(&reconfig_pending, true);
+  portEXIT_CRITICAL(&pending_mux);
+  return ESP_OK;
 }
 
-bool mic_add_tap_callback(mic_tap_callback cb, void *ctx) {
+uint32_t mic_config_epoch(void) {
+  portENTER_CRITICAL(&tap_index_mux);
+  uint32_t epoch = config_epoch;
+  portEXIT_CRITICAL(&tap_index_mux);
+  return epoch;
+}
+
+bool mic_add_config_listener(mic_config_listener cb, void *ctx) {
   if (cb == NULL) {
     return false;
   }
-  if (tap_cb_count >= MIC_TAP_MAX_CALLBACKS) {
-    return false;
+  bool added = false;
+  portENTER_CRITICAL(&listeners_mux);
+  const int count = atomic_load(&listener_count);
+  if (count < MIC_MAX_CONFIG_LISTENERS) {
+    listeners[count].cb = cb;
+    listeners[count].ctx = ctx;
+    // Published after the slot is filled; the reader reads up to the count.
+    atomic_store(&listener_count, count + 1);
+    added = true;
   }
-  tap_cbs[tap_cb_count] = cb;
-  tap_cb_ctxs[tap_cb_count] = ctx;
-  tap_cb_count++;
-  return true;
+  portEXIT_CRITICAL(&listeners_mux);
+  return added;
 }
 
-void mic_reader_task(void *arg) {
-  size_t bytes_rec = 0;
-  int16_t tapL[mic_cfg.tap_size];
-  int16_t tapR[mic_cfg.tap_size];
+mic_subscription *mic_subscribe(const mic_subscriber_cfg *cfg) {
+  if (cfg == NULL || cfg->cb == NULL ||
+      cfg->batch_taps > MIC_RING_HEADROOM_TAPS) {
+    return NULL;
+  }
 
-  while (true) {
-    i2s_channel_read(rx_channel, (void *)i2s_read_buffer, READ_BUFFER_BYTES,
-                     &bytes_rec, portMAX_DELAY);
+  struct mic_subscription *sub = NULL;
+  portENTER_CRITICAL(&subs_mux);
+  for (int k = 0; k < MIC_MAX_SUBSCRIBERS; k++) {
+    if (!subs[k].in_use) {
+      sub = &subs[k];
+      sub->in_use = true;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&subs_mux);
+  if (sub == NULL) {
+    ESP_LOGE(TAG, "No free tap subscription slot");
+    return NULL;
+  }
 
-    const int n = bytes_rec / 8;
-    for (int i = 0; i < n; i++) {
+  // The slot is not in subscribed_mask yet, so the reader does not look at
+  // it while it is filled in.
+  const uint32_t bit = 1u << (sub - subs);
+  sub->cb = cfg->cb;
+  sub->ctx = cfg->ctx;
+  sub->name = cfg->name ? cfg->name : "?";
+  sub->batch_taps = cfg->batch_taps ? cfg->batch_taps : 1;
+  sub->decimation = cfg->decimation ? cfg->decimation : 1;
+  atomic_store(&sub->reset, SUB_RESET_BATCH | SUB_RESET_STATS);
+  atomic_fetch_or(&subscribed_mask, bit);
+  if (cfg->enabled) {
+    atomic_fetch_or(&active_mask, bit);
+  }
+  return sub;
+}
 
-      int32_t sL32 = i2s_read_buffer[2 * i + 1];
-      int32_t sR32 = i2s_read_buffer[2 * i + 0];
+void mic_unsubscribe(mic_subscription *sub) {
+  if (sub == NULL) {
+    return;
+  }
+  const uint32_t bit = 1u << (sub - subs);
+  atomic_fetch_and(&active_mask, ~bit);
+  atomic_fetch_and(&subscribed_mask, ~bit);
+
+  // A delivery that loaded the mask before it was cleared may still be
+  // running; wait for the reader to finish that chunk.
+  uint32_t pass = atomic_load(&reader_pass);
+  if ((pass & 1u) && xTaskGetCurrentTaskHandle() != reader_task) {
+    while (atomic_load(&reader_pass) == pass) {
+      vTaskDelay(1);
+    }
+  }
 
-      int16_t xL0 = int_shift(sL32);
-      int16_t xR0 = int_shift(sR32);
+  portENTER_CRITICAL(&subs_mux);
+  sub->in_use = false;
+  portEXIT_CRITICAL(&subs_mux);
+}
 
-      int16_t xL = xL0 + DC_OFFSET_LEFT;
-      int16_t xR = xR0 + DC_OFFSET_RIGHT;
+void mic_subscription_set_enabled(mic_subscription *sub, bool enabled) {
+  if (sub == NULL) {
+    return;
+  }
+  const uint32_t bit = 1u << (sub - subs);
+  if (enabled) {
+    if (!(atomic_load(&active_mask) & bit)) {
+      atomic_fetch_or(&sub->reset, SUB_RESET_BATCH);
+      atomic_fetch_or(&active_mask, bit);
+    }
+  } else {
+    atomic_fetch_and(&active_mask, ~bit);
+  }
+}
 
-      int16_t yL = dc_block_sample(&dcfL, xL);
-      int16_t yR = dc_block_sample(&dcfR, xR);
+bool mic_subscription_enabled(const mic_subscription *sub) {
+  return sub != NULL &&
+         (atomic_load(&active_mask) & (1u << (sub - subs))) != 0;
+}
 
-      tapL[i % mic_cfg.tap_size] = yL;
-      tapR[i % mic_cfg.tap_size] = yR;
+// Accounts one freshly committed tap for `sub` and calls it when a batch
+// (or the part of it before the ring end) is complete.
+static void deliver_tap(struct mic_subscription *sub, int slot,
+                        uint64_t tap_index, int tap_size, uint32_t epoch) {
+  uint8_t reset = atomic_exchange(&sub->reset, 0);
+  if (reset & SUB_RESET_STATS) {
+    memset(&reader_stats.callbacks[slot], 0, sizeof(mic_callback_stats));
+    reader_stats.callbacks[slot].name = sub->name;
+  }
+  if (reset & SUB_RESET_BATCH) {
+    sub->batch_pos = 0;
+    sub->seg_taps = 0;
+    sub->skip = 0;
+  }
 
-      if (((i + 1) % mic_cfg.tap_size == 0)) {
+  if (sub->batch_pos == 0) {
+    sub->deliver = sub->skip == 0;
+    sub->skip = sub->deliver ? sub->decimation - 1 : sub->skip - 1;
+  }
+  if (sub->seg_taps == 0) {
+    sub->seg_start = tap_index;
+  }
+  sub->seg_taps++;
+  sub->batch_pos++;
+
+  const bool batch_done = sub->batch_pos >= sub->batch_taps;
+  // Views are contiguous, so a segment ends where the ring wraps.
+  const bool ring_end = rb_left.head == 0;
+  if (batch_done) {
+    sub->batch_pos = 0;
+  }
+  if (!batch_done && !ring_end) {
+    return;
+  }
 
-        for (int j = 0; j < mic_cfg.tap_size; j++) {
-          rb_push(&rb_left, tapL[j]);
-          rb_push(&rb_right, tapR[j]);
-        }
+  const int length = sub->seg_taps * tap_size;
+  sub->seg_taps = 0;
+  if (!sub->deliver) {
+    return;
+  }
 
-        for (int k = 0; k < tap_cb_count; k++) {
-          if (tap_cbs[k]) {
-            tap_cbs[k](&tapL[0], &tapR[0], tap_cb_ctxs[k]);
-          }
-        }
+  const int pos = (ring_end ? rb_left.size : rb_left.head) - length;
+  mic_tap_view view = {
+      .left = &rb_left.data[pos],
+      .right = &rb_right.data[pos],
+      .length = length,
+      .sample_index = sub->seg_start,
+      .time_us = sample_clock_time_us(&reader_clock, sub->seg_start),
+      .epoch = epoch,
+  };
+  int64_t t0 = esp_timer_get_time();
+  TRACE_BEGIN(TRACE_TAP_CALLBACK, slot);
+  sub->cb(&view, sub->ctx);
+  TRACE_END(TRACE_TAP_CALLBACK, slot);
+  stats_record_callback(&reader_stats.callbacks[slot],
+                        (uint32_t)(esp_timer_get_time() - t0));
+}
+
+static int32_t dc_clamp(int32_t v) {
+  if (v > MIC_DC_OFFSET_LIMIT)
+    return MIC_DC_OFFSET_LIMIT;
+  if (v < -MIC_DC_OFFSET_LIMIT)
+    return -MIC_DC_OFFSET_LIMIT;
+  return v;
+}
+
+// Rounded mean of the raw samples, negated: the offset that centres them.
+static int32_t dc_offset_for(int64_t sum, uint32_t frames) {
+  const int64_t half = frames / 2;
+  int64_t mean = sum >= 0 ? (sum + half) / frames : (sum - half) / frames;
+  return dc_clamp((int32_t)-mean);
+}
+
+// Applies new offsets between chunks. The filter histories move with them,
+// so the change produces no step at the filter output (and no false hit).
+static void dc_apply(int32_t left, int32_t right) {
+  mic_dc_filter_shift(&dcfL, left - dc_off_l);
+  mic_dc_filter_shift(&dcfR, right - dc_off_r);
+  dc_off_l = left;
+  dc_off_r = right;
+  portENTER_CRITICAL(&dc_mux);
+  dc_published.left = (int16_t)left;
+  dc_published.right = (int16_t)right;
+  dc_published.calibrated = dc_track.calibrated;
+  portEXIT_CRITICAL(&dc_mux);
+}
+
+static void dc_notify(void) {
+  dc_track.notified_l = (int16_t)dc_off_l;
+  dc_track.notified_r = (int16_t)dc_off_r;
+  // Offsets calibrated on replayed audio say nothing about the microphones
+  // and are not handed on to be stored.
+  if (dc_listener != NULL && source->raw) {
+    const mic_dc_offset off = {(int16_t)dc_off_l, (int16_t)dc_off_r, true};
+    dc_listener(&off, dc_listener_ctx);
+  }
+}
+
+// One tracker step of `d` towards the target, rounded away from zero so the
+// tracker settles on the target exactly.
+static int32_t dc_track_step(int32_t d) {
+  const int32_t round = (1 << MIC_DC_TRACK_SHIFT) - 1;
+  return d >= 0 ? (d + round) >> MIC_DC_TRACK_SHIFT
+                : -((-d + round) >> MIC_DC_TRACK_SHIFT);
+}
+
+// Runs once per chunk on the raw DMA data: first a plain mean over the
+// calibration chunks, then a slow exponential tracker.
+static void dc_track_chunk(const int32_t *buf, int frames) {
+  mic_dsp_sum_chunk(buf, frames, &dc_track.sum_l, &dc_track.sum_r);
+  dc_track.frames += frames;
+  dc_track.chunks++;
+
+  const uint32_t period =
+      dc_track.calibrated ? MIC_DC_TRACK_CHUNKS : MIC_DC_CAL_CHUNKS;
+  if (dc_track.chunks < period || dc_track.frames == 0) {
+    return;
+  }
+  const int32_t target_l = dc_offset_for(dc_track.sum_l, dc_track.frames);
+  const int32_t target_r = dc_offset_for(dc_track.sum_r, dc_track.frames);
+  dc_track.sum_l = dc_track.sum_r = 0;
+  dc_track.frames = 0;
+  dc_track.chunks = 0;
+
+  if (!dc_track.calibrated) {
+    dc_track.calibrated = true;
+    ESP_LOGI(TAG, "DC offset calibrated: L %ld -> %ld, R %ld -> %ld",
+             (long)dc_off_l, (long)target_l, (long)dc_off_r, (long)target_r);
+    dc_apply(target_l, target_r);
+    dc_notify();
+    return;
+  }
+
+  const int32_t step_l = dc_track_step(target_l - dc_off_l);
+  const int32_t step_r = dc_track_step(target_r - dc_off_r);
+  if (step_l != 0 || step_r != 0) {
+    dc_apply(dc_off_l + step_l, dc_off_r + step_r);
+  }
+  if (abs(dc_off_l - dc_track.notified_l) >= MIC_DC_NOTIFY_DELTA ||
+      abs(dc_off_r - dc_track.notified_r) >= MIC_DC_NOTIFY_DELTA) {
+    dc_notify();
+  }
+}
+
+void mic_set_dc_offset(int16_t left, int16_t right) {
+  if (reader_task != NULL) {
+    ESP_LOGW(TAG, "mic_set_dc_offset ignored while the reader is running");
+    return;
+  }
+  dc_off_l = dc_clamp(left);
+  dc_off_r = dc_clamp(right);
+  dc_track.notified_l = (int16_t)dc_off_l;
+  dc_track.notified_r = (int16_t)dc_off_r;
+  portENTER_CRITICAL(&dc_mux);
+  dc_published.left = (int16_t)dc_off_l;
+  dc_published.right = (int16_t)dc_off_r;
+  dc_published.calibrated = false;
+  portEXIT_CRITICAL(&dc_mux);
+}
+
+void mic_get_dc_offset(mic_dc_offset *out) {
+  if (out == NULL) {
+    return;
+  }
+  portENTER_CRITICAL(&dc_mux);
+  *out = dc_published;
+  portEXIT_CRITICAL(&dc_mux);
+}
+
+void mic_set_dc_listener(mic_dc_listener cb, void *ctx) {
+  dc_listener_ctx = ctx;
+  dc_listener = cb;
+}
+
+#if MIC_DMA_ADAPTIVE
+// Rebuilds the DMA queue when the tuner asks for another size. The rebuild
+// loses the audio in flight, so the clock re-anchors as after an overflow.
+static void dma_adapt(int32_t lag_us, uint32_t overflows) {
+  const int want = dma_tuner_chunk(&dma_tune, lag_us, overflows);
+  if (want == dma_desc || source->set_dma == NULL) {
+    return;
+  }
+  const esp_err_t err = source->set_dma(want, dma_frames);
+  // Either way the queue was rebuilt and the audio in flight is gone; the
+  // unfinished tap must not be completed with audio from after the gap.
+  tap_fill = 0;
+  if (err == ESP_OK) {
+    ESP_LOGI(TAG, "DMA queue %d -> %d buffers (read lag max %lu us)",
+             dma_desc, want, (unsigned long)reader_stats.read_lag_us_max);
+    dma_desc = want;
+  } else {
+    ESP_LOGW(TAG, "DMA queue %d -> %d buffers failed: %s", dma_desc, want,
+             esp_err_to_name(err));
+  }
+  sample_clock_unlock(&reader_clock);
+  dma_tuner_resized(&dma_tune, dma_desc, dma_period_us(), source_overflows());
+  reader_stats.dma_resizes = dma_tune.resizes;
+}
+#endif
+
+void mic_reader_task(void *arg) {
+  while (true) {
+    if (atomic_load(&reconfig_pending)) {
+      mic_config cfg;
+      portENTER_CRITICAL(&pending_mux);
+      cfg = pending_cfg;
+      atomic_store(&reconfig_pending, false);
+      portEXIT_CRITICAL(&pending_mux);
+      mic_apply_config(&cfg);
+    }
+    // Only this task changes the geometry, so it may read it unlocked.
+    const int tap_size = mic_cfg.tap_size;
+    const uint32_t epoch = config_epoch;
+
+    const int n = source->read(read_buffer, dma_frames);
+    TRACE_INSTANT(TRACE_I2S_READ, n * 8);
+    if (n == 0) {
+      continue;
+    }
+    // Stamped before the clock switch, which can take a few microseconds.
+    const int64_t chunk_start = esp_timer_get_time();
+    if (reader_pm_lock) {
+      esp_pm_lock_acquire(reader_pm_lock);
+    }
+    atomic_fetch_add(&reader_pass, 1);
+
+    int off = 0;
+
+    // Offsets change only here, between chunks, so a chunk is processed
+    // with one pair throughout.
+    if (MIC_DC_CAL_CHUNKS > 0) {
+      dc_track_chunk(read_buffer, n);
+    }
+
+    // The ring size is a multiple of tap_size and the head only moves by
+    // whole taps, so every tap is contiguous in both planes. The first tap
+    // may continue one the previous read started, the last may be left for
+    // the next.
+    while (off < n) {
+      const int take =
+          tap_size - tap_fill < n - off ? tap_size - tap_fill : n - off;
+      mic_dsp_process_chunk(&read_buffer[2 * off], take, (int16_t)dc_off_l,
+                            (int16_t)dc_off_r, &dcfL, &dcfR,
+                            rb_write_ptr(&rb_left) + tap_fill,
+                            rb_write_ptr(&rb_right) + tap_fill);
+      off += take;
+      tap_fill += take;
+      if (tap_fill < tap_size) {
+        break;
       }
+      tap_fill = 0;
+      const uint64_t tap_index = tap_sample_index;
+      // The heads move with the index, so ring_state_get() copies a
+      // consistent ring.
+      portENTER_CRITICAL(&tap_index_mux);
+      rb_commit(&rb_left, tap_size);
+      rb_commit(&rb_right, tap_size);
+      tap_sample_index += tap_size;
+      portEXIT_CRITICAL(&tap_index_mux);
+
+      uint32_t mask = atomic_load(&active_mask);
+      while (mask) {
+        const int k = __builtin_ctz(mask);
+        mask &= mask - 1;
+        deliver_tap(&subs[k], k, tap_index, tap_size, epoch);
+      }
+    }
+
+    // The read returned once the chunk's last frame was in, so its arrival
+    // bounds the capture time of everything read so far, the unfinished tap
+    // included. An overflow dropped audio the counter never saw; the fit
+    // starts over from here.
+    const uint32_t ovf = source_overflows();
+    if (ovf != clock_overflows) {
+      clock_overflows = ovf;
+      sample_clock_unlock(&reader_clock);
+    }
+    const uint64_t read_end = tap_sample_index + (uint64_t)tap_fill;
+    sample_clock_update(&reader_clock, read_end, chunk_start);
+    portENTER_CRITICAL(&tap_index_mux);
+    published_clock = reader_clock;
+    portEXIT_CRITICAL(&tap_index_mux);
+
+    // How long the last frame waited for this read; the fit tracks the
+    // least delayed arrivals, so it is only meaningful once locked.
+    int32_t lag_us = -1;
+    if (sample_clock_locked(&reader_clock)) {
+      const int64_t lag =
+          chunk_start - sample_clock_time_us(&reader_clock, read_end);
+      lag_us = lag > 0 ? (lag < INT32_MAX ? (int32_t)lag : INT32_MAX) : 0;
+    }
+
+    atomic_fetch_add(&reader_pass, 1);
+    stats_record_chunk((uint32_t)(esp_timer_get_time() - chunk_start),
+                       lag_us);
+#if MIC_DMA_ADAPTIVE
+    dma_adapt(lag_us, ovf);
+#endif
+    if (reader_pm_lock) {
+      esp_pm_lock_release(reader_pm_lock);
     }
   }
 }
 
+// Scrape-time view of the reader telemetry: the counters already live in
+// published_stats, so they are read from a snapshot instead of duplicated.
+static void mic_collect(metrics_out *out, void *ctx) {
+  (void)ctx;
+  mic_stats st;
+  mic_get_stats(&st);
+  metrics_out_family(out, "mic_chunks_total", "counter",
+                     "DMA chunks processed by the reader");
+  metrics_out_uint(out, "mic_chunks_total", NULL, st.chunks);
+  metrics_out_family(out, "mic_dma_overflows_total", "counter",
+                     "I2S receive queue overflows (audio lost)");
+  metrics_out_uint(out, "mic_dma_overflows_total", NULL, st.dma_overflows);
+  metrics_out_family(out, "mic_chunk_us_max", "gauge",
+                     "Longest chunk processing time [us]");
+  metrics_out_uint(out, "mic_chunk_us_max", NULL, st.chunk_us_max);
+  metrics_out_family(out, "mic_chunk_us_total", "counter",
+                     "Total chunk processing time [us]");
+  metrics_out_uint(out, "mic_chunk_us_total", NULL, st.chunk_us_total);
+  metrics_out_family(out, "mic_dma_buffers", "gauge",
+                     "I2S DMA buffers in the receive queue");
+  metrics_out_uint(out, "mic_dma_buffers", NULL, st.dma_desc_num);
+  metrics_out_family(out, "mic_read_lag_us_max", "gauge",
+                     "Longest wait of a captured frame for its read [us]");
+  metrics_out_uint(out, "mic_read_lag_us_max", NULL, st.read_lag_us_max);
+  metrics_out_family(out, "mic_clock_ppm", "gauge",
+                     "Sample clock deviation from nominal [ppm]");
+  metrics_out_double(out, "mic_clock_ppm", NULL, st.clock_ppm);
+  metrics_out_family(out, "mic_clock_relocks_total", "counter",
+                     "Sample clock re-anchors");
+  metrics_out_uint(out, "mic_clock_relocks_total", NULL, st.clock_relocks);
+
+  // Buckets hold durations below their edge; whole microseconds make that
+  // the inclusive "le" bound edge - 1.
+  metrics_out_family(out, "mic_callback_us", "histogram",
+                     "Tap callback duration [us]");
+  for (int i = 0; i < MIC_MAX_SUBSCRIBERS; i++) {
+    const mic_callback_stats *cb = &st.callbacks[i];
+    if (!(st.subscribed_mask & (1u << i))) {
+      continue;
+    }
+    const char *name = cb->name ? cb->name : "unnamed";
+    char labels[64];
+    uint64_t cumulative = 0;
+    for (int b = 0; b < MIC_CB_HIST_BUCKETS; b++) {
+      cumulative += cb->hist[b];
+      if (b + 1 < MIC_CB_HIST_BUCKETS) {
+        snprintf(labels, sizeof(labels), "callback=\"%s\",le=\"%u\"", name,
+                 (unsigned)cb_hist_edges_us[b] - 1);
+      } else {
+        snprintf(labels, sizeof(labels), "callback=\"%s\",le=\"+Inf\"",
+                 name);
+      }
+      metrics_out_uint(out, "mic_callback_us_bucket", labels, cumulative);
+    }
+    snprintf(labels, sizeof(labels), "callback=\"%s\"", name);
+    metrics_out_uint(out, "mic_callback_us_sum", labels, cb->total_us);
+    metrics_out_uint(out, "mic_callback_us_count", labels, cb->calls);
+  }
+}
+
+void mic_get_stats(mic_stats *out) {
+  if (out == NULL) {
+    return;
+  }
+  portENTER_CRITICAL(&stats_mux);
+  *out = published_stats;
+  portEXIT_CRITICAL(&stats_mux);
+}
+
 void mic_save_event(int16_t *out_left_mic, int16_t *out_right_mic) {
 
   const int wanted = mic_cfg.num_taps * mic_cfg.tap_size;
   rb_copy_tail(&rb_left, out_left_mic, 0, wanted);
   rb_copy_tail(&rb_right, out_right_mic, 0, wanted);
 }
+
+uint64_t mic_captured_samples(void) {
+  portENTER_CRITICAL(&tap_index_mux);
+  uint64_t idx = tap_sample_index;
+  portEXIT_CRITICAL(&tap_index_mux);
+  return idx;
+}
+
+int64_t mic_sample_time_us(uint64_t index) {
+  portENTER_CRITICAL(&tap_index_mux);
+  const sample_clock clk = published_clock;
+  portEXIT_CRITICAL(&tap_index_mux);
+  return sample_clock_time_us(&clk, index);
+}
+
+int64_t mic_sample_unix_us(uint64_t index) {
+  const int64_t t = mic_sample_time_us(index);
+  struct timeval tv;
+  if (t == 0 || gettimeofday(&tv, NULL) != 0 ||
+      tv.tv_sec < MIC_UNIX_VALID_S) {
+    return 0;
+  }
+  const int64_t age_us = esp_timer_get_time() - t;
+  return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - age_us;
+}
+
+// Ring geometry as seen by other tasks; consistent with `head`.
+typedef struct {
+  uint64_t head;
+  uint64_t base;
+  uint64_t retained;
+  uint32_t epoch;
+  rb_struct left, right;
+} ring_state;
+
+static void ring_state_get(ring_state *st) {
+  portENTER_CRITICAL(&tap_index_mux);
+  st->head = tap_sample_index;
+  st->base = ring_base_index;
+  st->retained = (uint64_t)(rb_left.size - mic_cfg.tap_size);
+  st->epoch = config_epoch;
+  st->left = rb_left;
+  st->right = rb_right;
+  portEXIT_CRITICAL(&tap_index_mux);
+}
+
+static bool ring_state_holds(const ring_state *st, uint64_t start_index) {
+  return start_index >= st->base && start_index + st->retained >= st->head;
+}
+
+bool mic_range_retained(uint64_t start_index) {
+  if (!mic_initialized) {
+    return false;
+  }
+  ring_state st;
+  ring_state_get(&st);
+  return ring_state_holds(&st, start_index);
+}
+
+bool mic_snapshot(uint64_t start_index, int length, int16_t *out_left,
+                  int16_t *out_right) {
+  if (!mic_initialized || length <= 0 || !out_left || !out_right) {
+    return false;
+  }
+  ring_state st;
+  ring_state_get(&st);
+  if ((uint64_t)length > st.retained) {
+    return false;
+  }
+  if (start_index + (uint64_t)length > st.head ||
+      !ring_state_holds(&st, start_index)) {
+    return false;
+  }
+
+  // The ring never skips between reconfigurations, so the ring position
+  // follows directly from the absolute index. The copy goes through the
+  // geometry read above: a concurrent reconfiguration retires the storage
+  // without freeing it.
+  const int pos = (int)((start_index - st.base) % (uint64_t)st.left.size);
+  rb_copy_from(&st.left, out_left, pos, length);
+  rb_copy_from(&st.right, out_right, pos, length);
+
+  // The reader may have overwritten the start of the range while we copied;
+  // the writer only touches samples older than (head - retained).
+  ring_state now;
+  ring_state_get(&now);
+  return now.epoch == st.epoch && ring_state_holds(&now, start_index);
+}
@@ -0,0 +1,128 @@
+#include "mic_replay.h"
+
+#include <string.h>
+
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+static uint32_t rd_le32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+static uint16_t rd_le16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+bool mic_replay_parse_wav(const uint8_t *buf, size_t len, mic_replay_wav *out) {
+  if (len < 12 || memcmp(buf, "RIFF", 4) != 0 ||
+      memcmp(buf + 8, "WAVE", 4) != 0) {
+    return false;
+  }
+  bool have_fmt = false;
+  size_t pos = 12;
+  while (pos + 8 <= len) {
+    const uint8_t *chunk = buf + pos;
+    const uint32_t size = rd_le32(chunk + 4);
+    if (memcmp(chunk, "fmt ", 4) == 0) {
+      if (size < 16 || pos + 8 + 16 > len) {
+        return false;
+      }
+      const uint16_t format = rd_le16(chunk + 8);
+      out->channels = rd_le16(chunk + 10);
+      out->sample_rate = (int)rd_le32(chunk + 12);
+      const uint16_t bits = rd_le16(chunk + 22);
+      if ((format != WAV_FORMAT_PCM && format != WAV_FORMAT_EXTENSIBLE) ||
+          bits != 16 || out->channels < 1 || out->channels > 2 ||
+          out->sample_rate <= 0) {
+        return false;
+      }
+      have_fmt = true;
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      if (!have_fmt) {
+        return false;
+      }
+      out->data_offset = (uint32_t)(pos + 8);
+      // 0xFFFFFFFF is the usual "unknown" of a stream header.
+      out->data_bytes = size == 0xFFFFFFFFu ? 0 : size;
+      return true;
+    }
+    // Chunks are padded to even sizes.
+    pos += 8 + (size_t)size + (size & 1);
+  }
+  return false;
+}
+
+void mic_replay_pack_frames(const int16_t *pcm, int channels, int frames,
+                            int32_t *out) {
+  // Frame i is read from bytes [2 * channels * i, +2 * channels) and written
+  // to [8 * i, +8), never below the input still to be read. The reads go
+  // through memcpy so they stay ordered with the writes when both alias.
+  const uint8_t *in = (const uint8_t *)pcm;
+  const size_t stride = (size_t)channels * sizeof(int16_t);
+  for (int i = frames - 1; i >= 0; i--) {
+    int16_t l, r;
+    memcpy(&l, in + stride * (size_t)i, sizeof(l));
+    if (channels == 2) {
+      memcpy(&r, in + stride * (size_t)i + sizeof(l), sizeof(r));
+    } else {
+      r = l;
+    }
+    out[2 * i] = (int32_t)((uint32_t)(uint16_t)r << 16);
+    out[2 * i + 1] = (int32_t)((uint32_t)(uint16_t)l << 16);
+  }
+}
+
+void mic_synth_init(mic_synth *s, int sample_rate, int period_ms, int lag_us,
+                    int peak, int noise, int decay_ms) {
+  memset(s, 0, sizeof(*s));
+  s->period_frames = (uint32_t)((int64_t)sample_rate * period_ms / 1000);
+  if (s->period_frames == 0) {
+    s->period_frames = 1;
+  }
+  s->lag_frames = (uint32_t)((int64_t)sample_rate * lag_us / 1000000);
+  s->lag_frames %= s->period_frames;
+  s->peak = peak;
+  s->noise = noise;
+  // e^(-1/tau) ~ 1 - 1/tau; tau is tens of samples or more.
+  int32_t tau = (int32_t)((int64_t)sample_rate * decay_ms / 1000);
+  tau = tau < 2 ? 2 : tau;
+  s->decay_q15 = 32768 - 32768 / tau;
+  s->seed = 0x2545F491u;
+}
+
+// xorshift32, as a signed 16-bit value.
+static int32_t synth_rand(mic_synth *s) {
+  uint32_t x = s->seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  s->seed = x;
+  return (int16_t)(x >> 16);
+}
+
+static int16_t synth_sample(mic_synth *s, int32_t env) {
+  int32_t v = (s->noise * synth_rand(s)) / 32768;
+  v += (env * synth_rand(s)) / 32768;
+  return (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+}
+
+void mic_synth_fill(mic_synth *s, int32_t *out, int frames) {
+  for (int i = 0; i < frames; i++) {
+    if (s->pos == 0) {
+      s->env_left = s->peak;
+    }
+    if (s->pos == s->lag_frames) {
+      s->env_right = s->peak;
+    }
+    const int16_t l = synth_sample(s, s->env_left);
+    const int16_t r = synth_sample(s, s->env_right);
+    out[2 * i] = (int32_t)((uint32_t)(uint16_t)r << 16);
+    out[2 * i + 1] = (int32_t)((uint32_t)(uint16_t)l << 16);
+    s->env_left = (int32_t)(((int64_t)s->env_left * s->decay_q15) >> 15);
+    s->env_right = (int32_t)(((int64_t)s->env_right * s->decay_q15) >> 15);
+    if (++s->pos >= s->period_frames) {
+      s->pos = 0;
+    }
+  }
+}
@@ -0,0 +1,152 @@
+#include "mic_source.h"
+#include "mic_input.h"
+
+#include "driver/gpio.h"
+#include "driver/i2s_std.h"
+#include "driver/i2s_types.h"
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "MIC_I2S";
+
+i2s_chan_handle_t rx_channel = NULL, tx_channel = NULL;
+static volatile uint32_t dma_overflows = 0;
+// Queue geometry for the next channel created; set_dma() may change it.
+static int dma_desc_num = DMA_DESC_NUM;
+static int dma_frame_num = CHUNK_FRAMES;
+static int channel_rate = 0;
+
+static bool IRAM_ATTR mic_on_recv_q_ovf(i2s_chan_handle_t handle,
+                                        i2s_event_data_t *event,
+                                        void *user_ctx) {
+  (void)handle;
+  (void)event;
+  (void)user_ctx;
+  dma_overflows++;
+  return false;
+}
+
+static esp_err_t i2s_open(int sampling_freq) {
+  i2s_chan_config_t chan_cfg = {
+      .id = I2S_NUM_0,
+      .role = I2S_ROLE_MASTER,
+      .dma_desc_num = dma_desc_num,
+      .dma_frame_num = dma_frame_num,
+      .auto_clear = true,
+  };
+
+  // NOTE: I2S RX was returning zeros unless TX was also enabled, so we
+  // create+enable both channels.
+  // The DMA buffers are allocated here: a failure is reported, not fatal,
+  // so set_dma() can fall back to the queue it replaced.
+  const esp_err_t err = i2s_new_channel(&chan_cfg, &tx_channel, &rx_channel);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "No I2S channel with %d x %d-frame DMA buffers: %s",
+             dma_desc_num, dma_frame_num, esp_err_to_name(err));
+    return err;
+  }
+
+  i2s_std_slot_config_t slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(
+      I2S_DATA_BIT_WIDTH_32BIT, I2S_SLOT_MODE_STEREO);
+  slot_cfg.slot_bit_width = I2S_SLOT_BIT_WIDTH_32BIT;
+  slot_cfg.slot_mask = I2S_STD_SLOT_BOTH;
+
+  i2s_std_config_t std_cfg = {
+      .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(sampling_freq),
+      .slot_cfg = slot_cfg,
+      .gpio_cfg =
+          {
+              .mclk = I2S_GPIO_UNUSED,
+              .bclk = GPIO_NUM_19,
+              .ws = GPIO_NUM_18,
+              .dout = I2S_GPIO_UNUSED,
+              .din = GPIO_NUM_21,
+              .invert_flags =
+                  {
+                      .mclk_inv = false,
+                      .bclk_inv = false,
+                      .ws_inv = false,
+                  },
+          },
+  };
+
+  ESP_ERROR_CHECK(i2s_channel_init_std_mode(tx_channel, &std_cfg));
+  ESP_ERROR_CHECK(i2s_channel_init_std_mode(rx_channel, &std_cfg));
+
+  const i2s_event_callbacks_t rx_cbs = {
+      .on_recv_q_ovf = mic_on_recv_q_ovf,
+  };
+  ESP_ERROR_CHECK(i2s_channel_register_event_callback(rx_channel, &rx_cbs,
+                                                      NULL));
+
+  // keep TX enabled – see note above
+  ESP_ERROR_CHECK(i2s_channel_enable(tx_channel));
+  ESP_ERROR_CHECK(i2s_channel_enable(rx_channel));
+  channel_rate = sampling_freq;
+  ESP_LOGI(TAG, "I2S initialized: %d x %d-frame DMA buffers", dma_desc_num,
+           dma_frame_num);
+  return ESP_OK;
+}
+
+static esp_err_t i2s_set_rate(int sampling_freq) {
+  // The clock can only be changed on a disabled channel; TX is stopped too
+  // because RX depends on it (see i2s_open).
+  ESP_ERROR_CHECK(i2s_channel_disable(rx_channel));
+  ESP_ERROR_CHECK(i2s_channel_disable(tx_channel));
+  const i2s_std_clk_config_t clk_cfg =
+      I2S_STD_CLK_DEFAULT_CONFIG(sampling_freq);
+  ESP_ERROR_CHECK(i2s_channel_reconfig_std_clock(tx_channel, &clk_cfg));
+  ESP_ERROR_CHECK(i2s_channel_reconfig_std_clock(rx_channel, &clk_cfg));
+  ESP_ERROR_CHECK(i2s_channel_enable(tx_channel));
+  ESP_ERROR_CHECK(i2s_channel_enable(rx_channel));
+  channel_rate = sampling_freq;
+  return ESP_OK;
+}
+
+// The driver sizes the DMA queue when the channel is created, so a new
+// geometry takes a new pair of channels; the audio in flight is lost.
+static esp_err_t i2s_set_dma(int desc_num, int frame_num) {
+  if (desc_num == dma_desc_num && frame_num == dma_frame_num) {
+    return ESP_OK;
+  }
+  const int old_desc = dma_desc_num, old_frames = dma_frame_num;
+  dma_desc_num = desc_num;
+  dma_frame_num = frame_num;
+  if (rx_channel == NULL) {
+    return ESP_OK;
+  }
+  ESP_ERROR_CHECK(i2s_channel_disable(rx_channel));
+  ESP_ERROR_CHECK(i2s_channel_disable(tx_channel));
+  ESP_ERROR_CHECK(i2s_del_channel(rx_channel));
+  ESP_ERROR_CHECK(i2s_del_channel(tx_channel));
+  rx_channel = tx_channel = NULL;
+  const esp_err_t err = i2s_open(channel_rate);
+  if (err != ESP_OK) {
+    // The old queue's memory was just freed, so it fits again.
+    dma_desc_num = old_desc;
+    dma_frame_num = old_frames;
+    ESP_ERROR_CHECK(i2s_open(channel_rate));
+  }
+  return err;
+}
+
+static int i2s_read(int32_t *frames, int max_frames) {
+  size_t bytes_rec = 0;
+  i2s_channel_read(rx_channel, (void *)frames, (size_t)max_frames * 8,
+                   &bytes_rec, portMAX_DELAY);
+  return (int)(bytes_rec / 8);
+}
+
+static uint32_t i2s_overflows(void) { return dma_overflows; }
+
+const mic_source mic_source_i2s = {
+    .name = "i2s",
+    .raw = true,
+    .open = i2s_open,
+    .set_rate = i2s_set_rate,
+    .read = i2s_read,
+    .set_dma = i2s_set_dma,
+    .overflows = i2s_overflows,
+};
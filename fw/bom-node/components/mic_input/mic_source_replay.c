@@ -0,0 +1,225 @@
+#include "mic_replay.h"
+#include "mic_source.h"
+#include "mic_input.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+static const char *TAG = "MIC_REPLAY";
+
+// Wait after a missing file or the end of a single pass before read()
+// returns empty, so the reader still applies reconfigurations.
+#define REPLAY_IDLE_MS 1000
+// Pacing falling this far behind (a stall, a reconfiguration) re-anchors
+// instead of catching up with a burst.
+#define REPLAY_RESYNC_US 500000
+// At full speed the reader still sleeps one tick this often, so the idle
+// task feeds the task watchdog.
+#define REPLAY_YIELD_US 1000000
+#define REPLAY_HEADER_PROBE 512
+
+typedef struct {
+  int rate;
+  int64_t anchor_us;
+  uint64_t frames; // since the anchor
+  int64_t last_yield_us;
+} replay_clock;
+
+static void replay_clock_reset(replay_clock *c, int rate) {
+  c->rate = rate;
+  c->anchor_us = esp_timer_get_time();
+  c->frames = 0;
+  c->last_yield_us = c->anchor_us;
+}
+
+// Returns once `frames` more frames would have been captured in real time.
+static void replay_pace(replay_clock *c, int frames) {
+  const int64_t now = esp_timer_get_time();
+#ifdef CONFIG_MIC_SOURCE_MAX_SPEED
+  (void)frames;
+  if (now - c->last_yield_us >= REPLAY_YIELD_US) {
+    c->last_yield_us = now;
+    vTaskDelay(1);
+  }
+#else
+  c->frames += (uint64_t)frames;
+  const int64_t due =
+      c->anchor_us + (int64_t)(c->frames * 1000000ull / (uint64_t)c->rate);
+  if (now - due > REPLAY_RESYNC_US) {
+    replay_clock_reset(c, c->rate);
+    return;
+  }
+  // Whole ticks only; the remainder carries over to the next chunk.
+  const TickType_t ticks =
+      (TickType_t)((due - now) / 1000 / portTICK_PERIOD_MS);
+  if (due > now && ticks > 0) {
+    vTaskDelay(ticks);
+  }
+#endif
+}
+
+// WAV file replay.
+
+static struct {
+  FILE *file;
+  mic_replay_wav info;
+  uint32_t remaining; // bytes left in this pass
+  int rate;
+  bool done;          // single pass finished
+  replay_clock clock;
+  int64_t pass_us;    // start of this pass
+  uint64_t pass_frames;
+  uint32_t passes;
+} wav;
+
+static bool wav_open_file(void) {
+  FILE *f = fopen(CONFIG_MIC_SOURCE_WAV_PATH, "rb");
+  if (!f) {
+    return false;
+  }
+  uint8_t probe[REPLAY_HEADER_PROBE];
+  const size_t got = fread(probe, 1, sizeof(probe), f);
+  if (!mic_replay_parse_wav(probe, got, &wav.info) ||
+      fseek(f, (long)wav.info.data_offset, SEEK_SET) != 0) {
+    ESP_LOGE(TAG, "%s is not a 16-bit PCM WAV file",
+             CONFIG_MIC_SOURCE_WAV_PATH);
+    fclose(f);
+    wav.done = true;
+    return false;
+  }
+  if (wav.info.sample_rate != wav.rate) {
+    ESP_LOGW(TAG, "%s is %d Hz, replayed as %d Hz",
+             CONFIG_MIC_SOURCE_WAV_PATH, wav.info.sample_rate, wav.rate);
+  }
+  ESP_LOGI(TAG, "Replaying %s: %d Hz, %d channel(s)",
+           CONFIG_MIC_SOURCE_WAV_PATH, wav.info.sample_rate,
+           wav.info.channels);
+  wav.file = f;
+  return true;
+}
+
+static void wav_start_pass(void) {
+  wav.remaining = wav.info.data_bytes ? wav.info.data_bytes : UINT32_MAX;
+  wav.pass_us = esp_timer_get_time();
+  wav.pass_frames = 0;
+}
+
+// Logs the pass rate, the pipeline's throughput when replaying at full
+// speed.
+static void wav_end_pass(void) {
+  const int64_t us = esp_timer_get_time() - wav.pass_us;
+  wav.passes++;
+  if (us > 0 && wav.pass_frames > 0) {
+    const double fps = (double)wav.pass_frames * 1e6 / (double)us;
+    ESP_LOGI(TAG, "Pass %" PRIu32 ": %" PRIu64 " frames in %lld ms, %.0f fps "
+             "(%.2fx real time)", wav.passes, wav.pass_frames,
+             (long long)(us / 1000), fps, fps / wav.rate);
+  }
+}
+
+static esp_err_t wav_open(int sampling_freq) {
+  wav.rate = sampling_freq;
+  replay_clock_reset(&wav.clock, sampling_freq);
+  // The file system may not be mounted yet; read() opens the file.
+  return ESP_OK;
+}
+
+static esp_err_t wav_set_rate(int sampling_freq) {
+  wav.rate = sampling_freq;
+  replay_clock_reset(&wav.clock, sampling_freq);
+  return ESP_OK;
+}
+
+static int wav_read(int32_t *frames, int max_frames) {
+  if (wav.done || (!wav.file && !wav_open_file())) {
+    vTaskDelay(pdMS_TO_TICKS(REPLAY_IDLE_MS));
+    return 0;
+  }
+  if (wav.pass_frames == 0 && wav.remaining == 0) {
+    wav_start_pass();
+    replay_clock_reset(&wav.clock, wav.rate);
+  }
+  const size_t frame_bytes = (size_t)wav.info.channels * sizeof(int16_t);
+  size_t want = (size_t)max_frames * frame_bytes;
+  if (want > wav.remaining) {
+    want = wav.remaining - wav.remaining % frame_bytes;
+  }
+  // The 16-bit frames are read into the start of the chunk buffer and
+  // expanded in place.
+  const int got = (int)(fread(frames, 1, want, wav.file) / frame_bytes);
+  if (got == 0) {
+    const bool had_audio = wav.pass_frames > 0;
+    wav_end_pass();
+    wav.remaining = 0;
+    wav.pass_frames = 0;
+#ifdef CONFIG_MIC_SOURCE_WAV_LOOP
+    // A file without audio would spin here instead.
+    if (had_audio &&
+        fseek(wav.file, (long)wav.info.data_offset, SEEK_SET) == 0) {
+      return 0;
+    }
+#else
+    (void)had_audio;
+#endif
+    ESP_LOGI(TAG, "Replay finished");
+    fclose(wav.file);
+    wav.file = NULL;
+    wav.done = true;
+    return 0;
+  }
+  wav.remaining -= (uint32_t)got * frame_bytes;
+  wav.pass_frames += (uint64_t)got;
+  mic_replay_pack_frames((const int16_t *)frames, wav.info.channels, got,
+                         frames);
+  replay_pace(&wav.clock, got);
+  return got;
+}
+
+const mic_source mic_source_wav = {
+    .name = "wav",
+    .open = wav_open,
+    .set_rate = wav_set_rate,
+    .read = wav_read,
+    .overflows = NULL,
+};
+
+// Synthetic impulses.
+
+static mic_synth synth;
+static replay_clock synth_clock;
+
+static esp_err_t synth_set_rate(int sampling_freq) {
+  mic_synth_init(&synth, sampling_freq, CONFIG_MIC_SOURCE_SYNTH_PERIOD_MS,
+                 CONFIG_MIC_SOURCE_SYNTH_LAG_US, CONFIG_MIC_SOURCE_SYNTH_PEAK,
+                 CONFIG_MIC_SOURCE_SYNTH_NOISE,
+                 CONFIG_MIC_SOURCE_SYNTH_DECAY_MS);
+  replay_clock_reset(&synth_clock, sampling_freq);
+  return ESP_OK;
+}
+
+static esp_err_t synth_open(int sampling_freq) {
+  ESP_LOGI(TAG, "Synthetic impulses every %d ms",
+           CONFIG_MIC_SOURCE_SYNTH_PERIOD_MS);
+  return synth_set_rate(sampling_freq);
+}
+
+static int synth_read(int32_t *frames, int max_frames) {
+  mic_synth_fill(&synth, frames, max_frames);
+  replay_pace(&synth_clock, max_frames);
+  return max_frames;
+}
+
+const mic_source mic_source_synth = {
+    .name = "synth",
+    .open = synth_open,
+    .set_rate = synth_set_rate,
+    .read = synth_read,
+    .overflows = NULL,
+};
@@ -3,35 +3,108 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+
+static int rb_mask_for(int samples) {
+  return (samples > 0 && (samples & (samples - 1)) == 0) ? samples - 1 : 0;
+}
+
+static inline int rb_wrap(const rb_struct *rb, int idx) {
+  if (rb->mask) {
+    return idx & rb->mask;
+  }
+  return idx >= rb->size ? idx - rb->size : idx;
+}
 
 void rb_init(rb_struct *rb, int samples) {
   rb->data = (int16_t *)calloc(samples, sizeof(int16_t));
   assert(rb->data != NULL);
   rb->size = samples;
   rb->head = 0;
+  rb->mask = rb_mask_for(samples);
+  rb->owned = true;
+}
+
+void rb_init_pow2(rb_struct *rb, int samples) {
+  int size = 1;
+  while (size < samples) {
+    size <<= 1;
+  }
+  rb_init(rb, size);
+}
+
+void rb_attach(rb_struct *rb, int16_t *storage, int samples) {
+  assert(storage != NULL);
+  rb->data = storage;
+  rb->size = samples;
+  rb->head = 0;
+  rb->mask = rb_mask_for(samples);
+  rb->owned = false;
 }
 
 void rb_free(rb_struct *rb) {
   if (rb->data) {
-    free(rb->data);
+    if (rb->owned) {
+      free(rb->data);
+    }
     rb->data = NULL;
     rb->size = 0;
     rb->head = 0;
+    rb->mask = 0;
   }
 }
 
 void rb_push(rb_struct *rb, int16_t value) {
   rb->data[rb->head] = value;
-  rb->head++;
-  if (rb->head >= rb->size) {
-    rb->head = 0;
+  rb->head = rb_wrap(rb, rb->head + 1);
+}
+
+void rb_push_block(rb_struct *rb, const int16_t *src, int count) {
+  if (count <= 0) {
+    return;
+  }
+  if (count > rb->size) {
+    src += count - rb->size;
+    count = rb->size;
+  }
+  int first = rb->size - rb->head;
+  if (first > count) {
+    first = count;
   }
+  memcpy(&rb->data[rb->head], src, first * sizeof(int16_t));
+  if (count > first) {
+    memcpy(rb->data, src + first, (count - first) * sizeof(int16_t));
+  }
+  rb->head = rb_wrap(rb, rb->head + count);
+}
+
+void rb_commit(rb_struct *rb, int count) {
+  assert(count >= 0 && count <= rb->size - rb->head);
+  rb->head = rb_wrap(rb, rb->head + count);
 }
 
 void rb_copy_tail(const rb_struct *rb, int16_t *out_arr, int offset,
                   int count) {
-  int start = ((rb->head - offset - count) % rb->size + rb->size) % rb->size;
-  for (int i = 0; i < count; i++) {
-    out_arr[i] = rb->data[(start + i) % rb->size];
+  assert(offset >= 0 && count >= 0 && offset + count <= rb->size);
+  int start = rb->head - offset - count;
+  if (start < 0) {
+    start += rb->size;
+  }
+  rb_copy_from(rb, out_arr, start, count);
+}
+
+void rb_copy_from(const rb_struct *rb, int16_t *out_arr, int start,
+                  int count) {
+  assert(start >= 0 && start < rb->size && count <= rb->size);
+  if (count <= 0) {
+    return;
+  }
+  int first = rb->size - start;
+  if (first > count) {
+    first = count;
+  }
+  memcpy(out_arr, &rb->data[start], first * sizeof(int16_t));
+  if (count > first) {
+    memcpy(out_arr + first, rb->data, (count - first) * sizeof(int16_t));
   }
 }
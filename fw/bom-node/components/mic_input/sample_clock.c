@@ -0,0 +1,93 @@
+#include "sample_clock.h"
+
+#include <string.h>
+
+// Per-window loop gains: a quarter of the phase error is removed each window.
+// The period gain starts high so the first windows acquire the drift quickly,
+// then decays to a floor that averages the arrival jitter over ~100 windows.
+#define SAMPLE_CLOCK_KP 0.25
+#define SAMPLE_CLOCK_KI_START 0.5
+#define SAMPLE_CLOCK_KI_MIN 0.01
+
+void sample_clock_reset(sample_clock *clk, double sample_rate) {
+  memset(clk, 0, sizeof(*clk));
+  clk->nominal_us = sample_rate > 0.0 ? 1e6 / sample_rate : 0.0;
+  clk->period_us = clk->nominal_us;
+}
+
+void sample_clock_unlock(sample_clock *clk) {
+  if (clk->anchored) {
+    clk->relocks++;
+  }
+  clk->anchored = false;
+  clk->windows = 0;
+}
+
+static inline double predict(const sample_clock *clk, uint64_t index) {
+  // Signed: indices before the anchor map to earlier times.
+  const double d = (double)(int64_t)(index - clk->anchor_index);
+  return clk->anchor_us + d * clk->period_us;
+}
+
+static void anchor(sample_clock *clk, uint64_t index, double us) {
+  clk->anchor_index = index;
+  clk->anchor_us = us;
+  clk->anchored = true;
+  clk->window_n = 0;
+  clk->window_min_us = 0.0;
+}
+
+void sample_clock_update(sample_clock *clk, uint64_t index, int64_t now_us) {
+  if (clk->period_us <= 0.0) {
+    return;
+  }
+  const bool anchored = clk->anchored;
+  const double err = (double)now_us - predict(clk, index);
+  if (!anchored || err > SAMPLE_CLOCK_RELOCK_US ||
+      err < -SAMPLE_CLOCK_RELOCK_US) {
+    if (anchored) {
+      clk->relocks++;
+    }
+    clk->windows = 0;
+    anchor(clk, index, (double)now_us);
+    return;
+  }
+
+  if (clk->window_n == 0 || err < clk->window_min_us) {
+    clk->window_min_us = err;
+  }
+  if (++clk->window_n < SAMPLE_CLOCK_WINDOW) {
+    return;
+  }
+
+  // The window's earliest arrival stands in for the true capture time. The
+  // phase moves to the current index first, so the period step does not
+  // shift times already handed out by more than the correction itself.
+  const double span = (double)(int64_t)(index - clk->anchor_index);
+  const double e = clk->window_min_us;
+  const double base = predict(clk, index);
+  if (span > 0.0) {
+    double ki = SAMPLE_CLOCK_KI_START / (1 + clk->windows);
+    if (ki < SAMPLE_CLOCK_KI_MIN) {
+      ki = SAMPLE_CLOCK_KI_MIN;
+    }
+    double period = clk->period_us + ki * e / span;
+    const double limit = clk->nominal_us * SAMPLE_CLOCK_MAX_PPM * 1e-6;
+    if (period > clk->nominal_us + limit) {
+      period = clk->nominal_us + limit;
+    } else if (period < clk->nominal_us - limit) {
+      period = clk->nominal_us - limit;
+    }
+    clk->period_us = period;
+  }
+  anchor(clk, index, base + SAMPLE_CLOCK_KP * e);
+  clk->windows++;
+}
+
+int64_t sample_clock_time_us(const sample_clock *clk, uint64_t index) {
+  if (!clk->anchored) {
+    return 0;
+  }
+  const double t = predict(clk, index);
+  return (int64_t)(t >= 0.0 ? t + 0.5 : t - 0.5);
+}
@@ -0,0 +1,95 @@
+#include "spsc_queue.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Capacity rounded up to a power of two, 0 if it cannot be.
+static uint32_t spsc_round_capacity(size_t elem_size, uint32_t capacity) {
+  if (elem_size == 0 || capacity == 0 || capacity > (UINT32_MAX >> 1) + 1) {
+    return 0;
+  }
+  uint32_t cap = 1;
+  while (cap < capacity) {
+    cap <<= 1;
+  }
+  return cap;
+}
+
+static void spsc_setup(spsc_queue *q, uint8_t *slots, size_t elem_size,
+                       uint32_t cap, bool owned) {
+  q->slots = slots;
+  q->elem_size = elem_size;
+  q->mask = cap - 1;
+  q->owned = owned;
+  atomic_init(&q->head, 0);
+  atomic_init(&q->tail, 0);
+}
+
+bool spsc_init(spsc_queue *q, size_t elem_size, uint32_t capacity) {
+  const uint32_t cap = spsc_round_capacity(elem_size, capacity);
+  if (q == NULL || cap == 0) {
+    return false;
+  }
+  uint8_t *slots = (uint8_t *)calloc(cap, elem_size);
+  if (slots == NULL) {
+    return false;
+  }
+  spsc_setup(q, slots, elem_size, cap, true);
+  return true;
+}
+
+size_t spsc_storage_bytes(size_t elem_size, uint32_t capacity) {
+  return (size_t)spsc_round_capacity(elem_size, capacity) * elem_size;
+}
+
+bool spsc_attach(spsc_queue *q, size_t elem_size, uint32_t capacity,
+                 void *storage) {
+  const uint32_t cap = spsc_round_capacity(elem_size, capacity);
+  if (q == NULL || storage == NULL || cap == 0) {
+    return false;
+  }
+  spsc_setup(q, (uint8_t *)storage, elem_size, cap, false);
+  return true;
+}
+
+void spsc_free(spsc_queue *q) {
+  if (q->owned) {
+    free(q->slots);
+  }
+  q->slots = NULL;
+  q->mask = 0;
+  atomic_store(&q->head, 0);
+  atomic_store(&q->tail, 0);
+}
+
+bool spsc_push(spsc_queue *q, const void *elem) {
+  uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+  uint32_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+  if (head - tail > q->mask) {
+    return false;
+  }
+  memcpy(&q->slots[(size_t)(head & q->mask) * q->elem_size], elem,
+         q->elem_size);
+  // Publishes the slot contents before the consumer can see the new head.
+  atomic_store_explicit(&q->head, head + 1, memory_order_release);
+  return true;
+}
+
+bool spsc_pop(spsc_queue *q, void *elem) {
+  uint32_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  uint32_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+  if (head == tail) {
+    return false;
+  }
+  memcpy(elem, &q->slots[(size_t)(tail & q->mask) * q->elem_size],
+         q->elem_size);
+  // Hands the slot back to the producer only after it has been copied out.
+  atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+  return true;
+}
+
+uint32_t spsc_count(spsc_queue *q) {
+  uint32_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+  uint32_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+  return head - tail;
+}
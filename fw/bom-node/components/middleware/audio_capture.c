@@ -1,21 +1,85 @@
 #include "audio_capture.h"
 
 #include "audio_config.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+#include "median_detection.h"
+#include "mic_history.h"
 #include "mic_input.h"
 
-void audio_capture_init(void) {
-    audio_config_t audio_cfg = audio_config_get();
+static const char* TAG = "AUDIO_CAPTURE";
+
+static mic_dc_offset s_dc_pending;
+static portMUX_TYPE s_dc_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static mic_config audio_capture_mic_config(int rate) {
+    // Keep the tap duration of the default geometry, snapped to a specialised
+    // detector instance when one is close enough.
     mic_config mic_cfg = {
-        .sampling_freq = audio_cfg.sampling_rate > 0 ? audio_cfg.sampling_rate
-                                                     : MIC_SAMPLING_FREQUENCY,
+        .sampling_freq = rate,
         .pre_event_ms = MIC_PRE_EVENT_MS,
         .post_event_ms = MIC_POST_EVENT_MS,
         .num_taps = MIC_DEFAULT_NUM_TAPS,
-        .tap_size = MIC_DEFAULT_TAP_SIZE,
+        .tap_size = impulse_tap_size_for_rate(rate, MIC_SAMPLING_FREQUENCY,
+                                              MIC_DEFAULT_TAP_SIZE,
+                                              MIC_DEFAULT_NUM_TAPS),
     };
+    return mic_cfg;
+}
+
+// Runs on the timer service task, away from the mic reader: NVS writes stall
+// on flash.
+static void audio_capture_store_dc(void* arg, uint32_t unused) {
+    (void)arg;
+    (void)unused;
+    portENTER_CRITICAL(&s_dc_mux);
+    mic_dc_offset off = s_dc_pending;
+    portEXIT_CRITICAL(&s_dc_mux);
+
+    esp_err_t err = audio_config_set_dc_offset(off.left, off.right);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to store DC offset: %s", esp_err_to_name(err));
+    }
+}
+
+static void audio_capture_on_dc(const mic_dc_offset* off, void* ctx) {
+    (void)ctx;
+    portENTER_CRITICAL(&s_dc_mux);
+    s_dc_pending = *off;
+    portEXIT_CRITICAL(&s_dc_mux);
+    // A full timer queue only delays the write to the next notification.
+    xTimerPendFunctionCall(audio_capture_store_dc, NULL, 0, 0);
+}
+
+void audio_capture_init(void) {
+    audio_config_t audio_cfg;
+    audio_config_get(&audio_cfg);
+    int rate = audio_cfg.sampling_rate > 0 ? audio_cfg.sampling_rate
+                                           : MIC_SAMPLING_FREQUENCY;
+    mic_config mic_cfg = audio_capture_mic_config(rate);
     mic_init(&mic_cfg);
+    // Subscribed before the reader starts, so the history has no gap at its
+    // start; the event clips beyond the detector window are read from it.
+    mic_history_start();
+
+    int16_t dc_left = 0;
+    int16_t dc_right = 0;
+    if (audio_config_get_dc_offset(&dc_left, &dc_right) == ESP_OK) {
+        ESP_LOGI(TAG, "Restored DC offset: L %d, R %d", dc_left, dc_right);
+        mic_set_dc_offset(dc_left, dc_right);
+    }
+    mic_set_dc_listener(audio_capture_on_dc, NULL);
 }
 
 void audio_capture_start(void) {
     mic_start();
 }
+
+esp_err_t audio_capture_set_rate(int rate) {
+    if (rate <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    mic_config mic_cfg = audio_capture_mic_config(rate);
+    return mic_reconfigure(&mic_cfg);
+}
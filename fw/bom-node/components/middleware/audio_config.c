@@ -1,17 +1,51 @@
 #include "audio_config.h"
 
 #include <string.h>
+#include "esp_log.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/timers.h"
 #include "nvs.h"
 
 #define AUDIO_NVS_NAMESPACE "audio"
 #define AUDIO_NVS_MODE      "mode"
 #define AUDIO_NVS_URL       "upload_url"
+#define AUDIO_NVS_FORMAT    "format"
+#define AUDIO_NVS_CHANNELS  "channels"
+#define AUDIO_NVS_DECIM     "decimation"
 #define AUDIO_NVS_ENABLED   "enabled"
 #define AUDIO_NVS_RATE      "sample_rate"
+#define AUDIO_NVS_DC_LEFT   "dc_left"
+#define AUDIO_NVS_DC_RIGHT  "dc_right"
+
+// Setting a burst of values costs one commit this long after the last.
+#define AUDIO_NVS_COMMIT_DELAY_MS 2000
+
+static const char* TAG = "AUDIO_CONFIG";
+
+typedef struct
+{
+    audio_config_listener cb;
+    void* ctx;
+} audio_config_listener_slot_t;
 
 static bool s_audio_config_initialized = false;
 static audio_config_t s_audio_config = {0};
+static uint32_t s_generation = 0;
+static uint32_t s_dirty = 0; // fields not yet in NVS
+// s_lock guards the RAM copy and is only held for copies; s_write_lock
+// orders setters, their notifications and NVS writes.
+static SemaphoreHandle_t s_lock = NULL;
+static SemaphoreHandle_t s_write_lock = NULL;
+static TimerHandle_t s_commit_timer = NULL;
+static audio_config_listener_slot_t s_listeners[AUDIO_CONFIG_MAX_LISTENERS];
+static int s_listener_count = 0;
+
+static void audio_config_commit_cb(TimerHandle_t timer);
+static void audio_config_shutdown(void);
 
+// The first call comes from app_main before any other task exists.
 static void audio_config_load(void)
 {
     if (s_audio_config_initialized)
@@ -22,6 +56,9 @@ static void audio_config_load(void)
     memset(&s_audio_config, 0, sizeof(s_audio_config));
     strncpy(s_audio_config.mode, "disabled", sizeof(s_audio_config.mode) - 1);
     s_audio_config.upload_url[0] = '\0';
+    strncpy(s_audio_config.format, "pcm", sizeof(s_audio_config.format) - 1);
+    strncpy(s_audio_config.channels, "stereo", sizeof(s_audio_config.channels) - 1);
+    s_audio_config.decimation = 1;
     s_audio_config.enabled = false;
     s_audio_config.sampling_rate = 44100;
 
@@ -40,6 +77,24 @@ static void audio_config_load(void)
             s_audio_config.upload_url[0] = '\0';
         }
 
+        size_t format_len = sizeof(s_audio_config.format);
+        if (nvs_get_str(handle, AUDIO_NVS_FORMAT, s_audio_config.format, &format_len) != ESP_OK)
+        {
+            strncpy(s_audio_config.format, "pcm", sizeof(s_audio_config.format) - 1);
+        }
+
+        size_t channels_len = sizeof(s_audio_config.channels);
+        if (nvs_get_str(handle, AUDIO_NVS_CHANNELS, s_audio_config.channels, &channels_len) != ESP_OK)
+        {
+            strncpy(s_audio_config.channels, "stereo", sizeof(s_audio_config.channels) - 1);
+        }
+
+        uint8_t decimation = 0;
+        if (nvs_get_u8(handle, AUDIO_NVS_DECIM, &decimation) == ESP_OK && decimation > 0)
+        {
+            s_audio_config.decimation = decimation;
+        }
+
         uint8_t enabled = 0;
         if (nvs_get_u8(handle, AUDIO_NVS_ENABLED, &enabled) == ESP_OK)
         {
@@ -57,31 +112,84 @@ static void audio_config_load(void)
         nvs_close(handle);
     }
 
+    s_lock = xSemaphoreCreateMutex();
+    s_write_lock = xSemaphoreCreateMutex();
+    s_commit_timer = xTimerCreate("audio_cfg", pdMS_TO_TICKS(AUDIO_NVS_COMMIT_DELAY_MS), pdFALSE,
+                                  NULL, audio_config_commit_cb);
+    if (!s_commit_timer)
+    {
+        ESP_LOGW(TAG, "No commit timer, settings are written at once");
+    }
+    esp_register_shutdown_handler(audio_config_shutdown);
     s_audio_config_initialized = true;
 }
 
-audio_config_t audio_config_get(void)
+void audio_config_init(void)
 {
     audio_config_load();
-    return s_audio_config;
 }
 
-esp_err_t audio_config_set(const audio_config_t* config)
+uint32_t audio_config_get(audio_config_t* out)
 {
-    if (!config)
+    audio_config_load();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (out)
     {
-        return ESP_ERR_INVALID_ARG;
+        *out = s_audio_config;
     }
+    const uint32_t generation = s_generation;
+    xSemaphoreGive(s_lock);
+    return generation;
+}
 
-    audio_config_load();
-    strncpy(s_audio_config.mode, config->mode, sizeof(s_audio_config.mode) - 1);
-    s_audio_config.mode[sizeof(s_audio_config.mode) - 1] = '\0';
-    strncpy(s_audio_config.upload_url, config->upload_url,
-            sizeof(s_audio_config.upload_url) - 1);
-    s_audio_config.upload_url[sizeof(s_audio_config.upload_url) - 1] = '\0';
-    s_audio_config.enabled = config->enabled;
-    s_audio_config.sampling_rate = config->sampling_rate;
+uint32_t audio_config_generation(void)
+{
+    return audio_config_get(NULL);
+}
+
+static void copy_str(char* dst, const char* src, size_t size)
+{
+    strncpy(dst, src, size - 1);
+    dst[size - 1] = '\0';
+}
+
+static uint32_t audio_config_diff(const audio_config_t* a, const audio_config_t* b)
+{
+    uint32_t changed = 0;
+    if (strcmp(a->mode, b->mode) != 0)
+    {
+        changed |= AUDIO_CONFIG_MODE;
+    }
+    if (strcmp(a->upload_url, b->upload_url) != 0)
+    {
+        changed |= AUDIO_CONFIG_UPLOAD_URL;
+    }
+    if (strcmp(a->format, b->format) != 0)
+    {
+        changed |= AUDIO_CONFIG_FORMAT;
+    }
+    if (strcmp(a->channels, b->channels) != 0)
+    {
+        changed |= AUDIO_CONFIG_CHANNELS;
+    }
+    if (a->decimation != b->decimation)
+    {
+        changed |= AUDIO_CONFIG_DECIMATION;
+    }
+    if (a->enabled != b->enabled)
+    {
+        changed |= AUDIO_CONFIG_ENABLED;
+    }
+    if (a->sampling_rate != b->sampling_rate)
+    {
+        changed |= AUDIO_CONFIG_SAMPLING_RATE;
+    }
+    return changed;
+}
 
+// Writes the keys of `fields` from `cfg` and commits them.
+static esp_err_t audio_config_write(const audio_config_t* cfg, uint32_t fields)
+{
     nvs_handle_t handle;
     esp_err_t err = nvs_open(AUDIO_NVS_NAMESPACE, NVS_READWRITE, &handle);
     if (err != ESP_OK)
@@ -89,18 +197,33 @@ esp_err_t audio_config_set(const audio_config_t* config)
         return err;
     }
 
-    err = nvs_set_str(handle, AUDIO_NVS_MODE, s_audio_config.mode);
-    if (err == ESP_OK)
+    if (err == ESP_OK && (fields & AUDIO_CONFIG_MODE))
     {
-        err = nvs_set_str(handle, AUDIO_NVS_URL, s_audio_config.upload_url);
+        err = nvs_set_str(handle, AUDIO_NVS_MODE, cfg->mode);
     }
-    if (err == ESP_OK)
+    if (err == ESP_OK && (fields & AUDIO_CONFIG_UPLOAD_URL))
     {
-        err = nvs_set_u8(handle, AUDIO_NVS_ENABLED, s_audio_config.enabled ? 1 : 0);
+        err = nvs_set_str(handle, AUDIO_NVS_URL, cfg->upload_url);
     }
-    if (err == ESP_OK)
+    if (err == ESP_OK && (fields & AUDIO_CONFIG_FORMAT))
+    {
+        err = nvs_set_str(handle, AUDIO_NVS_FORMAT, cfg->format);
+    }
+    if (err == ESP_OK && (fields & AUDIO_CONFIG_CHANNELS))
+    {
+        err = nvs_set_str(handle, AUDIO_NVS_CHANNELS, cfg->channels);
+    }
+    if (err == ESP_OK && (fields & AUDIO_CONFIG_DECIMATION))
+    {
+        err = nvs_set_u8(handle, AUDIO_NVS_DECIM, (uint8_t)cfg->decimation);
+    }
+    if (err == ESP_OK && (fields & AUDIO_CONFIG_ENABLED))
     {
-        err = nvs_set_i32(handle, AUDIO_NVS_RATE, s_audio_config.sampling_rate);
+        err = nvs_set_u8(handle, AUDIO_NVS_ENABLED, cfg->enabled ? 1 : 0);
+    }
+    if (err == ESP_OK && (fields & AUDIO_CONFIG_SAMPLING_RATE))
+    {
+        err = nvs_set_i32(handle, AUDIO_NVS_RATE, cfg->sampling_rate);
     }
     if (err == ESP_OK)
     {
@@ -110,19 +233,180 @@ esp_err_t audio_config_set(const audio_config_t* config)
     return err;
 }
 
-bool audio_config_is_configured(void)
+esp_err_t audio_config_flush(void)
+{
+    audio_config_load();
+    xSemaphoreTake(s_write_lock, portMAX_DELAY);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const audio_config_t cfg = s_audio_config;
+    const uint32_t fields = s_dirty;
+    s_dirty = 0;
+    xSemaphoreGive(s_lock);
+
+    esp_err_t err = ESP_OK;
+    if (fields)
+    {
+        err = audio_config_write(&cfg, fields);
+        if (err != ESP_OK)
+        {
+            // Kept for the next change or flush.
+            ESP_LOGE(TAG, "Failed to store audio config: %s", esp_err_to_name(err));
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            s_dirty |= fields;
+            xSemaphoreGive(s_lock);
+        }
+    }
+    xSemaphoreGive(s_write_lock);
+    return err;
+}
+
+// Runs on the timer service task, away from the HTTP handlers.
+static void audio_config_commit_cb(TimerHandle_t timer)
+{
+    (void)timer;
+    audio_config_flush();
+}
+
+static void audio_config_shutdown(void)
+{
+    audio_config_flush();
+}
+
+esp_err_t audio_config_set(const audio_config_t* config)
+{
+    if (!config)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_config_load();
+    audio_config_t next = *config;
+    copy_str(next.mode, config->mode, sizeof(next.mode));
+    copy_str(next.upload_url, config->upload_url, sizeof(next.upload_url));
+    copy_str(next.format, config->format, sizeof(next.format));
+    copy_str(next.channels, config->channels, sizeof(next.channels));
+    next.decimation = config->decimation > 0 ? config->decimation : 1;
+
+    xSemaphoreTake(s_write_lock, portMAX_DELAY);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const uint32_t changed = audio_config_diff(&s_audio_config, &next);
+    if (changed)
+    {
+        s_audio_config = next;
+        s_generation++;
+        s_dirty |= changed;
+    }
+    const int listener_count = s_listener_count;
+    xSemaphoreGive(s_lock);
+
+    if (changed)
+    {
+        for (int i = 0; i < listener_count; i++)
+        {
+            s_listeners[i].cb(&next, changed, s_listeners[i].ctx);
+        }
+    }
+    xSemaphoreGive(s_write_lock);
+
+    if (!changed)
+    {
+        return ESP_OK;
+    }
+    if (s_commit_timer && xTimerReset(s_commit_timer, 0) == pdPASS)
+    {
+        return ESP_OK;
+    }
+    return audio_config_flush();
+}
+
+bool audio_config_subscribe(audio_config_listener cb, void* ctx)
 {
+    if (!cb)
+    {
+        return false;
+    }
     audio_config_load();
-    if (strcmp(s_audio_config.mode, "pull") == 0)
+    bool added = false;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_listener_count < AUDIO_CONFIG_MAX_LISTENERS)
+    {
+        s_listeners[s_listener_count].cb = cb;
+        s_listeners[s_listener_count].ctx = ctx;
+        s_listener_count++;
+        added = true;
+    }
+    xSemaphoreGive(s_lock);
+    return added;
+}
+
+bool audio_config_is_configured(void)
+{
+    audio_config_t cfg;
+    audio_config_get(&cfg);
+    if (strcmp(cfg.mode, "pull") == 0)
     {
-        return s_audio_config.enabled;
+        return cfg.enabled;
     }
-    if ((strcmp(s_audio_config.mode, "push") == 0) ||
-        (strcmp(s_audio_config.mode, "http") == 0) ||
-        (strcmp(s_audio_config.mode, "http_push") == 0) ||
-        (strcmp(s_audio_config.mode, "http_stream") == 0))
+    if ((strcmp(cfg.mode, "push") == 0) ||
+        (strcmp(cfg.mode, "http") == 0) ||
+        (strcmp(cfg.mode, "http_push") == 0) ||
+        (strcmp(cfg.mode, "http_stream") == 0) ||
+        (strcmp(cfg.mode, "events") == 0) ||
+        (strcmp(cfg.mode, "rtp") == 0))
     {
-        return s_audio_config.upload_url[0] != '\0';
+        return cfg.upload_url[0] != '\0';
     }
     return false;
 }
+
+esp_err_t audio_config_get_dc_offset(int16_t* left, int16_t* right)
+{
+    if (!left || !right)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(AUDIO_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    int16_t l = 0;
+    int16_t r = 0;
+    err = nvs_get_i16(handle, AUDIO_NVS_DC_LEFT, &l);
+    if (err == ESP_OK)
+    {
+        err = nvs_get_i16(handle, AUDIO_NVS_DC_RIGHT, &r);
+    }
+    nvs_close(handle);
+    if (err == ESP_OK)
+    {
+        *left = l;
+        *right = r;
+    }
+    return err;
+}
+
+esp_err_t audio_config_set_dc_offset(int16_t left, int16_t right)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(AUDIO_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    err = nvs_set_i16(handle, AUDIO_NVS_DC_LEFT, left);
+    if (err == ESP_OK)
+    {
+        err = nvs_set_i16(handle, AUDIO_NVS_DC_RIGHT, right);
+    }
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
@@ -1,5 +1,7 @@
 #include "audio_wav.h"
 
+#include <inttypes.h>
+#include <stdio.h>
 #include <string.h>
 
 static void write_le16(uint8_t *dst, uint16_t val) {
@@ -14,15 +16,37 @@ static void write_le32(uint8_t *dst, uint32_t val) {
     dst[3] = (uint8_t)((val >> 24) & 0xff);
 }
 
-enum { AUDIO_WAV_CHANNELS = 2 };
+enum { AUDIO_WAV_CLIP_CHANNELS = 2 };
 
-void audio_wav_build_header(uint8_t *out, int sample_rate) {
-    const uint16_t num_channels = AUDIO_WAV_CHANNELS;
+// Fixed size, so the header length does not depend on the values: "LIST",
+// size, "INFO", "ICMT", size, NUL-padded text.
+#define STAMP_TEXT_BYTES (AUDIO_WAV_STAMP_BYTES - 20)
+
+static size_t put_stamp(uint8_t *out, const audio_wav_stamp *stamp) {
+    if (!stamp) {
+        return 0;
+    }
+    memcpy(out, "LIST", 4);
+    write_le32(out + 4, AUDIO_WAV_STAMP_BYTES - 8);
+    memcpy(out + 8, "INFO", 4);
+    memcpy(out + 12, "ICMT", 4);
+    write_le32(out + 16, STAMP_TEXT_BYTES);
+    char text[STAMP_TEXT_BYTES] = {0};
+    snprintf(text, sizeof(text),
+             "sample=%" PRIu64 " uptime_us=%" PRId64 " unix_us=%" PRId64,
+             stamp->sample_index, stamp->uptime_us, stamp->unix_us);
+    memcpy(out + 20, text, sizeof(text));
+    return AUDIO_WAV_STAMP_BYTES;
+}
+
+static size_t build_pcm_header(uint8_t *out, int sample_rate, int channels,
+                               uint32_t data_size, const audio_wav_stamp *stamp) {
+    const uint16_t num_channels = (uint16_t)channels;
     const uint16_t bits_per_sample = 16;
     const uint32_t byte_rate = sample_rate * num_channels * bits_per_sample / 8;
     const uint16_t block_align = num_channels * bits_per_sample / 8;
-    const uint32_t data_size = 0xffffffff;
-    const uint32_t riff_size = data_size + 36;
+    const size_t extra = put_stamp(out + 36, stamp);
+    const uint32_t riff_size = data_size + 36 + extra;
 
     memcpy(out, "RIFF", 4);
     write_le32(out + 4, riff_size);
@@ -35,6 +59,56 @@ void audio_wav_build_header(uint8_t *out, int sample_rate) {
     write_le32(out + 28, byte_rate);
     write_le16(out + 32, block_align);
     write_le16(out + 34, bits_per_sample);
-    memcpy(out + 36, "data", 4);
-    write_le32(out + 40, data_size);
+    memcpy(out + 36 + extra, "data", 4);
+    write_le32(out + 40 + extra, data_size);
+    return AUDIO_WAV_HEADER_BYTES + extra;
+}
+
+size_t audio_wav_build_header(uint8_t *out, int sample_rate, int channels,
+                              const audio_wav_stamp *stamp) {
+    return build_pcm_header(out, sample_rate, channels, 0xffffffff, stamp);
+}
+
+void audio_wav_build_clip_header(uint8_t *out, int sample_rate, uint32_t frames) {
+    build_pcm_header(out, sample_rate, AUDIO_WAV_CLIP_CHANNELS,
+                     frames * AUDIO_WAV_CLIP_CHANNELS * sizeof(int16_t), NULL);
+}
+
+size_t audio_wav_build_adpcm_header(uint8_t *out, int sample_rate,
+                                    int channels, uint16_t block_align,
+                                    uint16_t samples_per_block,
+                                    const audio_wav_stamp *stamp) {
+    const uint16_t num_channels = (uint16_t)channels;
+    const uint32_t byte_rate =
+        (uint32_t)((uint64_t)sample_rate * block_align / samples_per_block);
+    // Unknown length for a live stream, as in the PCM header.
+    const uint32_t data_size = 0xffffffff;
+    const size_t extra = put_stamp(out + 52, stamp);
+    const uint32_t riff_size = data_size + 52 + extra;
+
+    memcpy(out, "RIFF", 4);
+    write_le32(out + 4, riff_size);
+    memcpy(out + 8, "WAVE", 4);
+    memcpy(out + 12, "fmt ", 4);
+    write_le32(out + 16, 20);
+    write_le16(out + 20, 0x11);
+    write_le16(out + 22, num_channels);
+    write_le32(out + 24, (uint32_t)sample_rate);
+    write_le32(out + 28, byte_rate);
+    write_le16(out + 32, block_align);
+    write_le16(out + 34, 4);
+    write_le16(out + 36, 2);
+    write_le16(out + 38, samples_per_block);
+    memcpy(out + 40, "fact", 4);
+    write_le32(out + 44, 4);
+    write_le32(out + 48, 0xffffffff);
+    memcpy(out + 52 + extra, "data", 4);
+    write_le32(out + 56 + extra, data_size);
+    return AUDIO_WAV_ADPCM_HEADER_BYTES + extra;
+}
+
+void audio_wav_patch_pcm_sizes(uint8_t *header, size_t header_len,
+                               uint32_t data_size) {
+    write_le32(header + 4, (uint32_t)(header_len - 8) + data_size);
+    write_le32(header + header_len - 4, data_size);
 }
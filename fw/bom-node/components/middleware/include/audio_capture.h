@@ -1,4 +1,12 @@
 #pragma once
 
+#include "esp_err.h"
+
+// Initialises the microphone at the stored sampling rate and restores the DC
+// offset of the last calibration; new calibrations are written back to NVS.
 void audio_capture_init(void);
 void audio_capture_start(void);
+// Re-clocks the running capture to `rate` Hz without a reboot; the tap
+// geometry follows the same rule as at boot. Applied asynchronously by the
+// mic reader, which then notifies the detector and the streamer.
+esp_err_t audio_capture_set_rate(int rate);
@@ -2,18 +2,72 @@
 
 #include "esp_err.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 #define AUDIO_MODE_MAX_LEN 16
 #define AUDIO_URL_MAX_LEN  128
+#define AUDIO_FORMAT_MAX_LEN 8
+#define AUDIO_CHANNELS_MAX_LEN 8
 
 typedef struct
 {
     char mode[AUDIO_MODE_MAX_LEN];
     char upload_url[AUDIO_URL_MAX_LEN];
+    char format[AUDIO_FORMAT_MAX_LEN]; // stream encoding: "pcm" or "adpcm"
+    // Stream channels: "stereo", "left", "right" or "mono" (the sum).
+    char channels[AUDIO_CHANNELS_MAX_LEN];
+    int decimation; // stream rate divider, 1 for the mic rate
     bool enabled;
     int sampling_rate;
 } audio_config_t;
 
-audio_config_t audio_config_get(void);
+// The audio settings live in RAM; NVS is written behind them.
+//
+// Every change bumps a generation counter and restarts a short commit
+// delay, so a burst of POSTs costs one NVS commit, and only the keys that
+// changed are written. esp_restart() flushes a pending commit first.
+// Listeners are told which fields changed, on the task that made the
+// change.
+
+// Fields of audio_config_t, as bits of a change mask.
+typedef enum
+{
+    AUDIO_CONFIG_MODE = 1u << 0,
+    AUDIO_CONFIG_UPLOAD_URL = 1u << 1,
+    AUDIO_CONFIG_FORMAT = 1u << 2,
+    AUDIO_CONFIG_CHANNELS = 1u << 3,
+    AUDIO_CONFIG_DECIMATION = 1u << 4,
+    AUDIO_CONFIG_ENABLED = 1u << 5,
+    AUDIO_CONFIG_SAMPLING_RATE = 1u << 6,
+} audio_config_field;
+
+// Loads the settings from NVS; needs NVS initialised. Later getters load
+// them on first use otherwise.
+void audio_config_init(void);
+
+// Copies the settings into `out` and returns their generation.
+uint32_t audio_config_get(audio_config_t* out);
+// Changes with every audio_config_set() that changes a field.
+uint32_t audio_config_generation(void);
+
+// Updates the RAM copy and schedules the NVS commit. Setting the current
+// values is a no-op: no generation bump, no write and no notification.
 esp_err_t audio_config_set(const audio_config_t* config);
+// Writes a pending change now.
+esp_err_t audio_config_flush(void);
 bool audio_config_is_configured(void);
+
+// `changed` is a mask of audio_config_field. Called with the new settings
+// after they are in place; must not block for long or set the
+// configuration itself.
+typedef void (*audio_config_listener)(const audio_config_t* cfg, uint32_t changed, void* ctx);
+
+#define AUDIO_CONFIG_MAX_LISTENERS 4
+
+// Returns false when all AUDIO_CONFIG_MAX_LISTENERS slots are taken.
+bool audio_config_subscribe(audio_config_listener cb, void* ctx);
+
+// Per-channel microphone DC offset from the last calibration, stored in the
+// audio namespace. Returns ESP_ERR_NVS_NOT_FOUND on a unit never calibrated.
+esp_err_t audio_config_get_dc_offset(int16_t* left, int16_t* right);
+esp_err_t audio_config_set_dc_offset(int16_t left, int16_t right);
@@ -1,5 +1,44 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
-void audio_wav_build_header(uint8_t *out, int sample_rate);
+#define AUDIO_WAV_HEADER_BYTES       44
+#define AUDIO_WAV_ADPCM_HEADER_BYTES 60
+// LIST/INFO chunk carrying an audio_wav_stamp, placed just before "data".
+#define AUDIO_WAV_STAMP_BYTES        108
+#define AUDIO_WAV_STREAM_HEADER_MAX                                            \
+    (AUDIO_WAV_ADPCM_HEADER_BYTES + AUDIO_WAV_STAMP_BYTES)
+
+// When a stream's first frame was captured. Written as the ICMT comment
+// "sample=<index> uptime_us=<us> unix_us=<us>" so any RIFF reader can show
+// it; a time of 0 is unknown (clock not anchored / wall clock not set).
+typedef struct {
+    uint64_t sample_index; // mic sample counter, see mic_captured_samples()
+    int64_t uptime_us;     // esp_timer capture time
+    int64_t unix_us;       // wall-clock capture time
+} audio_wav_stamp;
+
+// 16-bit PCM of `channels` channels for a stream of unknown length, with the
+// LIST chunk when `stamp` is given. Returns the length:
+// AUDIO_WAV_HEADER_BYTES, plus AUDIO_WAV_STAMP_BYTES with a stamp.
+size_t audio_wav_build_header(uint8_t *out, int sample_rate, int channels,
+                              const audio_wav_stamp *stamp);
+
+// Fills in the RIFF and data sizes of a header from audio_wav_build_header(),
+// `header_len` bytes long, once the stream is known to hold `data_size`
+// bytes of samples; for files written before their length was known.
+void audio_wav_patch_pcm_sizes(uint8_t *header, size_t header_len,
+                               uint32_t data_size);
+
+// Stereo, for a clip of exactly `frames` frames.
+void audio_wav_build_clip_header(uint8_t *out, int sample_rate,
+                                 uint32_t frames);
+
+// IMA ADPCM (format 0x11) with the given block geometry, including the fact
+// chunk non-PCM files need; AUDIO_WAV_ADPCM_HEADER_BYTES long, plus
+// AUDIO_WAV_STAMP_BYTES with a stamp.
+size_t audio_wav_build_adpcm_header(uint8_t *out, int sample_rate,
+                                    int channels, uint16_t block_align,
+                                    uint16_t samples_per_block,
+                                    const audio_wav_stamp *stamp);
@@ -2,4 +2,9 @@
 
 #include "esp_err.h"
 
+// What everything else needs first: NVS, netif and the default event loop.
+// Fast; no radio activity.
+esp_err_t middleware_init_core(void);
+// Brings up Wi-Fi and joins the stored network; blocks until associated or
+// timed out, so it belongs on a task off the audio path.
 esp_err_t middleware_init(void);
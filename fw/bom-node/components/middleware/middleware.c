@@ -1,7 +1,18 @@
 #include "middleware.h"
 
+#include "audio_config.h"
 #include "wifi.h"
 
+esp_err_t middleware_init_core(void)
+{
+    esp_err_t err = wifi_init_core();
+    if (err == ESP_OK)
+    {
+        audio_config_init();
+    }
+    return err;
+}
+
 esp_err_t middleware_init(void)
 {
     return wifi_init();
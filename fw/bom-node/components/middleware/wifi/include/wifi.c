@@ -3,41 +3,251 @@
 // ===========================
 
 #include "wifi.h"
+#include "boot_timing.h"
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_netif.h"
+#include "esp_netif_sntp.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "lwip/inet.h"
+#include "mbedtls/pkcs5.h"
+#include "metrics.h"
+#include "sdkconfig.h"
 #include "wifi_config.h"
+#include "wifi_perf.h"
+#include "wifi_scan.h"
 #include "wifi_types.h"
 #include <string.h>
 
 #define TAG "wifi"
 
-static int retry_count = 0;
+// How long wifi_try_reconnect() waits for an IP; retries go on afterwards.
+#define CONNECT_WAIT_MS 30000
+// Reconnect backoff: the first retry is immediate, then it doubles from here
+// up to CONFIG_MIDDLEWARE_WIFI_RETRY_MAX_MS.
+#define RETRY_DELAY_MIN_MS 250
+// Failed attempts at the cached BSSID/channel before falling back to a scan.
+#define PINNED_FAILURES_MAX 2
+
 static bool s_got_ip = false;
 static SemaphoreHandle_t s_connect_sema = NULL;
+static bool s_sntp_started = false;
+
+static uint8_t s_last_reason = 0; // wifi_err_reason_t of the last disconnect
+
+static wifi_config_t s_sta_cfg;  // as configured, with the passphrase
+static bool s_sta_wanted = false; // reconnect on disconnect
+static bool s_associated = false; // between STA_CONNECTED and DISCONNECTED
+static bool s_leaving = false;    // our own esp_wifi_disconnect() in flight
+static bool s_pinned = false;     // s_sta_cfg goes to the cached AP
+static int s_pinned_failures = 0;
+static uint32_t s_retry_delay_ms = 0;
+static esp_timer_handle_t s_retry_timer = NULL;
+
+static metrics_counter s_disconnects = METRICS_COUNTER_INIT(
+    "wifi_sta_disconnects_total", "Station disconnect events");
+static metrics_counter s_reconnects = METRICS_COUNTER_INIT(
+    "wifi_sta_reconnect_attempts_total", "Association attempts after a disconnect");
+static void wifi_collect(metrics_out *out, void *ctx);
+static metrics_collector s_collector =
+    METRICS_COLLECTOR_INIT(wifi_collect, NULL);
+
+// Link state is read when scraped rather than tracked on every event.
+static void wifi_collect(metrics_out *out, void *ctx) {
+  (void)ctx;
+  metrics_out_family(out, "wifi_sta_connected", "gauge",
+                     "1 while the station holds an IP address");
+  metrics_out_uint(out, "wifi_sta_connected", NULL, s_got_ip ? 1 : 0);
+  wifi_ap_record_t ap;
+  if (s_got_ip && esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+    metrics_out_family(out, "wifi_sta_rssi_dbm", "gauge",
+                       "Signal strength of the associated AP [dBm]");
+    metrics_out_int(out, "wifi_sta_rssi_dbm", NULL, ap.rssi);
+  }
+  wifi_perf_status_t perf;
+  wifi_perf_get_status(&perf);
+  metrics_out_family(out, "wifi_streaming_profile", "gauge",
+                     "1 while a stream keeps power save off");
+  metrics_out_uint(out, "wifi_streaming_profile", NULL, perf.streaming ? 1 : 0);
+}
+
+void wifi_get_link_stats(wifi_link_stats_t *out) {
+  if (!out) {
+    return;
+  }
+  memset(out, 0, sizeof(*out));
+  out->connected = s_got_ip;
+  wifi_ap_record_t ap;
+  if (s_got_ip && esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+    out->rssi = ap.rssi;
+    out->channel = ap.primary;
+  }
+  out->disconnects = metrics_counter_read32(&s_disconnects);
+  out->reconnect_attempts = metrics_counter_read32(&s_reconnects);
+  out->last_disconnect_reason = s_last_reason;
+}
+
+// SNTP keeps running across reconnects once started, so this only runs on
+// the first IP. Smooth sync slews the clock after the first step, which keeps
+// wall-clock stamps derived from esp_timer monotonic.
+static void wifi_start_sntp(void) {
+  if (s_sntp_started || CONFIG_MIDDLEWARE_WIFI_SNTP_SERVER[0] == '\0') {
+    return;
+  }
+  esp_sntp_config_t config =
+      ESP_NETIF_SNTP_DEFAULT_CONFIG(CONFIG_MIDDLEWARE_WIFI_SNTP_SERVER);
+  config.smooth_sync = true;
+  esp_err_t err = esp_netif_sntp_init(&config);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "SNTP init failed: %s", esp_err_to_name(err));
+    return;
+  }
+  s_sntp_started = true;
+  ESP_LOGI(TAG, "SNTP started (%s)", CONFIG_MIDDLEWARE_WIFI_SNTP_SERVER);
+}
+
+static bool is_psk_only(uint8_t authmode) {
+  return authmode == WIFI_AUTH_WPA_PSK || authmode == WIFI_AUTH_WPA2_PSK ||
+         authmode == WIFI_AUTH_WPA_WPA2_PSK;
+}
+
+// Station config for the next attempt: s_sta_cfg, directed at the cached AP
+// when it is for the same SSID. With a cached PMK the supplicant also skips
+// the 4096-round PBKDF2 of the passphrase.
+static void apply_sta_config(bool pin) {
+  wifi_config_t cfg = s_sta_cfg;
+  wifi_fast_connect_t fc;
+  s_pinned = pin && wifi_load_fast_connect(&fc) &&
+             strncmp(fc.ssid, (const char *)cfg.sta.ssid, sizeof(fc.ssid)) == 0;
+  if (s_pinned) {
+    cfg.sta.bssid_set = true;
+    memcpy(cfg.sta.bssid, fc.bssid, sizeof(cfg.sta.bssid));
+    cfg.sta.channel = fc.channel;
+    if (fc.has_pmk && is_psk_only(fc.authmode)) {
+      // A 64 hex digit password is taken as the PSK itself.
+      static const char hex[] = "0123456789abcdef";
+      for (int i = 0; i < 32; i++) {
+        cfg.sta.password[i * 2] = hex[fc.pmk[i] >> 4];
+        cfg.sta.password[i * 2 + 1] = hex[fc.pmk[i] & 0xf];
+      }
+    }
+  }
+  s_pinned_failures = 0;
+  esp_wifi_set_config(WIFI_IF_STA, &cfg);
+}
+
+static void retry_connect(void *arg) {
+  (void)arg;
+  if (s_sta_wanted && !s_associated) {
+    metrics_counter_inc(&s_reconnects);
+    esp_wifi_connect();
+  }
+}
+
+static void schedule_retry(uint8_t reason) {
+  if (s_pinned && (reason == WIFI_REASON_NO_AP_FOUND ||
+                   ++s_pinned_failures >= PINNED_FAILURES_MAX)) {
+    ESP_LOGI(TAG, "Cached AP not joined (reason %u), scanning", reason);
+    wifi_fast_connect_t fc;
+    if ((reason == WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT ||
+         reason == WIFI_REASON_HANDSHAKE_TIMEOUT) &&
+        wifi_load_fast_connect(&fc) && fc.has_pmk) {
+      fc.has_pmk = false; // derived again after the next successful join
+      memset(fc.pmk, 0, sizeof(fc.pmk));
+      wifi_store_fast_connect(&fc);
+    }
+    apply_sta_config(false);
+  }
+  if (s_retry_delay_ms == 0 || !s_retry_timer) {
+    s_retry_delay_ms = RETRY_DELAY_MIN_MS;
+    retry_connect(NULL);
+    return;
+  }
+  ESP_LOGI(TAG, "Reconnecting in %u ms", (unsigned)s_retry_delay_ms);
+  esp_timer_stop(s_retry_timer);
+  esp_timer_start_once(s_retry_timer, (uint64_t)s_retry_delay_ms * 1000);
+  s_retry_delay_ms = s_retry_delay_ms * 2 > CONFIG_MIDDLEWARE_WIFI_RETRY_MAX_MS
+                         ? CONFIG_MIDDLEWARE_WIFI_RETRY_MAX_MS
+                         : s_retry_delay_ms * 2;
+}
+
+// Remembers the AP for the next boot; the PMK is kept while the SSID stays.
+static void remember_ap(const wifi_event_sta_connected_t *ev) {
+  wifi_fast_connect_t fc;
+  const bool had = wifi_load_fast_connect(&fc);
+  const bool same_ssid =
+      had && ev->ssid_len <= sizeof(fc.ssid) &&
+      strncmp(fc.ssid, (const char *)ev->ssid, sizeof(fc.ssid)) == 0;
+  if (!same_ssid) {
+    memset(&fc, 0, sizeof(fc));
+    memcpy(fc.ssid, ev->ssid,
+           ev->ssid_len < sizeof(fc.ssid) ? ev->ssid_len : sizeof(fc.ssid));
+  }
+  memcpy(fc.bssid, ev->bssid, sizeof(fc.bssid));
+  fc.channel = ev->channel;
+  fc.authmode = (uint8_t)ev->authmode;
+  esp_err_t err = wifi_store_fast_connect(&fc);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "AP not cached: %s", esp_err_to_name(err));
+  }
+}
+
+// Derives and caches the PMK of the current network. Slow (hundreds of ms),
+// so it runs in the connecting task rather than the event loop.
+static void cache_pmk(void) {
+  wifi_fast_connect_t fc;
+  const char *pass = (const char *)s_sta_cfg.sta.password;
+  const size_t pass_len = strnlen(pass, sizeof(s_sta_cfg.sta.password));
+  if (!wifi_load_fast_connect(&fc) || fc.has_pmk || !is_psk_only(fc.authmode) ||
+      pass_len < 8 || pass_len >= 64 ||
+      strncmp(fc.ssid, (const char *)s_sta_cfg.sta.ssid, sizeof(fc.ssid)) != 0) {
+    return;
+  }
+  const size_t ssid_len = strnlen(fc.ssid, sizeof(fc.ssid));
+  if (mbedtls_pkcs5_pbkdf2_hmac_ext(MBEDTLS_MD_SHA1, (const unsigned char *)pass,
+                                    pass_len, (const unsigned char *)fc.ssid,
+                                    ssid_len, 4096, sizeof(fc.pmk), fc.pmk) != 0) {
+    return;
+  }
+  fc.has_pmk = true;
+  wifi_store_fast_connect(&fc);
+}
 
 static void wifi_event_handler(void *arg, esp_event_base_t base, int32_t id,
                                void *data) {
-  if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED) {
+  if (base == WIFI_EVENT && id == WIFI_EVENT_STA_CONNECTED) {
+    s_associated = true;
+    if (data) {
+      remember_ap((const wifi_event_sta_connected_t *)data);
+    }
+  } else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED) {
+    metrics_counter_inc(&s_disconnects);
+    uint8_t reason = 0;
+    if (data) {
+      reason = ((const wifi_event_sta_disconnected_t *)data)->reason;
+      s_last_reason = reason;
+    }
+    s_associated = false;
     s_got_ip = false;
     set_wifi_connected(false);
-    if (retry_count++ < 5) {
-      esp_wifi_connect();
-    } else {
-      if (s_connect_sema) {
-        xSemaphoreGive(s_connect_sema);
-      }
+    if (s_leaving && reason == WIFI_REASON_ASSOC_LEAVE) {
+      s_leaving = false; // our own disconnect, the caller connects again
+    } else if (s_sta_wanted) {
+      schedule_retry(reason);
     }
   } else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
+    boot_timing_mark(BOOT_STAGE_WIFI_IP);
     s_got_ip = true;
+    s_retry_delay_ms = 0;
+    s_pinned_failures = 0;
     if (s_connect_sema) {
       xSemaphoreGive(s_connect_sema);
     }
     set_wifi_connected(true);
+    wifi_start_sntp();
   }
 }
 
@@ -67,7 +277,8 @@ static void init_ap_netif(void) {
 static esp_err_t apply_ap_config(bool enabled, const char *ssid) {
   if (enabled) {
     wifi_config_t ap_config = {
-        .ap = {.max_connection = 2, .authmode = WIFI_AUTH_OPEN}};
+        .ap = {.max_connection = CONFIG_MIDDLEWARE_WIFI_AP_MAX_CONNECTIONS,
+               .authmode = WIFI_AUTH_OPEN}};
 
     strncpy((char *)ap_config.ap.ssid, ssid, sizeof(ap_config.ap.ssid) - 1);
     ap_config.ap.ssid_len = strlen((const char *)ap_config.ap.ssid);
@@ -91,29 +302,41 @@ esp_err_t wifi_try_reconnect(void) {
   if (!s_connect_sema) {
     s_connect_sema = xSemaphoreCreateBinary();
   }
+  if (!s_retry_timer) {
+    const esp_timer_create_args_t args = {.callback = retry_connect,
+                                          .name = "wifi_retry"};
+    esp_timer_create(&args, &s_retry_timer);
+  }
 
-  retry_count = 0;
-  s_got_ip = false;
-
+  s_sta_wanted = false;
+  if (s_retry_timer) {
+    esp_timer_stop(s_retry_timer);
+  }
+  s_leaving = s_associated;
   esp_wifi_disconnect();
-
-  for (int i = 0; i < 5; i++) {
-    esp_wifi_connect();
-
-    if (xSemaphoreTake(s_connect_sema, pdMS_TO_TICKS(30000)) == pdTRUE) {
-      if (s_got_ip) {
-        ESP_LOGI(TAG, "Reconnected successfully.");
-        set_wifi_connected(true);
-        return ESP_OK;
-      } else {
-        ESP_LOGW(TAG, "Reconnection attempt %d failed.", i + 1);
-      }
-    } else {
-      ESP_LOGE(TAG, "Reconnect attempt %d timeout.", i + 1);
-    }
+  s_got_ip = false;
+  xSemaphoreTake(s_connect_sema, 0); // drop a stale give
+
+  apply_sta_config(true);
+  s_retry_delay_ms = 0;
+  s_sta_wanted = true;
+  const int64_t start_us = esp_timer_get_time();
+  metrics_counter_inc(&s_reconnects);
+  esp_wifi_connect();
+
+  // Failed attempts are retried by the event handler, with backoff and
+  // without a limit; this only waits for the outcome.
+  if (xSemaphoreTake(s_connect_sema, pdMS_TO_TICKS(CONNECT_WAIT_MS)) == pdTRUE &&
+      s_got_ip) {
+    ESP_LOGI(TAG, "Connected in %d ms%s",
+             (int)((esp_timer_get_time() - start_us) / 1000),
+             s_pinned ? " (cached AP)" : "");
+    set_wifi_connected(true);
+    cache_pmk();
+    return ESP_OK;
   }
 
-  ESP_LOGE(TAG, "Reconnection failed after 5 attempts.");
+  ESP_LOGW(TAG, "No IP after %d s, still retrying", CONNECT_WAIT_MS / 1000);
   set_wifi_connected(false);
   return ESP_FAIL;
 }
@@ -134,42 +357,41 @@ esp_err_t wifi_connect_with_credentials(const char *ssid,
   esp_wifi_set_mode(WIFI_MODE_APSTA);
   set_wifi_mode(WIFI_MODE_APSTA);
 
-  ESP_LOGI(TAG, "Disconnecting if already connected...");
-  esp_wifi_disconnect();
-  vTaskDelay(pdMS_TO_TICKS(100));
-
-  ESP_LOGI(TAG, "Setting new STA config...");
-  esp_wifi_set_config(ESP_IF_WIFI_STA, &cfg);
+  // The cached AP and PMK belong to the stored network.
+  const wifi_credentials_t stored = get_wifi_credentials();
+  if (strncmp(stored.ssid, ssid, sizeof(stored.ssid)) != 0 ||
+      strncmp(stored.password, password, sizeof(stored.password)) != 0) {
+    wifi_clear_fast_connect();
+  }
 
+  // The STA config is applied by wifi_try_reconnect().
+  s_sta_cfg = cfg;
   set_wifi_configured(true);
   return wifi_try_reconnect();
 }
 
+// Boot path: the stored network, without the mode switch and settle delay
+// of a newly entered one.
+static void wifi_connect_stored(void) {
+  const wifi_credentials_t creds = get_wifi_credentials();
+  memset(&s_sta_cfg, 0, sizeof(s_sta_cfg));
+  strncpy((char *)s_sta_cfg.sta.ssid, creds.ssid, sizeof(s_sta_cfg.sta.ssid) - 1);
+  strncpy((char *)s_sta_cfg.sta.password, creds.password,
+          sizeof(s_sta_cfg.sta.password));
+  set_wifi_configured(true);
+  wifi_try_reconnect();
+}
+
+// Blocking scan for callers that need fresh results; shares the scan of
+// the background service (wifi_scan.h).
 esp_err_t wifi_scan_networks(wifi_scan_result_t *result) {
   if (!result) {
     return ESP_ERR_INVALID_ARG;
   }
 
-  wifi_mode_t current_mode = get_wifi_mode();
-  if (current_mode == WIFI_MODE_AP) {
-    esp_wifi_set_mode(WIFI_MODE_APSTA);
-    set_wifi_mode(WIFI_MODE_APSTA);
-  }
-
-  wifi_scan_config_t cfg = {
-      .show_hidden = false,
-      .scan_type = WIFI_SCAN_TYPE_ACTIVE,
-      .scan_time.active = {.min = 200, .max = 400},
-  };
-
-  esp_wifi_scan_start(&cfg, true);
-
-  uint16_t count = 0;
-  esp_wifi_scan_get_ap_num(&count);
-  count = count > MAX_WIFI_SCAN_RESULTS ? MAX_WIFI_SCAN_RESULTS : count;
-
-  result->count = count;
-  return esp_wifi_scan_get_ap_records(&count, result->records);
+  esp_err_t err = wifi_scan_wait(10000);
+  wifi_scan_get(result, NULL, NULL);
+  return err;
 }
 
 esp_err_t wifi_set_ap_config(bool enabled, const char *ssid) {
@@ -190,6 +412,9 @@ esp_err_t wifi_set_ap_config(bool enabled, const char *ssid) {
 }
 
 void wifi_main_func(void) {
+  metrics_register(&s_disconnects.base);
+  metrics_register(&s_reconnects.base);
+  metrics_register(&s_collector.base);
   esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
                                       wifi_event_handler, NULL, NULL);
   esp_event_handler_instance_register(IP_EVENT, ESP_EVENT_ANY_ID,
@@ -202,9 +427,11 @@ void wifi_main_func(void) {
 
   apply_ap_config(is_ap_enabled(), get_ap_ssid());
   esp_wifi_start();
+  boot_timing_mark(BOOT_STAGE_WIFI_STARTED);
+  wifi_perf_init();
+  wifi_scan_init();
 
   if (is_wifi_credentials_set()) {
-    wifi_connect_with_credentials(get_wifi_credentials().ssid,
-                                  get_wifi_credentials().password);
+    wifi_connect_stored();
   }
 }
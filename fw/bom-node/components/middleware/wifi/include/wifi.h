@@ -3,6 +3,10 @@
 #include "esp_err.h"
 #include "wifi_types.h"
 
+// NVS, netif and the default event loop; safe to call more than once.
+esp_err_t wifi_init_core(void);
+// wifi_init_core(), then starts the radio and joins the stored network
+// (waits up to 30 s for an IP).
 esp_err_t wifi_init(void);
 void wifi_main_func(void);
 void start_apsta_mode(void);
@@ -10,3 +14,4 @@ esp_err_t wifi_try_reconnect(void);
 esp_err_t wifi_connect_with_credentials(const char *ssid, const char *password);
 esp_err_t wifi_scan_networks(wifi_scan_result_t *result);
 esp_err_t wifi_set_ap_config(bool enabled, const char *ssid);
+void wifi_get_link_stats(wifi_link_stats_t *out);
@@ -19,6 +19,10 @@ wifi_credentials_t get_wifi_credentials(void);
 
 esp_err_t wifi_store_credentials(const char* ssid, const char* password);
 
+bool wifi_load_fast_connect(wifi_fast_connect_t* out);
+esp_err_t wifi_store_fast_connect(const wifi_fast_connect_t* fc);
+esp_err_t wifi_clear_fast_connect(void);
+
 void set_ap_enabled(bool enabled);
 bool is_ap_enabled(void);
 
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+
+// Radio profile that follows the audio streams.
+//
+// While any stream holds the radio (a push or RTP session, or an attached
+// pull client) the station runs with power save off: modem sleep parks the
+// radio between DTIM beacons and delays queued uplink frames by up to a
+// beacon interval, which shows up as 100+ ms jitter on chunked uploads.
+// With no holders it drops back to CONFIG_WIFI_PERF_IDLE_PS.
+//
+// TX power and the station bandwidth are stored in NVS and reapplied at
+// start-up. Buffer and block-ack window sizes are build-time settings
+// (CONFIG_ESP_WIFI_* and CONFIG_LWIP_TCP_* in sdkconfig).
+
+// dBm range esp_wifi_set_max_tx_power() accepts (in quarter dBm there).
+#define WIFI_PERF_TX_POWER_MIN_DBM 2
+#define WIFI_PERF_TX_POWER_MAX_DBM 20
+
+typedef struct {
+  bool streaming;          // at least one holder
+  int holders;
+  wifi_ps_type_t ps;       // power save in effect
+  int tx_power_dbm;        // configured; 0 = PHY default
+  float tx_power_actual_dbm; // as reported by the driver
+  wifi_bandwidth_t bandwidth;
+} wifi_perf_status_t;
+
+// Loads the stored settings and applies them; call after esp_wifi_start().
+void wifi_perf_init(void);
+
+// Takes (hold = true) or releases a hold on the streaming profile. Safe from
+// any task, also before wifi_perf_init().
+void wifi_perf_stream_hold(bool hold);
+
+// Sets, applies and stores the maximum TX power. 0 restores the PHY default
+// (CONFIG_ESP_PHY_MAX_WIFI_TX_POWER).
+esp_err_t wifi_perf_set_tx_power(int dbm);
+
+// Sets and stores the station bandwidth (WIFI_BW_HT20 or WIFI_BW_HT40).
+// Takes effect from the next association.
+esp_err_t wifi_perf_set_bandwidth(wifi_bandwidth_t bw);
+
+void wifi_perf_get_status(wifi_perf_status_t *out);
+
+// "ht20" / "ht40"; false for anything else.
+bool wifi_perf_parse_bandwidth(const char *name, wifi_bandwidth_t *out);
+const char *wifi_perf_bandwidth_name(wifi_bandwidth_t bw);
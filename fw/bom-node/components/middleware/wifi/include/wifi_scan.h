@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "wifi_types.h"
+
+// Background scan service.
+//
+// Scans run asynchronously in the Wi-Fi driver and their results are kept
+// with the time they were taken, so readers (the web UI) never wait on the
+// radio. A request while a scan is already running joins it instead of
+// starting another. Results can also be refreshed on a schedule
+// (CONFIG_MIDDLEWARE_WIFI_SCAN_INTERVAL_S), skipped while an audio stream
+// holds the radio (wifi_perf.h) since every off-channel dwell is a gap in
+// the uplink.
+
+// Registers the scan-done handler and starts the schedule; call after
+// esp_wifi_start().
+void wifi_scan_init(void);
+
+// Starts a scan unless one is in flight. ESP_OK when a scan is running
+// afterwards.
+esp_err_t wifi_scan_request(void);
+
+// Copies the cached results. `age_ms` is -1 before the first completed scan
+// (and the result is empty); `scanning` tells whether a fresher one is on
+// the way. Either may be NULL.
+void wifi_scan_get(wifi_scan_result_t *out, int64_t *age_ms, bool *scanning);
+
+// Requests a scan and waits up to `timeout_ms` for it to finish.
+esp_err_t wifi_scan_wait(uint32_t timeout_ms);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "esp_wifi_types.h"
 
@@ -16,3 +17,26 @@ typedef struct
     uint16_t count;
     wifi_ap_record_t records[MAX_WIFI_SCAN_RESULTS];
 } wifi_scan_result_t;
+
+typedef struct
+{
+    bool connected;
+    int8_t rssi;      // dBm, while connected
+    uint8_t channel;  // while connected
+    uint32_t disconnects;
+    uint32_t reconnect_attempts;
+    uint8_t last_disconnect_reason; // wifi_err_reason_t, 0 before the first
+} wifi_link_stats_t;
+
+// Last AP the station associated with, for a directed reconnect that skips
+// the full scan. The PMK is derived from the passphrase once and only used
+// for WPA/WPA2-PSK networks.
+typedef struct
+{
+    char ssid[32];
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t authmode; // wifi_auth_mode_t
+    bool has_pmk;
+    uint8_t pmk[32];
+} wifi_fast_connect_t;
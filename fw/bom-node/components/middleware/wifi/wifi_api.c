@@ -5,8 +5,14 @@
 #include "esp_netif.h"
 #include "nvs_flash.h"
 
-esp_err_t wifi_init(void)
+esp_err_t wifi_init_core(void)
 {
+    static bool s_done = false;
+    if (s_done)
+    {
+        return ESP_OK;
+    }
+
     esp_err_t err = nvs_flash_init();
     if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND)
     {
@@ -30,6 +36,18 @@ esp_err_t wifi_init(void)
         return err;
     }
 
+    s_done = true;
+    return ESP_OK;
+}
+
+esp_err_t wifi_init(void)
+{
+    esp_err_t err = wifi_init_core();
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
     wifi_main_func();
     return ESP_OK;
 }
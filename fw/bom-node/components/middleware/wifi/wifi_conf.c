@@ -8,6 +8,7 @@
 #define WIFI_NVS_NAMESPACE "wifi"
 #define WIFI_NVS_STA_SSID "sta_ssid"
 #define WIFI_NVS_STA_PASS "sta_pass"
+#define WIFI_NVS_STA_FAST "sta_fast"
 #define WIFI_NVS_AP_SSID "ap_ssid"
 #define WIFI_NVS_AP_EN "ap_enabled"
 
@@ -19,6 +20,9 @@ static bool s_wifi_credentials_initialized = false;
 static bool s_ap_config_initialized = false;
 static bool s_ap_enabled = true;
 static char s_ap_ssid[32];
+static wifi_fast_connect_t s_fast;
+static bool s_fast_loaded = false;
+static bool s_fast_valid = false;
 
 static esp_err_t wifi_nvs_open(nvs_handle_t *handle) {
   if (!handle) {
@@ -148,6 +152,86 @@ esp_err_t wifi_store_credentials(const char *ssid, const char *password) {
   return err;
 }
 
+static void wifi_init_fast_connect(void) {
+  if (s_fast_loaded) {
+    return;
+  }
+
+  memset(&s_fast, 0, sizeof(s_fast));
+  s_fast_valid = false;
+
+  nvs_handle_t handle;
+  if (wifi_nvs_open(&handle) == ESP_OK) {
+    size_t len = sizeof(s_fast);
+    s_fast_valid = nvs_get_blob(handle, WIFI_NVS_STA_FAST, &s_fast, &len) == ESP_OK &&
+                   len == sizeof(s_fast) && s_fast.ssid[0] != '\0' && s_fast.channel != 0;
+    nvs_close(handle);
+  }
+  if (!s_fast_valid) {
+    memset(&s_fast, 0, sizeof(s_fast));
+  }
+
+  s_fast_loaded = true;
+}
+
+bool wifi_load_fast_connect(wifi_fast_connect_t *out) {
+  wifi_init_fast_connect();
+  if (!out || !s_fast_valid) {
+    return false;
+  }
+  *out = s_fast;
+  return true;
+}
+
+esp_err_t wifi_store_fast_connect(const wifi_fast_connect_t *fc) {
+  if (!fc || fc->ssid[0] == '\0' || fc->channel == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  wifi_init_fast_connect();
+  // Reconnects to the same AP are the common case; spare the flash.
+  if (s_fast_valid && memcmp(&s_fast, fc, sizeof(s_fast)) == 0) {
+    return ESP_OK;
+  }
+  s_fast = *fc;
+  s_fast_valid = true;
+
+  nvs_handle_t handle;
+  esp_err_t err = wifi_nvs_open(&handle);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  err = nvs_set_blob(handle, WIFI_NVS_STA_FAST, &s_fast, sizeof(s_fast));
+  if (err == ESP_OK) {
+    err = nvs_commit(handle);
+  }
+  nvs_close(handle);
+  return err;
+}
+
+esp_err_t wifi_clear_fast_connect(void) {
+  wifi_init_fast_connect();
+  if (!s_fast_valid) {
+    return ESP_OK;
+  }
+  memset(&s_fast, 0, sizeof(s_fast));
+  s_fast_valid = false;
+
+  nvs_handle_t handle;
+  esp_err_t err = wifi_nvs_open(&handle);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  err = nvs_erase_key(handle, WIFI_NVS_STA_FAST);
+  if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND) {
+    err = nvs_commit(handle);
+  }
+  nvs_close(handle);
+  return err;
+}
+
 void set_ap_enabled(bool enabled) { s_ap_enabled = enabled; }
 
 bool is_ap_enabled(void) {
@@ -0,0 +1,192 @@
+#include "wifi_perf.h"
+
+#include <stdatomic.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+
+#define TAG "wifi_perf"
+
+#define WIFI_NVS_NAMESPACE "wifi"
+#define WIFI_NVS_TX_POWER "tx_dbm"
+#define WIFI_NVS_BANDWIDTH "bw"
+
+#if defined(CONFIG_WIFI_PERF_IDLE_PS_NONE)
+#define IDLE_PS WIFI_PS_NONE
+#elif defined(CONFIG_WIFI_PERF_IDLE_PS_MAX_MODEM)
+#define IDLE_PS WIFI_PS_MAX_MODEM
+#else
+#define IDLE_PS WIFI_PS_MIN_MODEM
+#endif
+
+static _Atomic int s_holders = 0;
+// Serialises esp_wifi_set_ps() so the last transition wins; created by init.
+static SemaphoreHandle_t s_mutex = NULL;
+static bool s_started = false;
+static bool s_ps_set = false; // s_ps was applied at least once
+static wifi_ps_type_t s_ps = IDLE_PS;
+static int s_tx_power_dbm = 0;
+static wifi_bandwidth_t s_bandwidth = WIFI_BW_HT20;
+
+static void apply_ps(void) {
+  if (!s_mutex || xSemaphoreTake(s_mutex, portMAX_DELAY) != pdTRUE) {
+    return;
+  }
+  const wifi_ps_type_t ps =
+      atomic_load(&s_holders) > 0 ? WIFI_PS_NONE : IDLE_PS;
+  if (s_started && (!s_ps_set || ps != s_ps)) {
+    esp_err_t err = esp_wifi_set_ps(ps);
+    if (err == ESP_OK) {
+      ESP_LOGI(TAG, "Power save %s",
+               ps == IDLE_PS ? "idle profile" : "off (streaming)");
+      s_ps = ps;
+      s_ps_set = true;
+    } else {
+      ESP_LOGW(TAG, "esp_wifi_set_ps failed: %s", esp_err_to_name(err));
+    }
+  }
+  xSemaphoreGive(s_mutex);
+}
+
+static esp_err_t apply_tx_power(int dbm) {
+  if (dbm == 0) {
+    dbm = CONFIG_ESP_PHY_MAX_WIFI_TX_POWER;
+  }
+  return esp_wifi_set_max_tx_power((int8_t)(dbm * 4));
+}
+
+static esp_err_t store_i8(const char *key, int8_t value) {
+  nvs_handle_t handle;
+  esp_err_t err = nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &handle);
+  if (err != ESP_OK) {
+    return err;
+  }
+  err = nvs_set_i8(handle, key, value);
+  if (err == ESP_OK) {
+    err = nvs_commit(handle);
+  }
+  nvs_close(handle);
+  return err;
+}
+
+static void load_settings(void) {
+  nvs_handle_t handle;
+  if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+    return;
+  }
+  int8_t v = 0;
+  if (nvs_get_i8(handle, WIFI_NVS_TX_POWER, &v) == ESP_OK &&
+      (v == 0 ||
+       (v >= WIFI_PERF_TX_POWER_MIN_DBM && v <= WIFI_PERF_TX_POWER_MAX_DBM))) {
+    s_tx_power_dbm = v;
+  }
+  if (nvs_get_i8(handle, WIFI_NVS_BANDWIDTH, &v) == ESP_OK &&
+      (v == WIFI_BW_HT20 || v == WIFI_BW_HT40)) {
+    s_bandwidth = (wifi_bandwidth_t)v;
+  }
+  nvs_close(handle);
+}
+
+void wifi_perf_init(void) {
+  if (!s_mutex) {
+    s_mutex = xSemaphoreCreateMutex();
+  }
+  load_settings();
+
+  esp_err_t err = esp_wifi_set_bandwidth(WIFI_IF_STA, s_bandwidth);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Bandwidth not applied: %s", esp_err_to_name(err));
+  }
+  if (s_tx_power_dbm != 0) {
+    err = apply_tx_power(s_tx_power_dbm);
+    if (err != ESP_OK) {
+      ESP_LOGW(TAG, "TX power not applied: %s", esp_err_to_name(err));
+    }
+  }
+
+  // Holds taken before start-up are applied now.
+  s_started = true;
+  apply_ps();
+}
+
+void wifi_perf_stream_hold(bool hold) {
+  const int before = hold ? atomic_fetch_add(&s_holders, 1)
+                          : atomic_fetch_sub(&s_holders, 1);
+  if (!hold && before <= 0) {
+    atomic_fetch_add(&s_holders, 1); // unbalanced release
+    return;
+  }
+  // Only the idle <-> streaming edges change anything.
+  if ((hold && before == 0) || (!hold && before == 1)) {
+    apply_ps();
+  }
+}
+
+esp_err_t wifi_perf_set_tx_power(int dbm) {
+  if (dbm != 0 &&
+      (dbm < WIFI_PERF_TX_POWER_MIN_DBM || dbm > WIFI_PERF_TX_POWER_MAX_DBM)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  esp_err_t err = apply_tx_power(dbm);
+  if (err != ESP_OK) {
+    return err;
+  }
+  s_tx_power_dbm = dbm;
+  return store_i8(WIFI_NVS_TX_POWER, (int8_t)dbm);
+}
+
+esp_err_t wifi_perf_set_bandwidth(wifi_bandwidth_t bw) {
+  if (bw != WIFI_BW_HT20 && bw != WIFI_BW_HT40) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  esp_err_t err = esp_wifi_set_bandwidth(WIFI_IF_STA, bw);
+  if (err != ESP_OK) {
+    return err;
+  }
+  s_bandwidth = bw;
+  return store_i8(WIFI_NVS_BANDWIDTH, (int8_t)bw);
+}
+
+void wifi_perf_get_status(wifi_perf_status_t *out) {
+  if (!out) {
+    return;
+  }
+  memset(out, 0, sizeof(*out));
+  out->holders = atomic_load(&s_holders);
+  out->streaming = out->holders > 0;
+  out->ps = s_ps;
+  out->tx_power_dbm = s_tx_power_dbm;
+  int8_t quarter = 0;
+  if (esp_wifi_get_max_tx_power(&quarter) == ESP_OK) {
+    out->tx_power_actual_dbm = quarter / 4.0f;
+  }
+  wifi_bandwidth_t bw = s_bandwidth;
+  if (esp_wifi_get_bandwidth(WIFI_IF_STA, &bw) == ESP_OK) {
+    out->bandwidth = bw;
+  } else {
+    out->bandwidth = s_bandwidth;
+  }
+}
+
+bool wifi_perf_parse_bandwidth(const char *name, wifi_bandwidth_t *out) {
+  if (!name || !out) {
+    return false;
+  }
+  if (strcmp(name, "ht20") == 0) {
+    *out = WIFI_BW_HT20;
+    return true;
+  }
+  if (strcmp(name, "ht40") == 0) {
+    *out = WIFI_BW_HT40;
+    return true;
+  }
+  return false;
+}
+
+const char *wifi_perf_bandwidth_name(wifi_bandwidth_t bw) {
+  return bw == WIFI_BW_HT40 ? "ht40" : "ht20";
+}
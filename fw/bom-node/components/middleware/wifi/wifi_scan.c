@@ -0,0 +1,152 @@
+#include "wifi_scan.h"
+
+#include <stdatomic.h>
+#include <string.h>
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include "wifi_config.h"
+#include "wifi_perf.h"
+
+#define TAG "wifi_scan"
+
+#define SCAN_DONE_BIT (1u << 0)
+
+// Short off-channel dwells with a return to the home channel between them,
+// so a scan while associated delays uplink frames by tens of ms rather than
+// dropping the link for the whole sweep.
+#define SCAN_ACTIVE_MIN_MS 50
+#define SCAN_ACTIVE_MAX_MS 120
+#define SCAN_HOME_DWELL_MS 30
+
+static SemaphoreHandle_t s_mutex = NULL; // guards s_cache and s_taken_us
+static EventGroupHandle_t s_events = NULL;
+static esp_timer_handle_t s_timer = NULL;
+static wifi_scan_result_t s_cache;
+static int64_t s_taken_us = -1;
+static atomic_bool s_scanning = false;
+
+static void on_scan_done(void *arg, esp_event_base_t base, int32_t id,
+                         void *data) {
+  (void)arg;
+  (void)base;
+  (void)id;
+  const wifi_event_sta_scan_done_t *ev = data;
+  if (ev && ev->status == 0) {
+    uint16_t count = MAX_WIFI_SCAN_RESULTS;
+    if (xSemaphoreTake(s_mutex, portMAX_DELAY) == pdTRUE) {
+      if (esp_wifi_scan_get_ap_records(&count, s_cache.records) == ESP_OK) {
+        s_cache.count = count;
+        s_taken_us = esp_timer_get_time();
+      }
+      xSemaphoreGive(s_mutex);
+    }
+    ESP_LOGD(TAG, "Scan done, %u networks", (unsigned)count);
+  } else {
+    esp_wifi_clear_ap_list();
+    ESP_LOGW(TAG, "Scan failed");
+  }
+  atomic_store(&s_scanning, false);
+  xEventGroupSetBits(s_events, SCAN_DONE_BIT);
+}
+
+static void on_schedule(void *arg) {
+  (void)arg;
+  wifi_perf_status_t perf;
+  wifi_perf_get_status(&perf);
+  if (perf.streaming) {
+    ESP_LOGD(TAG, "Scheduled scan skipped while streaming");
+    return;
+  }
+  wifi_scan_request();
+}
+
+void wifi_scan_init(void) {
+  if (s_mutex) {
+    return;
+  }
+  s_mutex = xSemaphoreCreateMutex();
+  s_events = xEventGroupCreate();
+  memset(&s_cache, 0, sizeof(s_cache));
+  esp_event_handler_instance_register(WIFI_EVENT, WIFI_EVENT_SCAN_DONE,
+                                      on_scan_done, NULL, NULL);
+
+#if CONFIG_MIDDLEWARE_WIFI_SCAN_INTERVAL_S > 0
+  const esp_timer_create_args_t args = {.callback = on_schedule,
+                                        .name = "wifi_scan"};
+  if (esp_timer_create(&args, &s_timer) == ESP_OK) {
+    esp_timer_start_periodic(
+        s_timer, (uint64_t)CONFIG_MIDDLEWARE_WIFI_SCAN_INTERVAL_S * 1000000);
+  }
+#else
+  (void)on_schedule;
+  (void)s_timer;
+#endif
+}
+
+esp_err_t wifi_scan_request(void) {
+  if (!s_mutex) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  bool expected = false;
+  if (!atomic_compare_exchange_strong(&s_scanning, &expected, true)) {
+    return ESP_OK; // joins the scan in flight
+  }
+
+  // Scanning needs the station interface.
+  if (get_wifi_mode() == WIFI_MODE_AP) {
+    esp_wifi_set_mode(WIFI_MODE_APSTA);
+    set_wifi_mode(WIFI_MODE_APSTA);
+  }
+
+  wifi_scan_config_t cfg = {
+      .show_hidden = false,
+      .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+      .scan_time.active = {.min = SCAN_ACTIVE_MIN_MS,
+                           .max = SCAN_ACTIVE_MAX_MS},
+      .home_chan_dwell_time = SCAN_HOME_DWELL_MS,
+  };
+  xEventGroupClearBits(s_events, SCAN_DONE_BIT);
+  esp_err_t err = esp_wifi_scan_start(&cfg, false);
+  if (err != ESP_OK) {
+    // E.g. while the station is connecting; the cache stays as it is.
+    ESP_LOGW(TAG, "Scan not started: %s", esp_err_to_name(err));
+    atomic_store(&s_scanning, false);
+    xEventGroupSetBits(s_events, SCAN_DONE_BIT);
+  }
+  return err;
+}
+
+void wifi_scan_get(wifi_scan_result_t *out, int64_t *age_ms, bool *scanning) {
+  int64_t taken_us = -1;
+  if (s_mutex && xSemaphoreTake(s_mutex, portMAX_DELAY) == pdTRUE) {
+    if (out) {
+      *out = s_cache;
+    }
+    taken_us = s_taken_us;
+    xSemaphoreGive(s_mutex);
+  } else if (out) {
+    memset(out, 0, sizeof(*out));
+  }
+  if (age_ms) {
+    *age_ms = taken_us < 0 ? -1 : (esp_timer_get_time() - taken_us) / 1000;
+  }
+  if (scanning) {
+    *scanning = atomic_load(&s_scanning);
+  }
+}
+
+esp_err_t wifi_scan_wait(uint32_t timeout_ms) {
+  esp_err_t err = wifi_scan_request();
+  if (err != ESP_OK) {
+    return err;
+  }
+  const EventBits_t bits = xEventGroupWaitBits(
+      s_events, SCAN_DONE_BIT, pdFALSE, pdTRUE, pdMS_TO_TICKS(timeout_ms));
+  return (bits & SCAN_DONE_BIT) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
@@ -1,6 +1,27 @@
 #pragma once
 
+#include <stdbool.h>
+
 #include "esp_err.h"
 
+// Firmware updates from OTAdrive.
+//
+// Checks run on one long-lived low-priority task (CONFIG_OTA_TASK_PRIORITY):
+// at start, then every CONFIG_OTA_CHECK_INTERVAL_MIN give or take 20%, and
+// whenever ota_check_for_update() asks. A new
+// image is downloaded at no more than CONFIG_OTA_RATE_KBPS into the spare
+// app partition, with the progress saved to NVS every 64 KB; an interrupted
+// download resumes there with an HTTP range request on the next check.
+
 esp_err_t ota_init(void);
+// Starts the update task, which checks right away.
+esp_err_t ota_start(void);
+// Wakes the update task for a check now. ESP_ERR_INVALID_STATE before
+// ota_start().
 esp_err_t ota_check_for_update(void);
+
+// Called with true before the downloaded image is verified and made the
+// boot partition, and with false if that fails and the device keeps
+// running. A success reboots without the second call.
+typedef void (*ota_swap_hook)(bool swapping);
+void ota_set_swap_hook(ota_swap_hook hook);
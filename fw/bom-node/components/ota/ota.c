@@ -1,15 +1,52 @@
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "esp_crt_bundle.h"
+#include "esp_http_client.h"
 #include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_ota_ops.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "nvs.h"
 #include "otadrive_esp.h"
+#include "sdkconfig.h"
 
 #include "ota.h"
 
 static const char *TAG = "ota";
-static TaskHandle_t s_ota_check_task = NULL;
+
+#define OTA_TASK_STACK 8192
+#define OTA_TASK_PRIO CONFIG_OTA_TASK_PRIORITY
+#define OTA_READ_BYTES 1024
+// Progress is saved at these boundaries, whole flash sectors, so a resumed
+// download continues at the start of a sector that was never written.
+#define OTA_PROGRESS_BYTES (64 * 1024)
+#define OTA_ATTEMPTS 5
+#define OTA_RETRY_MS 5000
+#define OTA_URL_MAX 256
+// Periodic checks land anywhere within this share of the interval either
+// side, so units booted together do not poll the server together.
+#define OTA_JITTER_PCT 20
+
+#define OTA_NVS_NAMESPACE "ota"
+#define OTA_NVS_PROGRESS "progress"
+
+// What the partition holds of a download that did not finish.
+typedef struct {
+  char version[32];
+  uint32_t size;
+  uint32_t offset;    // bytes in flash, a multiple of OTA_PROGRESS_BYTES
+  uint32_t partition; // address of the partition written
+} ota_progress_t;
+
+static TaskHandle_t s_ota_task = NULL;
+static ota_swap_hook s_swap_hook = NULL;
 
 esp_err_t ota_init(void) {
   if (CONFIG_OTA_API_KEY[0] == '\0') {
@@ -22,20 +59,224 @@ esp_err_t ota_init(void) {
   return ESP_OK;
 }
 
-static void ota_check_task(void *arg) {
+void ota_set_swap_hook(ota_swap_hook hook) { s_swap_hook = hook; }
+
+static bool ota_load_progress(ota_progress_t *p) {
+  nvs_handle_t handle;
+  if (nvs_open(OTA_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+    return false;
+  }
+  size_t len = sizeof(*p);
+  const esp_err_t err = nvs_get_blob(handle, OTA_NVS_PROGRESS, p, &len);
+  nvs_close(handle);
+  return err == ESP_OK && len == sizeof(*p);
+}
+
+static void ota_store_progress(const ota_progress_t *p) {
+  nvs_handle_t handle;
+  esp_err_t err = nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE, &handle);
+  if (err != ESP_OK) {
+    return;
+  }
+  if (p) {
+    err = nvs_set_blob(handle, OTA_NVS_PROGRESS, p, sizeof(*p));
+  } else {
+    err = nvs_erase_key(handle, OTA_NVS_PROGRESS);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+      err = ESP_OK;
+    }
+  }
+  if (err == ESP_OK) {
+    err = nvs_commit(handle);
+  }
+  nvs_close(handle);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Failed to store progress: %s", esp_err_to_name(err));
+  }
+}
+
+// The OTAdrive device API the client library downloads from, identified by
+// the station MAC.
+static void ota_image_url(char *url, size_t len) {
+  uint8_t mac[6] = {0};
+  esp_read_mac(mac, ESP_MAC_WIFI_STA);
+  snprintf(url, len, "%s?k=%s&v=%s&s=%02X%02X%02X%02X%02X%02X",
+           CONFIG_OTA_SERVER_URL, CONFIG_OTA_API_KEY,
+           CONFIG_OTA_CURRENT_VERSION, mac[0], mac[1], mac[2], mac[3], mac[4],
+           mac[5]);
+}
+
+// Sleeps as long as `bytes` since `start_us` are ahead of the rate limit.
+static void ota_throttle(int64_t start_us, uint32_t bytes) {
+  const int64_t due_us =
+      start_us + (int64_t)bytes * 1000000 / (CONFIG_OTA_RATE_KBPS * 1024);
+  const int64_t ahead_ms = (due_us - esp_timer_get_time()) / 1000;
+  if (ahead_ms > 0 && pdMS_TO_TICKS(ahead_ms) > 0) {
+    vTaskDelay(pdMS_TO_TICKS(ahead_ms));
+  }
+}
+
+// One request from p->offset on. Returns ESP_OK once the whole image is in
+// flash; otherwise p->offset is where the next attempt resumes.
+static esp_err_t ota_fetch(const char *url, ota_progress_t *p,
+                           esp_ota_handle_t ota) {
+  static char buf[OTA_READ_BYTES];
+  esp_http_client_config_t cfg = {
+      .url = url,
+      .timeout_ms = 10000,
+      .crt_bundle_attach = esp_crt_bundle_attach,
+  };
+  esp_http_client_handle_t client = esp_http_client_init(&cfg);
+  if (!client) {
+    return ESP_ERR_NO_MEM;
+  }
+  char range[32];
+  snprintf(range, sizeof(range), "bytes=%lu-", (unsigned long)p->offset);
+  esp_http_client_set_header(client, "Range", range);
+
+  esp_err_t err = esp_http_client_open(client, 0);
+  if (err == ESP_OK && esp_http_client_fetch_headers(client) < 0) {
+    err = ESP_FAIL;
+  }
+  const int status = err == ESP_OK ? esp_http_client_get_status_code(client) : 0;
+  if (err == ESP_OK && p->offset > 0 && status != 206) {
+    // The server ignored the range; the body starts at the beginning.
+    ESP_LOGW(TAG, "Server cannot resume (HTTP %d)", status);
+    err = ESP_ERR_NOT_SUPPORTED;
+  } else if (err == ESP_OK && status != 200 && status != 206) {
+    ESP_LOGE(TAG, "Download failed (HTTP %d)", status);
+    err = ESP_FAIL;
+  }
+
+  const int64_t start_us = esp_timer_get_time();
+  const uint32_t start = p->offset;
+  uint32_t done = p->offset;
+  while (err == ESP_OK && done < p->size) {
+    // Reads stop at each progress boundary so it can be saved exactly there.
+    const uint32_t boundary = (done / OTA_PROGRESS_BYTES + 1) * OTA_PROGRESS_BYTES;
+    uint32_t want = boundary - done;
+    want = want < sizeof(buf) ? want : sizeof(buf);
+    want = want < p->size - done ? want : p->size - done;
+    const int n = esp_http_client_read(client, buf, want);
+    if (n <= 0) {
+      err = ESP_FAIL;
+      break;
+    }
+    err = esp_ota_write(ota, buf, n);
+    if (err != ESP_OK) {
+      ESP_LOGE(TAG, "Flash write failed: %s", esp_err_to_name(err));
+      break;
+    }
+    done += n;
+    if (done % OTA_PROGRESS_BYTES == 0 && done < p->size) {
+      p->offset = done;
+      ota_store_progress(p);
+      ESP_LOGI(TAG, "Downloaded %lu/%lu bytes", (unsigned long)done,
+               (unsigned long)p->size);
+    }
+    ota_throttle(start_us, done - start);
+  }
+  if (err == ESP_OK) {
+    p->offset = done;
+  }
+  esp_http_client_close(client);
+  esp_http_client_cleanup(client);
+  return err;
+}
+
+// Downloads, verifies and boots `version`. Returns only on failure.
+static void ota_update(const char *version, uint32_t size) {
+  const esp_partition_t *part = esp_ota_get_next_update_partition(NULL);
+  if (!part || size == 0 || size > part->size) {
+    ESP_LOGE(TAG, "No partition for a %lu byte image", (unsigned long)size);
+    return;
+  }
+
+  ota_progress_t p = {0};
+  const bool resume = ota_load_progress(&p) &&
+                      strncmp(p.version, version, sizeof(p.version)) == 0 &&
+                      p.size == size && p.partition == part->address &&
+                      p.offset > 0 && p.offset < size;
+  esp_ota_handle_t ota = 0;
+  esp_err_t err;
+  if (resume) {
+    ESP_LOGI(TAG, "Resuming %s at %lu/%lu bytes", version,
+             (unsigned long)p.offset, (unsigned long)size);
+    err = esp_ota_resume(part, OTA_WITH_SEQUENTIAL_WRITES, p.offset, &ota);
+  } else {
+    memset(&p, 0, sizeof(p));
+    strncpy(p.version, version, sizeof(p.version) - 1);
+    p.size = size;
+    p.partition = part->address;
+    err = esp_ota_begin(part, OTA_WITH_SEQUENTIAL_WRITES, &ota);
+  }
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "OTA begin failed: %s", esp_err_to_name(err));
+    return;
+  }
+
+  char url[OTA_URL_MAX];
+  ota_image_url(url, sizeof(url));
+  for (int attempt = 1; attempt <= OTA_ATTEMPTS; attempt++) {
+    err = ota_fetch(url, &p, ota);
+    if (err == ESP_OK) {
+      break;
+    }
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+      // Start over on a freshly erased partition.
+      esp_ota_abort(ota);
+      p.offset = 0;
+      ota_store_progress(NULL);
+      err = esp_ota_begin(part, OTA_WITH_SEQUENTIAL_WRITES, &ota);
+      if (err != ESP_OK) {
+        ESP_LOGE(TAG, "OTA begin failed: %s", esp_err_to_name(err));
+        return;
+      }
+      continue;
+    }
+    ESP_LOGW(TAG, "Download interrupted at %lu bytes (attempt %d/%d)",
+             (unsigned long)p.offset, attempt, OTA_ATTEMPTS);
+    vTaskDelay(pdMS_TO_TICKS(OTA_RETRY_MS));
+  }
+  if (err != ESP_OK) {
+    // The saved progress lets the next check pick up from here.
+    esp_ota_abort(ota);
+    return;
+  }
+
+  // Verification reads the whole image back and the swap rewrites otadata;
+  // audio that would go out over the network waits for the reboot.
+  if (s_swap_hook) {
+    s_swap_hook(true);
+  }
+  err = esp_ota_end(ota);
+  if (err == ESP_OK) {
+    err = esp_ota_set_boot_partition(part);
+  }
+  ota_store_progress(NULL);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Image rejected: %s", esp_err_to_name(err));
+    if (s_swap_hook) {
+      s_swap_hook(false);
+    }
+    return;
+  }
+  ESP_LOGI(TAG, "Updated to %s, rebooting", version);
+  esp_restart();
+}
+
+static void ota_check(void) {
   otadrive_result r = otadrive_updateFirmwareInfo();
 
   switch (r.code) {
   case OTADRIVE_NewFirmwareExists:
     ESP_LOGI(TAG, "Update available: %s (%ld bytes), current %s", r.version,
              (long)r.size, otadrive_currentversion());
-    r = otadrive_updateFirmware(true);
-    if (r.code != OTADRIVE_Success) {
-      ESP_LOGE(TAG, "Firmware update failed (%d)", r.code);
-    }
+    ota_update(r.version, (uint32_t)r.size);
     break;
   case OTADRIVE_AlreadyUpToDate:
     ESP_LOGI(TAG, "Firmware is up to date (%s)", otadrive_currentversion());
+    ota_store_progress(NULL);
     break;
   case OTADRIVE_DeviceUnauthorized:
     ESP_LOGE(TAG, "Device unauthorized");
@@ -47,21 +288,50 @@ static void ota_check_task(void *arg) {
     ESP_LOGE(TAG, "Failed to check firmware (%d)", r.code);
     break;
   }
+}
 
-  s_ota_check_task = NULL;
-  vTaskDelete(NULL);
+static TickType_t ota_next_wait(void) {
+  if (CONFIG_OTA_CHECK_INTERVAL_MIN == 0) {
+    return portMAX_DELAY;
+  }
+  const uint64_t interval_ms = (uint64_t)CONFIG_OTA_CHECK_INTERVAL_MIN * 60000;
+  const uint64_t jitter_ms = interval_ms * OTA_JITTER_PCT / 100;
+  const uint64_t wait_ms =
+      interval_ms - jitter_ms + esp_random() % (2 * jitter_ms + 1);
+  return pdMS_TO_TICKS(wait_ms);
 }
 
-esp_err_t ota_check_for_update(void) {
-  if (s_ota_check_task != NULL) {
-    return ESP_ERR_INVALID_STATE;
+// The one update task: checks at start, then on each interval or request.
+static void ota_task(void *arg) {
+  (void)arg;
+  while (true) {
+    ota_check();
+    const TickType_t wait = ota_next_wait();
+    if (wait != portMAX_DELAY) {
+      ESP_LOGI(TAG, "Next check in %lu min",
+               (unsigned long)(wait / pdMS_TO_TICKS(60000)));
+    }
+    ulTaskNotifyTake(pdTRUE, wait);
   }
+}
 
-  if (xTaskCreate(ota_check_task, "ota_check", 12288, NULL, 5,
-                  &s_ota_check_task) != pdPASS) {
-    s_ota_check_task = NULL;
+esp_err_t ota_start(void) {
+  if (s_ota_task != NULL) {
+    return ESP_OK;
+  }
+  if (xTaskCreate(ota_task, "ota", OTA_TASK_STACK, NULL, OTA_TASK_PRIO,
+                  &s_ota_task) != pdPASS) {
+    s_ota_task = NULL;
     return ESP_ERR_NO_MEM;
   }
+  return ESP_OK;
+}
 
+esp_err_t ota_check_for_update(void) {
+  if (s_ota_task == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  // A request during a check runs one more check after it.
+  xTaskNotifyGive(s_ota_task);
   return ESP_OK;
 }
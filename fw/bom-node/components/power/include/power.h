@@ -0,0 +1,27 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdio.h>
+
+#include "esp_err.h"
+
+// Dynamic frequency scaling and tickless idle.
+//
+// The CPU runs at CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ while any
+// ESP_PM_CPU_FREQ_MAX lock is held and at CONFIG_POWER_MIN_CPU_MHZ
+// otherwise; with CONFIG_POWER_LIGHT_SLEEP an idle system also enters
+// automatic light sleep. The audio hot paths hold such a lock only while
+// they process (the mic reader per DMA chunk, detection per drained tap
+// queue, the streamer per frame sent). The I2S and Wi-Fi drivers hold their
+// own APB locks while active, so capture timing does not move with the CPU
+// clock, and the running I2S channel keeps light sleep out.
+// Needs CONFIG_PM_ENABLE; without it power_init() returns
+// ESP_ERR_NOT_SUPPORTED and the locks are never created.
+
+esp_err_t power_init(void);
+
+// Writes the configuration and the registered locks; with
+// CONFIG_PM_PROFILING also the time spent in each power mode.
+void power_report(FILE *out);
+
+#endif
@@ -0,0 +1,57 @@
+#include "power.h"
+
+#include <stdbool.h>
+
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "POWER";
+
+#if defined(CONFIG_POWER_LIGHT_SLEEP)
+#define POWER_LIGHT_SLEEP true
+#else
+#define POWER_LIGHT_SLEEP false
+#endif
+
+static bool s_enabled = false;
+
+esp_err_t power_init(void) {
+#ifdef CONFIG_PM_ENABLE
+  const esp_pm_config_t cfg = {
+      .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+      .min_freq_mhz = CONFIG_POWER_MIN_CPU_MHZ,
+      .light_sleep_enable = POWER_LIGHT_SLEEP,
+  };
+  esp_err_t err = esp_pm_configure(&cfg);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "esp_pm_configure failed: %s", esp_err_to_name(err));
+    return err;
+  }
+  s_enabled = true;
+  ESP_LOGI(TAG, "DFS %d-%d MHz, light sleep %s", cfg.min_freq_mhz,
+           cfg.max_freq_mhz, cfg.light_sleep_enable ? "on" : "off");
+  return ESP_OK;
+#else
+  ESP_LOGI(TAG, "Power management disabled (CONFIG_PM_ENABLE)");
+  return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void power_report(FILE *out) {
+  if (!out) {
+    return;
+  }
+  if (!s_enabled) {
+    fprintf(out, "Power management disabled\n");
+    return;
+  }
+#ifdef CONFIG_PM_ENABLE
+  fprintf(out, "DFS %d-%d MHz, light sleep %s\n", CONFIG_POWER_MIN_CPU_MHZ,
+          CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, POWER_LIGHT_SLEEP ? "on" : "off");
+#ifndef CONFIG_PM_PROFILING
+  fprintf(out, "Mode times need CONFIG_PM_PROFILING\n");
+#endif
+  esp_pm_dump_locks(out);
+#endif
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Local recording to an SD card, for sites without a dependable uplink.
+//
+// CONFIG_SD_RECORDER_CONTINUOUS records the stereo mic stream as a series
+// of WAV files of CONFIG_SD_RECORDER_SEGMENT_S each. A tap subscriber
+// interleaves the samples into one of two blocks of
+// CONFIG_SD_RECORDER_BLOCK_KB; a full block goes to a low-priority writer
+// task, which writes it in one call while the other block fills. Blocks are
+// multiples of the 4 KB FAT sector, and each file starts on one, so every
+// write but the last of a file covers whole sectors from a word-aligned
+// buffer: FATFS hands them to the card driver as one multi-sector DMA
+// transfer, without staging them through its sector window. A write that
+// takes longer than a block lasts only costs the taps that find both blocks
+// taken; the reader never waits. Those taps are counted and the recording
+// resumes in a new file, so no file has a hole in its timeline.
+//
+// CONFIG_SD_RECORDER_EVENTS writes one file per detected impulse instead,
+// holding the detector's pre/post clip read from the mic history
+// (mic_history.h), which has to be long enough to hold it.
+//
+// Files are named R<seq>.WAV (continuous) or E<seq>.WAV (events) in
+// /sdcard/REC, with a sequence number that carries on across reboots. They
+// start with the stamped header (audio_wav.h) of a stream of unknown
+// length, whose sizes are filled in when the file is closed. Before a file
+// is opened, the oldest recordings are deleted until
+// CONFIG_SD_RECORDER_MIN_FREE_MB are free.
+
+// Mounts the card, subscribes to the taps or the detector and starts the
+// writer task. Call after the mic is initialised and before
+// impulse_detector_start(); does nothing without CONFIG_SD_RECORDER, and
+// leaves the recorder off when no card is found.
+void sd_recorder_init(void);
+
+typedef struct {
+  bool mounted;
+  bool recording;          // a file is open
+  uint32_t files;          // files opened since boot
+  uint32_t deleted;        // oldest files removed to keep space free
+  uint32_t overruns;       // taps lost because both blocks were taken
+  uint32_t events_lost;    // events whose clip had left the history
+  uint32_t write_errors;   // failed writes, opens and closes
+  uint32_t write_max_us;   // slowest block write
+  uint64_t bytes_written;  // since boot
+  uint64_t card_bytes;     // capacity of the FAT volume
+  uint64_t free_bytes;     // free space, as of the last file opened
+  uint32_t oldest_seq;     // sequence numbers of the recordings on the card
+  uint32_t newest_seq;
+  char current[16];        // name of the open file, "" when none
+} sd_recorder_stats_t;
+
+void sd_recorder_get_stats(sd_recorder_stats_t *stats);
@@ -0,0 +1,629 @@
+#include "sd_recorder.h"
+
+#include "sdkconfig.h"
+
+#ifdef CONFIG_SD_RECORDER
+
+#include "audio_arena.h"
+#include "audio_wav.h"
+#include "detector.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_vfs_fat.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "metrics.h"
+#include "mic_history.h"
+#include "mic_input.h"
+#include "sdmmc_cmd.h"
+#if CONFIG_SD_RECORDER_BUS_SDMMC
+#include "driver/sdmmc_host.h"
+#else
+#include "driver/sdspi_host.h"
+#include "driver/spi_common.h"
+#endif
+
+#include <dirent.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static const char *TAG = "SD_RECORDER";
+
+#define SD_MOUNT "/sdcard"
+#define SD_DIR SD_MOUNT "/REC"
+#define SD_NAME_LEN 16 // "R1234567.WAV" and its NUL
+#define SD_PATH_LEN (sizeof(SD_DIR) + SD_NAME_LEN)
+#define SD_SEQ_MAX 9999999u
+
+// Whole FAT sectors (CONFIG_FATFS_SECTOR_4096) per write.
+#define SD_SECTOR_BYTES 4096
+#define SD_BLOCK_BYTES                                                         \
+  ((CONFIG_SD_RECORDER_BLOCK_KB * 1024 / SD_SECTOR_BYTES) * SD_SECTOR_BYTES)
+#define SD_FRAME_BYTES (2 * (int)sizeof(int16_t))
+// Stamped PCM header; a multiple of SD_FRAME_BYTES, so the frames after it
+// stay aligned.
+#define SD_HEADER_BYTES (AUDIO_WAV_HEADER_BYTES + AUDIO_WAV_STAMP_BYTES)
+#define SD_FREE_MIN_BYTES ((uint64_t)CONFIG_SD_RECORDER_MIN_FREE_MB << 20)
+
+#define SD_TASK_STACK 4096
+#define SD_TASK_PRIO CONFIG_SD_RECORDER_TASK_PRIORITY
+#define SD_TASK_CORE CONFIG_SD_RECORDER_TASK_CORE
+#define SD_HISTORY_POLL_MS 20
+#define SD_QUEUE_LEN 4
+
+#if CONFIG_SD_RECORDER_CONTINUOUS
+#define SD_PREFIX 'R'
+// Queue items: a block index, or SD_CLOSE to end the file without one.
+#define SD_CLOSE (-1)
+#else
+#define SD_PREFIX 'E'
+#endif
+
+typedef struct {
+  uint8_t *data;
+  size_t len;           // bytes filled, header included
+  bool opens_file;      // data starts with SD_HEADER_BYTES for the header
+  bool closes_file;
+  int sample_rate;      // with opens_file
+  audio_wav_stamp stamp;
+  _Atomic bool busy;    // handed to the writer task
+} sd_block;
+
+typedef struct {
+  uint32_t epoch;
+  uint64_t start;
+  int length;
+  int sample_rate;
+  int64_t start_us;
+  int64_t start_unix_us;
+} sd_event;
+
+static sd_block s_blocks[2];
+static QueueHandle_t s_queue = NULL;
+static sdmmc_card_t *s_card = NULL;
+
+// Writer task state.
+static FILE *s_file = NULL;
+static uint8_t s_header[SD_HEADER_BYTES];
+static uint32_t s_data_bytes = 0; // PCM data bytes in s_file
+static uint32_t s_next_seq = 1;
+
+#if CONFIG_SD_RECORDER_CONTINUOUS
+// Reader task state.
+static sd_block *s_fill = NULL; // block being filled
+static int s_next_block = 0;
+static bool s_file_open = false; // the blocks handed over belong to a file
+static uint32_t s_epoch = 0;
+static uint64_t s_next_index = 0;
+static uint32_t s_file_frames = 0;
+static mic_subscription *s_sub = NULL;
+#endif
+
+static portMUX_TYPE s_stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static sd_recorder_stats_t s_stats;
+
+static metrics_counter s_overruns = METRICS_COUNTER_INIT(
+    "sd_recorder_overruns_total", "Taps lost because both SD blocks were taken.");
+static metrics_counter s_files = METRICS_COUNTER_INIT(
+    "sd_recorder_files_total", "Recording files opened.");
+static metrics_counter s_write_errors = METRICS_COUNTER_INIT(
+    "sd_recorder_write_errors_total", "Failed SD writes, opens and closes.");
+static metrics_histogram s_write_us = METRICS_HISTOGRAM_INIT(
+    "sd_recorder_write_us", "SD block write duration [us]", 1000, 2500, 5000,
+    10000, 25000, 50000, 100000, 250000);
+
+static void sd_recorder_error(const char *what) {
+  ESP_LOGW(TAG, "%s failed", what);
+  metrics_counter_inc(&s_write_errors);
+  portENTER_CRITICAL(&s_stats_mux);
+  s_stats.write_errors++;
+  portEXIT_CRITICAL(&s_stats_mux);
+}
+
+static void sd_recorder_path(char *out, char prefix, uint32_t seq) {
+  snprintf(out, SD_PATH_LEN, SD_DIR "/%c%07" PRIu32 ".WAV", prefix, seq);
+}
+
+// Parses "R1234567.WAV" / "E1234567.WAV"; 0 for anything else.
+static uint32_t sd_recorder_seq_of(const char *name) {
+  if ((name[0] != 'R' && name[0] != 'E') || strlen(name) != 12 ||
+      strcmp(&name[8], ".WAV") != 0) {
+    return 0;
+  }
+  uint32_t seq = 0;
+  for (int i = 1; i < 8; i++) {
+    if (name[i] < '0' || name[i] > '9') {
+      return 0;
+    }
+    seq = seq * 10 + (uint32_t)(name[i] - '0');
+  }
+  return seq;
+}
+
+// Picks up the sequence numbers of the recordings already on the card.
+static void sd_recorder_scan(void) {
+  uint32_t oldest = 0, newest = 0;
+  DIR *dir = opendir(SD_DIR);
+  if (dir) {
+    struct dirent *e;
+    while ((e = readdir(dir)) != NULL) {
+      const uint32_t seq = sd_recorder_seq_of(e->d_name);
+      if (seq == 0) {
+        continue;
+      }
+      if (oldest == 0 || seq < oldest) {
+        oldest = seq;
+      }
+      if (seq > newest) {
+        newest = seq;
+      }
+    }
+    closedir(dir);
+  }
+  s_next_seq = newest < SD_SEQ_MAX ? newest + 1 : 1;
+  s_stats.oldest_seq = oldest;
+  s_stats.newest_seq = newest;
+}
+
+static void sd_recorder_update_space(void) {
+  uint64_t total = 0, free_bytes = 0;
+  if (esp_vfs_fat_info(SD_MOUNT, &total, &free_bytes) != ESP_OK) {
+    return;
+  }
+  portENTER_CRITICAL(&s_stats_mux);
+  s_stats.card_bytes = total;
+  s_stats.free_bytes = free_bytes;
+  portEXIT_CRITICAL(&s_stats_mux);
+}
+
+// Deletes the oldest recordings until SD_FREE_MIN_BYTES are free, or none
+// are left to delete.
+static void sd_recorder_make_room(void) {
+  sd_recorder_update_space();
+  while (s_stats.free_bytes < SD_FREE_MIN_BYTES && s_stats.oldest_seq != 0) {
+    const uint32_t seq = s_stats.oldest_seq;
+    char path[SD_PATH_LEN];
+    bool removed = false;
+    sd_recorder_path(path, 'R', seq);
+    removed |= remove(path) == 0;
+    sd_recorder_path(path, 'E', seq);
+    removed |= remove(path) == 0;
+    portENTER_CRITICAL(&s_stats_mux);
+    s_stats.deleted += removed ? 1 : 0;
+    s_stats.oldest_seq = seq < s_stats.newest_seq ? seq + 1 : 0;
+    portEXIT_CRITICAL(&s_stats_mux);
+    if (removed) {
+      ESP_LOGI(TAG, "Deleted recording %" PRIu32 " for space", seq);
+      sd_recorder_update_space();
+    }
+  }
+}
+
+// Writes the patched header over the provisional one and closes the file.
+static void sd_recorder_close(void) {
+  if (!s_file) {
+    return;
+  }
+  audio_wav_patch_pcm_sizes(s_header, sizeof(s_header), s_data_bytes);
+  if (fseek(s_file, 0, SEEK_SET) != 0 ||
+      fwrite(s_header, 1, sizeof(s_header), s_file) != sizeof(s_header)) {
+    sd_recorder_error("Header patch");
+  }
+  if (fclose(s_file) != 0) {
+    sd_recorder_error("Close");
+  }
+  s_file = NULL;
+  portENTER_CRITICAL(&s_stats_mux);
+  s_stats.recording = false;
+  s_stats.current[0] = '\0';
+  portEXIT_CRITICAL(&s_stats_mux);
+}
+
+// Opens the next file; its header goes into the first SD_HEADER_BYTES of
+// `first`, the buffer of the file's first write.
+static bool sd_recorder_open(uint8_t *first, int sample_rate,
+                             const audio_wav_stamp *stamp) {
+  sd_recorder_close();
+  sd_recorder_make_room();
+  char path[SD_PATH_LEN];
+  const uint32_t seq = s_next_seq;
+  sd_recorder_path(path, SD_PREFIX, seq);
+  s_file = fopen(path, "wb");
+  if (!s_file) {
+    sd_recorder_error("Open");
+    return false;
+  }
+  // Unbuffered: blocks go to FATFS as they are, not through a copy.
+  setvbuf(s_file, NULL, _IONBF, 0);
+  s_next_seq = seq < SD_SEQ_MAX ? seq + 1 : 1;
+  s_data_bytes = 0;
+  audio_wav_build_header(s_header, sample_rate, 2, stamp);
+  memcpy(first, s_header, sizeof(s_header));
+
+  metrics_counter_inc(&s_files);
+  portENTER_CRITICAL(&s_stats_mux);
+  s_stats.files++;
+  s_stats.recording = true;
+  s_stats.newest_seq = seq;
+  if (s_stats.oldest_seq == 0) {
+    s_stats.oldest_seq = seq;
+  }
+  strncpy(s_stats.current, &path[sizeof(SD_DIR)], sizeof(s_stats.current) - 1);
+  portEXIT_CRITICAL(&s_stats_mux);
+  return true;
+}
+
+static bool sd_recorder_write(const uint8_t *data, size_t len, size_t header) {
+  if (!s_file) {
+    return false;
+  }
+  const int64_t start = esp_timer_get_time();
+  const size_t done = fwrite(data, 1, len, s_file);
+  const uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+  metrics_histogram_observe(&s_write_us, us);
+  s_data_bytes += (uint32_t)(done > header ? done - header : 0);
+  portENTER_CRITICAL(&s_stats_mux);
+  s_stats.bytes_written += done;
+  if (us > s_stats.write_max_us) {
+    s_stats.write_max_us = us;
+  }
+  portEXIT_CRITICAL(&s_stats_mux);
+  if (done != len) {
+    // Card full or gone: give up on this file; the next one makes room.
+    sd_recorder_error("Write");
+    sd_recorder_close();
+    return false;
+  }
+  return true;
+}
+
+#if CONFIG_SD_RECORDER_CONTINUOUS
+
+// Hands the block being filled to the writer.
+static void sd_recorder_hand_over(bool closes_file) {
+  sd_block *b = s_fill;
+  s_fill = NULL;
+  b->closes_file = closes_file;
+  const int item = (int)(b - s_blocks);
+  // Two blocks and one close marker at most are ever queued.
+  xQueueSend(s_queue, &item, 0);
+}
+
+// Ends the open file, if any, with the block being filled.
+static void sd_recorder_end_file(void) {
+  if (s_fill) {
+    sd_recorder_hand_over(true);
+  } else if (s_file_open) {
+    const int item = SD_CLOSE;
+    xQueueSend(s_queue, &item, 0);
+  }
+  s_file_open = false;
+}
+
+// The next block to fill, starting a file at sample `index` when none is
+// open; NULL while the writer still has it.
+static sd_block *sd_recorder_take_block(uint64_t index) {
+  sd_block *b = &s_blocks[s_next_block];
+  if (atomic_load(&b->busy)) {
+    return NULL;
+  }
+  s_next_block ^= 1;
+  atomic_store(&b->busy, true);
+  b->len = 0;
+  b->opens_file = !s_file_open;
+  b->closes_file = false;
+  if (b->opens_file) {
+    b->len = SD_HEADER_BYTES;
+    b->sample_rate = mic_get_config()->sampling_freq;
+    b->stamp.sample_index = index;
+    b->stamp.uptime_us = mic_sample_time_us(index);
+    b->stamp.unix_us = mic_sample_unix_us(index);
+    s_file_open = true;
+    s_file_frames = 0;
+  }
+  return b;
+}
+
+// Reader task: interleaves the taps into the blocks.
+static void sd_recorder_on_tap(const mic_tap_view *tap, void *ctx) {
+  (void)ctx;
+  if (tap->epoch != s_epoch || tap->sample_index != s_next_index) {
+    // A new rate, or taps that never arrived: the file's timeline ends.
+    sd_recorder_end_file();
+    s_epoch = tap->epoch;
+  }
+  s_next_index = tap->sample_index + (uint64_t)tap->length;
+
+  const uint32_t segment_frames =
+      (uint32_t)CONFIG_SD_RECORDER_SEGMENT_S * mic_get_config()->sampling_freq;
+  int done = 0;
+  while (done < tap->length) {
+    if (!s_fill) {
+      s_fill = sd_recorder_take_block(tap->sample_index + (uint64_t)done);
+      if (!s_fill) {
+        metrics_counter_inc(&s_overruns);
+        portENTER_CRITICAL(&s_stats_mux);
+        s_stats.overruns++;
+        portEXIT_CRITICAL(&s_stats_mux);
+        sd_recorder_end_file();
+        return;
+      }
+    }
+    const int room = (int)((SD_BLOCK_BYTES - s_fill->len) / SD_FRAME_BYTES);
+    const uint32_t left = segment_frames - s_file_frames;
+    int n = tap->length - done;
+    n = n < room ? n : room;
+    n = (uint32_t)n < left ? n : (int)left;
+
+    int16_t *out = (int16_t *)(s_fill->data + s_fill->len);
+    const int16_t *l = &tap->left[done];
+    const int16_t *r = &tap->right[done];
+    for (int i = 0; i < n; i++) {
+      out[2 * i] = l[i];
+      out[2 * i + 1] = r[i];
+    }
+    s_fill->len += (size_t)n * SD_FRAME_BYTES;
+    s_file_frames += (uint32_t)n;
+    done += n;
+
+    if (s_file_frames >= segment_frames) {
+      sd_recorder_end_file();
+    } else if (s_fill->len + SD_FRAME_BYTES > SD_BLOCK_BYTES) {
+      sd_recorder_hand_over(false);
+    }
+  }
+}
+
+static void sd_recorder_task(void *arg) {
+  (void)arg;
+  for (;;) {
+    int item;
+    if (xQueueReceive(s_queue, &item, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    if (item == SD_CLOSE) {
+      sd_recorder_close();
+      continue;
+    }
+    sd_block *b = &s_blocks[item];
+    size_t header = 0;
+    if (b->opens_file) {
+      sd_recorder_open(b->data, b->sample_rate, &b->stamp);
+      header = SD_HEADER_BYTES;
+    }
+    // Blocks of a file that failed to open or write are let go unwritten
+    // until the next file starts.
+    sd_recorder_write(b->data, b->len, header);
+    if (b->closes_file) {
+      sd_recorder_close();
+    }
+    atomic_store(&b->busy, false);
+  }
+}
+
+#else // CONFIG_SD_RECORDER_EVENTS
+
+static void sd_recorder_on_event(const impulse_event *event, void *ctx) {
+  (void)ctx;
+  const bool clip = event->clip_length > 0;
+  sd_event ev = {
+      .epoch = event->epoch,
+      .start = clip ? event->clip_start : event->window_start,
+      .length = clip ? event->clip_length : event->window_length,
+      .sample_rate = event->sample_rate,
+  };
+  ev.start_us = mic_sample_time_us(ev.start);
+  ev.start_unix_us = mic_sample_unix_us(ev.start);
+  if (xQueueSend(s_queue, &ev, 0) != pdTRUE) {
+    portENTER_CRITICAL(&s_stats_mux);
+    s_stats.events_lost++;
+    portEXIT_CRITICAL(&s_stats_mux);
+  }
+}
+
+static mic_history_state sd_recorder_wait_history(const sd_event *ev,
+                                                  uint64_t start, int length) {
+  const int rate = ev->sample_rate > 0 ? ev->sample_rate : 1;
+  const TickType_t deadline =
+      xTaskGetTickCount() + pdMS_TO_TICKS((int64_t)length * 1000 / rate + 1000);
+  mic_history_state st;
+  while ((st = mic_history_check(ev->epoch, start, length)) ==
+             MIC_HISTORY_PENDING &&
+         (int32_t)(deadline - xTaskGetTickCount()) > 0) {
+    vTaskDelay(pdMS_TO_TICKS(SD_HISTORY_POLL_MS));
+  }
+  return st;
+}
+
+// Reads the clip from the history a block at a time: planar into the second
+// block, interleaved into the first, which is then written.
+static void sd_recorder_write_event(const sd_event *ev) {
+  uint8_t *out = s_blocks[0].data;
+  int16_t *left = (int16_t *)s_blocks[1].data;
+  int16_t *right = left + SD_BLOCK_BYTES / SD_FRAME_BYTES;
+  const audio_wav_stamp stamp = {
+      .sample_index = ev->start,
+      .uptime_us = ev->start_us,
+      .unix_us = ev->start_unix_us,
+  };
+  bool open = false;
+  int done = 0;
+  while (done < ev->length) {
+    const size_t header = open ? 0 : SD_HEADER_BYTES;
+    int n = (int)((SD_BLOCK_BYTES - header) / SD_FRAME_BYTES);
+    n = n < ev->length - done ? n : ev->length - done;
+    const uint64_t from = ev->start + (uint64_t)done;
+    if (sd_recorder_wait_history(ev, from, n) != MIC_HISTORY_OK ||
+        mic_history_read(ev->epoch, from, n, left, right) != MIC_HISTORY_OK) {
+      portENTER_CRITICAL(&s_stats_mux);
+      s_stats.events_lost++;
+      portEXIT_CRITICAL(&s_stats_mux);
+      break;
+    }
+    if (!open) {
+      if (!sd_recorder_open(out, ev->sample_rate, &stamp)) {
+        return;
+      }
+      open = true;
+    }
+    int16_t *frames = (int16_t *)(out + header);
+    for (int i = 0; i < n; i++) {
+      frames[2 * i] = left[i];
+      frames[2 * i + 1] = right[i];
+    }
+    if (!sd_recorder_write(out, header + (size_t)n * SD_FRAME_BYTES, header)) {
+      return;
+    }
+    done += n;
+  }
+  sd_recorder_close();
+}
+
+static void sd_recorder_task(void *arg) {
+  (void)arg;
+  for (;;) {
+    sd_event ev;
+    if (xQueueReceive(s_queue, &ev, portMAX_DELAY) == pdTRUE) {
+      sd_recorder_write_event(&ev);
+    }
+  }
+}
+
+#endif // CONFIG_SD_RECORDER_CONTINUOUS
+
+static esp_err_t sd_recorder_mount(void) {
+  const esp_vfs_fat_sdmmc_mount_config_t mount_cfg = {
+#ifdef CONFIG_SD_RECORDER_FORMAT_IF_MOUNT_FAILED
+      .format_if_mount_failed = true,
+#endif
+      .max_files = 2,
+      // Only used when formatting: clusters as large as a write.
+      .allocation_unit_size = 16 * 1024,
+  };
+#if CONFIG_SD_RECORDER_BUS_SDMMC
+  sdmmc_host_t host = SDMMC_HOST_DEFAULT();
+  host.max_freq_khz = SDMMC_FREQ_HIGHSPEED;
+  sdmmc_slot_config_t slot = SDMMC_SLOT_CONFIG_DEFAULT();
+#ifdef CONFIG_SD_RECORDER_SDMMC_4BIT
+  slot.width = 4;
+#else
+  slot.width = 1;
+#endif
+  slot.flags |= SDMMC_SLOT_FLAG_INTERNAL_PULLUP;
+  return esp_vfs_fat_sdmmc_mount(SD_MOUNT, &host, &slot, &mount_cfg, &s_card);
+#else
+  sdmmc_host_t host = SDSPI_HOST_DEFAULT();
+  const spi_bus_config_t bus = {
+      .mosi_io_num = CONFIG_SD_RECORDER_SPI_MOSI,
+      .miso_io_num = CONFIG_SD_RECORDER_SPI_MISO,
+      .sclk_io_num = CONFIG_SD_RECORDER_SPI_CLK,
+      .quadwp_io_num = -1,
+      .quadhd_io_num = -1,
+      .max_transfer_sz = SD_BLOCK_BYTES,
+  };
+  esp_err_t err = spi_bus_initialize(host.slot, &bus, SDSPI_DEFAULT_DMA);
+  if (err != ESP_OK) {
+    return err;
+  }
+  sdspi_device_config_t dev = SDSPI_DEVICE_CONFIG_DEFAULT();
+  dev.gpio_cs = CONFIG_SD_RECORDER_SPI_CS;
+  dev.host_id = host.slot;
+  return esp_vfs_fat_sdspi_mount(SD_MOUNT, &host, &dev, &mount_cfg, &s_card);
+#endif
+}
+
+void sd_recorder_init(void) {
+  if (s_queue) {
+    return;
+  }
+  esp_err_t err = sd_recorder_mount();
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "No SD card: %s; recording off", esp_err_to_name(err));
+    return;
+  }
+  sdmmc_card_print_info(stdout, s_card);
+  mkdir(SD_DIR, 0775);
+  s_stats.mounted = true;
+  sd_recorder_scan();
+  sd_recorder_update_space();
+
+  for (int i = 0; i < 2; i++) {
+    s_blocks[i].data =
+        audio_arena_alloc(AUDIO_ARENA_LARGE, SD_BLOCK_BYTES, "sd_recorder");
+    if (!s_blocks[i].data) {
+      ESP_LOGE(TAG, "No memory for the SD blocks");
+      return;
+    }
+  }
+#if CONFIG_SD_RECORDER_CONTINUOUS
+  s_queue = xQueueCreate(SD_QUEUE_LEN, sizeof(int));
+#else
+  s_queue = xQueueCreate(SD_QUEUE_LEN, sizeof(sd_event));
+#endif
+  if (!s_queue) {
+    ESP_LOGE(TAG, "Failed to create the SD queue");
+    return;
+  }
+  if (xTaskCreatePinnedToCore(sd_recorder_task, "sd_recorder", SD_TASK_STACK,
+                              NULL, SD_TASK_PRIO, NULL,
+                              SD_TASK_CORE) != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create the SD writer task");
+    return;
+  }
+
+  metrics_register(&s_overruns.base);
+  metrics_register(&s_files.base);
+  metrics_register(&s_write_errors.base);
+  metrics_register(&s_write_us.base);
+
+#if CONFIG_SD_RECORDER_CONTINUOUS
+  const mic_subscriber_cfg sub_cfg = {
+      .cb = sd_recorder_on_tap,
+      .name = "sd_recorder",
+      .batch_taps = 1,
+      .enabled = true,
+  };
+  s_sub = mic_subscribe(&sub_cfg);
+  if (!s_sub) {
+    ESP_LOGE(TAG, "Failed to subscribe to microphone taps");
+    return;
+  }
+#else
+  if (mic_history_samples() == 0) {
+    ESP_LOGW(TAG, "Mic history is off; event clips cannot be recorded");
+  }
+  if (!impulse_detector_add_event_listener(sd_recorder_on_event, NULL)) {
+    ESP_LOGE(TAG, "No detector listener slot left");
+    return;
+  }
+#endif
+  ESP_LOGI(TAG, "Recording to " SD_DIR ", %d KB blocks, next file %" PRIu32,
+           SD_BLOCK_BYTES / 1024, s_next_seq);
+}
+
+void sd_recorder_get_stats(sd_recorder_stats_t *stats) {
+  if (!stats) {
+    return;
+  }
+  portENTER_CRITICAL(&s_stats_mux);
+  *stats = s_stats;
+  portEXIT_CRITICAL(&s_stats_mux);
+}
+
+#else // !CONFIG_SD_RECORDER
+
+#include <string.h>
+
+void sd_recorder_init(void) {}
+
+void sd_recorder_get_stats(sd_recorder_stats_t *stats) {
+  if (stats) {
+    memset(stats, 0, sizeof(*stats));
+  }
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef TASK_MONITOR_H
+#define TASK_MONITOR_H
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Per-task CPU load and stack headroom.
+//
+// A periodic esp_timer samples the FreeRTOS run-time counters into a ring of
+// CONFIG_TASK_MONITOR_WINDOW_SAMPLES snapshots; a read compares a live
+// snapshot against the oldest one, so loads cover a sliding window of that
+// many periods rather than the time since boot.
+// Needs CONFIG_FREERTOS_USE_TRACE_FACILITY and
+// CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS; without them every call returns
+// ESP_ERR_NOT_SUPPORTED.
+
+// uxTaskGetSystemState() reports nothing when there are more tasks than this.
+#define TASK_MONITOR_MAX_TASKS 32
+#define TASK_MONITOR_NAME_LEN 16
+
+typedef struct {
+  char name[TASK_MONITOR_NAME_LEN];
+  int core;                // pinned core, or -1 when the task may run on both
+  uint32_t priority;       // current (possibly inherited) priority
+  uint32_t base_priority;
+  uint32_t stack_free_min; // stack high-water mark: bytes never touched
+  float cpu_percent;       // share of one core over the window
+} task_monitor_task;
+
+typedef struct {
+  uint32_t window_ms; // span the loads cover; 0 before the second sample
+  int count;
+  task_monitor_task tasks[TASK_MONITOR_MAX_TASKS];
+} task_monitor_report;
+
+// Starts sampling; safe to call more than once.
+esp_err_t task_monitor_start(void);
+
+// Live task list with loads over the current window. Takes a few hundred
+// microseconds with the scheduler suspended; meant for diagnostics.
+esp_err_t task_monitor_read(task_monitor_report *out);
+
+#endif
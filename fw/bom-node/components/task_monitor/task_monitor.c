@@ -0,0 +1,148 @@
+#include "task_monitor.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+static const char *TAG = "TASK_MON";
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+
+#define SAMPLES CONFIG_TASK_MONITOR_WINDOW_SAMPLES
+
+typedef configRUN_TIME_COUNTER_TYPE run_time_t;
+
+typedef struct {
+  int64_t time_us;
+  run_time_t total; // run time counter: advances with wall time
+  int count;
+  struct {
+    UBaseType_t number; // xTaskNumber: unique, unlike handles of freed tasks
+    run_time_t run_time;
+  } tasks[TASK_MONITOR_MAX_TASKS];
+} sample;
+
+// The ring holds the older end of the window; a read takes a live snapshot
+// as the newer one. Sampler and reader share s_status, so both hold s_lock.
+static sample s_ring[SAMPLES];
+static int s_head = 0; // next slot to write
+static int s_filled = 0;
+static TaskStatus_t s_status[TASK_MONITOR_MAX_TASKS];
+static SemaphoreHandle_t s_lock = NULL;
+static esp_timer_handle_t s_timer = NULL;
+
+static void sampler_tick(void *arg) {
+  (void)arg;
+  // Skip a tick rather than stall the esp_timer task behind a reader.
+  if (xSemaphoreTake(s_lock, 0) != pdTRUE) {
+    return;
+  }
+  sample *s = &s_ring[s_head];
+  const UBaseType_t n =
+      uxTaskGetSystemState(s_status, TASK_MONITOR_MAX_TASKS, &s->total);
+  s->time_us = esp_timer_get_time();
+  s->count = (int)n;
+  for (UBaseType_t i = 0; i < n; i++) {
+    s->tasks[i].number = s_status[i].xTaskNumber;
+    s->tasks[i].run_time = s_status[i].ulRunTimeCounter;
+  }
+  s_head = (s_head + 1) % SAMPLES;
+  if (s_filled < SAMPLES) {
+    s_filled++;
+  }
+  xSemaphoreGive(s_lock);
+}
+
+esp_err_t task_monitor_start(void) {
+  if (s_timer) {
+    return ESP_OK;
+  }
+  s_lock = xSemaphoreCreateMutex();
+  if (!s_lock) {
+    return ESP_ERR_NO_MEM;
+  }
+  const esp_timer_create_args_t args = {
+      .callback = sampler_tick,
+      .name = "task_monitor",
+  };
+  esp_err_t err = esp_timer_create(&args, &s_timer);
+  if (err == ESP_OK) {
+    err = esp_timer_start_periodic(
+        s_timer, (uint64_t)CONFIG_TASK_MONITOR_PERIOD_MS * 1000);
+  }
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Sampler start failed: %s", esp_err_to_name(err));
+    return err;
+  }
+  ESP_LOGI(TAG, "Sampling every %d ms over %d samples",
+           CONFIG_TASK_MONITOR_PERIOD_MS, SAMPLES);
+  return ESP_OK;
+}
+
+// A task missing from the baseline started inside the window, with its
+// counter at zero.
+static run_time_t baseline_run_time(const sample *s, UBaseType_t number) {
+  for (int i = 0; i < s->count; i++) {
+    if (s->tasks[i].number == number) {
+      return s->tasks[i].run_time;
+    }
+  }
+  return 0;
+}
+
+esp_err_t task_monitor_read(task_monitor_report *out) {
+  if (!s_lock) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  run_time_t total = 0;
+  const UBaseType_t n =
+      uxTaskGetSystemState(s_status, TASK_MONITOR_MAX_TASKS, &total);
+  const int64_t now = esp_timer_get_time();
+  const sample *oldest =
+      s_filled == 0 ? NULL : &s_ring[s_filled < SAMPLES ? 0 : s_head];
+  // Loads are ratios of counter deltas, so they hold whatever the counter's
+  // clock source; only window_ms uses esp_timer.
+  const run_time_t window = oldest ? (run_time_t)(total - oldest->total) : 0;
+  out->window_ms = oldest ? (uint32_t)((now - oldest->time_us) / 1000) : 0;
+  out->count = 0;
+  for (UBaseType_t i = 0; i < n; i++) {
+    const TaskStatus_t *st = &s_status[i];
+    task_monitor_task *t = &out->tasks[out->count++];
+    strncpy(t->name, st->pcTaskName, sizeof(t->name) - 1);
+    t->name[sizeof(t->name) - 1] = '\0';
+    const BaseType_t core = xTaskGetCoreID(st->xHandle);
+    t->core = core == tskNO_AFFINITY ? -1 : (int)core;
+    t->priority = st->uxCurrentPriority;
+    t->base_priority = st->uxBasePriority;
+    t->stack_free_min = st->usStackHighWaterMark;
+    t->cpu_percent = 0.0f;
+    if (window > 0) {
+      const run_time_t then = baseline_run_time(oldest, st->xTaskNumber);
+      t->cpu_percent =
+          100.0f * (float)(run_time_t)(st->ulRunTimeCounter - then) / window;
+    }
+  }
+  xSemaphoreGive(s_lock);
+  return ESP_OK;
+}
+
+#else
+
+esp_err_t task_monitor_start(void) {
+  ESP_LOGW(TAG, "Run-time stats are disabled, task loads are unavailable");
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t task_monitor_read(task_monitor_report *out) {
+  (void)out;
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+// Hot-path event tracing for latency work (CONFIG_TRACE_ENABLE).
+//
+// Each core appends to its own ring of CONFIG_TRACE_RING_EVENTS compact
+// events stamped with its cycle counter: one atomic index bump and a 16-byte
+// store, with no lock and no word shared between cores.
+// The oldest events are overwritten. With tracing compiled out the macros
+// expand to nothing and their arguments are not evaluated.
+//
+// Cycle counts are turned into microseconds at export, walking back from a
+// fresh anchor taken on each core. That holds as long as consecutive events
+// on a core are less than 2^31 cycles (~9 s at 240 MHz) apart, which the
+// per-chunk reader events guarantee while audio runs.
+
+typedef enum {
+  TRACE_I2S_READ,          // instant, arg: bytes read
+  TRACE_TAP_CALLBACK,      // span, arg: subscriber slot
+  TRACE_TAP_QUEUE_SEND,    // instant, arg: tap sample index (low 32 bits)
+  TRACE_TAP_QUEUE_RECEIVE, // instant, arg: tap sample index (low 32 bits)
+  TRACE_IMPULSE_ADD_TAP,   // span, arg: tap sample index (low 32 bits)
+  TRACE_IMPULSE_DETECT,    // span, arg: 1 on a hit (on the end event)
+  TRACE_CHUNK_QUEUE_SEND,  // instant, arg: chunk sample index (low 32 bits)
+  TRACE_CHUNK_QUEUE_RECEIVE, // instant, arg: chunk sample index
+  TRACE_HTTP_WRITE,        // span, arg: bytes
+  TRACE_EVENT_COUNT,
+} trace_event_id;
+
+typedef enum {
+  TRACE_PHASE_BEGIN,
+  TRACE_PHASE_END,
+  TRACE_PHASE_INSTANT,
+} trace_phase;
+
+#ifdef CONFIG_TRACE_ENABLE
+
+void trace_record(trace_event_id id, trace_phase phase, uint32_t arg);
+
+#define TRACE_BEGIN(id, arg) trace_record((id), TRACE_PHASE_BEGIN, (arg))
+#define TRACE_END(id, arg) trace_record((id), TRACE_PHASE_END, (arg))
+#define TRACE_INSTANT(id, arg) trace_record((id), TRACE_PHASE_INSTANT, (arg))
+
+#else
+
+#define TRACE_BEGIN(id, arg) ((void)0)
+#define TRACE_END(id, arg) ((void)0)
+#define TRACE_INSTANT(id, arg) ((void)0)
+
+#endif
+
+// Writes the rings as Chrome trace event JSON (chrome://tracing, Perfetto)
+// through `sink`, oldest event first. Recording pauses for the duration.
+// ESP_ERR_NOT_SUPPORTED when tracing is compiled out.
+typedef esp_err_t (*trace_sink_fn)(const char *data, size_t len, void *ctx);
+esp_err_t trace_export(trace_sink_fn sink, void *ctx);
+
+#endif
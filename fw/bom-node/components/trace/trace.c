@@ -0,0 +1,229 @@
+#include "trace.h"
+
+#ifdef CONFIG_TRACE_ENABLE
+
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#if CONFIG_FREERTOS_NUMBER_OF_CORES > 1
+#include "esp_ipc.h"
+#endif
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define RING_EVENTS CONFIG_TRACE_RING_EVENTS
+#define CORES CONFIG_FREERTOS_NUMBER_OF_CORES
+#define CPU_MHZ CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#define LINE_MAX 160
+#define MAX_THREADS 32
+
+_Static_assert((RING_EVENTS & (RING_EVENTS - 1)) == 0,
+               "CONFIG_TRACE_RING_EVENTS must be a power of two");
+
+static const char *TAG = "TRACE";
+
+typedef struct {
+  uint32_t cycles;
+  uint32_t arg;
+  TaskHandle_t task;
+  uint16_t id;
+  uint8_t phase;
+  uint8_t reserved;
+} trace_event;
+
+typedef struct {
+  _Atomic uint32_t head; // events recorded since boot
+  trace_event events[RING_EVENTS];
+} trace_ring;
+
+typedef struct {
+  int64_t time_us;
+  uint32_t cycles;
+} trace_anchor;
+
+static trace_ring s_rings[CORES];
+static _Atomic bool s_paused = false;
+
+static const char *const s_names[TRACE_EVENT_COUNT] = {
+    [TRACE_I2S_READ] = "i2s_read",
+    [TRACE_TAP_CALLBACK] = "tap_callback",
+    [TRACE_TAP_QUEUE_SEND] = "tap_queue_send",
+    [TRACE_TAP_QUEUE_RECEIVE] = "tap_queue_receive",
+    [TRACE_IMPULSE_ADD_TAP] = "impulse_add_tap",
+    [TRACE_IMPULSE_DETECT] = "impulse_run_detection",
+    [TRACE_CHUNK_QUEUE_SEND] = "chunk_queue_send",
+    [TRACE_CHUNK_QUEUE_RECEIVE] = "chunk_queue_receive",
+    [TRACE_HTTP_WRITE] = "http_write",
+};
+
+void trace_record(trace_event_id id, trace_phase phase, uint32_t arg) {
+  if (atomic_load_explicit(&s_paused, memory_order_relaxed)) {
+    return;
+  }
+  const uint32_t cycles = esp_cpu_get_cycle_count();
+  trace_ring *r = &s_rings[esp_cpu_get_core_id()];
+  const uint32_t i =
+      atomic_fetch_add_explicit(&r->head, 1, memory_order_relaxed);
+  trace_event *e = &r->events[i & (RING_EVENTS - 1)];
+  e->cycles = cycles;
+  e->arg = arg;
+  e->task = xTaskGetCurrentTaskHandle();
+  e->id = (uint16_t)id;
+  e->phase = (uint8_t)phase;
+}
+
+static void take_anchor(void *arg) {
+  trace_anchor *a = arg;
+  a->cycles = esp_cpu_get_cycle_count();
+  a->time_us = esp_timer_get_time();
+}
+
+typedef struct {
+  trace_sink_fn sink;
+  void *ctx;
+  esp_err_t err;
+} trace_out;
+
+__attribute__((format(printf, 2, 3))) static void out_printf(trace_out *out,
+                                                             const char *fmt,
+                                                             ...) {
+  if (out->err != ESP_OK) {
+    return;
+  }
+  char line[LINE_MAX];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(line, sizeof(line), fmt, ap);
+  va_end(ap);
+  if (n < 0) {
+    return;
+  }
+  if ((size_t)n >= sizeof(line)) {
+    n = sizeof(line) - 1;
+  }
+  out->err = out->sink(line, (size_t)n, out->ctx);
+}
+
+static int64_t cycles_to_ns(int64_t cycles) {
+  return cycles * 1000 / CPU_MHZ;
+}
+
+static void export_ring(trace_out *out, int core, const trace_anchor *anchor,
+                        bool *first) {
+  const trace_ring *r = &s_rings[core];
+  const uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+  const uint32_t count = head < RING_EVENTS ? head : RING_EVENTS;
+  if (count == 0) {
+    return;
+  }
+  // Walk back from the anchor to date the oldest event, then forward. The
+  // deltas are signed: a task preempted between reading the counter and
+  // taking a slot leaves its event slightly out of order, not 2^32 cycles
+  // off.
+  const uint32_t oldest = head - count;
+  uint32_t prev = anchor->cycles;
+  int64_t back = 0;
+  for (uint32_t k = head; k-- > oldest;) {
+    const uint32_t c = r->events[k & (RING_EVENTS - 1)].cycles;
+    back += (int32_t)(prev - c);
+    prev = c;
+  }
+  int64_t cycles = -back;
+  prev = r->events[oldest & (RING_EVENTS - 1)].cycles;
+  for (uint32_t k = oldest; k != head; k++) {
+    const trace_event *e = &r->events[k & (RING_EVENTS - 1)];
+    cycles += (int32_t)(e->cycles - prev);
+    prev = e->cycles;
+    if (e->id >= TRACE_EVENT_COUNT || e->phase > TRACE_PHASE_INSTANT) {
+      continue;
+    }
+    const int64_t ns = anchor->time_us * 1000 + cycles_to_ns(cycles);
+    static const char phases[] = {'B', 'E', 'i'};
+    out_printf(out,
+               "%s{\"name\":\"%s\",\"ph\":\"%c\",%s\"ts\":%" PRId64
+               ".%03d,\"pid\":%d,\"tid\":%" PRIu32
+               ",\"args\":{\"arg\":%" PRIu32 "}}",
+               *first ? "" : ",\n", s_names[e->id], phases[e->phase],
+               e->phase == TRACE_PHASE_INSTANT ? "\"s\":\"t\"," : "",
+               ns / 1000, (int)(ns % 1000), core,
+               (uint32_t)(uintptr_t)e->task, e->arg);
+    *first = false;
+  }
+}
+
+// Names the threads of the tasks still alive; events of deleted tasks keep
+// their numeric tid.
+static void export_thread_names(trace_out *out, bool *first) {
+#if configUSE_TRACE_FACILITY
+  static TaskStatus_t status[MAX_THREADS];
+  const UBaseType_t n = uxTaskGetSystemState(status, MAX_THREADS, NULL);
+  for (UBaseType_t i = 0; i < n; i++) {
+    for (int core = 0; core < CORES; core++) {
+      out_printf(out,
+                 "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+                 "\"tid\":%" PRIu32 ",\"args\":{\"name\":\"%s\"}}",
+                 *first ? "" : ",\n", core,
+                 (uint32_t)(uintptr_t)status[i].xHandle,
+                 status[i].pcTaskName);
+      *first = false;
+    }
+  }
+#else
+  (void)out;
+  (void)first;
+#endif
+}
+
+esp_err_t trace_export(trace_sink_fn sink, void *ctx) {
+  atomic_store(&s_paused, true);
+  // Let an event that was being written when recording paused land.
+  vTaskDelay(1);
+
+  trace_anchor anchors[CORES];
+  for (int core = 0; core < CORES; core++) {
+#if CORES > 1
+    esp_ipc_call_blocking(core, take_anchor, &anchors[core]);
+#else
+    take_anchor(&anchors[core]);
+#endif
+  }
+
+  trace_out out = {.sink = sink, .ctx = ctx, .err = ESP_OK};
+  bool first = true;
+  out_printf(&out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  for (int core = 0; core < CORES; core++) {
+    out_printf(&out,
+               "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+               "\"args\":{\"name\":\"core %d\"}}",
+               first ? "" : ",\n", core, core);
+    first = false;
+  }
+  export_thread_names(&out, &first);
+  for (int core = 0; core < CORES; core++) {
+    export_ring(&out, core, &anchors[core], &first);
+  }
+  out_printf(&out, "\n]}\n");
+
+  atomic_store(&s_paused, false);
+  if (out.err != ESP_OK) {
+    ESP_LOGW(TAG, "Export aborted: %s", esp_err_to_name(out.err));
+  }
+  return out.err;
+}
+
+#else
+
+esp_err_t trace_export(trace_sink_fn sink, void *ctx) {
+  (void)sink;
+  (void)ctx;
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
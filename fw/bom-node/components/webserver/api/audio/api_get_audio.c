@@ -1,37 +1,54 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "esp_err.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #include "api_get_audio.h"
+#include "api_ws_levels.h"
 #include "audio_config.h"
 #include "audio_streamer.h"
 #include "audio_wav.h"
-#include "cJSON.h"
+#include "detector.h"
 #include "esp_http_server.h"
+#include "event_uploader.h"
 #include "handler.h"
+#include "ima_adpcm.h"
+#include "level_meter.h"
+#include "mic_input.h"
+#include "sd_recorder.h"
+#include "sdkconfig.h"
 #include "slre.h"
 
 static const char* TAG = "GET_AUDIO";
 
+// One task per open stream.wav response, placed like the stream server task
+// that hands it the request.
+#define AUDIO_STREAM_TASK_STACK 4096
+#define AUDIO_STREAM_TASK_PRIO  CONFIG_WEB_STREAM_TASK_PRIORITY
+#define AUDIO_STREAM_TASK_CORE  CONFIG_WEB_STREAM_TASK_CORE
+// Longest Host header kept for the redirect to the stream port.
+#define AUDIO_STREAM_HOST_MAX   64
+
 // Definition of handlers
 esp_err_t get_audio_stream_config(httpd_req_t* req);
 esp_err_t get_audio_settings(httpd_req_t* req);
-esp_err_t get_audio_stream(httpd_req_t* req);
+esp_err_t get_audio_stream_redirect(httpd_req_t* req);
 esp_err_t get_audio_stats(httpd_req_t* req);
 
 // Table of routes
 static const route_entry_t route_table[] = {
-    {"^/api/v1/audio/stream\\.wav$", get_audio_stream},
-    {"^/api/v1/audio/stats/?$", get_audio_stats},
-    {"^/api/v1/audio/stream/?$", get_audio_stream_config},
-    {"^/api/v1/audio/settings/?$", get_audio_settings},
+    {"/api/v1/audio/stream.wav", get_audio_stream_redirect},
+    {"/api/v1/audio/stats", get_audio_stats},
+    {"/api/v1/audio/stream", get_audio_stream_config},
+    {"/api/v1/audio/settings", get_audio_settings},
 };
 
 // Main handler for GET audio/* requests
 esp_err_t api_get_audio(httpd_req_t* req) {
-    ESP_LOGI(TAG, "Received GET request: %s", req->uri);
+    ESP_LOGD(TAG, "Received GET request: %s", req->uri);
 
     return route_request(req, route_table, sizeof(route_table) / sizeof(route_entry_t));
 }
@@ -44,28 +61,20 @@ esp_err_t api_get_audio(httpd_req_t* req) {
  * @response 500 - Internal error
  */
 esp_err_t get_audio_stream_config(httpd_req_t* req) {
-    cJSON* root = cJSON_CreateObject();
-    if (!root) {
-        return httpd_resp_send_500(req);
-    }
-
-    audio_config_t config = audio_config_get();
-    cJSON_AddStringToObject(root, "mode", config.mode);
-    cJSON_AddStringToObject(root, "uploadUrl", config.upload_url);
-    cJSON_AddBoolToObject(root, "enabled", config.enabled);
-
-    const char* resp_str = cJSON_PrintUnformatted(root);
-    if (!resp_str) {
-        cJSON_Delete(root);
-        return httpd_resp_send_500(req);
-    }
-
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, resp_str, strlen(resp_str));
-
-    cJSON_Delete(root);
-    free((void*)resp_str);
-    return ESP_OK;
+    audio_config_t config;
+    audio_config_get(&config);
+    json_writer_t w;
+    json_response_begin(&w);
+    json_writer_object_begin(&w, NULL);
+    json_writer_string(&w, "mode", config.mode);
+    json_writer_string(&w, "uploadUrl", config.upload_url);
+    json_writer_string(&w, "format", config.format);
+    json_writer_string(&w, "channels", config.channels);
+    json_writer_int(&w, "decimation", config.decimation);
+    json_writer_bool(&w, "enabled", config.enabled);
+    json_writer_int(&w, "streamPort", CONFIG_WEB_STREAM_PORT);
+    json_writer_object_end(&w);
+    return json_response_send(req, &w, TAG);
 }
 
 /**
@@ -76,27 +85,92 @@ esp_err_t get_audio_stream_config(httpd_req_t* req) {
  * @response 500 - Internal error
  */
 esp_err_t get_audio_settings(httpd_req_t* req) {
-    cJSON* root = cJSON_CreateObject();
-    if (!root) {
-        return httpd_resp_send_500(req);
-    }
+    audio_config_t config;
+    audio_config_get(&config);
+    json_writer_t w;
+    json_response_begin(&w);
+    json_writer_object_begin(&w, NULL);
+    json_writer_int(&w, "samplingRate", config.sampling_rate);
+    json_writer_string(&w, "captureMode", "continuous");
+    json_writer_object_end(&w);
+    return json_response_send(req, &w, TAG);
+}
 
-    audio_config_t config = audio_config_get();
-    cJSON_AddNumberToObject(root, "samplingRate", config.sampling_rate);
-    cJSON_AddStringToObject(root, "captureMode", "continuous");
+// Reader pipeline telemetry: DMA overflows, per-chunk processing time, the
+// DMA queue and read lag, the sample clock fit and per-callback duration histograms.
+static void write_mic_stats(json_writer_t* w) {
+    mic_stats st = {0};
+    mic_get_stats(&st);
 
-    const char* resp_str = cJSON_PrintUnformatted(root);
-    if (!resp_str) {
-        cJSON_Delete(root);
-        return httpd_resp_send_500(req);
+    json_writer_object_begin(w, "mic");
+    json_writer_uint(w, "chunks", st.chunks);
+    json_writer_uint(w, "dmaOverflows", st.dma_overflows);
+    json_writer_string(w, "source", st.source ? st.source : "");
+
+    json_writer_object_begin(w, "chunkUs");
+    json_writer_uint(w, "min", st.chunk_us_min);
+    json_writer_double(w, "avg", st.chunks ? (double)st.chunk_us_total / st.chunks : 0);
+    json_writer_uint(w, "max", st.chunk_us_max);
+    json_writer_object_end(w);
+
+    json_writer_object_begin(w, "dma");
+    json_writer_uint(w, "buffers", st.dma_desc_num);
+    json_writer_uint(w, "frames", st.dma_frames);
+    json_writer_uint(w, "resizes", st.dma_resizes);
+    json_writer_uint(w, "readLagUs", st.read_lag_us);
+    json_writer_uint(w, "readLagUsMax", st.read_lag_us_max);
+    json_writer_object_end(w);
+
+    json_writer_object_begin(w, "clock");
+    json_writer_double(w, "ppm", st.clock_ppm);
+    json_writer_uint(w, "relocks", st.clock_relocks);
+    json_writer_bool(w, "locked", st.clock_locked);
+    const uint64_t head = mic_captured_samples();
+    json_writer_uint(w, "sampleIndex", head);
+    const int64_t unix_us = mic_sample_unix_us(head);
+    if (unix_us) {
+        json_writer_int(w, "unixUs", unix_us);
+    } else {
+        json_writer_null(w, "unixUs");
     }
+    json_writer_object_end(w);
 
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, resp_str, strlen(resp_str));
+    mic_dc_offset dc = {0};
+    mic_get_dc_offset(&dc);
+    json_writer_object_begin(w, "dcOffset");
+    json_writer_int(w, "left", dc.left);
+    json_writer_int(w, "right", dc.right);
+    json_writer_bool(w, "calibrated", dc.calibrated);
+    json_writer_object_end(w);
 
-    cJSON_Delete(root);
-    free((void*)resp_str);
-    return ESP_OK;
+    static const int edges[] = MIC_CB_HIST_EDGES_US;
+    json_writer_array_begin(w, "callbackHistEdgesUs");
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+        json_writer_int(w, NULL, edges[i]);
+    }
+    json_writer_array_end(w);
+
+    json_writer_array_begin(w, "callbacks");
+    for (int i = 0; i < MIC_MAX_SUBSCRIBERS; i++) {
+        if (!(st.subscribed_mask & (1u << i))) {
+            continue;
+        }
+        const mic_callback_stats* cb = &st.callbacks[i];
+        json_writer_object_begin(w, NULL);
+        json_writer_string(w, "name", cb->name ? cb->name : "");
+        json_writer_bool(w, "enabled", (st.active_mask & (1u << i)) != 0);
+        json_writer_uint(w, "calls", cb->calls);
+        json_writer_double(w, "avgUs", cb->calls ? (double)cb->total_us / cb->calls : 0);
+        json_writer_uint(w, "maxUs", cb->max_us);
+        json_writer_array_begin(w, "hist");
+        for (int b = 0; b < MIC_CB_HIST_BUCKETS; b++) {
+            json_writer_uint(w, NULL, cb->hist[b]);
+        }
+        json_writer_array_end(w);
+        json_writer_object_end(w);
+    }
+    json_writer_array_end(w);
+    json_writer_object_end(w);
 }
 
 /**
@@ -107,60 +181,151 @@ esp_err_t get_audio_settings(httpd_req_t* req) {
  * @response 500 - Internal error
  */
 esp_err_t get_audio_stats(httpd_req_t* req) {
-    cJSON* root = cJSON_CreateObject();
-    if (!root) {
-        return httpd_resp_send_500(req);
-    }
-
     audio_streamer_stats_t stats = {0};
     audio_streamer_get_stats(&stats);
-    
-    cJSON_AddNumberToObject(root, "tapCalls", stats.tap_calls);
-    cJSON_AddNumberToObject(root, "streamWrites", stats.stream_writes);
-    cJSON_AddNumberToObject(root, "sendFailed", stats.send_failed);
-    cJSON_AddNumberToObject(root, "readCalls", stats.read_calls);
-    cJSON_AddNumberToObject(root, "readBytes", stats.read_bytes);
-    cJSON_AddBoolToObject(root, "pullEnabled", stats.pull_enabled);
-
-    const char* resp_str = cJSON_PrintUnformatted(root);
-    if (!resp_str) {
-        cJSON_Delete(root);
-        return httpd_resp_send_500(req);
+
+    json_writer_t w;
+    json_response_begin(&w);
+    json_writer_object_begin(&w, NULL);
+    json_writer_uint(&w, "tapCalls", stats.tap_calls);
+    json_writer_uint(&w, "streamWrites", stats.stream_writes);
+    json_writer_uint(&w, "sendFailed", stats.send_failed);
+    json_writer_uint(&w, "pullDropOldest", stats.pull_drop_oldest);
+    json_writer_uint(&w, "pullDropNewest", stats.pull_drop_newest);
+    json_writer_uint(&w, "readCalls", stats.read_calls);
+    json_writer_uint(&w, "readBytes", stats.read_bytes);
+    json_writer_bool(&w, "pullEnabled", stats.pull_enabled);
+    json_writer_uint(&w, "pushWrites", stats.push_writes);
+    json_writer_uint(&w, "pushBytes", stats.push_bytes);
+    json_writer_uint(&w, "pushConnects", stats.push_connects);
+    json_writer_uint(&w, "pushDropped", stats.push_dropped);
+    json_writer_uint(&w, "pushGaps", stats.push_gaps);
+    json_writer_uint(&w, "rtpPackets", stats.rtp_packets);
+    json_writer_uint(&w, "rtpBytes", stats.rtp_bytes);
+    json_writer_uint(&w, "rtpDropped", stats.rtp_dropped);
+    json_writer_uint(&w, "rtpGaps", stats.rtp_gaps);
+    json_writer_object_begin(&w, "layout");
+    json_writer_string(&w, "channels", audio_shaper_channels_name(stats.layout.channel_mode));
+    json_writer_int(&w, "decimation", stats.layout.decimation);
+    json_writer_int(&w, "sampleRate", stats.layout.sample_rate);
+    json_writer_object_end(&w);
+
+    json_writer_array_begin(&w, "pullClients");
+    for (int i = 0; i < CONFIG_AUDIO_STREAM_PULL_CLIENTS; i++) {
+        const audio_pull_client_stats_t* c = &stats.pull_clients[i];
+        json_writer_object_begin(&w, NULL);
+        json_writer_bool(&w, "active", c->active);
+        json_writer_uint(&w, "readBytes", c->read_bytes);
+        json_writer_uint(&w, "overruns", c->overruns);
+        json_writer_uint(&w, "skippedChunks", c->skipped_chunks);
+        json_writer_uint(&w, "heldChunks", c->held_chunks);
+        json_writer_object_end(&w);
     }
+    json_writer_array_end(&w);
 
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, resp_str, strlen(resp_str));
+    write_mic_stats(&w);
 
-    cJSON_Delete(root);
-    free((void*)resp_str);
-    return ESP_OK;
+    level_meter_stats_t meter = {0};
+    level_meter_get_stats(&meter);
+    api_ws_levels_stats_t levels = {0};
+    api_ws_levels_get_stats(&levels);
+    json_writer_object_begin(&w, "levels");
+    json_writer_uint(&w, "clients", levels.clients);
+    json_writer_uint(&w, "blocks", meter.blocks);
+    json_writer_uint(&w, "framesSent", levels.frames_sent);
+    json_writer_uint(&w, "framesDropped", levels.frames_dropped);
+    json_writer_object_end(&w);
+
+    impulse_detector_stats det = {0};
+    impulse_detector_get_stats(&det);
+    json_writer_object_begin(&w, "detection");
+    json_writer_uint(&w, "tapsDropped", det.taps_dropped);
+    json_writer_uint(&w, "resets", det.resets);
+    json_writer_uint(&w, "detections", det.detections);
+    json_writer_uint(&w, "coalesced", det.coalesced);
+    json_writer_uint(&w, "windowsLost", det.windows_lost);
+    json_writer_object_end(&w);
+
+    event_uploader_stats_t ev = {0};
+    event_uploader_get_stats(&ev);
+    json_writer_object_begin(&w, "events");
+    json_writer_bool(&w, "enabled", ev.enabled);
+    json_writer_uint(&w, "queued", ev.queued);
+    json_writer_uint(&w, "dropped", ev.dropped);
+    json_writer_uint(&w, "uploaded", ev.uploaded);
+    json_writer_uint(&w, "batches", ev.batches);
+    json_writer_uint(&w, "failures", ev.failures);
+    json_writer_int(&w, "lastStatus", ev.last_status);
+    json_writer_bool(&w, "logReady", ev.log_ready);
+    json_writer_uint(&w, "stored", ev.stored);
+    json_writer_uint(&w, "replayed", ev.replayed);
+    json_writer_uint(&w, "rejected", ev.rejected);
+    json_writer_uint(&w, "backlog", ev.backlog);
+    json_writer_uint(&w, "logLost", ev.log_lost);
+    json_writer_object_end(&w);
+
+    sd_recorder_stats_t sd = {0};
+    sd_recorder_get_stats(&sd);
+    json_writer_object_begin(&w, "sd");
+    json_writer_bool(&w, "mounted", sd.mounted);
+    json_writer_bool(&w, "recording", sd.recording);
+    json_writer_string(&w, "current", sd.current);
+    json_writer_uint(&w, "files", sd.files);
+    json_writer_uint(&w, "deleted", sd.deleted);
+    json_writer_uint(&w, "oldestSeq", sd.oldest_seq);
+    json_writer_uint(&w, "newestSeq", sd.newest_seq);
+    json_writer_uint(&w, "cardBytes", sd.card_bytes);
+    json_writer_uint(&w, "freeBytes", sd.free_bytes);
+    json_writer_uint(&w, "bytesWritten", sd.bytes_written);
+    json_writer_uint(&w, "overruns", sd.overruns);
+    json_writer_uint(&w, "eventsLost", sd.events_lost);
+    json_writer_uint(&w, "writeErrors", sd.write_errors);
+    json_writer_uint(&w, "writeMaxUs", sd.write_max_us);
+    json_writer_object_end(&w);
+
+    json_writer_object_end(&w);
+    return json_response_send(req, &w, TAG);
 }
 
-esp_err_t get_audio_stream(httpd_req_t* req) {
-    if (!audio_streamer_pull_enabled()) {
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Audio stream disabled");
-        return ESP_FAIL;
-    }
+typedef struct {
+    httpd_req_t* req;
+    audio_pull_client* client;
+} audio_stream_job_t;
 
-    if (!audio_streamer_pull_claim()) {
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Stream already in use");
-        return ESP_FAIL;
-    }
+// Runs one pull response outside the server task, so several clients (and
+// the rest of the API) are served while a stream is open.
+static void audio_stream_task(void* arg) {
+    audio_stream_job_t* job = (audio_stream_job_t*)arg;
+    httpd_req_t* req = job->req;
 
     httpd_resp_set_type(req, "audio/wav");
     httpd_resp_set_hdr(req, "Cache-Control", "no-store");
 
-    uint8_t header[44] = {0};
-    audio_wav_build_header(header, audio_streamer_sample_rate());
-    if (httpd_resp_send_chunk(req, (const char*)header, sizeof(header)) != ESP_OK) {
+    // The header is only valid for the current rate; a reconfiguration ends
+    // the response and the client reopens it with the new header.
+    // The header stamps the first frame the client reads; without audio
+    // within the wait it goes out unstamped.
+    const uint32_t format_epoch = audio_streamer_format_epoch();
+    audio_wav_stamp stamp;
+    const bool stamped =
+        audio_streamer_pull_stamp(job->client, &stamp, pdMS_TO_TICKS(1000));
+    uint8_t header[AUDIO_WAV_STREAM_HEADER_MAX] = {0};
+    const audio_stream_layout_t layout = audio_streamer_pull_layout(job->client);
+    size_t header_len =
+        audio_streamer_build_header(&layout, stamped ? &stamp : NULL, header);
+    if (httpd_resp_send_chunk(req, (const char*)header, header_len) != ESP_OK) {
         goto cleanup;
     }
 
-    uint8_t buf[512];
-    while (audio_streamer_pull_enabled()) {
-        size_t got = audio_streamer_pull_read(buf, sizeof(buf), pdMS_TO_TICKS(200));
+    // At least one ADPCM block.
+    uint8_t buf[IMA_ADPCM_BLOCK_BYTES];
+    while (audio_streamer_pull_enabled() &&
+           audio_streamer_format_epoch() == format_epoch) {
+        size_t got = audio_streamer_pull_read(job->client, buf, sizeof(buf),
+                                              pdMS_TO_TICKS(200), NULL);
+        // Empty after a timeout, a skip or a partial ADPCM block; the next
+        // read blocks until there is audio, so no delay is needed.
         if (got == 0) {
-            vTaskDelay(pdMS_TO_TICKS(1));
             continue;
         }
         if (httpd_resp_send_chunk(req, (const char*)buf, got) != ESP_OK) {
@@ -169,6 +334,67 @@ esp_err_t get_audio_stream(httpd_req_t* req) {
     }
 cleanup:
     httpd_resp_send_chunk(req, NULL, 0);
-    audio_streamer_pull_release();
+    audio_streamer_pull_close(job->client);
+    httpd_req_async_handler_complete(req);
+    free(job);
+    vTaskDelete(NULL);
+}
+
+/**
+ * GET /api/v1/audio/stream.wav on the main port
+ * @summary Redirect to the stream server
+ * @tag Audio
+ * @response 307 - Location on CONFIG_WEB_STREAM_PORT, same host and query
+ * @response 400 - No usable Host header
+ */
+esp_err_t get_audio_stream_redirect(httpd_req_t* req) {
+    char host[AUDIO_STREAM_HOST_MAX];
+    if (httpd_req_get_hdr_value_str(req, "Host", host, sizeof(host)) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Missing Host header");
+        return ESP_FAIL;
+    }
+    // Drop the port; a bracketed IPv6 address keeps its colons.
+    char* colon = strrchr(host, ':');
+    if (colon && !strchr(colon, ']')) {
+        *colon = '\0';
+    }
+    char location[AUDIO_STREAM_HOST_MAX + 192];
+    snprintf(location, sizeof(location), "http://%s:%d%s", host, CONFIG_WEB_STREAM_PORT,
+             req->uri);
+    httpd_resp_set_status(req, "307 Temporary Redirect");
+    httpd_resp_set_hdr(req, "Location", location);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, NULL, 0);
+}
+
+esp_err_t api_get_audio_stream(httpd_req_t* req) {
+    if (!audio_streamer_pull_enabled()) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Audio stream disabled");
+        return ESP_FAIL;
+    }
+
+    audio_pull_client* client = audio_streamer_pull_open();
+    if (!client) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "All stream slots in use");
+        return ESP_FAIL;
+    }
+
+    audio_stream_job_t* job = calloc(1, sizeof(*job));
+    if (!job || httpd_req_async_handler_begin(req, &job->req) != ESP_OK) {
+        free(job);
+        audio_streamer_pull_close(client);
+        return httpd_resp_send_500(req);
+    }
+    job->client = client;
+
+    if (xTaskCreatePinnedToCore(audio_stream_task, "audio_pull", AUDIO_STREAM_TASK_STACK, job,
+                                AUDIO_STREAM_TASK_PRIO, NULL,
+                                AUDIO_STREAM_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start stream task");
+        httpd_resp_send_500(job->req);
+        audio_streamer_pull_close(client);
+        httpd_req_async_handler_complete(job->req);
+        free(job);
+    }
     return ESP_OK;
 }
@@ -1,14 +1,15 @@
 #include <stdio.h>
 #include <string.h>
-#include "cJSON.h"
 #include "error_handler.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "handler.h"
 
 #include "api_post_audio.h"
+#include "audio_capture.h"
 #include "audio_config.h"
 #include "audio_streamer.h"
+#include "config_document.h"
 #include "slre.h"
 
 static const char* TAG = "POST_AUDIO";
@@ -19,35 +20,26 @@ esp_err_t post_audio_settings(httpd_req_t* req);
 
 // Table of routes
 static const route_entry_t route_table[] = {
-    {"^/api/v1/audio/stream/?$", post_audio_stream_config},
-    {"^/api/v1/audio/settings/?$", post_audio_settings},
+    {"/api/v1/audio/stream", post_audio_stream_config},
+    {"/api/v1/audio/settings", post_audio_settings},
 };
 
 // Main handler for POST audio/* requests
 esp_err_t api_post_audio(httpd_req_t* req) {
-    ESP_LOGI(TAG, "Received POST request: %s", req->uri);
+    ESP_LOGD(TAG, "Received POST request: %s", req->uri);
 
     return route_request(req, route_table, sizeof(route_table) / sizeof(route_entry_t));
 }
 
-static esp_err_t read_json_body(httpd_req_t* req, char* buf, size_t buf_len) {
-    if (req->content_len <= 0 || req->content_len >= (int)buf_len) {
-        return ESP_ERR_INVALID_SIZE;
-    }
-
-    int len = httpd_req_recv(req, buf, buf_len - 1);
-    if (len <= 0) {
-        return ESP_FAIL;
-    }
-    buf[len] = '\0';
-    return ESP_OK;
-}
-
 /**
  * POST /api/v1/audio/stream
  * @summary Update audio stream configuration
  * @tag Audio
- * @bodyDescription Update the audio mode, enabled flag, and upload URL.
+ * @bodyDescription Update the audio mode ("push", "pull", "events" or
+ * "rtp"), enabled flag, upload URL and, optionally, the stream format ("pcm"
+ * or "adpcm"), channels ("stereo", "left", "right" or "mono") and rate
+ * divider ("decimation", 1 to 4). In "rtp" mode the upload URL is the UDP
+ * target, host:port.
  * @bodyContent {AudioConfig} application/json
  * @bodyRequired
  * @response 200 - Audio config updated
@@ -56,42 +48,75 @@ static esp_err_t read_json_body(httpd_req_t* req, char* buf, size_t buf_len) {
 esp_err_t post_audio_stream_config(httpd_req_t* req) {
     ESP_LOGI(TAG, "Handling audio stream config");
 
-    char buf[256];
-    if (read_json_body(req, buf, sizeof buf) != ESP_OK) {
-        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Failed to receive request body");
+    json_doc_t doc;
+    esp_err_t err = json_request_read(req, &doc);
+    if (err != ESP_OK) {
+        return json_request_error(req, TAG, err);
     }
 
-    cJSON* root = cJSON_Parse(buf);
-    if (!root) {
-        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Invalid JSON format");
+    audio_config_t config;
+    audio_config_get(&config);
+
+    // Fields are decoded into copies, so nothing is applied unless the whole
+    // body is valid.
+    char mode[sizeof(config.mode)];
+    char upload_url[sizeof(config.upload_url)];
+    const int mode_tok = json_reader_find(&doc, 0, "mode");
+    const int url_tok = json_reader_find(&doc, 0, "uploadUrl");
+    if (!json_reader_is(&doc, mode_tok, JSON_TOKEN_STRING) ||
+        !json_reader_is(&doc, url_tok, JSON_TOKEN_STRING)) {
+        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Missing required fields");
+    }
+    if (!json_reader_string(&doc, mode_tok, mode, sizeof(mode))) {
+        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Invalid mode field");
+    }
+    if (!json_reader_string(&doc, url_tok, upload_url, sizeof(upload_url))) {
+        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "uploadUrl too long");
     }
 
-    const cJSON* mode = cJSON_GetObjectItem(root, "mode");
-    const cJSON* upload_url = cJSON_GetObjectItem(root, "uploadUrl");
-    const cJSON* enabled = cJSON_GetObjectItem(root, "enabled");
-    if (!cJSON_IsString(mode) || !cJSON_IsString(upload_url)) {
-        cJSON_Delete(root);
-        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Missing required fields");
+    bool enabled = false;
+    const int enabled_tok = json_reader_find(&doc, 0, "enabled");
+    if (enabled_tok >= 0 && !json_reader_bool(&doc, enabled_tok, &enabled)) {
+        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Invalid enabled field");
     }
-    if (enabled) {
-        if (!cJSON_IsBool(enabled)) {
-            cJSON_Delete(root);
-            return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Invalid enabled field");
-        }
+
+    char format[sizeof(config.format)];
+    audio_stream_format_t parsed_format;
+    const int format_tok = json_reader_find(&doc, 0, "format");
+    if (format_tok >= 0 && (!json_reader_string(&doc, format_tok, format, sizeof(format)) ||
+                            !audio_streamer_parse_format(format, &parsed_format))) {
+        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Unsupported format");
+    }
+    char channels[sizeof(config.channels)];
+    audio_channel_mode parsed_channels;
+    const int channels_tok = json_reader_find(&doc, 0, "channels");
+    if (channels_tok >= 0 &&
+        (!json_reader_string(&doc, channels_tok, channels, sizeof(channels)) ||
+         !audio_shaper_parse_channels(channels, &parsed_channels))) {
+        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Unsupported channels");
+    }
+    int decimation = config.decimation;
+    const int decimation_tok = json_reader_find(&doc, 0, "decimation");
+    if (decimation_tok >= 0 && (!json_reader_int(&doc, decimation_tok, &decimation) ||
+                                decimation < 1 || decimation > AUDIO_SHAPER_MAX_DECIMATION)) {
+        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Unsupported decimation");
     }
 
-    audio_config_t config = audio_config_get();
-    strncpy(config.mode, mode->valuestring, sizeof(config.mode) - 1);
-    strncpy(config.upload_url, upload_url->valuestring, sizeof(config.upload_url) - 1);
-    config.enabled = enabled ? cJSON_IsTrue(enabled) : false;
+    if (format_tok >= 0) {
+        memcpy(config.format, format, sizeof(config.format));
+    }
+    if (channels_tok >= 0) {
+        memcpy(config.channels, channels, sizeof(config.channels));
+    }
+    config.decimation = decimation;
+    memcpy(config.mode, mode, sizeof(config.mode));
+    memcpy(config.upload_url, upload_url, sizeof(config.upload_url));
+    config.enabled = enabled;
 
     if (audio_config_set(&config) != ESP_OK) {
-        cJSON_Delete(root);
         return send_json_error(req, TAG, WEBERR_INTERNAL_ERR, "Failed to store audio config");
     }
-    audio_streamer_apply_config(&config);
 
-    cJSON_Delete(root);
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"status\":\"ok\"}");
     return ESP_OK;
@@ -101,7 +126,8 @@ esp_err_t post_audio_stream_config(httpd_req_t* req) {
  * POST /api/v1/audio/settings
  * @summary Update audio capture settings
  * @tag Audio
- * @bodyDescription Update the audio sampling rate.
+ * @bodyDescription Update the audio sampling rate. The capture is re-clocked
+ * in place; an open audio stream is closed and must be reopened.
  * @bodyContent {AudioSettings} application/json
  * @bodyRequired
  * @response 200 - Audio settings updated
@@ -110,50 +136,37 @@ esp_err_t post_audio_stream_config(httpd_req_t* req) {
 esp_err_t post_audio_settings(httpd_req_t* req) {
     ESP_LOGI(TAG, "Handling audio capture settings");
 
-    char buf[256];
-    if (read_json_body(req, buf, sizeof buf) != ESP_OK) {
-        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Failed to receive request body");
-    }
-
-    cJSON* root = cJSON_Parse(buf);
-    if (!root) {
-        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Invalid JSON format");
+    json_doc_t doc;
+    esp_err_t err = json_request_read(req, &doc);
+    if (err != ESP_OK) {
+        return json_request_error(req, TAG, err);
     }
 
-    const cJSON* sample_rate = cJSON_GetObjectItem(root, "samplingRate");
-    if (!cJSON_IsNumber(sample_rate)) {
-        cJSON_Delete(root);
+    int rate = 0;
+    if (!json_reader_int(&doc, json_reader_find(&doc, 0, "samplingRate"), &rate)) {
         return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Invalid samplingRate field");
     }
 
-    int rate = (int)sample_rate->valuedouble;
-    switch (rate) {
-        case 8000:
-        case 11025:
-        case 16000:
-        case 22050:
-        case 32000:
-        case 44100:
-            break;
-        default:
-            cJSON_Delete(root);
-            return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Unsupported samplingRate");
+    if (!config_document_rate_supported(rate)) {
+        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Unsupported samplingRate");
     }
 
-    audio_config_t config = audio_config_get();
+    audio_config_t config;
+    audio_config_get(&config);
     int prev_rate = config.sampling_rate;
     config.sampling_rate = rate;
 
     if (audio_config_set(&config) != ESP_OK) {
-        cJSON_Delete(root);
         return send_json_error(req, TAG, WEBERR_INTERNAL_ERR, "Failed to store audio settings");
     }
 
     if (config.sampling_rate != prev_rate) {
         ESP_LOGI(TAG, "Sampling rate updated: %d -> %d", prev_rate, config.sampling_rate);
+        if (audio_capture_set_rate(config.sampling_rate) != ESP_OK) {
+            return send_json_error(req, TAG, WEBERR_INTERNAL_ERR, "Failed to apply sampling rate");
+        }
     }
 
-    cJSON_Delete(root);
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"status\":\"ok\"}");
     return ESP_OK;
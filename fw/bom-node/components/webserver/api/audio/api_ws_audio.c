@@ -0,0 +1,274 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "api_ws_audio.h"
+#include "audio_streamer.h"
+#include "esp_http_server.h"
+#include "ima_adpcm.h"
+#include "sdkconfig.h"
+
+static const char* TAG = "WS_AUDIO";
+
+#define AUDIO_WS_TASK_STACK 4096
+// Placed like the stream server task that sends the frames it fills.
+#define AUDIO_WS_TASK_PRIO  CONFIG_WEB_STREAM_TASK_PRIORITY
+#define AUDIO_WS_TASK_CORE  CONFIG_WEB_STREAM_TASK_CORE
+#define AUDIO_WS_FRAME_BYTES CONFIG_AUDIO_STREAM_WS_FRAME_BYTES
+#define AUDIO_WS_BUF_BYTES  (AUDIO_WS_HEADER_BYTES + AUDIO_WS_FRAME_BYTES)
+// Longest a partly filled frame waits for more audio (ADPCM reads come back
+// empty while a block fills).
+#define AUDIO_WS_LINGER_MS  40
+// Incoming data frames carry nothing yet; anything larger closes the socket.
+#define AUDIO_WS_RX_MAX     64
+
+_Static_assert(AUDIO_WS_FRAME_BYTES >= IMA_ADPCM_BLOCK_BYTES,
+               "a frame must hold one ADPCM block");
+
+// One per socket. The stream task fills one buffer while the server task
+// sends the other, so sending never runs on the stream task and the session
+// holds no request or worker. Owned by the stream task and by the server's
+// session (through sess_ctx); whichever lets go last frees it.
+typedef struct {
+    httpd_handle_t hd;
+    int fd;
+    audio_pull_client* client;
+    _Atomic int refs;
+    bool closed;  // server task only: the socket is gone, fd may be reused
+    SemaphoreHandle_t sent; // given when a queued send has run
+    esp_err_t send_err;
+    const uint8_t* tx;
+    size_t tx_len;
+    uint8_t buf[2][AUDIO_WS_BUF_BYTES];
+} audio_ws_session_t;
+
+static void audio_ws_put_le32(uint8_t* dst, uint32_t val) {
+    for (int i = 0; i < 4; i++) {
+        dst[i] = (uint8_t)(val >> (8 * i));
+    }
+}
+
+static void audio_ws_put_le64(uint8_t* dst, uint64_t val) {
+    audio_ws_put_le32(dst, (uint32_t)val);
+    audio_ws_put_le32(dst + 4, (uint32_t)(val >> 32));
+}
+
+static void audio_ws_release(audio_ws_session_t* s) {
+    if (atomic_fetch_sub(&s->refs, 1) == 1) {
+        vSemaphoreDelete(s->sent);
+        free(s);
+    }
+}
+
+// sess_ctx destructor; runs on the server task when the socket closes.
+static void audio_ws_free_ctx(void* ctx) {
+    audio_ws_session_t* s = (audio_ws_session_t*)ctx;
+    s->closed = true;
+    audio_ws_release(s);
+}
+
+// Server task. Checks `closed` there, where it cannot change underneath.
+static void audio_ws_send_work(void* arg) {
+    audio_ws_session_t* s = (audio_ws_session_t*)arg;
+    if (s->closed) {
+        s->send_err = ESP_ERR_INVALID_STATE;
+    } else {
+        httpd_ws_frame_t frame = {
+            .final = true,
+            .type = HTTPD_WS_TYPE_BINARY,
+            .payload = (uint8_t*)s->tx,
+            .len = s->tx_len,
+        };
+        s->send_err = httpd_ws_send_frame_async(s->hd, s->fd, &frame);
+    }
+    xSemaphoreGive(s->sent);
+}
+
+static void audio_ws_close_work(void* arg) {
+    audio_ws_session_t* s = (audio_ws_session_t*)arg;
+    if (!s->closed) {
+        httpd_sess_trigger_close(s->hd, s->fd);
+    }
+    audio_ws_release(s);
+}
+
+// Waits for the send in flight, if any. False once a send has failed.
+static bool audio_ws_wait_sent(audio_ws_session_t* s, bool* in_flight) {
+    if (!*in_flight) {
+        return true;
+    }
+    xSemaphoreTake(s->sent, portMAX_DELAY);
+    *in_flight = false;
+    return s->send_err == ESP_OK;
+}
+
+static void audio_ws_task(void* arg) {
+    audio_ws_session_t* s = (audio_ws_session_t*)arg;
+    const audio_stream_layout_t layout = audio_streamer_pull_layout(s->client);
+    const audio_stream_format_t format = layout.format;
+    const uint32_t format_epoch = audio_streamer_format_epoch();
+    // Whole frames and whole blocks only, as audio_streamer_pull_read gives.
+    const size_t unit = format == AUDIO_STREAM_ADPCM
+                            ? IMA_ADPCM_BLOCK_BYTES
+                            : layout.channels * sizeof(int16_t);
+    const size_t payload_max = AUDIO_WS_FRAME_BYTES - AUDIO_WS_FRAME_BYTES % unit;
+    // Mic sample indices one unit spans.
+    const uint64_t index_per_unit =
+        (uint64_t)layout.decimation *
+        (format == AUDIO_STREAM_ADPCM ? IMA_ADPCM_BLOCK_FRAMES(layout.channels) : 1);
+
+    int cur = 0;
+    size_t fill = 0;           // payload bytes in buf[cur]
+    uint64_t frame_index = 0;  // sample index of buf[cur]'s payload
+    uint64_t next_index = 0;   // sample index following the last byte read
+    TickType_t fill_tick = 0;  // when buf[cur] got its first bytes
+    bool started = false;
+    bool in_flight = false;
+    uint32_t seq = 0;
+    uint32_t dropped = 0;
+    bool ok = true;
+
+    ESP_LOGI(TAG, "WebSocket stream open (fd %d, %u-byte frames)", s->fd,
+             (unsigned)payload_max);
+    while (ok && audio_streamer_pull_enabled() &&
+           audio_streamer_format_epoch() == format_epoch) {
+        uint8_t* payload = &s->buf[cur][AUDIO_WS_HEADER_BYTES];
+        uint64_t index = 0;
+        const size_t got = audio_streamer_pull_read(
+            s->client, payload + fill, payload_max - fill, pdMS_TO_TICKS(200),
+            &index);
+        if (got > 0 && started && index != next_index) {
+            dropped += (uint32_t)((index - next_index) / layout.decimation);
+        }
+        // A read that does not continue a partly filled frame starts the
+        // next one; it is moved there below.
+        const bool gap = got > 0 && fill > 0 && index != next_index;
+        if (got > 0 && (!started || fill == 0)) {
+            frame_index = index;
+        }
+        if (got > 0) {
+            started = true;
+            next_index = index + (got / unit) * index_per_unit;
+        }
+
+        const size_t send_len = gap ? fill : fill + got;
+        if (fill == 0 && send_len > 0) {
+            fill_tick = xTaskGetTickCount();
+        }
+        // Full, cut by a gap, or partly filled for longer than the linger.
+        const bool due = send_len == payload_max || gap ||
+                         (send_len > 0 && got == 0 &&
+                          xTaskGetTickCount() - fill_tick >=
+                              pdMS_TO_TICKS(AUDIO_WS_LINGER_MS));
+        if (!due) {
+            fill = send_len;
+            continue;
+        }
+
+        uint8_t* hdr = s->buf[cur];
+        hdr[0] = AUDIO_WS_VERSION;
+        hdr[1] = (uint8_t)format;
+        hdr[2] = (uint8_t)layout.channels;
+        hdr[3] = AUDIO_WS_HEADER_BYTES;
+        audio_ws_put_le32(hdr + 4, seq);
+        audio_ws_put_le64(hdr + 8, frame_index);
+        audio_ws_put_le32(hdr + 16, dropped);
+        audio_ws_put_le32(hdr + 20, (uint32_t)layout.sample_rate);
+
+        ok = audio_ws_wait_sent(s, &in_flight);
+        if (!ok) {
+            break;
+        }
+        s->tx = hdr;
+        s->tx_len = AUDIO_WS_HEADER_BYTES + send_len;
+        if (httpd_queue_work(s->hd, audio_ws_send_work, s) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to queue WebSocket frame");
+            break;
+        }
+        in_flight = true;
+        seq++;
+
+        // The send before this one was of the other buffer and has run.
+        const int next = cur ^ 1;
+        fill = 0;
+        if (gap) {
+            // The read that did not continue the frame opens the next one.
+            memcpy(&s->buf[next][AUDIO_WS_HEADER_BYTES], payload + send_len,
+                   got);
+            fill = got;
+            frame_index = index;
+            fill_tick = xTaskGetTickCount();
+        }
+        cur = next;
+    }
+
+    audio_ws_wait_sent(s, &in_flight);
+    audio_streamer_pull_close(s->client);
+    ESP_LOGI(TAG, "WebSocket stream closed (fd %d, %lu frames)", s->fd,
+             (unsigned long)seq);
+    // Ends the socket unless the peer already has; drops the task's ref.
+    if (httpd_queue_work(s->hd, audio_ws_close_work, s) != ESP_OK) {
+        audio_ws_release(s);
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t api_ws_audio_stream(httpd_req_t* req) {
+    if (req->method == HTTP_GET) {
+        // Handshake done; the socket now belongs to the stream task.
+        if (!audio_streamer_pull_enabled()) {
+            ESP_LOGW(TAG, "WebSocket stream refused: pull mode disabled");
+            return ESP_FAIL;
+        }
+        audio_pull_client* client = audio_streamer_pull_open();
+        if (!client) {
+            ESP_LOGW(TAG, "WebSocket stream refused: all stream slots in use");
+            return ESP_FAIL;
+        }
+        audio_ws_session_t* s = calloc(1, sizeof(*s));
+        if (s) {
+            s->sent = xSemaphoreCreateBinary();
+        }
+        if (!s || !s->sent) {
+            free(s);
+            audio_streamer_pull_close(client);
+            return ESP_ERR_NO_MEM;
+        }
+        s->hd = req->handle;
+        s->fd = httpd_req_to_sockfd(req);
+        s->client = client;
+        atomic_store(&s->refs, 2);
+        req->sess_ctx = s;
+        req->free_ctx = audio_ws_free_ctx;
+        if (xTaskCreatePinnedToCore(audio_ws_task, "audio_ws", AUDIO_WS_TASK_STACK, s,
+                                    AUDIO_WS_TASK_PRIO, NULL, AUDIO_WS_TASK_CORE) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to start WebSocket stream task");
+            audio_streamer_pull_close(client);
+            audio_ws_release(s); // the session's ref goes with the socket
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+
+    // Control frames are answered by the server; data frames are drained.
+    httpd_ws_frame_t frame = {0};
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (frame.len > AUDIO_WS_RX_MAX) {
+        return ESP_FAIL;
+    }
+    if (frame.len > 0) {
+        uint8_t rx[AUDIO_WS_RX_MAX];
+        frame.payload = rx;
+        err = httpd_ws_recv_frame(req, &frame, sizeof(rx));
+    }
+    return err;
+}
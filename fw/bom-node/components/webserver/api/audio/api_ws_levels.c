@@ -0,0 +1,262 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "api_ws_levels.h"
+#include "audio_levels.h"
+#include "esp_http_server.h"
+#include "level_meter.h"
+#include "metrics.h"
+#include "sdkconfig.h"
+
+static const char* TAG = "WS_LEVELS";
+
+#define LEVELS_WS_TASK_STACK 3072
+// Placed like the stream server task that sends the frames it fills.
+#define LEVELS_WS_TASK_PRIO  CONFIG_WEB_STREAM_TASK_PRIORITY
+#define LEVELS_WS_TASK_CORE  CONFIG_WEB_STREAM_TASK_CORE
+// Every socket of the stream server may be a level client.
+#define LEVELS_WS_CLIENTS    CONFIG_WEB_STREAM_MAX_SOCKETS
+// Incoming data frames carry nothing yet; anything larger closes the socket.
+#define LEVELS_WS_RX_MAX     64
+
+// One per socket, in a fixed table. The meter task merges blocks into the
+// window and encodes the frame; the server task sends it and frees the slot
+// when the socket closes, so a send never races a reused fd.
+typedef struct {
+    bool used;
+    int fd;
+    uint16_t window_ms;
+    uint16_t blocks;       // per window
+    uint16_t merged;       // blocks in `acc`
+    audio_levels_sum acc;
+    uint32_t seq;
+    bool pending;          // `frame` waits for the server task
+    uint8_t frame[AUDIO_LEVELS_FRAME_BYTES];
+} levels_ws_client_t;
+
+static levels_ws_client_t s_clients[LEVELS_WS_CLIENTS];
+static SemaphoreHandle_t s_lock = NULL;
+static httpd_handle_t s_hd = NULL;
+static TaskHandle_t s_task = NULL;
+static _Atomic bool s_work_queued = false;
+static uint32_t s_open = 0;
+static metrics_counter s_frames_sent = METRICS_COUNTER_INIT(
+    "levels_ws_frames_total", "Level meter frames sent, all clients.");
+static metrics_counter s_frames_dropped = METRICS_COUNTER_INIT(
+    "levels_ws_frames_dropped_total", "Level meter frames replaced before they were sent.");
+
+// Reader task, once per published block.
+static void levels_ws_on_block(void* ctx) {
+    (void)ctx;
+    xTaskNotifyGive(s_task);
+}
+
+// Server task. Clears the flag first, so a frame encoded during the sends
+// queues another pass.
+static void levels_ws_send_work(void* arg) {
+    (void)arg;
+    atomic_store(&s_work_queued, false);
+    for (int i = 0; i < LEVELS_WS_CLIENTS; i++) {
+        uint8_t buf[AUDIO_LEVELS_FRAME_BYTES];
+        int fd = -1;
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        levels_ws_client_t* c = &s_clients[i];
+        if (c->used && c->pending) {
+            memcpy(buf, c->frame, sizeof(buf));
+            c->pending = false;
+            fd = c->fd;
+        }
+        xSemaphoreGive(s_lock);
+        if (fd < 0) {
+            continue;
+        }
+        httpd_ws_frame_t frame = {
+            .final = true,
+            .type = HTTPD_WS_TYPE_BINARY,
+            .payload = buf,
+            .len = sizeof(buf),
+        };
+        if (httpd_ws_send_frame_async(s_hd, fd, &frame) == ESP_OK) {
+            metrics_counter_inc(&s_frames_sent);
+        } else {
+            httpd_sess_trigger_close(s_hd, fd);
+        }
+    }
+}
+
+// Adds the block to every client's window and encodes the windows it
+// completes. Returns true when a frame is ready.
+static bool levels_ws_add_block(const level_meter_block* b) {
+    bool ready = false;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < LEVELS_WS_CLIENTS; i++) {
+        levels_ws_client_t* c = &s_clients[i];
+        if (!c->used) {
+            continue;
+        }
+        // A gap in the audio (or in the blocks read) starts the window over.
+        if (!audio_levels_merge(&c->acc, &b->sum)) {
+            c->acc = b->sum;
+            c->merged = 0;
+        }
+        if (++c->merged < c->blocks) {
+            continue;
+        }
+        if (c->pending) {
+            metrics_counter_inc(&s_frames_dropped);
+        }
+        audio_levels_encode(&c->acc, b->floor, c->seq++, c->window_ms, c->frame);
+        c->pending = true;
+        memset(&c->acc, 0, sizeof(c->acc));
+        c->merged = 0;
+        ready = true;
+    }
+    xSemaphoreGive(s_lock);
+    return ready;
+}
+
+static void levels_ws_task(void* arg) {
+    (void)arg;
+    uint32_t cursor = level_meter_next_seq();
+    level_meter_block block;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        bool ready = false;
+        while (level_meter_read(&cursor, &block)) {
+            ready |= levels_ws_add_block(&block);
+        }
+        if (ready && !atomic_exchange(&s_work_queued, true) &&
+            httpd_queue_work(s_hd, levels_ws_send_work, NULL) != ESP_OK) {
+            atomic_store(&s_work_queued, false);
+            ESP_LOGW(TAG, "Failed to queue level frames");
+        }
+    }
+}
+
+// sess_ctx destructor; runs on the server task when the socket closes.
+static void levels_ws_free_ctx(void* ctx) {
+    levels_ws_client_t* c = (levels_ws_client_t*)ctx;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    c->used = false;
+    c->pending = false;
+    s_open--;
+    xSemaphoreGive(s_lock);
+    level_meter_release();
+    ESP_LOGI(TAG, "Level stream closed (fd %d, %lu frames)", c->fd,
+             (unsigned long)c->seq);
+}
+
+// Started with the first client; the server task runs the handlers one at a
+// time, so this needs no lock of its own.
+static bool levels_ws_start(httpd_handle_t hd) {
+    if (s_task) {
+        return true;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) {
+        return false;
+    }
+    s_hd = hd;
+    metrics_register(&s_frames_sent.base);
+    metrics_register(&s_frames_dropped.base);
+    if (xTaskCreatePinnedToCore(levels_ws_task, "levels_ws", LEVELS_WS_TASK_STACK, NULL,
+                                LEVELS_WS_TASK_PRIO, &s_task,
+                                LEVELS_WS_TASK_CORE) != pdPASS) {
+        vSemaphoreDelete(s_lock);
+        s_lock = NULL;
+        return false;
+    }
+    level_meter_set_listener(levels_ws_on_block, NULL);
+    return true;
+}
+
+// Window from `?window_ms=`, as a whole number of blocks in range.
+static uint16_t levels_ws_window_blocks(httpd_req_t* req) {
+    long ms = CONFIG_AUDIO_LEVELS_WINDOW_MS;
+    char query[32];
+    char value[8];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "window_ms", value, sizeof(value)) == ESP_OK) {
+        char* end = NULL;
+        const long v = strtol(value, &end, 10);
+        if (end != value && *end == '\0') {
+            ms = v;
+        }
+    }
+    if (ms < LEVEL_METER_WINDOW_MIN_MS) {
+        ms = LEVEL_METER_WINDOW_MIN_MS;
+    } else if (ms > LEVEL_METER_WINDOW_MAX_MS) {
+        ms = LEVEL_METER_WINDOW_MAX_MS;
+    }
+    return (uint16_t)((ms + LEVEL_METER_BLOCK_MS / 2) / LEVEL_METER_BLOCK_MS);
+}
+
+esp_err_t api_ws_levels_stream(httpd_req_t* req) {
+    if (req->method == HTTP_GET) {
+        // Handshake done; the socket now receives the level frames.
+        if (!levels_ws_start(req->handle)) {
+            ESP_LOGE(TAG, "Failed to start level stream task");
+            return ESP_FAIL;
+        }
+        const uint16_t blocks = levels_ws_window_blocks(req);
+        levels_ws_client_t* c = NULL;
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        for (int i = 0; i < LEVELS_WS_CLIENTS && !c; i++) {
+            if (!s_clients[i].used) {
+                c = &s_clients[i];
+                memset(c, 0, sizeof(*c));
+                c->used = true;
+                c->fd = httpd_req_to_sockfd(req);
+                c->blocks = blocks;
+                c->window_ms = (uint16_t)(blocks * LEVEL_METER_BLOCK_MS);
+                s_open++;
+            }
+        }
+        xSemaphoreGive(s_lock);
+        if (!c) {
+            ESP_LOGW(TAG, "Level stream refused: no client slot left");
+            return ESP_FAIL;
+        }
+        req->sess_ctx = c;
+        req->free_ctx = levels_ws_free_ctx;
+        level_meter_acquire();
+        ESP_LOGI(TAG, "Level stream open (fd %d, %u ms windows)", c->fd,
+                 (unsigned)c->window_ms);
+        return ESP_OK;
+    }
+
+    // Control frames are answered by the server; data frames are drained.
+    httpd_ws_frame_t frame = {0};
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (frame.len > LEVELS_WS_RX_MAX) {
+        return ESP_FAIL;
+    }
+    if (frame.len > 0) {
+        uint8_t rx[LEVELS_WS_RX_MAX];
+        frame.payload = rx;
+        err = httpd_ws_recv_frame(req, &frame, sizeof(rx));
+    }
+    return err;
+}
+
+void api_ws_levels_get_stats(api_ws_levels_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!s_lock) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    stats->clients = s_open;
+    xSemaphoreGive(s_lock);
+    stats->frames_sent = metrics_counter_read32(&s_frames_sent);
+    stats->frames_dropped = metrics_counter_read32(&s_frames_dropped);
+}
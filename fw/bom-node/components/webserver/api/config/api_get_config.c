@@ -4,11 +4,11 @@
 #include "esp_log.h"
 
 #include "api_get_config.h"
-#include "cJSON.h"
 #include "error_handler.h"
 #include "handler.h"
 #include "slre.h"
 #include "audio_config.h"
+#include "config_document.h"
 #include "wifi.h"
 #include "wifi_config.h"
 
@@ -18,11 +18,11 @@ static const char* TAG = "GET_CONFIG";
 esp_err_t get_config_status(httpd_req_t* req);
 
 // Table of routes
-static const route_entry_t route_table[] = {{"^/api/v1/config/?$", get_config_status}};
+static const route_entry_t route_table[] = {{"/api/v1/config", get_config_status}};
 
 // Main handler for GET config/* requests
 esp_err_t api_get_config(httpd_req_t* req) {
-    ESP_LOGI(TAG, "Received GET request: %s", req->uri);
+    ESP_LOGD(TAG, "Received GET request: %s", req->uri);
 
     return route_request(req, route_table, sizeof(route_table) / sizeof(route_entry_t));
 }
@@ -33,20 +33,18 @@ esp_err_t api_get_config(httpd_req_t* req) {
 
 /**
  * GET /api/v1/config
- * @summary Get device status
+ * Besides the setup flags, carries the configuration document POST
+ * /api/v1/config takes: "version", "audio" and "wifi". The version is also sent as
+ * ETag; a request whose If-None-Match names it gets 304 without a body.
+ * @summary Get device status and configuration
  * @tag Device
  * @response 200 - Device status
+ * @response 304 - Configuration unchanged
  * @response 500 - Internal error
  * @responseContent {ConfigStatus} 200.application/json
  * @responseExample {ConfigStatus200} 200.application/json.200
 */
 esp_err_t get_config_status(httpd_req_t* req) {
-    // Build JSON response using cJSON
-    cJSON* root = cJSON_CreateObject();
-    if (!root) {
-        return send_json_error(req, TAG, WEBERR_INTERNAL_ERR, "Failed to allocate cJSON");
-    }
-
     bool wifiConfigured = is_wifi_configured();
     bool wifiConnected = is_wifi_connected();
     bool apEnabled = is_ap_enabled();
@@ -54,23 +52,30 @@ esp_err_t get_config_status(httpd_req_t* req) {
 
     bool isSetupDone = wifiConfigured;
 
-    cJSON_AddBoolToObject(root, "isSetupDone", isSetupDone);
-    cJSON_AddBoolToObject(root, "wifiConfigured", wifiConfigured);
-    cJSON_AddBoolToObject(root, "wifiConnected", wifiConnected);
-    cJSON_AddBoolToObject(root, "apEnabled", apEnabled);
-    cJSON_AddBoolToObject(root, "audioConfigured", audioConfigured);
-    cJSON_AddStringToObject(root, "deviceName", "BOM-Node");
+    config_document_t doc;
+    config_document_load(&doc);
+    char etag[CONFIG_DOCUMENT_ETAG_BUF];
+    config_document_etag(&doc, etag);
+    httpd_resp_set_hdr(req, "ETag", etag);
 
-    const char* resp_str = cJSON_PrintUnformatted(root);
-    if (!resp_str) {
-        ESP_LOGE(TAG, "Failed to allocate memory for JSON response");
-        cJSON_Delete(root);
-        return send_json_error(req, TAG, WEBERR_INTERNAL_ERR,
-                               "Failed to allocate memory for JSON response");
+    char if_none_match[CONFIG_DOCUMENT_ETAG_BUF];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match,
+                                    sizeof(if_none_match)) == ESP_OK &&
+        strcmp(if_none_match, etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
     }
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, resp_str, strlen(resp_str));
-    cJSON_Delete(root);
-    free((void*)resp_str);
-    return ESP_OK;
+
+    json_writer_t w;
+    json_response_begin(&w);
+    json_writer_object_begin(&w, NULL);
+    json_writer_bool(&w, "isSetupDone", isSetupDone);
+    json_writer_bool(&w, "wifiConfigured", wifiConfigured);
+    json_writer_bool(&w, "wifiConnected", wifiConnected);
+    json_writer_bool(&w, "apEnabled", apEnabled);
+    json_writer_bool(&w, "audioConfigured", audioConfigured);
+    json_writer_string(&w, "deviceName", "BOM-Node");
+    config_document_write(&w, &doc);
+    json_writer_object_end(&w);
+    return json_response_send(req, &w, TAG);
 }
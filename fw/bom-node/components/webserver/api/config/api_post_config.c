@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "api_post_config.h"
+#include "audio_capture.h"
+#include "config_document.h"
+#include "error_handler.h"
+#include "handler.h"
+#include "wifi.h"
+#include "wifi_perf.h"
+
+static const char* TAG = "POST_CONFIG";
+
+// Definition of handlers
+esp_err_t post_config_document(httpd_req_t* req);
+
+// Table of routes
+static const route_entry_t route_table[] = {{"/api/v1/config", post_config_document}};
+
+// Main handler for POST config/* requests
+esp_err_t api_post_config(httpd_req_t* req) {
+    ESP_LOGD(TAG, "Received POST request: %s", req->uri);
+
+    return route_request(req, route_table, sizeof(route_table) / sizeof(route_entry_t));
+}
+
+// The version the client based its change on: the If-Match header, else the
+// document's own "version". False when it sent neither.
+static bool expected_version(httpd_req_t* req, const json_doc_t* json, char* out, size_t cap) {
+    const size_t len = httpd_req_get_hdr_value_len(req, "If-Match");
+    if (len > 0) {
+        // A tag too long to be ours can only mismatch.
+        if (len >= cap || httpd_req_get_hdr_value_str(req, "If-Match", out, cap) != ESP_OK) {
+            out[0] = '\0';
+        }
+        return true;
+    }
+    const int version = json_reader_find(json, 0, "version");
+    if (version < 0) {
+        return false;
+    }
+    if (!json_reader_string(json, version, out, cap)) {
+        out[0] = '\0';
+    }
+    return true;
+}
+
+// Validated settings in, everything that differs applied. The audio fields
+// go through a single audio_config_set(), so listeners hear about all of them
+// at once and NVS is committed once.
+static const char* apply_document(const config_document_t* current,
+                                  const config_document_t* next) {
+    if (audio_config_set(&next->audio) != ESP_OK) {
+        return "Failed to store audio config";
+    }
+    if (next->audio.sampling_rate != current->audio.sampling_rate) {
+        ESP_LOGI(TAG, "Sampling rate updated: %d -> %d", current->audio.sampling_rate,
+                 next->audio.sampling_rate);
+        if (audio_capture_set_rate(next->audio.sampling_rate) != ESP_OK) {
+            return "Failed to apply sampling rate";
+        }
+    }
+    if ((next->ap_enabled != current->ap_enabled ||
+         strcmp(next->ap_ssid, current->ap_ssid) != 0) &&
+        wifi_set_ap_config(next->ap_enabled, next->ap_ssid) != ESP_OK) {
+        return "Failed to update AP config";
+    }
+    if (next->tx_power_dbm != current->tx_power_dbm &&
+        wifi_perf_set_tx_power(next->tx_power_dbm) != ESP_OK) {
+        return "Failed to set TX power";
+    }
+    if (next->bandwidth != current->bandwidth && wifi_perf_set_bandwidth(next->bandwidth) != ESP_OK) {
+        return "Failed to set bandwidth";
+    }
+    return NULL;
+}
+
+/**
+ * POST /api/v1/config
+ * @summary Replace the node configuration in one request
+ * @tag Device
+ * @bodyDescription The document GET /api/v1/config returns, or any part of it. Every
+ * field is validated before anything is applied. To guard against concurrent changes,
+ * send the version the change is based on in If-Match or as "version"; a stale one is
+ * refused with 412 unless the document matches the current settings already, so a
+ * retried request succeeds without applying anything twice.
+ * @bodyContent {ConfigDocument} application/json
+ * @bodyRequired
+ * @response 200 - Settings in effect, with their version in the ETag header
+ * @response 400 - Invalid document
+ * @response 412 - The settings changed since the given version
+ * @response 500 - Internal error
+ */
+esp_err_t post_config_document(httpd_req_t* req) {
+    ESP_LOGI(TAG, "Handling config document");
+
+    json_doc_t json;
+    esp_err_t err = json_request_read(req, &json);
+    if (err != ESP_OK) {
+        return json_request_error(req, TAG, err);
+    }
+
+    config_document_t current;
+    config_document_load(&current);
+    config_document_t next = current;
+    const char* invalid = config_document_parse(&json, 0, &next);
+    if (invalid) {
+        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, invalid);
+    }
+
+    char etag[CONFIG_DOCUMENT_ETAG_BUF];
+    char next_etag[CONFIG_DOCUMENT_ETAG_BUF];
+    config_document_etag(&current, etag);
+    config_document_etag(&next, next_etag);
+    if (strcmp(etag, next_etag) != 0) {
+        char expected[CONFIG_DOCUMENT_ETAG_BUF];
+        if (expected_version(req, &json, expected, sizeof(expected)) &&
+            strcmp(expected, etag) != 0 && strcmp(expected, "*") != 0) {
+            httpd_resp_set_status(req, "412 Precondition Failed");
+            httpd_resp_set_hdr(req, "ETag", etag);
+            return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Configuration has changed");
+        }
+        const char* failed = apply_document(&current, &next);
+        if (failed) {
+            return send_json_error(req, TAG, WEBERR_INTERNAL_ERR, failed);
+        }
+        config_document_load(&current);
+        config_document_etag(&current, etag);
+    }
+
+    httpd_resp_set_hdr(req, "ETag", etag);
+    json_writer_t w;
+    json_response_begin(&w);
+    json_writer_object_begin(&w, NULL);
+    json_writer_string(&w, "status", "ok");
+    config_document_write(&w, &current);
+    json_writer_object_end(&w);
+    return json_response_send(req, &w, TAG);
+}
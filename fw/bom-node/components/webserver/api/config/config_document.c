@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "audio_shaper.h"
+#include "audio_streamer.h"
+#include "config_document.h"
+#include "wifi_config.h"
+#include "wifi_perf.h"
+
+void config_document_load(config_document_t* doc) {
+    memset(doc, 0, sizeof(*doc));
+    audio_config_get(&doc->audio);
+    doc->ap_enabled = is_ap_enabled();
+    strncpy(doc->ap_ssid, get_ap_ssid(), sizeof(doc->ap_ssid) - 1);
+    wifi_perf_status_t perf;
+    wifi_perf_get_status(&perf);
+    doc->tx_power_dbm = perf.tx_power_dbm;
+    doc->bandwidth = perf.bandwidth;
+}
+
+void config_document_write(json_writer_t* w, const config_document_t* doc) {
+    char etag[CONFIG_DOCUMENT_ETAG_BUF];
+    config_document_etag(doc, etag);
+    json_writer_string(w, "version", etag);
+
+    const audio_config_t* audio = &doc->audio;
+    json_writer_object_begin(w, "audio");
+    json_writer_string(w, "mode", audio->mode);
+    json_writer_string(w, "uploadUrl", audio->upload_url);
+    json_writer_bool(w, "enabled", audio->enabled);
+    json_writer_string(w, "format", audio->format);
+    json_writer_string(w, "channels", audio->channels);
+    json_writer_int(w, "decimation", audio->decimation);
+    json_writer_int(w, "samplingRate", audio->sampling_rate);
+    json_writer_object_end(w);
+
+    json_writer_object_begin(w, "wifi");
+    json_writer_bool(w, "apEnabled", doc->ap_enabled);
+    json_writer_string(w, "apSsid", doc->ap_ssid);
+    json_writer_int(w, "txPowerDbm", doc->tx_power_dbm);
+    json_writer_string(w, "bandwidth", wifi_perf_bandwidth_name(doc->bandwidth));
+    json_writer_object_end(w);
+}
+
+// Copies member `key` of `object`, if present, into `out`.
+static bool read_string(const json_doc_t* json, int object, const char* key, char* out,
+                        size_t cap) {
+    const int tok = json_reader_find(json, object, key);
+    return tok < 0 || json_reader_string(json, tok, out, cap);
+}
+
+static bool read_int(const json_doc_t* json, int object, const char* key, int* out) {
+    const int tok = json_reader_find(json, object, key);
+    return tok < 0 || json_reader_int(json, tok, out);
+}
+
+static bool read_bool(const json_doc_t* json, int object, const char* key, bool* out) {
+    const int tok = json_reader_find(json, object, key);
+    return tok < 0 || json_reader_bool(json, tok, out);
+}
+
+static const char* parse_audio(const json_doc_t* json, int object, audio_config_t* audio) {
+    if (!read_string(json, object, "mode", audio->mode, sizeof(audio->mode))) {
+        return "Invalid audio.mode";
+    }
+    if (!read_string(json, object, "uploadUrl", audio->upload_url, sizeof(audio->upload_url))) {
+        return "Invalid audio.uploadUrl";
+    }
+    if (!read_bool(json, object, "enabled", &audio->enabled)) {
+        return "Invalid audio.enabled";
+    }
+    audio_stream_format_t format;
+    if (!read_string(json, object, "format", audio->format, sizeof(audio->format)) ||
+        !audio_streamer_parse_format(audio->format, &format)) {
+        return "Unsupported audio.format";
+    }
+    audio_channel_mode channels;
+    if (!read_string(json, object, "channels", audio->channels, sizeof(audio->channels)) ||
+        !audio_shaper_parse_channels(audio->channels, &channels)) {
+        return "Unsupported audio.channels";
+    }
+    if (!read_int(json, object, "decimation", &audio->decimation) || audio->decimation < 1 ||
+        audio->decimation > AUDIO_SHAPER_MAX_DECIMATION) {
+        return "Unsupported audio.decimation";
+    }
+    if (!read_int(json, object, "samplingRate", &audio->sampling_rate) ||
+        !config_document_rate_supported(audio->sampling_rate)) {
+        return "Unsupported audio.samplingRate";
+    }
+    return NULL;
+}
+
+static const char* parse_wifi(const json_doc_t* json, int object, config_document_t* doc) {
+    if (!read_bool(json, object, "apEnabled", &doc->ap_enabled)) {
+        return "Invalid wifi.apEnabled";
+    }
+    if (!read_string(json, object, "apSsid", doc->ap_ssid, sizeof(doc->ap_ssid))) {
+        return "Invalid wifi.apSsid";
+    }
+    if (doc->ap_enabled && doc->ap_ssid[0] == '\0') {
+        return "SSID required when enabling AP";
+    }
+    if (!read_int(json, object, "txPowerDbm", &doc->tx_power_dbm) ||
+        (doc->tx_power_dbm != 0 && (doc->tx_power_dbm < WIFI_PERF_TX_POWER_MIN_DBM ||
+                                    doc->tx_power_dbm > WIFI_PERF_TX_POWER_MAX_DBM))) {
+        return "wifi.txPowerDbm out of range";
+    }
+    char bandwidth[8];
+    const int bandwidth_tok = json_reader_find(json, object, "bandwidth");
+    if (bandwidth_tok >= 0 &&
+        (!json_reader_string(json, bandwidth_tok, bandwidth, sizeof(bandwidth)) ||
+         !wifi_perf_parse_bandwidth(bandwidth, &doc->bandwidth))) {
+        return "wifi.bandwidth must be \"ht20\" or \"ht40\"";
+    }
+    return NULL;
+}
+
+const char* config_document_parse(const json_doc_t* json, int object, config_document_t* doc) {
+    if (!json_reader_is(json, object, JSON_TOKEN_OBJECT)) {
+        return "Document must be an object";
+    }
+    const int audio = json_reader_find(json, object, "audio");
+    if (audio >= 0) {
+        if (!json_reader_is(json, audio, JSON_TOKEN_OBJECT)) {
+            return "audio must be an object";
+        }
+        const char* err = parse_audio(json, audio, &doc->audio);
+        if (err) {
+            return err;
+        }
+    }
+    const int wifi = json_reader_find(json, object, "wifi");
+    if (wifi >= 0) {
+        if (!json_reader_is(json, wifi, JSON_TOKEN_OBJECT)) {
+            return "wifi must be an object";
+        }
+        return parse_wifi(json, wifi, doc);
+    }
+    return NULL;
+}
+
+// FNV-1a.
+static uint32_t hash_bytes(uint32_t h, const void* data, size_t len) {
+    const uint8_t* p = data;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+static uint32_t hash_string(uint32_t h, const char* s) {
+    return hash_bytes(h, s, strlen(s) + 1);
+}
+
+static uint32_t hash_int(uint32_t h, int32_t v) {
+    return hash_bytes(h, &v, sizeof(v));
+}
+
+void config_document_etag(const config_document_t* doc, char out[CONFIG_DOCUMENT_ETAG_BUF]) {
+    // Field by field, so padding and bytes past a string's NUL do not count.
+    const audio_config_t* audio = &doc->audio;
+    uint32_t h = 2166136261u;
+    h = hash_string(h, audio->mode);
+    h = hash_string(h, audio->upload_url);
+    h = hash_string(h, audio->format);
+    h = hash_string(h, audio->channels);
+    h = hash_int(h, audio->decimation);
+    h = hash_int(h, audio->enabled);
+    h = hash_int(h, audio->sampling_rate);
+    h = hash_int(h, doc->ap_enabled);
+    h = hash_string(h, doc->ap_ssid);
+    h = hash_int(h, doc->tx_power_dbm);
+    h = hash_int(h, (int32_t)doc->bandwidth);
+    snprintf(out, CONFIG_DOCUMENT_ETAG_BUF, "\"%08lx\"", (unsigned long)h);
+}
+
+bool config_document_rate_supported(int rate) {
+    switch (rate) {
+        case 8000:
+        case 11025:
+        case 16000:
+        case 22050:
+        case 32000:
+        case 44100:
+            return true;
+        default:
+            return false;
+    }
+}
@@ -13,6 +13,9 @@ extern "C" {
 
 esp_err_t api_get_audio(httpd_req_t* req);
 
+// GET /api/v1/audio/stream.wav, on the stream server (CONFIG_WEB_STREAM_PORT).
+esp_err_t api_get_audio_stream(httpd_req_t* req);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
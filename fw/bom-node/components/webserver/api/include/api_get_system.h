@@ -4,3 +4,18 @@
 #include "esp_http_server.h"
 
 esp_err_t api_get_system(httpd_req_t* req);
+
+// Prometheus text exposition of the metrics registry.
+esp_err_t api_get_metrics(httpd_req_t* req);
+
+// Time of each boot stage reached so far (boot_timing.h).
+esp_err_t api_get_boot(httpd_req_t* req);
+
+// CPU frequency scaling setup and time per power mode (power.h).
+esp_err_t api_get_power(httpd_req_t* req);
+
+// Per-task CPU load, core, priority and stack headroom from the task monitor.
+esp_err_t api_get_tasks(httpd_req_t* req);
+
+// Chrome trace event JSON export of the trace rings.
+esp_err_t api_get_trace(httpd_req_t* req);
@@ -0,0 +1,22 @@
+/**
+ * \file            api_post_config.h
+ * \brief           API POST CONFIG header file
+ * \details         This file contains the function prototype for the API POST CONFIG handler.
+ */
+#ifndef API_POST_CONFIG_HDR_H
+#define API_POST_CONFIG_HDR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "esp_http_server.h"
+
+/* Function prototypes, name aligned, lowercase names */
+esp_err_t api_post_config(httpd_req_t* req);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* API_POST_CONFIG_HDR_H */
@@ -0,0 +1,41 @@
+/**
+ * \file            api_ws_audio.h
+ * \brief           API WebSocket audio stream header file
+ */
+#ifndef API_WS_AUDIO_HDR_H
+#define API_WS_AUDIO_HDR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "esp_http_server.h"
+
+/*
+ * Binary frame layout of /api/v1/audio/stream.ws, all fields little-endian:
+ *
+ *   0  u8   version (AUDIO_WS_VERSION)
+ *   1  u8   format: 0 = 16-bit PCM, 1 = IMA ADPCM (WAV 0x11 blocks)
+ *   2  u8   channels, interleaved
+ *   3  u8   header length (AUDIO_WS_HEADER_BYTES)
+ *   4  u32  frame sequence number, from 0 per connection
+ *   8  u64  mic sample index of the first sample in the payload
+ *  16  u32  samples per channel dropped since the connection opened, at the
+ *           stream rate
+ *  20  u32  stream sample rate [Hz]; with decimation, consecutive samples
+ *           are (mic rate / stream rate) mic sample indices apart
+ *  24       payload: whole PCM frames or whole ADPCM blocks
+ *
+ * A frame's payload is gap-free; a jump in the sample index between two
+ * frames is audio that was dropped, and is also added to the drop count.
+ */
+#define AUDIO_WS_VERSION      1
+#define AUDIO_WS_HEADER_BYTES 24
+
+esp_err_t api_ws_audio_stream(httpd_req_t* req);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* API_WS_AUDIO_HDR_H */
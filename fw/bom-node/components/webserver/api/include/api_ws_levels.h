@@ -0,0 +1,40 @@
+/**
+ * \file            api_ws_levels.h
+ * \brief           API WebSocket level meter header file
+ */
+#ifndef API_WS_LEVELS_HDR_H
+#define API_WS_LEVELS_HDR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdint.h>
+#include "esp_http_server.h"
+
+/*
+ * /api/v1/audio/levels.ws sends one binary frame of AUDIO_LEVELS_FRAME_BYTES
+ * per window (layout in audio_levels.h): RMS, peak, crest factor and the
+ * detector's noise floor of both channels. `?window_ms=` picks the window,
+ * rounded to whole LEVEL_METER_BLOCK_MS blocks within
+ * LEVEL_METER_WINDOW_MIN_MS .. LEVEL_METER_WINDOW_MAX_MS; without it the
+ * window is CONFIG_AUDIO_LEVELS_WINDOW_MS. The frame carries the window in
+ * effect. All clients share one level meter and one sender, so a client
+ * costs a socket and a few bytes per window; a frame a slow client has not
+ * taken by the next window is replaced, not queued.
+ */
+esp_err_t api_ws_levels_stream(httpd_req_t* req);
+
+typedef struct {
+    uint32_t clients;        // sockets open now
+    uint32_t frames_sent;    // since boot, all clients
+    uint32_t frames_dropped; // replaced before they were sent
+} api_ws_levels_stats_t;
+
+void api_ws_levels_get_stats(api_ws_levels_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* API_WS_LEVELS_HDR_H */
@@ -0,0 +1,70 @@
+/**
+ * \file            config_document.h
+ * \brief           Node configuration as one JSON document
+ * \details         The settings fleet tooling changes, gathered so they can be read,
+ *                  compared and written in one request: the audio stream and capture
+ *                  settings and the Wi-Fi AP and radio settings. Station credentials
+ *                  stay with POST /api/v1/wifi/connect, which has to join the network
+ *                  to keep them, and are never read back.
+ */
+#ifndef CONFIG_DOCUMENT_HDR_H
+#define CONFIG_DOCUMENT_HDR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdbool.h>
+#include "audio_config.h"
+#include "esp_wifi_types.h"
+#include "json_reader.h"
+#include "json_writer.h"
+
+// 32 byte SSID and its NUL.
+#define CONFIG_DOCUMENT_SSID_BUF 33
+// A quoted 32 bit hash, as sent in the ETag header, and its NUL.
+#define CONFIG_DOCUMENT_ETAG_BUF 11
+
+typedef struct {
+    audio_config_t audio;
+    bool ap_enabled;
+    char ap_ssid[CONFIG_DOCUMENT_SSID_BUF];
+    int tx_power_dbm; // 0 for the PHY default
+    wifi_bandwidth_t bandwidth;
+} config_document_t;
+
+// The settings in effect.
+void config_document_load(config_document_t* doc);
+
+/*
+ * \brief           Write the "version", "audio" and "wifi" members
+ * \param[in]       w: Writer inside an open object
+ * \param[in]       doc: Settings
+ */
+void config_document_write(json_writer_t* w, const config_document_t* doc);
+
+/*
+ * \brief           Apply the members of a JSON document to `doc`
+ * \details         Either section and any field may be left out and keeps its value;
+ *                  unknown members, including the read-only ones GET adds, are ignored,
+ *                  so a fetched document can be posted back as is.
+ * \param[in]       json: Tokens of the request
+ * \param[in]       object: Token index of the document object
+ * \param[in,out]   doc: Settings to update
+ * \return          NULL when every field is valid, else what is wrong; `doc` may hold
+ *                  part of the update then
+ */
+const char* config_document_parse(const json_doc_t* json, int object, config_document_t* doc);
+
+// Content hash of the settings as a quoted entity tag, the document's
+// "version". Identical settings give the same tag across reboots.
+void config_document_etag(const config_document_t* doc, char out[CONFIG_DOCUMENT_ETAG_BUF]);
+
+// The capture rates POST /api/v1/audio/settings and the document accept.
+bool config_document_rate_supported(int rate);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* CONFIG_DOCUMENT_HDR_H */
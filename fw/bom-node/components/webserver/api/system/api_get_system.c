@@ -1,7 +1,175 @@
 #include "api_get_system.h"
 
+#include <stdio.h>
+#include <string.h>
+#include "boot_timing.h"
+#include "error_handler.h"
+#include "handler.h"
+#include "metrics.h"
+#include "power.h"
+#include "task_monitor.h"
+#include "trace.h"
+
+static const char* TAG = "GET_SYSTEM";
+
+#define STREAM_CHUNK_SIZE 1024
+
 esp_err_t api_get_system(httpd_req_t* req) {
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"status\":\"ok\"}");
     return ESP_OK;
 }
+
+// Streamed bodies are gathered into chunks; handlers only run on the server
+// task, so one static buffer serves every request.
+typedef struct {
+    httpd_req_t* req;
+    size_t len;
+    esp_err_t err;
+} chunk_stream_t;
+
+static char s_chunk[STREAM_CHUNK_SIZE];
+
+static void chunk_stream_flush(chunk_stream_t* st) {
+    if (st->len > 0 && st->err == ESP_OK) {
+        st->err = httpd_resp_send_chunk(st->req, s_chunk, st->len);
+    }
+    st->len = 0;
+}
+
+static esp_err_t chunk_stream_write(const char* data, size_t len, void* ctx) {
+    chunk_stream_t* st = ctx;
+    while (len > 0 && st->err == ESP_OK) {
+        if (st->len == sizeof(s_chunk)) {
+            chunk_stream_flush(st);
+        }
+        size_t n = sizeof(s_chunk) - st->len;
+        n = n < len ? n : len;
+        memcpy(&s_chunk[st->len], data, n);
+        st->len += n;
+        data += n;
+        len -= n;
+    }
+    return st->err;
+}
+
+static esp_err_t chunk_stream_end(chunk_stream_t* st) {
+    chunk_stream_flush(st);
+    if (st->err != ESP_OK) {
+        return st->err;
+    }
+    return httpd_resp_send_chunk(st->req, NULL, 0);
+}
+
+static void metrics_sink(const char* data, size_t len, void* ctx) {
+    chunk_stream_write(data, len, ctx);
+}
+
+esp_err_t api_get_metrics(httpd_req_t* req) {
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    chunk_stream_t st = {.req = req, .len = 0, .err = ESP_OK};
+    metrics_expose(metrics_sink, &st);
+    return chunk_stream_end(&st);
+}
+
+/**
+ * GET /api/v1/system/trace
+ * @summary Download the trace rings as Chrome trace event JSON
+ * @tag System
+ * @response 200 - Trace for chrome://tracing or ui.perfetto.dev
+ * @response 500 - Tracing is compiled out (CONFIG_TRACE_ENABLE)
+ */
+esp_err_t api_get_trace(httpd_req_t* req) {
+#ifdef CONFIG_TRACE_ENABLE
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"trace.json\"");
+    chunk_stream_t st = {.req = req, .len = 0, .err = ESP_OK};
+    trace_export(chunk_stream_write, &st);
+    return chunk_stream_end(&st);
+#else
+    return send_json_error(req, TAG, WEBERR_INTERNAL_ERR, "Tracing is disabled");
+#endif
+}
+
+/**
+ * GET /api/v1/system/boot
+ * @summary Boot timing breakdown
+ * @tag System
+ * @response 200 - Milliseconds from application start to each stage, null if not reached
+ */
+esp_err_t api_get_boot(httpd_req_t* req) {
+    json_writer_t w;
+    json_response_begin(&w);
+    json_writer_object_begin(&w, NULL);
+    json_writer_object_begin(&w, "stages_ms");
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        const int64_t us = boot_timing_get_us((boot_stage)i);
+        if (us < 0) {
+            json_writer_null(&w, boot_timing_name((boot_stage)i));
+        } else {
+            json_writer_double(&w, boot_timing_name((boot_stage)i), (double)(us / 100) / 10.0);
+        }
+    }
+    json_writer_object_end(&w);
+    json_writer_object_end(&w);
+    return json_response_send(req, &w, TAG);
+}
+
+static ssize_t power_cookie_write(void* ctx, const char* data, size_t len) {
+    return chunk_stream_write(data, len, ctx) == ESP_OK ? (ssize_t)len : -1;
+}
+
+/**
+ * GET /api/v1/system/power
+ * @summary Frequency scaling configuration and time spent in each power mode
+ * @tag System
+ * @response 200 - Text report of esp_pm_dump_locks(); mode times need CONFIG_PM_PROFILING
+ * @response 500 - Out of memory
+ */
+esp_err_t api_get_power(httpd_req_t* req) {
+    httpd_resp_set_type(req, "text/plain");
+    chunk_stream_t st = {.req = req, .len = 0, .err = ESP_OK};
+    FILE* out = fopencookie(&st, "w", (cookie_io_functions_t){.write = power_cookie_write});
+    if (!out) {
+        return send_json_error(req, TAG, WEBERR_INTERNAL_ERR, "Out of memory");
+    }
+    power_report(out);
+    fclose(out);
+    return chunk_stream_end(&st);
+}
+
+/**
+ * GET /api/v1/system/tasks
+ * @summary Per-task CPU load and stack headroom
+ * @tag System
+ * @response 200 - Tasks with their load over the sampling window
+ * @response 500 - Run-time stats are disabled in this build
+ */
+esp_err_t api_get_tasks(httpd_req_t* req) {
+    // Too big for the HTTP server task's stack.
+    static task_monitor_report report;
+    esp_err_t err = task_monitor_read(&report);
+    if (err != ESP_OK) {
+        return send_json_error(req, TAG, WEBERR_INTERNAL_ERR, "Task monitor unavailable");
+    }
+
+    json_writer_t w;
+    json_response_begin(&w);
+    json_writer_object_begin(&w, NULL);
+    json_writer_uint(&w, "window_ms", report.window_ms);
+    json_writer_array_begin(&w, "tasks");
+    for (int i = 0; i < report.count; i++) {
+        const task_monitor_task* t = &report.tasks[i];
+        json_writer_object_begin(&w, NULL);
+        json_writer_string(&w, "name", t->name);
+        json_writer_int(&w, "core", t->core);
+        json_writer_uint(&w, "priority", t->priority);
+        json_writer_uint(&w, "base_priority", t->base_priority);
+        json_writer_uint(&w, "stack_free_min", t->stack_free_min);
+        json_writer_double(&w, "cpu_percent", (int)(t->cpu_percent * 10.0f + 0.5f) / 10.0);
+        json_writer_object_end(&w);
+    }
+    json_writer_array_end(&w);
+    json_writer_object_end(&w);
+    return json_response_send(req, &w, TAG);
+}
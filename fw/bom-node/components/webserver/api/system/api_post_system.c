@@ -5,20 +5,24 @@
 #include "freertos/task.h"
 
 #include "api_post_system.h"
+#include "error_handler.h"
 #include "handler.h"
+#include "ota.h"
 #include "slre.h"
 
 static const char* TAG = "POST_SYSTEM";
 
 // Definition of handlers
 static esp_err_t post_system_reboot(httpd_req_t* req);
+static esp_err_t post_system_ota_check(httpd_req_t* req);
 
 // Table of routes
-static const route_entry_t route_table[] = {{"^/api/v1/system/reboot/?$", post_system_reboot}};
+static const route_entry_t route_table[] = {{"/api/v1/system/reboot", post_system_reboot},
+                                            {"/api/v1/system/ota/check", post_system_ota_check}};
 
 // Main handler for POST system/* requests
 esp_err_t api_post_system(httpd_req_t* req) {
-    ESP_LOGI(TAG, "Received POST request: %s", req->uri);
+    ESP_LOGD(TAG, "Received POST request: %s", req->uri);
     return route_request(req, route_table, sizeof(route_table) / sizeof(route_entry_t));
 }
 
@@ -29,3 +33,21 @@ static esp_err_t post_system_reboot(httpd_req_t* req) {
     esp_restart();
     return ESP_OK;
 }
+
+/**
+ * POST /api/v1/system/ota/check
+ * @summary Check for a firmware update now
+ * @tag System
+ * @bodyDescription No body. The check runs on the update task; a new image is
+ * downloaded in the background and the device reboots into it.
+ * @response 200 - Check started
+ * @response 500 - OTA is disabled or not configured
+ */
+static esp_err_t post_system_ota_check(httpd_req_t* req) {
+    if (ota_check_for_update() != ESP_OK) {
+        return send_json_error(req, TAG, WEBERR_INTERNAL_ERR, "OTA is not running");
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, "{\"status\":\"checking\"}");
+    return ESP_OK;
+}
@@ -4,26 +4,29 @@
 #include "esp_log.h"
 
 #include "api_get_wifi.h"
-#include "cJSON.h"
 #include "handler.h"
 #include "slre.h"
 #include "wifi.h"
 #include "wifi_config.h"
 #include "wifi_api.h"
+#include "wifi_perf.h"
+#include "wifi_scan.h"
 
 static const char* TAG = "GET_WIFI";
 
 // Definition of handlers
 esp_err_t get_wifi_scan(httpd_req_t* req);
 esp_err_t get_wifi_status(httpd_req_t* req);
+esp_err_t get_wifi_perf(httpd_req_t* req);
 
 // Table of routes
-static const route_entry_t route_table[] = {{"^/api/v1/wifi/scan/?$", get_wifi_scan},
-                                            {"^/api/v1/wifi/status/?$", get_wifi_status}};
+static const route_entry_t route_table[] = {{"/api/v1/wifi/scan", get_wifi_scan},
+                                            {"/api/v1/wifi/status", get_wifi_status},
+                                            {"/api/v1/wifi/perf", get_wifi_perf}};
 
 // Main handler for GET wifi/* requests
 esp_err_t api_get_wifi(httpd_req_t* req) {
-    ESP_LOGI(TAG, "Received GET request: %s", req->uri);
+    ESP_LOGD(TAG, "Received GET request: %s", req->uri);
 
     return route_request(req, route_table, sizeof(route_table) / sizeof(route_entry_t));
 }
@@ -34,47 +37,57 @@ esp_err_t api_get_wifi(httpd_req_t* req) {
 
 /**
  * GET /api/v1/wifi/scan
- * @summary Scan for WiFi networks
+ * @summary List WiFi networks from the last scan
  * @tag Wi-Fi
- * @response 200 - List of available networks
+ * @response 200 - Cached networks, their age and whether a scan is running
  * @response 500 - Internal error
  * @responseContent {WifiSearch} 200.application/json
  * @responseExample {WifiSearch200} 200.application/json.200
  */
-/** 
- * @brief Handler for searching WiFi networks.
- * 
+/**
+ * @brief Handler for listing WiFi networks.
+ *
+ * Never waits for the radio: the results come from the background scan
+ * service. `?refresh=1` starts a scan, or joins the one running, and the
+ * client polls until `scanning` is false. Without cached results a scan is
+ * started as well.
+ *
  * @param req HTTP request
  * @return ESP_OK on success
  */
 esp_err_t get_wifi_scan(httpd_req_t* req) {
-    // Create JSON response
-    cJSON* root = cJSON_CreateObject();
-    cJSON* ssids = cJSON_CreateArray();
-    cJSON_AddItemToObject(root, "ssids", ssids);
+    bool refresh = false;
+    char query[32];
+    char value[8];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "refresh", value, sizeof(value)) == ESP_OK) {
+        refresh = strcmp(value, "0") != 0 && strcmp(value, "false") != 0;
+    }
 
-    wifi_scan_result_t ssid_result;
-    esp_err_t err = wifi_api_scan(&ssid_result);
-    if (err != ESP_OK) {
-        httpd_resp_send_500(req);
-        return ESP_FAIL;
+    static wifi_scan_result_t ssid_result; // httpd runs one handler at a time
+    int64_t age_ms;
+    bool scanning;
+    wifi_scan_get(&ssid_result, &age_ms, &scanning);
+    if ((refresh || age_ms < 0) && !scanning && wifi_scan_request() == ESP_OK) {
+        scanning = true;
     }
 
+    json_writer_t w;
+    json_response_begin(&w);
+    json_writer_object_begin(&w, NULL);
+    json_writer_array_begin(&w, "ssids");
     for (int i = 0; i < ssid_result.count; i++) {
-        wifi_ap_record_t record = ssid_result.records[i];
-        cJSON_AddItemToArray(ssids, cJSON_CreateString((const char*)record.ssid));
+        json_writer_string(&w, NULL, (const char*)ssid_result.records[i].ssid);
     }
-
-    // Convert JSON to string and send response
-    const char* resp_str = cJSON_PrintUnformatted(root);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, resp_str, strlen(resp_str));
-
-    // Clean up
-    cJSON_Delete(root);
-    free((void*)resp_str); // Important: cJSON_PrintUnformatted allocates memory
-
-    return ESP_OK;
+    json_writer_array_end(&w);
+    if (age_ms < 0) {
+        json_writer_null(&w, "ageMs");
+    } else {
+        json_writer_int(&w, "ageMs", age_ms);
+    }
+    json_writer_bool(&w, "scanning", scanning);
+    json_writer_object_end(&w);
+    return json_response_send(req, &w, TAG);
 }
 
 /**
@@ -85,28 +98,67 @@ esp_err_t get_wifi_scan(httpd_req_t* req) {
  * @response 500 - Internal error
  */
 esp_err_t get_wifi_status(httpd_req_t* req) {
-    cJSON* root = cJSON_CreateObject();
-    if (!root) {
-        return httpd_resp_send_500(req);
-    }
-
     wifi_credentials_t creds = get_wifi_credentials();
-    cJSON_AddBoolToObject(root, "connected", is_wifi_connected());
-    cJSON_AddBoolToObject(root, "configured", is_wifi_configured());
-    cJSON_AddBoolToObject(root, "apEnabled", is_ap_enabled());
-    cJSON_AddStringToObject(root, "ssid", creds.ssid);
-    cJSON_AddStringToObject(root, "apSsid", get_ap_ssid());
+    json_writer_t w;
+    json_response_begin(&w);
+    json_writer_object_begin(&w, NULL);
+    json_writer_bool(&w, "connected", is_wifi_connected());
+    json_writer_bool(&w, "configured", is_wifi_configured());
+    json_writer_bool(&w, "apEnabled", is_ap_enabled());
+    json_writer_string(&w, "ssid", creds.ssid);
+    json_writer_string(&w, "apSsid", get_ap_ssid());
+    json_writer_object_end(&w);
+    return json_response_send(req, &w, TAG);
+}
 
-    const char* resp_str = cJSON_PrintUnformatted(root);
-    if (!resp_str) {
-        cJSON_Delete(root);
-        return httpd_resp_send_500(req);
+static const char* ps_name(wifi_ps_type_t ps) {
+    switch (ps) {
+    case WIFI_PS_NONE:
+        return "none";
+    case WIFI_PS_MIN_MODEM:
+        return "min_modem";
+    case WIFI_PS_MAX_MODEM:
+        return "max_modem";
+    default:
+        return "unknown";
     }
+}
 
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, resp_str, strlen(resp_str));
-
-    cJSON_Delete(root);
-    free((void*)resp_str);
-    return ESP_OK;
+/**
+ * GET /api/v1/wifi/perf
+ * @summary Get the radio profile and link statistics
+ * @tag Wi-Fi
+ * @response 200 - Power save, TX power, bandwidth and link counters
+ * @response 500 - Internal error
+ */
+esp_err_t get_wifi_perf(httpd_req_t* req) {
+    wifi_perf_status_t perf;
+    wifi_perf_get_status(&perf);
+    wifi_link_stats_t link;
+    wifi_get_link_stats(&link);
+
+    json_writer_t w;
+    json_response_begin(&w);
+    json_writer_object_begin(&w, NULL);
+    json_writer_bool(&w, "streaming", perf.streaming);
+    json_writer_int(&w, "holders", perf.holders);
+    json_writer_string(&w, "powerSave", ps_name(perf.ps));
+    json_writer_int(&w, "txPowerDbm", perf.tx_power_dbm);
+    json_writer_double(&w, "txPowerActualDbm", perf.tx_power_actual_dbm);
+    json_writer_string(&w, "bandwidth", wifi_perf_bandwidth_name(perf.bandwidth));
+    json_writer_object_begin(&w, "link");
+    json_writer_bool(&w, "connected", link.connected);
+    if (link.connected) {
+        json_writer_int(&w, "rssi", link.rssi);
+        json_writer_uint(&w, "channel", link.channel);
+    } else {
+        json_writer_null(&w, "rssi");
+        json_writer_null(&w, "channel");
+    }
+    json_writer_uint(&w, "disconnects", link.disconnects);
+    json_writer_uint(&w, "reconnectAttempts", link.reconnect_attempts);
+    json_writer_uint(&w, "lastDisconnectReason", link.last_disconnect_reason);
+    json_writer_object_end(&w);
+    json_writer_object_end(&w);
+    return json_response_send(req, &w, TAG);
 }
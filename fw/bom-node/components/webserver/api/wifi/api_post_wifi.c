@@ -1,6 +1,5 @@
 #include <stdio.h>
 #include <string.h>
-#include "cJSON.h"
 #include "error_handler.h"
 #include "esp_err.h"
 #include "esp_log.h"
@@ -8,20 +7,27 @@
 #include "wifi.h"
 #include "wifi_config.h"
 #include "wifi_api.h"
+#include "wifi_perf.h"
 
 static const char* TAG = "POST_WIFI";
 
+// 802.11 limits: 32 byte SSIDs, 64 character passphrases.
+#define WIFI_SSID_BUF 33
+#define WIFI_PASSWORD_BUF 65
+
 // Prototypes for the handler functions
 esp_err_t post_wifi_connect(httpd_req_t* req);
 esp_err_t post_wifi_ap(httpd_req_t* req);
+esp_err_t post_wifi_perf(httpd_req_t* req);
 
 // Table of routes
-static const route_entry_t route_table[] = {{"^/api/v1/wifi/connect/?$", post_wifi_connect},
-                                            {"^/api/v1/wifi/ap/?$", post_wifi_ap}};
+static const route_entry_t route_table[] = {{"/api/v1/wifi/connect", post_wifi_connect},
+                                            {"/api/v1/wifi/ap", post_wifi_ap},
+                                            {"/api/v1/wifi/perf", post_wifi_perf}};
 
 // Main handler for POST wifi/* requests
 esp_err_t api_post_wifi(httpd_req_t* req) {
-    ESP_LOGI(TAG, "Received POST request: %s", req->uri);
+    ESP_LOGD(TAG, "Received POST request: %s", req->uri);
 
     return route_request(req, route_table, sizeof(route_table) / sizeof(route_table[0]));
 }
@@ -70,51 +76,37 @@ esp_err_t api_post_wifi(httpd_req_t* req) {
  * | 400  | **WIFI_MISSING_FIELDS** | Either *ssid* or *password* is absent. |
  * | 500  | **WIFI_CONNECT_FAIL**   | ESP32 failed to join the network.      |
  *
- * @note Uses a fixed 256‑byte stack buffer.  Increase if larger payloads
- *       are expected, or stream the body in chunks.
+ * @note The body is read with json_request_read(), up to
+ *       CONFIG_WEB_API_MAX_BODY_LEN bytes.
  */
-static esp_err_t read_json_body(httpd_req_t* req, char* buf, size_t buf_len) {
-    if (req->content_len <= 0 || req->content_len >= (int)buf_len) {
-        return ESP_ERR_INVALID_SIZE;
-    }
-
-    int len = httpd_req_recv(req, buf, buf_len - 1);
-    if (len <= 0) {
-        return ESP_FAIL;
-    }
-    buf[len] = '\0';
-    return ESP_OK;
-}
-
 esp_err_t post_wifi_connect(httpd_req_t* req) {
     ESP_LOGI(TAG, "Handling WiFi connect");
 
-    char buf[256];
-    if (read_json_body(req, buf, sizeof buf) != ESP_OK) {
-        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Failed to receive request body");
-    }
-
-    /* ---------- parse JSON ---------- */
-    cJSON* root = cJSON_Parse(buf);
-    if (!root) {
-        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Invalid JSON format");
+    json_doc_t doc;
+    esp_err_t err = json_request_read(req, &doc);
+    if (err != ESP_OK) {
+        return json_request_error(req, TAG, err);
     }
 
-    const cJSON* ssid = cJSON_GetObjectItem(root, "ssid");
-    const cJSON* password = cJSON_GetObjectItem(root, "password");
-    if (!cJSON_IsString(ssid) || !cJSON_IsString(password)) {
-        cJSON_Delete(root);
+    /* ---------- read fields ---------- */
+    char ssid[WIFI_SSID_BUF];
+    char password[WIFI_PASSWORD_BUF];
+    const int ssid_tok = json_reader_find(&doc, 0, "ssid");
+    const int password_tok = json_reader_find(&doc, 0, "password");
+    if (!json_reader_is(&doc, ssid_tok, JSON_TOKEN_STRING) ||
+        !json_reader_is(&doc, password_tok, JSON_TOKEN_STRING)) {
         return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Missing required fields");
     }
+    if (!json_reader_string(&doc, ssid_tok, ssid, sizeof(ssid)) ||
+        !json_reader_string(&doc, password_tok, password, sizeof(password))) {
+        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "SSID or password too long");
+    }
 
     /* ---------- Wi‑Fi connect ---------- */
-    if (wifi_api_connect_and_store(ssid->valuestring, password->valuestring) != ESP_OK) {
-        cJSON_Delete(root);
+    if (wifi_api_connect_and_store(ssid, password) != ESP_OK) {
         return send_json_error(req, TAG, WEBERR_INTERNAL_ERR, "Failed to connect to WiFi");
     }
 
-    cJSON_Delete(root);
-
     /* ---------- success ---------- */
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"status\":\"ok\"}");
@@ -134,31 +126,30 @@ esp_err_t post_wifi_connect(httpd_req_t* req) {
 esp_err_t post_wifi_ap(httpd_req_t* req) {
     ESP_LOGI(TAG, "Handling WiFi AP config");
 
-    char buf[256];
-    if (read_json_body(req, buf, sizeof buf) != ESP_OK) {
-        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Failed to receive request body");
+    json_doc_t doc;
+    esp_err_t err = json_request_read(req, &doc);
+    if (err != ESP_OK) {
+        return json_request_error(req, TAG, err);
     }
 
-    cJSON* root = cJSON_Parse(buf);
-    if (!root) {
-        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Invalid JSON format");
-    }
-
-    const cJSON* enabled = cJSON_GetObjectItem(root, "enabled");
-    const cJSON* ssid = cJSON_GetObjectItem(root, "ssid");
-    if (!cJSON_IsBool(enabled)) {
-        cJSON_Delete(root);
+    bool ap_enabled = false;
+    if (!json_reader_bool(&doc, json_reader_find(&doc, 0, "enabled"), &ap_enabled)) {
         return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Missing required fields");
     }
 
-    bool ap_enabled = cJSON_IsTrue(enabled);
+    char ssid[WIFI_SSID_BUF];
     const char* ap_ssid = NULL;
-    if (cJSON_IsString(ssid) && ssid->valuestring[0] != '\0') {
-        ap_ssid = ssid->valuestring;
+    const int ssid_tok = json_reader_find(&doc, 0, "ssid");
+    if (json_reader_is(&doc, ssid_tok, JSON_TOKEN_STRING)) {
+        if (!json_reader_string(&doc, ssid_tok, ssid, sizeof(ssid))) {
+            return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "SSID too long");
+        }
+        if (ssid[0] != '\0') {
+            ap_ssid = ssid;
+        }
     }
 
     if (ap_enabled && !ap_ssid) {
-        cJSON_Delete(root);
         return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "SSID required when enabling AP");
     }
 
@@ -167,11 +158,68 @@ esp_err_t post_wifi_ap(httpd_req_t* req) {
     }
 
     if (wifi_set_ap_config(ap_enabled, ap_ssid) != ESP_OK) {
-        cJSON_Delete(root);
         return send_json_error(req, TAG, WEBERR_INTERNAL_ERR, "Failed to update AP config");
     }
 
-    cJSON_Delete(root);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, "{\"status\":\"ok\"}");
+    return ESP_OK;
+}
+
+/**
+ * POST /api/v1/wifi/perf
+ * @summary Set TX power and station bandwidth
+ * @tag Wi-Fi
+ * @bodyDescription Both fields are optional. txPowerDbm is 2..20, or 0 for the PHY
+ *                  default; bandwidth is "ht20" or "ht40" and applies from the next
+ *                  association. Settings are stored in NVS.
+ * @bodyContent {WifiPerfConfig} application/json
+ * @bodyRequired
+ * @response 200 - Settings applied
+ * @response 400 - Invalid value
+ * @response 500 - Internal error
+ */
+esp_err_t post_wifi_perf(httpd_req_t* req) {
+    ESP_LOGI(TAG, "Handling WiFi perf config");
+
+    json_doc_t doc;
+    esp_err_t err = json_request_read(req, &doc);
+    if (err != ESP_OK) {
+        return json_request_error(req, TAG, err);
+    }
+
+    const int tx_power_tok = json_reader_find(&doc, 0, "txPowerDbm");
+    const int bandwidth_tok = json_reader_find(&doc, 0, "bandwidth");
+    const bool tx_power = tx_power_tok >= 0;
+    const bool bandwidth = bandwidth_tok >= 0;
+    if (!tx_power && !bandwidth) {
+        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "Missing required fields");
+    }
+
+    // Validate everything before applying anything.
+    int dbm = 0;
+    if (tx_power) {
+        if (!json_reader_int(&doc, tx_power_tok, &dbm)) {
+            return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "txPowerDbm must be a number");
+        }
+        if (dbm != 0 && (dbm < WIFI_PERF_TX_POWER_MIN_DBM || dbm > WIFI_PERF_TX_POWER_MAX_DBM)) {
+            return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "txPowerDbm out of range");
+        }
+    }
+    wifi_bandwidth_t bw = WIFI_BW_HT20;
+    char bw_name[8];
+    if (bandwidth && (!json_reader_string(&doc, bandwidth_tok, bw_name, sizeof(bw_name)) ||
+                      !wifi_perf_parse_bandwidth(bw_name, &bw))) {
+        return send_json_error(req, TAG, WEBERR_BAD_REQUEST, "bandwidth must be \"ht20\" or \"ht40\"");
+    }
+
+    if (tx_power && wifi_perf_set_tx_power(dbm) != ESP_OK) {
+        return send_json_error(req, TAG, WEBERR_INTERNAL_ERR, "Failed to set TX power");
+    }
+    if (bandwidth && wifi_perf_set_bandwidth(bw) != ESP_OK) {
+        return send_json_error(req, TAG, WEBERR_INTERNAL_ERR, "Failed to set bandwidth");
+    }
+
     httpd_resp_set_type(req, "application/json");
     httpd_resp_sendstr(req, "{\"status\":\"ok\"}");
     return ESP_OK;
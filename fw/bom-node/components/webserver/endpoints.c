@@ -1,6 +1,8 @@
 #include "endpoints.h"
 
+#include "esp_timer.h"
 #include "handler.h"
+#include "metrics.h"
 #include "handler_options.h"
 
 #include "api_get_audio.h"
@@ -8,29 +10,55 @@
 #include "api_get_system.h"
 #include "api_get_wifi.h"
 #include "api_post_audio.h"
+#include "api_post_config.h"
 #include "api_post_system.h"
 #include "api_post_wifi.h"
+#include "api_ws_audio.h"
+#include "api_ws_levels.h"
 #include "handler_get_static.h"
 
 // API Handlers GET
-const route_entry_t route_table_api_get[] = {{"^/api/v1/wifi(/.*)?/?$", api_get_wifi},
-                                             {"^/api/v1/audio(/.*)?/?$", api_get_audio},
-                                             {"^/api/v1/config(/.*)?/?$", api_get_config},
-                                             {"^/api/v1/ping/?$", api_get_system}};
+const route_entry_t route_table_api_get[] = {{"/api/v1/wifi", api_get_wifi, ROUTE_PREFIX},
+                                             {"/api/v1/audio", api_get_audio, ROUTE_PREFIX},
+                                             {"/api/v1/config", api_get_config, ROUTE_PREFIX},
+                                             {"/api/v1/ping", api_get_system},
+                                             {"/api/v1/system/boot", api_get_boot},
+                                             {"/api/v1/system/power", api_get_power},
+                                             {"/api/v1/system/tasks", api_get_tasks},
+                                             {"/api/v1/system/trace", api_get_trace},
+                                             {"/api/v1/metrics", api_get_metrics}};
+
+static metrics_counter s_api_get_requests = METRICS_COUNTER_LABELED_INIT(
+    "http_api_requests_total", "API requests handled", "method=\"get\"");
+static metrics_counter s_api_post_requests = METRICS_COUNTER_LABELED_INIT(
+    "http_api_requests_total", "API requests handled", "method=\"post\"");
+static metrics_histogram s_api_latency_us =
+    METRICS_HISTOGRAM_INIT("http_api_request_us", "API handler duration [us]", 1000, 2500,
+                           5000, 10000, 25000, 50000, 100000, 250000, 1000000);
+
+static esp_err_t route_timed(httpd_req_t* req, metrics_counter* requests,
+                             const route_entry_t* table, size_t count) {
+    const int64_t start = esp_timer_get_time();
+    const esp_err_t err = route_request(req, table, count);
+    metrics_counter_inc(requests);
+    metrics_histogram_observe(&s_api_latency_us, (uint32_t)(esp_timer_get_time() - start));
+    return err;
+}
 
 esp_err_t api_get_handler(httpd_req_t* req) {
-    return route_request(req, route_table_api_get,
-                         sizeof(route_table_api_get) / sizeof(route_entry_t));
+    return route_timed(req, &s_api_get_requests, route_table_api_get,
+                       sizeof(route_table_api_get) / sizeof(route_entry_t));
 }
 
 // API Handlers POST
-const route_entry_t route_table_api_post[] = {{"^/api/v1/wifi(/.*)?/?$", api_post_wifi},
-                                              {"^/api/v1/audio(/.*)?/?$", api_post_audio},
-                                              {"^/api/v1/system(/.*)?/?$", api_post_system}};
+const route_entry_t route_table_api_post[] = {{"/api/v1/wifi", api_post_wifi, ROUTE_PREFIX},
+                                              {"/api/v1/audio", api_post_audio, ROUTE_PREFIX},
+                                              {"/api/v1/config", api_post_config, ROUTE_PREFIX},
+                                              {"/api/v1/system", api_post_system, ROUTE_PREFIX}};
 
 esp_err_t api_post_handler(httpd_req_t* req) {
-    return route_request(req, route_table_api_post,
-                         sizeof(route_table_api_post) / sizeof(route_entry_t));
+    return route_timed(req, &s_api_post_requests, route_table_api_post,
+                       sizeof(route_table_api_post) / sizeof(route_entry_t));
 }
 
 // URI Handlers
@@ -43,6 +71,24 @@ static httpd_uri_t api_post_handler_uri = {
 httpd_uri_t options_uri = {
     .uri = "/*", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL};
 
+// Audio streams, served on the stream port only.
+static httpd_uri_t api_ws_audio_uri = {.uri = "/api/v1/audio/stream.ws",
+                                       .method = HTTP_GET,
+                                       .handler = api_ws_audio_stream,
+                                       .user_ctx = NULL,
+                                       .is_websocket = true};
+
+static httpd_uri_t api_ws_levels_uri = {.uri = "/api/v1/audio/levels.ws",
+                                        .method = HTTP_GET,
+                                        .handler = api_ws_levels_stream,
+                                        .user_ctx = NULL,
+                                        .is_websocket = true};
+
+static httpd_uri_t api_get_audio_stream_uri = {.uri = "/api/v1/audio/stream.wav",
+                                               .method = HTTP_GET,
+                                               .handler = api_get_audio_stream,
+                                               .user_ctx = NULL};
+
 // Static file handler
 static httpd_uri_t uri_get_static_tmp = {
     .uri = "/*", .method = HTTP_GET, .handler = get_static_handler, .user_ctx = NULL};
@@ -52,6 +98,10 @@ static httpd_uri_t uri_get_static = {
 
 // register all URI handlers function
 esp_err_t register_endpoints(httpd_handle_t server) {
+    metrics_register(&s_api_get_requests.base);
+    metrics_register(&s_api_post_requests.base);
+    metrics_register(&s_api_latency_us.base);
+
     // Register API handlers
     httpd_register_uri_handler(server, &api_get_handler_uri);
     httpd_register_uri_handler(server, &api_post_handler_uri);
@@ -65,3 +115,11 @@ esp_err_t register_endpoints(httpd_handle_t server) {
 
     return ESP_OK;
 }
+
+esp_err_t register_stream_endpoints(httpd_handle_t server) {
+    httpd_register_uri_handler(server, &api_ws_audio_uri);
+    httpd_register_uri_handler(server, &api_ws_levels_uri);
+    httpd_register_uri_handler(server, &api_get_audio_stream_uri);
+    httpd_register_uri_handler(server, &options_uri);
+    return ESP_OK;
+}
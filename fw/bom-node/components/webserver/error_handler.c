@@ -10,8 +10,8 @@
  * Author:          Martin Maxa <martin.maxa@resonect.cz>
  */
 #include <string.h>
-#include "cJSON.h"
 #include "error_handler.h"
+#include "json_writer.h"
 
 struct webserver_error webserver_error_create(const char* tag, enum webserver_errors code,
                                               const char* message) {
@@ -24,31 +24,14 @@ esp_err_t webserver_error_to_json(const struct webserver_error* err, char* buf,
         return ESP_ERR_INVALID_ARG;
     }
 
-    cJSON* root = cJSON_CreateObject();
-    if (!root) {
-        return ESP_FAIL;
-    }
-
-    cJSON_AddStringToObject(root, "tag", err->tag);
-    cJSON_AddNumberToObject(root, "code", (int)err->code);
-    cJSON_AddStringToObject(root, "message", err->message);
-
-    char* json_str = cJSON_PrintUnformatted(root);
-    esp_err_t result = ESP_FAIL;
-
-    if (json_str) {
-        size_t len = strlen(json_str);
-        if (len < buf_size) {
-            memcpy(buf, json_str, len + 1);
-            result = ESP_OK;
-        } else {
-            result = ESP_ERR_NO_MEM;
-        }
-        cJSON_free(json_str);
-    }
-
-    cJSON_Delete(root);
-    return result;
+    json_writer_t w;
+    json_writer_init(&w, buf, buf_size);
+    json_writer_object_begin(&w, NULL);
+    json_writer_string(&w, "tag", err->tag);
+    json_writer_int(&w, "code", (int)err->code);
+    json_writer_string(&w, "message", err->message);
+    json_writer_object_end(&w);
+    return json_writer_finish(&w, NULL) ? ESP_OK : ESP_ERR_NO_MEM;
 }
 
 esp_err_t send_json_error(httpd_req_t* req, const char* tag, enum webserver_errors code,
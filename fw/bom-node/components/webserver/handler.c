@@ -15,10 +15,34 @@
 #include "handler.h"
 #include "error_handler.h"
 #include "esp_log.h"
-#include "slre.h"
+#include "sdkconfig.h"
+#include <stdbool.h>
+#include <string.h>
 
 #define TAG "SERVER_HANDLER"
 
+/*
+ * @brief           Match a request path against a route
+ * @param[in]       route: Route table entry
+ * @param[in]       path: Request path, not NUL terminated
+ * @param[in]       len: Length of the path without query or trailing slash
+ * @return          true when the route takes the request
+ */
+static bool route_matches(const route_entry_t *route, const char *path,
+                          size_t len) {
+  const char *p = route->path;
+  size_t i = 0;
+  for (; i < len && p[i] != '\0'; i++) {
+    if (p[i] != path[i]) {
+      return false;
+    }
+  }
+  if (p[i] != '\0') {
+    return false;
+  }
+  return i == len || (route->match == ROUTE_PREFIX && path[i] == '/');
+}
+
 /*
  * @brief           Route request to appropriate handler
  * @param[in]       req: Pointer to the HTTP request
@@ -28,16 +52,105 @@
  */
 esp_err_t route_request(httpd_req_t *req, const route_entry_t *route_table,
                         size_t route_table_size) {
-  struct slre_cap caps[1]; // Buffer for regex capture groups
+  const char *uri = req->uri;
+  size_t len = strcspn(uri, "?");
+  if (len > 1 && uri[len - 1] == '/') {
+    len--;
+  }
 
+  // Each candidate is rejected at its first differing character, so a
+  // lookup costs about one pass over the path per table level.
   for (size_t i = 0; i < route_table_size; i++) {
-    if (slre_match(route_table[i].path, req->uri, strlen(req->uri), caps, 1,
-                   0) > 0) {
-      ESP_LOGI(TAG, "Routing to handler: %s", route_table[i].path);
+    if (route_matches(&route_table[i], uri, len)) {
+      ESP_LOGD(TAG, "Routing to handler: %s", route_table[i].path);
       return route_table[i].handler(req);
     }
   }
 
   send_json_error(req, TAG, WEBERR_NOT_FOUND, "Endpoint not found");
   return ESP_FAIL;
-}
\ No newline at end of file
+}
+
+static char s_json_response[JSON_RESPONSE_MAX];
+
+/*
+ * @brief           Start a JSON response in the shared buffer
+ * @param[out]      w: Writer to initialise
+ */
+void json_response_begin(json_writer_t *w) {
+  json_writer_init(w, s_json_response, sizeof(s_json_response));
+}
+
+/*
+ * @brief           Send a finished JSON response in one write
+ * @param[in]       req: Pointer to the HTTP request
+ * @param[in]       w: Writer from json_response_begin()
+ * @param[in]       tag: Module reported if the document did not fit
+ * @return          ESP_OK on success, ESP_FAIL on failure
+ */
+esp_err_t json_response_send(httpd_req_t *req, json_writer_t *w,
+                             const char *tag) {
+  size_t len = 0;
+  const char *doc = json_writer_finish(w, &len);
+  if (!doc) {
+    ESP_LOGE(TAG, "JSON response overflowed %d B", JSON_RESPONSE_MAX);
+    return send_json_error(req, tag, WEBERR_INTERNAL_ERR,
+                           "Response too large");
+  }
+  httpd_resp_set_type(req, "application/json");
+  return httpd_resp_send(req, doc, (ssize_t)len);
+}
+
+static char s_json_request[CONFIG_WEB_API_MAX_BODY_LEN];
+static json_token_t s_json_tokens[JSON_REQUEST_MAX_TOKENS];
+
+/*
+ * @brief           Receive and tokenize a JSON request body
+ * @param[in]       req: Pointer to the HTTP request
+ * @param[out]      doc: Tokens of the body
+ * @return          ESP_OK on success, see handler.h for the errors
+ */
+esp_err_t json_request_read(httpd_req_t *req, json_doc_t *doc) {
+  const size_t len = req->content_len;
+  if (len == 0 || len > sizeof(s_json_request)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  size_t got = 0;
+  while (got < len) {
+    const int n = httpd_req_recv(req, &s_json_request[got], len - got);
+    if (n == HTTPD_SOCK_ERR_TIMEOUT) {
+      continue;
+    }
+    if (n <= 0) {
+      return ESP_FAIL;
+    }
+    got += (size_t)n;
+  }
+  const json_reader_err_t err = json_reader_parse(
+      doc, s_json_request, len, s_json_tokens, JSON_REQUEST_MAX_TOKENS);
+  if (err != JSON_READER_OK) {
+    ESP_LOGD(TAG, "Request body rejected by the JSON reader (%d)", err);
+    return ESP_ERR_INVALID_ARG;
+  }
+  return ESP_OK;
+}
+
+/*
+ * @brief           Answer a request whose body could not be read
+ * @param[in]       req: Pointer to the HTTP request
+ * @param[in]       tag: Module reported in the error
+ * @param[in]       err: Error from json_request_read()
+ * @return          Result of sending the response
+ */
+esp_err_t json_request_error(httpd_req_t *req, const char *tag,
+                             esp_err_t err) {
+  if (err == ESP_ERR_INVALID_ARG) {
+    return send_json_error(req, tag, WEBERR_BAD_REQUEST, "Invalid JSON format");
+  }
+  if (err == ESP_ERR_INVALID_SIZE && req->content_len > 0) {
+    return send_json_error(req, tag, WEBERR_BAD_REQUEST,
+                           "Request body too large");
+  }
+  return send_json_error(req, tag, WEBERR_BAD_REQUEST,
+                         "Failed to receive request body");
+}
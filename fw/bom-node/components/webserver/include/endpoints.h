@@ -5,4 +5,7 @@
 
 esp_err_t register_endpoints(httpd_handle_t server);
 
+// Audio stream endpoints, on the server bound to CONFIG_WEB_STREAM_PORT.
+esp_err_t register_stream_endpoints(httpd_handle_t server);
+
 #endif // ENDPOINTS_H
@@ -19,17 +19,48 @@ extern "C" {
 #endif /* __cplusplus */
 
 #include "esp_http_server.h"
+#include "json_reader.h"
+#include "json_writer.h"
 
-// Structure for routing table
+// Largest JSON document a GET handler can answer with.
+#define JSON_RESPONSE_MAX 4096
+
+// Tokens a POST body may have: every value, key and container is one.
+#define JSON_REQUEST_MAX_TOKENS 128
+
+// How a route path is compared with the request path (up to any query
+// string). Either way one trailing slash on the request is ignored.
+typedef enum {
+    ROUTE_EXACT = 0, // the whole path
+    ROUTE_PREFIX,    // the path or anything below it, for sub-routers
+} route_match_t;
+
+// Structure for routing table. Paths are literals, not patterns.
 typedef struct {
     const char* path;
     esp_err_t (*handler)(httpd_req_t* req);
+    route_match_t match;
 } route_entry_t;
 
 // Function prototypes, name aligned, lowercase names
 esp_err_t route_request(httpd_req_t* req, const route_entry_t* route_table,
                         size_t route_table_size);
 
+// JSON responses are written into one static buffer of JSON_RESPONSE_MAX
+// bytes, so they cost no heap. Handlers run on the HTTP server task only;
+// code on other tasks must bring its own buffer.
+void json_response_begin(json_writer_t* w);
+esp_err_t json_response_send(httpd_req_t* req, json_writer_t* w, const char* tag);
+
+// POST bodies are read, in as many receives as they take, into one static
+// buffer of CONFIG_WEB_API_MAX_BODY_LEN bytes and tokenized in place; `doc`
+// points into it until the next request. HTTP server task only, as above.
+// ESP_ERR_INVALID_SIZE: no body or a longer one, ESP_FAIL: the receive
+// failed, ESP_ERR_INVALID_ARG: not JSON or more than JSON_REQUEST_MAX_TOKENS.
+esp_err_t json_request_read(httpd_req_t* req, json_doc_t* doc);
+// Sends the 400 matching a json_request_read() error.
+esp_err_t json_request_error(httpd_req_t* req, const char* tag, esp_err_t err);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,110 @@
+/**
+ * \file            json_reader.h
+ * \brief           Non-allocating JSON tokenizer
+ * \details         Splits a JSON document into tokens in a caller-provided array,
+ *                  without building a tree or allocating, in the manner of jsmn. Each
+ *                  token records where its value lies in the source text; values are
+ *                  converted only when a handler asks for them, straight into its own
+ *                  variables. The source must stay alive as long as the tokens are used.
+ */
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define JSON_READER_MAX_DEPTH 16
+
+typedef enum {
+    JSON_TOKEN_OBJECT = 1,
+    JSON_TOKEN_ARRAY,
+    JSON_TOKEN_STRING, // start/end exclude the quotes, escapes are left in
+    JSON_TOKEN_NUMBER,
+    JSON_TOKEN_BOOL,
+    JSON_TOKEN_NULL,
+} json_token_type_t;
+
+/*
+ * Tokens are stored in document order. An object is followed by its members,
+ * each a string key token and then the value's tokens; an array by its
+ * elements.
+ */
+typedef struct {
+    json_token_type_t type;
+    uint16_t start; // offset of the first character
+    uint16_t end;   // offset one past the last character
+    uint16_t size;  // members of an object, elements of an array, else 0
+} json_token_t;
+
+typedef struct {
+    const char* js;
+    const json_token_t* tokens;
+    int count;
+} json_doc_t;
+
+typedef enum {
+    JSON_READER_OK = 0,
+    JSON_READER_ERR_SYNTAX,    // not a single well-formed JSON value
+    JSON_READER_ERR_TOKENS,    // more tokens than the array holds
+    JSON_READER_ERR_DEPTH,     // nested deeper than JSON_READER_MAX_DEPTH
+    JSON_READER_ERR_TOO_LARGE, // longer than the 16 bit token offsets reach
+} json_reader_err_t;
+
+/*
+ * \brief           Tokenize a document
+ * \param[out]      doc: Document, valid only when JSON_READER_OK is returned
+ * \param[in]       js: Source text, need not be NUL terminated
+ * \param[in]       len: Length of the source text
+ * \param[out]      tokens: Token storage
+ * \param[in]       max_tokens: Number of tokens `tokens` holds
+ */
+json_reader_err_t json_reader_parse(json_doc_t* doc, const char* js, size_t len,
+                                    json_token_t* tokens, int max_tokens);
+
+/*
+ * Tokens are addressed by index; the root value is token 0. Lookups take
+ * out-of-range indexes, including the -1 they return themselves, and then
+ * fail, so calls can be chained without checking every step.
+ */
+
+/*
+ * \brief           Index of the token after `index` and everything nested in it
+ */
+int json_reader_next(const json_doc_t* doc, int index);
+
+/*
+ * \brief           Value of member `key` of object `object`
+ * \return          Token index, or -1 if `object` is not an object or has no
+ *                  such member. Keys are compared as written, so a key spelled
+ *                  with escapes does not match.
+ */
+int json_reader_find(const json_doc_t* doc, int object, const char* key);
+
+/*
+ * Typed conversions. Each returns false, leaving `out` alone, when the token
+ * is of another type or its value does not fit.
+ */
+
+// Unescapes into `out`, NUL terminated; \u escapes become UTF-8. A string
+// longer than cap - 1 bytes, or containing \u0000, does not fit.
+bool json_reader_string(const json_doc_t* doc, int index, char* out, size_t cap);
+bool json_reader_double(const json_doc_t* doc, int index, double* out);
+// Integral numbers within the range of int only; 2.0 fits, 2.5 does not.
+bool json_reader_int(const json_doc_t* doc, int index, int* out);
+bool json_reader_bool(const json_doc_t* doc, int index, bool* out);
+
+static inline bool json_reader_is(const json_doc_t* doc, int index,
+                                  json_token_type_t type) {
+    return index >= 0 && index < doc->count && doc->tokens[index].type == type;
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* JSON_READER_H */
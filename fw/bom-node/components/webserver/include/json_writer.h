@@ -0,0 +1,68 @@
+/**
+ * \file            json_writer.h
+ * \brief           Streaming JSON writer
+ * \details         Writes compact JSON straight into a caller-provided buffer, without
+ *                  building a tree or allocating. Commas and nesting are tracked by the
+ *                  writer; a value that does not fit marks the writer as overflowed and
+ *                  everything after it is ignored.
+ */
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define JSON_WRITER_MAX_DEPTH 16
+
+typedef struct {
+    char* buf;
+    size_t cap;
+    size_t len;
+    bool overflow;
+    int depth;
+    uint32_t has_items; // bit d: the container at depth d already has a member
+} json_writer_t;
+
+/*
+ * \brief           Start a document in `buf`
+ * \param[in]       w: Writer
+ * \param[out]      buf: Output buffer
+ * \param[in]       cap: Size of the buffer, including the terminating NUL
+ */
+void json_writer_init(json_writer_t* w, char* buf, size_t cap);
+
+/*
+ * Every value takes the member name it is written under; pass NULL for the
+ * root value and for array elements.
+ */
+void json_writer_object_begin(json_writer_t* w, const char* key);
+void json_writer_object_end(json_writer_t* w);
+void json_writer_array_begin(json_writer_t* w, const char* key);
+void json_writer_array_end(json_writer_t* w);
+
+void json_writer_string(json_writer_t* w, const char* key, const char* value);
+void json_writer_int(json_writer_t* w, const char* key, int64_t value);
+void json_writer_uint(json_writer_t* w, const char* key, uint64_t value);
+void json_writer_double(json_writer_t* w, const char* key, double value);
+void json_writer_bool(json_writer_t* w, const char* key, bool value);
+void json_writer_null(json_writer_t* w, const char* key);
+
+/*
+ * \brief           Finish the document
+ * \param[in]       w: Writer
+ * \param[out]      len: Length of the document, without the NUL
+ * \return          The NUL terminated document, or NULL if it overflowed the
+ *                  buffer or containers were left open
+ */
+const char* json_writer_finish(json_writer_t* w, size_t* len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* JSON_WRITER_H */
@@ -0,0 +1,37 @@
+#ifndef STATIC_CACHE_H
+#define STATIC_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Validators and an optional RAM cache for the files under /storage.
+//
+// ETags come from the "etags" manifest the web build writes next to the
+// files (one "<hash> <path>" line per served path), read once on first use.
+// Nothing here locks: the static handler only runs on the HTTP server task.
+
+// Quoted ETag of the file served at `path` (e.g. "/index.html"), or NULL if
+// the manifest does not list it.
+const char* static_cache_etag(const char* path);
+
+// True for names the web build gave a content hash (name.<hex>.ext), which
+// never change content and can be cached by the browser indefinitely.
+bool static_cache_is_hashed(const char* path);
+
+// Cached body of `path`, valid until the next static_cache_put(). Always
+// false when the cache is disabled (CONFIG_WEB_STATIC_CACHE_KB).
+bool static_cache_get(const char* path, const uint8_t** data, size_t* len, bool* gzip);
+
+// Largest body static_cache_put() takes; 0 when the cache is disabled.
+size_t static_cache_max_file(void);
+
+// Buffer for a body that is about to be put, from PSRAM. NULL when the
+// cache is disabled or out of memory.
+uint8_t* static_cache_alloc(size_t len);
+
+// Adds a body from static_cache_alloc(), evicting the least recently used
+// files to make room. The cache owns `data` afterwards either way.
+void static_cache_put(const char* path, uint8_t* data, size_t len, bool gzip);
+
+#endif // STATIC_CACHE_H
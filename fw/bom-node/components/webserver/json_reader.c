@@ -0,0 +1,435 @@
+/**
+ * \file            json_reader.c
+ * \brief           Non-allocating JSON tokenizer
+ */
+#include "json_reader.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char* js;
+    size_t len;
+    size_t pos;
+    json_token_t* tokens;
+    int max_tokens;
+    int count;
+    json_reader_err_t err;
+} parser_t;
+
+static bool fail(parser_t* p, json_reader_err_t err) {
+    if (p->err == JSON_READER_OK) {
+        p->err = err;
+    }
+    return false;
+}
+
+static void skip_ws(parser_t* p) {
+    while (p->pos < p->len) {
+        const char c = p->js[p->pos];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+            break;
+        }
+        p->pos++;
+    }
+}
+
+static int alloc_token(parser_t* p, json_token_type_t type, size_t start) {
+    if (p->count >= p->max_tokens) {
+        fail(p, JSON_READER_ERR_TOKENS);
+        return -1;
+    }
+    json_token_t* t = &p->tokens[p->count];
+    t->type = type;
+    t->start = (uint16_t)start;
+    t->end = (uint16_t)start;
+    t->size = 0;
+    return p->count++;
+}
+
+static bool is_hex(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// At the opening quote.
+static bool parse_string(parser_t* p) {
+    const int index = alloc_token(p, JSON_TOKEN_STRING, ++p->pos);
+    if (index < 0) {
+        return false;
+    }
+    while (p->pos < p->len) {
+        const unsigned char c = (unsigned char)p->js[p->pos];
+        if (c == '"') {
+            p->tokens[index].end = (uint16_t)p->pos++;
+            return true;
+        }
+        if (c < 0x20) {
+            return fail(p, JSON_READER_ERR_SYNTAX);
+        }
+        if (c == '\\') {
+            if (++p->pos >= p->len) {
+                break;
+            }
+            switch (p->js[p->pos]) {
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+                break;
+            case 'u':
+                for (int i = 1; i <= 4; i++) {
+                    if (p->pos + i >= p->len || !is_hex(p->js[p->pos + i])) {
+                        return fail(p, JSON_READER_ERR_SYNTAX);
+                    }
+                }
+                p->pos += 4;
+                break;
+            default:
+                return fail(p, JSON_READER_ERR_SYNTAX);
+            }
+        }
+        p->pos++;
+    }
+    return fail(p, JSON_READER_ERR_SYNTAX);
+}
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool parse_number(parser_t* p) {
+    const size_t start = p->pos;
+    const char* js = p->js;
+    size_t i = p->pos;
+    if (i < p->len && js[i] == '-') {
+        i++;
+    }
+    if (i < p->len && js[i] == '0') {
+        i++;
+    } else if (i < p->len && is_digit(js[i])) {
+        while (i < p->len && is_digit(js[i])) {
+            i++;
+        }
+    } else {
+        return fail(p, JSON_READER_ERR_SYNTAX);
+    }
+    if (i < p->len && js[i] == '.') {
+        if (++i >= p->len || !is_digit(js[i])) {
+            return fail(p, JSON_READER_ERR_SYNTAX);
+        }
+        while (i < p->len && is_digit(js[i])) {
+            i++;
+        }
+    }
+    if (i < p->len && (js[i] == 'e' || js[i] == 'E')) {
+        i++;
+        if (i < p->len && (js[i] == '+' || js[i] == '-')) {
+            i++;
+        }
+        if (i >= p->len || !is_digit(js[i])) {
+            return fail(p, JSON_READER_ERR_SYNTAX);
+        }
+        while (i < p->len && is_digit(js[i])) {
+            i++;
+        }
+    }
+    const int index = alloc_token(p, JSON_TOKEN_NUMBER, start);
+    if (index < 0) {
+        return false;
+    }
+    p->tokens[index].end = (uint16_t)i;
+    p->pos = i;
+    return true;
+}
+
+static bool parse_literal(parser_t* p, const char* word, json_token_type_t type) {
+    const size_t n = strlen(word);
+    if (p->len - p->pos < n || memcmp(&p->js[p->pos], word, n) != 0) {
+        return fail(p, JSON_READER_ERR_SYNTAX);
+    }
+    const int index = alloc_token(p, type, p->pos);
+    if (index < 0) {
+        return false;
+    }
+    p->pos += n;
+    p->tokens[index].end = (uint16_t)p->pos;
+    return true;
+}
+
+static bool parse_value(parser_t* p, int depth);
+
+// At the opening bracket or brace.
+static bool parse_container(parser_t* p, int depth, bool object) {
+    if (depth >= JSON_READER_MAX_DEPTH) {
+        return fail(p, JSON_READER_ERR_DEPTH);
+    }
+    const char close = object ? '}' : ']';
+    const int index = alloc_token(p, object ? JSON_TOKEN_OBJECT : JSON_TOKEN_ARRAY, p->pos);
+    if (index < 0) {
+        return false;
+    }
+    p->pos++;
+    skip_ws(p);
+    uint16_t size = 0;
+    if (p->pos < p->len && p->js[p->pos] == close) {
+        p->pos++;
+        p->tokens[index].end = (uint16_t)p->pos;
+        return true;
+    }
+    for (;;) {
+        if (object) {
+            if (p->pos >= p->len || p->js[p->pos] != '"' || !parse_string(p)) {
+                return fail(p, JSON_READER_ERR_SYNTAX);
+            }
+            skip_ws(p);
+            if (p->pos >= p->len || p->js[p->pos] != ':') {
+                return fail(p, JSON_READER_ERR_SYNTAX);
+            }
+            p->pos++;
+        }
+        if (!parse_value(p, depth + 1)) {
+            return false;
+        }
+        size++;
+        skip_ws(p);
+        if (p->pos >= p->len) {
+            return fail(p, JSON_READER_ERR_SYNTAX);
+        }
+        const char c = p->js[p->pos++];
+        if (c == close) {
+            break;
+        }
+        if (c != ',') {
+            return fail(p, JSON_READER_ERR_SYNTAX);
+        }
+        skip_ws(p);
+    }
+    p->tokens[index].end = (uint16_t)p->pos;
+    p->tokens[index].size = size;
+    return true;
+}
+
+static bool parse_value(parser_t* p, int depth) {
+    skip_ws(p);
+    if (p->pos >= p->len) {
+        return fail(p, JSON_READER_ERR_SYNTAX);
+    }
+    switch (p->js[p->pos]) {
+    case '{':
+        return parse_container(p, depth, true);
+    case '[':
+        return parse_container(p, depth, false);
+    case '"':
+        return parse_string(p);
+    case 't':
+        return parse_literal(p, "true", JSON_TOKEN_BOOL);
+    case 'f':
+        return parse_literal(p, "false", JSON_TOKEN_BOOL);
+    case 'n':
+        return parse_literal(p, "null", JSON_TOKEN_NULL);
+    default:
+        return parse_number(p);
+    }
+}
+
+json_reader_err_t json_reader_parse(json_doc_t* doc, const char* js, size_t len,
+                                    json_token_t* tokens, int max_tokens) {
+    if (len > UINT16_MAX) {
+        return JSON_READER_ERR_TOO_LARGE;
+    }
+    parser_t p = {
+        .js = js,
+        .len = len,
+        .tokens = tokens,
+        .max_tokens = max_tokens,
+    };
+    if (parse_value(&p, 0)) {
+        skip_ws(&p);
+        if (p.pos != p.len) {
+            fail(&p, JSON_READER_ERR_SYNTAX);
+        }
+    }
+    if (p.err != JSON_READER_OK) {
+        return p.err;
+    }
+    doc->js = js;
+    doc->tokens = tokens;
+    doc->count = p.count;
+    return JSON_READER_OK;
+}
+
+int json_reader_next(const json_doc_t* doc, int index) {
+    if (index < 0 || index >= doc->count) {
+        return -1;
+    }
+    const uint16_t end = doc->tokens[index].end;
+    int next = index + 1;
+    while (next < doc->count && doc->tokens[next].start < end) {
+        next++;
+    }
+    return next;
+}
+
+int json_reader_find(const json_doc_t* doc, int object, const char* key) {
+    if (!json_reader_is(doc, object, JSON_TOKEN_OBJECT)) {
+        return -1;
+    }
+    const size_t key_len = strlen(key);
+    int member = object + 1;
+    for (uint16_t i = 0; i < doc->tokens[object].size; i++) {
+        const json_token_t* k = &doc->tokens[member];
+        if ((size_t)(k->end - k->start) == key_len &&
+            memcmp(&doc->js[k->start], key, key_len) == 0) {
+            return member + 1;
+        }
+        member = json_reader_next(doc, member + 1);
+    }
+    return -1;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    return (c | 0x20) - 'a' + 10;
+}
+
+static uint32_t read_u16_escape(const char* s) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        v = (v << 4) | (uint32_t)hex_value(s[i]);
+    }
+    return v;
+}
+
+bool json_reader_string(const json_doc_t* doc, int index, char* out, size_t cap) {
+    if (!json_reader_is(doc, index, JSON_TOKEN_STRING) || cap == 0) {
+        return false;
+    }
+    const json_token_t* t = &doc->tokens[index];
+    const char* s = &doc->js[t->start];
+    const char* end = &doc->js[t->end];
+    size_t n = 0;
+    while (s < end) {
+        char utf8[4];
+        size_t len = 1;
+        if (*s != '\\') {
+            utf8[0] = *s++;
+        } else {
+            const char e = s[1];
+            s += 2;
+            // The tokenizer has already checked every escape.
+            switch (e) {
+            case 'b':
+                utf8[0] = '\b';
+                break;
+            case 'f':
+                utf8[0] = '\f';
+                break;
+            case 'n':
+                utf8[0] = '\n';
+                break;
+            case 'r':
+                utf8[0] = '\r';
+                break;
+            case 't':
+                utf8[0] = '\t';
+                break;
+            case 'u': {
+                uint32_t cp = read_u16_escape(s);
+                s += 4;
+                if (cp >= 0xd800 && cp < 0xdc00 && end - s >= 6 && s[0] == '\\' &&
+                    s[1] == 'u') {
+                    const uint32_t lo = read_u16_escape(s + 2);
+                    if (lo >= 0xdc00 && lo < 0xe000) {
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                        s += 6;
+                    }
+                }
+                if (cp == 0) {
+                    return false;
+                }
+                if (cp >= 0xd800 && cp < 0xe000) {
+                    cp = 0xfffd; // unpaired surrogate
+                }
+                if (cp < 0x80) {
+                    utf8[0] = (char)cp;
+                } else if (cp < 0x800) {
+                    utf8[0] = (char)(0xc0 | (cp >> 6));
+                    utf8[1] = (char)(0x80 | (cp & 0x3f));
+                    len = 2;
+                } else if (cp < 0x10000) {
+                    utf8[0] = (char)(0xe0 | (cp >> 12));
+                    utf8[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+                    utf8[2] = (char)(0x80 | (cp & 0x3f));
+                    len = 3;
+                } else {
+                    utf8[0] = (char)(0xf0 | (cp >> 18));
+                    utf8[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+                    utf8[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+                    utf8[3] = (char)(0x80 | (cp & 0x3f));
+                    len = 4;
+                }
+                break;
+            }
+            default: // '"', '\\' and '/' stand for themselves
+                utf8[0] = e;
+                break;
+            }
+        }
+        if (len >= cap - n) {
+            return false;
+        }
+        memcpy(&out[n], utf8, len);
+        n += len;
+    }
+    out[n] = '\0';
+    return true;
+}
+
+bool json_reader_double(const json_doc_t* doc, int index, double* out) {
+    if (!json_reader_is(doc, index, JSON_TOKEN_NUMBER)) {
+        return false;
+    }
+    // strtod() needs a terminated copy; longer numbers carry no more precision
+    // than a double holds, but they are rare enough to just refuse.
+    const json_token_t* t = &doc->tokens[index];
+    char num[32];
+    const size_t len = (size_t)(t->end - t->start);
+    if (len >= sizeof(num)) {
+        return false;
+    }
+    memcpy(num, &doc->js[t->start], len);
+    num[len] = '\0';
+    const double v = strtod(num, NULL);
+    if (!isfinite(v)) {
+        return false;
+    }
+    *out = v;
+    return true;
+}
+
+bool json_reader_int(const json_doc_t* doc, int index, int* out) {
+    double v = 0.0;
+    if (!json_reader_double(doc, index, &v) || v != floor(v) || v < (double)INT_MIN ||
+        v > (double)INT_MAX) {
+        return false;
+    }
+    *out = (int)v;
+    return true;
+}
+
+bool json_reader_bool(const json_doc_t* doc, int index, bool* out) {
+    if (!json_reader_is(doc, index, JSON_TOKEN_BOOL)) {
+        return false;
+    }
+    *out = doc->js[doc->tokens[index].start] == 't';
+    return true;
+}
@@ -0,0 +1,202 @@
+/**
+ * \file            json_writer.c
+ * \brief           Streaming JSON writer
+ */
+#include "json_writer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void put(json_writer_t* w, const char* s, size_t n) {
+    if (w->overflow) {
+        return;
+    }
+    if (n >= w->cap - w->len) { // keep room for the NUL
+        w->overflow = true;
+        return;
+    }
+    memcpy(&w->buf[w->len], s, n);
+    w->len += n;
+}
+
+static inline void put_char(json_writer_t* w, char c) {
+    put(w, &c, 1);
+}
+
+static void put_string(json_writer_t* w, const char* s) {
+    static const char hex[] = "0123456789abcdef";
+    put_char(w, '"');
+    const char* run = s;
+    for (; *s; s++) {
+        const unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        put(w, run, (size_t)(s - run));
+        run = s + 1;
+        switch (c) {
+        case '"':
+            put(w, "\\\"", 2);
+            break;
+        case '\\':
+            put(w, "\\\\", 2);
+            break;
+        case '\n':
+            put(w, "\\n", 2);
+            break;
+        case '\r':
+            put(w, "\\r", 2);
+            break;
+        case '\t':
+            put(w, "\\t", 2);
+            break;
+        default: {
+            const char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+            put(w, esc, sizeof(esc));
+            break;
+        }
+        }
+    }
+    put(w, run, (size_t)(s - run));
+    put_char(w, '"');
+}
+
+// Separator and member name ahead of a value.
+static void begin_value(json_writer_t* w, const char* key) {
+    if (w->depth > 0) {
+        const uint32_t bit = 1u << (w->depth - 1);
+        if (w->has_items & bit) {
+            put_char(w, ',');
+        }
+        w->has_items |= bit;
+    }
+    if (key) {
+        put_string(w, key);
+        put_char(w, ':');
+    }
+}
+
+static void open_container(json_writer_t* w, const char* key, char c) {
+    begin_value(w, key);
+    if (w->depth >= JSON_WRITER_MAX_DEPTH) {
+        w->overflow = true;
+        return;
+    }
+    put_char(w, c);
+    w->depth++;
+    w->has_items &= ~(1u << (w->depth - 1));
+}
+
+static void close_container(json_writer_t* w, char c) {
+    if (w->depth == 0) {
+        w->overflow = true;
+        return;
+    }
+    put_char(w, c);
+    w->depth--;
+}
+
+void json_writer_init(json_writer_t* w, char* buf, size_t cap) {
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->cap = cap;
+    w->overflow = buf == NULL || cap == 0;
+}
+
+void json_writer_object_begin(json_writer_t* w, const char* key) {
+    open_container(w, key, '{');
+}
+
+void json_writer_object_end(json_writer_t* w) {
+    close_container(w, '}');
+}
+
+void json_writer_array_begin(json_writer_t* w, const char* key) {
+    open_container(w, key, '[');
+}
+
+void json_writer_array_end(json_writer_t* w) {
+    close_container(w, ']');
+}
+
+void json_writer_string(json_writer_t* w, const char* key, const char* value) {
+    begin_value(w, key);
+    put_string(w, value ? value : "");
+}
+
+void json_writer_uint(json_writer_t* w, const char* key, uint64_t value) {
+    char digits[20];
+    size_t n = 0;
+    do {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    begin_value(w, key);
+    put(w, &digits[sizeof(digits) - n], n);
+}
+
+void json_writer_int(json_writer_t* w, const char* key, int64_t value) {
+    if (value >= 0) {
+        json_writer_uint(w, key, (uint64_t)value);
+        return;
+    }
+    char digits[20];
+    size_t n = 0;
+    uint64_t mag = (uint64_t)0 - (uint64_t)value;
+    do {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + mag % 10);
+        mag /= 10;
+    } while (mag);
+    begin_value(w, key);
+    put_char(w, '-');
+    put(w, &digits[sizeof(digits) - n], n);
+}
+
+void json_writer_double(json_writer_t* w, const char* key, double value) {
+    // As cJSON prints numbers: whole values without a fraction, no NaN or
+    // infinities in JSON.
+    if (!isfinite(value)) {
+        json_writer_null(w, key);
+        return;
+    }
+    // In range first: the cast is undefined beyond int64_t.
+    if (fabs(value) < 9007199254740992.0 && value == (double)(int64_t)value) {
+        json_writer_int(w, key, (int64_t)value);
+        return;
+    }
+    // 15 digits where they read back exactly, else all 17.
+    char num[32];
+    int n = snprintf(num, sizeof(num), "%.15g", value);
+    if (strtod(num, NULL) != value) {
+        n = snprintf(num, sizeof(num), "%.17g", value);
+    }
+    begin_value(w, key);
+    put(w, num, (size_t)n);
+}
+
+void json_writer_bool(json_writer_t* w, const char* key, bool value) {
+    begin_value(w, key);
+    if (value) {
+        put(w, "true", 4);
+    } else {
+        put(w, "false", 5);
+    }
+}
+
+void json_writer_null(json_writer_t* w, const char* key) {
+    begin_value(w, key);
+    put(w, "null", 4);
+}
+
+const char* json_writer_finish(json_writer_t* w, size_t* len) {
+    if (w->overflow || w->depth != 0) {
+        return NULL;
+    }
+    w->buf[w->len] = '\0';
+    if (len) {
+        *len = w->len;
+    }
+    return w->buf;
+}
@@ -1,113 +1,227 @@
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
 #include "esp_err.h"
+#include "esp_heap_caps.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
+#include "sdkconfig.h"
 
 #include "slre.h"
+#include "static_cache.h"
 
 #define BASE_PATH       "/storage"
 #define MAX_PATH_LENGTH 512
 #define BASE_PATH_LEN   (sizeof(BASE_PATH) - 1)
 #define URI_MAX_LEN     256
+#define SEND_BUFFER_BYTES (CONFIG_WEB_STATIC_SEND_BUFFER_KB * 1024)
 
 static const char* TAG = "GET_STATIC";
 
 // --- MIME Type Helper ---
+typedef struct {
+    const char* ext;
+    const char* mime;
+} mime_entry_t;
+
+static const mime_entry_t mime_table[] = {
+    {"html", "text/html"},
+    {"css", "text/css"},
+    {"js", "application/javascript"},
+    {"json", "application/json"},
+    {"svg", "image/svg+xml"},
+    {"ico", "image/x-icon"},
+    {"png", "image/png"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"woff2", "font/woff2"},
+    {"ttf", "font/ttf"},
+};
+
+// Looks up the extension of the served name (not of any ".gz").
 static const char* get_mime_type(const char* filepath) {
-    if (strstr(filepath, ".html")) {
-        return "text/html";
-    }
-    if (strstr(filepath, ".css")) {
-        return "text/css";
-    }
-    if (strstr(filepath, ".js")) {
-        return "application/javascript";
+    const char* base = strrchr(filepath, '/');
+    const char* dot = strrchr(base ? base : filepath, '.');
+    if (dot) {
+        for (size_t i = 0; i < sizeof(mime_table) / sizeof(mime_table[0]); i++) {
+            if (strcasecmp(dot + 1, mime_table[i].ext) == 0) {
+                return mime_table[i].mime;
+            }
+        }
     }
-    if (strstr(filepath, ".json")) {
-        return "application/json";
+    return "application/octet-stream";
+}
+
+// --- Send buffer ---
+// The server runs handlers on a single task, so one buffer serves every
+// request. Allocated on first use and kept.
+static uint8_t* s_send_buf = NULL;
+
+static uint8_t* get_send_buffer(void) {
+    if (!s_send_buf) {
+        s_send_buf = malloc(SEND_BUFFER_BYTES);
+        if (!s_send_buf) {
+            ESP_LOGE(TAG, "No memory for the %d B send buffer", SEND_BUFFER_BYTES);
+        }
     }
-    if (strstr(filepath, ".svg")) {
-        return "image/svg+xml";
+    return s_send_buf;
+}
+
+// --- Validators ---
+#define IMMUTABLE_CACHE_CONTROL "public, max-age=31536000, immutable"
+#define REVALIDATE_CACHE_CONTROL "no-cache"
+
+// True when the request's If-None-Match lists `etag` (or is "*").
+static bool etag_matches(httpd_req_t* req, const char* etag) {
+    char value[128];
+    size_t len = httpd_req_get_hdr_value_len(req, "If-None-Match");
+    if (len == 0 || len >= sizeof(value) ||
+        httpd_req_get_hdr_value_str(req, "If-None-Match", value, sizeof(value)) != ESP_OK) {
+        return false;
     }
-    if (strstr(filepath, ".ico")) {
-        return "image/x-icon";
+    return strcmp(value, "*") == 0 || strstr(value, etag) != NULL;
+}
+
+// Sends a whole file into the cache as well as to the client. Returns false
+// (nothing sent) when the file is not worth caching or memory ran out.
+static bool send_and_cache(httpd_req_t* req, FILE* file, size_t size, const char* path,
+                           bool gzip) {
+    uint8_t* data = static_cache_alloc(size);
+    if (!data) {
+        return false;
     }
-    if (strstr(filepath, ".png")) {
-        return "image/png";
+    if (fread(data, 1, size, file) != size) {
+        heap_caps_free(data);
+        rewind(file);
+        return false;
     }
-    if (strstr(filepath, ".jpg") || strstr(filepath, ".jpeg")) {
-        return "image/jpeg";
+    httpd_resp_send(req, (const char*)data, (ssize_t)size);
+    static_cache_put(path, data, size, gzip);
+    return true;
+}
+
+// Sends the file through the shared buffer: with Content-Length in one
+// write when it fits, otherwise in buffer-sized chunks.
+static esp_err_t send_file(httpd_req_t* req, FILE* file, size_t size) {
+    uint8_t* buf = get_send_buffer();
+    if (!buf) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
     }
-    if (strstr(filepath, ".woff2")) {
-        return "font/woff2";
+    if (size <= SEND_BUFFER_BYTES) {
+        size_t read_bytes = fread(buf, 1, size, file);
+        return httpd_resp_send(req, (const char*)buf, (ssize_t)read_bytes);
     }
-    if (strstr(filepath, ".ttf")) {
-        return "font/ttf";
+    size_t read_bytes;
+    while ((read_bytes = fread(buf, 1, SEND_BUFFER_BYTES, file)) > 0) {
+        if (httpd_resp_send_chunk(req, (const char*)buf, (ssize_t)read_bytes) != ESP_OK) {
+            return ESP_FAIL;
+        }
     }
-    return "application/octet-stream";
+    return httpd_resp_send_chunk(req, NULL, 0); // end response
 }
 
 // --- Static file handler ---
 static esp_err_t get_static_file_handler(httpd_req_t* req) {
     char filepath[MAX_PATH_LENGTH + BASE_PATH_LEN + 4 + 1];
+    char uri_path[URI_MAX_LEN + 1];
     const char* uri = req->uri;
 
+    // The query string does not select a file.
+    size_t uri_len = strcspn(uri, "?");
+    if (uri_len > URI_MAX_LEN) {
+        httpd_resp_send_err(req, HTTPD_414_URI_TOO_LONG, "URI too long");
+        return ESP_FAIL;
+    }
+    memcpy(uri_path, uri, uri_len);
+    uri_path[uri_len] = '\0';
+    uri = uri_path;
+
     // Redirect root URI and everything without extension to index.html
     // TODO: Make this more generic and configurable
     if (strcmp(uri, "/") == 0 || strrchr(uri, '.') == NULL) {
         uri = "/index.html";
+        uri_len = strlen(uri);
     }
 
-    size_t uri_len = strnlen(uri, URI_MAX_LEN + 1);
-    if (uri_len > URI_MAX_LEN) {
+    if ((BASE_PATH_LEN + uri_len + 3 + 1) >= sizeof(filepath)) {
         httpd_resp_send_err(req, HTTPD_414_URI_TOO_LONG, "URI too long");
         return ESP_FAIL;
     }
 
-    if ((BASE_PATH_LEN + uri_len + 3 + 1) >= sizeof(filepath)) {
-        httpd_resp_send_err(req, HTTPD_414_URI_TOO_LONG, "URI too long");
-        return ESP_FAIL;
+    // Hashed names never change, so the browser need not ask again; the
+    // rest are revalidated against the build's ETag on every load.
+    const char* etag = static_cache_etag(uri);
+    const char* cache_control =
+        static_cache_is_hashed(uri) ? IMMUTABLE_CACHE_CONTROL : REVALIDATE_CACHE_CONTROL;
+    if (etag && etag_matches(req, etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_set_hdr(req, "Cache-Control", cache_control);
+        httpd_resp_set_hdr(req, "ETag", etag);
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    const char* mime = get_mime_type(uri);
+    const uint8_t* cached = NULL;
+    size_t cached_len = 0;
+    bool gzip = false;
+    if (static_cache_get(uri, &cached, &cached_len, &gzip)) {
+        httpd_resp_set_hdr(req, "Cache-Control", cache_control);
+        if (etag) {
+            httpd_resp_set_hdr(req, "ETag", etag);
+        }
+        if (gzip) {
+            httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+        }
+        httpd_resp_set_type(req, mime);
+        return httpd_resp_send(req, (const char*)cached, (ssize_t)cached_len);
     }
 
     memcpy(filepath, BASE_PATH, BASE_PATH_LEN);
     memcpy(filepath + BASE_PATH_LEN, uri, uri_len);
     memcpy(filepath + BASE_PATH_LEN + uri_len, ".gz", 3);
     filepath[BASE_PATH_LEN + uri_len + 3] = '\0';
-    ESP_LOGI(TAG, "Serving file: %s", filepath);
+    ESP_LOGD(TAG, "Serving file: %s", filepath);
 
-    FILE* file = fopen(filepath, "r");
-    if (!file) {
-        ESP_LOGE(TAG, "Gzip file not found: %s, fallback to normal.", filepath);
-        memcpy(filepath, BASE_PATH, BASE_PATH_LEN);
-        memcpy(filepath + BASE_PATH_LEN, uri, uri_len);
+    // stat() picks the stored variant and gives its length up front.
+    struct stat st;
+    gzip = stat(filepath, &st) == 0;
+    if (!gzip) {
+        ESP_LOGD(TAG, "Gzip file not found: %s, fallback to normal.", filepath);
         filepath[BASE_PATH_LEN + uri_len] = '\0';
-
-        file = fopen(filepath, "r");
-        if (!file) {
+        if (stat(filepath, &st) != 0) {
             ESP_LOGE(TAG, "File not found: %s", filepath);
             httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "File not found");
             return ESP_FAIL;
-        } else {
-            ESP_LOGI(TAG, "Normal file served: %s", filepath);
         }
-    } else {
+    }
+    FILE* file = fopen(filepath, "r");
+    if (!file) {
+        ESP_LOGE(TAG, "Cannot open: %s", filepath);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Cannot open file");
+        return ESP_FAIL;
+    }
+    if (gzip) {
         httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
     }
 
-    // Set content type
-    const char* mime = get_mime_type(filepath);
+    // Set content type and validators
     httpd_resp_set_type(req, mime);
-
-    char chunk[512];
-    size_t read_bytes;
-    while ((read_bytes = fread(chunk, 1, sizeof(chunk), file)) > 0) {
-        httpd_resp_send_chunk(req, chunk, read_bytes);
+    httpd_resp_set_hdr(req, "Cache-Control", cache_control);
+    if (etag) {
+        httpd_resp_set_hdr(req, "ETag", etag);
     }
 
+    const size_t size = (size_t)st.st_size;
+    esp_err_t err = ESP_OK;
+    if (!send_and_cache(req, file, size, uri, gzip)) {
+        err = send_file(req, file, size);
+    }
     fclose(file);
-    httpd_resp_send_chunk(req, NULL, 0); // end response
-    return ESP_OK;
+    return err;
 }
 
 // --- Route table ---
@@ -0,0 +1,176 @@
+#include "static_cache.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#define MANIFEST_PATH    "/storage/etags"
+#define MANIFEST_MAX     32
+#define PATH_MAX_LEN     CONFIG_SPIFFS_OBJ_NAME_LEN
+#define ETAG_HEX_LEN     16
+#define HASHED_MIN_DIGITS 8
+
+#if defined(CONFIG_WEB_STATIC_CACHE_KB) && CONFIG_WEB_STATIC_CACHE_KB > 0
+#define CACHE_BYTES     ((size_t)CONFIG_WEB_STATIC_CACHE_KB * 1024)
+#define CACHE_FILE_MAX  ((size_t)CONFIG_WEB_STATIC_CACHE_FILE_KB * 1024)
+#define CACHE_SLOTS     8
+#else
+#define CACHE_BYTES     0
+#define CACHE_FILE_MAX  0
+#define CACHE_SLOTS     1
+#endif
+
+static const char* TAG = "STATIC_CACHE";
+
+typedef struct {
+    char path[PATH_MAX_LEN];
+    char etag[ETAG_HEX_LEN + 3]; // quoted
+} manifest_entry_t;
+
+typedef struct {
+    char path[PATH_MAX_LEN];
+    uint8_t* data; // NULL when the slot is free
+    size_t len;
+    bool gzip;
+    uint32_t used; // s_clock at the last hit
+} cache_slot_t;
+
+static manifest_entry_t s_manifest[MANIFEST_MAX];
+static int s_manifest_count = 0;
+static bool s_manifest_loaded = false;
+
+static cache_slot_t s_slots[CACHE_SLOTS];
+static size_t s_cached_bytes = 0;
+static uint32_t s_clock = 0;
+
+static void load_manifest(void) {
+    s_manifest_loaded = true;
+    FILE* f = fopen(MANIFEST_PATH, "r");
+    if (!f) {
+        ESP_LOGW(TAG, "No %s, static files are sent without ETags", MANIFEST_PATH);
+        return;
+    }
+    char line[ETAG_HEX_LEN + PATH_MAX_LEN + 8];
+    while (s_manifest_count < MANIFEST_MAX && fgets(line, sizeof(line), f)) {
+        char* sep = strchr(line, ' ');
+        if (!sep || sep - line != ETAG_HEX_LEN || sep[1] != '/') {
+            continue;
+        }
+        char* path = sep + 1;
+        path[strcspn(path, "\r\n")] = '\0';
+        if (strlen(path) >= PATH_MAX_LEN) {
+            continue;
+        }
+        manifest_entry_t* e = &s_manifest[s_manifest_count++];
+        strcpy(e->path, path);
+        e->etag[0] = '"';
+        memcpy(&e->etag[1], line, ETAG_HEX_LEN);
+        e->etag[ETAG_HEX_LEN + 1] = '"';
+        e->etag[ETAG_HEX_LEN + 2] = '\0';
+    }
+    fclose(f);
+    ESP_LOGI(TAG, "Loaded %d ETags", s_manifest_count);
+}
+
+const char* static_cache_etag(const char* path) {
+    if (!s_manifest_loaded) {
+        load_manifest();
+    }
+    for (int i = 0; i < s_manifest_count; i++) {
+        if (strcmp(s_manifest[i].path, path) == 0) {
+            return s_manifest[i].etag;
+        }
+    }
+    return NULL;
+}
+
+bool static_cache_is_hashed(const char* path) {
+    // The last two dots of the base name enclose the hash.
+    const char* base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    const char* ext = strrchr(base, '.');
+    if (!ext) {
+        return false;
+    }
+    const char* p = ext;
+    int digits = 0;
+    while (p > base && isxdigit((unsigned char)p[-1])) {
+        p--;
+        digits++;
+    }
+    return digits >= HASHED_MIN_DIGITS && p > base && p[-1] == '.';
+}
+
+bool static_cache_get(const char* path, const uint8_t** data, size_t* len, bool* gzip) {
+    if (CACHE_BYTES == 0) {
+        return false;
+    }
+    for (int i = 0; i < CACHE_SLOTS; i++) {
+        cache_slot_t* slot = &s_slots[i];
+        if (slot->data && strcmp(slot->path, path) == 0) {
+            slot->used = ++s_clock;
+            *data = slot->data;
+            *len = slot->len;
+            *gzip = slot->gzip;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t static_cache_max_file(void) {
+    return CACHE_FILE_MAX < CACHE_BYTES ? CACHE_FILE_MAX : CACHE_BYTES;
+}
+
+uint8_t* static_cache_alloc(size_t len) {
+    if (CACHE_BYTES == 0 || len == 0 || len > static_cache_max_file()) {
+        return NULL;
+    }
+    return heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+}
+
+static void evict(cache_slot_t* slot) {
+    heap_caps_free(slot->data);
+    s_cached_bytes -= slot->len;
+    slot->data = NULL;
+    slot->len = 0;
+}
+
+void static_cache_put(const char* path, uint8_t* data, size_t len, bool gzip) {
+    if (!data) {
+        return;
+    }
+    if (CACHE_BYTES == 0 || len > static_cache_max_file() || strlen(path) >= PATH_MAX_LEN) {
+        heap_caps_free(data);
+        return;
+    }
+    // Evict least recently used files until both a slot and the bytes fit.
+    for (;;) {
+        cache_slot_t* free_slot = NULL;
+        cache_slot_t* oldest = NULL;
+        for (int i = 0; i < CACHE_SLOTS; i++) {
+            cache_slot_t* slot = &s_slots[i];
+            if (!slot->data) {
+                free_slot = free_slot ? free_slot : slot;
+            } else if (!oldest || (int32_t)(slot->used - oldest->used) < 0) {
+                oldest = slot;
+            }
+        }
+        if (free_slot && s_cached_bytes + len <= CACHE_BYTES) {
+            strcpy(free_slot->path, path);
+            free_slot->data = data;
+            free_slot->len = len;
+            free_slot->gzip = gzip;
+            free_slot->used = ++s_clock;
+            s_cached_bytes += len;
+            ESP_LOGD(TAG, "Cached %s (%u B, %u B total)", path, (unsigned)len,
+                     (unsigned)s_cached_bytes);
+            return;
+        }
+        evict(oldest);
+    }
+}
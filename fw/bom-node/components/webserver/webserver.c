@@ -1,5 +1,7 @@
 #include <stdio.h>
+#include "boot_timing.h"
 #include "esp_log.h"
+#include "sdkconfig.h"
 
 #include "endpoints.h"
 #include "spiffs_init.h"
@@ -7,6 +9,10 @@
 
 static const char* TAG = "webserver";
 
+// Second instance for the long-lived audio streams, so the dashboard and the
+// API never queue behind one on the main server's task and sockets.
+static httpd_handle_t s_stream_server = NULL;
+
 /**
  * @brief Stops the ESP32 HTTP web server.
  * 
@@ -19,6 +25,37 @@ void stop_webserver(httpd_handle_t server) {
         ESP_LOGI(TAG, "Stopping webserver");
         httpd_stop(server);
     }
+    if (s_stream_server) {
+        httpd_stop(s_stream_server);
+        s_stream_server = NULL;
+    }
+}
+
+/**
+ * @brief Starts the stream server on CONFIG_WEB_STREAM_PORT.
+ *
+ * @return Handle to the stream server instance, or NULL on failure.
+ */
+static httpd_handle_t start_stream_server(void) {
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    httpd_handle_t server = NULL;
+    config.server_port = CONFIG_WEB_STREAM_PORT;
+    config.ctrl_port += 1; // the main server has the default one
+    config.max_open_sockets = CONFIG_WEB_STREAM_MAX_SOCKETS;
+    config.task_priority = CONFIG_WEB_STREAM_TASK_PRIORITY;
+    config.core_id = CONFIG_WEB_STREAM_TASK_CORE;
+    config.max_uri_handlers = 4;
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    // Every socket here is a stream someone is listening to; a client over
+    // the limit is refused rather than closing one of them.
+    config.lru_purge_enable = false;
+
+    if (httpd_start(&server, &config) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start stream server on port %d", config.server_port);
+        return NULL;
+    }
+    ESP_ERROR_CHECK(register_stream_endpoints(server));
+    return server;
 }
 
 /**
@@ -32,11 +69,16 @@ httpd_handle_t start_webserver(void) {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     httpd_handle_t server = NULL;
     config.uri_match_fn = httpd_uri_match_wildcard;
+    config.max_open_sockets = CONFIG_WEB_API_MAX_SOCKETS;
+    config.lru_purge_enable = true;
 
     init_spiffs_static();
+    boot_timing_mark(BOOT_STAGE_SPIFFS);
 
     if (httpd_start(&server, &config) == ESP_OK) {
         ESP_ERROR_CHECK(register_endpoints(server));
+        s_stream_server = start_stream_server();
+        boot_timing_mark(BOOT_STAGE_WEBSERVER);
     }
 
     return server;
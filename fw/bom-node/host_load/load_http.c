@@ -0,0 +1,270 @@
+#include "load_http.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+bool load_url_parse(const char *url, load_url *out) {
+  static const char scheme[] = "http://";
+  if (strncmp(url, scheme, sizeof(scheme) - 1) != 0) {
+    return false;
+  }
+  const char *host = url + sizeof(scheme) - 1;
+  const char *path = strchr(host, '/');
+  const size_t authority = path ? (size_t)(path - host) : strlen(host);
+  if (!path) {
+    path = "/";
+  }
+  const char *colon = memchr(host, ':', authority);
+  const size_t host_len = colon ? (size_t)(colon - host) : authority;
+  if (host_len == 0 || host_len >= sizeof(out->host) ||
+      strlen(path) >= sizeof(out->path)) {
+    return false;
+  }
+  memcpy(out->host, host, host_len);
+  out->host[host_len] = '\0';
+  if (colon) {
+    const size_t port_len = authority - host_len - 1;
+    if (port_len == 0 || port_len >= sizeof(out->port)) {
+      return false;
+    }
+    memcpy(out->port, colon + 1, port_len);
+    out->port[port_len] = '\0';
+  } else {
+    strcpy(out->port, "80");
+  }
+  strcpy(out->path, path);
+  return true;
+}
+
+void load_reader_init(load_reader *r, int fd) {
+  r->fd = fd;
+  r->pos = r->len = 0;
+}
+
+static bool reader_fill(load_reader *r) {
+  for (;;) {
+    const ssize_t n = recv(r->fd, r->buf, sizeof(r->buf), 0);
+    if (n > 0) {
+      r->pos = 0;
+      r->len = (size_t)n;
+      return true;
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    return false;
+  }
+}
+
+bool load_reader_line(load_reader *r, char *line, size_t cap) {
+  size_t n = 0;
+  for (;;) {
+    if (r->pos == r->len && !reader_fill(r)) {
+      return false;
+    }
+    const char c = r->buf[r->pos++];
+    if (c == '\n') {
+      if (n > 0 && line[n - 1] == '\r') {
+        n--;
+      }
+      line[n] = '\0';
+      return true;
+    }
+    if (n + 1 >= cap) {
+      return false;
+    }
+    line[n++] = c;
+  }
+}
+
+bool load_reader_skip(load_reader *r, uint64_t n) {
+  while (n > 0) {
+    if (r->pos == r->len && !reader_fill(r)) {
+      return false;
+    }
+    const size_t avail = r->len - r->pos;
+    const size_t take = n < avail ? (size_t)n : avail;
+    r->pos += take;
+    n -= take;
+  }
+  return true;
+}
+
+bool load_read_head(load_reader *r, bool response, load_message *msg,
+                    char *first_line, size_t cap) {
+  *msg = (load_message){.status = -1, .length = -1};
+  if (!load_reader_line(r, first_line, cap)) {
+    return false;
+  }
+  if (response) {
+    if (strncmp(first_line, "HTTP/1.", 7) != 0 || strlen(first_line) < 12) {
+      return false;
+    }
+    msg->status = atoi(first_line + 9);
+    // HTTP/1.0 closes unless told otherwise.
+    msg->close = first_line[7] == '0';
+  }
+  char line[512];
+  for (;;) {
+    if (!load_reader_line(r, line, sizeof(line))) {
+      return false;
+    }
+    if (line[0] == '\0') {
+      return true;
+    }
+    char *value = strchr(line, ':');
+    if (!value) {
+      continue;
+    }
+    *value++ = '\0';
+    while (*value == ' ' || *value == '\t') {
+      value++;
+    }
+    if (strcasecmp(line, "Content-Length") == 0) {
+      msg->length = strtoll(value, NULL, 10);
+    } else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+      msg->chunked = strcasestr(value, "chunked") != NULL;
+    } else if (strcasecmp(line, "Connection") == 0) {
+      msg->close = strcasestr(value, "close") != NULL;
+    }
+  }
+}
+
+int64_t load_read_body(load_reader *r, const load_message *msg) {
+  if (msg->chunked) {
+    int64_t total = 0;
+    char line[64];
+    for (;;) {
+      if (!load_reader_line(r, line, sizeof(line))) {
+        return -1;
+      }
+      char *end = NULL;
+      const unsigned long long size = strtoull(line, &end, 16);
+      if (end == line) {
+        return -1;
+      }
+      if (size == 0) {
+        break;
+      }
+      if (!load_reader_skip(r, size) || !load_reader_line(r, line, 4)) {
+        return -1;
+      }
+      total += (int64_t)size;
+    }
+    // Trailers up to the blank line.
+    do {
+      if (!load_reader_line(r, line, sizeof(line))) {
+        return -1;
+      }
+    } while (line[0] != '\0');
+    return total;
+  }
+  if (msg->length >= 0) {
+    return load_reader_skip(r, (uint64_t)msg->length) ? msg->length : -1;
+  }
+  if (msg->status < 0) {
+    return 0; // a request without a body
+  }
+  int64_t total = (int64_t)(r->len - r->pos);
+  r->pos = r->len;
+  while (reader_fill(r)) {
+    total += (int64_t)r->len;
+    r->pos = r->len;
+  }
+  return total;
+}
+
+int load_connect(const load_url *url, int timeout_ms) {
+  const struct addrinfo hints = {
+      .ai_family = AF_UNSPEC,
+      .ai_socktype = SOCK_STREAM,
+  };
+  struct addrinfo *res = NULL;
+  if (getaddrinfo(url->host, url->port, &hints, &res) != 0) {
+    return -1;
+  }
+  int fd = -1;
+  for (const struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    const struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+      break;
+    }
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+bool load_send_all(int fd, const void *buf, size_t len) {
+  const char *p = buf;
+  while (len > 0) {
+    const ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+bool load_send_chunk(int fd, const void *payload, size_t len) {
+  char hdr[16];
+  const int hlen = snprintf(hdr, sizeof(hdr), "%X\r\n", (unsigned)len);
+  if (len == 0) {
+    return load_send_all(fd, "0\r\n\r\n", 5);
+  }
+  // One write per frame, like the firmware, so the segments match.
+  char stack[8192];
+  if ((size_t)hlen + len + 2 <= sizeof(stack)) {
+    memcpy(stack, hdr, (size_t)hlen);
+    memcpy(stack + hlen, payload, len);
+    memcpy(stack + hlen + len, "\r\n", 2);
+    return load_send_all(fd, stack, (size_t)hlen + len + 2);
+  }
+  return load_send_all(fd, hdr, (size_t)hlen) &&
+         load_send_all(fd, payload, len) && load_send_all(fd, "\r\n", 2);
+}
+
+bool load_send_post(int fd, const load_url *url, const char *content_type,
+                    int64_t length) {
+  char head[768];
+  char framing[48];
+  if (length < 0) {
+    snprintf(framing, sizeof(framing), "Transfer-Encoding: chunked");
+  } else {
+    snprintf(framing, sizeof(framing), "Content-Length: %lld",
+             (long long)length);
+  }
+  const int n = snprintf(head, sizeof(head),
+                         "POST %s HTTP/1.1\r\n"
+                         "User-Agent: ESP32 HTTP Client/1.0\r\n"
+                         "Host: %s:%s\r\n"
+                         "Content-Type: %s\r\n"
+                         "%s\r\n\r\n",
+                         url->path, url->host, url->port, content_type,
+                         framing);
+  return n > 0 && (size_t)n < sizeof(head) &&
+         load_send_all(fd, head, (size_t)n);
+}
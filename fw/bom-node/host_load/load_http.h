@@ -0,0 +1,72 @@
+#ifndef LOAD_HTTP_H
+#define LOAD_HTTP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Just enough HTTP/1.1 over blocking POSIX sockets for the load generator
+// and its sink: plain http:// only, one request at a time per connection.
+// The requests are shaped like the firmware's esp_http_client ones.
+
+#define LOAD_URL_HOST_MAX 128
+#define LOAD_URL_PATH_MAX 256
+
+typedef struct {
+  char host[LOAD_URL_HOST_MAX];
+  char port[8];
+  char path[LOAD_URL_PATH_MAX];
+} load_url;
+
+// Parses "http://host[:port][/path]". Returns false for anything else.
+bool load_url_parse(const char *url, load_url *out);
+
+// Buffered reads from a socket.
+typedef struct {
+  int fd;
+  size_t pos, len;
+  char buf[4096];
+} load_reader;
+
+void load_reader_init(load_reader *r, int fd);
+
+// Reads one line into `line` without its CRLF. Returns false on EOF, on a
+// timeout or when the line does not fit.
+bool load_reader_line(load_reader *r, char *line, size_t cap);
+
+// Reads and discards `n` bytes.
+bool load_reader_skip(load_reader *r, uint64_t n);
+
+// Both the response and the request side of a message: headers read up to
+// the blank line, then the body drained.
+typedef struct {
+  int status;        // responses only
+  int64_t length;    // Content-Length, or -1
+  bool chunked;      // Transfer-Encoding: chunked
+  bool close;        // Connection: close
+} load_message;
+
+// Reads the status line (`response`) or request line and the headers.
+bool load_read_head(load_reader *r, bool response, load_message *msg,
+                    char *first_line, size_t cap);
+
+// Drains the body described by `msg`; a response with neither a length nor
+// chunking runs to EOF. Returns the body bytes, or -1 on failure.
+int64_t load_read_body(load_reader *r, const load_message *msg);
+
+// Connects to the URL's host with send and receive timeouts. Returns the
+// socket or -1.
+int load_connect(const load_url *url, int timeout_ms);
+
+bool load_send_all(int fd, const void *buf, size_t len);
+
+// One chunked-encoding frame, as audio_streamer_write_frame() sends it:
+// "<hex size>\r\n", the payload, "\r\n". A zero length is the terminator.
+bool load_send_chunk(int fd, const void *payload, size_t len);
+
+// Request line and headers of a POST. `length` < 0 sends
+// "Transfer-Encoding: chunked".
+bool load_send_post(int fd, const load_url *url, const char *content_type,
+                    int64_t length);
+
+#endif
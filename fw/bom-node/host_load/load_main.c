@@ -0,0 +1,971 @@
+// Fleet load generator: many simulated nodes pushing the firmware's chunked
+// WAV stream and its multipart event batches at one backend, reporting how
+// fast and how reliably the backend takes them. See README.md.
+
+#include "audio_shaper.h"
+#include "audio_wav.h"
+#include "ima_adpcm.h"
+#include "json_writer.h"
+#include "load_http.h"
+#include "load_sink.h"
+#include "mic_replay.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+// The streamer's framing and pacing (audio_streamer.c).
+#define STREAM_CHUNK_FRAMES 480
+#define STREAM_PUSH_CHUNKS  3 // 4 segments of the default 1440-byte MSS
+#define STREAM_POOL_CHUNKS  10
+#define STREAM_RETRY_MS     1000
+#define STREAM_RETRY_MAX_MS 30000
+
+// The event uploader's (event_uploader.c).
+#define EVENT_QUEUE_EVENTS 6
+#define EVENT_BATCH_EVENTS 4
+#define EVENT_BATCH_MS     2000
+#define EVENT_RETRY_MS     1000
+#define EVENT_RETRY_MAX_MS 60000
+#define EVENT_PRE_MS       30
+#define EVENT_POST_MS      50
+#define EVENT_BOUNDARY     "bomchecker-event-batch"
+#define EVENT_PART_HDR_MAX 192
+#define EVENT_FEATURE_BANDS 8
+
+#define LOAD_HTTP_TIMEOUT_MS 10000
+#define LOAD_NODE_STACK      (256 * 1024)
+#define LOAD_MAX_BATCH       16
+#define LOAD_JSON_PER_EVENT  640
+
+typedef enum {
+  PAYLOAD_CLIP,
+  PAYLOAD_FEATURES,
+  PAYLOAD_BOTH,
+} event_payload;
+
+typedef struct {
+  const char *url; // "{node}" is replaced by the node number
+  int nodes;
+  double seconds;
+  double ramp_s;
+  bool stream;
+  bool events;
+  int rate;
+  bool adpcm;
+  audio_channel_mode channels;
+  int decimation;
+  double jitter_ms;
+  int coalesce;
+  int pool;
+  double segment_s;
+  double events_per_min;
+  int batch;
+  int linger_ms;
+  event_payload payload;
+  bool self_sink;
+  int sink_delay_us;
+  bool expect_ok;
+} load_options;
+
+static load_options s_opt = {
+    .nodes = 10,
+    .seconds = 30,
+    .ramp_s = 1,
+    .stream = true,
+    .events = true,
+    .rate = 44100,
+    .channels = AUDIO_CHANNELS_STEREO,
+    .decimation = 1,
+    .jitter_ms = 2,
+    .coalesce = STREAM_PUSH_CHUNKS,
+    .pool = STREAM_POOL_CHUNKS,
+    .segment_s = 10,
+    .events_per_min = 6,
+    .batch = EVENT_BATCH_EVENTS,
+    .linger_ms = EVENT_BATCH_MS,
+    .payload = PAYLOAD_BOTH,
+};
+
+// A growing list of microsecond samples, one per node and measure, merged
+// for the report.
+typedef struct {
+  uint32_t *v;
+  size_t n, cap;
+} lat_log;
+
+// Outcome of a request by status class.
+typedef struct {
+  uint64_t ok;        // 2xx
+  uint64_t client;    // 4xx
+  uint64_t server;    // 5xx and anything else
+  uint64_t transport; // no status: connect, write or read failed
+} status_counts;
+
+typedef struct {
+  // Stream.
+  lat_log write_us; // one HTTP chunk write
+  lat_log queue_us; // a chunk's wait from capture to its write
+  lat_log ack_us;   // terminator sent to status line
+  status_counts uploads;
+  uint64_t writes, stream_bytes, chunks, dropped, gaps;
+  // Events.
+  lat_log post_us;    // connect to status line
+  lat_log deliver_us; // detection to accepted
+  status_counts posts;
+  uint64_t events, delivered, events_dropped, event_bytes;
+} node_stats;
+
+typedef struct {
+  int id;
+  load_url url;
+  int64_t start_us, end_us; // monotonic
+  uint32_t seed;
+  node_stats st;
+} node_ctx;
+
+static int64_t s_run_start_us;
+static int16_t *s_clip_pcm; // stereo clip shared by every node's events
+static int s_clip_frames;
+
+static int64_t now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t unix_us(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void sleep_until_us(int64_t t) {
+  const struct timespec ts = {
+      .tv_sec = t / 1000000,
+      .tv_nsec = (long)(t % 1000000) * 1000,
+  };
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+  }
+}
+
+static void lat_add(lat_log *l, int64_t us) {
+  if (l->n == l->cap) {
+    const size_t cap = l->cap ? 2 * l->cap : 1024;
+    uint32_t *v = realloc(l->v, cap * sizeof(*v));
+    if (!v) {
+      return;
+    }
+    l->v = v;
+    l->cap = cap;
+  }
+  l->v[l->n++] = us < 0 ? 0 : us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+static void lat_merge(lat_log *into, const lat_log *from) {
+  for (size_t i = 0; i < from->n; i++) {
+    lat_add(into, from->v[i]);
+  }
+}
+
+static void status_add(status_counts *c, int status) {
+  if (status < 0) {
+    c->transport++;
+  } else if (status >= 200 && status < 300) {
+    c->ok++;
+  } else if (status >= 400 && status < 500) {
+    c->client++;
+  } else {
+    c->server++;
+  }
+}
+
+static uint64_t status_failed(const status_counts *c) {
+  return c->client + c->server + c->transport;
+}
+
+static uint32_t node_rand(node_ctx *n) {
+  uint32_t x = n->seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  n->seed = x;
+  return x;
+}
+
+// Uniform in [0, 1).
+static double node_uniform(node_ctx *n) {
+  return (node_rand(n) >> 8) / 16777216.0;
+}
+
+static void retry_wait(node_ctx *n, uint32_t *backoff_ms, uint32_t max_ms) {
+  int64_t until = now_us() + (int64_t)*backoff_ms * 1000;
+  sleep_until_us(until < n->end_us ? until : n->end_us);
+  *backoff_ms = *backoff_ms >= max_ms / 2 ? max_ms : *backoff_ms * 2;
+}
+
+// Reads a response and closes the connection. Returns the status, or -1.
+static int finish_request(int fd) {
+  load_reader *r = malloc(sizeof(*r));
+  int status = -1;
+  if (r) {
+    load_reader_init(r, fd);
+    char line[256];
+    load_message msg;
+    if (load_read_head(r, true, &msg, line, sizeof(line)) &&
+        load_read_body(r, &msg) >= 0) {
+      status = msg.status;
+    }
+    free(r);
+  }
+  close(fd);
+  return status;
+}
+
+// ---------------------------------------------------------------- stream
+
+typedef struct {
+  node_ctx *node;
+  mic_synth synth;
+  audio_shaper shaper;
+  ima_adpcm_encoder enc;
+  int channels; // after shaping
+  int fd;       // open upload, or -1
+  int64_t upload_start_us;
+  uint64_t synth_index; // next mic sample the synth produces
+  int32_t dma[STREAM_CHUNK_FRAMES * 2];
+  int16_t chunk[STREAM_CHUNK_FRAMES * 2];
+  int16_t *payload; // coalesce chunks, shaped
+  uint8_t *coded;
+  size_t pending; // frames in payload
+  int64_t oldest_ready_us;
+} stream_state;
+
+// Audio of chunk `k`; the synth runs on through dropped chunks so that
+// gaps stay gaps in the sample indices.
+static void stream_make_chunk(stream_state *s, uint64_t k) {
+  const uint64_t index = k * STREAM_CHUNK_FRAMES;
+  while (s->synth_index <= index) {
+    mic_synth_fill(&s->synth, s->dma, STREAM_CHUNK_FRAMES);
+    s->synth_index += STREAM_CHUNK_FRAMES;
+  }
+  for (int i = 0; i < STREAM_CHUNK_FRAMES; i++) {
+    s->chunk[2 * i] = (int16_t)(s->dma[2 * i + 1] >> 16);
+    s->chunk[2 * i + 1] = (int16_t)(s->dma[2 * i] >> 16);
+  }
+}
+
+static bool stream_open(stream_state *s, uint64_t k) {
+  node_ctx *n = s->node;
+  const int64_t t0 = now_us();
+  s->fd = load_connect(&n->url, LOAD_HTTP_TIMEOUT_MS);
+  if (s->fd < 0) {
+    return false;
+  }
+  audio_shaper_init(&s->shaper, s_opt.channels, s_opt.decimation);
+  ima_adpcm_init(&s->enc, s->channels);
+  const int rate = s_opt.rate / s_opt.decimation;
+  const int64_t captured =
+      n->start_us + (int64_t)(k * STREAM_CHUNK_FRAMES * 1000000 / s_opt.rate);
+  const audio_wav_stamp stamp = {
+      .sample_index = audio_shaper_out_index(&s->shaper,
+                                             k * STREAM_CHUNK_FRAMES),
+      .uptime_us = captured - s_run_start_us,
+      .unix_us = unix_us() - (now_us() - captured),
+  };
+  uint8_t header[AUDIO_WAV_STREAM_HEADER_MAX];
+  const size_t len =
+      s_opt.adpcm
+          ? audio_wav_build_adpcm_header(header, rate, s->channels,
+                                         IMA_ADPCM_BLOCK_BYTES,
+                                         IMA_ADPCM_BLOCK_FRAMES(s->channels),
+                                         &stamp)
+          : audio_wav_build_header(header, rate, s->channels, &stamp);
+  if (!load_send_post(s->fd, &n->url, "audio/wav", -1) ||
+      !load_send_chunk(s->fd, header, len)) {
+    close(s->fd);
+    s->fd = -1;
+    return false;
+  }
+  s->upload_start_us = t0;
+  return true;
+}
+
+static bool stream_flush(stream_state *s) {
+  if (s->pending == 0) {
+    return true;
+  }
+  node_stats *st = &s->node->st;
+  const void *frame = s->payload;
+  size_t len = s->pending * s->channels * sizeof(int16_t);
+  if (s_opt.adpcm) {
+    len = ima_adpcm_encode(&s->enc, s->payload, s->pending, s->coded);
+    frame = s->coded;
+  }
+  s->pending = 0;
+  const int64_t t0 = now_us();
+  lat_add(&st->queue_us, t0 - s->oldest_ready_us);
+  if (len == 0) {
+    return true;
+  }
+  if (!load_send_chunk(s->fd, frame, len)) {
+    return false;
+  }
+  lat_add(&st->write_us, now_us() - t0);
+  st->writes++;
+  st->stream_bytes += len;
+  return true;
+}
+
+// Ends the upload the way a graceful disconnect does: the last write, the
+// terminating chunk, then the backend's answer.
+static void stream_close(stream_state *s) {
+  node_stats *st = &s->node->st;
+  if (s->fd < 0) {
+    return;
+  }
+  if (!stream_flush(s) || !load_send_chunk(s->fd, NULL, 0)) {
+    close(s->fd);
+    s->fd = -1;
+    status_add(&st->uploads, -1);
+    return;
+  }
+  const int64_t t0 = now_us();
+  const int status = finish_request(s->fd);
+  s->fd = -1;
+  if (status >= 0) {
+    lat_add(&st->ack_us, now_us() - t0);
+  }
+  status_add(&st->uploads, status);
+}
+
+static void *stream_node(void *arg) {
+  node_ctx *n = arg;
+  node_stats *st = &n->st;
+  stream_state *s = calloc(1, sizeof(*s));
+  if (!s) {
+    return NULL;
+  }
+  s->node = n;
+  s->fd = -1;
+  s->channels = s_opt.channels == AUDIO_CHANNELS_STEREO ? 2 : 1;
+  const size_t payload_frames =
+      (size_t)s_opt.coalesce * STREAM_CHUNK_FRAMES;
+  s->payload = malloc(payload_frames * 2 * sizeof(int16_t));
+  s->coded = malloc(IMA_ADPCM_MAX_BYTES(payload_frames));
+  mic_synth_init(&s->synth, s_opt.rate, 1000, 100 + 37 * (n->id % 10), 16000,
+                 64, 5);
+  const double period_us = STREAM_CHUNK_FRAMES * 1e6 / s_opt.rate;
+  uint32_t backoff_ms = STREAM_RETRY_MS;
+  uint64_t k = 0;
+  // A stall that overfilled the pool: chunks gap_from..gap_to-1 were lost.
+  uint64_t gap_from = 0, gap_to = 0;
+
+  while (s->payload && s->coded && now_us() < n->end_us) {
+    // Chunk k is complete once its last frame is captured; the tap hands it
+    // over a little later.
+    const int64_t ready =
+        n->start_us + (int64_t)((k + 1) * period_us) +
+        (int64_t)(node_uniform(n) * s_opt.jitter_ms * 1000);
+    if (ready >= n->end_us) {
+      break;
+    }
+    const int64_t now = now_us();
+    if (now < ready) {
+      sleep_until_us(ready);
+    } else if (gap_to == 0) {
+      const uint64_t available =
+          (uint64_t)((now - n->start_us) / period_us);
+      if (available > k + (uint64_t)s_opt.pool) {
+        gap_from = k + (uint64_t)s_opt.pool;
+        gap_to = available;
+      }
+    }
+    if (gap_to && k == gap_from) {
+      // The stream task meets the hole and starts a new upload after it.
+      stream_close(s);
+      st->gaps++;
+      st->dropped += gap_to - gap_from;
+      k = gap_to;
+      gap_to = 0;
+      continue;
+    }
+    if (s->fd < 0 && !stream_open(s, k)) {
+      status_add(&st->uploads, -1);
+      retry_wait(n, &backoff_ms, STREAM_RETRY_MAX_MS);
+      continue;
+    }
+    stream_make_chunk(s, k);
+    if (s->pending == 0) {
+      s->oldest_ready_us = ready;
+    }
+    s->pending += audio_shaper_run(&s->shaper, s->chunk, STREAM_CHUNK_FRAMES,
+                                   k * STREAM_CHUNK_FRAMES,
+                                   s->payload + s->pending * s->channels);
+    st->chunks++;
+    k++;
+    if (s->pending + audio_shaper_max_out(&s->shaper, STREAM_CHUNK_FRAMES) >
+        payload_frames) {
+      if (!stream_flush(s)) {
+        // The pending audio is kept by the firmware; here it is lost.
+        close(s->fd);
+        s->fd = -1;
+        status_add(&st->uploads, -1);
+        retry_wait(n, &backoff_ms, STREAM_RETRY_MAX_MS);
+        continue;
+      }
+      backoff_ms = STREAM_RETRY_MS;
+    }
+    if (s_opt.segment_s > 0 &&
+        now_us() - s->upload_start_us >= (int64_t)(s_opt.segment_s * 1e6)) {
+      stream_close(s);
+    }
+  }
+  stream_close(s);
+  free(s->payload);
+  free(s->coded);
+  free(s);
+  return NULL;
+}
+
+// ---------------------------------------------------------------- events
+
+typedef struct {
+  uint32_t seq;
+  int64_t detected_us; // monotonic
+  uint64_t peak_index;
+  int32_t level_left, level_right;
+} sim_event;
+
+static bool send_features(void) { return s_opt.payload != PAYLOAD_CLIP; }
+static bool send_clips(void) { return s_opt.payload != PAYLOAD_FEATURES; }
+
+static const char *event_json(node_ctx *n, const sim_event *batch, int count,
+                              char *buf, size_t cap, size_t *len) {
+  json_writer_t w;
+  json_writer_init(&w, buf, cap);
+  json_writer_array_begin(&w, NULL);
+  const int pre = s_opt.rate * EVENT_PRE_MS / 1000;
+  for (int i = 0; i < count; i++) {
+    const sim_event *ev = &batch[i];
+    const int64_t uptime = ev->detected_us - s_run_start_us;
+    const int64_t unix_now = unix_us() - (now_us() - ev->detected_us);
+    json_writer_object_begin(&w, NULL);
+    json_writer_uint(&w, "bootId", 0x10000u + (uint32_t)n->id);
+    json_writer_uint(&w, "seq", ev->seq);
+    json_writer_uint(&w, "peakIndex", ev->peak_index);
+    json_writer_uint(&w, "windowStart", ev->peak_index - (uint64_t)pre);
+    json_writer_int(&w, "preSamples", pre);
+    json_writer_int(&w, "frames", s_clip_frames);
+    json_writer_int(&w, "sampleRate", s_opt.rate);
+    json_writer_string(&w, "channels", "LR");
+    json_writer_int(&w, "lrOffset", (int)(n->id % 13) - 6);
+    json_writer_int(&w, "levelLeft", ev->level_left);
+    json_writer_int(&w, "levelRight", ev->level_right);
+    json_writer_int(&w, "detLevel", ev->level_left);
+    json_writer_int(&w, "hits", 3);
+    json_writer_int(&w, "detRms", ev->level_left / 4);
+    json_writer_int(&w, "detEnergy", ev->level_left * 16);
+    json_writer_int(&w, "uptimeMs", uptime / 1000);
+    json_writer_int(&w, "unixMs", unix_now / 1000);
+    json_writer_int(&w, "peakUs", uptime - EVENT_POST_MS * 1000);
+    json_writer_int(&w, "peakUnixUs", unix_now - EVENT_POST_MS * 1000);
+    if (send_features()) {
+      json_writer_object_begin(&w, "features");
+      json_writer_array_begin(&w, "bandsDb");
+      for (int b = 0; b < EVENT_FEATURE_BANDS; b++) {
+        json_writer_double(&w, NULL, -20.0 - 3.5 * b);
+      }
+      json_writer_array_end(&w);
+      json_writer_string(&w, "channel", "L");
+      json_writer_double(&w, "centroidHz", 2150.0);
+      json_writer_double(&w, "riseUs", 420.0);
+      json_writer_double(&w, "peakToRmsDb", 17.5);
+      json_writer_object_end(&w);
+    }
+    if (send_clips()) {
+      char clip[16];
+      snprintf(clip, sizeof(clip), "clip%d", i);
+      json_writer_string(&w, "clip", clip);
+    }
+    json_writer_object_end(&w);
+  }
+  json_writer_array_end(&w);
+  return json_writer_finish(&w, len);
+}
+
+// As event_uploader_part_header().
+static int event_part_header(char *buf, size_t cap, int clip, uint32_t seq) {
+  if (clip < 0) {
+    return snprintf(buf, cap,
+                    "--" EVENT_BOUNDARY "\r\n"
+                    "Content-Disposition: form-data; name=\"events\"\r\n"
+                    "Content-Type: application/json\r\n\r\n");
+  }
+  return snprintf(buf, cap,
+                  "--" EVENT_BOUNDARY "\r\n"
+                  "Content-Disposition: form-data; name=\"clip%d\"; "
+                  "filename=\"event-%lu.wav\"\r\n"
+                  "Content-Type: audio/wav\r\n\r\n",
+                  clip, (unsigned long)seq);
+}
+
+static const char k_closing[] = "--" EVENT_BOUNDARY "--\r\n";
+
+// One batch as event_uploader_post() sends it: a fresh connection, a
+// Content-Length multipart body. Returns the status, or -1.
+static int event_post(node_ctx *n, const sim_event *batch, int count) {
+  static const size_t json_cap = LOAD_MAX_BATCH * LOAD_JSON_PER_EVENT;
+  char *json_buf = malloc(json_cap);
+  if (!json_buf) {
+    return -1;
+  }
+  size_t json_len = 0;
+  const char *json = event_json(n, batch, count, json_buf, json_cap, &json_len);
+  if (!json) {
+    free(json_buf);
+    return -1;
+  }
+  const size_t clip_bytes =
+      AUDIO_WAV_HEADER_BYTES + (size_t)s_clip_frames * 2 * sizeof(int16_t);
+  char part[EVENT_PART_HDR_MAX];
+  int64_t total =
+      event_part_header(part, sizeof(part), -1, 0) + (int64_t)json_len + 2;
+  for (int i = 0; send_clips() && i < count; i++) {
+    total += event_part_header(part, sizeof(part), i, batch[i].seq) +
+             (int64_t)clip_bytes + 2;
+  }
+  total += (int64_t)sizeof(k_closing) - 1;
+
+  const int64_t t0 = now_us();
+  const int fd = load_connect(&n->url, LOAD_HTTP_TIMEOUT_MS);
+  bool ok = fd >= 0 &&
+            load_send_post(fd, &n->url,
+                           "multipart/form-data; boundary=" EVENT_BOUNDARY,
+                           total);
+  int len = event_part_header(part, sizeof(part), -1, 0);
+  ok = ok && load_send_all(fd, part, (size_t)len) &&
+       load_send_all(fd, json, json_len) && load_send_all(fd, "\r\n", 2);
+  for (int i = 0; send_clips() && ok && i < count; i++) {
+    uint8_t wav[AUDIO_WAV_HEADER_BYTES];
+    audio_wav_build_clip_header(wav, s_opt.rate, (uint32_t)s_clip_frames);
+    len = event_part_header(part, sizeof(part), i, batch[i].seq);
+    ok = load_send_all(fd, part, (size_t)len) &&
+         load_send_all(fd, wav, sizeof(wav)) &&
+         load_send_all(fd, s_clip_pcm, clip_bytes - sizeof(wav)) &&
+         load_send_all(fd, "\r\n", 2);
+  }
+  ok = ok && load_send_all(fd, k_closing, sizeof(k_closing) - 1);
+  free(json_buf);
+  int status = -1;
+  if (ok) {
+    status = finish_request(fd);
+  } else if (fd >= 0) {
+    close(fd);
+  }
+  if (status >= 0) {
+    lat_add(&n->st.post_us, now_us() - t0);
+  }
+  if (ok) {
+    n->st.event_bytes += (uint64_t)total;
+  }
+  return status;
+}
+
+// Detections arrive as a Poisson process; the first of a batch waits up to
+// the linger time for more to join it. A failed batch is kept and resent
+// after the backoff, as without the flash log; detections that find the
+// queue full meanwhile are dropped.
+static void *event_node(void *arg) {
+  node_ctx *n = arg;
+  node_stats *st = &n->st;
+  const double mean_us = 60e6 / s_opt.events_per_min;
+  sim_event queue[LOAD_MAX_BATCH + EVENT_QUEUE_EVENTS];
+  const int queue_cap = s_opt.batch + EVENT_QUEUE_EVENTS;
+  int queued = 0;
+  uint32_t seq = 0;
+  uint32_t backoff_ms = EVENT_RETRY_MS;
+  int64_t next = n->start_us + (int64_t)(-log(1.0 - node_uniform(n)) * mean_us);
+  int64_t retry_at = 0;
+
+  for (;;) {
+    int64_t send_at = INT64_MAX;
+    if (queued >= s_opt.batch) {
+      send_at = retry_at > now_us() ? retry_at : now_us();
+    } else if (queued > 0) {
+      send_at = queue[0].detected_us + (int64_t)s_opt.linger_ms * 1000;
+      send_at = retry_at > send_at ? retry_at : send_at;
+    }
+    if (next < send_at && next < n->end_us) {
+      sleep_until_us(next);
+      st->events++;
+      if (queued < queue_cap) {
+        const int32_t level = 4000 + (int32_t)(node_rand(n) % 20000);
+        queue[queued++] = (sim_event){
+            .seq = seq,
+            .detected_us = next,
+            .peak_index =
+                (uint64_t)((next - n->start_us) * s_opt.rate / 1000000),
+            .level_left = level,
+            .level_right = level - 300,
+        };
+      } else {
+        st->events_dropped++;
+      }
+      seq++;
+      next += (int64_t)(-log(1.0 - node_uniform(n)) * mean_us);
+      continue;
+    }
+    if (queued == 0 || retry_at > n->end_us) {
+      break;
+    }
+    // What is still waiting at the end goes out at once.
+    sleep_until_us(send_at < n->end_us ? send_at : n->end_us);
+    const int count = queued < s_opt.batch ? queued : s_opt.batch;
+    const int status = event_post(n, queue, count);
+    status_add(&st->posts, status);
+    if (status >= 200 && status < 300) {
+      const int64_t done = now_us();
+      for (int i = 0; i < count; i++) {
+        lat_add(&st->deliver_us, done - queue[i].detected_us);
+      }
+      st->delivered += (uint64_t)count;
+      queued -= count;
+      memmove(queue, queue + count, (size_t)queued * sizeof(queue[0]));
+      backoff_ms = EVENT_RETRY_MS;
+      retry_at = 0;
+    } else {
+      retry_at = now_us() + (int64_t)backoff_ms * 1000;
+      backoff_ms = backoff_ms >= EVENT_RETRY_MAX_MS / 2 ? EVENT_RETRY_MAX_MS
+                                                        : backoff_ms * 2;
+    }
+  }
+  st->events_dropped += (uint64_t)queued;
+  return NULL;
+}
+
+// ---------------------------------------------------------------- report
+
+static int cmp_u32(const void *a, const void *b) {
+  const uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static void print_lat(const char *name, lat_log *l) {
+  if (l->n == 0) {
+    printf("  %-10s -\n", name);
+    return;
+  }
+  qsort(l->v, l->n, sizeof(l->v[0]), cmp_u32);
+  const double q[] = {0.5, 0.9, 0.99};
+  printf("  %-10s", name);
+  for (size_t i = 0; i < sizeof(q) / sizeof(q[0]); i++) {
+    const double ms = l->v[(size_t)(q[i] * (double)(l->n - 1))] / 1000.0;
+    printf(" p%g %.2f", q[i] * 100, ms);
+  }
+  printf(" max %.2f ms (%zu)\n", l->v[l->n - 1] / 1000.0, l->n);
+}
+
+static void print_status(const char *name, const status_counts *c) {
+  printf("  %-10s %" PRIu64 " 2xx, %" PRIu64 " 4xx, %" PRIu64
+         " 5xx, %" PRIu64 " transport errors\n",
+         name, c->ok, c->client, c->server, c->transport);
+}
+
+static void status_merge(status_counts *into, const status_counts *from) {
+  into->ok += from->ok;
+  into->client += from->client;
+  into->server += from->server;
+  into->transport += from->transport;
+}
+
+static double rate_of(uint64_t bytes, double seconds) {
+  return seconds > 0 ? bytes * 8 / seconds / 1e6 : 0;
+}
+
+// ---------------------------------------------------------------- options
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "Simulates nodes pushing the firmware's audio stream and event\n"
+          "uploads at one backend and reports its latency and error rates.\n"
+          "  --url URL           upload URL, http:// only; {node} is replaced\n"
+          "                      by the node number\n"
+          "  --self-sink         run a local sink and target it instead\n"
+          "  --sink-delay-us US  hold each sink answer back (0)\n"
+          "  --nodes N           simulated nodes (%d)\n"
+          "  --seconds S         run time (%g)\n"
+          "  --ramp S            spread the node starts over S seconds (%g)\n"
+          "  --mode MODE         push, events or both (both)\n"
+          "  --rate HZ           capture rate (%d)\n"
+          "  --adpcm             encode the stream to IMA ADPCM\n"
+          "  --channels NAME     stream channels: stereo, left, right, mono\n"
+          "  --decimation M      stream decimation, 1..%d (1)\n"
+          "  --jitter-ms MS      extra delay per chunk, uniform 0..MS (%g)\n"
+          "  --coalesce N        chunks per HTTP chunk (%d)\n"
+          "  --pool N            chunks queued before a stall drops audio "
+          "(%d)\n"
+          "  --segment-s S       end each upload after S seconds, 0 never "
+          "(%g)\n"
+          "  --events-per-min R  mean detections per node (%g)\n"
+          "  --batch N           events per POST, 1..%d (%d)\n"
+          "  --linger-ms MS      wait for a batch to fill (%d)\n"
+          "  --payload NAME      clip, features or both (both)\n"
+          "  --expect-ok         exit 1 on any failed request, or when an\n"
+          "                      enabled mode never got a 2xx\n",
+          argv0, s_opt.nodes, s_opt.seconds, s_opt.ramp_s, s_opt.rate,
+          AUDIO_SHAPER_MAX_DECIMATION, s_opt.jitter_ms, s_opt.coalesce,
+          s_opt.pool, s_opt.segment_s, s_opt.events_per_min, LOAD_MAX_BATCH,
+          s_opt.batch, s_opt.linger_ms);
+}
+
+static bool parse_args(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+    bool used = true;
+    if (strcmp(a, "--self-sink") == 0) {
+      s_opt.self_sink = true;
+      used = false;
+    } else if (strcmp(a, "--adpcm") == 0) {
+      s_opt.adpcm = true;
+      used = false;
+    } else if (strcmp(a, "--expect-ok") == 0) {
+      s_opt.expect_ok = true;
+      used = false;
+    } else if (!v) {
+      return false;
+    } else if (strcmp(a, "--url") == 0) {
+      s_opt.url = v;
+    } else if (strcmp(a, "--sink-delay-us") == 0) {
+      s_opt.sink_delay_us = atoi(v);
+    } else if (strcmp(a, "--nodes") == 0) {
+      s_opt.nodes = atoi(v);
+    } else if (strcmp(a, "--seconds") == 0) {
+      s_opt.seconds = atof(v);
+    } else if (strcmp(a, "--ramp") == 0) {
+      s_opt.ramp_s = atof(v);
+    } else if (strcmp(a, "--mode") == 0) {
+      s_opt.stream = strcmp(v, "events") != 0;
+      s_opt.events = strcmp(v, "push") != 0;
+      if (strcmp(v, "push") && strcmp(v, "events") && strcmp(v, "both")) {
+        return false;
+      }
+    } else if (strcmp(a, "--rate") == 0) {
+      s_opt.rate = atoi(v);
+    } else if (strcmp(a, "--channels") == 0) {
+      if (!audio_shaper_parse_channels(v, &s_opt.channels)) {
+        return false;
+      }
+    } else if (strcmp(a, "--decimation") == 0) {
+      s_opt.decimation = atoi(v);
+    } else if (strcmp(a, "--jitter-ms") == 0) {
+      s_opt.jitter_ms = atof(v);
+    } else if (strcmp(a, "--coalesce") == 0) {
+      s_opt.coalesce = atoi(v);
+    } else if (strcmp(a, "--pool") == 0) {
+      s_opt.pool = atoi(v);
+    } else if (strcmp(a, "--segment-s") == 0) {
+      s_opt.segment_s = atof(v);
+    } else if (strcmp(a, "--events-per-min") == 0) {
+      s_opt.events_per_min = atof(v);
+    } else if (strcmp(a, "--batch") == 0) {
+      s_opt.batch = atoi(v);
+    } else if (strcmp(a, "--linger-ms") == 0) {
+      s_opt.linger_ms = atoi(v);
+    } else if (strcmp(a, "--payload") == 0) {
+      if (strcmp(v, "clip") == 0) {
+        s_opt.payload = PAYLOAD_CLIP;
+      } else if (strcmp(v, "features") == 0) {
+        s_opt.payload = PAYLOAD_FEATURES;
+      } else if (strcmp(v, "both") == 0) {
+        s_opt.payload = PAYLOAD_BOTH;
+      } else {
+        return false;
+      }
+    } else {
+      return false;
+    }
+    i += used;
+  }
+  return (s_opt.url || s_opt.self_sink) && s_opt.nodes > 0 &&
+         s_opt.seconds > 0 && s_opt.ramp_s >= 0 && s_opt.rate >= 8000 &&
+         s_opt.decimation >= 1 &&
+         s_opt.decimation <= AUDIO_SHAPER_MAX_DECIMATION &&
+         s_opt.jitter_ms >= 0 && s_opt.coalesce >= 1 && s_opt.pool >= 1 &&
+         s_opt.events_per_min > 0 && s_opt.batch >= 1 &&
+         s_opt.batch <= LOAD_MAX_BATCH && s_opt.linger_ms >= 0;
+}
+
+// Substitutes the node number for "{node}".
+static bool node_url(const char *tmpl, int id, load_url *out) {
+  char url[LOAD_URL_HOST_MAX + LOAD_URL_PATH_MAX + 16];
+  const char *mark = strstr(tmpl, "{node}");
+  if (mark) {
+    snprintf(url, sizeof(url), "%.*s%d%s", (int)(mark - tmpl), tmpl, id,
+             mark + 6);
+  } else {
+    snprintf(url, sizeof(url), "%s", tmpl);
+  }
+  return load_url_parse(url, out);
+}
+
+int main(int argc, char **argv) {
+  if (!parse_args(argc, argv)) {
+    usage(argv[0]);
+    return 2;
+  }
+  char sink_url[64];
+  if (s_opt.self_sink) {
+    const int port = load_sink_start(0, s_opt.sink_delay_us);
+    if (port < 0) {
+      fprintf(stderr, "cannot start the sink\n");
+      return 1;
+    }
+    snprintf(sink_url, sizeof(sink_url), "http://127.0.0.1:%d/ingest", port);
+    s_opt.url = sink_url;
+  }
+
+  s_clip_frames = s_opt.rate * (EVENT_PRE_MS + EVENT_POST_MS) / 1000;
+  s_clip_pcm = malloc((size_t)s_clip_frames * 2 * sizeof(int16_t));
+  int32_t *dma = malloc((size_t)s_clip_frames * 2 * sizeof(int32_t));
+  if (!s_clip_pcm || !dma) {
+    return 1;
+  }
+  mic_synth synth;
+  mic_synth_init(&synth, s_opt.rate, EVENT_PRE_MS + EVENT_POST_MS,
+                 EVENT_PRE_MS * 1000, 16000, 64, 5);
+  mic_synth_fill(&synth, dma, s_clip_frames);
+  for (int i = 0; i < s_clip_frames; i++) {
+    s_clip_pcm[2 * i] = (int16_t)(dma[2 * i + 1] >> 16);
+    s_clip_pcm[2 * i + 1] = (int16_t)(dma[2 * i] >> 16);
+  }
+  free(dma);
+
+  node_ctx *nodes = calloc((size_t)s_opt.nodes, sizeof(*nodes));
+  pthread_t *threads = calloc((size_t)s_opt.nodes * 2, sizeof(*threads));
+  bool *started = calloc((size_t)s_opt.nodes * 2, sizeof(*started));
+  if (!nodes || !threads || !started) {
+    return 1;
+  }
+  s_run_start_us = now_us();
+  const int64_t end_us = s_run_start_us + (int64_t)(s_opt.seconds * 1e6);
+  for (int i = 0; i < s_opt.nodes; i++) {
+    node_ctx *n = &nodes[i];
+    n->id = i;
+    n->seed = 0x9E3779B9u * (uint32_t)(i + 1);
+    if (!node_url(s_opt.url, i, &n->url)) {
+      fprintf(stderr, "bad URL %s (http:// only)\n", s_opt.url);
+      return 2;
+    }
+    n->start_us = s_run_start_us +
+                  (int64_t)(s_opt.ramp_s * 1e6 * i / s_opt.nodes);
+    n->end_us = end_us;
+  }
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, LOAD_NODE_STACK);
+  int launched = 0;
+  for (int i = 0; i < s_opt.nodes; i++) {
+    if (s_opt.stream) {
+      started[2 * i] =
+          pthread_create(&threads[2 * i], &attr, stream_node, &nodes[i]) == 0;
+      launched += started[2 * i];
+    }
+    if (s_opt.events) {
+      started[2 * i + 1] = pthread_create(&threads[2 * i + 1], &attr,
+                                          event_node, &nodes[i]) == 0;
+      launched += started[2 * i + 1];
+    }
+  }
+  for (int i = 0; i < 2 * s_opt.nodes; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+  const double elapsed = (now_us() - s_run_start_us) / 1e6;
+
+  node_stats total = {0};
+  for (int i = 0; i < s_opt.nodes; i++) {
+    const node_stats *st = &nodes[i].st;
+    lat_merge(&total.write_us, &st->write_us);
+    lat_merge(&total.queue_us, &st->queue_us);
+    lat_merge(&total.ack_us, &st->ack_us);
+    lat_merge(&total.post_us, &st->post_us);
+    lat_merge(&total.deliver_us, &st->deliver_us);
+    status_merge(&total.uploads, &st->uploads);
+    status_merge(&total.posts, &st->posts);
+    total.writes += st->writes;
+    total.stream_bytes += st->stream_bytes;
+    total.chunks += st->chunks;
+    total.dropped += st->dropped;
+    total.gaps += st->gaps;
+    total.events += st->events;
+    total.delivered += st->delivered;
+    total.events_dropped += st->events_dropped;
+    total.event_bytes += st->event_bytes;
+  }
+
+  printf("%d nodes (%d threads) for %.1f s against %s\n", s_opt.nodes,
+         launched, elapsed, s_opt.url);
+  if (s_opt.stream) {
+    printf("stream: %s %s, %d Hz, %d chunk(s) per write, %g s uploads\n",
+           s_opt.adpcm ? "adpcm" : "pcm",
+           audio_shaper_channels_name(s_opt.channels),
+           s_opt.rate / s_opt.decimation, s_opt.coalesce, s_opt.segment_s);
+    printf("  %" PRIu64 " chunks in %" PRIu64 " writes, %.2f Mbit/s; %" PRIu64
+           " chunks dropped in %" PRIu64 " gaps\n",
+           total.chunks, total.writes,
+           rate_of(total.stream_bytes, elapsed), total.dropped, total.gaps);
+    print_status("uploads", &total.uploads);
+    print_lat("write", &total.write_us);
+    print_lat("queue", &total.queue_us);
+    print_lat("ack", &total.ack_us);
+  }
+  if (s_opt.events) {
+    printf("events: %g/min per node, batches of %d, %d ms linger, "
+           "payload %s\n",
+           s_opt.events_per_min, s_opt.batch, s_opt.linger_ms,
+           s_opt.payload == PAYLOAD_CLIP       ? "clip"
+           : s_opt.payload == PAYLOAD_FEATURES ? "features"
+                                               : "both");
+    printf("  %" PRIu64 " detected, %" PRIu64 " delivered, %" PRIu64
+           " dropped; %.2f Mbit/s\n",
+           total.events, total.delivered, total.events_dropped,
+           rate_of(total.event_bytes, elapsed));
+    print_status("posts", &total.posts);
+    print_lat("post", &total.post_us);
+    print_lat("deliver", &total.deliver_us);
+  }
+  if (s_opt.self_sink) {
+    load_sink_stats sink;
+    load_sink_get_stats(&sink);
+    printf("sink: %" PRIu64 " requests, %" PRIu64 " bytes, %" PRIu64
+           " errors\n",
+           sink.requests, sink.bytes, sink.errors);
+  }
+
+  int rc = 0;
+  if (s_opt.expect_ok &&
+      (status_failed(&total.uploads) || status_failed(&total.posts) ||
+       (s_opt.stream && total.uploads.ok == 0) ||
+       (s_opt.events && total.posts.ok == 0))) {
+    fprintf(stderr, "failed requests or a mode without a 2xx\n");
+    rc = 1;
+  }
+  free(nodes);
+  free(threads);
+  free(started);
+  free(s_clip_pcm);
+  return rc;
+}
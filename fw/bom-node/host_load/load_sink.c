@@ -0,0 +1,102 @@
+#include "load_sink.h"
+#include "load_http.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int s_listen = -1;
+static int s_delay_us = 0;
+static _Atomic uint64_t s_requests = 0;
+static _Atomic uint64_t s_bytes = 0;
+static _Atomic uint64_t s_errors = 0;
+
+static const char k_answer[] =
+    "HTTP/1.1 204 No Content\r\nContent-Length: 0\r\n\r\n";
+
+static void *sink_conn(void *arg) {
+  const int fd = (int)(intptr_t)arg;
+  load_reader *r = malloc(sizeof(*r));
+  if (r) {
+    load_reader_init(r, fd);
+    char line[512];
+    load_message msg;
+    // Keep-alive: requests follow each other until the client closes.
+    while (load_read_head(r, false, &msg, line, sizeof(line))) {
+      const int64_t body = load_read_body(r, &msg);
+      if (body < 0) {
+        atomic_fetch_add(&s_errors, 1);
+        break;
+      }
+      if (s_delay_us > 0) {
+        usleep((useconds_t)s_delay_us);
+      }
+      atomic_fetch_add(&s_requests, 1);
+      atomic_fetch_add(&s_bytes, (uint64_t)body);
+      if (!load_send_all(fd, k_answer, sizeof(k_answer) - 1)) {
+        break;
+      }
+    }
+    free(r);
+  }
+  close(fd);
+  return NULL;
+}
+
+static void *sink_accept(void *arg) {
+  (void)arg;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  pthread_attr_setstacksize(&attr, 64 * 1024);
+  for (;;) {
+    const int fd = accept(s_listen, NULL, NULL);
+    if (fd < 0) {
+      continue;
+    }
+    pthread_t t;
+    if (pthread_create(&t, &attr, sink_conn, (void *)(intptr_t)fd) != 0) {
+      close(fd);
+    }
+  }
+  return NULL;
+}
+
+int load_sink_start(int port, int delay_us) {
+  s_delay_us = delay_us;
+  s_listen = socket(AF_INET, SOCK_STREAM, 0);
+  if (s_listen < 0) {
+    return -1;
+  }
+  const int one = 1;
+  setsockopt(s_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr = {
+      .sin_family = AF_INET,
+      .sin_port = htons((uint16_t)port),
+      .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+  };
+  socklen_t len = sizeof(addr);
+  pthread_t t;
+  if (bind(s_listen, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(s_listen, 512) != 0 ||
+      getsockname(s_listen, (struct sockaddr *)&addr, &len) != 0 ||
+      pthread_create(&t, NULL, sink_accept, NULL) != 0) {
+    close(s_listen);
+    s_listen = -1;
+    return -1;
+  }
+  pthread_detach(t);
+  return ntohs(addr.sin_port);
+}
+
+void load_sink_get_stats(load_sink_stats *out) {
+  out->requests = atomic_load(&s_requests);
+  out->bytes = atomic_load(&s_bytes);
+  out->errors = atomic_load(&s_errors);
+}
@@ -0,0 +1,23 @@
+#ifndef LOAD_SINK_H
+#define LOAD_SINK_H
+
+#include <stdint.h>
+
+// A loopback HTTP server that takes any POST, drains its body and answers
+// 204, one thread per connection, keeping connections alive. It stands in
+// for the backend so the generator can be run (and smoke-tested) on its own;
+// its figures are the client side's ceiling, not the backend's.
+
+typedef struct {
+  uint64_t requests;
+  uint64_t bytes;
+  uint64_t errors; // malformed requests or connections cut mid-body
+} load_sink_stats;
+
+// Listens on 127.0.0.1 at `port` (0 picks one) and returns the port, or -1.
+// Each answer is held back by `delay_us`, to stand in for a slow backend.
+int load_sink_start(int port, int delay_us);
+
+void load_sink_get_stats(load_sink_stats *out);
+
+#endif
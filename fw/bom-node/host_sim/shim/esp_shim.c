@@ -0,0 +1,76 @@
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+int64_t esp_timer_get_time(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+const char *esp_err_to_name(esp_err_t err) {
+  switch (err) {
+  case ESP_OK:
+    return "ESP_OK";
+  case ESP_FAIL:
+    return "ESP_FAIL";
+  case ESP_ERR_NO_MEM:
+    return "ESP_ERR_NO_MEM";
+  case ESP_ERR_INVALID_ARG:
+    return "ESP_ERR_INVALID_ARG";
+  case ESP_ERR_INVALID_STATE:
+    return "ESP_ERR_INVALID_STATE";
+  case ESP_ERR_INVALID_SIZE:
+    return "ESP_ERR_INVALID_SIZE";
+  case ESP_ERR_NOT_FOUND:
+    return "ESP_ERR_NOT_FOUND";
+  case ESP_ERR_NOT_SUPPORTED:
+    return "ESP_ERR_NOT_SUPPORTED";
+  case ESP_ERR_TIMEOUT:
+    return "ESP_ERR_TIMEOUT";
+  default:
+    return "ESP_ERR_UNKNOWN";
+  }
+}
+
+static int log_rank(char level) {
+  switch (level) {
+  case 'E':
+    return 1;
+  case 'W':
+    return 2;
+  case 'I':
+    return 3;
+  default:
+    return 4;
+  }
+}
+
+static int s_log_max;
+static pthread_once_t s_log_once = PTHREAD_ONCE_INIT;
+
+static void log_init(void) {
+  const char *env = getenv("SIM_LOG");
+  s_log_max = log_rank(env && *env ? *env : 'W');
+}
+
+void sim_log(char level, const char *tag, const char *fmt, ...) {
+  pthread_once(&s_log_once, log_init);
+  if (log_rank(level) > s_log_max) {
+    return;
+  }
+  // One fprintf per line keeps lines from different tasks whole.
+  char line[256];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(line, sizeof(line), fmt, ap);
+  va_end(ap);
+  fprintf(stderr, "%c (%lld) %s: %s\n", level,
+          (long long)(esp_timer_get_time() / 1000), tag, line);
+}
@@ -0,0 +1,376 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TASK_NAME_LEN 16
+
+// Every task and queue state change happens under one lock, as under the
+// FreeRTOS scheduler lock, so sim_wait_idle() sees a consistent picture of
+// who is blocked.
+static pthread_mutex_t s_kernel = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_idle_cond;
+static pthread_once_t s_kernel_once = PTHREAD_ONCE_INIT;
+
+struct sim_task {
+  pthread_t thread;
+  TaskFunction_t fn;
+  void *arg;
+  char name[TASK_NAME_LEN];
+  UBaseType_t priority;
+  BaseType_t core;
+  struct sim_task *next;
+  // Task notification value, as a counting semaphore.
+  pthread_cond_t cond;
+  uint32_t notify;
+  // What the task is blocked on: it has work once ready(ready_arg) holds.
+  bool waiting;
+  bool (*ready)(void *);
+  void *ready_arg;
+};
+
+struct sim_queue {
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+  UBaseType_t length;
+  UBaseType_t item_size;
+  UBaseType_t count;
+  UBaseType_t head;
+  uint8_t *items; // NULL for a counting queue
+};
+
+static _Thread_local struct sim_task *s_current;
+static struct sim_task *s_tasks;
+
+static void cond_init(pthread_cond_t *cond) {
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(cond, &attr);
+  pthread_condattr_destroy(&attr);
+}
+
+static void kernel_init(void) { cond_init(&s_idle_cond); }
+
+// Links a new task in; the kernel lock is held.
+static struct sim_task *task_new(const char *name, UBaseType_t priority,
+                                 BaseType_t core) {
+  pthread_once(&s_kernel_once, kernel_init);
+  struct sim_task *t = calloc(1, sizeof(*t));
+  if (!t) {
+    return NULL;
+  }
+  snprintf(t->name, sizeof(t->name), "%s", name ? name : "");
+  t->priority = priority;
+  t->core = core;
+  cond_init(&t->cond);
+  t->next = s_tasks;
+  s_tasks = t;
+  return t;
+}
+
+static void task_unlink(struct sim_task *t) {
+  for (struct sim_task **p = &s_tasks; *p; p = &(*p)->next) {
+    if (*p == t) {
+      *p = t->next;
+      break;
+    }
+  }
+  pthread_cond_broadcast(&s_idle_cond);
+}
+
+static struct sim_task *current_locked(void) {
+  if (!s_current) {
+    // A thread that was not created as a task, such as main().
+    s_current = task_new("main", 1, 0);
+    if (!s_current) {
+      abort();
+    }
+    s_current->thread = pthread_self();
+  }
+  return s_current;
+}
+
+// Absolute CLOCK_MONOTONIC deadline `ticks` from now.
+static struct timespec deadline_after(TickType_t ticks) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  const uint64_t ns = (uint64_t)ticks * (1000000000ull / configTICK_RATE_HZ);
+  ts.tv_sec += (time_t)(ns / 1000000000ull);
+  ts.tv_nsec += (long)(ns % 1000000000ull);
+  if (ts.tv_nsec >= 1000000000L) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000L;
+  }
+  return ts;
+}
+
+// Blocks on `cond` until `ready` holds or `ticks` pass; the kernel lock is
+// held. Returns whether `ready` holds.
+static bool wait_until(pthread_cond_t *cond, bool (*ready)(void *), void *arg,
+                       TickType_t ticks) {
+  if (ready(arg)) {
+    return true;
+  }
+  struct sim_task *self = current_locked();
+  self->waiting = true;
+  self->ready = ready;
+  self->ready_arg = arg;
+  pthread_cond_broadcast(&s_idle_cond);
+  bool ok = true;
+  if (ticks == portMAX_DELAY) {
+    while (!ready(arg)) {
+      pthread_cond_wait(cond, &s_kernel);
+    }
+  } else {
+    const struct timespec until = deadline_after(ticks);
+    while (!ready(arg)) {
+      if (pthread_cond_timedwait(cond, &s_kernel, &until) == ETIMEDOUT) {
+        ok = ready(arg);
+        break;
+      }
+    }
+  }
+  self->waiting = false;
+  return ok;
+}
+
+static bool task_idle(const struct sim_task *t) {
+  return t->waiting && !t->ready(t->ready_arg);
+}
+
+static bool others_idle(void *arg) {
+  const struct sim_task *self = arg;
+  for (const struct sim_task *t = s_tasks; t; t = t->next) {
+    if (t != self && !task_idle(t)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void sim_wait_idle(void) {
+  pthread_mutex_lock(&s_kernel);
+  struct sim_task *self = current_locked();
+  while (!others_idle(self)) {
+    pthread_cond_wait(&s_idle_cond, &s_kernel);
+  }
+  pthread_mutex_unlock(&s_kernel);
+}
+
+static void *task_entry(void *arg) {
+  struct sim_task *t = arg;
+  s_current = t;
+  pthread_setname_np(pthread_self(), t->name);
+  t->fn(t->arg);
+  // FreeRTOS tasks must not return; the ones here end in vTaskDelete(NULL).
+  return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                   uint32_t stack, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *out,
+                                   BaseType_t core) {
+  pthread_mutex_lock(&s_kernel);
+  struct sim_task *t = task_new(name, priority, core);
+  pthread_mutex_unlock(&s_kernel);
+  if (!t) {
+    return pdFAIL;
+  }
+  t->fn = fn;
+  t->arg = arg;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  // Stack depths are in bytes on ESP-IDF. Sanitizers need far more than the
+  // firmware does, so they only set a floor.
+  size_t bytes = stack < 256 * 1024 ? 256 * 1024 : stack;
+  pthread_attr_setstacksize(&attr, bytes);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if (out) {
+    // Set before the task runs: it may be notified straight away.
+    *out = t;
+  }
+  const int rc = pthread_create(&t->thread, &attr, task_entry, t);
+  pthread_attr_destroy(&attr);
+  if (rc != 0) {
+    if (out) {
+      *out = NULL;
+    }
+    pthread_mutex_lock(&s_kernel);
+    task_unlink(t);
+    pthread_mutex_unlock(&s_kernel);
+    free(t);
+    return pdFAIL;
+  }
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (task == NULL || task == s_current) {
+    pthread_mutex_lock(&s_kernel);
+    task_unlink(s_current);
+    pthread_mutex_unlock(&s_kernel);
+    // The handle stays allocated: others may still hold it.
+    pthread_exit(NULL);
+  }
+  // Deleting another task is not needed by the modules built here.
+  abort();
+}
+
+static bool never(void *arg) {
+  (void)arg;
+  return false;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  if (ticks == 0) {
+    sched_yield();
+    return;
+  }
+  pthread_mutex_lock(&s_kernel);
+  // A delayed task counts as blocked for sim_wait_idle().
+  wait_until(&current_locked()->cond, never, NULL, ticks);
+  pthread_mutex_unlock(&s_kernel);
+}
+
+TickType_t xTaskGetTickCount(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  const uint64_t ms = (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+  return (TickType_t)(ms * configTICK_RATE_HZ / 1000u);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+  pthread_mutex_lock(&s_kernel);
+  struct sim_task *t = current_locked();
+  pthread_mutex_unlock(&s_kernel);
+  return t;
+}
+
+const char *pcTaskGetName(TaskHandle_t task) {
+  if (!task) {
+    task = xTaskGetCurrentTaskHandle();
+  }
+  return task->name;
+}
+
+BaseType_t xPortGetCoreID(void) {
+  const struct sim_task *t = s_current;
+  return t && t->core >= 0 ? t->core : 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  pthread_mutex_lock(&s_kernel);
+  task->notify++;
+  pthread_cond_signal(&task->cond);
+  pthread_mutex_unlock(&s_kernel);
+  return pdPASS;
+}
+
+static bool notified(void *arg) {
+  return ((struct sim_task *)arg)->notify != 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+  pthread_mutex_lock(&s_kernel);
+  struct sim_task *t = current_locked();
+  wait_until(&t->cond, notified, t, ticks);
+  const uint32_t value = t->notify;
+  if (value != 0) {
+    t->notify = clear ? 0 : value - 1;
+  }
+  pthread_mutex_unlock(&s_kernel);
+  return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+  struct sim_queue *q = calloc(1, sizeof(*q));
+  if (!q) {
+    return NULL;
+  }
+  if (item_size > 0) {
+    q->items = calloc(length, item_size);
+    if (!q->items) {
+      free(q);
+      return NULL;
+    }
+  }
+  q->length = length;
+  q->item_size = item_size;
+  cond_init(&q->not_empty);
+  cond_init(&q->not_full);
+  return q;
+}
+
+QueueHandle_t sim_semaphore_counting(UBaseType_t max, UBaseType_t initial) {
+  struct sim_queue *q = xQueueCreate(max, 0);
+  if (q) {
+    q->count = initial;
+  }
+  return q;
+}
+
+void vQueueDelete(QueueHandle_t q) {
+  if (!q) {
+    return;
+  }
+  pthread_cond_destroy(&q->not_empty);
+  pthread_cond_destroy(&q->not_full);
+  free(q->items);
+  free(q);
+}
+
+static bool queue_has_room(void *arg) {
+  const struct sim_queue *q = arg;
+  return q->count < q->length;
+}
+
+static bool queue_has_item(void *arg) {
+  return ((const struct sim_queue *)arg)->count > 0;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks) {
+  pthread_mutex_lock(&s_kernel);
+  if (!wait_until(&q->not_full, queue_has_room, q, ticks)) {
+    pthread_mutex_unlock(&s_kernel);
+    return pdFALSE;
+  }
+  if (q->items) {
+    const UBaseType_t tail = (q->head + q->count) % q->length;
+    memcpy(q->items + (size_t)tail * q->item_size, item, q->item_size);
+  }
+  q->count++;
+  pthread_cond_signal(&q->not_empty);
+  pthread_mutex_unlock(&s_kernel);
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks) {
+  pthread_mutex_lock(&s_kernel);
+  if (!wait_until(&q->not_empty, queue_has_item, q, ticks)) {
+    pthread_mutex_unlock(&s_kernel);
+    return pdFALSE;
+  }
+  if (q->items) {
+    memcpy(item, q->items + (size_t)q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->length;
+  }
+  q->count--;
+  pthread_cond_signal(&q->not_full);
+  pthread_mutex_unlock(&s_kernel);
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+  pthread_mutex_lock(&s_kernel);
+  const UBaseType_t n = q->count;
+  pthread_mutex_unlock(&s_kernel);
+  return n;
+}
@@ -0,0 +1,37 @@
+#ifndef SIM_ESP_HEAP_CAPS_H
+#define SIM_ESP_HEAP_CAPS_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MALLOC_CAP_8BIT (1u << 2)
+#define MALLOC_CAP_DMA (1u << 3)
+#define MALLOC_CAP_SPIRAM (1u << 10)
+#define MALLOC_CAP_INTERNAL (1u << 11)
+
+static inline void *heap_caps_malloc(size_t size, unsigned caps) {
+  (void)caps;
+  return malloc(size);
+}
+static inline void *heap_caps_calloc(size_t n, size_t size, unsigned caps) {
+  (void)caps;
+  return calloc(n, size);
+}
+static inline void *heap_caps_aligned_alloc(size_t align, size_t size,
+                                            unsigned caps) {
+  (void)caps;
+  // aligned_alloc wants a multiple of the alignment.
+  return aligned_alloc(align, (size + align - 1) / align * align);
+}
+static inline void heap_caps_free(void *p) { free(p); }
+static inline size_t heap_caps_get_free_size(unsigned caps) {
+  (void)caps;
+  return 0;
+}
+static inline size_t heap_caps_get_largest_free_block(unsigned caps) {
+  (void)caps;
+  return 0;
+}
+
+#endif
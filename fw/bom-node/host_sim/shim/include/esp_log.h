@@ -0,0 +1,15 @@
+#ifndef SIM_ESP_LOG_H
+#define SIM_ESP_LOG_H
+
+// Lines go to stderr, so stdout carries only the run's results. SIM_LOG
+// (environment: E, W, I or D) sets the level; the default is W.
+void sim_log(char level, const char *tag, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, fmt, ...) sim_log('E', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) sim_log('W', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) sim_log('I', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) sim_log('D', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) ((void)0)
+
+#endif
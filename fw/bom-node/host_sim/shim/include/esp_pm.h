@@ -0,0 +1,28 @@
+#ifndef SIM_ESP_PM_H
+#define SIM_ESP_PM_H
+
+#include "esp_err.h"
+
+// No power management: lock creation fails, as without CONFIG_PM_ENABLE.
+typedef struct sim_pm_lock *esp_pm_lock_handle_t;
+typedef enum { ESP_PM_CPU_FREQ_MAX, ESP_PM_APB_FREQ_MAX, ESP_PM_NO_LIGHT_SLEEP } esp_pm_lock_type_t;
+
+static inline esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg,
+                                           const char *name,
+                                           esp_pm_lock_handle_t *out) {
+  (void)type;
+  (void)arg;
+  (void)name;
+  *out = NULL;
+  return ESP_ERR_NOT_SUPPORTED;
+}
+static inline esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t h) {
+  (void)h;
+  return ESP_OK;
+}
+static inline esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t h) {
+  (void)h;
+  return ESP_OK;
+}
+
+#endif
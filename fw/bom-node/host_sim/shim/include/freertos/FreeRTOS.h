@@ -0,0 +1,54 @@
+#ifndef SIM_FREERTOS_H
+#define SIM_FREERTOS_H
+
+// FreeRTOS on POSIX threads, for the host pipeline build. Only what the
+// firmware sources compiled there use. Tasks are threads: priorities and
+// core pinning are recorded but not enforced, so tasks that would take
+// turns on one core run in parallel here.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffu)
+
+#define configTICK_RATE_HZ CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)                                                      \
+  ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000u))
+
+// Critical sections are one recursive mutex per portMUX, which also lets
+// ThreadSanitizer see the ordering they provide.
+typedef struct {
+  pthread_mutex_t mu;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP}
+#define portENTER_CRITICAL(m) pthread_mutex_lock(&(m)->mu)
+#define portEXIT_CRITICAL(m) pthread_mutex_unlock(&(m)->mu)
+#define portENTER_CRITICAL_ISR(m) portENTER_CRITICAL(m)
+#define portEXIT_CRITICAL_ISR(m) portEXIT_CRITICAL(m)
+#define portENTER_CRITICAL_SAFE(m) portENTER_CRITICAL(m)
+#define portEXIT_CRITICAL_SAFE(m) portEXIT_CRITICAL(m)
+static inline void spinlock_initialize(portMUX_TYPE *m) {
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&m->mu, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+
+BaseType_t xPortGetCoreID(void);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef SIM_SEMPHR_H
+#define SIM_SEMPHR_H
+
+#include "freertos/queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#define xSemaphoreCreateBinary() xQueueCreate(1, 0)
+#define xSemaphoreCreateCounting(max, initial) sim_semaphore_counting(max, initial)
+#define xSemaphoreCreateMutex() xQueueCreate(1, 0)
+#define xSemaphoreGive(s) xQueueSend((s), NULL, 0)
+#define xSemaphoreTake(s, ticks) xQueueReceive((s), NULL, (ticks))
+#define vSemaphoreDelete(s) vQueueDelete(s)
+
+QueueHandle_t sim_semaphore_counting(UBaseType_t max, UBaseType_t initial);
+
+#endif
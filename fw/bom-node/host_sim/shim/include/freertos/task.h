@@ -0,0 +1,33 @@
+#ifndef SIM_TASK_H
+#define SIM_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct sim_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                   uint32_t stack, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *out,
+                                   BaseType_t core);
+static inline BaseType_t xTaskCreate(TaskFunction_t fn, const char *name,
+                                     uint32_t stack, void *arg,
+                                     UBaseType_t priority, TaskHandle_t *out) {
+  return xTaskCreatePinnedToCore(fn, name, stack, arg, priority, out, -1);
+}
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+const char *pcTaskGetName(TaskHandle_t task);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+
+// Simulator only: returns once every other task is blocked with nothing to
+// do (waiting on an empty queue, a notification not yet given, or a delay).
+// A producer calling it before each step runs the pipeline in lockstep, so
+// no consumer falls behind however fast the producer is.
+void sim_wait_idle(void);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SIM_SDKCONFIG_H
+#define SIM_SDKCONFIG_H
+
+// The firmware's sdkconfig values for the modules the host pipeline is
+// built from (see ../../CMakeLists.txt). Keep them in step with
+// fw/bom-node/sdkconfig so the host profiles the configuration that ships.
+
+#define CONFIG_FREERTOS_HZ 100
+#define CONFIG_FREERTOS_NUMBER_OF_CORES 2
+
+// Task placement
+#define CONFIG_MIC_READER_TASK_CORE 0
+#define CONFIG_MIC_READER_TASK_PRIORITY 6
+#define CONFIG_IMPULSE_DETECTION_TASK_CORE 1
+#define CONFIG_IMPULSE_DETECTION_TASK_PRIORITY 5
+
+// Microphone
+#define CONFIG_MIC_DC_BLOCK_FREQ_HZ 100
+#define CONFIG_MIC_DC_FILTER_ONE_POLE 1
+#define CONFIG_MIC_GAIN_DB 0
+#define CONFIG_MIC_DC_CAL_CHUNKS 16
+#define CONFIG_MIC_DMA_DESC_NUM 14
+// The guarded values are overridden by variant builds (CMakeLists.txt).
+#ifndef CONFIG_MIC_HISTORY_MS
+#define CONFIG_MIC_HISTORY_MS 200
+#endif
+#define CONFIG_MIC_PRE_EVENT_MS 30
+#define CONFIG_MIC_POST_EVENT_MS 50
+// The simulator installs its own source (sim_source.c); the synthetic one
+// is the default so mic_source_default() links without the I2S driver.
+#define CONFIG_MIC_SOURCE_SYNTH 1
+#define CONFIG_MIC_SOURCE_WAV_PATH "replay.wav"
+#define CONFIG_MIC_SOURCE_WAV_LOOP 1
+#define CONFIG_MIC_SOURCE_SYNTH_PERIOD_MS 1000
+#define CONFIG_MIC_SOURCE_SYNTH_PEAK 16000
+#define CONFIG_MIC_SOURCE_SYNTH_DECAY_MS 5
+#define CONFIG_MIC_SOURCE_SYNTH_LAG_US 250
+#define CONFIG_MIC_SOURCE_SYNTH_NOISE 64
+
+// Audio arena
+#define CONFIG_AUDIO_ARENA_INTERNAL_KB 16
+#define CONFIG_AUDIO_ARENA_LARGE_KB 116
+
+// Impulse detection
+#define CONFIG_IMPULSE_DETECTION_GEOMETRIES "31x30 31x16"
+#ifndef CONFIG_IMPULSE_DETECTION_REFRACTORY_MS
+#define CONFIG_IMPULSE_DETECTION_REFRACTORY_MS 20
+#endif
+
+#endif
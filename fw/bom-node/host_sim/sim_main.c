@@ -0,0 +1,445 @@
+// Host build of the audio pipeline: the mic reader (DC tracking, DSP, ring,
+// taps, history, sample clock), the impulse detector and the streamer's
+// accumulate/shape/encode stages, fed from a WAV file or synthetic impulses
+// instead of I2S. See README.md.
+
+#include "audio_accum.h"
+#include "audio_arena.h"
+#include "audio_shaper.h"
+#include "audio_wav.h"
+#include "detector.h"
+#include "ima_adpcm.h"
+#include "median_detection.h"
+#include "metrics.h"
+#include "mic_history.h"
+#include "mic_input.h"
+#include "sim_source.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "SIM";
+
+// The streamer's chunking (audio_streamer.c).
+#define STREAM_CHUNK_FRAMES 480
+#define STREAM_BATCH_TAPS 16
+#define STREAM_POOL_CHUNKS 8
+#define STREAM_TASK_STACK 8192
+
+// Time the detector and the stream get to drain once the audio has ended:
+// longer than the post-event window the last event waits for.
+#define SIM_DRAIN_MS (MIC_POST_EVENT_MS + 250)
+
+typedef struct {
+  const char *wav_path;
+  double seconds;
+  bool realtime;
+  bool free_run;
+  bool loop;
+  int rate;
+  int period_ms;
+  int decimation;
+  audio_channel_mode channels;
+  bool adpcm;
+  const char *out_path;
+  bool metrics;
+  bool quiet;
+  long expect; // detections; -1 when not checked
+  int switch_rate; // 0: none
+} sim_options;
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [options] [file.wav]\n"
+          "Runs the audio pipeline on a 16-bit PCM WAV file, or on synthetic\n"
+          "impulses without one, and reports its throughput.\n"
+          "  --seconds S      stop after S seconds of audio (synth: 10)\n"
+          "  --realtime       deliver audio at the sample rate\n"
+          "  --free-run       read DMA-sized chunks without waiting for the\n"
+          "                   consumers, which may then drop audio\n"
+          "  --loop           replay the file until --seconds\n"
+          "  --rate HZ        synthetic sample rate (%d)\n"
+          "  --period MS      synthetic impulse spacing (%d)\n"
+          "  --switch-rate HZ reconfigure to this rate halfway through\n"
+          "  --decimation M   stream decimation, 1..%d (1)\n"
+          "  --channels NAME  stream channels: stereo, left, right, mono\n"
+          "  --adpcm          encode the stream to IMA ADPCM\n"
+          "  --out FILE       write the shaped PCM stream as WAV\n"
+          "  --metrics        print the metrics exposition at the end\n"
+          "  --quiet          do not print each event\n"
+          "  --expect N       exit 1 unless exactly N events were detected,\n"
+          "                   none of them without its window\n",
+          argv0, MIC_SAMPLING_FREQUENCY, CONFIG_MIC_SOURCE_SYNTH_PERIOD_MS,
+          AUDIO_SHAPER_MAX_DECIMATION);
+}
+
+static bool parse_args(int argc, char **argv, sim_options *o) {
+  *o = (sim_options){
+      .rate = MIC_SAMPLING_FREQUENCY,
+      .period_ms = CONFIG_MIC_SOURCE_SYNTH_PERIOD_MS,
+      .decimation = 1,
+      .channels = AUDIO_CHANNELS_STEREO,
+      .expect = -1,
+  };
+  for (int i = 1; i < argc; i++) {
+    const char *a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+    if (strcmp(a, "--realtime") == 0) {
+      o->realtime = true;
+    } else if (strcmp(a, "--free-run") == 0) {
+      o->free_run = true;
+    } else if (strcmp(a, "--loop") == 0) {
+      o->loop = true;
+    } else if (strcmp(a, "--adpcm") == 0) {
+      o->adpcm = true;
+    } else if (strcmp(a, "--metrics") == 0) {
+      o->metrics = true;
+    } else if (strcmp(a, "--quiet") == 0) {
+      o->quiet = true;
+    } else if (a[0] == '-' && a[1] == '-' && v == NULL) {
+      return false;
+    } else if (strcmp(a, "--seconds") == 0) {
+      o->seconds = atof(argv[++i]);
+    } else if (strcmp(a, "--rate") == 0) {
+      o->rate = atoi(argv[++i]);
+    } else if (strcmp(a, "--switch-rate") == 0) {
+      o->switch_rate = atoi(argv[++i]);
+    } else if (strcmp(a, "--period") == 0) {
+      o->period_ms = atoi(argv[++i]);
+    } else if (strcmp(a, "--decimation") == 0) {
+      o->decimation = atoi(argv[++i]);
+    } else if (strcmp(a, "--channels") == 0) {
+      if (!audio_shaper_parse_channels(argv[++i], &o->channels)) {
+        return false;
+      }
+    } else if (strcmp(a, "--out") == 0) {
+      o->out_path = argv[++i];
+    } else if (strcmp(a, "--expect") == 0) {
+      o->expect = atol(argv[++i]);
+    } else if (a[0] != '-' && !o->wav_path) {
+      o->wav_path = a;
+    } else {
+      return false;
+    }
+  }
+  if (o->seconds <= 0 && !o->wav_path) {
+    o->seconds = 10;
+  }
+  return o->rate > 0 && o->period_ms > 0 && o->switch_rate >= 0 &&
+         (o->switch_rate == 0 || o->seconds > 0) && o->decimation >= 1 &&
+         o->decimation <= AUDIO_SHAPER_MAX_DECIMATION;
+}
+
+// Events.
+
+static atomic_uint s_events;
+
+static void on_event(const impulse_event *ev, void *ctx) {
+  const sim_options *o = ctx;
+  const unsigned n = atomic_fetch_add(&s_events, 1) + 1;
+  if (o->quiet) {
+    return;
+  }
+  printf("event %u: peak %" PRIu64 " (%.3f s) level %" PRIu32
+         " hits %" PRIu32,
+         n, ev->peak_index, (double)ev->peak_index / ev->sample_rate,
+         ev->peak_level, ev->hits);
+  // Capture times follow the sample clock, which only tracks real time
+  // when the audio is delivered at its rate.
+  if (o->realtime) {
+    printf(" latency %lld us", (long long)(ev->detected_us - ev->peak_us));
+  }
+  printf("\n");
+}
+
+// Streaming: chunks accumulated in the tap callback and shaped and encoded
+// on a task of their own, as in audio_streamer.c.
+
+typedef struct {
+  uint64_t sample_index;
+  int16_t data[STREAM_CHUNK_FRAMES * 2];
+} sim_chunk;
+
+static struct {
+  const sim_options *opt;
+  sim_chunk *pool;
+  QueueHandle_t free_q;
+  QueueHandle_t filled_q;
+  SemaphoreHandle_t done;
+  sim_chunk *fill;
+  audio_accum accum;
+  audio_shaper shaper;
+  ima_adpcm_encoder enc;
+  FILE *out;
+  int out_rate;
+  uint32_t out_bytes;
+  atomic_bool stop;
+  atomic_uint chunks;
+  atomic_uint drops;
+  uint64_t frames_out;
+  uint64_t adpcm_bytes;
+} st;
+
+static int16_t *stream_publish(int16_t *data, uint64_t first_index,
+                               void *ctx) {
+  (void)data;
+  (void)ctx;
+  sim_chunk *next;
+  st.fill->sample_index = first_index;
+  if (xQueueReceive(st.free_q, &next, 0) != pdTRUE) {
+    // The stream task is behind: refill this chunk.
+    atomic_fetch_add(&st.drops, 1);
+    return st.fill->data;
+  }
+  xQueueSend(st.filled_q, &st.fill, 0);
+  st.fill = next;
+  return st.fill->data;
+}
+
+static void stream_on_tap(const mic_tap_view *tap, void *ctx) {
+  (void)ctx;
+  audio_accum_push(&st.accum, tap->left, tap->right, (size_t)tap->length,
+                   tap->sample_index, stream_publish, NULL);
+}
+
+static void stream_task(void *arg) {
+  (void)arg;
+  static int16_t shaped[STREAM_CHUNK_FRAMES * 2];
+  static uint8_t coded[IMA_ADPCM_MAX_BYTES(STREAM_CHUNK_FRAMES)];
+  for (;;) {
+    sim_chunk *chunk;
+    if (xQueueReceive(st.filled_q, &chunk, pdMS_TO_TICKS(50)) != pdTRUE) {
+      if (atomic_load(&st.stop)) {
+        break;
+      }
+      continue;
+    }
+    atomic_fetch_add(&st.chunks, 1);
+    const int16_t *pcm = chunk->data;
+    size_t frames = STREAM_CHUNK_FRAMES;
+    if (!audio_shaper_is_identity(&st.shaper)) {
+      frames = audio_shaper_run(&st.shaper, chunk->data, STREAM_CHUNK_FRAMES,
+                                chunk->sample_index, shaped);
+      pcm = shaped;
+    }
+    st.frames_out += frames;
+    if (st.opt->adpcm) {
+      st.adpcm_bytes += ima_adpcm_encode(&st.enc, pcm, frames, coded);
+    }
+    if (st.out) {
+      const size_t bytes =
+          frames * (size_t)st.shaper.channels * sizeof(int16_t);
+      st.out_bytes += (uint32_t)fwrite(pcm, 1, bytes, st.out);
+    }
+    xQueueSend(st.free_q, &chunk, 0);
+  }
+  xSemaphoreGive(st.done);
+  vTaskDelete(NULL);
+}
+
+static bool stream_start(const sim_options *o, int rate) {
+  st.opt = o;
+  st.pool = audio_arena_alloc(AUDIO_ARENA_LARGE,
+                              STREAM_POOL_CHUNKS * sizeof(sim_chunk),
+                              "sim_stream");
+  st.free_q = xQueueCreate(STREAM_POOL_CHUNKS, sizeof(sim_chunk *));
+  st.filled_q = xQueueCreate(STREAM_POOL_CHUNKS, sizeof(sim_chunk *));
+  st.done = xSemaphoreCreateBinary();
+  if (!st.pool || !st.free_q || !st.filled_q || !st.done) {
+    return false;
+  }
+  st.fill = &st.pool[0];
+  for (int i = 1; i < STREAM_POOL_CHUNKS; i++) {
+    sim_chunk *c = &st.pool[i];
+    xQueueSend(st.free_q, &c, 0);
+  }
+  audio_accum_init(&st.accum, st.fill->data, STREAM_CHUNK_FRAMES);
+  audio_shaper_init(&st.shaper, o->channels, o->decimation);
+  ima_adpcm_init(&st.enc, st.shaper.channels);
+
+  if (o->out_path) {
+    st.out = fopen(o->out_path, "wb");
+    if (!st.out) {
+      ESP_LOGE(TAG, "Cannot create %s", o->out_path);
+      return false;
+    }
+    // The sizes are filled in by stream_finish().
+    uint8_t header[AUDIO_WAV_HEADER_BYTES];
+    st.out_rate = rate / o->decimation;
+    audio_wav_build_header(header, st.out_rate, st.shaper.channels, NULL);
+    fwrite(header, 1, sizeof(header), st.out);
+  }
+
+  const mic_subscriber_cfg sub_cfg = {
+      .cb = stream_on_tap,
+      .name = "sim_stream",
+      .batch_taps = STREAM_BATCH_TAPS,
+      .enabled = true,
+  };
+  return mic_subscribe(&sub_cfg) != NULL &&
+         xTaskCreatePinnedToCore(stream_task, "sim_stream", STREAM_TASK_STACK,
+                                 NULL, 4, NULL, 1) == pdPASS;
+}
+
+static void stream_finish(void) {
+  atomic_store(&st.stop, true);
+  xSemaphoreTake(st.done, portMAX_DELAY);
+  if (st.out) {
+    uint8_t header[AUDIO_WAV_HEADER_BYTES];
+    audio_wav_build_header(header, st.out_rate, st.shaper.channels, NULL);
+    audio_wav_patch_pcm_sizes(header, sizeof(header), st.out_bytes);
+    fseek(st.out, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), st.out);
+    fclose(st.out);
+  }
+}
+
+// Report.
+
+static void print_metric(const char *data, size_t len, void *ctx) {
+  (void)ctx;
+  fwrite(data, 1, len, stdout);
+}
+
+static void report(const sim_options *o, uint64_t frames, int64_t wall_us) {
+  const int rate = mic_get_config()->sampling_freq;
+  const double audio_s = sim_source_seconds();
+  const double wall_s = (double)wall_us / 1e6;
+  printf("audio: %" PRIu64 " frames, %.2f s at %d Hz, in %.2f s (%.2fx real "
+         "time)\n",
+         frames, audio_s, rate, wall_s, wall_s > 0 ? audio_s / wall_s : 0.0);
+
+  mic_stats ms;
+  mic_get_stats(&ms);
+  printf("reader: %" PRIu32 " chunks, chunk us min %" PRIu32 " mean %.1f "
+         "max %" PRIu32 ", clock %s %.1f ppm\n",
+         ms.chunks, ms.chunk_us_min,
+         ms.chunks ? (double)ms.chunk_us_total / ms.chunks : 0.0,
+         ms.chunk_us_max, ms.clock_locked ? "locked" : "unlocked",
+         (double)ms.clock_ppm);
+  for (int i = 0; i < MIC_MAX_SUBSCRIBERS; i++) {
+    const mic_callback_stats *cb = &ms.callbacks[i];
+    if (!(ms.subscribed_mask & (1u << i))) {
+      continue;
+    }
+    printf("  %-12s %8" PRIu32 " calls, mean %.2f us, max %" PRIu32 " us\n",
+           cb->name ? cb->name : "?", cb->calls,
+           cb->calls ? (double)cb->total_us / cb->calls : 0.0, cb->max_us);
+  }
+
+  impulse_detector_stats ds;
+  impulse_detector_get_stats(&ds);
+  printf("detector: %" PRIu32 " events (%" PRIu32 " hits coalesced), %" PRIu32
+         " taps dropped, %" PRIu32 " resets, %" PRIu32 " windows lost\n",
+         ds.detections, ds.coalesced, ds.taps_dropped, ds.resets,
+         ds.windows_lost);
+
+  printf("stream: %u chunks, %u dropped, %" PRIu64 " frames out",
+         atomic_load(&st.chunks), atomic_load(&st.drops), st.frames_out);
+  if (o->adpcm) {
+    printf(", %" PRIu64 " ADPCM bytes", st.adpcm_bytes);
+  }
+  printf("\n");
+
+  if (o->metrics) {
+    metrics_expose(print_metric, NULL);
+  }
+}
+
+// The geometry audio_capture_mic_config() picks for `rate`.
+static mic_config sim_mic_config(int rate) {
+  const mic_config cfg = {
+      .sampling_freq = rate,
+      .pre_event_ms = MIC_PRE_EVENT_MS,
+      .post_event_ms = MIC_POST_EVENT_MS,
+      .num_taps = MIC_DEFAULT_NUM_TAPS,
+      .tap_size = impulse_tap_size_for_rate(rate, MIC_SAMPLING_FREQUENCY,
+                                            MIC_DEFAULT_TAP_SIZE,
+                                            MIC_DEFAULT_NUM_TAPS),
+  };
+  return cfg;
+}
+
+static int s_switch_rate;
+
+// What audio_capture_set_rate() does.
+static void switch_rate(void) {
+  const mic_config cfg = sim_mic_config(s_switch_rate);
+  const esp_err_t err = mic_reconfigure(&cfg);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Switch to %d Hz failed: %s", s_switch_rate,
+             esp_err_to_name(err));
+  }
+}
+
+int main(int argc, char **argv) {
+  sim_options opt;
+  if (!parse_args(argc, argv, &opt)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  audio_arena_init();
+  const sim_source_cfg src = {
+      .wav_path = opt.wav_path,
+      .loop = opt.loop,
+      .realtime = opt.realtime,
+      .free_run = opt.free_run,
+      .synth_rate = opt.rate,
+      .max_seconds = opt.seconds,
+      .synth_period_ms = opt.period_ms,
+      .on_switch = opt.switch_rate ? switch_rate : NULL,
+      .switch_at_s = opt.seconds / 2,
+  };
+  s_switch_rate = opt.switch_rate;
+  if (!sim_source_setup(&src)) {
+    return 2;
+  }
+  const int rate = sim_source_rate();
+
+  const mic_config mic_cfg = sim_mic_config(rate);
+  mic_init(&mic_cfg);
+  mic_history_start();
+  if (!impulse_detector_add_event_listener(on_event, &opt) ||
+      !stream_start(&opt, rate)) {
+    ESP_LOGE(TAG, "Pipeline setup failed");
+    return 2;
+  }
+
+  const int64_t start_us = esp_timer_get_time();
+  // Starts the reader too.
+  impulse_detector_start();
+
+  while (!sim_source_finished()) {
+    vTaskDelay(pdMS_TO_TICKS(20));
+  }
+  const int64_t wall_us = esp_timer_get_time() - start_us;
+  vTaskDelay(pdMS_TO_TICKS(SIM_DRAIN_MS));
+  stream_finish();
+
+  report(&opt, sim_source_frames(), wall_us);
+  fflush(stdout);
+
+  const unsigned events = atomic_load(&s_events);
+  if (opt.expect >= 0 && (long)events != opt.expect) {
+    fprintf(stderr, "expected %ld events, detected %u\n", opt.expect, events);
+    return 1;
+  }
+  impulse_detector_stats ds;
+  impulse_detector_get_stats(&ds);
+  if (opt.expect >= 0 && ds.windows_lost > 0) {
+    fprintf(stderr, "%" PRIu32 " event windows lost\n", ds.windows_lost);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,263 @@
+#include "sim_source.h"
+#include "mic_input.h"
+#include "mic_replay.h"
+#include "mic_source.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *TAG = "SIM_SOURCE";
+
+// How long read() waits once the audio has run out, so the reader does not
+// spin while the run is wound down.
+#define SIM_IDLE_TICKS pdMS_TO_TICKS(10)
+
+static struct {
+  sim_source_cfg cfg;
+  int16_t *pcm; // the whole data chunk of the file
+  int channels;
+  uint64_t file_frames;
+  uint64_t file_pos;
+  int rate;
+  uint64_t rate_start;   // frames delivered before the current rate
+  double rate_start_s;   // and their length
+  bool switched;
+  uint64_t max_frames; // 0: no limit
+  int chunk_left;      // frames of the DMA chunk still to hand over
+  mic_synth synth;
+  int64_t anchor_us;
+  uint64_t paced_frames;
+  _Atomic uint64_t frames;
+  atomic_bool finished;
+} sim;
+
+static uint8_t *read_file(const char *path, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    return NULL;
+  }
+  uint8_t *buf = NULL;
+  if (fseek(f, 0, SEEK_END) == 0) {
+    const long size = ftell(f);
+    if (size > 0 && fseek(f, 0, SEEK_SET) == 0 &&
+        (buf = malloc((size_t)size)) != NULL) {
+      *len = fread(buf, 1, (size_t)size, f);
+    }
+  }
+  fclose(f);
+  return buf;
+}
+
+static bool load_wav(const char *path) {
+  size_t len = 0;
+  uint8_t *file = read_file(path, &len);
+  if (!file) {
+    ESP_LOGE(TAG, "Cannot read %s", path);
+    return false;
+  }
+  mic_replay_wav info;
+  if (!mic_replay_parse_wav(file, len, &info) || info.data_offset > len) {
+    ESP_LOGE(TAG, "%s is not a 16-bit PCM WAV file", path);
+    free(file);
+    return false;
+  }
+  size_t bytes = len - info.data_offset;
+  if (info.data_bytes != 0 && info.data_bytes < bytes) {
+    bytes = info.data_bytes;
+  }
+  const size_t frame_bytes = (size_t)info.channels * sizeof(int16_t);
+  sim.file_frames = bytes / frame_bytes;
+  if (sim.file_frames == 0) {
+    ESP_LOGE(TAG, "%s holds no audio", path);
+    free(file);
+    return false;
+  }
+  sim.pcm = malloc(sim.file_frames * frame_bytes);
+  if (!sim.pcm) {
+    free(file);
+    return false;
+  }
+  memcpy(sim.pcm, file + info.data_offset, sim.file_frames * frame_bytes);
+  free(file);
+  sim.channels = info.channels;
+  sim.rate = info.sample_rate;
+  ESP_LOGI(TAG, "%s: %d Hz, %d channel(s), %llu frames", path, sim.rate,
+           sim.channels, (unsigned long long)sim.file_frames);
+  return true;
+}
+
+// Sleeps until `frames` more frames would have been captured in real time.
+// To the microsecond rather than in ticks, as DMA chunks arrive, so the
+// sample clock sees the arrival pattern it fits on the target.
+static void pace(int frames) {
+  sim.paced_frames += (uint64_t)frames;
+  const int64_t due_us =
+      sim.anchor_us +
+      (int64_t)(sim.paced_frames * 1000000ull / (uint64_t)sim.rate);
+  const struct timespec until = {
+      .tv_sec = (time_t)(due_us / 1000000),
+      .tv_nsec = (long)(due_us % 1000000) * 1000,
+  };
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) ==
+         EINTR) {
+  }
+}
+
+static void reset_clock(void) {
+  sim.anchor_us = esp_timer_get_time();
+  sim.paced_frames = 0;
+}
+
+static esp_err_t sim_open(int sampling_freq) {
+  if (sim.pcm && sampling_freq != sim.rate) {
+    ESP_LOGW(TAG, "Audio is %d Hz, processed as %d Hz", sim.rate,
+             sampling_freq);
+  }
+  // max_seconds holds across a rate change: what was delivered counts at
+  // the rate it was delivered at.
+  const uint64_t sent = atomic_load(&sim.frames);
+  sim.rate_start_s += (double)(sent - sim.rate_start) / sim.rate;
+  sim.rate_start = sent;
+  sim.rate = sampling_freq;
+  sim.max_frames =
+      sim.cfg.max_seconds > 0
+          ? sent + (uint64_t)((sim.cfg.max_seconds - sim.rate_start_s) *
+                              sampling_freq)
+          : 0;
+  if (!sim.cfg.wav_path) {
+    mic_synth_init(&sim.synth, sampling_freq, sim.cfg.synth_period_ms,
+                   CONFIG_MIC_SOURCE_SYNTH_LAG_US,
+                   CONFIG_MIC_SOURCE_SYNTH_PEAK, CONFIG_MIC_SOURCE_SYNTH_NOISE,
+                   CONFIG_MIC_SOURCE_SYNTH_DECAY_MS);
+  }
+  reset_clock();
+  return ESP_OK;
+}
+
+static esp_err_t sim_set_rate(int sampling_freq) { return sim_open(sampling_freq); }
+
+// Frames of the file from the current position, wrapping when looping.
+static int read_file_frames(int32_t *frames, int n) {
+  int done = 0;
+  while (done < n) {
+    if (sim.file_pos == sim.file_frames) {
+      if (!sim.cfg.loop) {
+        break;
+      }
+      sim.file_pos = 0;
+    }
+    uint64_t avail = sim.file_frames - sim.file_pos;
+    const int take = avail < (uint64_t)(n - done) ? (int)avail : n - done;
+    // Packed in place from the start of the chunk, as the firmware source
+    // does with what it reads from the file.
+    int32_t *dst = frames + 2 * done;
+    memcpy(dst, sim.pcm + sim.file_pos * (uint64_t)sim.channels,
+           (size_t)take * (size_t)sim.channels * sizeof(int16_t));
+    mic_replay_pack_frames((const int16_t *)dst, sim.channels, take, dst);
+    sim.file_pos += (uint64_t)take;
+    done += take;
+  }
+  return done;
+}
+
+// In lockstep a DMA chunk is handed over in pieces of at most half the
+// detector's tap queue (MIC_RING_HEADROOM_TAPS deep), so the queue cannot
+// overflow before the detector task has woken up. A whole chunk fills the
+// queue on its own, which the target absorbs because the detector drains it
+// from the other core within microseconds; a host thread takes longer to
+// wake. The pieces are whole taps but for the chunk's last, so the reader
+// drops the trailing frames of each chunk as it does on the target, and the
+// sample clock sees the sample rate it was set up for.
+static int lockstep_frames(void) {
+  const int step = mic_get_config()->tap_size * (MIC_RING_HEADROOM_TAPS / 2);
+  return step < sim.chunk_left ? step : sim.chunk_left;
+}
+
+static int sim_read(int32_t *frames, int max_frames) {
+  if (atomic_load(&sim.finished)) {
+    vTaskDelay(SIM_IDLE_TICKS);
+    return 0;
+  }
+  int want = max_frames;
+  if (!sim.cfg.free_run) {
+    sim_wait_idle();
+    if (sim.chunk_left == 0) {
+      sim.chunk_left = max_frames;
+    }
+    want = lockstep_frames();
+  }
+  const uint64_t sent = atomic_load_explicit(&sim.frames, memory_order_relaxed);
+  int n = want;
+  int end = want; // fewer frames than this end the run
+  if (sim.cfg.on_switch && !sim.switched) {
+    const uint64_t at = (uint64_t)(sim.cfg.switch_at_s * sim.rate);
+    if (sent >= at) {
+      // The reader applies what the callback posts before its next read.
+      sim.switched = true;
+      sim.chunk_left = 0;
+      sim.cfg.on_switch();
+      return 0;
+    }
+    if (at - sent < (uint64_t)n) {
+      n = end = (int)(at - sent);
+    }
+  }
+  if (sim.max_frames && sim.max_frames - sent < (uint64_t)n) {
+    n = (int)(sim.max_frames - sent);
+  }
+  if (sim.pcm) {
+    n = read_file_frames(frames, n);
+  } else {
+    mic_synth_fill(&sim.synth, frames, n);
+  }
+  atomic_store(&sim.frames, sent + (uint64_t)n);
+  sim.chunk_left -= n;
+  if (n < end) {
+    atomic_store(&sim.finished, true);
+  }
+  if (sim.cfg.realtime) {
+    pace(n);
+  }
+  return n;
+}
+
+static const mic_source sim_source = {
+    .name = "sim",
+    .open = sim_open,
+    .set_rate = sim_set_rate,
+    .read = sim_read,
+    .overflows = NULL,
+};
+
+bool sim_source_setup(const sim_source_cfg *cfg) {
+  sim.cfg = *cfg;
+  sim.rate = cfg->synth_rate;
+  if (cfg->wav_path && !load_wav(cfg->wav_path)) {
+    return false;
+  }
+  if (cfg->loop && cfg->max_seconds <= 0 && cfg->wav_path) {
+    ESP_LOGW(TAG, "Looping without a length limit runs until interrupted");
+  }
+  mic_set_source(&sim_source);
+  return true;
+}
+
+int sim_source_rate(void) { return sim.rate; }
+
+uint64_t sim_source_frames(void) { return atomic_load(&sim.frames); }
+
+double sim_source_seconds(void) {
+  return sim.rate_start_s +
+         (double)(atomic_load(&sim.frames) - sim.rate_start) / sim.rate;
+}
+
+bool sim_source_finished(void) { return atomic_load(&sim.finished); }
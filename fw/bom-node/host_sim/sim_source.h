@@ -0,0 +1,46 @@
+#ifndef SIM_SOURCE_H
+#define SIM_SOURCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The simulator's mic source (mic_source.h): a WAV file held in memory, or
+// the synthetic impulses of mic_replay.h, chosen at run time. Unlike the
+// firmware's replay sources it stops after a set amount of audio, so a run
+// has a defined end. It also runs the pipeline in lockstep: a read returns
+// a few whole taps once every other task is done with the previous ones
+// (sim_wait_idle()), so no consumer drops audio and two runs over the same
+// input process it identically. At full speed a run then takes as long as
+// its processing.
+
+typedef struct {
+  const char *wav_path; // NULL for the synthetic impulses
+  bool loop;            // replay the file until max_frames
+  bool realtime;        // pace to the sample rate instead of full speed
+  // Deliver DMA-sized chunks without waiting for the pipeline to finish
+  // the last one: consumers that fall behind drop, as with
+  // CONFIG_MIC_SOURCE_MAX_SPEED on the target.
+  bool free_run;
+  double max_seconds;   // of audio; 0: one pass of the file (synth: no end)
+  int synth_rate;       // [Hz]
+  int synth_period_ms;
+  // Called on the reader task once `switch_at_s` seconds of audio have been
+  // delivered, before any more is; NULL for none.
+  void (*on_switch)(void);
+  double switch_at_s;
+} sim_source_cfg;
+
+// Loads the file and installs the source with mic_set_source(). Call before
+// mic_init(). Returns false, after logging why, when the file is unusable.
+bool sim_source_setup(const sim_source_cfg *cfg);
+
+// The rate to pass to mic_init(): the file's, or synth_rate.
+int sim_source_rate(void);
+
+// Frames delivered so far, their length in seconds at the rates they were
+// delivered at, and whether the last one has been.
+uint64_t sim_source_frames(void);
+double sim_source_seconds(void);
+bool sim_source_finished(void);
+
+#endif
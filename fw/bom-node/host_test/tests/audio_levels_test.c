@@ -0,0 +1,157 @@
+#include "audio_levels.h"
+#include "unity.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+#define RATE 44100
+#define BLOCK 2205 // 50 ms
+#define FRAMES (4 * BLOCK)
+#define MAX_BLOCKS 8
+
+static int16_t left[FRAMES];
+static int16_t right[FRAMES];
+
+static audio_levels_sum blocks[MAX_BLOCKS];
+static int block_count;
+
+static void on_block(const audio_levels_sum *block, void *ctx) {
+  (void)ctx;
+  TEST_ASSERT_TRUE(block_count < MAX_BLOCKS);
+  blocks[block_count++] = *block;
+}
+
+static void fill_sine(double amp) {
+  for (int i = 0; i < FRAMES; i++) {
+    left[i] = (int16_t)lrint(amp * sin(2.0 * M_PI * 1000.0 * i / RATE));
+    right[i] = (int16_t)(left[i] / 4);
+  }
+}
+
+static int16_t rd_le16(const uint8_t *p) {
+  return (int16_t)(uint16_t)(p[0] | (p[1] << 8));
+}
+
+void test_blocks_split_across_pushes(void) {
+  fill_sine(10000.0);
+  audio_levels lv;
+  audio_levels_init(&lv, BLOCK);
+  block_count = 0;
+  // Tap-sized pieces that do not line up with the blocks.
+  for (int i = 0; i < FRAMES; i += 240) {
+    const int n = FRAMES - i < 240 ? FRAMES - i : 240;
+    audio_levels_push(&lv, left + i, right + i, (size_t)n, 1000 + (uint64_t)i,
+                      on_block, NULL);
+  }
+  TEST_ASSERT_EQUAL_INT(4, block_count);
+  for (int b = 0; b < 4; b++) {
+    TEST_ASSERT_EQUAL_UINT32(BLOCK, blocks[b].samples);
+    TEST_ASSERT_EQUAL_UINT64(1000 + (uint64_t)b * BLOCK, blocks[b].first_index);
+    uint64_t sum = 0;
+    uint32_t peak = 0;
+    for (int i = b * BLOCK; i < (b + 1) * BLOCK; i++) {
+      const int32_t s = left[i];
+      sum += (uint64_t)(s * s);
+      peak = (uint32_t)abs(s) > peak ? (uint32_t)abs(s) : peak;
+    }
+    TEST_ASSERT_EQUAL_UINT64(sum, blocks[b].sum_sq[0]);
+    TEST_ASSERT_EQUAL_UINT32(peak, blocks[b].peak[0]);
+  }
+}
+
+void test_gap_drops_the_partial_block(void) {
+  fill_sine(10000.0);
+  audio_levels lv;
+  audio_levels_init(&lv, BLOCK);
+  block_count = 0;
+  audio_levels_push(&lv, left, right, BLOCK / 2, 0, on_block, NULL);
+  audio_levels_push(&lv, left, right, BLOCK, 50000, on_block, NULL);
+  TEST_ASSERT_EQUAL_INT(1, block_count);
+  TEST_ASSERT_EQUAL_UINT64(50000, blocks[0].first_index);
+  TEST_ASSERT_EQUAL_UINT32(BLOCK, blocks[0].samples);
+}
+
+void test_merge_needs_consecutive_blocks(void) {
+  fill_sine(10000.0);
+  audio_levels lv;
+  audio_levels_init(&lv, BLOCK);
+  block_count = 0;
+  audio_levels_push(&lv, left, right, FRAMES, 0, on_block, NULL);
+
+  audio_levels_sum w = {0};
+  TEST_ASSERT_TRUE(audio_levels_merge(&w, &blocks[0]));
+  TEST_ASSERT_TRUE(audio_levels_merge(&w, &blocks[1]));
+  TEST_ASSERT_FALSE(audio_levels_merge(&w, &blocks[3]));
+  TEST_ASSERT_EQUAL_UINT32(2 * BLOCK, w.samples);
+  TEST_ASSERT_EQUAL_UINT64(blocks[0].sum_sq[1] + blocks[1].sum_sq[1],
+                           w.sum_sq[1]);
+  TEST_ASSERT_EQUAL_UINT32(
+      blocks[0].peak[1] > blocks[1].peak[1] ? blocks[0].peak[1]
+                                            : blocks[1].peak[1],
+      w.peak[1]);
+}
+
+void test_levels_in_centi_db(void) {
+  TEST_ASSERT_EQUAL_INT16(0, audio_levels_cdb(32768.0f));
+  TEST_ASSERT_EQUAL_INT16(-602, audio_levels_cdb(16384.0f));
+  TEST_ASSERT_EQUAL_INT16(AUDIO_LEVELS_SILENT_CDB, audio_levels_cdb(0.0f));
+  TEST_ASSERT_EQUAL_INT16(AUDIO_LEVELS_SILENT_CDB, audio_levels_cdb(1e-4f));
+}
+
+void test_frame_of_a_sine(void) {
+  // Full-scale sine on the left, a quarter of it on the right.
+  fill_sine(32767.0);
+  audio_levels lv;
+  audio_levels_init(&lv, FRAMES);
+  block_count = 0;
+  audio_levels_push(&lv, left, right, FRAMES, 0x123456789ull, on_block, NULL);
+  TEST_ASSERT_EQUAL_INT(1, block_count);
+
+  const uint16_t floor[AUDIO_LEVELS_CHANNELS] = {328, 0};
+  uint8_t frame[AUDIO_LEVELS_FRAME_BYTES];
+  TEST_ASSERT_EQUAL_UINT(AUDIO_LEVELS_FRAME_BYTES,
+                         audio_levels_encode(&blocks[0], floor, 7, 200, frame));
+  TEST_ASSERT_EQUAL_UINT8(AUDIO_LEVELS_VERSION, frame[0]);
+  TEST_ASSERT_EQUAL_UINT8(2, frame[1]);
+  TEST_ASSERT_EQUAL_INT16(200, rd_le16(frame + 2));
+  TEST_ASSERT_EQUAL_UINT8(7, frame[4]);
+  TEST_ASSERT_EQUAL_UINT8(0x89, frame[8]);
+  TEST_ASSERT_EQUAL_UINT8(0x01, frame[12]);
+
+  // RMS -3.01 dB, peak 0 dB, crest 3.01 dB; the floor is 40 dB down.
+  TEST_ASSERT_INT_WITHIN(3, -301, rd_le16(frame + 16));
+  TEST_ASSERT_INT_WITHIN(1, 0, rd_le16(frame + 18));
+  TEST_ASSERT_INT_WITHIN(3, 301, rd_le16(frame + 20));
+  TEST_ASSERT_INT_WITHIN(1, -4000, rd_le16(frame + 22));
+  // 12 dB lower on the right, with the same crest factor; no floor yet.
+  TEST_ASSERT_INT_WITHIN(3, -301 - 1204, rd_le16(frame + 24));
+  TEST_ASSERT_INT_WITHIN(3, -1204, rd_le16(frame + 26));
+  TEST_ASSERT_INT_WITHIN(3, 301, rd_le16(frame + 28));
+  TEST_ASSERT_EQUAL_INT16(AUDIO_LEVELS_SILENT_CDB, rd_le16(frame + 30));
+}
+
+void test_silence_has_no_crest_factor(void) {
+  const audio_levels_sum silent = {.samples = BLOCK};
+  const uint16_t floor[AUDIO_LEVELS_CHANNELS] = {0, 0};
+  uint8_t frame[AUDIO_LEVELS_FRAME_BYTES];
+  audio_levels_encode(&silent, floor, 0, 50, frame);
+  TEST_ASSERT_EQUAL_INT16(AUDIO_LEVELS_SILENT_CDB, rd_le16(frame + 16));
+  TEST_ASSERT_EQUAL_INT16(AUDIO_LEVELS_SILENT_CDB, rd_le16(frame + 18));
+  TEST_ASSERT_EQUAL_INT16(0, rd_le16(frame + 20));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_blocks_split_across_pushes);
+  RUN_TEST(test_gap_drops_the_partial_block);
+  RUN_TEST(test_merge_needs_consecutive_blocks);
+  RUN_TEST(test_levels_in_centi_db);
+  RUN_TEST(test_frame_of_a_sine);
+  RUN_TEST(test_silence_has_no_crest_factor);
+  return UNITY_END();
+}
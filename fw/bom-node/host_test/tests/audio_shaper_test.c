@@ -0,0 +1,188 @@
+#include "audio_shaper.h"
+#include "unity.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+#define RATE 44100
+#define FRAMES 8820 // 200 ms
+
+static int16_t in[FRAMES * 2];
+static int16_t out[FRAMES * 2];
+static int16_t out_split[FRAMES * 2];
+
+static void fill_sine(double hz, double amp) {
+  for (int i = 0; i < FRAMES; i++) {
+    const int16_t v = (int16_t)lrint(amp * sin(2.0 * M_PI * hz * i / RATE));
+    in[2 * i] = v;
+    in[2 * i + 1] = (int16_t)(v / 2);
+  }
+}
+
+// RMS of the output after the filter has filled, relative to `amp`.
+static double gain_db(const int16_t *y, size_t frames, int channels,
+                      double amp) {
+  double sum = 0.0;
+  size_t n = 0;
+  for (size_t i = frames / 4; i < frames; i++) {
+    sum += (double)y[i * channels] * y[i * channels];
+    n++;
+  }
+  return 20.0 * log10(sqrt(sum / n) / (amp / sqrt(2.0)));
+}
+
+void test_channel_names(void) {
+  audio_channel_mode mode = AUDIO_CHANNELS_LEFT;
+  TEST_ASSERT_TRUE(audio_shaper_parse_channels("", &mode));
+  TEST_ASSERT_EQUAL_INT(AUDIO_CHANNELS_STEREO, mode);
+  TEST_ASSERT_TRUE(audio_shaper_parse_channels("mono", &mode));
+  TEST_ASSERT_EQUAL_INT(AUDIO_CHANNELS_MONO, mode);
+  TEST_ASSERT_FALSE(audio_shaper_parse_channels("quad", &mode));
+  TEST_ASSERT_EQUAL_INT(AUDIO_CHANNELS_MONO, mode);
+  TEST_ASSERT_EQUAL_INT(
+      0, strcmp("right", audio_shaper_channels_name(AUDIO_CHANNELS_RIGHT)));
+}
+
+void test_rejects_bad_decimation(void) {
+  audio_shaper sh;
+  TEST_ASSERT_FALSE(audio_shaper_init(&sh, AUDIO_CHANNELS_STEREO, 0));
+  TEST_ASSERT_FALSE(audio_shaper_init(&sh, AUDIO_CHANNELS_STEREO,
+                                      AUDIO_SHAPER_MAX_DECIMATION + 1));
+}
+
+void test_channel_select_without_decimation(void) {
+  const int16_t frames[] = {100, -300, 7, 9, INT16_MAX, INT16_MAX};
+  int16_t y[6];
+  audio_shaper sh;
+
+  audio_shaper_init(&sh, AUDIO_CHANNELS_STEREO, 1);
+  TEST_ASSERT_TRUE(audio_shaper_is_identity(&sh));
+  TEST_ASSERT_EQUAL_size_t(3, audio_shaper_run(&sh, frames, 3, 0, y));
+  TEST_ASSERT_EQUAL_INT16_ARRAY(frames, y, 6);
+
+  audio_shaper_init(&sh, AUDIO_CHANNELS_LEFT, 1);
+  TEST_ASSERT_EQUAL_INT(1, sh.channels);
+  audio_shaper_run(&sh, frames, 3, 0, y);
+  const int16_t left[] = {100, 7, INT16_MAX};
+  TEST_ASSERT_EQUAL_INT16_ARRAY(left, y, 3);
+
+  audio_shaper_init(&sh, AUDIO_CHANNELS_RIGHT, 1);
+  audio_shaper_run(&sh, frames, 3, 0, y);
+  const int16_t right[] = {-300, 9, INT16_MAX};
+  TEST_ASSERT_EQUAL_INT16_ARRAY(right, y, 3);
+
+  audio_shaper_init(&sh, AUDIO_CHANNELS_MONO, 1);
+  audio_shaper_run(&sh, frames, 3, 0, y);
+  const int16_t mono[] = {-100, 8, INT16_MAX}; // no overflow at full scale
+  TEST_ASSERT_EQUAL_INT16_ARRAY(mono, y, 3);
+}
+
+void test_dc_passes_at_unity_gain(void) {
+  for (int m = 2; m <= AUDIO_SHAPER_MAX_DECIMATION; m++) {
+    for (int i = 0; i < FRAMES * 2; i++) {
+      in[i] = 10000;
+    }
+    audio_shaper sh;
+    audio_shaper_init(&sh, AUDIO_CHANNELS_STEREO, m);
+    const size_t made = audio_shaper_run(&sh, in, FRAMES, 0, out);
+    TEST_ASSERT_EQUAL_size_t(audio_shaper_max_out(&sh, FRAMES), made);
+    TEST_ASSERT_INT_WITHIN(1, 10000, out[2 * (made - 1)]);
+    TEST_ASSERT_INT_WITHIN(1, 10000, out[2 * (made - 1) + 1]);
+  }
+}
+
+void test_passband_is_kept_and_aliases_are_rejected(void) {
+  // 44.1 -> 11.025 kHz: flat well inside the new band, and a tone that
+  // would alias down to 3 kHz is gone.
+  audio_shaper sh;
+  audio_shaper_init(&sh, AUDIO_CHANNELS_LEFT, 4);
+
+  fill_sine(1000.0, 16000.0);
+  size_t made = audio_shaper_run(&sh, in, FRAMES, 0, out);
+  TEST_ASSERT_FLOAT_WITHIN(0.2f, 0.0f, (float)gain_db(out, made, 1, 16000.0));
+
+  fill_sine(3500.0, 16000.0);
+  audio_shaper_init(&sh, AUDIO_CHANNELS_LEFT, 4);
+  made = audio_shaper_run(&sh, in, FRAMES, 0, out);
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 0.0f, (float)gain_db(out, made, 1, 16000.0));
+
+  fill_sine(11025.0 - 3000.0, 16000.0);
+  audio_shaper_init(&sh, AUDIO_CHANNELS_LEFT, 4);
+  made = audio_shaper_run(&sh, in, FRAMES, 0, out);
+  TEST_ASSERT_LESS_THAN(-60, (int)gain_db(out, made, 1, 16000.0));
+}
+
+void test_split_input_matches_single_call(void) {
+  fill_sine(440.0, 12000.0);
+  audio_shaper a, b;
+  audio_shaper_init(&a, AUDIO_CHANNELS_STEREO, 3);
+  audio_shaper_init(&b, AUDIO_CHANNELS_STEREO, 3);
+  const uint64_t base = 1000001;
+  const size_t na = audio_shaper_run(&a, in, FRAMES, base, out);
+
+  size_t nb = 0;
+  size_t done = 0;
+  const size_t pieces[] = {1, 479, 480, 2, 31};
+  for (int k = 0; done < FRAMES; k = (k + 1) % 5) {
+    size_t take = pieces[k];
+    if (take > FRAMES - done)
+      take = FRAMES - done;
+    const size_t got =
+        audio_shaper_run(&b, &in[2 * done], take, base + done, &out_split[2 * nb]);
+    TEST_ASSERT_LESS_OR_EQUAL(audio_shaper_max_out(&b, take), got);
+    nb += got;
+    done += take;
+  }
+  TEST_ASSERT_EQUAL_size_t(na, nb);
+  TEST_ASSERT_EQUAL_INT16_ARRAY(out, out_split, 2 * na);
+}
+
+void test_outputs_land_on_the_index_grid(void) {
+  audio_shaper sh;
+  audio_shaper_init(&sh, AUDIO_CHANNELS_MONO, 4);
+  // Frames 1001..1010: outputs at 1004 and 1008, labelled at the centre of
+  // their filter span.
+  TEST_ASSERT_EQUAL_size_t(2, audio_shaper_run(&sh, in, 10, 1001, out));
+  TEST_ASSERT_EQUAL_UINT64(1004 - (uint64_t)sh.delay,
+                           audio_shaper_out_index(&sh, 1001));
+  TEST_ASSERT_EQUAL_UINT64(1004 - (uint64_t)sh.delay,
+                           audio_shaper_out_index(&sh, 1004));
+  // Continuing at 1011, the next output is at 1012.
+  TEST_ASSERT_EQUAL_size_t(1, audio_shaper_run(&sh, in, 2, 1011, out));
+  TEST_ASSERT_EQUAL_UINT64(1012 - (uint64_t)sh.delay,
+                           audio_shaper_out_index(&sh, 1011));
+  // Before the first full span the label would be negative.
+  TEST_ASSERT_EQUAL_UINT64(0, audio_shaper_out_index(&sh, 0));
+}
+
+void test_gap_restarts_the_filter(void) {
+  for (int i = 0; i < FRAMES * 2; i++) {
+    in[i] = 20000;
+  }
+  audio_shaper sh;
+  audio_shaper_init(&sh, AUDIO_CHANNELS_LEFT, 2);
+  audio_shaper_run(&sh, in, 1000, 0, out);
+  // A jump: the history is cleared, so the first output ramps up from
+  // silence instead of mixing audio from both sides of the gap.
+  memset(in, 0, 200 * 2 * sizeof(int16_t));
+  audio_shaper_run(&sh, in, 200, 5000, out);
+  TEST_ASSERT_EQUAL_INT16(0, out[0]);
+  TEST_ASSERT_EQUAL_INT16(0, out[99]);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_channel_names);
+  RUN_TEST(test_rejects_bad_decimation);
+  RUN_TEST(test_channel_select_without_decimation);
+  RUN_TEST(test_dc_passes_at_unity_gain);
+  RUN_TEST(test_passband_is_kept_and_aliases_are_rejected);
+  RUN_TEST(test_split_input_matches_single_call);
+  RUN_TEST(test_outputs_land_on_the_index_grid);
+  RUN_TEST(test_gap_restarts_the_filter);
+  return UNITY_END();
+}
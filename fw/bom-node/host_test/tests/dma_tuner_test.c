@@ -0,0 +1,110 @@
+#include "dma_tuner.h"
+#include "unity.h"
+
+#include <stdint.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+#define PERIOD_US 11565 // 510 frames at 44.1 kHz
+
+// Feeds a whole window of reads with `lag_us` and returns the last answer.
+static int run_window(dma_tuner *t, int32_t lag_us, uint32_t overflows) {
+  int want = t->desc_num;
+  for (int i = 0; i < DMA_TUNER_WINDOW_CHUNKS; i++) {
+    want = dma_tuner_chunk(t, lag_us, overflows);
+    if (want != t->desc_num) {
+      break;
+    }
+  }
+  return want;
+}
+
+void test_buffers_for_lag(void) {
+  TEST_ASSERT_EQUAL_INT(1, dma_tuner_buffers_for(0, PERIOD_US));
+  TEST_ASSERT_EQUAL_INT(2, dma_tuner_buffers_for(1, PERIOD_US));
+  TEST_ASSERT_EQUAL_INT(2, dma_tuner_buffers_for(PERIOD_US, PERIOD_US));
+  TEST_ASSERT_EQUAL_INT(4, dma_tuner_buffers_for(3 * PERIOD_US - 5, PERIOD_US));
+}
+
+void test_steady_lag_keeps_the_queue(void) {
+  dma_tuner t;
+  dma_tuner_init(&t, 7, 4, 20, PERIOD_US, 0);
+  // Three buffers in use and twice the margin spare: nothing to give back.
+  for (int w = 0; w < 3 * DMA_TUNER_CALM_WINDOWS; w++) {
+    TEST_ASSERT_EQUAL_INT(7, run_window(&t, 2 * PERIOD_US, 0));
+  }
+}
+
+void test_overflow_grows_at_once(void) {
+  dma_tuner t;
+  dma_tuner_init(&t, 8, 4, 20, PERIOD_US, 5);
+  TEST_ASSERT_EQUAL_INT(8, dma_tuner_chunk(&t, 100, 5));
+  TEST_ASSERT_EQUAL_INT(8 + DMA_TUNER_OVERFLOW_STEP,
+                        dma_tuner_chunk(&t, -1, 6));
+  dma_tuner_resized(&t, 10, PERIOD_US, 6);
+  TEST_ASSERT_EQUAL_UINT32(1, t.resizes);
+  TEST_ASSERT_EQUAL_INT(10, dma_tuner_chunk(&t, -1, 6));
+}
+
+void test_long_lag_grows_to_the_margin(void) {
+  dma_tuner t;
+  dma_tuner_init(&t, 6, 4, 20, PERIOD_US, 0);
+  // One read waited through six buffers: seven in use.
+  dma_tuner_chunk(&t, 6 * PERIOD_US, 0);
+  TEST_ASSERT_EQUAL_INT(7 + DMA_TUNER_MARGIN, run_window(&t, 100, 0));
+}
+
+void test_quiet_windows_shrink_one_at_a_time(void) {
+  dma_tuner t;
+  dma_tuner_init(&t, 10, 4, 20, PERIOD_US, 0);
+  for (int w = 0; w < DMA_TUNER_CALM_WINDOWS - 1; w++) {
+    TEST_ASSERT_EQUAL_INT(10, run_window(&t, 100, 0));
+  }
+  TEST_ASSERT_EQUAL_INT(9, run_window(&t, 100, 0));
+  dma_tuner_resized(&t, 9, PERIOD_US, 0);
+  // Down to two in use plus twice the margin.
+  int desc = 9;
+  for (int w = 0; w < 20 * DMA_TUNER_CALM_WINDOWS; w++) {
+    const int want = run_window(&t, 100, 0);
+    if (want != desc) {
+      TEST_ASSERT_EQUAL_INT(desc - 1, want);
+      dma_tuner_resized(&t, want, PERIOD_US, 0);
+      desc = want;
+    }
+  }
+  TEST_ASSERT_EQUAL_INT(2 + 2 * DMA_TUNER_MARGIN, desc);
+}
+
+void test_unknown_lag_never_shrinks(void) {
+  dma_tuner t;
+  dma_tuner_init(&t, 10, 4, 20, PERIOD_US, 0);
+  for (int w = 0; w < 2 * DMA_TUNER_CALM_WINDOWS; w++) {
+    for (int i = 0; i < DMA_TUNER_WINDOW_CHUNKS; i++) {
+      TEST_ASSERT_EQUAL_INT(10, dma_tuner_chunk(&t, i == 0 ? -1 : 100, 0));
+    }
+  }
+}
+
+void test_limits_hold(void) {
+  dma_tuner t;
+  dma_tuner_init(&t, 30, 4, 12, PERIOD_US, 0);
+  TEST_ASSERT_EQUAL_INT(12, t.desc_num);
+  TEST_ASSERT_EQUAL_INT(12, dma_tuner_chunk(&t, -1, 1));
+  dma_tuner_init(&t, 4, 4, 12, PERIOD_US, 0);
+  for (int w = 0; w < 2 * DMA_TUNER_CALM_WINDOWS; w++) {
+    TEST_ASSERT_EQUAL_INT(4, run_window(&t, 0, 0));
+  }
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_buffers_for_lag);
+  RUN_TEST(test_steady_lag_keeps_the_queue);
+  RUN_TEST(test_overflow_grows_at_once);
+  RUN_TEST(test_long_lag_grows_to_the_margin);
+  RUN_TEST(test_quiet_windows_shrink_one_at_a_time);
+  RUN_TEST(test_unknown_lag_never_shrinks);
+  RUN_TEST(test_limits_hold);
+  return UNITY_END();
+}
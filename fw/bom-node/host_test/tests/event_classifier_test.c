@@ -0,0 +1,105 @@
+#include "event_classifier.h"
+#include "unity.h"
+
+#include <stdint.h>
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+#define HIDDEN 2
+
+static uint8_t blob[EVENT_CLASSIFIER_BLOB_BYTES(HIDDEN)];
+static size_t blob_len;
+
+static void put(const void *src, size_t len) {
+  memcpy(blob + blob_len, src, len);
+  blob_len += len;
+}
+
+// Unit 0 follows the top octave, unit 1 the crest factor negated; the logit
+// is their difference, and events score above 40 when the top band is loud.
+static void build_blob(uint32_t magic, float scale0) {
+  const uint32_t hidden = HIDDEN;
+  float offset[EVENT_CLASSIFIER_INPUTS] = {0};
+  float scale[EVENT_CLASSIFIER_INPUTS];
+  for (int i = 0; i < EVENT_CLASSIFIER_INPUTS; i++) {
+    scale[i] = 1.0f;
+  }
+  scale[0] = scale0;
+  const float m1 = 0.5f, m2 = 1.0f, threshold = 40.0f;
+  const int32_t b2 = 0;
+  const int32_t b1[HIDDEN] = {128, 0};
+  int8_t w1[HIDDEN][EVENT_CLASSIFIER_INPUTS] = {{0}};
+  w1[0][7] = 1;
+  w1[1][EVENT_FEATURE_BANDS + 2] = -1;
+  const int8_t w2[HIDDEN] = {1, -1};
+
+  blob_len = 0;
+  put(&magic, 4);
+  put(&hidden, 4);
+  put(offset, sizeof(offset));
+  put(scale, sizeof(scale));
+  put(&m1, 4);
+  put(&m2, 4);
+  put(&threshold, 4);
+  put(&b2, 4);
+  put(b1, sizeof(b1));
+  put(w1, sizeof(w1));
+  put(w2, sizeof(w2));
+}
+
+static event_features features(float top_db, float crest_db) {
+  event_features f = {0};
+  for (int b = 0; b < EVENT_FEATURE_BANDS; b++) {
+    f.band_db[b] = -60.0f;
+  }
+  f.band_db[7] = top_db;
+  f.peak_to_rms_db = crest_db;
+  return f;
+}
+
+static void test_scores_follow_the_model(void) {
+  build_blob(EVENT_CLASSIFIER_MAGIC, 1.0f);
+  TEST_ASSERT_EQUAL_size_t(sizeof(blob), blob_len);
+  event_classifier c;
+  TEST_ASSERT_TRUE(event_classifier_load(&c, blob, blob_len));
+  TEST_ASSERT_EQUAL_INT(HIDDEN, c.hidden);
+
+  event_features f = features(-20.0f, 12.0f);
+  // (128 - 20) * 0.5 = 54 from unit 0; unit 1 is clipped at zero by ReLU.
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 54.0f, event_classifier_score(&c, &f));
+  f = features(-60.0f, 12.0f);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 34.0f, event_classifier_score(&c, &f));
+  TEST_ASSERT_TRUE(event_classifier_score(&c, &f) < c.threshold);
+}
+
+static void test_inputs_and_units_saturate(void) {
+  build_blob(EVENT_CLASSIFIER_MAGIC, 1.0f);
+  event_classifier c;
+  TEST_ASSERT_TRUE(event_classifier_load(&c, blob, blob_len));
+  // +300 dB quantizes to 127 and (128 + 127) * 0.5 rounds to 128, held at
+  // 127; the negated crest of -200 dB saturates at 127 again.
+  event_features f = features(300.0f, -200.0f);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 127.0f - 64.0f,
+                           event_classifier_score(&c, &f));
+}
+
+static void test_rejects_malformed_blobs(void) {
+  event_classifier c;
+  build_blob(EVENT_CLASSIFIER_MAGIC ^ 1, 1.0f);
+  TEST_ASSERT_FALSE(event_classifier_load(&c, blob, blob_len));
+  build_blob(EVENT_CLASSIFIER_MAGIC, 1.0f);
+  TEST_ASSERT_FALSE(event_classifier_load(&c, blob, blob_len - 1));
+  TEST_ASSERT_FALSE(event_classifier_load(&c, blob, 6));
+  build_blob(EVENT_CLASSIFIER_MAGIC, 0.0f);
+  TEST_ASSERT_FALSE(event_classifier_load(&c, blob, blob_len));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_scores_follow_the_model);
+  RUN_TEST(test_inputs_and_units_saturate);
+  RUN_TEST(test_rejects_malformed_blobs);
+  return UNITY_END();
+}
@@ -0,0 +1,94 @@
+#include "event_features.h"
+#include "unity.h"
+
+#include <math.h>
+#include <stdint.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+#define RATE 48000
+#define N EVENT_FEATURE_FFT_N
+
+static int16_t samples[N];
+static float work[EVENT_FEATURE_WORK_FLOATS];
+
+// Bin-centred, so the whole tone lands in one octave band.
+static void fill_tone(int bin, float amplitude) {
+  for (int i = 0; i < N; i++) {
+    samples[i] = (int16_t)lrintf(amplitude * 32767.0f *
+                                 sinf(2.0f * 3.14159265f * bin * i / N));
+  }
+}
+
+static void test_tone_lands_in_its_band(void) {
+  fill_tone(96, 1.0f); // 4.5 kHz, band 5: bins [64, 128)
+  event_features f;
+  event_features_compute(samples, N, RATE, work, &f);
+
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 0.0f, f.band_db[5]);
+  for (int b = 0; b < EVENT_FEATURE_BANDS; b++) {
+    if (b != 5) {
+      TEST_ASSERT_TRUE(f.band_db[b] < -30.0f);
+    }
+  }
+  TEST_ASSERT_FLOAT_WITHIN(50.0f, 4500.0f, f.centroid_hz);
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, 3.01f, f.peak_to_rms_db); // sqrt(2)
+}
+
+static void test_half_scale_is_six_db_down(void) {
+  fill_tone(300, 0.5f); // band 7
+  event_features f;
+  event_features_compute(samples, N, RATE, work, &f);
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, -6.02f, f.band_db[7]);
+}
+
+static void test_impulse_rise_and_crest(void) {
+  for (int i = 0; i < N; i++) {
+    samples[i] = 0;
+  }
+  // A 10-sample ramp up to full scale at the analysis peak position.
+  const int peak = EVENT_FEATURE_PRE;
+  for (int k = 0; k <= 10; k++) {
+    samples[peak - 10 + k] = (int16_t)(3000 * k);
+  }
+  event_features f;
+  event_features_compute(samples, N, RATE, work, &f);
+  // 10 % of 30000 is first reached one step into the ramp: 9 samples.
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, 9 * 1e6f / RATE, f.rise_us);
+  TEST_ASSERT_TRUE(f.peak_to_rms_db > 15.0f);
+  // Broadband: the top octave gets energy too.
+  TEST_ASSERT_TRUE(f.band_db[7] > -100.0f);
+}
+
+static void test_short_window_is_zero_padded(void) {
+  fill_tone(96, 1.0f);
+  event_features f;
+  event_features_compute(samples, N / 2, RATE, work, &f);
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, 0.0f, f.band_db[5]);
+  TEST_ASSERT_FLOAT_WITHIN(100.0f, 4500.0f, f.centroid_hz);
+}
+
+static void test_silence(void) {
+  for (int i = 0; i < N; i++) {
+    samples[i] = 0;
+  }
+  event_features f;
+  event_features_compute(samples, N, RATE, work, &f);
+  for (int b = 0; b < EVENT_FEATURE_BANDS; b++) {
+    TEST_ASSERT_FLOAT_WITHIN(0.0f, -120.0f, f.band_db[b]);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.0f, 0.0f, f.centroid_hz);
+  TEST_ASSERT_FLOAT_WITHIN(0.0f, 0.0f, f.rise_us);
+  TEST_ASSERT_FLOAT_WITHIN(0.0f, 0.0f, f.peak_to_rms_db);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_tone_lands_in_its_band);
+  RUN_TEST(test_half_scale_is_six_db_down);
+  RUN_TEST(test_impulse_rise_and_crest);
+  RUN_TEST(test_short_window_is_zero_padded);
+  RUN_TEST(test_silence);
+  return UNITY_END();
+}
@@ -0,0 +1,325 @@
+#include "event_log.h"
+#include "unity.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define SECTORS 4
+
+// NOR flash model: erase sets bytes to 0xff, writes can only clear bits.
+static uint8_t flash_mem[SECTORS * EVENT_LOG_SECTOR_SIZE];
+static int fail_writes_after = -1; // writes left before they start failing
+static int bit_set_violations = 0;
+
+static int ram_read(void *ctx, uint32_t offset, void *dst, size_t len) {
+  (void)ctx;
+  if (offset + len > sizeof(flash_mem))
+    return -1;
+  memcpy(dst, &flash_mem[offset], len);
+  return 0;
+}
+
+static int ram_write(void *ctx, uint32_t offset, const void *src, size_t len) {
+  (void)ctx;
+  if (offset + len > sizeof(flash_mem))
+    return -1;
+  if (fail_writes_after == 0)
+    return -1;
+  if (fail_writes_after > 0)
+    fail_writes_after--;
+  const uint8_t *s = src;
+  for (size_t i = 0; i < len; i++) {
+    if (s[i] & ~flash_mem[offset + i])
+      bit_set_violations++;
+    flash_mem[offset + i] &= s[i];
+  }
+  return 0;
+}
+
+static int ram_erase(void *ctx, uint32_t offset) {
+  (void)ctx;
+  if (offset % EVENT_LOG_SECTOR_SIZE || offset >= sizeof(flash_mem))
+    return -1;
+  memset(&flash_mem[offset], 0xff, EVENT_LOG_SECTOR_SIZE);
+  return 0;
+}
+
+static const event_log_flash flash = {
+    .read = ram_read,
+    .write = ram_write,
+    .erase_sector = ram_erase,
+    .ctx = NULL,
+};
+
+static event_log log_a;
+static event_log log_b;
+
+void setUp(void) {
+  memset(flash_mem, 0xff, sizeof(flash_mem));
+  fail_writes_after = -1;
+  bit_set_violations = 0;
+}
+
+void tearDown(void) { TEST_ASSERT_EQUAL_INT(0, bit_set_violations); }
+
+// Records of `len` bytes whose content encodes `id`.
+static void make_record(uint8_t *buf, size_t len, uint32_t id) {
+  for (size_t i = 0; i < len; i++)
+    buf[i] = (uint8_t)(id * 31u + i);
+}
+
+static void append_records(event_log *log, uint32_t first, int n, size_t len) {
+  uint8_t buf[EVENT_LOG_MAX_RECORD];
+  for (int i = 0; i < n; i++) {
+    make_record(buf, len, first + (uint32_t)i);
+    TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_append(log, buf, len));
+  }
+}
+
+static void expect_next(event_log *log, event_log_cursor *cur, uint32_t id,
+                        size_t len) {
+  uint8_t want[EVENT_LOG_MAX_RECORD];
+  uint8_t got[EVENT_LOG_MAX_RECORD];
+  size_t got_len = 0;
+  make_record(want, len, id);
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK,
+                        event_log_next(log, cur, got, sizeof(got), &got_len));
+  TEST_ASSERT_EQUAL_UINT(len, got_len);
+  TEST_ASSERT_EQUAL_MEMORY(want, got, len);
+}
+
+void test_empty_log_has_nothing_to_replay(void) {
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_a, &flash, SECTORS));
+  TEST_ASSERT_EQUAL_UINT32(0, event_log_pending(&log_a));
+  event_log_cursor cur;
+  event_log_rewind(&log_a, &cur);
+  uint8_t buf[8];
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_EMPTY,
+                        event_log_next(&log_a, &cur, buf, sizeof(buf), NULL));
+}
+
+void test_rejects_bad_arguments(void) {
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_ERR_INVALID_ARG,
+                        event_log_open(&log_a, &flash, 1));
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_a, &flash, SECTORS));
+  static uint8_t big[EVENT_LOG_MAX_RECORD + 1];
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_ERR_TOO_LARGE,
+                        event_log_append(&log_a, big, sizeof(big)));
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK,
+                        event_log_append(&log_a, big, EVENT_LOG_MAX_RECORD));
+}
+
+void test_records_are_staged_until_flush(void) {
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_a, &flash, SECTORS));
+  append_records(&log_a, 0, 3, 101);
+  TEST_ASSERT_EQUAL_UINT32(0, event_log_pending(&log_a));
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_a));
+  TEST_ASSERT_EQUAL_UINT32(3, event_log_pending(&log_a));
+
+  event_log_cursor cur;
+  event_log_rewind(&log_a, &cur);
+  for (uint32_t id = 0; id < 3; id++)
+    expect_next(&log_a, &cur, id, 101);
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_EMPTY,
+                        event_log_next(&log_a, &cur, NULL, 0, NULL));
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_commit(&log_a, &cur));
+  TEST_ASSERT_EQUAL_UINT32(0, event_log_pending(&log_a));
+}
+
+void test_full_stage_spills_into_next_sector(void) {
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_a, &flash, SECTORS));
+  // Three 1500-byte records do not fit one sector.
+  append_records(&log_a, 0, 3, 1500);
+  TEST_ASSERT_EQUAL_UINT32(2, event_log_pending(&log_a));
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_a));
+  TEST_ASSERT_EQUAL_UINT32(3, event_log_pending(&log_a));
+
+  event_log_cursor cur;
+  event_log_rewind(&log_a, &cur);
+  for (uint32_t id = 0; id < 3; id++)
+    expect_next(&log_a, &cur, id, 1500);
+}
+
+void test_backlog_survives_reopen(void) {
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_a, &flash, SECTORS));
+  append_records(&log_a, 10, 2, 3000);
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_a));
+
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_b, &flash, SECTORS));
+  TEST_ASSERT_EQUAL_UINT32(2, event_log_pending(&log_b));
+  event_log_cursor cur;
+  event_log_rewind(&log_b, &cur);
+  expect_next(&log_b, &cur, 10, 3000);
+  expect_next(&log_b, &cur, 11, 3000);
+
+  // New sectors continue after the old head.
+  append_records(&log_b, 12, 1, 3000);
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_b));
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_commit(&log_b, &cur));
+  TEST_ASSERT_EQUAL_UINT32(1, event_log_pending(&log_b));
+  event_log_rewind(&log_b, &cur);
+  expect_next(&log_b, &cur, 12, 3000);
+}
+
+void test_commit_is_durable_per_sector(void) {
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_a, &flash, SECTORS));
+  append_records(&log_a, 0, 2, 100); // sector 0: records 0, 1
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_a));
+  append_records(&log_a, 2, 2, 100); // sector 1: records 2, 3
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_a));
+
+  event_log_cursor cur;
+  event_log_rewind(&log_a, &cur);
+  expect_next(&log_a, &cur, 0, 100);
+  expect_next(&log_a, &cur, 1, 100);
+  expect_next(&log_a, &cur, 2, 100);
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_commit(&log_a, &cur));
+  TEST_ASSERT_EQUAL_UINT32(1, event_log_pending(&log_a));
+
+  // After a reboot the half-read sector is replayed whole.
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_b, &flash, SECTORS));
+  TEST_ASSERT_EQUAL_UINT32(2, event_log_pending(&log_b));
+  event_log_rewind(&log_b, &cur);
+  expect_next(&log_b, &cur, 2, 100);
+  expect_next(&log_b, &cur, 3, 100);
+}
+
+void test_uncommitted_reads_are_replayed(void) {
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_a, &flash, SECTORS));
+  append_records(&log_a, 0, 2, 64);
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_a));
+
+  event_log_cursor cur;
+  event_log_rewind(&log_a, &cur);
+  expect_next(&log_a, &cur, 0, 64);
+  // Upload failed: no commit, the next rewind starts over.
+  event_log_rewind(&log_a, &cur);
+  expect_next(&log_a, &cur, 0, 64);
+  expect_next(&log_a, &cur, 1, 64);
+}
+
+void test_full_ring_drops_oldest_sector(void) {
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_a, &flash, SECTORS));
+  for (uint32_t id = 0; id < SECTORS + 2; id++) {
+    append_records(&log_a, id, 1, 3000);
+    TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_a));
+  }
+  TEST_ASSERT_EQUAL_UINT32(2, log_a.lost);
+  TEST_ASSERT_EQUAL_UINT32(SECTORS, event_log_pending(&log_a));
+
+  event_log_cursor cur;
+  event_log_rewind(&log_a, &cur);
+  for (uint32_t id = 2; id < SECTORS + 2; id++)
+    expect_next(&log_a, &cur, id, 3000);
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_EMPTY,
+                        event_log_next(&log_a, &cur, NULL, 0, NULL));
+
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_b, &flash, SECTORS));
+  TEST_ASSERT_EQUAL_UINT32(SECTORS, event_log_pending(&log_b));
+  event_log_rewind(&log_b, &cur);
+  expect_next(&log_b, &cur, 2, 3000);
+}
+
+void test_partly_read_tail_sector_counts_only_unread_as_lost(void) {
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_a, &flash, SECTORS));
+  append_records(&log_a, 0, 2, 100);
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_a));
+  for (uint32_t id = 2; id < 2 + SECTORS - 1; id++) {
+    append_records(&log_a, id, 1, 100);
+    TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_a));
+  }
+  event_log_cursor cur;
+  event_log_rewind(&log_a, &cur);
+  expect_next(&log_a, &cur, 0, 100);
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_commit(&log_a, &cur));
+
+  append_records(&log_a, 100, 1, 100);
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_a));
+  TEST_ASSERT_EQUAL_UINT32(1, log_a.lost);
+  event_log_rewind(&log_a, &cur);
+  for (uint32_t id = 2; id < 2 + SECTORS - 1; id++)
+    expect_next(&log_a, &cur, id, 100);
+  expect_next(&log_a, &cur, 100, 100);
+}
+
+void test_overwrite_makes_outstanding_cursor_stale(void) {
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_a, &flash, SECTORS));
+  for (uint32_t id = 0; id < SECTORS; id++) {
+    append_records(&log_a, id, 1, 3000);
+    TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_a));
+  }
+  event_log_cursor cur;
+  event_log_rewind(&log_a, &cur);
+  expect_next(&log_a, &cur, 0, 3000);
+  expect_next(&log_a, &cur, 1, 3000);
+
+  append_records(&log_a, SECTORS, 1, 3000);
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_a));
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_ERR_STALE, event_log_commit(&log_a, &cur));
+  TEST_ASSERT_EQUAL_UINT32(SECTORS, event_log_pending(&log_a));
+}
+
+void test_torn_sector_is_ignored(void) {
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_a, &flash, SECTORS));
+  append_records(&log_a, 0, 1, 200);
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_a));
+  // Payload lands, the header write does not.
+  append_records(&log_a, 1, 1, 200);
+  fail_writes_after = 1;
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_ERR_FLASH, event_log_flush(&log_a));
+  fail_writes_after = -1;
+
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_b, &flash, SECTORS));
+  TEST_ASSERT_EQUAL_UINT32(1, event_log_pending(&log_b));
+  event_log_cursor cur;
+  event_log_rewind(&log_b, &cur);
+  expect_next(&log_b, &cur, 0, 200);
+}
+
+void test_corrupt_sector_is_skipped_on_open(void) {
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_a, &flash, SECTORS));
+  append_records(&log_a, 0, 1, 200);
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_a));
+  append_records(&log_a, 1, 1, 200);
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_a));
+  flash_mem[EVENT_LOG_HEADER_SIZE + 50] ^= 0x10; // bit rot in sector 0
+
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_b, &flash, SECTORS));
+  TEST_ASSERT_EQUAL_UINT32(1, log_b.corrupt);
+  TEST_ASSERT_EQUAL_UINT32(1, event_log_pending(&log_b));
+  event_log_cursor cur;
+  event_log_rewind(&log_b, &cur);
+  expect_next(&log_b, &cur, 1, 200);
+}
+
+void test_short_buffer_skips_record(void) {
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_open(&log_a, &flash, SECTORS));
+  append_records(&log_a, 0, 2, 300);
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_OK, event_log_flush(&log_a));
+  event_log_cursor cur;
+  event_log_rewind(&log_a, &cur);
+  uint8_t small[16];
+  size_t len = 0;
+  TEST_ASSERT_EQUAL_INT(EVENT_LOG_ERR_TOO_LARGE,
+                        event_log_next(&log_a, &cur, small, sizeof(small), &len));
+  TEST_ASSERT_EQUAL_UINT(300, len);
+  expect_next(&log_a, &cur, 1, 300);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_log_has_nothing_to_replay);
+  RUN_TEST(test_rejects_bad_arguments);
+  RUN_TEST(test_records_are_staged_until_flush);
+  RUN_TEST(test_full_stage_spills_into_next_sector);
+  RUN_TEST(test_backlog_survives_reopen);
+  RUN_TEST(test_commit_is_durable_per_sector);
+  RUN_TEST(test_uncommitted_reads_are_replayed);
+  RUN_TEST(test_full_ring_drops_oldest_sector);
+  RUN_TEST(test_partly_read_tail_sector_counts_only_unread_as_lost);
+  RUN_TEST(test_overwrite_makes_outstanding_cursor_stale);
+  RUN_TEST(test_torn_sector_is_ignored);
+  RUN_TEST(test_corrupt_sector_is_skipped_on_open);
+  RUN_TEST(test_short_buffer_skips_record);
+  return UNITY_END();
+}
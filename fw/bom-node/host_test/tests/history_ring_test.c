@@ -0,0 +1,94 @@
+#include "history_ring.h"
+#include "unity.h"
+
+#include <stdint.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+#define CAP 50
+
+static int16_t storage[2 * CAP];
+
+// Appends samples [h->head, h->head + count): left carries the index, right
+// its negation.
+static void append(history_ring *h, int count) {
+  int16_t l[CAP], r[CAP];
+  for (int i = 0; i < count; i++) {
+    l[i] = (int16_t)(h->head + i);
+    r[i] = (int16_t)-(int16_t)(h->head + i);
+  }
+  history_ring_begin(h, count);
+  history_ring_store(h, l, r, count);
+  history_ring_end(h);
+}
+
+static void assert_range(const history_ring *h, uint64_t start, int length) {
+  int16_t l[CAP], r[CAP];
+  TEST_ASSERT_EQUAL(HISTORY_RING_OK, history_ring_check(h, start, length));
+  history_ring_read(h, start, length, l, r);
+  for (int i = 0; i < length; i++) {
+    TEST_ASSERT_EQUAL_INT16((int16_t)(start + i), l[i]);
+    TEST_ASSERT_EQUAL_INT16((int16_t)-(int16_t)(start + i), r[i]);
+  }
+}
+
+static void test_reads_across_the_wrap(void) {
+  history_ring h;
+  history_ring_attach(&h, storage, CAP);
+  history_ring_reset(&h, 1000);
+  for (int k = 0; k < 7; k++) {
+    append(&h, 17); // 119 samples: the ring wrapped twice
+  }
+  assert_range(&h, h.head - CAP, CAP);
+  assert_range(&h, h.head - 30, 25);
+  assert_range(&h, 1119 - 34, 1);
+}
+
+static void test_reports_pending_and_lost(void) {
+  history_ring h;
+  history_ring_attach(&h, storage, CAP);
+  history_ring_reset(&h, 500);
+  append(&h, 20);
+
+  TEST_ASSERT_EQUAL(HISTORY_RING_LOST, history_ring_check(&h, 499, 5));
+  TEST_ASSERT_EQUAL(HISTORY_RING_PENDING, history_ring_check(&h, 510, 20));
+  assert_range(&h, 500, 20);
+
+  append(&h, 40);
+  TEST_ASSERT_EQUAL(HISTORY_RING_LOST, history_ring_check(&h, 509, 5));
+  assert_range(&h, 510, 5);
+  TEST_ASSERT_EQUAL(HISTORY_RING_LOST, history_ring_check(&h, 510, CAP + 1));
+}
+
+static void test_write_in_progress_laps_reader(void) {
+  history_ring h;
+  history_ring_attach(&h, storage, CAP);
+  append(&h, CAP);
+  assert_range(&h, 0, 10);
+
+  // A reader that checked before this write started sees LOST afterwards.
+  history_ring_begin(&h, 5);
+  TEST_ASSERT_EQUAL(HISTORY_RING_LOST, history_ring_check(&h, 0, 10));
+  TEST_ASSERT_EQUAL(HISTORY_RING_OK, history_ring_check(&h, 5, 10));
+  TEST_ASSERT_EQUAL(HISTORY_RING_PENDING, history_ring_check(&h, 45, 10));
+}
+
+static void test_reset_forgets_old_samples(void) {
+  history_ring h;
+  history_ring_attach(&h, storage, CAP);
+  append(&h, 30);
+  history_ring_reset(&h, 7000);
+  TEST_ASSERT_EQUAL(HISTORY_RING_LOST, history_ring_check(&h, 10, 5));
+  append(&h, 12);
+  assert_range(&h, 7000, 12);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_reads_across_the_wrap);
+  RUN_TEST(test_reports_pending_and_lost);
+  RUN_TEST(test_write_in_progress_laps_reader);
+  RUN_TEST(test_reset_forgets_old_samples);
+  return UNITY_END();
+}
@@ -0,0 +1,231 @@
+#include "ima_adpcm.h"
+#include "unity.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+#define BLOCKS 8
+#define BLOCK_FRAMES IMA_ADPCM_BLOCK_FRAMES(2)
+#define FRAMES (BLOCKS * BLOCK_FRAMES)
+
+static int16_t pcm[FRAMES * 2];
+static int16_t decoded[FRAMES * 2];
+static uint8_t coded[BLOCKS * IMA_ADPCM_BLOCK_BYTES];
+static uint8_t coded_split[BLOCKS * IMA_ADPCM_BLOCK_BYTES];
+
+static const int16_t step_table[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,
+    19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+    337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+    876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+    5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+static const int8_t index_table[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+// Reference decoder for the WAVE 0x11 block layout, written from the format
+// description rather than from the encoder.
+static void decode_block_ch(const uint8_t *block, int channels, int16_t *out) {
+  const int block_frames = IMA_ADPCM_BLOCK_FRAMES(channels);
+  int32_t pred[2];
+  int index[2];
+  for (int ch = 0; ch < channels; ch++) {
+    pred[ch] = (int16_t)(block[4 * ch] | (block[4 * ch + 1] << 8));
+    index[ch] = block[4 * ch + 2];
+    out[ch] = (int16_t)pred[ch];
+  }
+  const uint8_t *data = block + 4 * channels;
+  for (int i = 0; i < block_frames - 1; i++) {
+    for (int ch = 0; ch < channels; ch++) {
+      uint8_t byte = data[(i / 8) * 4 * channels + ch * 4 + (i % 8) / 2];
+      uint8_t code = (i & 1) ? byte >> 4 : byte & 0x0f;
+      int32_t step = step_table[index[ch]];
+      int32_t delta = step >> 3;
+      if (code & 4)
+        delta += step;
+      if (code & 2)
+        delta += step >> 1;
+      if (code & 1)
+        delta += step >> 2;
+      pred[ch] += (code & 8) ? -delta : delta;
+      if (pred[ch] > INT16_MAX)
+        pred[ch] = INT16_MAX;
+      if (pred[ch] < INT16_MIN)
+        pred[ch] = INT16_MIN;
+      index[ch] += index_table[code & 7];
+      if (index[ch] < 0)
+        index[ch] = 0;
+      if (index[ch] > 88)
+        index[ch] = 88;
+      out[channels * (i + 1) + ch] = (int16_t)pred[ch];
+    }
+  }
+}
+
+static void decode_block(const uint8_t *block, int16_t *out) {
+  decode_block_ch(block, 2, out);
+}
+
+static void fill_sines(void) {
+  for (int i = 0; i < FRAMES; i++) {
+    pcm[2 * i] = (int16_t)lrint(12000.0 * sin(2.0 * M_PI * 440.0 * i / 44100));
+    pcm[2 * i + 1] =
+        (int16_t)lrint(6000.0 * sin(2.0 * M_PI * 1250.0 * i / 44100));
+  }
+}
+
+static double snr_db(int ch) {
+  double sig = 0.0, err = 0.0;
+  for (int i = 0; i < FRAMES; i++) {
+    double s = pcm[2 * i + ch];
+    double e = s - decoded[2 * i + ch];
+    sig += s * s;
+    err += e * e;
+  }
+  return 10.0 * log10(sig / (err > 0.0 ? err : 1e-9));
+}
+
+void test_block_geometry_matches_wave_format(void) {
+  // Standard stereo geometry: 512-byte blocks of 505 frames.
+  TEST_ASSERT_EQUAL_INT(505, IMA_ADPCM_BLOCK_FRAMES(2));
+  // Mono: 4-byte header, then 508 bytes of codes.
+  TEST_ASSERT_EQUAL_INT(1017, IMA_ADPCM_BLOCK_FRAMES(1));
+  TEST_ASSERT_EQUAL_INT(512, IMA_ADPCM_MAX_BYTES(1));
+  TEST_ASSERT_EQUAL_INT(512, IMA_ADPCM_MAX_BYTES(505));
+  TEST_ASSERT_EQUAL_INT(1024, IMA_ADPCM_MAX_BYTES(506));
+}
+
+void test_roundtrip_sine_snr(void) {
+  fill_sines();
+  ima_adpcm_encoder enc;
+  ima_adpcm_init(&enc, 2);
+  size_t n = ima_adpcm_encode(&enc, pcm, FRAMES, coded);
+  TEST_ASSERT_EQUAL_UINT(sizeof(coded), n);
+  for (int b = 0; b < BLOCKS; b++) {
+    decode_block(&coded[b * IMA_ADPCM_BLOCK_BYTES],
+                 &decoded[b * BLOCK_FRAMES * 2]);
+  }
+  TEST_ASSERT_GREATER_THAN(25, (int)snr_db(0));
+  TEST_ASSERT_GREATER_THAN(25, (int)snr_db(1));
+}
+
+void test_block_header_carries_first_frame(void) {
+  fill_sines();
+  ima_adpcm_encoder enc;
+  ima_adpcm_init(&enc, 2);
+  ima_adpcm_encode(&enc, pcm, FRAMES, coded);
+  for (int b = 0; b < BLOCKS; b++) {
+    const uint8_t *blk = &coded[b * IMA_ADPCM_BLOCK_BYTES];
+    const int16_t *first = &pcm[b * BLOCK_FRAMES * 2];
+    TEST_ASSERT_EQUAL_INT16(first[0], (int16_t)(blk[0] | (blk[1] << 8)));
+    TEST_ASSERT_EQUAL_INT16(first[1], (int16_t)(blk[4] | (blk[5] << 8)));
+    TEST_ASSERT_LESS_OR_EQUAL(88, blk[2]);
+    TEST_ASSERT_EQUAL_UINT8(0, blk[3]);
+  }
+}
+
+void test_split_feed_matches_single_call(void) {
+  fill_sines();
+  ima_adpcm_encoder a, b;
+  ima_adpcm_init(&a, 2);
+  ima_adpcm_init(&b, 2);
+  size_t na = ima_adpcm_encode(&a, pcm, FRAMES, coded);
+
+  // Odd-sized pieces, as the pull path hands them over.
+  size_t nb = 0;
+  size_t pieces[] = {1, 127, 480, 3, 505, 1000};
+  size_t done = 0;
+  for (int k = 0; done < FRAMES; k = (k + 1) % 6) {
+    size_t take = pieces[k];
+    if (take > FRAMES - done)
+      take = FRAMES - done;
+    size_t out = ima_adpcm_encode(&b, &pcm[done * 2], take, &coded_split[nb]);
+    TEST_ASSERT_LESS_OR_EQUAL(IMA_ADPCM_MAX_BYTES(take), out);
+    nb += out;
+    done += take;
+  }
+  TEST_ASSERT_EQUAL_UINT(na, nb);
+  TEST_ASSERT_EQUAL_MEMORY(coded, coded_split, na);
+}
+
+void test_partial_block_is_held_back(void) {
+  fill_sines();
+  ima_adpcm_encoder enc;
+  ima_adpcm_init(&enc, 2);
+  TEST_ASSERT_EQUAL_UINT(0, ima_adpcm_encode(&enc, pcm, 504, coded));
+  TEST_ASSERT_EQUAL_UINT(512, ima_adpcm_encode(&enc, &pcm[504 * 2], 1, coded));
+  ima_adpcm_reset(&enc);
+  TEST_ASSERT_EQUAL_INT(0, enc.frames);
+}
+
+void test_mono_roundtrip(void) {
+  // The left channel of the stereo sines, packed as mono.
+  fill_sines();
+  static int16_t mono[FRAMES];
+  static int16_t mono_decoded[FRAMES];
+  for (int i = 0; i < FRAMES; i++) {
+    mono[i] = pcm[2 * i];
+  }
+  ima_adpcm_encoder enc;
+  ima_adpcm_init(&enc, 1);
+  const int blocks = FRAMES / IMA_ADPCM_BLOCK_FRAMES(1);
+  size_t n = ima_adpcm_encode(&enc, mono, FRAMES, coded);
+  TEST_ASSERT_EQUAL_UINT(blocks * IMA_ADPCM_BLOCK_BYTES, n);
+  TEST_ASSERT_EQUAL_INT(FRAMES - blocks * IMA_ADPCM_BLOCK_FRAMES(1),
+                        enc.frames);
+  for (int b = 0; b < blocks; b++) {
+    decode_block_ch(&coded[b * IMA_ADPCM_BLOCK_BYTES], 1,
+                    &mono_decoded[b * IMA_ADPCM_BLOCK_FRAMES(1)]);
+  }
+  double sig = 0.0, err = 0.0;
+  for (int i = 0; i < blocks * IMA_ADPCM_BLOCK_FRAMES(1); i++) {
+    double e = mono[i] - mono_decoded[i];
+    sig += (double)mono[i] * mono[i];
+    err += e * e;
+  }
+  TEST_ASSERT_GREATER_THAN(25, (int)(10.0 * log10(sig / err)));
+
+  // A reset starts over with the same channel count.
+  ima_adpcm_reset(&enc);
+  TEST_ASSERT_EQUAL_INT(1, enc.channels);
+  TEST_ASSERT_EQUAL_INT(0, enc.frames);
+}
+
+void test_full_scale_square_does_not_wrap(void) {
+  for (int i = 0; i < FRAMES; i++) {
+    int16_t v = ((i / 20) & 1) ? INT16_MAX : INT16_MIN;
+    pcm[2 * i] = v;
+    pcm[2 * i + 1] = (int16_t)-v - 1;
+  }
+  ima_adpcm_encoder enc;
+  ima_adpcm_init(&enc, 2);
+  ima_adpcm_encode(&enc, pcm, FRAMES, coded);
+  for (int b = 0; b < BLOCKS; b++) {
+    decode_block(&coded[b * IMA_ADPCM_BLOCK_BYTES],
+                 &decoded[b * BLOCK_FRAMES * 2]);
+  }
+  // Sign agreement away from the edges: a wrapped predictor would flip it.
+  for (int i = 0; i < FRAMES; i++) {
+    if (i % 20 < 10)
+      continue;
+    TEST_ASSERT_TRUE((pcm[2 * i] > 0) == (decoded[2 * i] > 0));
+  }
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_block_geometry_matches_wave_format);
+  RUN_TEST(test_roundtrip_sine_snr);
+  RUN_TEST(test_block_header_carries_first_frame);
+  RUN_TEST(test_split_feed_matches_single_call);
+  RUN_TEST(test_partial_block_is_held_back);
+  RUN_TEST(test_mono_roundtrip);
+  RUN_TEST(test_full_scale_square_does_not_wrap);
+  return UNITY_END();
+}
@@ -0,0 +1,120 @@
+#include "json_reader.h"
+#include "unity.h"
+
+#include <stdint.h>
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static json_token_t tokens[32];
+
+static json_reader_err_t parse(json_doc_t *doc, const char *js) {
+  return json_reader_parse(doc, js, strlen(js), tokens, 32);
+}
+
+void test_members_are_found_past_nested_values(void) {
+  json_doc_t doc;
+  TEST_ASSERT_EQUAL_INT(
+      JSON_READER_OK,
+      parse(&doc, " {\"a\": [1, {\"x\": [2, 3]}], \"b\" : {}, \"c\": \"v\"} "));
+  TEST_ASSERT_TRUE(json_reader_is(&doc, 0, JSON_TOKEN_OBJECT));
+  TEST_ASSERT_EQUAL_UINT(3, doc.tokens[0].size);
+  TEST_ASSERT_EQUAL_UINT(2, doc.tokens[json_reader_find(&doc, 0, "a")].size);
+  TEST_ASSERT_TRUE(
+      json_reader_is(&doc, json_reader_find(&doc, 0, "b"), JSON_TOKEN_OBJECT));
+  char s[8];
+  TEST_ASSERT_TRUE(
+      json_reader_string(&doc, json_reader_find(&doc, 0, "c"), s, sizeof(s)));
+  TEST_ASSERT_EQUAL_INT(0, strcmp("v", s));
+  TEST_ASSERT_EQUAL_INT(-1, json_reader_find(&doc, 0, "x"));
+  TEST_ASSERT_EQUAL_INT(doc.count, json_reader_next(&doc, 0));
+}
+
+void test_typed_values(void) {
+  json_doc_t doc;
+  TEST_ASSERT_EQUAL_INT(
+      JSON_READER_OK,
+      parse(&doc, "{\"i\":-12,\"f\":2.0,\"h\":2.5,\"e\":1e3,\"t\":true,"
+                  "\"n\":null,\"big\":3000000000}"));
+  int i = 0;
+  TEST_ASSERT_TRUE(json_reader_int(&doc, json_reader_find(&doc, 0, "i"), &i));
+  TEST_ASSERT_EQUAL_INT(-12, i);
+  TEST_ASSERT_TRUE(json_reader_int(&doc, json_reader_find(&doc, 0, "f"), &i));
+  TEST_ASSERT_EQUAL_INT(2, i);
+  TEST_ASSERT_TRUE(json_reader_int(&doc, json_reader_find(&doc, 0, "e"), &i));
+  TEST_ASSERT_EQUAL_INT(1000, i);
+  TEST_ASSERT_FALSE(json_reader_int(&doc, json_reader_find(&doc, 0, "h"), &i));
+  TEST_ASSERT_FALSE(
+      json_reader_int(&doc, json_reader_find(&doc, 0, "big"), &i));
+  double d = 0.0;
+  TEST_ASSERT_TRUE(
+      json_reader_double(&doc, json_reader_find(&doc, 0, "h"), &d));
+  TEST_ASSERT_TRUE(d == 2.5);
+  bool b = false;
+  TEST_ASSERT_TRUE(json_reader_bool(&doc, json_reader_find(&doc, 0, "t"), &b));
+  TEST_ASSERT_TRUE(b);
+  TEST_ASSERT_FALSE(json_reader_bool(&doc, json_reader_find(&doc, 0, "n"), &b));
+  TEST_ASSERT_TRUE(
+      json_reader_is(&doc, json_reader_find(&doc, 0, "n"), JSON_TOKEN_NULL));
+  // Missing members chain through as -1.
+  TEST_ASSERT_FALSE(json_reader_int(&doc, json_reader_find(&doc, 0, "z"), &i));
+  TEST_ASSERT_EQUAL_INT(1000, i);
+}
+
+void test_string_escapes_and_capacity(void) {
+  json_doc_t doc;
+  TEST_ASSERT_EQUAL_INT(
+      JSON_READER_OK,
+      parse(&doc, "[\"a\\\"b\\\\\\/\\n\", \"\\u00e9\\u20ac\\ud83d\\ude00\","
+                  "\"abcd\", \"\\u0000\"]"));
+  char s[16];
+  TEST_ASSERT_TRUE(json_reader_string(&doc, 1, s, sizeof(s)));
+  TEST_ASSERT_EQUAL_INT(0, strcmp("a\"b\\/\n", s));
+  TEST_ASSERT_TRUE(json_reader_string(&doc, 2, s, sizeof(s)));
+  TEST_ASSERT_EQUAL_INT(0, strcmp("\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80", s));
+  TEST_ASSERT_TRUE(json_reader_string(&doc, 3, s, 5));
+  TEST_ASSERT_EQUAL_INT(0, strcmp("abcd", s));
+  TEST_ASSERT_FALSE(json_reader_string(&doc, 3, s, 4));
+  TEST_ASSERT_FALSE(json_reader_string(&doc, 4, s, sizeof(s)));
+}
+
+void test_malformed_documents_are_rejected(void) {
+  static const char *const bad[] = {
+      "",          "{",          "{\"a\":}",     "{\"a\":1,}", "[1 2]",
+      "{a:1}",     "\"open",     "\"\\x\"",      "01",         "1.",
+      "-",         "tru",        "{\"a\":1} x",  "\"\\u12g4\"", "[\"\t\"]",
+  };
+  json_doc_t doc;
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    TEST_ASSERT_EQUAL_INT(JSON_READER_ERR_SYNTAX, parse(&doc, bad[i]));
+  }
+}
+
+void test_limits_are_reported(void) {
+  json_doc_t doc;
+  TEST_ASSERT_EQUAL_INT(JSON_READER_ERR_TOKENS,
+                        json_reader_parse(&doc, "[1,2,3]", 7, tokens, 3));
+  char deep[2 * JSON_READER_MAX_DEPTH + 3];
+  size_t n = 0;
+  for (int i = 0; i <= JSON_READER_MAX_DEPTH; i++) {
+    deep[n++] = '[';
+  }
+  for (int i = 0; i <= JSON_READER_MAX_DEPTH; i++) {
+    deep[n++] = ']';
+  }
+  TEST_ASSERT_EQUAL_INT(JSON_READER_ERR_DEPTH,
+                        json_reader_parse(&doc, deep, n, tokens, 32));
+  TEST_ASSERT_EQUAL_INT(JSON_READER_OK,
+                        json_reader_parse(&doc, deep + 1, n - 2, tokens, 32));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_members_are_found_past_nested_values);
+  RUN_TEST(test_typed_values);
+  RUN_TEST(test_string_escapes_and_capacity);
+  RUN_TEST(test_malformed_documents_are_rejected);
+  RUN_TEST(test_limits_are_reported);
+  return UNITY_END();
+}
@@ -0,0 +1,103 @@
+#include "json_writer.h"
+#include "unity.h"
+
+#include <stdint.h>
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static char buf[256];
+
+static void assert_doc(const char *expected, json_writer_t *w) {
+  size_t len = 0;
+  const char *doc = json_writer_finish(w, &len);
+  TEST_ASSERT_NOT_NULL(doc);
+  TEST_ASSERT_EQUAL_size_t(strlen(expected), len);
+  TEST_ASSERT_EQUAL_INT(0, strcmp(expected, doc));
+}
+
+void test_nested_members_and_commas(void) {
+  json_writer_t w;
+  json_writer_init(&w, buf, sizeof(buf));
+  json_writer_object_begin(&w, NULL);
+  json_writer_bool(&w, "on", true);
+  json_writer_object_begin(&w, "empty");
+  json_writer_object_end(&w);
+  json_writer_array_begin(&w, "list");
+  json_writer_uint(&w, NULL, 1);
+  json_writer_object_begin(&w, NULL);
+  json_writer_null(&w, "x");
+  json_writer_object_end(&w);
+  json_writer_array_begin(&w, NULL);
+  json_writer_array_end(&w);
+  json_writer_array_end(&w);
+  json_writer_string(&w, "s", "v");
+  json_writer_object_end(&w);
+  assert_doc("{\"on\":true,\"empty\":{},\"list\":[1,{\"x\":null},[]],\"s\":\"v\"}",
+             &w);
+}
+
+void test_numbers(void) {
+  json_writer_t w;
+  json_writer_init(&w, buf, sizeof(buf));
+  json_writer_array_begin(&w, NULL);
+  json_writer_int(&w, NULL, 0);
+  json_writer_int(&w, NULL, -42);
+  json_writer_int(&w, NULL, INT64_MIN);
+  json_writer_uint(&w, NULL, UINT64_MAX);
+  json_writer_double(&w, NULL, 12.0);
+  json_writer_double(&w, NULL, -0.25);
+  json_writer_double(&w, NULL, 1.0 / 0.0);
+  json_writer_double(&w, NULL, 0.0 / 0.0);
+  json_writer_double(&w, NULL, 1e300);
+  json_writer_double(&w, NULL, 0.1);
+  json_writer_double(&w, NULL, 0.1 + 0.2);
+  json_writer_array_end(&w);
+  assert_doc("[0,-42,-9223372036854775808,18446744073709551615,12,-0.25,null,"
+             "null,1e+300,0.1,0.30000000000000004]",
+             &w);
+}
+
+void test_string_escapes(void) {
+  json_writer_t w;
+  json_writer_init(&w, buf, sizeof(buf));
+  json_writer_string(&w, NULL, "a\"b\\c\nd\x01");
+  assert_doc("\"a\\\"b\\\\c\\nd\\u0001\"", &w);
+}
+
+void test_overflow_is_reported(void) {
+  char small[8];
+  json_writer_t w;
+  json_writer_init(&w, small, sizeof(small));
+  json_writer_object_begin(&w, NULL);
+  json_writer_string(&w, "key", "value");
+  json_writer_object_end(&w);
+  TEST_ASSERT_NULL(json_writer_finish(&w, NULL));
+
+  // Exactly full: seven characters and the NUL.
+  json_writer_init(&w, small, sizeof(small));
+  json_writer_string(&w, NULL, "abcde");
+  assert_doc("\"abcde\"", &w);
+}
+
+void test_unbalanced_document_is_rejected(void) {
+  json_writer_t w;
+  json_writer_init(&w, buf, sizeof(buf));
+  json_writer_object_begin(&w, NULL);
+  TEST_ASSERT_NULL(json_writer_finish(&w, NULL));
+
+  json_writer_init(&w, buf, sizeof(buf));
+  json_writer_array_end(&w);
+  TEST_ASSERT_NULL(json_writer_finish(&w, NULL));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_nested_members_and_commas);
+  RUN_TEST(test_numbers);
+  RUN_TEST(test_string_escapes);
+  RUN_TEST(test_overflow_is_reported);
+  RUN_TEST(test_unbalanced_document_is_rejected);
+  return UNITY_END();
+}
@@ -0,0 +1,79 @@
+#include "median_sorted_col.h"
+#include "unity.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static int cmp_val(const void *a, const void *b) {
+  sorted_col_val x = *(const sorted_col_val *)a;
+  sorted_col_val y = *(const sorted_col_val *)b;
+  return (x > y) - (x < y);
+}
+
+static sorted_col_val next_value(uint32_t *seed) {
+  *seed = *seed * 1664525u + 1013904223u;
+  // Narrow range so duplicates are frequent.
+  return (sorted_col_val)((*seed >> 16) % 23u);
+}
+
+static void check_against_qsort(uint16_t n) {
+  uint32_t seed = 1234u + n;
+  sorted_col_val hist[128];
+  sorted_col_val col[128];
+  sorted_col_val ref[128];
+
+  for (uint16_t k = 0; k < n; k++) {
+    hist[k] = next_value(&seed);
+    sorted_col_insert(col, k, hist[k]);
+  }
+
+  for (int step = 0; step < 2000; step++) {
+    uint16_t evict = (uint16_t)(step % n);
+    sorted_col_val v = next_value(&seed);
+    sorted_col_replace(col, n, hist[evict], v);
+    hist[evict] = v;
+
+    memcpy(ref, hist, n * sizeof(sorted_col_val));
+    qsort(ref, n, sizeof(sorted_col_val), cmp_val);
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(ref, col, n);
+  }
+}
+
+static void test_replace_keeps_column_sorted_31(void) { check_against_qsort(31); }
+static void test_replace_keeps_column_sorted_63(void) { check_against_qsort(63); }
+static void test_replace_keeps_column_sorted_127(void) {
+  check_against_qsort(127);
+}
+
+static void test_replace_missing_value_is_noop(void) {
+  sorted_col_val col[5] = {1, 3, 5, 7, 9};
+  sorted_col_val want[5] = {1, 3, 5, 7, 9};
+  sorted_col_replace(col, 5, 4, 100);
+  TEST_ASSERT_EQUAL_UINT16_ARRAY(want, col, 5);
+  sorted_col_replace(col, 5, 10, 0);
+  TEST_ASSERT_EQUAL_UINT16_ARRAY(want, col, 5);
+}
+
+static void test_replace_to_ends(void) {
+  sorted_col_val col[5] = {1, 3, 5, 7, 9};
+  sorted_col_replace(col, 5, 5, 100);
+  sorted_col_val want_hi[5] = {1, 3, 7, 9, 100};
+  TEST_ASSERT_EQUAL_UINT16_ARRAY(want_hi, col, 5);
+  sorted_col_replace(col, 5, 7, 0);
+  sorted_col_val want_lo[5] = {0, 1, 3, 9, 100};
+  TEST_ASSERT_EQUAL_UINT16_ARRAY(want_lo, col, 5);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_replace_keeps_column_sorted_31);
+  RUN_TEST(test_replace_keeps_column_sorted_63);
+  RUN_TEST(test_replace_keeps_column_sorted_127);
+  RUN_TEST(test_replace_missing_value_is_noop);
+  RUN_TEST(test_replace_to_ends);
+  return UNITY_END();
+}
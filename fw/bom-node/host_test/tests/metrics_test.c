@@ -0,0 +1,128 @@
+#include "metrics.h"
+#include "unity.h"
+
+#include <stdint.h>
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static char text[2048];
+static size_t text_len;
+
+static void sink(const char *data, size_t len, void *ctx) {
+  (void)ctx;
+  TEST_ASSERT_LESS_THAN(sizeof(text), text_len + len);
+  memcpy(&text[text_len], data, len);
+  text_len += len;
+  text[text_len] = '\0';
+}
+
+static const char *scrape(void) {
+  text_len = 0;
+  text[0] = '\0';
+  metrics_expose(sink, NULL);
+  return text;
+}
+
+static void assert_has(const char *line) {
+  if (strstr(text, line) == NULL) {
+    TEST_FAIL_MESSAGE(line);
+  }
+}
+
+static metrics_counter s_get =
+    METRICS_COUNTER_LABELED_INIT("test_requests_total", "Requests.",
+                                 "method=\"get\"");
+static metrics_counter s_post =
+    METRICS_COUNTER_LABELED_INIT("test_requests_total", "Requests.",
+                                 "method=\"post\"");
+static metrics_gauge s_level = METRICS_GAUGE_INIT("test_level", "Level.");
+static metrics_histogram s_lat =
+    METRICS_HISTOGRAM_INIT("test_latency_us", "Latency.", 10, 100, 1000);
+
+static void collect(metrics_out *out, void *ctx) {
+  metrics_out_family(out, "test_temperature", "gauge", NULL);
+  metrics_out_double(out, "test_temperature", "sensor=\"a\"", *(double *)ctx);
+}
+static double s_temperature = 21.5;
+static metrics_collector s_collector =
+    METRICS_COLLECTOR_INIT(collect, &s_temperature);
+
+void test_registration_is_idempotent(void) {
+  metrics_register(&s_get.base);
+  metrics_register(&s_post.base);
+  metrics_register(&s_level.base);
+  metrics_register(&s_lat.base);
+  metrics_register(&s_collector.base);
+  metrics_register(&s_get.base);
+  metrics_register(&s_collector.base);
+  scrape();
+  TEST_ASSERT_TRUE(s_collector.base.next == NULL);
+  TEST_ASSERT_TRUE(s_get.base.next == &s_post.base);
+}
+
+void test_family_header_once_and_labels(void) {
+  metrics_counter_inc(&s_get);
+  metrics_counter_add(&s_post, 5);
+  metrics_gauge_set(&s_level, -3);
+  scrape();
+  assert_has("# HELP test_requests_total Requests.\n"
+             "# TYPE test_requests_total counter\n"
+             "test_requests_total{method=\"get\"} 1\n"
+             "test_requests_total{method=\"post\"} 5\n");
+  assert_has("# TYPE test_level gauge\ntest_level -3\n");
+  assert_has("# TYPE test_temperature gauge\n"
+             "test_temperature{sensor=\"a\"} 21.5\n");
+}
+
+static metrics_counter s_put =
+    METRICS_COUNTER_LABELED_INIT("test_requests_total", "Requests.",
+                                 "method=\"put\"");
+
+void test_late_family_member_joins_family(void) {
+  metrics_register(&s_put.base);
+  metrics_counter_add(&s_put, 2);
+  scrape();
+  TEST_ASSERT_TRUE(s_post.base.next == &s_put.base);
+  TEST_ASSERT_TRUE(s_put.base.next == &s_level.base);
+  assert_has("test_requests_total{method=\"post\"} 5\n"
+             "test_requests_total{method=\"put\"} 2\n"
+             "# HELP test_level");
+}
+
+void test_counter_total_survives_slot_wrap(void) {
+  // Fold, then push one slot across 2^32 between two scrapes.
+  atomic_store(&s_get.value.slot[1], UINT32_MAX - 1);
+  scrape();
+  const uint64_t before = s_get.value.total;
+  atomic_store(&s_get.value.slot[1], 3); // +5, wrapped
+  scrape();
+  TEST_ASSERT_EQUAL_UINT64(before + 5, s_get.value.total);
+  TEST_ASSERT_EQUAL_UINT32(1 + 3, metrics_counter_read32(&s_get));
+}
+
+void test_histogram_buckets_are_cumulative(void) {
+  metrics_histogram_observe(&s_lat, 10);   // le 10 (inclusive)
+  metrics_histogram_observe(&s_lat, 11);   // le 100
+  metrics_histogram_observe(&s_lat, 1000); // le 1000
+  metrics_histogram_observe(&s_lat, 5000); // +Inf
+  scrape();
+  assert_has("# TYPE test_latency_us histogram\n"
+             "test_latency_us_bucket{le=\"10\"} 1\n"
+             "test_latency_us_bucket{le=\"100\"} 2\n"
+             "test_latency_us_bucket{le=\"1000\"} 3\n"
+             "test_latency_us_bucket{le=\"+Inf\"} 4\n"
+             "test_latency_us_sum 6021\n"
+             "test_latency_us_count 4\n");
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_registration_is_idempotent);
+  RUN_TEST(test_family_header_once_and_labels);
+  RUN_TEST(test_late_family_member_joins_family);
+  RUN_TEST(test_counter_total_survives_slot_wrap);
+  RUN_TEST(test_histogram_buckets_are_cumulative);
+  return UNITY_END();
+}
@@ -0,0 +1,323 @@
+#include "mic_dsp.h"
+#include "unity.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+#define FRAMES 4096
+
+static int32_t in[FRAMES * 2];
+static int16_t out_l[FRAMES], out_r[FRAMES];
+
+static const int rates[] = {8000, 11025, 16000, 22050, 32000, 44100, 48000};
+#define NUM_RATES (int)(sizeof(rates) / sizeof(rates[0]))
+
+// Left is the odd slot, right the even one; only the upper 16 bits count.
+static void fill_constant(int16_t left, int16_t right, int frames) {
+  for (int i = 0; i < frames; i++) {
+    in[2 * i + 1] = (int32_t)((uint32_t)(uint16_t)left << 16);
+    in[2 * i + 0] = (int32_t)((uint32_t)(uint16_t)right << 16);
+  }
+}
+
+static void fill_sine(double freq, int fs, double amp, int frames) {
+  for (int i = 0; i < frames; i++) {
+    int16_t v = (int16_t)lrint(amp * sin(2.0 * M_PI * freq * i / fs));
+    in[2 * i + 1] = (int32_t)((uint32_t)(uint16_t)v << 16);
+    in[2 * i + 0] = (int32_t)((uint32_t)(uint16_t)v << 16);
+  }
+}
+
+static double rms(const int16_t *x, int from, int to) {
+  double acc = 0.0;
+  for (int i = from; i < to; i++) {
+    acc += (double)x[i] * x[i];
+  }
+  return sqrt(acc / (to - from));
+}
+
+static double run_gain(mic_dc_filter_type type, double freq, int fs) {
+  mic_dc_filter l, r;
+  mic_dc_filter_init(&l, fs, 100, type);
+  mic_dc_filter_init(&r, fs, 100, type);
+  fill_sine(freq, fs, 10000.0, FRAMES);
+  mic_dsp_process_chunk(in, FRAMES, 0, 0, &l, &r, out_l, out_r);
+  // Skip the start-up transient.
+  return rms(out_l, FRAMES / 2, FRAMES) / (10000.0 / sqrt(2.0));
+}
+
+// Coefficients from the series expansions, including the folded table, stay
+// within a few Q steps of the libm values over the whole Kconfig range.
+static void test_coefficients_match_libm(void) {
+  const int cutoffs[] = {10, 20, 100, 250, 500};
+  for (int r = 0; r < NUM_RATES; r++) {
+    for (size_t c = 0; c < sizeof(cutoffs) / sizeof(cutoffs[0]); c++) {
+      const double fs = rates[r], fc = cutoffs[c];
+      mic_dc_filter op, bq;
+      mic_dc_filter_init(&op, rates[r], cutoffs[c], MIC_DC_ONE_POLE);
+      mic_dc_filter_init(&bq, rates[r], cutoffs[c], MIC_DC_BIQUAD_HPF);
+
+      const double R = exp(-2.0 * M_PI * fc / fs);
+      TEST_ASSERT_FLOAT_WITHIN(4.0, R * 2147483648.0, (double)op.a1);
+
+      const double k = tan(M_PI * fc / fs);
+      const double norm = 1.0 / (1.0 + M_SQRT2 * k + k * k);
+      const double q30 = 1073741824.0;
+      TEST_ASSERT_FLOAT_WITHIN(4.0, norm * q30, (double)bq.b0);
+      TEST_ASSERT_FLOAT_WITHIN(4.0, 2.0 * (k * k - 1.0) * norm * q30,
+                               (double)bq.a1);
+      TEST_ASSERT_FLOAT_WITHIN(4.0, (1.0 - M_SQRT2 * k + k * k) * norm * q30,
+                               (double)bq.a2);
+    }
+  }
+}
+
+static void test_table_covers_supported_rates(void) {
+  mic_dc_filter f;
+  for (int r = 0; r < NUM_RATES; r++) {
+    TEST_ASSERT_TRUE(mic_dc_filter_init(&f, rates[r], 100, MIC_DC_ONE_POLE));
+  }
+  TEST_ASSERT_FALSE(mic_dc_filter_init(&f, 44100, 120, MIC_DC_ONE_POLE));
+  TEST_ASSERT_FALSE(mic_dc_filter_init(&f, 96000, 100, MIC_DC_BIQUAD_HPF));
+}
+
+// The Q15 filter truncated the feedback every sample and settled at -1 LSB
+// (or further off) on a constant input; the Q14 state settles at 0.
+static void test_constant_input_settles_to_zero(void) {
+  const mic_dc_filter_type types[] = {MIC_DC_ONE_POLE, MIC_DC_BIQUAD_HPF};
+  for (int t = 0; t < 2; t++) {
+    mic_dc_filter l, r;
+    mic_dc_filter_init(&l, 44100, 100, types[t]);
+    mic_dc_filter_init(&r, 44100, 100, types[t]);
+    fill_constant(-1234, 3210, FRAMES);
+    for (int k = 0; k < 4; k++) {
+      mic_dsp_process_chunk(in, FRAMES, 0, 0, &l, &r, out_l, out_r);
+    }
+    for (int i = FRAMES - 64; i < FRAMES; i++) {
+      TEST_ASSERT_EQUAL_INT16(0, out_l[i]);
+      TEST_ASSERT_EQUAL_INT16(0, out_r[i]);
+    }
+  }
+}
+
+static void test_dc_offset_is_removed(void) {
+  mic_dc_filter l, r;
+  mic_dc_filter_init(&l, 16000, 100, MIC_DC_BIQUAD_HPF);
+  mic_dc_filter_init(&r, 16000, 100, MIC_DC_BIQUAD_HPF);
+  fill_constant(0, 0, FRAMES);
+  for (int k = 0; k < 4; k++) {
+    mic_dsp_process_chunk(in, FRAMES, 3500, 3000, &l, &r, out_l, out_r);
+  }
+  TEST_ASSERT_EQUAL_INT16(0, out_l[FRAMES - 1]);
+  TEST_ASSERT_EQUAL_INT16(0, out_r[FRAMES - 1]);
+}
+
+static void test_biquad_is_steeper_below_cutoff(void) {
+  const double op_20 = run_gain(MIC_DC_ONE_POLE, 20.0, 44100);
+  const double bq_20 = run_gain(MIC_DC_BIQUAD_HPF, 20.0, 44100);
+  TEST_ASSERT_LESS_THAN(op_20 / 2.0, bq_20);
+
+  // Butterworth: -3 dB at the cutoff, flat well above it.
+  TEST_ASSERT_FLOAT_WITHIN(0.03, M_SQRT1_2,
+                           run_gain(MIC_DC_BIQUAD_HPF, 100.0, 44100));
+  TEST_ASSERT_FLOAT_WITHIN(0.02, 1.0,
+                           run_gain(MIC_DC_BIQUAD_HPF, 2000.0, 44100));
+  TEST_ASSERT_FLOAT_WITHIN(0.02, 1.0,
+                           run_gain(MIC_DC_ONE_POLE, 2000.0, 44100));
+}
+
+static void test_step_saturates_instead_of_wrapping(void) {
+  mic_dc_filter l, r;
+  mic_dc_filter_init(&l, 44100, 100, MIC_DC_ONE_POLE);
+  mic_dc_filter_init(&r, 44100, 100, MIC_DC_ONE_POLE);
+  fill_constant(-32768, -32768, 8);
+  mic_dsp_process_chunk(in, 8, 0, 0, &l, &r, out_l, out_r);
+  fill_constant(32767, 32767, 8);
+  mic_dsp_process_chunk(in, 8, 0, 0, &l, &r, out_l, out_r);
+  TEST_ASSERT_EQUAL_INT16(INT16_MAX, out_l[0]);
+  TEST_ASSERT_EQUAL_INT16(INT16_MAX, out_r[0]);
+}
+
+// Chunk boundaries must not change the output: state is carried exactly.
+static void test_split_chunks_match_single_chunk(void) {
+  const mic_dc_filter_type types[] = {MIC_DC_ONE_POLE, MIC_DC_BIQUAD_HPF};
+  for (int t = 0; t < 4; t++) {
+    // The second pair runs at 24 bits with a gain.
+    const bool high_res = t >= 2;
+    const int32_t gain = mic_dsp_gain_q12(high_res ? -6 : 0);
+    uint32_t seed = 0xC0FFEEu;
+    for (int i = 0; i < FRAMES * 2; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      in[i] = (int32_t)(seed & 0x3FFFFF00u) - 0x20000000;
+    }
+    mic_dc_filter l, r;
+    mic_dc_filter_init(&l, 22050, 100, types[t % 2]);
+    mic_dc_filter_init(&r, 22050, 100, types[t % 2]);
+    mic_dc_filter_set_output(&l, high_res, gain);
+    mic_dc_filter_set_output(&r, high_res, gain);
+    static int16_t ref_l[FRAMES], ref_r[FRAMES];
+    mic_dsp_process_chunk(in, FRAMES, 3500, 3000, &l, &r, ref_l, ref_r);
+
+    mic_dc_filter_init(&l, 22050, 100, types[t % 2]);
+    mic_dc_filter_init(&r, 22050, 100, types[t % 2]);
+    mic_dc_filter_set_output(&l, high_res, gain);
+    mic_dc_filter_set_output(&r, high_res, gain);
+    int pos = 0;
+    const int step = 511;
+    while (pos < FRAMES) {
+      int n = FRAMES - pos < step ? FRAMES - pos : step;
+      mic_dsp_process_chunk(&in[2 * pos], n, 3500, 3000, &l, &r, &out_l[pos],
+                            &out_r[pos]);
+      pos += n;
+    }
+    TEST_ASSERT_EQUAL_INT16_ARRAY(ref_l, out_l, FRAMES);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(ref_r, out_r, FRAMES);
+  }
+}
+
+static void test_sum_chunk_matches_scalar_sum(void) {
+  uint32_t seed = 0xBADA55u;
+  for (int i = 0; i < FRAMES * 2; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    in[i] = (int32_t)seed;
+  }
+  // Odd length exercises the tail after the unrolled loop.
+  const int frames = 511;
+  int64_t ref_l = 0, ref_r = 0;
+  for (int i = 0; i < frames; i++) {
+    ref_l += (int16_t)(in[2 * i + 1] >> 16);
+    ref_r += (int16_t)(in[2 * i + 0] >> 16);
+  }
+  int64_t sum_l = 7, sum_r = -7;
+  mic_dsp_sum_chunk(in, frames, &sum_l, &sum_r);
+  TEST_ASSERT_EQUAL_INT64(ref_l + 7, sum_l);
+  TEST_ASSERT_EQUAL_INT64(ref_r - 7, sum_r);
+}
+
+// A large offset no longer wraps the sample back into int16.
+static void test_offset_add_does_not_wrap(void) {
+  mic_dc_filter l, r;
+  mic_dc_filter_init(&l, 44100, 100, MIC_DC_ONE_POLE);
+  mic_dc_filter_init(&r, 44100, 100, MIC_DC_ONE_POLE);
+  fill_constant(30000, -30000, 1);
+  mic_dsp_process_chunk(in, 1, 5000, -5000, &l, &r, out_l, out_r);
+  TEST_ASSERT_EQUAL_INT16(INT16_MAX, out_l[0]);
+  TEST_ASSERT_EQUAL_INT16(INT16_MIN, out_r[0]);
+}
+
+// Moving the offset together with the filter history leaves the output as
+// if the new offset had been applied all along.
+static void test_offset_change_with_shift_has_no_step(void) {
+  const mic_dc_filter_type types[] = {MIC_DC_ONE_POLE, MIC_DC_BIQUAD_HPF};
+  for (int t = 0; t < 4; t++) {
+    mic_dc_filter l, r;
+    mic_dc_filter_init(&l, 44100, 100, types[t % 2]);
+    mic_dc_filter_init(&r, 44100, 100, types[t % 2]);
+    mic_dc_filter_set_output(&l, t >= 2, MIC_DSP_GAIN_UNITY);
+    mic_dc_filter_set_output(&r, t >= 2, MIC_DSP_GAIN_UNITY);
+    fill_constant(-3000, -2500, FRAMES);
+    for (int k = 0; k < 4; k++) {
+      mic_dsp_process_chunk(in, FRAMES, 2000, 2000, &l, &r, out_l, out_r);
+    }
+    mic_dc_filter_shift(&l, 1000);
+    mic_dc_filter_shift(&r, 500);
+    mic_dsp_process_chunk(in, 64, 3000, 2500, &l, &r, out_l, out_r);
+    for (int i = 0; i < 64; i++) {
+      TEST_ASSERT_EQUAL_INT16(0, out_l[i]);
+      TEST_ASSERT_EQUAL_INT16(0, out_r[i]);
+    }
+  }
+}
+
+static void test_gain_steps_in_whole_db(void) {
+  TEST_ASSERT_EQUAL_INT32(MIC_DSP_GAIN_UNITY, mic_dsp_gain_q12(0));
+  TEST_ASSERT_EQUAL_INT32(2053, mic_dsp_gain_q12(-6));
+  TEST_ASSERT_EQUAL_INT32(8173, mic_dsp_gain_q12(6));
+  TEST_ASSERT_EQUAL_INT32(40960, mic_dsp_gain_q12(20));
+  TEST_ASSERT_EQUAL_INT32(mic_dsp_gain_q12(24), mic_dsp_gain_q12(40));
+  TEST_ASSERT_EQUAL_INT32(mic_dsp_gain_q12(-24), mic_dsp_gain_q12(-40));
+}
+
+// Attenuating before the output is narrowed keeps the overshoot of a
+// full-scale step (see test_step_saturates_instead_of_wrapping) in range.
+static void test_gain_leaves_headroom_for_a_step(void) {
+  mic_dc_filter l, r;
+  mic_dc_filter_init(&l, 44100, 100, MIC_DC_ONE_POLE);
+  mic_dc_filter_init(&r, 44100, 100, MIC_DC_ONE_POLE);
+  mic_dc_filter_set_output(&l, true, mic_dsp_gain_q12(-12));
+  mic_dc_filter_set_output(&r, true, mic_dsp_gain_q12(-12));
+  fill_constant(-32768, -32768, 8);
+  mic_dsp_process_chunk(in, 8, 0, 0, &l, &r, out_l, out_r);
+  fill_constant(32767, 32767, 8);
+  mic_dsp_process_chunk(in, 8, 0, 0, &l, &r, out_l, out_r);
+  // The step of 65535 LSB on what is left of the first -32768 after eight
+  // samples, at 10^(-12/20): past full scale before the gain.
+  const double R = (double)l.a1 / 2147483648.0;
+  const double y = 65535.0 - 32768.0 * pow(R, 8);
+  TEST_ASSERT_GREATER_THAN(INT16_MAX, (int)y);
+  TEST_ASSERT_INT_WITHIN(2, (int)lrint(y * mic_dsp_gain_q12(-12) / 4096.0),
+                         out_l[0]);
+  TEST_ASSERT_LESS_THAN(INT16_MAX, out_l[0]);
+  TEST_ASSERT_EQUAL_INT16(out_l[0], out_r[0]);
+}
+
+// Largest deviation from a double-precision one-pole filter of the exact
+// 24-bit input, scaled by the gain.
+static double high_res_error(bool high_res, int32_t gain) {
+  mic_dc_filter l, r;
+  mic_dc_filter_init(&l, 44100, 100, MIC_DC_ONE_POLE);
+  mic_dc_filter_init(&r, 44100, 100, MIC_DC_ONE_POLE);
+  mic_dc_filter_set_output(&l, high_res, gain);
+  mic_dc_filter_set_output(&r, high_res, gain);
+  // 1 kHz at 1.5 LSB of the 16-bit sample, with 8 bits below it.
+  for (int i = 0; i < FRAMES; i++) {
+    const int32_t v =
+        (int32_t)lrint(1.5 * 256.0 * sin(2.0 * M_PI * 1000.0 * i / 44100.0));
+    in[2 * i + 1] = v * 256;
+    in[2 * i + 0] = v * 256;
+  }
+  mic_dsp_process_chunk(in, FRAMES, 0, 0, &l, &r, out_l, out_r);
+
+  const double R = (double)l.a1 / 2147483648.0;
+  const double g = (double)gain / MIC_DSP_GAIN_UNITY;
+  double x1 = 0.0, y1 = 0.0, worst = 0.0;
+  for (int i = 0; i < FRAMES; i++) {
+    const double x = (double)(in[2 * i + 1] >> 8) / 256.0;
+    const double y = x - x1 + R * y1;
+    x1 = x;
+    y1 = y;
+    const double err = fabs(out_l[i] - g * y);
+    worst = err > worst ? err : worst;
+  }
+  return worst;
+}
+
+// The 16-bit path quantises the input before the gain; the 24-bit one only
+// rounds the output.
+static void test_high_res_keeps_bits_below_16(void) {
+  const int32_t gain = mic_dsp_gain_q12(24);
+  TEST_ASSERT_LESS_OR_EQUAL(1, (int)ceil(high_res_error(true, gain) - 0.5));
+  TEST_ASSERT_GREATER_THAN(4, (int)high_res_error(false, gain));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_coefficients_match_libm);
+  RUN_TEST(test_table_covers_supported_rates);
+  RUN_TEST(test_constant_input_settles_to_zero);
+  RUN_TEST(test_dc_offset_is_removed);
+  RUN_TEST(test_biquad_is_steeper_below_cutoff);
+  RUN_TEST(test_step_saturates_instead_of_wrapping);
+  RUN_TEST(test_split_chunks_match_single_chunk);
+  RUN_TEST(test_sum_chunk_matches_scalar_sum);
+  RUN_TEST(test_offset_add_does_not_wrap);
+  RUN_TEST(test_offset_change_with_shift_has_no_step);
+  RUN_TEST(test_gain_steps_in_whole_db);
+  RUN_TEST(test_gain_leaves_headroom_for_a_step);
+  RUN_TEST(test_high_res_keeps_bits_below_16);
+  return UNITY_END();
+}
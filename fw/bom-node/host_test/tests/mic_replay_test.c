@@ -0,0 +1,124 @@
+#include "audio_wav.h"
+#include "mic_replay.h"
+#include "unity.h"
+
+#include <stdint.h>
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Upper 16 bits of a DMA slot, as mic_dsp_process_chunk() takes them.
+static int16_t slot_sample(int32_t v) { return (int16_t)((uint32_t)v >> 16); }
+
+void test_parses_stamped_stream_header(void) {
+  uint8_t header[AUDIO_WAV_HEADER_BYTES + AUDIO_WAV_STAMP_BYTES];
+  const audio_wav_stamp stamp = {.sample_index = 42, .uptime_us = 7};
+  const size_t len = audio_wav_build_header(header, 16000, 2, &stamp);
+
+  mic_replay_wav wav;
+  TEST_ASSERT_TRUE(mic_replay_parse_wav(header, len, &wav));
+  TEST_ASSERT_EQUAL_INT(16000, wav.sample_rate);
+  TEST_ASSERT_EQUAL_INT(2, wav.channels);
+  TEST_ASSERT_EQUAL_UINT32(len, wav.data_offset);
+  // Stream headers leave the length open: play to the end of the file.
+  TEST_ASSERT_EQUAL_UINT32(0, wav.data_bytes);
+
+  audio_wav_patch_pcm_sizes(header, len, 4000);
+  TEST_ASSERT_TRUE(mic_replay_parse_wav(header, len, &wav));
+  TEST_ASSERT_EQUAL_UINT32(4000, wav.data_bytes);
+}
+
+void test_rejects_other_formats(void) {
+  uint8_t header[AUDIO_WAV_HEADER_BYTES];
+  audio_wav_build_header(header, 8000, 1, NULL);
+  mic_replay_wav wav;
+  TEST_ASSERT_TRUE(mic_replay_parse_wav(header, sizeof(header), &wav));
+  TEST_ASSERT_EQUAL_INT(1, wav.channels);
+
+  uint8_t bad[sizeof(header)];
+  memcpy(bad, header, sizeof(header));
+  bad[34] = 8; // 8-bit samples
+  TEST_ASSERT_FALSE(mic_replay_parse_wav(bad, sizeof(bad), &wav));
+  memcpy(bad, header, sizeof(header));
+  bad[20] = 0x11; // IMA ADPCM
+  TEST_ASSERT_FALSE(mic_replay_parse_wav(bad, sizeof(bad), &wav));
+  // "data" past the probed bytes.
+  TEST_ASSERT_FALSE(mic_replay_parse_wav(header, 36, &wav));
+}
+
+void test_packs_stereo_in_place(void) {
+  enum { FRAMES = 5 };
+  int32_t buf[2 * FRAMES];
+  const int16_t pcm[2 * FRAMES] = {1, -1, 200, -200, 32767, -32768, 0, 5, -7, 9};
+  memcpy(buf, pcm, sizeof(pcm));
+  mic_replay_pack_frames((const int16_t *)buf, 2, FRAMES, buf);
+  for (int i = 0; i < FRAMES; i++) {
+    // Left in the odd slot, right in the even one.
+    TEST_ASSERT_EQUAL_INT(pcm[2 * i], slot_sample(buf[2 * i + 1]));
+    TEST_ASSERT_EQUAL_INT(pcm[2 * i + 1], slot_sample(buf[2 * i]));
+  }
+}
+
+void test_packs_mono_to_both_channels(void) {
+  enum { FRAMES = 4 };
+  int32_t buf[2 * FRAMES];
+  const int16_t pcm[FRAMES] = {10, -20, 30, -40};
+  memcpy(buf, pcm, sizeof(pcm));
+  mic_replay_pack_frames((const int16_t *)buf, 1, FRAMES, buf);
+  for (int i = 0; i < FRAMES; i++) {
+    TEST_ASSERT_EQUAL_INT(pcm[i], slot_sample(buf[2 * i]));
+    TEST_ASSERT_EQUAL_INT(pcm[i], slot_sample(buf[2 * i + 1]));
+  }
+}
+
+static int peak_index(const int32_t *frames, int n, int slot) {
+  int best = 0, at = -1;
+  for (int i = 0; i < n; i++) {
+    int v = slot_sample(frames[2 * i + slot]);
+    v = v < 0 ? -v : v;
+    if (v > best) {
+      best = v;
+      at = i;
+    }
+  }
+  return at;
+}
+
+void test_synth_impulses_are_periodic_and_lagged(void) {
+  enum { RATE = 16000, PERIOD = 1600, N = 2 * PERIOD };
+  static int32_t frames[2 * N];
+  mic_synth s;
+  // 100 ms period, right 500 us (8 frames) behind.
+  mic_synth_init(&s, RATE, 100, 500, 20000, 32, 2);
+  mic_synth_fill(&s, frames, 100); // filled in pieces, as chunks
+  mic_synth_fill(&s, &frames[200], N - 100);
+
+  const int left = peak_index(frames, PERIOD, 1);
+  const int right = peak_index(frames, PERIOD, 0);
+  TEST_ASSERT_TRUE(left >= 0 && left < 32);
+  TEST_ASSERT_TRUE(right >= 8 && right < 40);
+  TEST_ASSERT_TRUE(peak_index(&frames[2 * PERIOD], PERIOD, 1) < 32);
+
+  // Between the bursts only the background noise is left.
+  for (int i = PERIOD / 2; i < PERIOD; i++) {
+    const int v = slot_sample(frames[2 * i + 1]);
+    TEST_ASSERT_TRUE(v <= 32 && v >= -32);
+  }
+
+  // The same parameters give the same audio.
+  static int32_t again[2 * N];
+  mic_synth_init(&s, RATE, 100, 500, 20000, 32, 2);
+  mic_synth_fill(&s, again, N);
+  TEST_ASSERT_EQUAL_INT(0, memcmp(frames, again, sizeof(frames)));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_parses_stamped_stream_header);
+  RUN_TEST(test_rejects_other_formats);
+  RUN_TEST(test_packs_stereo_in_place);
+  RUN_TEST(test_packs_mono_to_both_channels);
+  RUN_TEST(test_synth_impulses_are_periodic_and_lagged);
+  return UNITY_END();
+}
@@ -0,0 +1,142 @@
+#include "ring_buffer.h"
+#include "unity.h"
+
+#include <stdint.h>
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Reference ring: the original modulo-per-element implementation.
+static void ref_copy_tail(const int16_t *data, int size, int head,
+                          int16_t *out, int offset, int count) {
+  int start = ((head - offset - count) % size + size) % size;
+  for (int i = 0; i < count; i++) {
+    out[i] = data[(start + i) % size];
+  }
+}
+
+static void test_push_block_matches_push(void) {
+  rb_struct a, b;
+  rb_init(&a, 13);
+  rb_init(&b, 13);
+
+  int16_t src[40];
+  for (int i = 0; i < 40; i++) {
+    src[i] = (int16_t)(i * 7 - 100);
+  }
+
+  // Block sizes chosen to hit no-wrap, exact-end and wrapping cases.
+  const int blocks[] = {5, 8, 1, 11, 13, 2};
+  int pos = 0;
+  for (size_t k = 0; k < sizeof(blocks) / sizeof(blocks[0]); k++) {
+    rb_push_block(&a, &src[pos], blocks[k]);
+    for (int i = 0; i < blocks[k]; i++) {
+      rb_push(&b, src[pos + i]);
+    }
+    pos += blocks[k];
+    TEST_ASSERT_EQUAL(b.head, a.head);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(b.data, a.data, 13);
+  }
+
+  rb_free(&a);
+  rb_free(&b);
+}
+
+static void test_push_block_larger_than_ring_keeps_newest(void) {
+  rb_struct rb;
+  rb_init(&rb, 8);
+
+  int16_t src[21];
+  for (int i = 0; i < 21; i++) {
+    src[i] = (int16_t)i;
+  }
+  rb_push_block(&rb, src, 3);
+  rb_push_block(&rb, src, 21);
+
+  int16_t out[8];
+  rb_copy_tail(&rb, out, 0, 8);
+  TEST_ASSERT_EQUAL_INT16_ARRAY(&src[13], out, 8);
+
+  rb_free(&rb);
+}
+
+static void test_copy_tail_matches_reference(void) {
+  rb_struct rb;
+  rb_init(&rb, 17);
+
+  for (int i = 0; i < 17 * 3 + 5; i++) {
+    rb_push(&rb, (int16_t)(i * 3 + 1));
+
+    for (int offset = 0; offset <= 17; offset += 4) {
+      for (int count = 0; offset + count <= 17; count += 3) {
+        int16_t got[17], want[17];
+        memset(got, 0, sizeof(got));
+        memset(want, 0, sizeof(want));
+        rb_copy_tail(&rb, got, offset, count);
+        ref_copy_tail(rb.data, rb.size, rb.head, want, offset, count);
+        TEST_ASSERT_EQUAL_INT16_ARRAY(want, got, 17);
+      }
+    }
+  }
+
+  rb_free(&rb);
+}
+
+static void test_pow2_rounds_up_and_masks(void) {
+  rb_struct rb;
+  rb_init_pow2(&rb, 100);
+  TEST_ASSERT_EQUAL(128, rb.size);
+  TEST_ASSERT_EQUAL(127, rb.mask);
+
+  for (int i = 0; i < 300; i++) {
+    rb_push(&rb, (int16_t)i);
+  }
+  TEST_ASSERT_EQUAL(300 % 128, rb.head);
+
+  int16_t out[100];
+  rb_copy_tail(&rb, out, 0, 100);
+  for (int i = 0; i < 100; i++) {
+    TEST_ASSERT_EQUAL_INT16(200 + i, out[i]);
+  }
+
+  rb_free(&rb);
+
+  rb_init(&rb, 30);
+  TEST_ASSERT_EQUAL(0, rb.mask);
+  rb_free(&rb);
+}
+
+static void test_attach_commit_in_place(void) {
+  int16_t storage[12];
+  rb_struct rb;
+  rb_attach(&rb, storage, 12);
+
+  for (int round = 0; round < 5; round++) {
+    TEST_ASSERT_EQUAL(12 - rb.head, rb_writable(&rb));
+    int16_t *w = rb_write_ptr(&rb);
+    for (int i = 0; i < 4; i++) {
+      w[i] = (int16_t)(round * 4 + i);
+    }
+    rb_commit(&rb, 4);
+  }
+
+  int16_t out[12];
+  rb_copy_tail(&rb, out, 0, 12);
+  for (int i = 0; i < 12; i++) {
+    TEST_ASSERT_EQUAL_INT16(8 + i, out[i]);
+  }
+
+  rb_free(&rb);
+  TEST_ASSERT_NULL(rb.data);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_push_block_matches_push);
+  RUN_TEST(test_push_block_larger_than_ring_keeps_newest);
+  RUN_TEST(test_copy_tail_matches_reference);
+  RUN_TEST(test_pow2_rounds_up_and_masks);
+  RUN_TEST(test_attach_commit_in_place);
+  return UNITY_END();
+}
@@ -0,0 +1,238 @@
+#include "rtp_packetizer.h"
+#include "unity.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define MAX_PACKETS 64
+#define SSRC 0x11223344u
+
+typedef struct {
+  size_t len;
+  uint8_t data[RTP_PACKET_BYTES];
+} captured;
+
+static captured packets[MAX_PACKETS];
+static int count;
+
+void setUp(void) { count = 0; }
+void tearDown(void) {}
+
+static void capture(const rtp_packet *pkt, void *ctx) {
+  (void)ctx;
+  TEST_ASSERT_LESS_THAN(MAX_PACKETS, count);
+  packets[count].len = pkt->len;
+  memcpy(packets[count].data, pkt->data, pkt->len);
+  count++;
+}
+
+static uint16_t seq_of(int i) {
+  return (uint16_t)((packets[i].data[2] << 8) | packets[i].data[3]);
+}
+
+static uint32_t ts_of(int i) {
+  const uint8_t *d = packets[i].data;
+  return ((uint32_t)d[4] << 24) | ((uint32_t)d[5] << 16) |
+         ((uint32_t)d[6] << 8) | d[7];
+}
+
+static bool marker_of(int i) { return (packets[i].data[1] & 0x80) != 0; }
+
+// Frame f of the input: left is f, right is -f.
+static void fill(int16_t *pcm, uint64_t first, size_t frames) {
+  for (size_t i = 0; i < frames; i++) {
+    pcm[2 * i] = (int16_t)(first + i);
+    pcm[2 * i + 1] = (int16_t)-(int16_t)(first + i);
+  }
+}
+
+void test_header_fields(void) {
+  rtp_packetizer p;
+  rtp_packetizer_init(&p, RTP_PT_L16_44100_STEREO, SSRC, false, 2);
+  int16_t pcm[RTP_PCM_FRAMES * 2];
+  fill(pcm, 0, RTP_PCM_FRAMES);
+  rtp_packetizer_push(&p, pcm, RTP_PCM_FRAMES, 0x100000005ull, capture, NULL);
+
+  TEST_ASSERT_EQUAL_INT(1, count);
+  TEST_ASSERT_EQUAL_size_t(RTP_PACKET_BYTES, packets[0].len);
+  TEST_ASSERT_EQUAL_UINT8(0x80, packets[0].data[0]);
+  TEST_ASSERT_TRUE(marker_of(0));
+  TEST_ASSERT_EQUAL_UINT8(RTP_PT_L16_44100_STEREO, packets[0].data[1] & 0x7f);
+  TEST_ASSERT_EQUAL_UINT16(0, seq_of(0));
+  TEST_ASSERT_EQUAL_UINT32(5, ts_of(0)); // low 32 bits of the sample index
+  const uint8_t ssrc[4] = {0x11, 0x22, 0x33, 0x44};
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(ssrc, &packets[0].data[8], 4);
+}
+
+void test_pcm_is_big_endian(void) {
+  rtp_packetizer p;
+  rtp_packetizer_init(&p, RTP_PT_L16_DYNAMIC, SSRC, false, 2);
+  int16_t pcm[RTP_PCM_FRAMES * 2];
+  fill(pcm, 0x0102, RTP_PCM_FRAMES);
+  rtp_packetizer_push(&p, pcm, RTP_PCM_FRAMES, 0, capture, NULL);
+
+  const uint8_t *payload = &packets[0].data[RTP_HEADER_BYTES];
+  TEST_ASSERT_EQUAL_UINT8(0x01, payload[0]);
+  TEST_ASSERT_EQUAL_UINT8(0x02, payload[1]);
+  TEST_ASSERT_EQUAL_UINT8(0xfe, payload[2]); // -0x0102
+  TEST_ASSERT_EQUAL_UINT8(0xfe, payload[3]);
+}
+
+void test_split_input_packs_on_grid(void) {
+  rtp_packetizer p;
+  rtp_packetizer_init(&p, RTP_PT_L16_DYNAMIC, SSRC, false, 2);
+  int16_t pcm[100 * 2];
+  uint64_t index = 1000;
+  for (int i = 0; i < 12; i++) { // 1200 frames, DMA-sized pieces
+    fill(pcm, index, 100);
+    rtp_packetizer_push(&p, pcm, 100, index, capture, NULL);
+    index += 100;
+  }
+
+  TEST_ASSERT_EQUAL_INT(5, count);
+  for (int i = 0; i < count; i++) {
+    TEST_ASSERT_EQUAL_size_t(RTP_PACKET_BYTES, packets[i].len);
+    TEST_ASSERT_EQUAL_UINT16(i, seq_of(i));
+    TEST_ASSERT_EQUAL_UINT32(1000 + i * RTP_PCM_FRAMES, ts_of(i));
+    TEST_ASSERT_EQUAL_INT(i == 0, marker_of(i));
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, p.gaps);
+}
+
+void test_gap_skips_sequence_numbers(void) {
+  rtp_packetizer p;
+  rtp_packetizer_init(&p, RTP_PT_L16_DYNAMIC, SSRC, false, 2);
+  int16_t pcm[RTP_PCM_FRAMES * 2];
+  fill(pcm, 0, RTP_PCM_FRAMES);
+  rtp_packetizer_push(&p, pcm, RTP_PCM_FRAMES, 0, capture, NULL);
+  rtp_packetizer_push(&p, pcm, 100, RTP_PCM_FRAMES, capture, NULL);
+  TEST_ASSERT_EQUAL_INT(1, count);
+
+  // Three packets' worth of audio lost, landing mid-cell: the partial packet
+  // goes out short, and the next one fills out the rest of its cell.
+  const uint64_t resume = 4 * RTP_PCM_FRAMES + 40;
+  rtp_packetizer_push(&p, pcm, RTP_PCM_FRAMES, resume, capture, NULL);
+  rtp_packetizer_flush(&p, capture, NULL);
+
+  TEST_ASSERT_EQUAL_UINT32(1, p.gaps);
+  TEST_ASSERT_EQUAL_INT(4, count);
+  TEST_ASSERT_EQUAL_size_t(RTP_HEADER_BYTES + 100 * 4, packets[1].len);
+  TEST_ASSERT_EQUAL_UINT16(1, seq_of(1));
+  TEST_ASSERT_FALSE(marker_of(1));
+
+  TEST_ASSERT_EQUAL_size_t(RTP_HEADER_BYTES + 200 * 4, packets[2].len);
+  TEST_ASSERT_EQUAL_UINT16(4, seq_of(2));
+  TEST_ASSERT_EQUAL_UINT32(resume, ts_of(2));
+  TEST_ASSERT_TRUE(marker_of(2));
+
+  TEST_ASSERT_EQUAL_size_t(RTP_HEADER_BYTES + 40 * 4, packets[3].len);
+  TEST_ASSERT_EQUAL_UINT16(5, seq_of(3));
+  TEST_ASSERT_FALSE(marker_of(3));
+}
+
+void test_gap_within_a_cell_keeps_sequence_increasing(void) {
+  rtp_packetizer p;
+  rtp_packetizer_init(&p, RTP_PT_L16_DYNAMIC, SSRC, false, 2);
+  int16_t pcm[RTP_PCM_FRAMES * 2];
+  fill(pcm, 0, RTP_PCM_FRAMES);
+  rtp_packetizer_push(&p, pcm, 50, 0, capture, NULL);
+  rtp_packetizer_push(&p, pcm, 50, 60, capture, NULL);
+  rtp_packetizer_flush(&p, capture, NULL);
+
+  TEST_ASSERT_EQUAL_INT(2, count);
+  TEST_ASSERT_EQUAL_UINT16(0, seq_of(0));
+  TEST_ASSERT_EQUAL_UINT16(1, seq_of(1));
+  TEST_ASSERT_EQUAL_UINT32(60, ts_of(1));
+}
+
+void test_flush_sends_partial_pcm_once(void) {
+  rtp_packetizer p;
+  rtp_packetizer_init(&p, RTP_PT_L16_DYNAMIC, SSRC, false, 2);
+  int16_t pcm[30 * 2];
+  fill(pcm, 0, 30);
+  rtp_packetizer_push(&p, pcm, 30, 0, capture, NULL);
+  rtp_packetizer_flush(&p, capture, NULL);
+  rtp_packetizer_flush(&p, capture, NULL);
+
+  TEST_ASSERT_EQUAL_INT(1, count);
+  TEST_ASSERT_EQUAL_size_t(RTP_HEADER_BYTES + 30 * 4, packets[0].len);
+}
+
+void test_adpcm_one_block_per_packet(void) {
+  rtp_packetizer p;
+  rtp_packetizer_init(&p, RTP_PT_ADPCM_DYNAMIC, SSRC, true, 2);
+  static int16_t pcm[3 * IMA_ADPCM_BLOCK_FRAMES(2) * 2];
+  fill(pcm, 0, 3 * IMA_ADPCM_BLOCK_FRAMES(2));
+  // Odd-sized pieces, so blocks complete mid-call.
+  size_t done = 0;
+  while (done < 3 * IMA_ADPCM_BLOCK_FRAMES(2)) {
+    size_t n = 3 * IMA_ADPCM_BLOCK_FRAMES(2) - done;
+    if (n > 333)
+      n = 333;
+    rtp_packetizer_push(&p, &pcm[2 * done], n, 7 + done, capture, NULL);
+    done += n;
+  }
+  rtp_packetizer_flush(&p, capture, NULL); // nothing: no partial blocks
+
+  TEST_ASSERT_EQUAL_INT(3, count);
+  for (int i = 0; i < count; i++) {
+    TEST_ASSERT_EQUAL_size_t(RTP_HEADER_BYTES + IMA_ADPCM_BLOCK_BYTES,
+                             packets[i].len);
+    TEST_ASSERT_EQUAL_UINT16(i, seq_of(i));
+    TEST_ASSERT_EQUAL_UINT32(7 + i * IMA_ADPCM_BLOCK_FRAMES(2), ts_of(i));
+    TEST_ASSERT_EQUAL_UINT8(RTP_PT_ADPCM_DYNAMIC, packets[i].data[1] & 0x7f);
+  }
+
+  // The block header holds the first sample verbatim: the encoder restarted
+  // exactly at each packet's timestamp.
+  const uint8_t *block = &packets[1].data[RTP_HEADER_BYTES];
+  TEST_ASSERT_EQUAL_INT16((int16_t)IMA_ADPCM_BLOCK_FRAMES(2),
+                          (int16_t)(block[0] | (block[1] << 8)));
+}
+
+void test_adpcm_gap_drops_partial_block(void) {
+  rtp_packetizer p;
+  rtp_packetizer_init(&p, RTP_PT_ADPCM_DYNAMIC, SSRC, true, 2);
+  static int16_t pcm[IMA_ADPCM_BLOCK_FRAMES(2) * 2];
+  fill(pcm, 0, IMA_ADPCM_BLOCK_FRAMES(2));
+  rtp_packetizer_push(&p, pcm, 200, 0, capture, NULL);
+  const uint64_t resume = 5000;
+  rtp_packetizer_push(&p, pcm, IMA_ADPCM_BLOCK_FRAMES(2), resume, capture, NULL);
+
+  TEST_ASSERT_EQUAL_UINT32(1, p.gaps);
+  TEST_ASSERT_EQUAL_INT(1, count);
+  TEST_ASSERT_EQUAL_UINT32(resume, ts_of(0));
+  TEST_ASSERT_EQUAL_UINT16(resume / IMA_ADPCM_BLOCK_FRAMES(2), seq_of(0));
+  TEST_ASSERT_TRUE(marker_of(0));
+}
+
+void test_mono_pcm_packets(void) {
+  rtp_packetizer p;
+  rtp_packetizer_init(&p, RTP_PT_L16_44100_MONO, SSRC, false, 1);
+  int16_t pcm[RTP_PCM_FRAMES];
+  for (int i = 0; i < RTP_PCM_FRAMES; i++) {
+    pcm[i] = (int16_t)(i + 1);
+  }
+  rtp_packetizer_push(&p, pcm, RTP_PCM_FRAMES, 0, capture, NULL);
+
+  TEST_ASSERT_EQUAL_INT(1, count);
+  TEST_ASSERT_EQUAL_size_t(RTP_HEADER_BYTES + RTP_PCM_FRAMES * 2,
+                           packets[0].len);
+  const uint8_t *payload = &packets[0].data[RTP_HEADER_BYTES];
+  TEST_ASSERT_EQUAL_UINT8(0, payload[2]);
+  TEST_ASSERT_EQUAL_UINT8(2, payload[3]);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_header_fields);
+  RUN_TEST(test_pcm_is_big_endian);
+  RUN_TEST(test_split_input_packs_on_grid);
+  RUN_TEST(test_gap_skips_sequence_numbers);
+  RUN_TEST(test_gap_within_a_cell_keeps_sequence_increasing);
+  RUN_TEST(test_flush_sends_partial_pcm_once);
+  RUN_TEST(test_adpcm_one_block_per_packet);
+  RUN_TEST(test_adpcm_gap_drops_partial_block);
+  RUN_TEST(test_mono_pcm_packets);
+  return UNITY_END();
+}
@@ -0,0 +1,134 @@
+#include "sample_clock.h"
+#include "unity.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+void setUp(void) { srand(1234); }
+void tearDown(void) {}
+
+#define RATE 44100
+#define CHUNK 510 // samples committed per DMA read with 30-sample taps
+#define T0_US 5000000.0
+#define MIN_LATENCY_US 120.0
+
+static double true_time_us(uint64_t index, double ppm) {
+  return T0_US + (double)index * 1e6 / (RATE * (1.0 + ppm * 1e-6));
+}
+
+// Arrivals lag capture by a never-negative, jittery delay with an
+// occasional long stall.
+static int64_t arrival_us(uint64_t index, double ppm) {
+  double lat = MIN_LATENCY_US + (rand() % 2000);
+  if (rand() % 64 == 0)
+    lat += 8000.0;
+  return (int64_t)llround(true_time_us(index, ppm) + lat);
+}
+
+static void run(sample_clock *clk, uint64_t *index, int chunks, double ppm) {
+  for (int i = 0; i < chunks; i++) {
+    *index += CHUNK;
+    sample_clock_update(clk, *index, arrival_us(*index, ppm));
+  }
+}
+
+void test_unanchored_clock_reports_zero(void) {
+  sample_clock clk;
+  sample_clock_reset(&clk, RATE);
+  TEST_ASSERT_EQUAL_INT64(0, sample_clock_time_us(&clk, 1000));
+  TEST_ASSERT_FALSE(sample_clock_locked(&clk));
+}
+
+void test_tracks_drift_and_lower_envelope(void) {
+  const double ppm = 45.0;
+  sample_clock clk;
+  sample_clock_reset(&clk, RATE);
+  uint64_t index = 0;
+  run(&clk, &index, 6000, ppm); // about 70 s
+  TEST_ASSERT_TRUE(sample_clock_locked(&clk));
+  TEST_ASSERT_EQUAL_UINT32(0, clk.relocks);
+  TEST_ASSERT_FLOAT_WITHIN(5.0f, (float)ppm, (float)sample_clock_ppm(&clk));
+
+  // Times, including ones before the anchor and inside a chunk, sit on the
+  // least delayed arrivals rather than on the average one.
+  for (uint64_t back = 0; back < 20000; back += 1237) {
+    const uint64_t i = index - back;
+    const double err = (double)sample_clock_time_us(&clk, i) -
+                       (true_time_us(i, ppm) + MIN_LATENCY_US);
+    TEST_ASSERT_FLOAT_WITHIN(250.0f, 0.0f, (float)err);
+  }
+}
+
+void test_follows_negative_drift(void) {
+  const double ppm = -80.0;
+  sample_clock clk;
+  sample_clock_reset(&clk, RATE);
+  uint64_t index = 0;
+  run(&clk, &index, 6000, ppm);
+  TEST_ASSERT_FLOAT_WITHIN(5.0f, (float)ppm, (float)sample_clock_ppm(&clk));
+}
+
+void test_large_jump_reanchors(void) {
+  sample_clock clk;
+  sample_clock_reset(&clk, RATE);
+  uint64_t index = 0;
+  run(&clk, &index, 3000, 0.0);
+  TEST_ASSERT_TRUE(sample_clock_locked(&clk));
+
+  // A 60 ms stall: the clock re-anchors on the late arrival, then settles
+  // again.
+  index += CHUNK;
+  const int64_t late = arrival_us(index, 0.0) + 60000;
+  sample_clock_update(&clk, index, late);
+  TEST_ASSERT_EQUAL_UINT32(1, clk.relocks);
+  TEST_ASSERT_FALSE(sample_clock_locked(&clk));
+  TEST_ASSERT_EQUAL_INT64(late, sample_clock_time_us(&clk, index));
+
+  run(&clk, &index, 3000, 0.0);
+  TEST_ASSERT_TRUE(sample_clock_locked(&clk));
+  const double err = (double)sample_clock_time_us(&clk, index) -
+                     (true_time_us(index, 0.0) + MIN_LATENCY_US);
+  TEST_ASSERT_FLOAT_WITHIN(250.0f, 0.0f, (float)err);
+}
+
+void test_unlock_keeps_period(void) {
+  const double ppm = 45.0;
+  sample_clock clk;
+  sample_clock_reset(&clk, RATE);
+  uint64_t index = 0;
+  run(&clk, &index, 6000, ppm);
+  const double period = clk.period_us;
+
+  // Audio was dropped: indices stop matching time without a visible jump.
+  sample_clock_unlock(&clk);
+  TEST_ASSERT_EQUAL_UINT32(1, clk.relocks);
+  TEST_ASSERT_FALSE(sample_clock_locked(&clk));
+  index += 400;
+  const int64_t at = arrival_us(index, ppm);
+  sample_clock_update(&clk, index, at);
+  TEST_ASSERT_EQUAL_INT64(at, sample_clock_time_us(&clk, index));
+  TEST_ASSERT_TRUE(period == clk.period_us);
+}
+
+void test_period_is_clamped(void) {
+  sample_clock clk;
+  sample_clock_reset(&clk, RATE);
+  uint64_t index = 0;
+  // Far outside the crystal tolerance: the estimate stops at the clamp (the
+  // limit applies to the period, so the rate reads slightly above it).
+  run(&clk, &index, 4000, 3000.0);
+  TEST_ASSERT_FLOAT_WITHIN(2.0f, (float)SAMPLE_CLOCK_MAX_PPM,
+                           (float)fabs(sample_clock_ppm(&clk)));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_unanchored_clock_reports_zero);
+  RUN_TEST(test_tracks_drift_and_lower_envelope);
+  RUN_TEST(test_follows_negative_drift);
+  RUN_TEST(test_large_jump_reanchors);
+  RUN_TEST(test_unlock_keeps_period);
+  RUN_TEST(test_period_is_clamped);
+  return UNITY_END();
+}
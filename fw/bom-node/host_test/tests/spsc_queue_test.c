@@ -0,0 +1,129 @@
+#include "spsc_queue.h"
+#include "unity.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+typedef struct {
+  uint64_t index;
+  int16_t payload[3];
+} item_t;
+
+static void test_capacity_rounds_up(void) {
+  spsc_queue q;
+  TEST_ASSERT_TRUE(spsc_init(&q, sizeof(item_t), 12));
+  TEST_ASSERT_EQUAL_UINT32(16, spsc_capacity(&q));
+  spsc_free(&q);
+
+  TEST_ASSERT_FALSE(spsc_init(&q, 0, 4));
+  TEST_ASSERT_FALSE(spsc_init(&q, sizeof(item_t), 0));
+}
+
+static void test_fifo_order_and_full_empty(void) {
+  spsc_queue q;
+  TEST_ASSERT_TRUE(spsc_init(&q, sizeof(item_t), 4));
+
+  item_t out;
+  TEST_ASSERT_FALSE(spsc_pop(&q, &out));
+
+  // Several laps so the free-running indices wrap the slot mask.
+  uint64_t next_in = 0, next_out = 0;
+  for (int lap = 0; lap < 5; lap++) {
+    while (spsc_count(&q) < 4) {
+      item_t in = {.index = next_in, .payload = {(int16_t)next_in, 1, 2}};
+      TEST_ASSERT_TRUE(spsc_push(&q, &in));
+      next_in++;
+    }
+    item_t extra = {0};
+    TEST_ASSERT_FALSE(spsc_push(&q, &extra));
+
+    for (int k = 0; k < 3; k++) {
+      TEST_ASSERT_TRUE(spsc_pop(&q, &out));
+      TEST_ASSERT_EQUAL_UINT64(next_out, out.index);
+      TEST_ASSERT_EQUAL_INT16((int16_t)next_out, out.payload[0]);
+      next_out++;
+    }
+  }
+  while (spsc_pop(&q, &out)) {
+    TEST_ASSERT_EQUAL_UINT64(next_out, out.index);
+    next_out++;
+  }
+  TEST_ASSERT_EQUAL_UINT64(next_in, next_out);
+  TEST_ASSERT_EQUAL_UINT32(0, spsc_count(&q));
+  spsc_free(&q);
+}
+
+static void test_attach_uses_caller_storage(void) {
+  TEST_ASSERT_EQUAL(16 * sizeof(item_t),
+                    spsc_storage_bytes(sizeof(item_t), 12));
+  TEST_ASSERT_EQUAL(0, spsc_storage_bytes(sizeof(item_t), 0));
+
+  static item_t storage[16];
+  spsc_queue q;
+  TEST_ASSERT_FALSE(spsc_attach(&q, sizeof(item_t), 12, NULL));
+  TEST_ASSERT_TRUE(spsc_attach(&q, sizeof(item_t), 12, storage));
+  TEST_ASSERT_EQUAL_UINT32(16, spsc_capacity(&q));
+
+  item_t in = {.index = 7, .payload = {1, 2, 3}};
+  TEST_ASSERT_TRUE(spsc_push(&q, &in));
+  TEST_ASSERT_EQUAL_UINT64(7, storage[0].index);
+  item_t out;
+  TEST_ASSERT_TRUE(spsc_pop(&q, &out));
+  TEST_ASSERT_EQUAL_UINT64(7, out.index);
+  // Must not free the static storage.
+  spsc_free(&q);
+  TEST_ASSERT_NULL(q.slots);
+}
+
+#define THREAD_ITEMS 200000u
+
+static void *producer(void *arg) {
+  spsc_queue *q = (spsc_queue *)arg;
+  for (uint64_t i = 0; i < THREAD_ITEMS;) {
+    item_t in = {.index = i, .payload = {(int16_t)i, (int16_t)(i >> 16), 7}};
+    if (spsc_push(q, &in)) {
+      i++;
+    } else {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static void test_concurrent_producer_consumer(void) {
+  spsc_queue q;
+  TEST_ASSERT_TRUE(spsc_init(&q, sizeof(item_t), 16));
+
+  pthread_t th;
+  TEST_ASSERT_EQUAL(0, pthread_create(&th, NULL, producer, &q));
+
+  uint64_t expect = 0;
+  while (expect < THREAD_ITEMS) {
+    item_t out;
+    if (!spsc_pop(&q, &out)) {
+      sched_yield();
+      continue;
+    }
+    // Every element arrives once, in order, with its payload intact.
+    TEST_ASSERT_EQUAL_UINT64(expect, out.index);
+    TEST_ASSERT_EQUAL_INT16((int16_t)expect, out.payload[0]);
+    TEST_ASSERT_EQUAL_INT16((int16_t)(expect >> 16), out.payload[1]);
+    expect++;
+  }
+  pthread_join(th, NULL);
+  TEST_ASSERT_EQUAL_UINT32(0, spsc_count(&q));
+  spsc_free(&q);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_capacity_rounds_up);
+  RUN_TEST(test_fifo_order_and_full_empty);
+  RUN_TEST(test_attach_uses_caller_storage);
+  RUN_TEST(test_concurrent_producer_consumer);
+  return UNITY_END();
+}
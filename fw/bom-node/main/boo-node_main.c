@@ -2,6 +2,7 @@
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 
@@ -13,42 +14,117 @@
 #include "webserver.h"
 
 #include "detector.h"
+#include "audio_arena.h"
 #include "audio_capture.h"
+#include "boot_timing.h"
 #include "audio_streamer.h"
+#include "event_uploader.h"
 #include "ota.h"
+#include "power.h"
 #include "ring_buffer.h"
+#include "sd_recorder.h"
+#include "level_meter.h"
+#include "task_monitor.h"
 
 static const char *TAG = "MAIN";
 
-void app_main(void) {
-  httpd_handle_t server = NULL;
+// Bits of s_boot_done set by the boot tasks as they finish.
+#define BOOT_NET_DONE (1u << 0)
+#define BOOT_WEB_DONE (1u << 1)
+#define BOOT_TASK_STACK 6144
+#define BOOT_TASK_PRIO 4
+
+static EventGroupHandle_t s_boot_done = NULL;
+static httpd_handle_t s_server = NULL;
+
+#ifdef CONFIG_OTA_ENABLE
+// Streaming pauses only for the image check and the partition swap; the
+// download itself runs throttled beside it.
+static void ota_on_swap(bool swapping) { audio_streamer_pause(swapping); }
+#endif
 
+// Wi-Fi association can take seconds (or not finish at all), so it runs
+// beside the audio path instead of ahead of it. OTA needs the network.
+static void boot_network_task(void *arg) {
+  (void)arg;
   esp_err_t err = middleware_init();
   if (err != ESP_OK) {
     ESP_LOGE(TAG, "Middleware init failed: %s", esp_err_to_name(err));
   }
 
-  server = start_webserver();
-  if (!server) {
-    ESP_LOGE(TAG, "Webserver init failed");
-  }
-
 #ifdef CONFIG_OTA_ENABLE
   err = ota_init();
   if (err != ESP_OK) {
     ESP_LOGE(TAG, "OTA init failed: %s", esp_err_to_name(err));
   } else {
-    ota_check_for_update();
+    ota_set_swap_hook(ota_on_swap);
+    ota_start();
+    boot_timing_mark(BOOT_STAGE_OTA);
   }
 #endif
 
+  xEventGroupSetBits(s_boot_done, BOOT_NET_DONE);
+  vTaskDelete(NULL);
+}
+
+// The SPIFFS mount is the slow part; the server itself needs only netif.
+static void boot_web_task(void *arg) {
+  (void)arg;
+  s_server = start_webserver();
+  if (!s_server) {
+    ESP_LOGE(TAG, "Webserver init failed");
+  }
+  xEventGroupSetBits(s_boot_done, BOOT_WEB_DONE);
+  vTaskDelete(NULL);
+}
+
+static void boot_spawn(TaskFunction_t fn, const char *name, EventBits_t bit) {
+  if (xTaskCreate(fn, name, BOOT_TASK_STACK, NULL, BOOT_TASK_PRIO, NULL) !=
+      pdPASS) {
+    ESP_LOGE(TAG, "Failed to create %s", name);
+    xEventGroupSetBits(s_boot_done, bit);
+  }
+}
+
+void app_main(void) {
+  // First, so the load window already covers start-up.
+  task_monitor_start();
+  boot_timing_init();
+  // Before any audio component claims its buffers.
+  audio_arena_init();
+  s_boot_done = xEventGroupCreate();
+
+  // Stage 1: what everything else needs. NVS holds the audio config.
+  esp_err_t err = middleware_init_core();
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Core init failed: %s", esp_err_to_name(err));
+  }
+  // The CPU idles at the low clock from here on; the audio tasks lock the
+  // full one while they work.
+  power_init();
+  boot_timing_mark(BOOT_STAGE_CORE);
+
+  // Stage 2: capture and detection, before any networking. The streamer and
+  // uploader only create their queues and tasks here and wait for a link.
   audio_capture_init();
   audio_streamer_init();
+  level_meter_init();
+  event_uploader_init();
+  sd_recorder_init();
   audio_capture_start();
-  // Impulse detection disabled to keep audio streaming responsive for now.
-  // impulse_detector_start();
+  boot_timing_mark(BOOT_STAGE_CAPTURE);
+  // Detection and streaming run on their own tasks (see "Task placement" in
+  // Kconfig); the reader only hands them taps.
+  impulse_detector_start();
 
-  while (1) {
-    vTaskDelay(1);
-  }
+  // Stage 3: Wi-Fi and the web UI concurrently.
+  boot_spawn(boot_network_task, "boot_net", BOOT_NET_DONE);
+  boot_spawn(boot_web_task, "boot_web", BOOT_WEB_DONE);
+
+  xEventGroupWaitBits(s_boot_done, BOOT_NET_DONE | BOOT_WEB_DONE, pdFALSE,
+                      pdTRUE, portMAX_DELAY);
+  ESP_LOGI(TAG, "Boot complete:");
+  boot_timing_log();
+  audio_arena_log();
+  // Returning deletes the main task; nothing is left to wake the CPU for.
 }
@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+"""Compare two benchmark logs from the bench app.
+
+Reads the `BENCH {...}` lines of a baseline and a candidate serial log and
+prints the change in cycles_min per kernel. Exits with 1 when a kernel got
+slower than the threshold allows, so it can gate a release.
+
+    python compare.py baseline.log candidate.log [--threshold 5]
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    results = {}
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            _, sep, payload = line.partition("BENCH ")
+            if not sep:
+                continue
+            try:
+                entry = json.loads(payload)
+            except json.JSONDecodeError:
+                continue
+            results[entry["kernel"]] = entry
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("candidate")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="allowed slowdown in percent (default 5)")
+    args = parser.parse_args()
+
+    base = load(args.baseline)
+    cand = load(args.candidate)
+    if not base or not cand:
+        sys.exit("no BENCH lines found")
+
+    regressed = False
+    print(f"{'kernel':32} {'baseline':>10} {'candidate':>10} {'change':>8}")
+    for kernel in sorted(base.keys() | cand.keys()):
+        if kernel not in base or kernel not in cand:
+            where = "baseline" if kernel not in base else "candidate"
+            print(f"{kernel:32} missing from {where}")
+            continue
+        old = base[kernel]["cycles_min"]
+        new = cand[kernel]["cycles_min"]
+        change = (new - old) * 100.0 / old if old else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressed = True
+        print(f"{kernel:32} {old:>10} {new:>10} {change:>+7.1f}%{flag}")
+    sys.exit(1 if regressed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,60 @@
+#include "bench.h"
+
+#include "esp_app_desc.h"
+#include "esp_cpu.h"
+#include "sdkconfig.h"
+
+#include <stdio.h>
+
+bench_result bench_measure(const bench_spec *spec) {
+  bench_result r = {.min = UINT32_MAX};
+  uint64_t total = 0;
+  if (spec->setup) {
+    spec->setup(spec->ctx, 0);
+  }
+  spec->run(spec->ctx, 0); // warm the caches
+  for (int i = 0; i < spec->iterations; i++) {
+    if (spec->setup) {
+      spec->setup(spec->ctx, i);
+    }
+    const uint32_t t0 = esp_cpu_get_cycle_count();
+    spec->run(spec->ctx, i);
+    const uint32_t cycles = esp_cpu_get_cycle_count() - t0;
+    total += cycles;
+    r.min = cycles < r.min ? cycles : r.min;
+    r.max = cycles > r.max ? cycles : r.max;
+  }
+  r.mean = (uint32_t)(total / (uint64_t)spec->iterations);
+
+  printf("BENCH {\"kernel\":\"%s\",\"version\":\"%s\",\"cpu_mhz\":%d,"
+         "\"iterations\":%d,\"cycles_min\":%lu,\"cycles_mean\":%lu,"
+         "\"cycles_max\":%lu",
+         spec->kernel, esp_app_get_description()->version,
+         CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, spec->iterations,
+         (unsigned long)r.min, (unsigned long)r.mean, (unsigned long)r.max);
+  if (spec->taps_per_call > 0) {
+    printf(",\"cycles_per_tap\":%.1f", r.min / spec->taps_per_call);
+  }
+  printf("}\n");
+  return r;
+}
+
+void bench_noise(int16_t *out, int n, uint32_t *seed) {
+  for (int i = 0; i < n; i++) {
+    const uint32_t v = bench_rand(seed);
+    int32_t s = (int16_t)(v >> 16) >> 6;
+    if ((v & 0xff) == 0) {
+      s *= 16;
+    }
+    out[i] = (int16_t)s;
+  }
+}
+
+void bench_i2s_frames(int32_t *out, int frames, uint32_t *seed) {
+  int16_t s[2];
+  for (int i = 0; i < frames; i++) {
+    bench_noise(s, 2, seed);
+    out[2 * i] = (int32_t)((uint32_t)(uint16_t)s[0] << 16);
+    out[2 * i + 1] = (int32_t)((uint32_t)(uint16_t)s[1] << 16);
+  }
+}
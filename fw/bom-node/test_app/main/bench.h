@@ -0,0 +1,51 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+// Cycle-count harness for the kernel benchmarks.
+//
+// Each benchmark runs a kernel `iterations` times on inputs generated from a
+// fixed seed, after one untimed warm-up call, and prints one line
+//
+//   BENCH {"kernel":...,"version":...,"cycles_min":...,...}
+//
+// that compare.py diffs between firmware versions. Cycles are read from the
+// CPU cycle counter around each call only; any per-call input setup runs
+// untimed.
+
+#define BENCH_SEED 0x2545f491u
+#define BENCH_ITERATIONS 256
+
+typedef struct {
+  uint32_t min;   // fastest call: the kernel without interrupt noise
+  uint32_t mean;
+  uint32_t max;
+} bench_result;
+
+typedef struct {
+  const char *kernel;
+  // Untimed, before call `i`; may be NULL.
+  void (*setup)(void *ctx, int i);
+  void (*run)(void *ctx, int i);
+  void *ctx;
+  int iterations;
+  // For cycles_per_tap; 0 for kernels that do not scale with taps.
+  float taps_per_call;
+} bench_spec;
+
+bench_result bench_measure(const bench_spec *spec);
+
+// Next value of the seeded generator.
+static inline uint32_t bench_rand(uint32_t *seed) {
+  *seed = *seed * 1664525u + 1013904223u;
+  return *seed;
+}
+
+// Quiet noise with sparse +-16x outliers, like a mic between impulses.
+void bench_noise(int16_t *out, int n, uint32_t *seed);
+
+// Raw I2S frames (32-bit slots, sample in the upper half) of that noise.
+void bench_i2s_frames(int32_t *out, int frames, uint32_t *seed);
+
+#endif
@@ -0,0 +1,13 @@
+#include "esp_app_desc.h"
+#include "unity.h"
+#include "unity_test_runner.h"
+
+#include <stdio.h>
+
+void app_main(void) {
+  printf("Kernel benchmarks, firmware %s\n",
+         esp_app_get_description()->version);
+  UNITY_BEGIN();
+  unity_run_all_tests();
+  UNITY_END();
+}
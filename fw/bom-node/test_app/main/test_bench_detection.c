@@ -0,0 +1,111 @@
+#include "bench.h"
+#include "median_detection.h"
+#include "unity.h"
+
+#include <stdlib.h>
+
+// Distinct noise taps cycled through, so the sorted columns keep moving.
+#define PREPARED_TAPS 64
+
+typedef struct {
+  impulse_detector mono;
+  impulse_stereo_detector stereo;
+  void *storage;
+  int16_t left[PREPARED_TAPS][TAP_SIZE];
+  int16_t right[PREPARED_TAPS][TAP_SIZE];
+  uint64_t next_index;
+  int next_tap;
+} detect_ctx;
+
+static detect_ctx *detect_ctx_create(void) {
+  detect_ctx *c = calloc(1, sizeof(*c));
+  TEST_ASSERT_NOT_NULL(c);
+  const impulse_detector_cfg cfg = IMPULSE_DETECTOR_CFG_DEFAULT();
+  const size_t mono = impulse_detector_storage_size(&cfg);
+  const size_t stereo = impulse_stereo_detector_storage_size(&cfg);
+  c->storage = malloc(mono + stereo);
+  TEST_ASSERT_NOT_NULL(c->storage);
+  TEST_ASSERT_EQUAL(IMPULSE_DET_OK, impulse_detector_init(&c->mono, &cfg,
+                                                          c->storage, mono));
+  TEST_ASSERT_EQUAL(IMPULSE_DET_OK,
+                    impulse_stereo_detector_init(
+                        &c->stereo, &cfg, (uint8_t *)c->storage + mono,
+                        stereo));
+  uint32_t seed = BENCH_SEED;
+  for (int t = 0; t < PREPARED_TAPS; t++) {
+    bench_noise(c->left[t], TAP_SIZE, &seed);
+    bench_noise(c->right[t], TAP_SIZE, &seed);
+  }
+  return c;
+}
+
+static void detect_ctx_free(detect_ctx *c) {
+  free(c->storage);
+  free(c);
+}
+
+static void add_mono(void *ctx, int i) {
+  detect_ctx *c = ctx;
+  impulse_add_tap(&c->mono, c->left[c->next_tap], c->next_index);
+  c->next_tap = (c->next_tap + 1) % PREPARED_TAPS;
+  c->next_index += TAP_SIZE;
+}
+
+static void add_stereo(void *ctx, int i) {
+  detect_ctx *c = ctx;
+  impulse_stereo_add_tap(&c->stereo, c->left[c->next_tap],
+                         c->right[c->next_tap], c->next_index);
+  c->next_tap = (c->next_tap + 1) % PREPARED_TAPS;
+  c->next_index += TAP_SIZE;
+}
+
+static void detect_mono(void *ctx, int i) {
+  impulse_result r;
+  impulse_run_detection(&((detect_ctx *)ctx)->mono, &r);
+}
+
+static void detect_stereo(void *ctx, int i) {
+  impulse_stereo_result r;
+  impulse_stereo_run_detection(&((detect_ctx *)ctx)->stereo, &r);
+}
+
+// Measures `run` on a full window; `setup` feeds a tap before each call when
+// `run` does not add one itself.
+static void bench_detector(const char *kernel, void (*fill)(void *, int),
+                           void (*setup)(void *, int),
+                           void (*run)(void *, int)) {
+  detect_ctx *c = detect_ctx_create();
+  for (int t = 0; t < TAP_COUNT; t++) {
+    fill(c, t);
+  }
+  const bench_spec spec = {
+      .kernel = kernel,
+      .setup = setup,
+      .run = run,
+      .ctx = c,
+      .iterations = BENCH_ITERATIONS,
+      .taps_per_call = 1,
+  };
+  const bench_result r = bench_measure(&spec);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, r.min);
+  detect_ctx_free(c);
+}
+
+TEST_CASE("impulse_add_tap", "[bench]") {
+  bench_detector("impulse_add_tap", add_mono, NULL, add_mono);
+}
+
+TEST_CASE("impulse_run_detection", "[bench]") {
+  bench_detector("impulse_run_detection", add_mono, add_mono, detect_mono);
+}
+
+// The firmware runs the stereo detector; these are the per-tap costs on the
+// detection task.
+TEST_CASE("impulse_stereo_add_tap", "[bench]") {
+  bench_detector("impulse_stereo_add_tap", add_stereo, NULL, add_stereo);
+}
+
+TEST_CASE("impulse_stereo_run_detection", "[bench]") {
+  bench_detector("impulse_stereo_run_detection", add_stereo, add_stereo,
+                 detect_stereo);
+}
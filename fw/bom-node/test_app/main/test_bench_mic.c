@@ -0,0 +1,114 @@
+#include "bench.h"
+#include "mic_dsp.h"
+#include "mic_input.h"
+#include "ring_buffer.h"
+#include "unity.h"
+
+#include <stdlib.h>
+
+#define TAPS_PER_CHUNK ((float)CHUNK_FRAMES / MIC_DEFAULT_TAP_SIZE)
+
+typedef struct {
+  int32_t in[CHUNK_FRAMES * 2];
+  mic_dc_filter left, right;
+  int16_t out_left[CHUNK_FRAMES], out_right[CHUNK_FRAMES];
+  int64_t sum_left, sum_right;
+} dsp_ctx;
+
+static dsp_ctx s_dsp;
+
+static void run_process_chunk(void *ctx, int i) {
+  dsp_ctx *c = ctx;
+  mic_dsp_process_chunk(c->in, CHUNK_FRAMES, DC_OFFSET_LEFT, DC_OFFSET_RIGHT,
+                        &c->left, &c->right, c->out_left, c->out_right);
+}
+
+static void run_sum_chunk(void *ctx, int i) {
+  dsp_ctx *c = ctx;
+  mic_dsp_sum_chunk(c->in, CHUNK_FRAMES, &c->sum_left, &c->sum_right);
+}
+
+static void bench_dc_blocker(const char *kernel, mic_dc_filter_type type) {
+  uint32_t seed = BENCH_SEED;
+  bench_i2s_frames(s_dsp.in, CHUNK_FRAMES, &seed);
+  mic_dc_filter_init(&s_dsp.left, MIC_SAMPLING_FREQUENCY, DC_BLOCK_FREQ_HZ,
+                     type);
+  s_dsp.right = s_dsp.left;
+  const bench_spec spec = {
+      .kernel = kernel,
+      .run = run_process_chunk,
+      .ctx = &s_dsp,
+      .iterations = BENCH_ITERATIONS,
+      .taps_per_call = TAPS_PER_CHUNK,
+  };
+  const bench_result r = bench_measure(&spec);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, r.min);
+}
+
+// The DC blocker runs fused with deinterleaving and offset correction; a
+// chunk is one call.
+TEST_CASE("dc blocker, one pole", "[bench]") {
+  bench_dc_blocker("dc_block_one_pole", MIC_DC_ONE_POLE);
+}
+
+TEST_CASE("dc blocker, biquad", "[bench]") {
+  bench_dc_blocker("dc_block_biquad", MIC_DC_BIQUAD_HPF);
+}
+
+// Deinterleave on its own: the calibration pass over raw frames.
+TEST_CASE("deinterleave", "[bench]") {
+  uint32_t seed = BENCH_SEED;
+  bench_i2s_frames(s_dsp.in, CHUNK_FRAMES, &seed);
+  s_dsp.sum_left = s_dsp.sum_right = 0;
+  const bench_spec spec = {
+      .kernel = "deinterleave_sum",
+      .run = run_sum_chunk,
+      .ctx = &s_dsp,
+      .iterations = BENCH_ITERATIONS,
+      .taps_per_call = TAPS_PER_CHUNK,
+  };
+  const bench_result r = bench_measure(&spec);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, r.min);
+}
+
+typedef struct {
+  rb_struct rb;
+  int16_t *out;
+  int count;
+} ring_ctx;
+
+static void run_copy_tail(void *ctx, int i) {
+  ring_ctx *c = ctx;
+  rb_copy_tail(&c->rb, c->out, 0, c->count);
+}
+
+// An event save: the whole detection window out of a ring that has wrapped.
+TEST_CASE("rb_copy_tail", "[bench]") {
+  const int window = MIC_DEFAULT_NUM_TAPS * MIC_DEFAULT_TAP_SIZE;
+  ring_ctx c = {.count = window};
+  rb_init(&c.rb, 4 * window);
+  c.out = malloc(window * sizeof(int16_t));
+  int16_t *fill = malloc(window * sizeof(int16_t));
+  TEST_ASSERT_NOT_NULL(c.out);
+  TEST_ASSERT_NOT_NULL(fill);
+  uint32_t seed = BENCH_SEED;
+  for (int k = 0; k < 5; k++) { // leave the head mid-ring
+    bench_noise(fill, window, &seed);
+    rb_push_block(&c.rb, fill, window);
+  }
+  bench_noise(fill, window / 2, &seed);
+  rb_push_block(&c.rb, fill, window / 2);
+
+  const bench_spec spec = {
+      .kernel = "rb_copy_tail",
+      .run = run_copy_tail,
+      .ctx = &c,
+      .iterations = BENCH_ITERATIONS,
+      .taps_per_call = MIC_DEFAULT_NUM_TAPS,
+  };
+  const bench_result r = bench_measure(&spec);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, r.min);
+  free(fill);
+  free(c.out);
+  rb_free(&c.rb);
+}
@@ -0,0 +1,69 @@
+#include "audio_streamer.h"
+#include "audio_wav.h"
+#include "bench.h"
+#include "mic_input.h"
+#include "unity.h"
+
+typedef struct {
+  int16_t left[MIC_DEFAULT_TAP_SIZE * 8];
+  int16_t right[MIC_DEFAULT_TAP_SIZE * 8];
+  uint64_t next_index;
+} tap_ctx;
+
+static tap_ctx s_taps;
+
+static void run_on_tap(void *ctx, int i) {
+  tap_ctx *c = ctx;
+  const int slot = i % 8;
+  const mic_tap_view view = {
+      .left = &c->left[slot * MIC_DEFAULT_TAP_SIZE],
+      .right = &c->right[slot * MIC_DEFAULT_TAP_SIZE],
+      .length = MIC_DEFAULT_TAP_SIZE,
+      .sample_index = c->next_index,
+  };
+  audio_streamer_test_on_tap(&view);
+  c->next_index += MIC_DEFAULT_TAP_SIZE;
+}
+
+// Chunk accumulation on the reader task, the part every tap pays while a
+// stream is on; sending runs on the streamer task.
+TEST_CASE("audio_streamer_on_tap", "[bench]") {
+  uint32_t seed = BENCH_SEED;
+  bench_noise(s_taps.left, MIC_DEFAULT_TAP_SIZE * 8, &seed);
+  bench_noise(s_taps.right, MIC_DEFAULT_TAP_SIZE * 8, &seed);
+  const bench_spec spec = {
+      .kernel = "audio_streamer_on_tap",
+      .run = run_on_tap,
+      .ctx = &s_taps,
+      .iterations = BENCH_ITERATIONS,
+      .taps_per_call = 1,
+  };
+  const bench_result r = bench_measure(&spec);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, r.min);
+}
+
+typedef struct {
+  uint8_t out[AUDIO_WAV_STREAM_HEADER_MAX];
+  audio_wav_stamp stamp;
+  size_t len;
+} wav_ctx;
+
+static void run_wav_header(void *ctx, int i) {
+  wav_ctx *c = ctx;
+  c->len = audio_wav_build_header(c->out, MIC_SAMPLING_FREQUENCY, 2, &c->stamp);
+}
+
+// Once per stream, with the capture stamp every stream carries.
+TEST_CASE("audio_wav_build_header", "[bench]") {
+  wav_ctx c = {.stamp = {.sample_index = 123456789,
+                         .uptime_us = 987654321,
+                         .unix_us = 1760000000000000LL}};
+  const bench_spec spec = {
+      .kernel = "audio_wav_build_header",
+      .run = run_wav_header,
+      .ctx = &c,
+      .iterations = BENCH_ITERATIONS,
+  };
+  bench_measure(&spec);
+  TEST_ASSERT_EQUAL(AUDIO_WAV_HEADER_BYTES + AUDIO_WAV_STAMP_BYTES, c.len);
+}
@@ -0,0 +1,58 @@
+#include "median_detection_runner.h"
+#include "impulse_coalesce.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Zapíše skupinu zásahů uzavřenou na pozici `horizon`.
+static void emit_group(impulse_coalescer *groups, uint64_t horizon,
+                       int64_t *positions, size_t capacity, size_t *hits) {
+  impulse_coalesced_hit done;
+  if (!impulse_coalesce_flush(groups, horizon, &done)) {
+    return;
+  }
+  if (positions != NULL && *hits < capacity) {
+    positions[*hits] = (int64_t)done.peak_index;
+  }
+  ++*hits;
+}
+
+int detect_recording_median_i16(const int16_t *samples, size_t n,
+                                const impulse_detector_cfg *cfg,
+                                int64_t *positions, size_t capacity) {
+  if (samples == NULL || cfg == NULL) {
+    return IMPULSE_DET_ERR_INVALID_ARG;
+  }
+  size_t needed = impulse_detector_storage_size(cfg);
+  if (needed == 0) {
+    return IMPULSE_DET_ERR_INVALID_ARG;
+  }
+  void *buf = malloc(needed);
+  if (buf == NULL) {
+    return IMPULSE_DET_ERR_BUFFER_TOO_SMALL;
+  }
+  impulse_detector det;
+  enum impulse_det_state st = impulse_detector_init(&det, cfg, buf, needed);
+  if (st != IMPULSE_DET_OK) {
+    free(buf);
+    return st;
+  }
+
+  // Stejné slučování zásahů jako ve firmwaru, viz impulse_coalesce.h.
+  impulse_coalescer groups;
+  impulse_coalesce_init(&groups, cfg->refractory);
+  size_t hits = 0;
+  for (size_t i = 0; i + cfg->tap_size <= n; i += cfg->tap_size) {
+    impulse_add_tap(&det, samples + i, (uint64_t)i);
+    impulse_result res;
+    if (impulse_run_detection(&det, &res)) {
+      emit_group(&groups, res.peak_index, positions, capacity, &hits);
+      impulse_coalesce_add(&groups, res.peak_index, res.level);
+    }
+  }
+  emit_group(&groups, UINT64_MAX, positions, capacity, &hits);
+
+  free(buf);
+  return (int)hits;
+}
@@ -0,0 +1,37 @@
+#ifndef MEDIAN_DETECTION_RUNNER_H
+#define MEDIAN_DETECTION_RUNNER_H
+
+/**
+ * @file median_detection_runner.h
+ * @brief Offline běh firmwarového detektoru (sorted columns) nad nahrávkou.
+ *
+ * Jádro detektoru je sdílené s firmwarem
+ * (`fw/bom-node/components/impulse_detection/median-detector`), takže výsledky
+ * i výkon na hostu odpovídají tomu, co běží na zařízení.
+ */
+
+#include "median_detection.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Offline detekce nad celou nahrávkou (16bit) firmwarovým algoritmem.
+ *
+ * Nahrávka se zpracuje po tapech délky @c cfg->tap_size; zbytek kratší než
+ * tap se ignoruje stejně jako ve firmwaru. Paměť stavu se alokuje jednou na
+ * začátku volání. Zásahy v refrakterním okně @c cfg->refractory se sloučí do
+ * nejsilnějšího z nich jako ve firmwaru (impulse_coalesce.h).
+ *
+ * @param samples   vstupní pole vzorků
+ * @param n         počet vzorků
+ * @param cfg       konfigurace (geometrie + prahy)
+ * @param positions výstupní pole pro nalezené pozice (absolutní indexy piku)
+ * @param capacity  kapacita pole positions
+ * @return počet detekovaných pozic (>=0) nebo chybový kód (<0)
+ */
+int detect_recording_median_i16(const int16_t *samples, size_t n,
+                                const impulse_detector_cfg *cfg,
+                                int64_t *positions, size_t capacity);
+
+#endif // MEDIAN_DETECTION_RUNNER_H
@@ -0,0 +1,151 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "peak_bench.h"
+
+#include "median_detection.h"
+#include "peak_detector.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void record(int64_t *positions, size_t capacity, size_t *hits,
+                   int64_t pos) {
+  if (positions != NULL && *hits < capacity) {
+    positions[*hits] = pos;
+  }
+  ++*hits;
+}
+
+static void record_time(uint32_t *block_ns, size_t block_capacity,
+                        size_t block, uint64_t t0) {
+  const uint64_t dt = now_ns() - t0;
+  if (block_ns != NULL && block < block_capacity) {
+    block_ns[block] = dt > UINT32_MAX ? UINT32_MAX : (uint32_t)dt;
+  }
+}
+
+static int run_heaps(const int16_t *samples, size_t n,
+                     const struct peak_bench_cfg *cfg, int64_t *positions,
+                     size_t capacity, uint32_t *block_ns,
+                     size_t block_capacity) {
+  if (cfg->num_taps > UINT8_MAX) {
+    return PEAK_DET_ERR_INVALID_ARG;
+  }
+  const struct median_detector_cfg hcfg = {
+      .num_taps = (uint8_t)cfg->num_taps,
+      .tap_size = cfg->tap_size,
+      .levels = {.det_level = (int16_t)cfg->det_level,
+                 .det_rms = (int16_t)cfg->det_rms,
+                 .det_energy = (int16_t)cfg->det_energy},
+  };
+  size_t needed = 0;
+  enum peak_det_state st = detector_state_size(&hcfg, &needed);
+  if (st != PEAK_DET_OK) {
+    return st;
+  }
+  uint8_t *buf = (uint8_t *)malloc(needed);
+  if (buf == NULL) {
+    return PEAK_DET_ERR_BUFFER_TOO_SMALL;
+  }
+  struct detector_state *state = NULL;
+  st = detector_init(buf, needed, &hcfg, &state);
+  if (st != PEAK_DET_OK) {
+    free(buf);
+    return st;
+  }
+
+  size_t hits = 0;
+  size_t block = 0;
+  for (size_t i = 0; i + cfg->tap_size <= n; i += cfg->tap_size, block++) {
+    struct detector_result res;
+    const uint64_t t0 = now_ns();
+    st = detector_feed_block(state, samples + i, (int64_t)i, &res);
+    record_time(block_ns, block_capacity, block, t0);
+    if (st != PEAK_DET_OK) {
+      detector_deinit(state);
+      free(buf);
+      return st;
+    }
+    if (res.hit) {
+      record(positions, capacity, &hits, res.peak_index);
+    }
+  }
+
+  detector_deinit(state);
+  free(buf);
+  return (int)hits;
+}
+
+static int run_median(bool generic, const int16_t *samples, size_t n,
+                      const struct peak_bench_cfg *cfg, int64_t *positions,
+                      size_t capacity, uint32_t *block_ns,
+                      size_t block_capacity) {
+  const impulse_detector_cfg mcfg = {
+      .tap_count = cfg->num_taps,
+      .tap_size = cfg->tap_size,
+      .det_level = cfg->det_level,
+      .det_rms = cfg->det_rms,
+      .det_energy = cfg->det_energy,
+  };
+  const size_t needed = impulse_detector_storage_size(&mcfg);
+  if (needed == 0) {
+    return IMPULSE_DET_ERR_INVALID_ARG;
+  }
+  void *buf = malloc(needed);
+  if (buf == NULL) {
+    return IMPULSE_DET_ERR_BUFFER_TOO_SMALL;
+  }
+  impulse_detector det;
+  const enum impulse_det_state st =
+      impulse_detector_init(&det, &mcfg, buf, needed);
+  if (st != IMPULSE_DET_OK) {
+    free(buf);
+    return st;
+  }
+  if (generic) {
+    median_test_force_generic(&det);
+  }
+
+  size_t hits = 0;
+  size_t block = 0;
+  for (size_t i = 0; i + cfg->tap_size <= n; i += cfg->tap_size, block++) {
+    impulse_result res;
+    const uint64_t t0 = now_ns();
+    impulse_add_tap(&det, samples + i, (uint64_t)i);
+    const bool hit = impulse_run_detection(&det, &res);
+    record_time(block_ns, block_capacity, block, t0);
+    if (hit) {
+      record(positions, capacity, &hits, (int64_t)res.peak_index);
+    }
+  }
+
+  free(buf);
+  return (int)hits;
+}
+
+int peak_bench_run_i16(int variant, const int16_t *samples, size_t n,
+                       const struct peak_bench_cfg *cfg, int64_t *positions,
+                       size_t capacity, uint32_t *block_ns,
+                       size_t block_capacity) {
+  if (samples == NULL || cfg == NULL) {
+    return PEAK_DET_ERR_INVALID_ARG;
+  }
+  switch (variant) {
+  case PEAK_BENCH_HEAPS:
+    return run_heaps(samples, n, cfg, positions, capacity, block_ns,
+                     block_capacity);
+  case PEAK_BENCH_SORTED_GENERIC:
+  case PEAK_BENCH_FIRMWARE:
+    return run_median(variant == PEAK_BENCH_SORTED_GENERIC, samples, n, cfg,
+                      positions, capacity, block_ns, block_capacity);
+  default:
+    return PEAK_DET_ERR_INVALID_ARG;
+  }
+}
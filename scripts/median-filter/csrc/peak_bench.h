@@ -0,0 +1,55 @@
+#ifndef PEAK_BENCH_H
+#define PEAK_BENCH_H
+
+/**
+ * @file peak_bench.h
+ * @brief Měření variant detektoru nad nahrávkou po jednotlivých tapech.
+ *
+ * Stejný průchod jako detect_recording_i16() a
+ * detect_recording_median_i16(), navíc se ale měří doba zpracování každého
+ * tapu (CLOCK_MONOTONIC), aby šlo z Pythonu spočítat propustnost i
+ * percentily latence. Volá se přes ctypes z `python/benchmark.py`.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Porovnávané varianty detektoru.
+ */
+enum peak_bench_variant {
+  PEAK_BENCH_HEAPS = 0,          /**< peak_detector: mediány ze dvou hald. */
+  PEAK_BENCH_SORTED_GENERIC = 1, /**< Firmware, obecná cesta (setříděné sloupce). */
+  PEAK_BENCH_FIRMWARE = 2        /**< Firmware, specializovaná geometrie, pokud existuje. */
+};
+
+/**
+ * @brief Geometrie a prahy; varianta haldy bere prahy jako int16.
+ */
+struct peak_bench_cfg {
+  uint16_t num_taps;
+  uint16_t tap_size;
+  uint32_t det_level;
+  float det_rms;
+  float det_energy;
+};
+
+/**
+ * @brief Detekce nad celou nahrávkou s časem každého tapu.
+ *
+ * @param variant        enum peak_bench_variant
+ * @param samples        vstupní pole vzorků
+ * @param n              počet vzorků; zbytek kratší než tap se ignoruje
+ * @param cfg            konfigurace
+ * @param positions      výstupní pole nalezených pozic (absolutní indexy), může být NULL
+ * @param capacity       kapacita pole positions
+ * @param block_ns       výstupní doba zpracování tapu v ns, může být NULL
+ * @param block_capacity kapacita pole block_ns
+ * @return počet detekovaných pozic (>=0) nebo chybový kód (<0)
+ */
+int peak_bench_run_i16(int variant, const int16_t *samples, size_t n,
+                       const struct peak_bench_cfg *cfg, int64_t *positions,
+                       size_t capacity, uint32_t *block_ns,
+                       size_t block_capacity);
+
+#endif // PEAK_BENCH_H
@@ -68,10 +68,10 @@ struct detector_state {
   uint32_t *sqr_ring; // length num_taps * tap_size
   int64_t base_offset;
 
-  // runtime
+  // runtime; saturates at the window length, so it cannot wrap on a live feed
   size_t sample_count;
 
-  // generator
+  // generator; wraps, all comparisons are modulo 2^32
   uint32_t current_gen;
 };
 
@@ -169,13 +169,21 @@ static void layout_state(void *mem_base, const struct median_detector_cfg *cfg,
 // --- heap helpers (per offset)
 // ------------------------------------------------
 
+// Pořadí generací modulo 2^32: heap_compact() drží v haldách jen živé uzly,
+// ty jsou od sebe nejvýš num_taps generací, takže přetečení current_gen
+// pořadí nezmění.
+static inline int gen_cmp(uint32_t a, uint32_t b) {
+  const int32_t d = (int32_t)(a - b);
+  return (d > 0) - (d < 0);
+}
+
 static inline int heap_cmp_max(const struct heap_node *a,
                                const struct heap_node *b) {
   if (a->value != b->value) {
     return (int)a->value - (int)b->value;
   }
   // tie-breaker: newer generation first
-  return (int)a->gen - (int)b->gen;
+  return gen_cmp(a->gen, b->gen);
 }
 
 static inline int heap_cmp_min(const struct heap_node *a,
@@ -183,7 +191,7 @@ static inline int heap_cmp_min(const struct heap_node *a,
   if (a->value != b->value) {
     return (int)b->value - (int)a->value;
   }
-  return (int)b->gen - (int)a->gen;
+  return gen_cmp(b->gen, a->gen);
 }
 
 static inline bool heap_is_stale(const struct heap_node *n,
@@ -378,13 +386,79 @@ uint64_t peak_test_rms_acc(const struct detector_state *s) {
   }
   return s->rms_acc;
 }
+
+void peak_test_set_generation(struct detector_state *s, uint32_t gen) {
+  if (s) {
+    s->current_gen = gen;
+  }
+}
 #endif
 // --- helpers -----------------------------------------------------------------
 
-static int cmp_int16(const void *a, const void *b) {
-  int16_t av = *(const int16_t *)a;
-  int16_t bv = *(const int16_t *)b;
-  return (av > bv) - (av < bv);
+// Krátké úseky se řadí vkládáním, delší se zužují rozdělováním kolem
+// mediánu ze tří (nth_element); obojí bez volání porovnávací funkce.
+#define SELECT_INSERTION_MAX 16
+
+static void insertion_sort_int16(int16_t *a, size_t len) {
+  for (size_t i = 1; i < len; ++i) {
+    int16_t v = a[i];
+    size_t j = i;
+    for (; j > 0 && a[j - 1] > v; --j) {
+      a[j] = a[j - 1];
+    }
+    a[j] = v;
+  }
+}
+
+static inline void swap_int16(int16_t *a, int16_t *b) {
+  int16_t t = *a;
+  *a = *b;
+  *b = t;
+}
+
+/**
+ * @brief k-tý nejmenší prvek (jako tmp[k] po seřazení); pole přeuspořádá.
+ */
+static int16_t select_nth_int16(int16_t *a, size_t len, size_t k) {
+  size_t lo = 0;
+  size_t hi = len; // [lo, hi) obsahuje k
+  while (hi - lo > SELECT_INSERTION_MAX) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (a[mid] < a[lo]) {
+      swap_int16(&a[mid], &a[lo]);
+    }
+    if (a[hi - 1] < a[lo]) {
+      swap_int16(&a[hi - 1], &a[lo]);
+    }
+    if (a[hi - 1] < a[mid]) {
+      swap_int16(&a[hi - 1], &a[mid]);
+    }
+    const int16_t pivot = a[mid];
+    // Hoare: po skončení [lo, j] <= pivot <= [j + 1, hi).
+    size_t i = lo;
+    size_t j = hi - 1;
+    for (;;) {
+      while (a[i] < pivot) {
+        ++i;
+      }
+      while (a[j] > pivot) {
+        --j;
+      }
+      if (i >= j) {
+        break;
+      }
+      swap_int16(&a[i], &a[j]);
+      ++i;
+      --j;
+    }
+    if (k <= j) {
+      hi = j + 1;
+    } else {
+      lo = j + 1;
+    }
+  }
+  insertion_sort_int16(a + lo, hi - lo);
+  return a[k];
 }
 
 // Maximum supported slice length for median calculation.
@@ -411,9 +485,14 @@ static int16_t median_of_slice(const int16_t *arr, size_t len) {
   }
 
   memcpy(tmp, arr, actual_len * sizeof(int16_t));
-  qsort(tmp, actual_len, sizeof(int16_t), cmp_int16);
-  return tmp[actual_len / 2];
+  return select_nth_int16(tmp, actual_len, actual_len / 2);
+}
+
+#ifdef PEAK_DETECTOR_TESTING
+int16_t peak_test_median_of_slice(const int16_t *arr, size_t len) {
+  return median_of_slice(arr, len);
 }
+#endif
 
 enum peak_det_state detector_init(void *mem, size_t mem_size,
                                   const struct median_detector_cfg *cfg,
@@ -491,42 +570,49 @@ int detector_feed_block(struct detector_state *s, const int16_t *block,
   size_t base = (size_t)s->write_tap * s->tap_size;
   uint32_t gen = ++s->current_gen;
 
-  for (uint16_t i = 0; i < s->tap_size; ++i) {
-    size_t idx = base + i;
-    int16_t old = s->samples[idx];
-    int16_t val = block[i];
-
-    // RMS update
-    int32_t old32 = (int32_t)old;
-    int32_t val32 = (int32_t)val;
-    uint64_t old_sqr = (uint64_t)(old32 * old32);
-    uint64_t new_sqr = (uint64_t)(val32 * val32);
-    if (s->sqr_ring != NULL) {
-      s->rms_acc -= s->sqr_ring[idx];
+  // RMS update: čtverce celého tapu v samostatné smyčce bez větvení, kterou
+  // překladač vektorizuje (SSE2/AVX2/NEON podle cíle). Součty jsou celočíselné,
+  // výsledek je tedy stejný jako po vzorcích.
+  int16_t *ring = &s->samples[base];
+  uint64_t removed = 0;
+  uint64_t added = 0;
+  if (s->sqr_ring != NULL) {
+    uint32_t *sqr = &s->sqr_ring[base];
+    for (uint16_t i = 0; i < s->tap_size; ++i) {
       // Safe cast: max value for int16_t is 32767^2 =
       // 1,073,741,824 < UINT32_MAX
-      s->sqr_ring[idx] = (uint32_t)new_sqr;
-      s->rms_acc += s->sqr_ring[idx];
-    } else {
-      s->rms_acc -= old_sqr;
-      s->rms_acc += new_sqr;
+      const uint32_t v = (uint32_t)((int32_t)block[i] * (int32_t)block[i]);
+      removed += sqr[i];
+      added += v;
+      sqr[i] = v;
     }
+  } else {
+    for (uint16_t i = 0; i < s->tap_size; ++i) {
+      removed += (uint32_t)((int32_t)ring[i] * (int32_t)ring[i]);
+      added += (uint32_t)((int32_t)block[i] * (int32_t)block[i]);
+    }
+  }
+  s->rms_acc = s->rms_acc - removed + added;
+  memcpy(ring, block, (size_t)s->tap_size * sizeof(int16_t));
 
-    s->samples[idx] = val;
-    median_update_offset(&s->med[i], val, s->write_tap, gen);
+  for (uint16_t i = 0; i < s->tap_size; ++i) {
+    median_update_offset(&s->med[i], block[i], s->write_tap, gen);
   }
 
   s->write_tap = (uint8_t)((s->write_tap + 1) % s->num_taps);
-  s->sample_count += s->tap_size;
+  // vyhodnocení detekce až když máme plné okno
+  size_t window_len = (size_t)s->num_taps * s->tap_size;
+  if (s->sample_count < window_len) {
+    s->sample_count += s->tap_size;
+  }
   s->base_offset = block_start_offset;
 
   if (out) {
     out->hit = false;
     out->peak_index = -1;
+    out->level = 0;
   }
 
-  // vyhodnocení detekce až když máme plné okno
-  size_t window_len = (size_t)s->num_taps * s->tap_size;
   if (s->sample_count < window_len) {
     return PEAK_DET_OK;
   }
@@ -591,13 +677,14 @@ int detector_feed_block(struct detector_state *s, const int16_t *block,
   }
 
   out->hit = hit;
+  out->level = hit ? peak_val : 0;
   if (hit) {
     // newest tap index je (write_tap + num_taps - 1) % num_taps
     uint8_t newest = (uint8_t)((s->write_tap + s->num_taps - 1) % s->num_taps);
     uint8_t delta =
         (uint8_t)((newest + s->num_taps - middle_idx) % s->num_taps);
     int64_t middle_start = block_start_offset - ((int64_t)delta * s->tap_size);
-    out->peak_index = (int)(middle_start + peak_pos);
+    out->peak_index = middle_start + peak_pos;
   } else {
     out->peak_index = -1;
   }
@@ -23,7 +23,9 @@ enum peak_det_state {
   PEAK_DET_OK = 0,                         /**< Úspěch. */
   PEAK_DET_ERR_CFG_UNINITIALIZED = -200,   /**< Konfigurace nebo výstupní ukazatel nebyl předán. */
   PEAK_DET_ERR_BUFFER_TOO_SMALL = -201,    /**< Uživatel dodal příliš malý buffer pro stav. */
-  PEAK_DET_ERR_INVALID_ARG = -202          /**< Neplatný vstup (např. nulové parametry). */
+  PEAK_DET_ERR_INVALID_ARG = -202,         /**< Neplatný vstup (např. nulové parametry). */
+  PEAK_DET_ERR_IO = -203,                  /**< Chyba čtení vstupního souboru. */
+  PEAK_DET_ERR_FORMAT = -204               /**< Vstup není 16bit PCM WAV. */
 };
 
 /**
@@ -52,6 +54,11 @@ struct median_detector_cfg {
   uint8_t num_taps;                    /**< Počet tapů v okně (>=2). */
   uint16_t tap_size;                   /**< Délka jednoho tapu. */
   struct median_detector_levels levels;/**< Nastavení prahů detekce. */
+  uint32_t refractory;                 /**< Refrakterní okno ve vzorcích pro
+                                            slučování zásahů (viz
+                                            impulse_coalesce.h), 0 = každý
+                                            zásah zvlášť. Používají ho jen
+                                            offline běhy nad nahrávkou. */
 };
 
 /**
@@ -59,7 +66,8 @@ struct median_detector_cfg {
  */
 struct detector_result {
   bool hit;       /**< True, pokud byl nalezen platný pík. */
-  int peak_index; /**< Absolutní index piku v nahrávce, nebo -1. */
+  int64_t peak_index; /**< Absolutní index piku v nahrávce, nebo -1. */
+  int16_t level;  /**< Výška piku nad mediánem šumu, platí při @c hit. */
 };
 
 // Forward declaration for opaque state
@@ -122,6 +130,10 @@ int detector_feed_block(struct detector_state *s, const int16_t *block,
 /**
  * @brief Offline detekce nad celou nahrávkou (16bit).
  *
+ * Zásahy bližší než @c cfg->refractory vzorků za prvním zásahem skupiny se
+ * sloučí do jednoho se vzorkem nejsilnějšího z nich, stejně jako ve
+ * firmwaru (impulse_coalesce.h). Totéž platí pro ostatní offline běhy.
+ *
  * @param samples   vstupní pole vzorků
  * @param n         počet vzorků
  * @param cfg       konfigurace
@@ -133,6 +145,63 @@ int detect_recording_i16(const int16_t *samples, size_t n,
                          const struct median_detector_cfg *cfg, int *positions,
                          size_t capacity);
 
+/**
+ * @brief Offline detekce nad celou nahrávkou (16bit) ve více vláknech.
+ *
+ * Nahrávka se rozdělí na úseky po celých tapech, každý zpracuje jedno vlákno
+ * s vlastním stavem. Úseky se překrývají o jedno okno bez posledního tapu
+ * (@c (num_taps - 1) * tap_size vzorků), aby mělo každé vlákno při svém
+ * prvním tapu plné okno; výsledek je proto shodný s detect_recording_i16().
+ * Krátké nahrávky (méně než několik oken na vlákno) se zpracují sériově.
+ *
+ * @param samples     vstupní pole vzorků
+ * @param n           počet vzorků
+ * @param cfg         konfigurace
+ * @param num_threads počet vláken, 0 = počet online CPU
+ * @param positions   výstupní pole pro nalezené pozice (absolutní indexy)
+ * @param capacity    kapacita pole positions
+ * @return počet detekovaných pozic (>=0) nebo chybový kód (<0)
+ */
+int detect_recording_parallel_i16(const int16_t *samples, size_t n,
+                                  const struct median_detector_cfg *cfg,
+                                  unsigned num_threads, int *positions,
+                                  size_t capacity);
+
+/**
+ * @brief Uspořádání vzorků více kanálů v jednom bufferu.
+ */
+enum peak_channel_layout {
+  PEAK_LAYOUT_INTERLEAVED = 0, /**< Snímky za sebou: ch0, ch1, ..., ch0, ... */
+  PEAK_LAYOUT_PLANAR = 1       /**< Kanály za sebou, každý @c frames vzorků. */
+};
+
+/**
+ * @brief Offline detekce nad více kanály jedním voláním.
+ *
+ * Každý kanál má vlastní konfiguraci a vlastní stav; všechny stavy leží v
+ * jedné souvislé aréně rozvržené přes detector_state_size() a
+ * detector_init(). Kanály se zpracovávají střídavě po krátkých úsecích
+ * času, takže se čtou sousední části vstupu. Výsledky odpovídají
+ * detect_recording_i16() nad každým kanálem zvlášť.
+ *
+ * @param samples     vstupní vzorky všech kanálů
+ * @param frames      počet vzorků na kanál
+ * @param channels    počet kanálů (>=1)
+ * @param layout      enum peak_channel_layout
+ * @param cfgs        pole @p channels konfigurací
+ * @param positions   výstup: pozice kanálu @c ch začínají na
+ *                    @c positions[ch * capacity], může být NULL
+ * @param capacity    kapacita výstupu na kanál
+ * @param hit_counts  výstup: počet zásahů každého kanálu (i nad kapacitu),
+ *                    může být NULL
+ * @return celkový počet zásahů (>=0) nebo chybový kód (<0)
+ */
+int detect_recording_multi_i16(const int16_t *samples, size_t frames,
+                               size_t channels, int layout,
+                               const struct median_detector_cfg *cfgs,
+                               int *positions, size_t capacity,
+                               int *hit_counts);
+
 #ifdef PEAK_DETECTOR_TESTING
 /// Test-only helper pro injektování do medianu.
 void peak_test_median_update(struct detector_state *s, uint16_t offset,
@@ -141,6 +210,10 @@ void peak_test_median_update(struct detector_state *s, uint16_t offset,
 int16_t peak_test_median_value(struct detector_state *s, uint16_t offset);
 /// Test-only helper pro přečtení RMS akumulátoru.
 uint64_t peak_test_rms_acc(const struct detector_state *s);
+/// Test-only helper pro posun generace (test přetečení).
+void peak_test_set_generation(struct detector_state *s, uint32_t gen);
+/// Test-only helper pro medián úseku (before/after kritérium).
+int16_t peak_test_median_of_slice(const int16_t *arr, size_t len);
 #endif
 
 #endif // PEAK_DETECTOR_H
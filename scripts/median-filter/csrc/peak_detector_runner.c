@@ -1,8 +1,65 @@
 #include "peak_detector.h"
+#include "impulse_coalesce.h"
 
+#include <pthread.h>
+#include <stdalign.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <unistd.h>
+
+// Segment shorter than this many windows is not worth a thread of its own:
+// every segment re-reads num_taps - 1 taps of warm-up.
+#define PARALLEL_MIN_WINDOWS 8
+
+// Snímků, které multi-kanálový běh zpracuje v jednom kanálu, než přejde na
+// další; malé, aby se u prokládaného vstupu četla stále stejná část paměti.
+#define MULTI_STEP_FRAMES 256
+
+/**
+ * @brief Výstup jednoho běhu: zásahy se slučují podle refrakterního okna.
+ *
+ * Běhy nad celou nahrávkou znají zásahy vzestupně, uzavírají proto skupinu
+ * až s dalším zásahem a na konci běhu; skupiny vyjdou stejně jako ve
+ * firmwaru, který je uzavírá průběžně.
+ */
+struct hit_sink {
+  impulse_coalescer groups;
+  int *positions;
+  size_t capacity;
+  size_t hits; // i nad kapacitu
+};
+
+static void sink_init(struct hit_sink *sink, uint32_t refractory,
+                      int *positions, size_t capacity) {
+  impulse_coalesce_init(&sink->groups, refractory);
+  sink->positions = positions;
+  sink->capacity = capacity;
+  sink->hits = 0;
+}
+
+static void sink_emit(struct hit_sink *sink, uint64_t horizon) {
+  impulse_coalesced_hit done;
+  if (!impulse_coalesce_flush(&sink->groups, horizon, &done)) {
+    return;
+  }
+  if (sink->positions != NULL && sink->hits < sink->capacity) {
+    sink->positions[sink->hits] = (int)done.peak_index;
+  }
+  ++sink->hits;
+}
+
+// Výška piku jako klíč impulse_coalesce.h; pořadí zůstává zachováno.
+static void sink_add(struct hit_sink *sink, int pos, int16_t level) {
+  sink_emit(sink, (uint64_t)pos);
+  impulse_coalesce_add(&sink->groups, (uint64_t)pos,
+                       (uint32_t)((int32_t)level - INT16_MIN));
+}
+
+static size_t sink_finish(struct hit_sink *sink) {
+  sink_emit(sink, UINT64_MAX);
+  return sink->hits;
+}
 
 int detect_recording_i16(const int16_t *samples, size_t n,
                          const struct median_detector_cfg *cfg, int *positions,
@@ -26,7 +83,8 @@ int detect_recording_i16(const int16_t *samples, size_t n,
     return st;
   }
 
-  size_t hits = 0;
+  struct hit_sink sink;
+  sink_init(&sink, cfg->refractory, positions, capacity);
   int64_t offset = 0;
   for (size_t i = 0; i + cfg->tap_size <= n; i += cfg->tap_size) {
     struct detector_result res;
@@ -36,16 +94,290 @@ int detect_recording_i16(const int16_t *samples, size_t n,
       free(buf);
       return st;
     }
-    if (res.hit && positions != NULL && hits < capacity) {
-      positions[hits] = res.peak_index;
-    }
     if (res.hit) {
-      ++hits;
+      sink_add(&sink, (int)res.peak_index, res.level);
     }
     offset += cfg->tap_size;
   }
 
   detector_deinit(state);
   free(buf);
-  return (int)hits;
+  return (int)sink_finish(&sink);
+}
+
+/**
+ * @brief Úsek nahrávky zpracovaný jedním vláknem.
+ *
+ * Vlákno vlastní tapy [first_tap, end_tap); před nimi přečte ještě
+ * num_taps - 1 tapů, aby mělo při prvním vlastním tapu plné okno. Okno se
+ * vyhodnocuje až po jeho naplnění, takže zásahy z náběhu nevznikají a každý
+ * zásah vyjde stejně jako v sériovém běhu.
+ */
+struct segment {
+  const int16_t *samples;
+  const struct median_detector_cfg *cfg;
+  size_t first_tap;
+  size_t end_tap;
+  uint8_t *mem;     // stav detektoru, alokuje volající
+  size_t mem_size;
+  int *hits;        // nalezené pozice, vzestupně
+  int16_t *levels;  // jejich výšky
+  size_t hit_count;
+  size_t hit_cap;
+  int status;
+};
+
+static int segment_push(struct segment *seg, int pos, int16_t level) {
+  if (seg->hit_count == seg->hit_cap) {
+    size_t cap = seg->hit_cap ? seg->hit_cap * 2 : 64;
+    int *grown = (int *)realloc(seg->hits, cap * sizeof(int));
+    if (grown == NULL) {
+      return PEAK_DET_ERR_BUFFER_TOO_SMALL;
+    }
+    seg->hits = grown;
+    int16_t *grown_levels =
+        (int16_t *)realloc(seg->levels, cap * sizeof(int16_t));
+    if (grown_levels == NULL) {
+      return PEAK_DET_ERR_BUFFER_TOO_SMALL;
+    }
+    seg->levels = grown_levels;
+    seg->hit_cap = cap;
+  }
+  seg->levels[seg->hit_count] = level;
+  seg->hits[seg->hit_count++] = pos;
+  return PEAK_DET_OK;
+}
+
+static void *segment_run(void *arg) {
+  struct segment *seg = (struct segment *)arg;
+  const uint16_t tap_size = seg->cfg->tap_size;
+  const size_t warmup = (size_t)seg->cfg->num_taps - 1;
+  const size_t start = seg->first_tap > warmup ? seg->first_tap - warmup : 0;
+
+  struct detector_state *state = NULL;
+  seg->status = detector_init(seg->mem, seg->mem_size, seg->cfg, &state);
+  if (seg->status != PEAK_DET_OK) {
+    return NULL;
+  }
+  for (size_t t = start; t < seg->end_tap; ++t) {
+    struct detector_result res;
+    const size_t i = t * tap_size;
+    seg->status =
+        detector_feed_block(state, seg->samples + i, (int64_t)i, &res);
+    if (seg->status != PEAK_DET_OK) {
+      break;
+    }
+    if (res.hit && t >= seg->first_tap) {
+      seg->status = segment_push(seg, (int)res.peak_index, res.level);
+      if (seg->status != PEAK_DET_OK) {
+        break;
+      }
+    }
+  }
+  detector_deinit(state);
+  return NULL;
+}
+
+static unsigned online_cpus(void) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (unsigned)n : 1u;
+}
+
+int detect_recording_parallel_i16(const int16_t *samples, size_t n,
+                                  const struct median_detector_cfg *cfg,
+                                  unsigned num_threads, int *positions,
+                                  size_t capacity) {
+  if (samples == NULL || cfg == NULL) {
+    return PEAK_DET_ERR_INVALID_ARG;
+  }
+  size_t needed = 0;
+  enum peak_det_state st = detector_state_size(cfg, &needed);
+  if (st != PEAK_DET_OK) {
+    return st;
+  }
+
+  const size_t taps = n / cfg->tap_size;
+  size_t threads = num_threads ? num_threads : online_cpus();
+  const size_t min_taps = (size_t)cfg->num_taps * PARALLEL_MIN_WINDOWS;
+  if (threads > taps / min_taps) {
+    threads = taps / min_taps;
+  }
+  if (threads <= 1) {
+    return detect_recording_i16(samples, n, cfg, positions, capacity);
+  }
+
+  struct segment *segs =
+      (struct segment *)calloc(threads, sizeof(struct segment));
+  pthread_t *tids = (pthread_t *)calloc(threads, sizeof(pthread_t));
+  bool *started = (bool *)calloc(threads, sizeof(bool));
+  uint8_t *mem = (uint8_t *)malloc(threads * needed);
+  if (segs == NULL || tids == NULL || started == NULL || mem == NULL) {
+    free(segs);
+    free(tids);
+    free(started);
+    free(mem);
+    return PEAK_DET_ERR_BUFFER_TOO_SMALL;
+  }
+
+  for (size_t k = 0; k < threads; ++k) {
+    struct segment *seg = &segs[k];
+    seg->samples = samples;
+    seg->cfg = cfg;
+    seg->first_tap = taps * k / threads;
+    seg->end_tap = taps * (k + 1) / threads;
+    seg->mem = mem + k * needed;
+    seg->mem_size = needed;
+  }
+  // Segment 0 běží ve volajícím vlákně; když vlákno nejde vytvořit, úsek se
+  // zpracuje tamtéž.
+  for (size_t k = 1; k < threads; ++k) {
+    started[k] = pthread_create(&tids[k], NULL, segment_run, &segs[k]) == 0;
+  }
+  segment_run(&segs[0]);
+  for (size_t k = 1; k < threads; ++k) {
+    if (started[k]) {
+      pthread_join(tids[k], NULL);
+    } else {
+      segment_run(&segs[k]);
+    }
+  }
+
+  // Úseky jsou seřazené a jejich tapy se nepřekrývají, sloučení je tedy
+  // spojení seznamů. Pozice rostou s každým tapem, takže na hranici úseků
+  // se zahodí vše, co nenavazuje vzestupně. Refrakterní okno se uplatní až
+  // na spojený seznam, skupina tak může přesahovat hranici úseků.
+  int result = 0;
+  struct hit_sink sink;
+  sink_init(&sink, cfg->refractory, positions, capacity);
+  bool any = false;
+  int last = -1;
+  for (size_t k = 0; k < threads; ++k) {
+    if (segs[k].status != PEAK_DET_OK && result == 0) {
+      result = segs[k].status;
+    }
+    for (size_t h = 0; h < segs[k].hit_count; ++h) {
+      const int pos = segs[k].hits[h];
+      if (any && pos <= last) {
+        continue;
+      }
+      sink_add(&sink, pos, segs[k].levels[h]);
+      any = true;
+      last = pos;
+    }
+    free(segs[k].hits);
+    free(segs[k].levels);
+  }
+  const size_t hits = sink_finish(&sink);
+
+  free(segs);
+  free(tids);
+  free(started);
+  free(mem);
+  return result != 0 ? result : (int)hits;
+}
+
+struct channel_run {
+  struct detector_state *state;
+  uint16_t tap_size;
+  size_t next_frame; // první snímek dalšího tapu
+  struct hit_sink sink;
+};
+
+static size_t arena_align(size_t v) {
+  const size_t a = alignof(max_align_t);
+  return (v + a - 1u) & ~(a - 1u);
+}
+
+int detect_recording_multi_i16(const int16_t *samples, size_t frames,
+                               size_t channels, int layout,
+                               const struct median_detector_cfg *cfgs,
+                               int *positions, size_t capacity,
+                               int *hit_counts) {
+  if (samples == NULL || cfgs == NULL || channels == 0 ||
+      (layout != PEAK_LAYOUT_INTERLEAVED && layout != PEAK_LAYOUT_PLANAR)) {
+    return PEAK_DET_ERR_INVALID_ARG;
+  }
+
+  // Aréna: stavy kanálů za sebou, za nimi jeden tap pro rozbalení
+  // prokládaného vstupu.
+  size_t arena = arena_align(channels * sizeof(struct channel_run));
+  uint16_t max_tap = 0;
+  for (size_t ch = 0; ch < channels; ++ch) {
+    size_t needed = 0;
+    enum peak_det_state st = detector_state_size(&cfgs[ch], &needed);
+    if (st != PEAK_DET_OK) {
+      return st;
+    }
+    arena += arena_align(needed);
+    if (cfgs[ch].tap_size > max_tap) {
+      max_tap = cfgs[ch].tap_size;
+    }
+  }
+  arena += (size_t)max_tap * sizeof(int16_t);
+
+  uint8_t *mem = (uint8_t *)malloc(arena);
+  if (mem == NULL) {
+    return PEAK_DET_ERR_BUFFER_TOO_SMALL;
+  }
+  struct channel_run *runs = (struct channel_run *)mem;
+  size_t offset = arena_align(channels * sizeof(struct channel_run));
+  for (size_t ch = 0; ch < channels; ++ch) {
+    size_t needed = 0;
+    (void)detector_state_size(&cfgs[ch], &needed);
+    enum peak_det_state st =
+        detector_init(mem + offset, needed, &cfgs[ch], &runs[ch].state);
+    if (st != PEAK_DET_OK) {
+      free(mem);
+      return st;
+    }
+    runs[ch].tap_size = cfgs[ch].tap_size;
+    runs[ch].next_frame = 0;
+    sink_init(&runs[ch].sink, cfgs[ch].refractory,
+              positions != NULL ? positions + ch * capacity : NULL, capacity);
+    offset += arena_align(needed);
+  }
+  int16_t *unpacked = (int16_t *)(mem + offset);
+
+  int status = PEAK_DET_OK;
+  for (size_t horizon = 0; horizon < frames && status == PEAK_DET_OK;) {
+    horizon = frames - horizon > MULTI_STEP_FRAMES ? horizon + MULTI_STEP_FRAMES
+                                                   : frames;
+    for (size_t ch = 0; ch < channels && status == PEAK_DET_OK; ++ch) {
+      struct channel_run *run = &runs[ch];
+      while (run->next_frame + run->tap_size <= horizon) {
+        const int16_t *block;
+        if (layout == PEAK_LAYOUT_PLANAR) {
+          block = samples + ch * frames + run->next_frame;
+        } else {
+          const int16_t *src = samples + run->next_frame * channels + ch;
+          for (uint16_t i = 0; i < run->tap_size; ++i) {
+            unpacked[i] = src[(size_t)i * channels];
+          }
+          block = unpacked;
+        }
+        struct detector_result res;
+        status = detector_feed_block(run->state, block,
+                                     (int64_t)run->next_frame, &res);
+        if (status != PEAK_DET_OK) {
+          break;
+        }
+        if (res.hit) {
+          sink_add(&run->sink, (int)res.peak_index, res.level);
+        }
+        run->next_frame += run->tap_size;
+      }
+    }
+  }
+
+  size_t total = 0;
+  for (size_t ch = 0; ch < channels; ++ch) {
+    const size_t hits = sink_finish(&runs[ch].sink);
+    if (hit_counts != NULL) {
+      hit_counts[ch] = (int)hits;
+    }
+    total += hits;
+    detector_deinit(runs[ch].state);
+  }
+  free(mem);
+  return status != PEAK_DET_OK ? status : (int)total;
 }
@@ -0,0 +1,253 @@
+#include "peak_stream.h"
+#include "impulse_coalesce.h"
+
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// "PSTM", po inicializaci; odhalí neinicializovaný nebo cizí buffer.
+#define PEAK_STREAM_MAGIC 0x5053544du
+
+_Static_assert(sizeof(struct peak_stream_hit) == 16,
+               "struct peak_stream_hit is part of the ABI");
+
+struct stream_channel {
+  struct detector_state *state;
+  impulse_coalescer groups;
+};
+
+/**
+ * @brief Stav proudu; za ním kanály, tapy a stavy detektorů v jednom bloku.
+ */
+struct peak_stream {
+  uint32_t magic;
+  uint16_t channels;
+  uint16_t num_taps;
+  uint16_t tap_size;
+  uint16_t filled;        // snímky rozpracovaného tapu
+  int64_t offset;         // index snímku začátku rozpracovaného tapu
+  struct stream_channel *chans;
+  int16_t *taps;          // channels * tap_size, kanály za sebou
+};
+
+static size_t arena_align(size_t v) {
+  const size_t a = alignof(max_align_t);
+  return (v + a - 1u) & ~(a - 1u);
+}
+
+// Rozložení: hlavička, kanály, tapy, stavy detektorů (každý zarovnaný).
+static enum peak_det_state stream_layout(const struct median_detector_cfg *cfgs,
+                                         size_t channels, size_t *states_at,
+                                         size_t *total) {
+  if (cfgs == NULL || channels == 0 || channels > PEAK_STREAM_MAX_CHANNELS) {
+    return PEAK_DET_ERR_INVALID_ARG;
+  }
+  size_t size = arena_align(sizeof(struct peak_stream));
+  size += arena_align(channels * sizeof(struct stream_channel));
+  size += arena_align(channels * (size_t)cfgs[0].tap_size * sizeof(int16_t));
+  *states_at = size;
+  for (size_t ch = 0; ch < channels; ++ch) {
+    if (cfgs[ch].tap_size != cfgs[0].tap_size) {
+      return PEAK_DET_ERR_INVALID_ARG;
+    }
+    size_t needed = 0;
+    enum peak_det_state st = detector_state_size(&cfgs[ch], &needed);
+    if (st != PEAK_DET_OK) {
+      return st;
+    }
+    size += arena_align(needed);
+  }
+  *total = size;
+  return PEAK_DET_OK;
+}
+
+uint32_t peak_stream_abi_version(void) { return PEAK_STREAM_ABI_VERSION; }
+
+enum peak_det_state peak_stream_size(const struct median_detector_cfg *cfgs,
+                                     size_t channels, size_t *out_size) {
+  if (out_size == NULL) {
+    return PEAK_DET_ERR_CFG_UNINITIALIZED;
+  }
+  size_t states_at = 0;
+  return stream_layout(cfgs, channels, &states_at, out_size);
+}
+
+enum peak_det_state peak_stream_init(void *mem, size_t mem_size,
+                                     const struct median_detector_cfg *cfgs,
+                                     size_t channels,
+                                     struct peak_stream **out) {
+  if (mem == NULL || out == NULL) {
+    return PEAK_DET_ERR_CFG_UNINITIALIZED;
+  }
+  if (((uintptr_t)mem & (alignof(max_align_t) - 1u)) != 0) {
+    return PEAK_DET_ERR_INVALID_ARG;
+  }
+  size_t states_at = 0;
+  size_t total = 0;
+  enum peak_det_state st = stream_layout(cfgs, channels, &states_at, &total);
+  if (st != PEAK_DET_OK) {
+    return st;
+  }
+  if (mem_size < total) {
+    return PEAK_DET_ERR_BUFFER_TOO_SMALL;
+  }
+
+  uint8_t *base = (uint8_t *)mem;
+  struct peak_stream *s = (struct peak_stream *)mem;
+  memset(s, 0, sizeof(*s));
+  size_t offset = arena_align(sizeof(*s));
+  s->chans = (struct stream_channel *)(base + offset);
+  offset += arena_align(channels * sizeof(struct stream_channel));
+  s->taps = (int16_t *)(void *)(base + offset);
+  s->channels = (uint16_t)channels;
+  s->num_taps = cfgs[0].num_taps;
+  s->tap_size = cfgs[0].tap_size;
+
+  offset = states_at;
+  for (size_t ch = 0; ch < channels; ++ch) {
+    size_t needed = 0;
+    (void)detector_state_size(&cfgs[ch], &needed);
+    st = detector_init(base + offset, needed, &cfgs[ch], &s->chans[ch].state);
+    if (st != PEAK_DET_OK) {
+      return st;
+    }
+    impulse_coalesce_init(&s->chans[ch].groups, cfgs[ch].refractory);
+    offset += arena_align(needed);
+  }
+  s->magic = PEAK_STREAM_MAGIC;
+  *out = s;
+  return PEAK_DET_OK;
+}
+
+static bool stream_valid(const struct peak_stream *s) {
+  return s != NULL && s->magic == PEAK_STREAM_MAGIC;
+}
+
+// Zapíše skupinu kanálu @p ch uzavřenou na pozici @p horizon.
+static void stream_emit(struct peak_stream *s, uint16_t ch, uint64_t horizon,
+                        struct peak_stream_hit *hits, size_t *written) {
+  impulse_coalesced_hit done;
+  if (!impulse_coalesce_flush(&s->chans[ch].groups, horizon, &done)) {
+    return;
+  }
+  hits[*written] = (struct peak_stream_hit){
+      .position = (int64_t)done.peak_index,
+      .channel = ch,
+      .level = (int16_t)((int64_t)done.level + INT16_MIN),
+      .merged = done.hits,
+  };
+  ++*written;
+}
+
+// Jeden tap všech kanálů; `mono` je u jednoho kanálu tap přímo ze vstupu.
+static int stream_feed_taps(struct peak_stream *s, const int16_t *mono,
+                            struct peak_stream_hit *hits, size_t *written) {
+  for (uint16_t ch = 0; ch < s->channels; ++ch) {
+    const int16_t *block =
+        mono != NULL ? mono : s->taps + (size_t)ch * s->tap_size;
+    struct detector_result res;
+    int st = detector_feed_block(s->chans[ch].state, block, s->offset, &res);
+    if (st != PEAK_DET_OK) {
+      return st;
+    }
+    if (res.hit) {
+      stream_emit(s, ch, (uint64_t)res.peak_index, hits, written);
+      impulse_coalesce_add(&s->chans[ch].groups, (uint64_t)res.peak_index,
+                           (uint32_t)((int32_t)res.level - INT16_MIN));
+    }
+    // Dál už se ke skupině nepřidá nic, co by ji mohlo udržet otevřenou.
+    stream_emit(s, ch,
+                impulse_coalesce_horizon((uint64_t)s->offset, s->num_taps,
+                                         s->tap_size),
+                hits, written);
+  }
+  s->offset += s->tap_size;
+  return PEAK_DET_OK;
+}
+
+int peak_stream_feed_i16(struct peak_stream *s, const int16_t *samples,
+                         size_t frames, struct peak_stream_hit *hits,
+                         size_t capacity, size_t *consumed) {
+  if (consumed != NULL) {
+    *consumed = 0;
+  }
+  if (!stream_valid(s) || hits == NULL ||
+      capacity < PEAK_STREAM_MIN_HITS(s->channels) ||
+      (samples == NULL && frames > 0)) {
+    return PEAK_DET_ERR_INVALID_ARG;
+  }
+  const size_t channels = s->channels;
+  const size_t tap_size = s->tap_size;
+  const size_t reserve = PEAK_STREAM_MIN_HITS(channels);
+  size_t written = 0;
+  size_t done = 0;
+  while (done < frames) {
+    const size_t want = tap_size - s->filled;
+    const size_t left = frames - done;
+    if (left >= want && capacity - written < reserve) {
+      break; // tap by se dokončil, ale zásahy by se nevešly
+    }
+    const int16_t *src = samples + done * channels;
+    if (channels == 1 && s->filled == 0 && left >= tap_size) {
+      // Mono se předá bez kopie.
+      int st = stream_feed_taps(s, src, hits, &written);
+      if (st != PEAK_DET_OK) {
+        return st;
+      }
+      done += tap_size;
+      continue;
+    }
+    const size_t n = left < want ? left : want;
+    for (size_t ch = 0; ch < channels; ++ch) {
+      int16_t *dst = s->taps + ch * tap_size + s->filled;
+      for (size_t i = 0; i < n; ++i) {
+        dst[i] = src[i * channels + ch];
+      }
+    }
+    s->filled = (uint16_t)(s->filled + n);
+    done += n;
+    if (s->filled == tap_size) {
+      s->filled = 0;
+      int st = stream_feed_taps(s, NULL, hits, &written);
+      if (st != PEAK_DET_OK) {
+        return st;
+      }
+    }
+  }
+  if (consumed != NULL) {
+    *consumed = done;
+  }
+  return (int)written;
+}
+
+int peak_stream_finish(struct peak_stream *s, struct peak_stream_hit *hits,
+                       size_t capacity) {
+  if (!stream_valid(s) || hits == NULL || capacity < s->channels) {
+    return PEAK_DET_ERR_INVALID_ARG;
+  }
+  size_t written = 0;
+  for (uint16_t ch = 0; ch < s->channels; ++ch) {
+    stream_emit(s, ch, UINT64_MAX, hits, &written);
+  }
+  peak_stream_reset(s);
+  return (int)written;
+}
+
+void peak_stream_reset(struct peak_stream *s) {
+  if (!stream_valid(s)) {
+    return;
+  }
+  for (uint16_t ch = 0; ch < s->channels; ++ch) {
+    detector_reset(s->chans[ch].state);
+    impulse_coalesce_init(&s->chans[ch].groups,
+                          s->chans[ch].groups.refractory);
+  }
+  s->filled = 0;
+  s->offset = 0;
+}
+
+int64_t peak_stream_frames(const struct peak_stream *s) {
+  return stream_valid(s) ? s->offset + s->filled : 0;
+}
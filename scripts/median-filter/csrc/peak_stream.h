@@ -0,0 +1,130 @@
+#ifndef PEAK_STREAM_H
+#define PEAK_STREAM_H
+
+/**
+ * @file peak_stream.h
+ * @brief Proudová detekce nad libovolně dlouhými bloky prokládaných vzorků.
+ *
+ * Pro volající mimo C (ctypes, FFI), kteří dostávají audio po blocích
+ * náhodné délky, např. z živého `stream.wav` uzlu. Jedno volání
+ * peak_stream_feed_i16() zpracuje celý blok všech kanálů: rozdělí ho na tapy,
+ * u každého kanálu zavolá detector_feed_block(), sloučí zásahy podle
+ * refrakterního okna (impulse_coalesce.h) a zapíše hotové zásahy do pole
+ * volajícího. Režie volání tak připadá na blok, ne na tap.
+ *
+ * Rozhraní je navržené jako stabilní ABI: stav je neprůhledný a leží v
+ * paměti volajícího (velikost z peak_stream_size()), výstup má pevné
+ * rozložení a verzi vrací peak_stream_abi_version(). Skupiny se uzavírají
+ * průběžně jako ve firmwaru, zásahy ale vyjdou stejné jako z offline běhů
+ * nad celou nahrávkou (detect_recording_multi_i16()), nezávisle na délkách
+ * bloků.
+ */
+
+#include "peak_detector.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Verze rozhraní; zvyšuje se s každou nekompatibilní změnou. */
+#define PEAK_STREAM_ABI_VERSION 1u
+
+/** Nejvíce kanálů jednoho proudu. */
+#define PEAK_STREAM_MAX_CHANNELS 8u
+
+/**
+ * @brief Nejméně míst ve výstupním poli, aby volání pokročilo.
+ *
+ * Za jeden tap může každý kanál uzavřít nejvýše dvě skupiny: tu, ke které se
+ * nový zásah nepřidá, a s malým refrakterním oknem i skupinu nového zásahu.
+ */
+#define PEAK_STREAM_MIN_HITS(channels) (2u * (size_t)(channels))
+
+/**
+ * @brief Jeden sloučený zásah (16 bajtů, bez výplně).
+ */
+struct peak_stream_hit {
+  int64_t position; /**< Absolutní index snímku piku od začátku proudu. */
+  uint16_t channel; /**< Kanál, 0 = první ve snímku. */
+  int16_t level;    /**< Výška nejsilnějšího piku skupiny nad mediánem. */
+  uint32_t merged;  /**< Počet sloučených zásahů, >= 1. */
+};
+
+// Forward declaration for opaque state
+struct peak_stream;
+
+/**
+ * @brief Vrátí verzi ABI knihovny, viz PEAK_STREAM_ABI_VERSION.
+ */
+uint32_t peak_stream_abi_version(void);
+
+/**
+ * @brief Vrátí velikost paměti pro stav proudu.
+ *
+ * @param cfgs      pole @p channels konfigurací, jedna na kanál; všechny
+ *                  kanály musí mít stejný @c tap_size
+ * @param channels  počet kanálů, 1..PEAK_STREAM_MAX_CHANNELS
+ * @param out_size  výstup: požadovaná velikost v bajtech
+ * @return PEAK_DET_OK nebo chybový kód.
+ */
+enum peak_det_state peak_stream_size(const struct median_detector_cfg *cfgs,
+                                     size_t channels, size_t *out_size);
+
+/**
+ * @brief Inicializuje stav proudu v paměti volajícího (bez malloc).
+ *
+ * @param mem       buffer zarovnaný na @c alignof(max_align_t)
+ * @param mem_size  velikost bufferu, nejméně podle peak_stream_size()
+ * @param cfgs      konfigurace kanálů, zkopírují se
+ * @param channels  počet kanálů
+ * @param out       výstup: stav uvnitř bufferu
+ * @return PEAK_DET_OK nebo chybový kód.
+ */
+enum peak_det_state peak_stream_init(void *mem, size_t mem_size,
+                                     const struct median_detector_cfg *cfgs,
+                                     size_t channels,
+                                     struct peak_stream **out);
+
+/**
+ * @brief Zpracuje blok prokládaných snímků.
+ *
+ * Neúplný tap na konci bloku se uchová a doplní dalším voláním. Když ve
+ * výstupu nezbývá PEAK_STREAM_MIN_HITS() míst pro další tap, volání skončí
+ * dřív; @p consumed pak říká, kolik snímků zbývá předat znovu. S kapacitou
+ * aspoň PEAK_STREAM_MIN_HITS() * (frames / tap_size + 1) se zpracuje vždy
+ * celý blok.
+ *
+ * @param s         stav
+ * @param samples   @p frames snímků po @c channels vzorcích
+ * @param frames    počet snímků, může být 0
+ * @param hits      výstup: uzavřené zásahy vzestupně po tapech
+ * @param capacity  kapacita @p hits, nejméně PEAK_STREAM_MIN_HITS()
+ * @param consumed  výstup: zpracované snímky, může být NULL
+ * @return počet zapsaných zásahů (>=0) nebo chybový kód (<0)
+ */
+int peak_stream_feed_i16(struct peak_stream *s, const int16_t *samples,
+                         size_t frames, struct peak_stream_hit *hits,
+                         size_t capacity, size_t *consumed);
+
+/**
+ * @brief Konec vstupu: uzavře ještě otevřené skupiny.
+ *
+ * Neúplný tap se zahodí. Proud pak pokračuje jako po peak_stream_reset().
+ *
+ * @param hits      výstup
+ * @param capacity  kapacita @p hits, nejméně počet kanálů
+ * @return počet zapsaných zásahů (>=0) nebo chybový kód (<0)
+ */
+int peak_stream_finish(struct peak_stream *s, struct peak_stream_hit *hits,
+                       size_t capacity);
+
+/**
+ * @brief Začne nový proud se stejnou konfigurací; pozice opět od 0.
+ */
+void peak_stream_reset(struct peak_stream *s);
+
+/**
+ * @brief Počet snímků přijatých od začátku proudu.
+ */
+int64_t peak_stream_frames(const struct peak_stream *s);
+
+#endif // PEAK_STREAM_H
@@ -0,0 +1,395 @@
+#define _POSIX_C_SOURCE 200809L // mmap, posix_madvise
+
+#include "peak_wav.h"
+#include "impulse_coalesce.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Velikost čtecího bloku pro roury a stdin.
+#define STREAM_BUF_BYTES (64u * 1024u)
+
+// Délka dat živého proudu, viz audio_wav_build_header().
+#define WAV_DATA_UNBOUNDED 0xffffffffu
+
+#define WAV_FORMAT_PCM 1u
+#define WAV_FORMAT_EXTENSIBLE 0xfffeu
+
+/**
+ * @brief Zdroj bajtů: namapovaný soubor, nebo deskriptor s bufferem.
+ */
+struct wav_src {
+  int fd;
+  const uint8_t *map; // != NULL: soubor je namapovaný
+  size_t map_len;
+  size_t pos;         // u mapy čtecí pozice
+  uint8_t *buf;       // u proudu buffer, buf[0..buf_len) nepřečteno
+  size_t buf_len;
+};
+
+static uint16_t le16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t le32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+// Doplní buffer proudu aspoň na `want` bajtů (nebo do konce vstupu).
+static int src_fill(struct wav_src *s, size_t want) {
+  while (s->buf_len < want) {
+    ssize_t got = read(s->fd, s->buf + s->buf_len, STREAM_BUF_BYTES - s->buf_len);
+    if (got < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return PEAK_DET_ERR_IO;
+    }
+    if (got == 0) {
+      break;
+    }
+    s->buf_len += (size_t)got;
+  }
+  return PEAK_DET_OK;
+}
+
+static void src_consume(struct wav_src *s, size_t n) {
+  memmove(s->buf, s->buf + n, s->buf_len - n);
+  s->buf_len -= n;
+}
+
+// Přečte přesně n bajtů hlavičky (n <= STREAM_BUF_BYTES).
+static int src_read(struct wav_src *s, uint8_t *dst, size_t n) {
+  if (s->map != NULL) {
+    if (s->map_len - s->pos < n) {
+      return PEAK_DET_ERR_FORMAT;
+    }
+    memcpy(dst, s->map + s->pos, n);
+    s->pos += n;
+    return PEAK_DET_OK;
+  }
+  int st = src_fill(s, n);
+  if (st != PEAK_DET_OK) {
+    return st;
+  }
+  if (s->buf_len < n) {
+    return PEAK_DET_ERR_FORMAT;
+  }
+  memcpy(dst, s->buf, n);
+  src_consume(s, n);
+  return PEAK_DET_OK;
+}
+
+static int src_skip(struct wav_src *s, uint64_t n) {
+  if (s->map != NULL) {
+    if (s->map_len - s->pos < n) {
+      return PEAK_DET_ERR_FORMAT;
+    }
+    s->pos += (size_t)n;
+    return PEAK_DET_OK;
+  }
+  while (n > 0) {
+    if (s->buf_len == 0) {
+      int st = src_fill(s, 1);
+      if (st != PEAK_DET_OK) {
+        return st;
+      }
+      if (s->buf_len == 0) {
+        return PEAK_DET_ERR_FORMAT;
+      }
+    }
+    size_t step = s->buf_len < n ? s->buf_len : (size_t)n;
+    src_consume(s, step);
+    n -= step;
+  }
+  return PEAK_DET_OK;
+}
+
+/**
+ * @brief Projde chunky až k "data"; vrátí formát a délku dat.
+ */
+static int parse_header(struct wav_src *s, uint16_t *channels,
+                        uint32_t *sample_rate, uint32_t *data_size) {
+  uint8_t hdr[16];
+  int st = src_read(s, hdr, 12);
+  if (st != PEAK_DET_OK) {
+    return st;
+  }
+  if (memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0) {
+    return PEAK_DET_ERR_FORMAT;
+  }
+  bool have_fmt = false;
+  for (;;) {
+    st = src_read(s, hdr, 8);
+    if (st != PEAK_DET_OK) {
+      return st;
+    }
+    const uint32_t size = le32(hdr + 4);
+    if (memcmp(hdr, "data", 4) == 0) {
+      if (!have_fmt) {
+        return PEAK_DET_ERR_FORMAT;
+      }
+      *data_size = size;
+      return PEAK_DET_OK;
+    }
+    if (memcmp(hdr, "fmt ", 4) == 0 && size >= 16) {
+      st = src_read(s, hdr, 16);
+      if (st != PEAK_DET_OK) {
+        return st;
+      }
+      const uint16_t format = le16(hdr);
+      if ((format != WAV_FORMAT_PCM && format != WAV_FORMAT_EXTENSIBLE) ||
+          le16(hdr + 14) != 16 || le16(hdr + 2) == 0) {
+        return PEAK_DET_ERR_FORMAT;
+      }
+      *channels = le16(hdr + 2);
+      *sample_rate = le32(hdr + 4);
+      have_fmt = true;
+      st = src_skip(s, (uint64_t)size - 16 + (size & 1u));
+    } else {
+      // Chunky jsou zarovnané na sudou délku.
+      st = src_skip(s, (uint64_t)size + (size & 1u));
+    }
+    if (st != PEAK_DET_OK) {
+      return st;
+    }
+  }
+}
+
+/**
+ * @brief Stav skládání tapů z kanálu prokládaných snímků.
+ */
+struct tap_feed {
+  struct detector_state *state;
+  const struct median_detector_cfg *cfg;
+  int16_t *tap;
+  uint16_t filled;
+  int64_t offset; // index snímku začátku tapu
+  int64_t *positions;
+  size_t capacity;
+  size_t hits;
+  impulse_coalescer groups; // refrakterní okno, viz impulse_coalesce.h
+  peak_wav_hit_fn on_hit;
+  void *ctx;
+};
+
+// Ohlásí skupinu zásahů uzavřenou na pozici `horizon`.
+static void feed_emit(struct tap_feed *f, uint64_t horizon) {
+  impulse_coalesced_hit done;
+  if (!impulse_coalesce_flush(&f->groups, horizon, &done)) {
+    return;
+  }
+  const int64_t pos = (int64_t)done.peak_index;
+  if (f->positions != NULL && f->hits < f->capacity) {
+    f->positions[f->hits] = pos;
+  }
+  ++f->hits;
+  if (f->on_hit != NULL) {
+    f->on_hit(pos, f->ctx);
+  }
+}
+
+static int feed_tap(struct tap_feed *f, const int16_t *block) {
+  struct detector_result res;
+  int st = detector_feed_block(f->state, block, f->offset, &res);
+  if (st != PEAK_DET_OK) {
+    return st;
+  }
+  if (res.hit) {
+    feed_emit(f, (uint64_t)res.peak_index);
+    impulse_coalesce_add(&f->groups, (uint64_t)res.peak_index,
+                         (uint32_t)((int32_t)res.level - INT16_MIN));
+  }
+  f->offset += f->cfg->tap_size;
+  return PEAK_DET_OK;
+}
+
+// Zpracuje `frames` celých snímků od `p`.
+static int feed_frames(struct tap_feed *f, const uint8_t *p, size_t frames,
+                       uint16_t channels, unsigned channel) {
+  const size_t frame_bytes = (size_t)channels * sizeof(int16_t);
+  const uint16_t tap_size = f->cfg->tap_size;
+  p += (size_t)channel * sizeof(int16_t);
+  while (frames > 0) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // Mono na zarovnané adrese se předá bez kopie.
+    if (channels == 1 && f->filled == 0 && frames >= tap_size &&
+        ((uintptr_t)p & (sizeof(int16_t) - 1u)) == 0) {
+      int st = feed_tap(f, (const int16_t *)(const void *)p);
+      if (st != PEAK_DET_OK) {
+        return st;
+      }
+      p += (size_t)tap_size * frame_bytes;
+      frames -= tap_size;
+      continue;
+    }
+#endif
+    f->tap[f->filled++] = (int16_t)le16(p);
+    p += frame_bytes;
+    --frames;
+    if (f->filled == tap_size) {
+      f->filled = 0;
+      int st = feed_tap(f, f->tap);
+      if (st != PEAK_DET_OK) {
+        return st;
+      }
+    }
+  }
+  return PEAK_DET_OK;
+}
+
+static int run_data(struct wav_src *s, struct tap_feed *f, uint16_t channels,
+                    unsigned channel, uint64_t data_bytes, uint64_t *frames) {
+  const size_t frame_bytes = (size_t)channels * sizeof(int16_t);
+  if (s->map != NULL) {
+    uint64_t avail = s->map_len - s->pos;
+    if (data_bytes > avail) {
+      data_bytes = avail; // useknutý soubor nebo živý záznam
+    }
+    const size_t n = (size_t)(data_bytes / frame_bytes);
+    *frames = n;
+    return feed_frames(f, s->map + s->pos, n, channels, channel);
+  }
+
+  *frames = 0;
+  while (data_bytes >= frame_bytes) {
+    int st = src_fill(s, STREAM_BUF_BYTES - STREAM_BUF_BYTES % frame_bytes);
+    if (st != PEAK_DET_OK) {
+      return st;
+    }
+    size_t usable = s->buf_len - s->buf_len % frame_bytes;
+    if (usable > data_bytes) {
+      usable = (size_t)(data_bytes - data_bytes % frame_bytes);
+    }
+    if (usable == 0) {
+      break; // konec vstupu
+    }
+    st = feed_frames(f, s->buf, usable / frame_bytes, channels, channel);
+    if (st != PEAK_DET_OK) {
+      return st;
+    }
+    *frames += usable / frame_bytes;
+    data_bytes -= usable;
+    src_consume(s, usable);
+  }
+  return PEAK_DET_OK;
+}
+
+// Hlavička, stav detektoru a data; `mem` drží stav a pak tap.
+static int run_wav(struct wav_src *src, unsigned channel,
+                   const struct median_detector_cfg *cfg, uint8_t *mem,
+                   size_t needed, int64_t *positions, size_t capacity,
+                   peak_wav_hit_fn on_hit, void *ctx,
+                   struct peak_wav_info *info) {
+  uint16_t channels = 0;
+  uint32_t rate = 0;
+  uint32_t data_size = 0;
+  int st = parse_header(src, &channels, &rate, &data_size);
+  if (st != PEAK_DET_OK) {
+    return st;
+  }
+  if (channel >= channels) {
+    return PEAK_DET_ERR_INVALID_ARG;
+  }
+
+  struct tap_feed feed = {
+      .cfg = cfg,
+      .tap = (int16_t *)(void *)(mem + needed),
+      .positions = positions,
+      .capacity = capacity,
+      .on_hit = on_hit,
+      .ctx = ctx,
+  };
+  impulse_coalesce_init(&feed.groups, cfg->refractory);
+  st = detector_init(mem, needed, cfg, &feed.state);
+  if (st != PEAK_DET_OK) {
+    return st;
+  }
+  uint64_t frames = 0;
+  const uint64_t data_bytes =
+      data_size == WAV_DATA_UNBOUNDED ? UINT64_MAX : data_size;
+  st = run_data(src, &feed, channels, channel, data_bytes, &frames);
+  feed_emit(&feed, UINT64_MAX);
+  detector_deinit(feed.state);
+  if (info != NULL) {
+    info->sample_rate = rate;
+    info->channels = channels;
+    info->frames = frames;
+  }
+  return st != PEAK_DET_OK ? st : (int)feed.hits;
+}
+
+int detect_wav_fd(int fd, unsigned channel,
+                  const struct median_detector_cfg *cfg, int64_t *positions,
+                  size_t capacity, peak_wav_hit_fn on_hit, void *ctx,
+                  struct peak_wav_info *info) {
+  if (fd < 0 || cfg == NULL) {
+    return PEAK_DET_ERR_INVALID_ARG;
+  }
+  size_t needed = 0;
+  int st = detector_state_size(cfg, &needed);
+  if (st != PEAK_DET_OK) {
+    return st;
+  }
+  needed = (needed + sizeof(int16_t) - 1u) & ~(sizeof(int16_t) - 1u);
+
+  // Běžný soubor od začátku se mapuje, jinak (roura, stdin, už čtený
+  // deskriptor) se čte po blocích.
+  struct wav_src src = {.fd = fd};
+  struct stat sb;
+  if (fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0 &&
+      lseek(fd, 0, SEEK_CUR) == 0) {
+    void *map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      (void)posix_madvise(map, (size_t)sb.st_size, POSIX_MADV_SEQUENTIAL);
+      src.map = (const uint8_t *)map;
+      src.map_len = (size_t)sb.st_size;
+    }
+  }
+
+  // Stav, tap a u proudu čtecí buffer v jednom bloku.
+  const size_t tap_bytes = (size_t)cfg->tap_size * sizeof(int16_t);
+  const size_t stream_bytes = src.map != NULL ? 0 : STREAM_BUF_BYTES;
+  uint8_t *mem = (uint8_t *)malloc(needed + tap_bytes + stream_bytes);
+  if (mem == NULL) {
+    st = PEAK_DET_ERR_BUFFER_TOO_SMALL;
+  } else {
+    src.buf = stream_bytes ? mem + needed + tap_bytes : NULL;
+    st = run_wav(&src, channel, cfg, mem, needed, positions, capacity, on_hit,
+                 ctx, info);
+  }
+
+  free(mem);
+  if (src.map != NULL) {
+    munmap((void *)src.map, src.map_len);
+  }
+  return st;
+}
+
+int detect_wav_path(const char *path, unsigned channel,
+                    const struct median_detector_cfg *cfg, int64_t *positions,
+                    size_t capacity, peak_wav_hit_fn on_hit, void *ctx,
+                    struct peak_wav_info *info) {
+  if (path == NULL) {
+    return PEAK_DET_ERR_INVALID_ARG;
+  }
+  if (strcmp(path, "-") == 0) {
+    return detect_wav_fd(STDIN_FILENO, channel, cfg, positions, capacity,
+                         on_hit, ctx, info);
+  }
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return PEAK_DET_ERR_IO;
+  }
+  int st = detect_wav_fd(fd, channel, cfg, positions, capacity, on_hit, ctx,
+                         info);
+  close(fd);
+  return st;
+}
@@ -0,0 +1,65 @@
+#ifndef PEAK_WAV_H
+#define PEAK_WAV_H
+
+/**
+ * @file peak_wav.h
+ * @brief Detekce přímo nad WAV souborem nebo proudem, bez načtení do paměti.
+ *
+ * Čte 16bit PCM WAV tak, jak ho zapisuje firmware (`audio_wav.c`): RIFF
+ * hlavička, "fmt ", volitelné další chunky (např. LIST se značkou času) a
+ * "data". Délka dat 0xffffffff (živý `stream.wav`) znamená "do konce vstupu".
+ *
+ * Běžný soubor se namapuje do paměti, roura nebo stdin se čte po blocích;
+ * v obou případech se vzorky předávají rovnou do detector_feed_block() a
+ * paměť nezávisí na délce nahrávky.
+ */
+
+#include "peak_detector.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Údaje o zpracovaném vstupu.
+ */
+struct peak_wav_info {
+  uint32_t sample_rate; /**< Vzorkovací frekvence z hlavičky. */
+  uint16_t channels;    /**< Počet kanálů v souboru. */
+  uint64_t frames;      /**< Počet přečtených snímků. */
+};
+
+/**
+ * @brief Volá se pro každý zásah hned, jak je nalezen (živý vstup).
+ *
+ * S nenulovým median_detector_cfg::refractory až po uzavření skupiny, tedy
+ * s dalším zásahem za refrakterním oknem nebo na konci vstupu.
+ */
+typedef void (*peak_wav_hit_fn)(int64_t position, void *ctx);
+
+/**
+ * @brief Detekce nad jedním kanálem WAV vstupu z deskriptoru.
+ *
+ * @param fd        otevřený deskriptor (soubor, roura, stdin)
+ * @param channel   zpracovávaný kanál
+ * @param cfg       konfigurace
+ * @param positions výstupní pole pozic (absolutní index snímku), může být NULL
+ * @param capacity  kapacita pole positions
+ * @param on_hit    volání pro každý zásah, může být NULL
+ * @param ctx       kontext pro @p on_hit
+ * @param info      výstup: údaje o vstupu, může být NULL
+ * @return počet detekovaných pozic (>=0) nebo chybový kód (<0)
+ */
+int detect_wav_fd(int fd, unsigned channel,
+                  const struct median_detector_cfg *cfg, int64_t *positions,
+                  size_t capacity, peak_wav_hit_fn on_hit, void *ctx,
+                  struct peak_wav_info *info);
+
+/**
+ * @brief Jako detect_wav_fd(), vstup podle cesty; "-" je stdin.
+ */
+int detect_wav_path(const char *path, unsigned channel,
+                    const struct median_detector_cfg *cfg, int64_t *positions,
+                    size_t capacity, peak_wav_hit_fn on_hit, void *ctx,
+                    struct peak_wav_info *info);
+
+#endif // PEAK_WAV_H
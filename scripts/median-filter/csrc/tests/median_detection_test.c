@@ -0,0 +1,511 @@
+#include "impulse_coalesce.h"
+#include "median_detection.h"
+#include "median_detection_runner.h"
+#include "unity.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Tichý šum (+-20) s krátkými výbuchy na zadaných pozicích: první vzorek
+// 3000 (určuje polohu piku), zbytek 1500. Výbuchy nesmí přesahovat hranici
+// tapu, jinak detektor legitimně vystřelí i na sestupné hraně.
+static void generate_bursts(int16_t *dst, size_t n, const size_t *starts,
+                            size_t num_starts, size_t burst_len) {
+  uint32_t seed = 12345u;
+  for (size_t i = 0; i < n; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    dst[i] = (int16_t)((int32_t)(seed >> 16) % 41 - 20);
+  }
+  for (size_t k = 0; k < num_starts; k++) {
+    for (size_t i = starts[k]; i < starts[k] + burst_len && i < n; i++) {
+      dst[i] = (i == starts[k]) ? 3000 : 1500;
+    }
+  }
+}
+
+static void test_init_rejects_bad_args(void) {
+  impulse_detector det;
+  impulse_detector_cfg cfg = IMPULSE_DETECTOR_CFG_DEFAULT();
+  size_t need = impulse_detector_storage_size(&cfg);
+  TEST_ASSERT_EQUAL(
+      (2u * TAP_COUNT * TAP_SIZE + TAP_COUNT + 1u) / 2u * sizeof(uint32_t),
+      need);
+
+  uint32_t *buf = (uint32_t *)malloc(need);
+  TEST_ASSERT_NOT_NULL(buf);
+
+  TEST_ASSERT_EQUAL(IMPULSE_DET_ERR_INVALID_ARG,
+                    impulse_detector_init(NULL, &cfg, buf, need));
+  TEST_ASSERT_EQUAL(IMPULSE_DET_ERR_INVALID_ARG,
+                    impulse_detector_init(&det, &cfg, NULL, need));
+  TEST_ASSERT_EQUAL(IMPULSE_DET_ERR_BUFFER_TOO_SMALL,
+                    impulse_detector_init(&det, &cfg, buf, need - 1));
+
+  impulse_detector_cfg bad = cfg;
+  bad.tap_count = 2;
+  TEST_ASSERT_EQUAL(IMPULSE_DET_ERR_INVALID_ARG,
+                    impulse_detector_init(&det, &bad, buf, need));
+  bad = cfg;
+  bad.tap_size = IMPULSE_MAX_TAP_SIZE + 1;
+  TEST_ASSERT_EQUAL(IMPULSE_DET_ERR_INVALID_ARG,
+                    impulse_detector_init(&det, &bad, buf, need));
+
+  TEST_ASSERT_EQUAL(IMPULSE_DET_OK,
+                    impulse_detector_init(&det, &cfg, buf, need));
+  TEST_ASSERT_TRUE(impulse_detector_is_specialised(&det));
+  free(buf);
+}
+
+static void test_default_geometry_detects_burst(void) {
+  impulse_detector_cfg cfg = IMPULSE_DETECTOR_CFG_DEFAULT();
+  const size_t n = 200 * TAP_SIZE;
+  const size_t starts[] = {2000, 4517};
+  int16_t *samples = (int16_t *)malloc(n * sizeof(int16_t));
+  TEST_ASSERT_NOT_NULL(samples);
+  generate_bursts(samples, n, starts, 2, 8);
+
+  int64_t positions[8];
+  int hits = detect_recording_median_i16(samples, n, &cfg, positions, 8);
+  TEST_ASSERT_EQUAL(2, hits);
+  TEST_ASSERT_EQUAL_INT64(2000, positions[0]);
+  TEST_ASSERT_EQUAL_INT64(4517, positions[1]);
+
+  free(samples);
+}
+
+static void test_generic_geometry_detects_burst(void) {
+  impulse_detector_cfg cfg = IMPULSE_DETECTOR_CFG_DEFAULT();
+  cfg.tap_count = 15;
+  cfg.tap_size = 16;
+  const size_t n = 300 * 16;
+  const size_t starts[] = {1203};
+  int16_t *samples = (int16_t *)malloc(n * sizeof(int16_t));
+  TEST_ASSERT_NOT_NULL(samples);
+  generate_bursts(samples, n, starts, 1, 8);
+
+  int64_t positions[4];
+  int hits = detect_recording_median_i16(samples, n, &cfg, positions, 4);
+  TEST_ASSERT_EQUAL(1, hits);
+  TEST_ASSERT_EQUAL_INT64(1203, positions[0]);
+
+  free(samples);
+}
+
+static void check_specialised_matches_generic(uint16_t tap_count,
+                                             uint16_t tap_size) {
+  impulse_detector_cfg cfg = IMPULSE_DETECTOR_CFG_DEFAULT();
+  cfg.tap_count = tap_count;
+  cfg.tap_size = tap_size;
+  // Nižší prahy, aby detekce padaly i na samotný šum.
+  cfg.det_level = 50;
+  cfg.det_rms = 0.5f;
+  size_t need = impulse_detector_storage_size(&cfg);
+  uint32_t *buf_fast = (uint32_t *)malloc(need);
+  uint32_t *buf_gen = (uint32_t *)malloc(need);
+  TEST_ASSERT_NOT_NULL(buf_fast);
+  TEST_ASSERT_NOT_NULL(buf_gen);
+
+  impulse_detector fast, gen;
+  TEST_ASSERT_EQUAL(IMPULSE_DET_OK,
+                    impulse_detector_init(&fast, &cfg, buf_fast, need));
+  TEST_ASSERT_EQUAL(IMPULSE_DET_OK,
+                    impulse_detector_init(&gen, &cfg, buf_gen, need));
+  TEST_ASSERT_TRUE(impulse_detector_is_specialised(&fast));
+  median_test_force_generic(&gen);
+
+  uint32_t seed = 99u;
+  int16_t tap[IMPULSE_MAX_TAP_SIZE];
+  int fast_hits = 0;
+  for (uint64_t t = 0; t < 2000; t++) {
+    for (int i = 0; i < tap_size; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      tap[i] = (int16_t)((int32_t)(seed >> 16) % 201 - 100);
+    }
+    impulse_add_tap(&fast, tap, t * tap_size);
+    impulse_add_tap(&gen, tap, t * tap_size);
+
+    impulse_result rf = {0}, rg = {0};
+    bool hf = impulse_run_detection(&fast, &rf);
+    bool hg = impulse_run_detection(&gen, &rg);
+    TEST_ASSERT_EQUAL(hf, hg);
+    if (hf) {
+      fast_hits++;
+      TEST_ASSERT_EQUAL_UINT64(rf.peak_index, rg.peak_index);
+      TEST_ASSERT_EQUAL_UINT32(rf.level, rg.level);
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32_ARRAY(buf_fast, buf_gen,
+                                 need / sizeof(uint32_t));
+  TEST_ASSERT_TRUE(fast_hits > 0);
+
+  free(buf_fast);
+  free(buf_gen);
+}
+
+static void test_fast_path_matches_generic(void) {
+  check_specialised_matches_generic(TAP_COUNT, TAP_SIZE);
+}
+
+static void test_22k_geometry_matches_generic(void) {
+  // 31x16 je v seznamu generovaných geometrií (MEDIAN_GEOMETRIES).
+  TEST_ASSERT_TRUE(impulse_geometry_is_specialised(31, 16));
+  check_specialised_matches_generic(31, 16);
+}
+
+static void test_tap_size_for_rate(void) {
+  TEST_ASSERT_EQUAL(30, impulse_tap_size_for_rate(44100, 44100, 30, 31));
+  // 15 vzorků přesně, přichytí se na specializovaných 16.
+  TEST_ASSERT_EQUAL(16, impulse_tap_size_for_rate(22050, 44100, 30, 31));
+  // 48 kHz: 33 vzorků, 30 je do 25 %.
+  TEST_ASSERT_EQUAL(30, impulse_tap_size_for_rate(48000, 44100, 30, 31));
+  // 16 kHz: 11 vzorků, žádná blízká specializace.
+  TEST_ASSERT_EQUAL(11, impulse_tap_size_for_rate(16000, 44100, 30, 31));
+  // Jiný počet tapů nemá specializaci, vrací se přesná hodnota.
+  TEST_ASSERT_EQUAL(15, impulse_tap_size_for_rate(22050, 44100, 30, 15));
+  TEST_ASSERT_EQUAL(30, impulse_tap_size_for_rate(0, 44100, 30, 31));
+}
+
+static void check_stereo_matches_mono(bool generic) {
+  impulse_detector_cfg cfg = IMPULSE_DETECTOR_CFG_DEFAULT();
+  cfg.det_level = 50;
+  cfg.det_rms = 0.5f;
+  size_t mono_need = impulse_detector_storage_size(&cfg);
+  size_t stereo_need = impulse_stereo_detector_storage_size(&cfg);
+  TEST_ASSERT_EQUAL(2 * mono_need, stereo_need);
+  uint32_t *buf_l = (uint32_t *)malloc(mono_need);
+  uint32_t *buf_r = (uint32_t *)malloc(mono_need);
+  uint32_t *buf_st = (uint32_t *)malloc(stereo_need);
+  TEST_ASSERT_NOT_NULL(buf_l);
+  TEST_ASSERT_NOT_NULL(buf_r);
+  TEST_ASSERT_NOT_NULL(buf_st);
+
+  impulse_detector det_l, det_r;
+  impulse_stereo_detector st;
+  TEST_ASSERT_EQUAL(IMPULSE_DET_OK,
+                    impulse_detector_init(&det_l, &cfg, buf_l, mono_need));
+  TEST_ASSERT_EQUAL(IMPULSE_DET_OK,
+                    impulse_detector_init(&det_r, &cfg, buf_r, mono_need));
+  TEST_ASSERT_EQUAL(IMPULSE_DET_ERR_BUFFER_TOO_SMALL,
+                    impulse_stereo_detector_init(&st, &cfg, buf_st,
+                                                 mono_need));
+  TEST_ASSERT_EQUAL(IMPULSE_DET_OK, impulse_stereo_detector_init(
+                                        &st, &cfg, buf_st, stereo_need));
+  TEST_ASSERT_TRUE(impulse_stereo_detector_is_specialised(&st));
+  if (generic) {
+    median_test_force_generic(&st.core);
+  }
+
+  // Kanály s různým šumem, aby se výsledky L a R lišily.
+  uint32_t seed_l = 5u, seed_r = 77u;
+  int16_t left[TAP_SIZE], right[TAP_SIZE];
+  int hits[4] = {0};
+  for (uint64_t t = 0; t < 2000; t++) {
+    for (int i = 0; i < TAP_SIZE; i++) {
+      seed_l = seed_l * 1664525u + 1013904223u;
+      seed_r = seed_r * 1664525u + 1013904223u;
+      left[i] = (int16_t)((int32_t)(seed_l >> 16) % 201 - 100);
+      right[i] = (int16_t)((int32_t)(seed_r >> 16) % 201 - 100);
+    }
+    impulse_add_tap(&det_l, left, t * TAP_SIZE);
+    impulse_add_tap(&det_r, right, t * TAP_SIZE);
+    impulse_stereo_add_tap(&st, left, right, t * TAP_SIZE);
+
+    impulse_result rl = {0}, rr = {0};
+    impulse_stereo_result rs = {0};
+    bool hl = impulse_run_detection(&det_l, &rl);
+    bool hr = impulse_run_detection(&det_r, &rr);
+    bool hs = impulse_stereo_run_detection(&st, &rs);
+    uint8_t expect = (hl ? IMPULSE_CH_LEFT : 0) | (hr ? IMPULSE_CH_RIGHT : 0);
+    hits[expect]++;
+    TEST_ASSERT_EQUAL(hl || hr, hs);
+    if (!hs) {
+      continue;
+    }
+    TEST_ASSERT_EQUAL_UINT8(expect, rs.fired);
+    if (hl) {
+      TEST_ASSERT_EQUAL_UINT64(rl.peak_index, rs.left.peak_index);
+      TEST_ASSERT_EQUAL_UINT32(rl.level, rs.left.level);
+    }
+    if (hr) {
+      TEST_ASSERT_EQUAL_UINT64(rr.peak_index, rs.right.peak_index);
+      TEST_ASSERT_EQUAL_UINT32(rr.level, rs.right.level);
+    }
+    if (hl && hr) {
+      TEST_ASSERT_TRUE(rs.offset_valid);
+      TEST_ASSERT_EQUAL_INT32(rr.window_offset - rl.window_offset,
+                              rs.lr_offset);
+    }
+  }
+  // Šum musí vyvolat jednokanálové i oboukanálové zásahy.
+  TEST_ASSERT_TRUE(hits[IMPULSE_CH_LEFT] > 0);
+  TEST_ASSERT_TRUE(hits[IMPULSE_CH_RIGHT] > 0);
+  TEST_ASSERT_TRUE(hits[IMPULSE_CH_LEFT | IMPULSE_CH_RIGHT] > 0);
+
+  free(buf_l);
+  free(buf_r);
+  free(buf_st);
+}
+
+static void test_stereo_matches_mono(void) { check_stereo_matches_mono(false); }
+
+static void test_stereo_generic_matches_mono(void) {
+  check_stereo_matches_mono(true);
+}
+
+static void test_stereo_reports_channel_offset(void) {
+  impulse_detector_cfg cfg = IMPULSE_DETECTOR_CFG_DEFAULT();
+  const size_t n = 200 * TAP_SIZE;
+  int16_t *left = (int16_t *)malloc(n * sizeof(int16_t));
+  int16_t *right = (int16_t *)malloc(n * sizeof(int16_t));
+  size_t need = impulse_stereo_detector_storage_size(&cfg);
+  uint32_t *buf = (uint32_t *)malloc(need);
+  TEST_ASSERT_NOT_NULL(left);
+  TEST_ASSERT_NOT_NULL(right);
+  TEST_ASSERT_NOT_NULL(buf);
+
+  // Oba kanály: pravý o 7 vzorků později. Pouze levý: 4517.
+  const size_t starts_l[] = {1983, 4517};
+  const size_t starts_r[] = {1990};
+  generate_bursts(left, n, starts_l, 2, 8);
+  generate_bursts(right, n, starts_r, 1, 8);
+
+  impulse_stereo_detector st;
+  TEST_ASSERT_EQUAL(IMPULSE_DET_OK,
+                    impulse_stereo_detector_init(&st, &cfg, buf, need));
+
+  int hits = 0;
+  for (size_t t = 0; t < n / TAP_SIZE; t++) {
+    impulse_stereo_add_tap(&st, &left[t * TAP_SIZE], &right[t * TAP_SIZE],
+                           t * TAP_SIZE);
+    impulse_stereo_result rs;
+    if (!impulse_stereo_run_detection(&st, &rs)) {
+      continue;
+    }
+    if (hits == 0) {
+      TEST_ASSERT_EQUAL_UINT8(IMPULSE_CH_LEFT | IMPULSE_CH_RIGHT, rs.fired);
+      TEST_ASSERT_EQUAL_UINT64(1983, rs.left.peak_index);
+      TEST_ASSERT_EQUAL_UINT64(1990, rs.right.peak_index);
+      TEST_ASSERT_TRUE(rs.offset_valid);
+      TEST_ASSERT_EQUAL_INT32(7, rs.lr_offset);
+    } else {
+      TEST_ASSERT_EQUAL_UINT8(IMPULSE_CH_LEFT, rs.fired);
+      TEST_ASSERT_EQUAL_UINT64(4517, rs.left.peak_index);
+    }
+    hits++;
+  }
+  TEST_ASSERT_EQUAL(2, hits);
+
+  free(left);
+  free(right);
+  free(buf);
+}
+
+static void test_reset_clears_window(void) {
+  impulse_detector_cfg cfg = IMPULSE_DETECTOR_CFG_DEFAULT();
+  cfg.tap_count = 3;
+  cfg.tap_size = 2;
+  cfg.det_level = 0;
+  cfg.det_rms = 0.0f;
+  cfg.det_energy = 0.0f;
+  uint32_t buf[IMPULSE_DETECTOR_STORAGE_WORDS(3, 2)];
+  impulse_detector det;
+  TEST_ASSERT_EQUAL(IMPULSE_DET_OK,
+                    impulse_detector_init(&det, &cfg, buf, sizeof(buf)));
+  TEST_ASSERT_FALSE(impulse_detector_is_specialised(&det));
+
+  const int16_t quiet[2] = {0, 0};
+  const int16_t loud[2] = {10, 10};
+  impulse_add_tap(&det, quiet, 0);
+  impulse_add_tap(&det, loud, 2);
+  impulse_add_tap(&det, quiet, 4);
+
+  impulse_result res;
+  TEST_ASSERT_TRUE(impulse_run_detection(&det, &res));
+  TEST_ASSERT_EQUAL_UINT64(2, res.peak_index);
+  TEST_ASSERT_EQUAL_INT32(2, res.window_offset);
+
+  impulse_detector_reset(&det);
+  TEST_ASSERT_EQUAL(0, det.count);
+  TEST_ASSERT_FALSE(impulse_run_detection(&det, &res));
+}
+
+// Průběžně vedená energie šumu musí po každém tapu odpovídat součtu
+// čtverců energií mediánů sloupců (čtvrtých mocnin velikostí) spočtenému
+// znovu.
+static void test_noise_energy_tracks_columns(void) {
+  impulse_detector_cfg cfg = IMPULSE_DETECTOR_CFG_DEFAULT();
+  const size_t need = impulse_stereo_detector_storage_size(&cfg);
+  uint32_t *buf = (uint32_t *)malloc(need);
+  TEST_ASSERT_NOT_NULL(buf);
+  impulse_stereo_detector det;
+  TEST_ASSERT_EQUAL(IMPULSE_DET_OK,
+                    impulse_stereo_detector_init(&det, &cfg, buf, need));
+
+  const uint16_t tc = cfg.tap_count;
+  int16_t left[TAP_SIZE], right[TAP_SIZE];
+  uint32_t seed = 777u;
+  for (int t = 0; t < 4 * tc; t++) {
+    for (int i = 0; i < TAP_SIZE; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      left[i] = (int16_t)((int32_t)(seed >> 16) % 201 - 100);
+      right[i] = (int16_t)((t % 7 == 0) ? 2000 : left[i] / 2);
+    }
+    impulse_stereo_add_tap(&det, left, right, (uint64_t)t * TAP_SIZE);
+    if (det.core.count < tc) {
+      continue;
+    }
+    for (uint8_t ch = 0; ch < 2; ch++) {
+      uint64_t sum = 0;
+      for (int i = 0; i < TAP_SIZE; i++) {
+        const uint64_t m =
+            det.core.sorted_cols[((size_t)i * 2 + ch) * tc + tc / 2];
+        sum += m * m * m * m;
+      }
+      TEST_ASSERT_EQUAL_UINT64(sum, det.core.noise_sq[ch]);
+    }
+  }
+  free(buf);
+}
+
+// Bez vzorku nad det_level v prostředním tapu detekce vůbec neprobíhá;
+// jediný takový vzorek stačí, aby ji pustil dál.
+static void test_pre_gate_follows_middle_tap_peak(void) {
+  impulse_detector_cfg cfg = IMPULSE_DETECTOR_CFG_DEFAULT();
+  cfg.tap_count = 3;
+  cfg.tap_size = 2;
+  cfg.det_level = 99;
+  cfg.det_rms = 0.0f;
+  cfg.det_energy = 0.0f;
+  uint32_t buf[IMPULSE_DETECTOR_STORAGE_WORDS(3, 2)];
+  impulse_detector det;
+  TEST_ASSERT_EQUAL(IMPULSE_DET_OK,
+                    impulse_detector_init(&det, &cfg, buf, sizeof(buf)));
+
+  const int16_t quiet[2] = {0, 0};
+  const int16_t level[2] = {0, 9}; // 81 <= det_level
+  const int16_t loud[2] = {0, 10}; // 100 > det_level
+  impulse_add_tap(&det, quiet, 0);
+  impulse_add_tap(&det, level, 2);
+  impulse_add_tap(&det, quiet, 4);
+  TEST_ASSERT_EQUAL_UINT16(9, det.tap_max[1]);
+  TEST_ASSERT_FALSE(impulse_run_detection(&det, NULL));
+
+  impulse_detector_reset(&det);
+  impulse_add_tap(&det, quiet, 0);
+  impulse_add_tap(&det, loud, 2);
+  impulse_add_tap(&det, quiet, 4);
+  impulse_result res;
+  TEST_ASSERT_TRUE(impulse_run_detection(&det, &res));
+  TEST_ASSERT_EQUAL_UINT64(3, res.peak_index);
+}
+
+// Stav drží velikosti |s| na 16 bitech; záporný plný rozsah se musí vejít
+// a úroveň zásahu zůstává v čtvercích jako dřív.
+static void test_compact_storage_keeps_squared_levels(void) {
+  impulse_detector_cfg cfg = IMPULSE_DETECTOR_CFG_DEFAULT();
+  cfg.tap_count = 3;
+  cfg.tap_size = 2;
+  cfg.det_level = 0;
+  cfg.det_rms = 0.0f;
+  cfg.det_energy = 0.0f;
+  uint32_t buf[IMPULSE_DETECTOR_STORAGE_WORDS(3, 2)];
+  TEST_ASSERT_EQUAL(IMPULSE_DETECTOR_STORAGE_WORDS(3, 2) * sizeof(uint32_t),
+                    impulse_detector_storage_size(&cfg));
+  impulse_detector det;
+  TEST_ASSERT_EQUAL(IMPULSE_DET_OK,
+                    impulse_detector_init(&det, &cfg, buf, sizeof(buf)));
+
+  const int16_t quiet[2] = {3, -3};
+  const int16_t loud[2] = {-5, INT16_MIN};
+  impulse_add_tap(&det, quiet, 0);
+  impulse_add_tap(&det, loud, 2);
+  impulse_add_tap(&det, quiet, 4);
+  TEST_ASSERT_EQUAL_UINT16(32768, det.tap_max[1]);
+
+  impulse_result res;
+  TEST_ASSERT_TRUE(impulse_run_detection(&det, &res));
+  TEST_ASSERT_EQUAL_UINT64(3, res.peak_index);
+  TEST_ASSERT_EQUAL_UINT32(32768u * 32768u - 9u, res.level);
+}
+
+static void test_coalescer_keeps_strongest_in_window(void) {
+  impulse_coalescer c;
+  impulse_coalesced_hit out;
+  impulse_coalesce_init(&c, 100);
+  TEST_ASSERT_FALSE(impulse_coalesce_flush(&c, 0, &out));
+
+  TEST_ASSERT_TRUE(impulse_coalesce_add(&c, 1000, 50));
+  TEST_ASSERT_FALSE(impulse_coalesce_flush(&c, 1030, &out));
+  TEST_ASSERT_TRUE(impulse_coalesce_add(&c, 1030, 80));
+  // Stejně silný pozdější zásah nevyhrává.
+  TEST_ASSERT_FALSE(impulse_coalesce_flush(&c, 1099, &out));
+  TEST_ASSERT_FALSE(impulse_coalesce_add(&c, 1099, 80));
+  TEST_ASSERT_FALSE(impulse_coalesce_flush(&c, 1099, &out));
+
+  // Okno se měří od prvního zásahu skupiny, ne od nejsilnějšího.
+  TEST_ASSERT_TRUE(impulse_coalesce_flush(&c, 1100, &out));
+  TEST_ASSERT_EQUAL_UINT64(1030, out.peak_index);
+  TEST_ASSERT_EQUAL_UINT32(80, out.level);
+  TEST_ASSERT_EQUAL_UINT32(3, out.hits);
+  TEST_ASSERT_FALSE(impulse_coalesce_flush(&c, UINT64_MAX, &out));
+
+  TEST_ASSERT_TRUE(impulse_coalesce_add(&c, 1105, 10));
+  TEST_ASSERT_TRUE(impulse_coalesce_flush(&c, UINT64_MAX, &out));
+  TEST_ASSERT_EQUAL_UINT64(1105, out.peak_index);
+  TEST_ASSERT_EQUAL_UINT32(1, out.hits);
+
+  // Bez okna je každý zásah samostatná skupina.
+  impulse_coalesce_init(&c, 0);
+  TEST_ASSERT_TRUE(impulse_coalesce_add(&c, 7, 1));
+  TEST_ASSERT_TRUE(impulse_coalesce_flush(&c, 8, &out));
+  TEST_ASSERT_EQUAL_UINT64(7, out.peak_index);
+
+  // Nejnovější tap od 600, 31 x 30: další průchod může mít pík od 180.
+  TEST_ASSERT_EQUAL_UINT64(180, impulse_coalesce_horizon(600, 31, 30));
+  TEST_ASSERT_EQUAL_UINT64(0, impulse_coalesce_horizon(0, 31, 30));
+}
+
+static void test_refractory_merges_close_bursts(void) {
+  impulse_detector_cfg cfg = IMPULSE_DETECTOR_CFG_DEFAULT();
+  const size_t n = 200 * TAP_SIZE;
+  const size_t starts[] = {2000, 2100, 4517};
+  int16_t *samples = (int16_t *)malloc(n * sizeof(int16_t));
+  TEST_ASSERT_NOT_NULL(samples);
+  generate_bursts(samples, n, starts, 3, 8);
+  samples[2100] = 6000; // druhý výbuch je silnější
+
+  int64_t positions[8];
+  TEST_ASSERT_EQUAL(3,
+                    detect_recording_median_i16(samples, n, &cfg, positions, 8));
+  cfg.refractory = 300;
+  TEST_ASSERT_EQUAL(2,
+                    detect_recording_median_i16(samples, n, &cfg, positions, 8));
+  TEST_ASSERT_EQUAL_INT64(2100, positions[0]);
+  TEST_ASSERT_EQUAL_INT64(4517, positions[1]);
+
+  free(samples);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_init_rejects_bad_args);
+  RUN_TEST(test_default_geometry_detects_burst);
+  RUN_TEST(test_generic_geometry_detects_burst);
+  RUN_TEST(test_fast_path_matches_generic);
+  RUN_TEST(test_22k_geometry_matches_generic);
+  RUN_TEST(test_tap_size_for_rate);
+  RUN_TEST(test_stereo_matches_mono);
+  RUN_TEST(test_stereo_generic_matches_mono);
+  RUN_TEST(test_stereo_reports_channel_offset);
+  RUN_TEST(test_reset_clears_window);
+  RUN_TEST(test_noise_energy_tracks_columns);
+  RUN_TEST(test_pre_gate_follows_middle_tap_peak);
+  RUN_TEST(test_compact_storage_keeps_squared_levels);
+  RUN_TEST(test_coalescer_keeps_strongest_in_window);
+  RUN_TEST(test_refractory_merges_close_bursts);
+  return UNITY_END();
+}
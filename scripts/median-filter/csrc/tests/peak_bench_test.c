@@ -0,0 +1,92 @@
+#include "median_detection.h"
+#include "peak_bench.h"
+#include "unity.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Tichý šum s jedním krátkým výbuchem, viz median_detection_test.c.
+static int16_t *generate_burst(size_t n, size_t start) {
+  int16_t *dst = (int16_t *)malloc(n * sizeof(int16_t));
+  TEST_ASSERT_NOT_NULL(dst);
+  uint32_t seed = 12345u;
+  for (size_t i = 0; i < n; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    dst[i] = (int16_t)((int32_t)(seed >> 16) % 41 - 20);
+  }
+  for (size_t i = start; i < start + 8 && i < n; i++) {
+    dst[i] = (i == start) ? 3000 : 1500;
+  }
+  return dst;
+}
+
+static struct peak_bench_cfg default_cfg(void) {
+  const struct peak_bench_cfg cfg = {
+      .num_taps = TAP_COUNT,
+      .tap_size = TAP_SIZE,
+      .det_level = DET_LEVEL,
+      .det_rms = DET_RMS,
+      .det_energy = DET_ENERGY,
+  };
+  return cfg;
+}
+
+static void test_firmware_variants_agree_and_time_every_block(void) {
+  const struct peak_bench_cfg cfg = default_cfg();
+  const size_t blocks = 200;
+  const size_t n = blocks * TAP_SIZE + 7; // neúplný tap na konci se ignoruje
+  int16_t *samples = generate_burst(n, 2000);
+  uint32_t *ns = (uint32_t *)calloc(blocks + 1, sizeof(uint32_t));
+  TEST_ASSERT_NOT_NULL(ns);
+
+  int64_t fast[4], generic[4];
+  const int hf = peak_bench_run_i16(PEAK_BENCH_FIRMWARE, samples, n, &cfg,
+                                    fast, 4, ns, blocks + 1);
+  const int hg = peak_bench_run_i16(PEAK_BENCH_SORTED_GENERIC, samples, n,
+                                    &cfg, generic, 4, NULL, 0);
+  TEST_ASSERT_EQUAL(1, hf);
+  TEST_ASSERT_EQUAL(1, hg);
+  TEST_ASSERT_EQUAL_INT64(2000, fast[0]);
+  TEST_ASSERT_EQUAL_INT64(fast[0], generic[0]);
+  TEST_ASSERT_EQUAL_UINT32(0, ns[blocks]);
+
+  free(ns);
+  free(samples);
+}
+
+static void test_heaps_variant_finds_burst(void) {
+  struct peak_bench_cfg cfg = default_cfg();
+  cfg.det_level = 500;
+  cfg.det_rms = 0;
+  cfg.det_energy = 0;
+  const size_t n = 200 * TAP_SIZE;
+  int16_t *samples = generate_burst(n, 2000);
+
+  int64_t positions[4];
+  const int hits = peak_bench_run_i16(PEAK_BENCH_HEAPS, samples, n, &cfg,
+                                      positions, 4, NULL, 0);
+  TEST_ASSERT_GREATER_OR_EQUAL(1, hits);
+  TEST_ASSERT_EQUAL_INT64(2000, positions[0]);
+
+  free(samples);
+}
+
+static void test_rejects_bad_args(void) {
+  const struct peak_bench_cfg cfg = default_cfg();
+  int16_t samples[TAP_SIZE] = {0};
+  TEST_ASSERT_TRUE(peak_bench_run_i16(PEAK_BENCH_FIRMWARE, NULL, 0, &cfg,
+                                      NULL, 0, NULL, 0) < 0);
+  TEST_ASSERT_TRUE(peak_bench_run_i16(7, samples, TAP_SIZE, &cfg, NULL, 0,
+                                      NULL, 0) < 0);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_firmware_variants_agree_and_time_every_block);
+  RUN_TEST(test_heaps_variant_finds_burst);
+  RUN_TEST(test_rejects_bad_args);
+  return UNITY_END();
+}
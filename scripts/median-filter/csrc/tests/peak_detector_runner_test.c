@@ -99,10 +99,210 @@ static void test_detect_recording_large_generated(void) {
   free(samples);
 }
 
+static void test_refractory_keeps_strongest_hit(void) {
+  // Signál jako v test_detect_recording_multiple_hits, jen s vyšším druhým
+  // pikem: zásahy na pozicích 5 (5 nad mediánem) a 10 (7 nad mediánem).
+  struct median_detector_cfg cfg = {
+      .num_taps = 3,
+      .tap_size = 4,
+      .levels = {.det_level = 2, .det_rms = 0, .det_energy = 0},
+      .refractory = 8,
+  };
+  int16_t samples[5 * 4] = {0};
+  samples[1 * 4 + 1] = 5;
+  samples[1 * 4 + 2] = 1;
+  samples[1 * 4 + 3] = 1;
+  samples[2 * 4 + 2] = 8;
+  samples[2 * 4 + 3] = 1;
+
+  int positions[4] = {-1, -1, -1, -1};
+  TEST_ASSERT_EQUAL(1, detect_recording_i16(samples, 20, &cfg, positions, 4));
+  TEST_ASSERT_EQUAL(10, positions[0]);
+
+  // Druhý pík leží přesně na konci kratšího okna, zůstanou tedy oba.
+  cfg.refractory = 5;
+  TEST_ASSERT_EQUAL(2, detect_recording_i16(samples, 20, &cfg, positions, 4));
+  TEST_ASSERT_EQUAL(5, positions[0]);
+  TEST_ASSERT_EQUAL(10, positions[1]);
+}
+
+// Šum s pravidelnými výbuchy; pro různé počty vláken leží výbuchy na
+// různých místech vůči hranicím úseků.
+static int16_t *generate_noise_with_bursts(size_t n, size_t every) {
+  int16_t *dst = (int16_t *)malloc(n * sizeof(int16_t));
+  TEST_ASSERT_NOT_NULL(dst);
+  uint32_t seed = 777u;
+  for (size_t i = 0; i < n; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    dst[i] = (int16_t)((int32_t)(seed >> 16) % 21 - 10);
+  }
+  for (size_t p = every / 3; p + 4 < n; p += every) {
+    dst[p] = 400;
+    dst[p + 1] = 120;
+    dst[p + 2] = 60;
+  }
+  return dst;
+}
+
+static void test_parallel_matches_serial(void) {
+  struct median_detector_cfg cfg = {
+      .num_taps = 7,
+      .tap_size = 16,
+      .levels = {.det_level = 100, .det_rms = 2, .det_energy = 0},
+  };
+  const size_t n = 40000 + 5; // neúplný tap na konci
+  int16_t *samples = generate_noise_with_bursts(n, 997);
+
+  static int serial[256];
+  static int parallel[256];
+  const int expected = detect_recording_i16(samples, n, &cfg, serial, 256);
+  TEST_ASSERT_GREATER_THAN(20, expected);
+  TEST_ASSERT_LESS_OR_EQUAL(256, expected);
+
+  for (unsigned threads = 1; threads <= 9; ++threads) {
+    memset(parallel, 0xff, sizeof(parallel));
+    const int hits = detect_recording_parallel_i16(samples, n, &cfg, threads,
+                                                   parallel, 256);
+    TEST_ASSERT_EQUAL(expected, hits);
+    TEST_ASSERT_EQUAL_INT_ARRAY(serial, parallel, expected);
+  }
+  free(samples);
+}
+
+static void test_parallel_counts_beyond_capacity(void) {
+  struct median_detector_cfg cfg = {
+      .num_taps = 5,
+      .tap_size = 8,
+      .levels = {.det_level = 100, .det_rms = 2, .det_energy = 0},
+  };
+  const size_t n = 30000;
+  int16_t *samples = generate_noise_with_bursts(n, 500);
+
+  int serial[4];
+  int parallel[4];
+  const int expected = detect_recording_i16(samples, n, &cfg, serial, 4);
+  const int hits =
+      detect_recording_parallel_i16(samples, n, &cfg, 4, parallel, 4);
+  TEST_ASSERT_GREATER_THAN(4, expected);
+  TEST_ASSERT_EQUAL(expected, hits);
+  TEST_ASSERT_EQUAL_INT_ARRAY(serial, parallel, 4);
+  free(samples);
+}
+
+static void test_multi_matches_per_channel_runs(void) {
+  const struct median_detector_cfg cfgs[3] = {
+      {.num_taps = 7, .tap_size = 16,
+       .levels = {.det_level = 100, .det_rms = 2, .det_energy = 0}},
+      {.num_taps = 5, .tap_size = 30,
+       .levels = {.det_level = 80, .det_rms = 2, .det_energy = 0}},
+      {.num_taps = 9, .tap_size = 8,
+       .levels = {.det_level = 100, .det_rms = 3, .det_energy = 0}},
+  };
+  const size_t frames = 12000 + 3;
+  int16_t *planar = (int16_t *)malloc(3 * frames * sizeof(int16_t));
+  int16_t *interleaved = (int16_t *)malloc(3 * frames * sizeof(int16_t));
+  TEST_ASSERT_NOT_NULL(planar);
+  TEST_ASSERT_NOT_NULL(interleaved);
+  const size_t every[3] = {997, 613, 1409};
+  for (size_t ch = 0; ch < 3; ++ch) {
+    int16_t *one = generate_noise_with_bursts(frames, every[ch]);
+    memcpy(planar + ch * frames, one, frames * sizeof(int16_t));
+    for (size_t f = 0; f < frames; ++f) {
+      interleaved[f * 3 + ch] = one[f];
+    }
+    free(one);
+  }
+
+  enum { CAP = 64 };
+  static int expected[3][CAP];
+  int expected_hits[3];
+  int total = 0;
+  for (size_t ch = 0; ch < 3; ++ch) {
+    expected_hits[ch] = detect_recording_i16(planar + ch * frames, frames,
+                                             &cfgs[ch], expected[ch], CAP);
+    TEST_ASSERT_GREATER_THAN(5, expected_hits[ch]);
+    TEST_ASSERT_LESS_OR_EQUAL(CAP, expected_hits[ch]);
+    total += expected_hits[ch];
+  }
+
+  const int layouts[2] = {PEAK_LAYOUT_PLANAR, PEAK_LAYOUT_INTERLEAVED};
+  for (size_t l = 0; l < 2; ++l) {
+    static int got[3 * CAP];
+    int counts[3] = {-1, -1, -1};
+    const int16_t *src = layouts[l] == PEAK_LAYOUT_PLANAR ? planar : interleaved;
+    const int hits = detect_recording_multi_i16(src, frames, 3, layouts[l],
+                                                cfgs, got, CAP, counts);
+    TEST_ASSERT_EQUAL(total, hits);
+    for (size_t ch = 0; ch < 3; ++ch) {
+      TEST_ASSERT_EQUAL(expected_hits[ch], counts[ch]);
+      TEST_ASSERT_EQUAL_INT_ARRAY(expected[ch], &got[ch * CAP],
+                                  expected_hits[ch]);
+    }
+  }
+  free(planar);
+  free(interleaved);
+}
+
+static void test_refractory_parallel_and_multi_match_serial(void) {
+  // Okno přes dva výbuchy: skupiny přesahují i hranice úseků vláken.
+  struct median_detector_cfg cfg = {
+      .num_taps = 7,
+      .tap_size = 16,
+      .levels = {.det_level = 100, .det_rms = 2, .det_energy = 0},
+      .refractory = 1500,
+  };
+  const size_t n = 40000 + 5;
+  int16_t *samples = generate_noise_with_bursts(n, 997);
+
+  static int all[256];
+  static int serial[256];
+  static int other[256];
+  struct median_detector_cfg plain = cfg;
+  plain.refractory = 0;
+  const int raw = detect_recording_i16(samples, n, &plain, all, 256);
+  const int expected = detect_recording_i16(samples, n, &cfg, serial, 256);
+  TEST_ASSERT_GREATER_THAN(10, expected);
+  TEST_ASSERT_LESS_THAN(raw, expected);
+
+  for (unsigned threads = 2; threads <= 9; ++threads) {
+    memset(other, 0xff, sizeof(other));
+    TEST_ASSERT_EQUAL(expected, detect_recording_parallel_i16(
+                                    samples, n, &cfg, threads, other, 256));
+    TEST_ASSERT_EQUAL_INT_ARRAY(serial, other, expected);
+  }
+  int count = -1;
+  memset(other, 0xff, sizeof(other));
+  TEST_ASSERT_EQUAL(expected,
+                    detect_recording_multi_i16(samples, n, 1,
+                                               PEAK_LAYOUT_PLANAR, &cfg, other,
+                                               256, &count));
+  TEST_ASSERT_EQUAL(expected, count);
+  TEST_ASSERT_EQUAL_INT_ARRAY(serial, other, expected);
+  free(samples);
+}
+
+static void test_multi_rejects_bad_args(void) {
+  const struct median_detector_cfg cfg = {.num_taps = 3, .tap_size = 2};
+  int16_t samples[8] = {0};
+  TEST_ASSERT_EQUAL(PEAK_DET_ERR_INVALID_ARG,
+                    detect_recording_multi_i16(samples, 4, 0,
+                                               PEAK_LAYOUT_PLANAR, &cfg, NULL,
+                                               0, NULL));
+  TEST_ASSERT_EQUAL(PEAK_DET_ERR_INVALID_ARG,
+                    detect_recording_multi_i16(samples, 4, 1, 7, &cfg, NULL,
+                                               0, NULL));
+}
+
 int main(void) {
   UNITY_BEGIN();
   RUN_TEST(test_detect_recording_basic);
   RUN_TEST(test_detect_recording_multiple_hits);
   RUN_TEST(test_detect_recording_large_generated);
+  RUN_TEST(test_refractory_keeps_strongest_hit);
+  RUN_TEST(test_parallel_matches_serial);
+  RUN_TEST(test_parallel_counts_beyond_capacity);
+  RUN_TEST(test_multi_matches_per_channel_runs);
+  RUN_TEST(test_refractory_parallel_and_multi_match_serial);
+  RUN_TEST(test_multi_rejects_bad_args);
   return UNITY_END();
 }
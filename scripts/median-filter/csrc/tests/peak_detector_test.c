@@ -222,6 +222,93 @@ static void test_detection_basic(void) {
   free(buf);
 }
 
+static void test_generation_wrap_and_long_offsets(void) {
+  // Stav s generací těsně před přetečením a offsety za hranicí int musí dát
+  // stejné mediány i zásahy jako čerstvý stav.
+  struct median_detector_cfg cfg = {
+      .num_taps = 7,
+      .tap_size = 8,
+      .levels = {.det_level = 50, .det_rms = 0, .det_energy = 0},
+  };
+  size_t need = 0;
+  TEST_ASSERT_EQUAL(PEAK_DET_OK, detector_state_size(&cfg, &need));
+  uint8_t *buf_a = (uint8_t *)malloc(need);
+  uint8_t *buf_b = (uint8_t *)malloc(need);
+  TEST_ASSERT_NOT_NULL(buf_a);
+  TEST_ASSERT_NOT_NULL(buf_b);
+  struct detector_state *fresh = NULL;
+  struct detector_state *wrapped = NULL;
+  TEST_ASSERT_EQUAL(PEAK_DET_OK, detector_init(buf_a, need, &cfg, &fresh));
+  TEST_ASSERT_EQUAL(PEAK_DET_OK, detector_init(buf_b, need, &cfg, &wrapped));
+  peak_test_set_generation(wrapped, UINT32_MAX - 20u);
+
+  const int64_t far = (int64_t)INT32_MAX * 4; // ~ 2 dny při 48 kHz
+  uint32_t seed = 5u;
+  int hits = 0;
+  for (int tap = 0; tap < 60; ++tap) {
+    int16_t block[8];
+    for (int i = 0; i < 8; ++i) {
+      seed = seed * 1664525u + 1013904223u;
+      block[i] = (int16_t)((int32_t)(seed >> 16) % 9 - 4);
+    }
+    if (tap % 9 == 4) {
+      block[3] = 200; // opakované hodnoty, ať rozhoduje i generace
+      block[4] = 200;
+    }
+    struct detector_result ra;
+    struct detector_result rb;
+    TEST_ASSERT_EQUAL(PEAK_DET_OK,
+                      detector_feed_block(fresh, block, tap * 8, &ra));
+    TEST_ASSERT_EQUAL(PEAK_DET_OK,
+                      detector_feed_block(wrapped, block, far + tap * 8, &rb));
+    for (uint16_t i = 0; i < cfg.tap_size; ++i) {
+      TEST_ASSERT_EQUAL_INT16(peak_test_median_value(fresh, i),
+                              peak_test_median_value(wrapped, i));
+    }
+    TEST_ASSERT_EQUAL(ra.hit, rb.hit);
+    if (ra.hit) {
+      TEST_ASSERT_EQUAL_INT64(far + ra.peak_index, rb.peak_index);
+      ++hits;
+    }
+  }
+  TEST_ASSERT_GREATER_THAN(3, hits);
+
+  free(buf_a);
+  free(buf_b);
+}
+
+static int cmp_int16(const void *a, const void *b) {
+  int16_t av = *(const int16_t *)a;
+  int16_t bv = *(const int16_t *)b;
+  return (av > bv) - (av < bv);
+}
+
+static void test_median_of_slice_matches_sort(void) {
+  // Výběr musí dát totéž co tmp[len / 2] po qsort, i s opakovanými hodnotami.
+  uint32_t seed = 99u;
+  int16_t arr[128];
+  int16_t sorted[128];
+  for (size_t len = 1; len <= 128; ++len) {
+    for (int round = 0; round < 20; ++round) {
+      const int spread = round % 2 ? 65536 : 7;
+      for (size_t i = 0; i < len; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        arr[i] = (int16_t)((int32_t)((seed >> 8) % (uint32_t)spread) -
+                           spread / 2);
+      }
+      if (round == 2) {
+        for (size_t i = 0; i < len; ++i) {
+          arr[i] = (int16_t)(len - i); // sestupně
+        }
+      }
+      memcpy(sorted, arr, len * sizeof(int16_t));
+      qsort(sorted, len, sizeof(int16_t), cmp_int16);
+      TEST_ASSERT_EQUAL_INT16(sorted[len / 2],
+                              peak_test_median_of_slice(arr, len));
+    }
+  }
+}
+
 int main(void) {
   UNITY_BEGIN();
   RUN_TEST(test_state_size_and_init);
@@ -230,5 +317,7 @@ int main(void) {
   RUN_TEST(test_median_progression);
   RUN_TEST(test_big_median_progression);
   RUN_TEST(test_detection_basic);
+  RUN_TEST(test_median_of_slice_matches_sort);
+  RUN_TEST(test_generation_wrap_and_long_offsets);
   return UNITY_END();
 }
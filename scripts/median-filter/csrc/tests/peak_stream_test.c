@@ -0,0 +1,248 @@
+#include "peak_detector.h"
+#include "peak_stream.h"
+#include "unity.h"
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static const struct median_detector_cfg cfg = {
+    .num_taps = 7,
+    .tap_size = 16,
+    .levels = {.det_level = 100, .det_rms = 2, .det_energy = 0},
+};
+
+#define FRAMES 20005u
+#define MAX_HITS 256
+
+static int16_t *generate_channel(size_t n, size_t every, uint32_t seed) {
+  int16_t *dst = (int16_t *)malloc(n * sizeof(int16_t));
+  TEST_ASSERT_NOT_NULL(dst);
+  for (size_t i = 0; i < n; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    dst[i] = (int16_t)((int32_t)(seed >> 16) % 21 - 10);
+  }
+  for (size_t p = every / 3; p + 4 < n; p += every) {
+    dst[p] = 400;
+    dst[p + 1] = 120;
+    dst[p + 2] = 60;
+  }
+  return dst;
+}
+
+static int16_t *interleave(const int16_t *left, const int16_t *right,
+                           size_t frames) {
+  int16_t *dst = (int16_t *)malloc(frames * 2 * sizeof(int16_t));
+  TEST_ASSERT_NOT_NULL(dst);
+  for (size_t f = 0; f < frames; f++) {
+    dst[2 * f] = left[f];
+    dst[2 * f + 1] = right[f];
+  }
+  return dst;
+}
+
+static struct peak_stream *open_stream(const struct median_detector_cfg *cfgs,
+                                       size_t channels, void **mem) {
+  size_t size = 0;
+  TEST_ASSERT_EQUAL(PEAK_DET_OK, peak_stream_size(cfgs, channels, &size));
+  *mem = aligned_alloc(alignof(max_align_t),
+                       (size + alignof(max_align_t) - 1) &
+                           ~(alignof(max_align_t) - 1));
+  TEST_ASSERT_NOT_NULL(*mem);
+  struct peak_stream *s = NULL;
+  TEST_ASSERT_EQUAL(PEAK_DET_OK,
+                    peak_stream_init(*mem, size, cfgs, channels, &s));
+  return s;
+}
+
+// Předá vstup po blocích délek `steps` (cyklicky) do kapacity `capacity` a
+// vrátí zásahy včetně konce proudu.
+static size_t run_blocks(struct peak_stream *s, const int16_t *samples,
+                         size_t channels, size_t frames, const size_t *steps,
+                         size_t num_steps, size_t capacity,
+                         struct peak_stream_hit *out) {
+  struct peak_stream_hit buf[64];
+  TEST_ASSERT_TRUE(capacity <= 64);
+  size_t total = 0;
+  size_t pos = 0;
+  for (size_t k = 0; pos < frames; k++) {
+    size_t n = steps[k % num_steps];
+    n = n < frames - pos ? n : frames - pos;
+    size_t consumed = 0;
+    const int got = peak_stream_feed_i16(s, samples + pos * channels, n, buf,
+                                         capacity, &consumed);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, got);
+    TEST_ASSERT_TRUE(total + (size_t)got <= MAX_HITS);
+    memcpy(out + total, buf, (size_t)got * sizeof(buf[0]));
+    total += (size_t)got;
+    pos += consumed;
+  }
+  TEST_ASSERT_EQUAL_INT64((int64_t)frames, peak_stream_frames(s));
+  const int last = peak_stream_finish(s, buf, capacity);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, last);
+  memcpy(out + total, buf, (size_t)last * sizeof(buf[0]));
+  return total + (size_t)last;
+}
+
+// Zásahy kanálu `ch` musí odpovídat offline běhu nad celým kanálem.
+static void assert_channel_matches(const struct peak_stream_hit *hits,
+                                   size_t count, uint16_t ch,
+                                   const int16_t *channel,
+                                   const struct median_detector_cfg *c) {
+  static int expected[MAX_HITS];
+  const int want = detect_recording_i16(channel, FRAMES, c, expected, MAX_HITS);
+  TEST_ASSERT_GREATER_THAN(5, want);
+  int seen = 0;
+  int64_t last = -1;
+  for (size_t i = 0; i < count; i++) {
+    if (hits[i].channel != ch) {
+      continue;
+    }
+    TEST_ASSERT_TRUE(seen < want);
+    TEST_ASSERT_EQUAL_INT64(expected[seen], hits[i].position);
+    TEST_ASSERT_GREATER_THAN(last, hits[i].position);
+    TEST_ASSERT_GREATER_THAN(0, hits[i].level);
+    TEST_ASSERT_GREATER_OR_EQUAL(1, hits[i].merged);
+    last = hits[i].position;
+    seen++;
+  }
+  TEST_ASSERT_EQUAL(want, seen);
+}
+
+static void test_abi(void) {
+  TEST_ASSERT_EQUAL_UINT32(PEAK_STREAM_ABI_VERSION, peak_stream_abi_version());
+  TEST_ASSERT_EQUAL(16, sizeof(struct peak_stream_hit));
+  TEST_ASSERT_EQUAL(0, offsetof(struct peak_stream_hit, position));
+  TEST_ASSERT_EQUAL(8, offsetof(struct peak_stream_hit, channel));
+  TEST_ASSERT_EQUAL(10, offsetof(struct peak_stream_hit, level));
+  TEST_ASSERT_EQUAL(12, offsetof(struct peak_stream_hit, merged));
+}
+
+static void test_stereo_blocks_match_offline(void) {
+  int16_t *left = generate_channel(FRAMES, 997, 7u);
+  int16_t *right = generate_channel(FRAMES, 613, 11u);
+  int16_t *frames = interleave(left, right, FRAMES);
+  const struct median_detector_cfg cfgs[2] = {cfg, cfg};
+  void *mem = NULL;
+  struct peak_stream *s = open_stream(cfgs, 2, &mem);
+
+  static const size_t uneven[] = {1, 7, 16, 33, 1000, 5};
+  static const size_t whole[] = {4096};
+  static struct peak_stream_hit hits[MAX_HITS];
+  size_t n = run_blocks(s, frames, 2, FRAMES, uneven, 6, 64, hits);
+  assert_channel_matches(hits, n, 0, left, &cfg);
+  assert_channel_matches(hits, n, 1, right, &cfg);
+
+  // peak_stream_finish() začne proud znovu od nuly.
+  n = run_blocks(s, frames, 2, FRAMES, whole, 1, 64, hits);
+  assert_channel_matches(hits, n, 0, left, &cfg);
+  assert_channel_matches(hits, n, 1, right, &cfg);
+
+  free(mem);
+  free(frames);
+  free(right);
+  free(left);
+}
+
+static void test_mono_and_refractory_match_offline(void) {
+  int16_t *mono = generate_channel(FRAMES, 301, 5u);
+  // Každý impulz zasáhne víckrát; sloučí se do jednoho zásahu skupiny.
+  for (size_t p = 301 / 3 + 40; p + 4 < FRAMES; p += 301) {
+    mono[p] = 380;
+  }
+  struct median_detector_cfg c = cfg;
+  c.refractory = 60;
+  void *mem = NULL;
+  struct peak_stream *s = open_stream(&c, 1, &mem);
+
+  static const size_t steps[] = {16, 48, 3, 29};
+  static struct peak_stream_hit hits[MAX_HITS];
+  const size_t n = run_blocks(s, mono, 1, FRAMES, steps, 4, 64, hits);
+  assert_channel_matches(hits, n, 0, mono, &c);
+  uint32_t merged = 0;
+  for (size_t i = 0; i < n; i++) {
+    merged = hits[i].merged > merged ? hits[i].merged : merged;
+  }
+  TEST_ASSERT_GREATER_THAN(1, merged);
+
+  free(mem);
+  free(mono);
+}
+
+static void test_full_output_stops_early_without_losing_hits(void) {
+  int16_t *left = generate_channel(FRAMES, 211, 3u);
+  int16_t *right = generate_channel(FRAMES, 223, 9u);
+  int16_t *frames = interleave(left, right, FRAMES);
+  const struct median_detector_cfg cfgs[2] = {cfg, cfg};
+  void *mem = NULL;
+  struct peak_stream *s = open_stream(cfgs, 2, &mem);
+
+  // Jeden velký blok do nejmenšího výstupu: vrací se po kouscích.
+  static const size_t once[] = {FRAMES};
+  static struct peak_stream_hit hits[MAX_HITS];
+  const size_t n = run_blocks(s, frames, 2, FRAMES, once, 1,
+                              PEAK_STREAM_MIN_HITS(2), hits);
+  assert_channel_matches(hits, n, 0, left, &cfg);
+  assert_channel_matches(hits, n, 1, right, &cfg);
+
+  free(mem);
+  free(frames);
+  free(right);
+  free(left);
+}
+
+static void test_rejects_bad_arguments(void) {
+  struct median_detector_cfg cfgs[2] = {cfg, cfg};
+  size_t size = 0;
+  TEST_ASSERT_EQUAL(PEAK_DET_ERR_INVALID_ARG, peak_stream_size(cfgs, 0, &size));
+  TEST_ASSERT_EQUAL(PEAK_DET_ERR_INVALID_ARG,
+                    peak_stream_size(cfgs, PEAK_STREAM_MAX_CHANNELS + 1, &size));
+  cfgs[1].tap_size = 30;
+  TEST_ASSERT_EQUAL(PEAK_DET_ERR_INVALID_ARG, peak_stream_size(cfgs, 2, &size));
+  cfgs[1] = cfg;
+  TEST_ASSERT_EQUAL(PEAK_DET_OK, peak_stream_size(cfgs, 2, &size));
+
+  uint8_t *mem = aligned_alloc(alignof(max_align_t),
+                               size + 2 * alignof(max_align_t));
+  TEST_ASSERT_NOT_NULL(mem);
+  struct peak_stream *s = NULL;
+  TEST_ASSERT_EQUAL(PEAK_DET_ERR_BUFFER_TOO_SMALL,
+                    peak_stream_init(mem, size - 1, cfgs, 2, &s));
+  TEST_ASSERT_EQUAL(PEAK_DET_ERR_INVALID_ARG,
+                    peak_stream_init(mem + 2, size, cfgs, 2, &s));
+  TEST_ASSERT_EQUAL(PEAK_DET_OK, peak_stream_init(mem, size, cfgs, 2, &s));
+
+  int16_t samples[64] = {0};
+  struct peak_stream_hit hits[4];
+  size_t consumed = 99;
+  TEST_ASSERT_EQUAL(PEAK_DET_ERR_INVALID_ARG,
+                    peak_stream_feed_i16(s, samples, 32, hits, 3, &consumed));
+  TEST_ASSERT_EQUAL(0, consumed);
+  TEST_ASSERT_EQUAL(PEAK_DET_ERR_INVALID_ARG,
+                    peak_stream_feed_i16(s, NULL, 32, hits, 4, &consumed));
+  TEST_ASSERT_EQUAL(0, peak_stream_feed_i16(s, samples, 32, hits, 4, NULL));
+  TEST_ASSERT_EQUAL_INT64(32, peak_stream_frames(s));
+  peak_stream_reset(s);
+  TEST_ASSERT_EQUAL_INT64(0, peak_stream_frames(s));
+
+  // Bez platného stavu se nic nezpracuje.
+  memset(mem, 0, size);
+  TEST_ASSERT_EQUAL(PEAK_DET_ERR_INVALID_ARG,
+                    peak_stream_feed_i16(s, samples, 32, hits, 4, NULL));
+  free(mem);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_abi);
+  RUN_TEST(test_stereo_blocks_match_offline);
+  RUN_TEST(test_mono_and_refractory_match_offline);
+  RUN_TEST(test_full_output_stops_early_without_losing_hits);
+  RUN_TEST(test_rejects_bad_arguments);
+  return UNITY_END();
+}
@@ -0,0 +1,245 @@
+#include "peak_detector.h"
+#include "peak_wav.h"
+#include "unity.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static const struct median_detector_cfg cfg = {
+    .num_taps = 7,
+    .tap_size = 16,
+    .levels = {.det_level = 100, .det_rms = 2, .det_energy = 0},
+};
+
+static void put_le16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+  put_le16(p, (uint16_t)v);
+  put_le16(p + 2, (uint16_t)(v >> 16));
+}
+
+// Hlavička jako audio_wav_build_header(): volitelný LIST chunk se značkou,
+// u živého proudu délka dat 0xffffffff.
+static size_t build_header(uint8_t *out, uint16_t channels, uint32_t data_size,
+                           bool stamp) {
+  const size_t extra = stamp ? 64 : 0;
+  memcpy(out, "RIFF", 4);
+  put_le32(out + 4, data_size + 36 + (uint32_t)extra);
+  memcpy(out + 8, "WAVE", 4);
+  memcpy(out + 12, "fmt ", 4);
+  put_le32(out + 16, 16);
+  put_le16(out + 20, 1);
+  put_le16(out + 22, channels);
+  put_le32(out + 24, 48000);
+  put_le32(out + 28, 48000u * channels * 2);
+  put_le16(out + 32, (uint16_t)(channels * 2));
+  put_le16(out + 34, 16);
+  if (stamp) {
+    memset(out + 36, 0, extra);
+    memcpy(out + 36, "LIST", 4);
+    put_le32(out + 40, (uint32_t)extra - 8);
+    memcpy(out + 44, "INFO", 4);
+  }
+  memcpy(out + 36 + extra, "data", 4);
+  put_le32(out + 40 + extra, data_size);
+  return 44 + extra;
+}
+
+static int16_t *generate_channel(size_t n, size_t every, uint32_t seed) {
+  int16_t *dst = (int16_t *)malloc(n * sizeof(int16_t));
+  TEST_ASSERT_NOT_NULL(dst);
+  for (size_t i = 0; i < n; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    dst[i] = (int16_t)((int32_t)(seed >> 16) % 21 - 10);
+  }
+  for (size_t p = every / 3; p + 4 < n; p += every) {
+    dst[p] = 400;
+    dst[p + 1] = 120;
+    dst[p + 2] = 60;
+  }
+  return dst;
+}
+
+struct wav_image {
+  uint8_t *bytes;
+  size_t len;
+};
+
+static struct wav_image build_wav(const int16_t *const *ch, uint16_t channels,
+                                  size_t frames, bool live) {
+  struct wav_image img;
+  const size_t data = frames * channels * 2;
+  img.bytes = (uint8_t *)malloc(128 + data);
+  TEST_ASSERT_NOT_NULL(img.bytes);
+  size_t off = build_header(img.bytes, channels,
+                            live ? 0xffffffffu : (uint32_t)data, live);
+  for (size_t f = 0; f < frames; f++) {
+    for (uint16_t c = 0; c < channels; c++) {
+      put_le16(img.bytes + off, (uint16_t)ch[c][f]);
+      off += 2;
+    }
+  }
+  img.len = off;
+  return img;
+}
+
+static FILE *write_temp(const struct wav_image *img) {
+  FILE *f = tmpfile();
+  TEST_ASSERT_NOT_NULL(f);
+  TEST_ASSERT_EQUAL(img->len, fwrite(img->bytes, 1, img->len, f));
+  TEST_ASSERT_EQUAL(0, fflush(f));
+  rewind(f);
+  return f;
+}
+
+static void assert_matches_serial(const int16_t *channel, size_t frames,
+                                  const int64_t *got, int hits) {
+  static int expected[256];
+  const int want = detect_recording_i16(channel, frames, &cfg, expected, 256);
+  TEST_ASSERT_GREATER_THAN(5, want);
+  TEST_ASSERT_EQUAL(want, hits);
+  for (int i = 0; i < want; i++) {
+    TEST_ASSERT_EQUAL_INT64(expected[i], got[i]);
+  }
+}
+
+static void test_mono_file_is_mapped_and_matches_serial(void) {
+  const size_t frames = 20000;
+  int16_t *mono = generate_channel(frames, 997, 7u);
+  const int16_t *chans[1] = {mono};
+  struct wav_image img = build_wav(chans, 1, frames, false);
+  FILE *f = write_temp(&img);
+
+  static int64_t got[256];
+  struct peak_wav_info info;
+  const int hits =
+      detect_wav_fd(fileno(f), 0, &cfg, got, 256, NULL, NULL, &info);
+  assert_matches_serial(mono, frames, got, hits);
+  TEST_ASSERT_EQUAL_UINT32(48000, info.sample_rate);
+  TEST_ASSERT_EQUAL_UINT16(1, info.channels);
+  TEST_ASSERT_EQUAL_UINT64(frames, info.frames);
+
+  fclose(f);
+  free(img.bytes);
+  free(mono);
+}
+
+static void test_stereo_live_header_second_channel(void) {
+  const size_t frames = 20000 + 5;
+  int16_t *left = generate_channel(frames, 997, 7u);
+  int16_t *right = generate_channel(frames, 613, 11u);
+  const int16_t *chans[2] = {left, right};
+  struct wav_image img = build_wav(chans, 2, frames, true);
+  FILE *f = write_temp(&img);
+
+  static int64_t got[256];
+  const int hits = detect_wav_fd(fileno(f), 1, &cfg, got, 256, NULL, NULL, NULL);
+  assert_matches_serial(right, frames, got, hits);
+
+  fclose(f);
+  free(img.bytes);
+  free(left);
+  free(right);
+}
+
+struct pipe_writer {
+  int fd;
+  const struct wav_image *img;
+};
+
+// Zapisuje po malých kouscích, aby tapy i snímky padaly přes hranice čtení.
+static void *write_pipe(void *arg) {
+  struct pipe_writer *w = (struct pipe_writer *)arg;
+  for (size_t off = 0; off < w->img->len;) {
+    size_t n = w->img->len - off < 777 ? w->img->len - off : 777;
+    ssize_t put = write(w->fd, w->img->bytes + off, n);
+    if (put <= 0) {
+      break;
+    }
+    off += (size_t)put;
+  }
+  close(w->fd);
+  return NULL;
+}
+
+struct hit_log {
+  int64_t last;
+  int count;
+};
+
+static void on_hit(int64_t position, void *ctx) {
+  struct hit_log *log = (struct hit_log *)ctx;
+  log->last = position;
+  log->count++;
+}
+
+static void test_pipe_is_streamed(void) {
+  const size_t frames = 20000 + 3;
+  int16_t *left = generate_channel(frames, 701, 3u);
+  int16_t *right = generate_channel(frames, 997, 5u);
+  const int16_t *chans[2] = {left, right};
+  struct wav_image img = build_wav(chans, 2, frames, true);
+
+  int fds[2];
+  TEST_ASSERT_EQUAL(0, pipe(fds));
+  struct pipe_writer w = {.fd = fds[1], .img = &img};
+  pthread_t tid;
+  TEST_ASSERT_EQUAL(0, pthread_create(&tid, NULL, write_pipe, &w));
+
+  static int64_t got[256];
+  struct hit_log log = {.last = -1};
+  struct peak_wav_info info;
+  const int hits = detect_wav_fd(fds[0], 0, &cfg, got, 256, on_hit, &log, &info);
+  pthread_join(tid, NULL);
+  close(fds[0]);
+
+  assert_matches_serial(left, frames, got, hits);
+  TEST_ASSERT_EQUAL(hits, log.count);
+  TEST_ASSERT_EQUAL_INT64(got[hits - 1], log.last);
+  TEST_ASSERT_EQUAL_UINT64(frames, info.frames);
+
+  free(img.bytes);
+  free(left);
+  free(right);
+}
+
+static void test_rejects_non_pcm(void) {
+  uint8_t hdr[44];
+  build_header(hdr, 1, 0, false);
+  put_le16(hdr + 34, 8); // 8bit
+  struct wav_image img = {.bytes = hdr, .len = sizeof(hdr)};
+  FILE *f = write_temp(&img);
+  TEST_ASSERT_EQUAL(PEAK_DET_ERR_FORMAT,
+                    detect_wav_fd(fileno(f), 0, &cfg, NULL, 0, NULL, NULL, NULL));
+  fclose(f);
+
+  build_header(hdr, 1, 0, false);
+  img.len = 20; // useknutá hlavička
+  f = write_temp(&img);
+  TEST_ASSERT_EQUAL(PEAK_DET_ERR_FORMAT,
+                    detect_wav_fd(fileno(f), 0, &cfg, NULL, 0, NULL, NULL, NULL));
+  fclose(f);
+
+  TEST_ASSERT_EQUAL(PEAK_DET_ERR_IO,
+                    detect_wav_path("/nonexistent/x.wav", 0, &cfg, NULL, 0,
+                                    NULL, NULL, NULL));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_mono_file_is_mapped_and_matches_serial);
+  RUN_TEST(test_stereo_live_header_second_channel);
+  RUN_TEST(test_pipe_is_streamed);
+  RUN_TEST(test_rejects_non_pcm);
+  return UNITY_END();
+}
@@ -0,0 +1,126 @@
+"""
+WAV loading for the detector tools, stdlib only.
+
+Only 16-bit PCM is read, which is what the firmware streams and what the
+C detectors take.
+"""
+
+from __future__ import annotations
+
+import array
+import struct
+import sys
+import wave
+from pathlib import Path
+from typing import BinaryIO, Iterator, Tuple
+
+
+def read_wav_i16_interleaved(path: str | Path) -> Tuple[array.array, int, int]:
+    """
+    Returns (samples, channels, sample_rate) of a 16-bit PCM WAV, all
+    channels interleaved in one array('h').
+    """
+    with wave.open(str(path), "rb") as wav:
+        if wav.getsampwidth() != 2:
+            raise ValueError(f"{path}: only 16-bit PCM is supported")
+        channels = wav.getnchannels()
+        rate = wav.getframerate()
+        frames = wav.readframes(wav.getnframes())
+
+    samples = array.array("h")
+    samples.frombytes(frames)
+    if sys.byteorder == "big":
+        samples.byteswap()
+    return samples, channels, rate
+
+
+def read_wav_i16(path: str | Path, channel: int = 0) -> Tuple[array.array, int]:
+    """
+    Returns (samples, sample_rate) of one channel of a 16-bit PCM WAV as
+    array('h').
+    """
+    samples, channels, rate = read_wav_i16_interleaved(path)
+    if not 0 <= channel < channels:
+        raise ValueError(f"{path}: no channel {channel} (has {channels})")
+    if channels > 1:
+        samples = samples[channel::channels]
+    return samples, rate
+
+
+# Data length of a live stream, see audio_wav_build_header() in the firmware.
+_WAV_DATA_UNBOUNDED = 0xFFFFFFFF
+
+
+def _read_exact(f: BinaryIO, n: int) -> bytes:
+    data = b""
+    while len(data) < n:
+        piece = f.read(n - len(data))
+        if not piece:
+            raise ValueError("WAV header cut short")
+        data += piece
+    return data
+
+
+def read_wav_stream_header(f: BinaryIO) -> Tuple[int, int, int]:
+    """
+    Reads a 16-bit PCM WAV header from a stream, up to the start of its
+    samples, as the firmware writes it (optional LIST chunk, data length
+    0xffffffff while live). Returns (channels, sample_rate, data_bytes);
+    data_bytes is -1 for a live stream.
+    """
+    riff = _read_exact(f, 12)
+    if riff[:4] != b"RIFF" or riff[8:] != b"WAVE":
+        raise ValueError("not a RIFF/WAVE stream")
+    fmt = None
+    while True:
+        tag, size = struct.unpack("<4sI", _read_exact(f, 8))
+        if tag == b"data":
+            break
+        body = _read_exact(f, size + (size & 1))
+        if tag == b"fmt ":
+            fmt = struct.unpack("<HHIIHH", body[:16])
+    if fmt is None:
+        raise ValueError("no fmt chunk before the data")
+    format_tag, channels, rate, _, _, bits = fmt
+    if format_tag not in (1, 0xFFFE) or bits != 16 or channels == 0:
+        raise ValueError("only 16-bit PCM is supported")
+    return channels, rate, -1 if size == _WAV_DATA_UNBOUNDED else size
+
+
+def iter_wav_blocks(f: BinaryIO, channels: int, data_bytes: int = -1,
+                    frames: int = 4096) -> Iterator[memoryview]:
+    """
+    Yields the interleaved samples after read_wav_stream_header() in blocks
+    of at most `frames` frames, as memoryview('h') over one reused buffer:
+    a block is only valid until the next one is read. A negative
+    `data_bytes` reads to the end of the stream.
+    """
+    frame_bytes = 2 * channels
+    buf = bytearray(frames * frame_bytes)
+    view = memoryview(buf)
+    # One read per block, whatever has arrived, so a live stream is not held
+    # back until the buffer fills.
+    read = getattr(f, "readinto1", f.readinto)
+    pending = 0
+    left = data_bytes
+    while left != 0:
+        want = len(buf) - pending
+        if left > 0:
+            want = min(want, left)
+        n = read(view[pending:pending + want])
+        if not n:
+            break
+        pending += n
+        if left > 0:
+            left -= n
+        usable = pending - pending % frame_bytes
+        if usable == 0:
+            continue
+        if sys.byteorder == "big":
+            buf[0:usable:2], buf[1:usable:2] = buf[1:usable:2], buf[0:usable:2]
+        block = view[:usable].cast("h")
+        yield block
+        block.release()
+        rest = pending - usable
+        view[:rest] = view[usable:pending]
+        pending = rest
@@ -1,12 +1,157 @@
 """
-Placeholder benchmarking harness for comparing C implementations.
-TODO: wire up timing/accuracy benchmarks for peak detector variants.
+Timing and accuracy benchmark of the peak detector variants in libpeak.
+
+The corpus is a directory of 16-bit PCM WAVs; each `<name>.wav` may have a
+`<name>.json` sidecar with the labeled impulses:
+
+    {"impulses": [12345, 67890]}   # sample indices of the impulse peaks
+
+Files without a sidecar only count towards throughput. For every variant the
+report gives samples/s over the detection time alone, per-tap latency
+percentiles and precision/recall against the labels.
+
+    python benchmark.py corpus/ --variants heaps firmware --tolerance-ms 5
 """
 
+from __future__ import annotations
+
+import argparse
+import json
+import sys
+from pathlib import Path
+from typing import Dict, List, Optional, Sequence
+
+import peaklib
+from audio_io import read_wav_i16
+
+
+def load_labels(wav_path: Path) -> Optional[List[int]]:
+    sidecar = wav_path.with_suffix(".json")
+    if not sidecar.exists():
+        return None
+    with open(sidecar, encoding="utf-8") as f:
+        return sorted(int(i) for i in json.load(f).get("impulses", []))
+
+
+def match(detected: Sequence[int], labels: Sequence[int], tolerance: int):
+    """Greedy one-to-one matching; returns (true positives, fp, fn)."""
+    used = [False] * len(labels)
+    tp = 0
+    for pos in sorted(detected):
+        best = None
+        for i, label in enumerate(labels):
+            if used[i] or abs(label - pos) > tolerance:
+                continue
+            if best is None or abs(label - pos) < abs(labels[best] - pos):
+                best = i
+        if best is not None:
+            used[best] = True
+            tp += 1
+    return tp, len(detected) - tp, len(labels) - tp
+
+
+def percentile(sorted_values: Sequence[int], q: float) -> float:
+    if not sorted_values:
+        return 0.0
+    idx = min(len(sorted_values) - 1, int(round(q / 100.0 * (len(sorted_values) - 1))))
+    return float(sorted_values[idx])
+
+
+def bench_variant(name: str, cfg: peaklib.BenchCfg, corpus, tolerance_ms: float,
+                  repeat: int) -> Dict[str, float]:
+    variant = peaklib.VARIANTS[name]
+    block_ns: List[int] = []
+    samples_total = 0
+    tp = fp = fn = 0
+    for path, samples, rate, labels in corpus:
+        for r in range(repeat):
+            positions, times = peaklib.run(variant, samples, cfg, timed=True)
+            block_ns.extend(times or [])
+            samples_total += len(samples) - len(samples) % cfg.tap_size
+        if labels is not None:
+            t, p, n = match(positions, labels, int(tolerance_ms * rate / 1000))
+            tp, fp, fn = tp + t, fp + p, fn + n
+
+    block_ns.sort()
+    total_s = sum(block_ns) / 1e9
+    return {
+        "samples_per_s": samples_total / total_s if total_s else 0.0,
+        "p50_us": percentile(block_ns, 50) / 1000,
+        "p90_us": percentile(block_ns, 90) / 1000,
+        "p99_us": percentile(block_ns, 99) / 1000,
+        "max_us": (block_ns[-1] if block_ns else 0) / 1000,
+        "precision": tp / (tp + fp) if tp + fp else float("nan"),
+        "recall": tp / (tp + fn) if tp + fn else float("nan"),
+        "tp": tp,
+        "fp": fp,
+        "fn": fn,
+    }
+
+
+def variant_cfg(name: str, args) -> peaklib.BenchCfg:
+    cfg = peaklib.BenchCfg(args.taps, args.tap_size, args.det_level,
+                           args.det_rms, args.det_energy)
+    if name == "heaps":
+        # peak_detector takes its thresholds as int16.
+        cfg.det_level = args.heap_level
+        cfg.det_rms = args.heap_rms
+        cfg.det_energy = args.heap_energy
+    return cfg
+
+
+def main(argv: Optional[Sequence[str]] = None) -> int:
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("corpus", type=Path, help="directory of WAVs (+ JSON labels)")
+    parser.add_argument("--variants", nargs="+", choices=list(peaklib.VARIANTS),
+                        default=list(peaklib.VARIANTS))
+    parser.add_argument("--channel", type=int, default=0)
+    parser.add_argument("--taps", type=int, default=peaklib.TAP_COUNT)
+    parser.add_argument("--tap-size", type=int, default=peaklib.TAP_SIZE)
+    parser.add_argument("--det-level", type=int, default=peaklib.DET_LEVEL)
+    parser.add_argument("--det-rms", type=float, default=peaklib.DET_RMS)
+    parser.add_argument("--det-energy", type=float, default=peaklib.DET_ENERGY)
+    parser.add_argument("--heap-level", type=int, default=500,
+                        help="deviation threshold of the heaps variant")
+    parser.add_argument("--heap-rms", type=float, default=0)
+    parser.add_argument("--heap-energy", type=float, default=0)
+    parser.add_argument("--tolerance-ms", type=float, default=5.0,
+                        help="max distance of a detection from its label")
+    parser.add_argument("--repeat", type=int, default=1,
+                        help="passes over the corpus for the timing")
+    parser.add_argument("--json", action="store_true", help="print the report as JSON")
+    args = parser.parse_args(argv)
+
+    wavs = sorted(args.corpus.glob("*.wav")) if args.corpus.is_dir() else [args.corpus]
+    if not wavs:
+        print(f"no WAVs in {args.corpus}", file=sys.stderr)
+        return 1
+    corpus = []
+    for path in wavs:
+        samples, rate = read_wav_i16(path, args.channel)
+        corpus.append((path, samples, rate, load_labels(path)))
+
+    report = {}
+    for name in args.variants:
+        report[name] = bench_variant(name, variant_cfg(name, args), corpus,
+                                     args.tolerance_ms, max(1, args.repeat))
+
+    if args.json:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+        return 0
 
-def main():
-    raise NotImplementedError("Benchmark harness not implemented yet.")
+    seconds = sum(len(s) / r for _, s, r, _ in corpus)
+    print(f"{len(corpus)} files, {seconds:.1f} s of audio, geometry "
+          f"{args.taps}x{args.tap_size} (specialised: "
+          f"{'yes' if peaklib.is_specialised(args.taps, args.tap_size) else 'no'})")
+    print(f"{'variant':<16}{'Msamples/s':>11}{'p50 us':>9}{'p90 us':>9}"
+          f"{'p99 us':>9}{'max us':>9}{'precision':>11}{'recall':>8}")
+    for name, r in report.items():
+        print(f"{name:<16}{r['samples_per_s'] / 1e6:>11.2f}{r['p50_us']:>9.2f}"
+              f"{r['p90_us']:>9.2f}{r['p99_us']:>9.2f}{r['max_us']:>9.2f}"
+              f"{r['precision']:>11.3f}{r['recall']:>8.3f}")
+    return 0
 
 
 if __name__ == "__main__":
-    main()
+    sys.exit(main())
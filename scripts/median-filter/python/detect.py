@@ -1,13 +1,104 @@
 """
-Placeholder orchestrator for peak detection pipeline.
-TODO: load audio, call C library via ctypes/cffi, emit detections.
+Runs a peak detector variant from libpeak over a WAV and prints the detected
+impulses, one "<sample index> <seconds>" line each.
+
+    python detect.py recording.wav --variant firmware
+    curl -s http://node/stream.wav | python detect.py - --stream
+    curl -s http://node/stream.wav | python detect.py - --live
+
+With --stream the heaps detector reads the WAV itself, in constant memory,
+and prints hits as they are found; "-" reads stdin. --live does the same on
+every channel with the reading done in Python, block by block through
+peaklib.StreamDetector, as code analysing a stream in Python would; it
+prints "<sample index> <seconds> <channel>" lines.
 """
 
+from __future__ import annotations
+
+import argparse
+import json
+import sys
+from typing import BinaryIO, List, Optional, Sequence
+
+import peaklib
+from audio_io import iter_wav_blocks, read_wav_i16, read_wav_stream_header
+
+
+def heap_cfg(args: argparse.Namespace) -> peaklib.HeapCfg:
+    return peaklib.HeapCfg(args.taps, args.tap_size,
+                           peaklib.HeapLevels(args.heap_level, args.heap_rms,
+                                              args.heap_energy),
+                           args.refractory)
+
+
+def detect_live(f: BinaryIO, cfg: peaklib.HeapCfg) -> int:
+    channels, rate, data_bytes = read_wav_stream_header(f)
+    detector = peaklib.StreamDetector([cfg] * channels)
+
+    def report(hits: List[peaklib.Hit]) -> None:
+        for hit in hits:
+            print(f"{hit.position} {hit.position / rate:.4f} {hit.channel}",
+                  flush=True)
+
+    for block in iter_wav_blocks(f, channels, data_bytes):
+        report(detector.feed(block))
+    report(detector.finish())
+    return 0
+
+
+def main(argv: Optional[Sequence[str]] = None) -> int:
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("wav", help='WAV file, or "-" for stdin with --stream')
+    parser.add_argument("--variant", choices=list(peaklib.VARIANTS), default="firmware")
+    parser.add_argument("--channel", type=int, default=0)
+    parser.add_argument("--taps", type=int, default=peaklib.TAP_COUNT)
+    parser.add_argument("--tap-size", type=int, default=peaklib.TAP_SIZE)
+    parser.add_argument("--det-level", type=int, default=peaklib.DET_LEVEL)
+    parser.add_argument("--det-rms", type=float, default=peaklib.DET_RMS)
+    parser.add_argument("--det-energy", type=float, default=peaklib.DET_ENERGY)
+    parser.add_argument("--labels", action="store_true",
+                        help="print a benchmark.py label sidecar instead")
+    parser.add_argument("--stream", action="store_true",
+                        help="heaps detector reading the WAV in C (constant memory)")
+    parser.add_argument("--live", action="store_true",
+                        help="heaps detector on all channels, fed from Python "
+                             "block by block")
+    parser.add_argument("--heap-level", type=int, default=500,
+                        help="deviation threshold of the heaps detector")
+    parser.add_argument("--heap-rms", type=int, default=0)
+    parser.add_argument("--heap-energy", type=int, default=0)
+    parser.add_argument("--refractory", type=int, default=0,
+                        help="heaps detector: merge hits closer than this "
+                             "many samples into the strongest one")
+    args = parser.parse_args(argv)
+
+    if args.live:
+        cfg = heap_cfg(args)
+        if args.wav == "-":
+            return detect_live(sys.stdin.buffer, cfg)
+        with open(args.wav, "rb") as f:
+            return detect_live(f, cfg)
+
+    if args.stream or args.wav == "-":
+        cfg = heap_cfg(args)
+        # The rate is only known once the header is parsed; print indices.
+        peaklib.detect_wav(args.wav, cfg, args.channel,
+                           on_hit=lambda pos: print(pos, flush=True))
+        return 0
+
+    samples, rate = read_wav_i16(args.wav, args.channel)
+    cfg = peaklib.BenchCfg(args.taps, args.tap_size, args.det_level,
+                           args.det_rms, args.det_energy)
+    positions, _ = peaklib.run(peaklib.VARIANTS[args.variant], samples, cfg)
 
-def main():
-    # TODO: wire up audio loading and peak detection.
-    raise NotImplementedError("Pipeline not implemented yet.")
+    if args.labels:
+        json.dump({"impulses": positions}, sys.stdout)
+        print()
+        return 0
+    for pos in positions:
+        print(f"{pos} {pos / rate:.4f}")
+    return 0
 
 
 if __name__ == "__main__":
-    main()
+    sys.exit(main())
@@ -27,12 +27,13 @@ try:
 except ImportError:  # pragma: no cover
     AudioSegment = None
 
+from audio_io import read_wav_i16  # local module
 from prompt_store import load_prompt, ensure_files  # local module
 
 
-def load_audio(path: str):
-    """Stub for audio loading."""
-    raise NotImplementedError("Audio loader not implemented yet.")
+def load_audio(path: str, channel: int = 0):
+    """Load one channel of a 16-bit PCM WAV; see audio_io.read_wav_i16."""
+    return read_wav_i16(path, channel)
 
 
 def get_search_prompt() -> str:
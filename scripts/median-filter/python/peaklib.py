@@ -0,0 +1,449 @@
+"""
+ctypes bindings for libpeak (scripts/median-filter/build/libpeak.so).
+
+Build the library first: `cmake -S . -B _build && cmake --build _build` from
+scripts/median-filter. The path can be overridden with PEAK_LIB.
+"""
+
+from __future__ import annotations
+
+import array
+import ctypes
+import os
+import sys
+from pathlib import Path
+from typing import Any, Callable, List, NamedTuple, Optional, Sequence, Tuple
+
+# enum peak_bench_variant
+HEAPS = 0
+SORTED_GENERIC = 1
+FIRMWARE = 2
+
+VARIANTS = {
+    "heaps": HEAPS,
+    "sorted-generic": SORTED_GENERIC,
+    "firmware": FIRMWARE,
+}
+
+# enum peak_channel_layout
+INTERLEAVED = 0
+PLANAR = 1
+
+# Defaults of median_detection.h.
+TAP_COUNT = 31
+TAP_SIZE = 30
+DET_LEVEL = 10000
+DET_RMS = 100.0
+DET_ENERGY = 0.4
+
+
+class BenchCfg(ctypes.Structure):
+    """Mirror of struct peak_bench_cfg (peak_bench.h)."""
+
+    _fields_ = [
+        ("num_taps", ctypes.c_uint16),
+        ("tap_size", ctypes.c_uint16),
+        ("det_level", ctypes.c_uint32),
+        ("det_rms", ctypes.c_float),
+        ("det_energy", ctypes.c_float),
+    ]
+
+
+class HeapLevels(ctypes.Structure):
+    """Mirror of struct median_detector_levels (peak_detector.h)."""
+
+    _fields_ = [
+        ("det_level", ctypes.c_int16),
+        ("det_rms", ctypes.c_int16),
+        ("det_energy", ctypes.c_int16),
+    ]
+
+
+class HeapCfg(ctypes.Structure):
+    """Mirror of struct median_detector_cfg (peak_detector.h)."""
+
+    _fields_ = [
+        ("num_taps", ctypes.c_uint8),
+        ("tap_size", ctypes.c_uint16),
+        ("levels", HeapLevels),
+        ("refractory", ctypes.c_uint32),
+    ]
+
+
+class WavInfo(ctypes.Structure):
+    """Mirror of struct peak_wav_info (peak_wav.h)."""
+
+    _fields_ = [
+        ("sample_rate", ctypes.c_uint32),
+        ("channels", ctypes.c_uint16),
+        ("frames", ctypes.c_uint64),
+    ]
+
+
+class StreamHit(ctypes.Structure):
+    """Mirror of struct peak_stream_hit (peak_stream.h)."""
+
+    _fields_ = [
+        ("position", ctypes.c_int64),
+        ("channel", ctypes.c_uint16),
+        ("level", ctypes.c_int16),
+        ("merged", ctypes.c_uint32),
+    ]
+
+
+HIT_FN = ctypes.CFUNCTYPE(None, ctypes.c_int64, ctypes.c_void_p)
+
+# PEAK_STREAM_ABI_VERSION the bindings below are written against.
+STREAM_ABI_VERSION = 1
+
+
+def _library_path() -> Path:
+    env = os.environ.get("PEAK_LIB")
+    if env:
+        return Path(env)
+    return Path(__file__).resolve().parent.parent / "build" / "libpeak.so"
+
+
+_lib: Optional[ctypes.CDLL] = None
+
+
+def library() -> ctypes.CDLL:
+    global _lib
+    if _lib is not None:
+        return _lib
+    path = _library_path()
+    if not path.exists():
+        raise RuntimeError(
+            f"{path} not found; build scripts/median-filter with CMake first"
+        )
+    lib = ctypes.CDLL(str(path))
+    lib.peak_bench_run_i16.argtypes = [
+        ctypes.c_int,
+        ctypes.POINTER(ctypes.c_int16),
+        ctypes.c_size_t,
+        ctypes.POINTER(BenchCfg),
+        ctypes.POINTER(ctypes.c_int64),
+        ctypes.c_size_t,
+        ctypes.POINTER(ctypes.c_uint32),
+        ctypes.c_size_t,
+    ]
+    lib.peak_bench_run_i16.restype = ctypes.c_int
+    lib.detect_recording_parallel_i16.argtypes = [
+        ctypes.POINTER(ctypes.c_int16),
+        ctypes.c_size_t,
+        ctypes.POINTER(HeapCfg),
+        ctypes.c_uint,
+        ctypes.POINTER(ctypes.c_int),
+        ctypes.c_size_t,
+    ]
+    lib.detect_recording_parallel_i16.restype = ctypes.c_int
+    lib.detect_recording_multi_i16.argtypes = [
+        ctypes.POINTER(ctypes.c_int16),
+        ctypes.c_size_t,
+        ctypes.c_size_t,
+        ctypes.c_int,
+        ctypes.POINTER(HeapCfg),
+        ctypes.POINTER(ctypes.c_int),
+        ctypes.c_size_t,
+        ctypes.POINTER(ctypes.c_int),
+    ]
+    lib.detect_recording_multi_i16.restype = ctypes.c_int
+    lib.detect_wav_path.argtypes = [
+        ctypes.c_char_p,
+        ctypes.c_uint,
+        ctypes.POINTER(HeapCfg),
+        ctypes.POINTER(ctypes.c_int64),
+        ctypes.c_size_t,
+        HIT_FN,
+        ctypes.c_void_p,
+        ctypes.POINTER(WavInfo),
+    ]
+    lib.detect_wav_path.restype = ctypes.c_int
+    lib.peak_stream_abi_version.argtypes = []
+    lib.peak_stream_abi_version.restype = ctypes.c_uint32
+    lib.peak_stream_size.argtypes = [
+        ctypes.POINTER(HeapCfg),
+        ctypes.c_size_t,
+        ctypes.POINTER(ctypes.c_size_t),
+    ]
+    lib.peak_stream_size.restype = ctypes.c_int
+    lib.peak_stream_init.argtypes = [
+        ctypes.c_void_p,
+        ctypes.c_size_t,
+        ctypes.POINTER(HeapCfg),
+        ctypes.c_size_t,
+        ctypes.POINTER(ctypes.c_void_p),
+    ]
+    lib.peak_stream_init.restype = ctypes.c_int
+    lib.peak_stream_feed_i16.argtypes = [
+        ctypes.c_void_p,
+        ctypes.c_void_p,
+        ctypes.c_size_t,
+        ctypes.POINTER(StreamHit),
+        ctypes.c_size_t,
+        ctypes.POINTER(ctypes.c_size_t),
+    ]
+    lib.peak_stream_feed_i16.restype = ctypes.c_int
+    lib.peak_stream_finish.argtypes = [
+        ctypes.c_void_p,
+        ctypes.POINTER(StreamHit),
+        ctypes.c_size_t,
+    ]
+    lib.peak_stream_finish.restype = ctypes.c_int
+    lib.peak_stream_reset.argtypes = [ctypes.c_void_p]
+    lib.peak_stream_reset.restype = None
+    lib.peak_stream_frames.argtypes = [ctypes.c_void_p]
+    lib.peak_stream_frames.restype = ctypes.c_int64
+    lib.impulse_geometry_is_specialised.argtypes = [ctypes.c_uint16, ctypes.c_uint16]
+    lib.impulse_geometry_is_specialised.restype = ctypes.c_bool
+    _lib = lib
+    return lib
+
+
+def is_specialised(num_taps: int, tap_size: int) -> bool:
+    """True if the firmware variant has a fast path for this geometry."""
+    return bool(library().impulse_geometry_is_specialised(num_taps, tap_size))
+
+
+def run(
+    variant: int,
+    samples: array.array,
+    cfg: BenchCfg,
+    timed: bool = False,
+    capacity: int = 4096,
+) -> Tuple[List[int], Optional[List[int]]]:
+    """
+    Runs one detector variant over `samples` (array('h')).
+
+    Returns the detected sample indices and, with `timed`, the processing time
+    of every tap in nanoseconds. Timing happens in C so the ctypes call
+    overhead does not end up in the per-tap numbers.
+    """
+    if samples.typecode != "h":
+        raise TypeError("samples must be array('h')")
+    lib = library()
+    n = len(samples)
+    src = (ctypes.c_int16 * n).from_buffer(samples) if n else None
+    blocks = n // cfg.tap_size if cfg.tap_size else 0
+    block_ns = (ctypes.c_uint32 * blocks)() if timed and blocks else None
+
+    while True:
+        positions = (ctypes.c_int64 * capacity)()
+        hits = lib.peak_bench_run_i16(
+            variant, src, n, ctypes.byref(cfg), positions, capacity,
+            block_ns, blocks if block_ns is not None else 0,
+        )
+        if hits < 0:
+            raise RuntimeError(f"peak_bench_run_i16 failed with {hits}")
+        if hits <= capacity:
+            break
+        capacity = hits  # the count is exact even when the array was short
+
+    return list(positions[:hits]), (list(block_ns) if block_ns is not None else None)
+
+
+def detect_parallel(samples: array.array, cfg: HeapCfg, threads: int = 0,
+                    capacity: int = 4096) -> List[int]:
+    """
+    Heaps detector over `samples` (array('h')) on `threads` worker threads
+    (0 = all CPUs); same hits as a serial run.
+    """
+    if samples.typecode != "h":
+        raise TypeError("samples must be array('h')")
+    lib = library()
+    n = len(samples)
+    src = (ctypes.c_int16 * n).from_buffer(samples) if n else None
+    while True:
+        positions = (ctypes.c_int * capacity)()
+        hits = lib.detect_recording_parallel_i16(
+            src, n, ctypes.byref(cfg), threads, positions, capacity
+        )
+        if hits < 0:
+            raise RuntimeError(f"detect_recording_parallel_i16 failed with {hits}")
+        if hits <= capacity:
+            return list(positions[:hits])
+        capacity = hits
+
+
+def detect_multi(samples: array.array, cfgs: Sequence[HeapCfg],
+                 layout: int = INTERLEAVED, capacity: int = 4096) -> List[List[int]]:
+    """
+    Heaps detector over every channel of `samples` (array('h'), interleaved or
+    planar) in one call; `cfgs` holds one config per channel. Returns the hit
+    list of each channel.
+    """
+    if samples.typecode != "h":
+        raise TypeError("samples must be array('h')")
+    channels = len(cfgs)
+    if channels == 0 or len(samples) % channels:
+        raise ValueError("samples must hold a whole number of frames")
+    lib = library()
+    frames = len(samples) // channels
+    src = (ctypes.c_int16 * len(samples)).from_buffer(samples) if frames else None
+    cfg_array = (HeapCfg * channels)(*cfgs)
+    counts = (ctypes.c_int * channels)()
+    while True:
+        positions = (ctypes.c_int * (capacity * channels))()
+        hits = lib.detect_recording_multi_i16(
+            src, frames, channels, layout, cfg_array, positions, capacity, counts
+        )
+        if hits < 0:
+            raise RuntimeError(f"detect_recording_multi_i16 failed with {hits}")
+        if max(counts) <= capacity:
+            break
+        capacity = max(counts)
+    return [list(positions[ch * capacity:ch * capacity + counts[ch]])
+            for ch in range(channels)]
+
+
+def detect_wav(path: str, cfg: HeapCfg, channel: int = 0,
+               on_hit: Optional[Callable[[int], None]] = None,
+               capacity: int = 4096) -> Tuple[List[int], WavInfo]:
+    """
+    Heaps detector reading a 16-bit PCM WAV in C, so memory does not grow with
+    the recording: files are memory-mapped, "-" (stdin) and pipes are read in
+    blocks. `on_hit` is called for every hit as it is found. Returns the
+    first `capacity` hits and the stream info.
+    """
+    lib = library()
+    positions = (ctypes.c_int64 * capacity)()
+    info = WavInfo()
+    callback = HIT_FN(lambda pos, _ctx: on_hit(pos)) if on_hit else HIT_FN()
+    hits = lib.detect_wav_path(
+        os.fsencode(path), channel, ctypes.byref(cfg), positions, capacity,
+        callback, None, ctypes.byref(info),
+    )
+    if hits < 0:
+        raise RuntimeError(f"detect_wav_path failed with {hits}")
+    return list(positions[:min(hits, capacity)]), info
+
+
+class Hit(NamedTuple):
+    position: int  # frame index from the start of the stream
+    channel: int
+    level: int     # strongest peak of the group over the noise median
+    merged: int    # detections merged by the refractory window
+
+
+_NATIVE_I16 = "<i2" if sys.byteorder == "little" else ">i2"
+
+
+def _i16_address(samples: Any) -> Tuple[int, int, Any]:
+    """
+    Address and sample count of the int16 samples in `samples`, without
+    copying: a C-contiguous numpy int16 array, array('h'), or any writable
+    buffer of whole 16-bit samples (bytearray, memoryview). The third value
+    keeps the buffer exported for the duration of the call.
+    """
+    iface = getattr(samples, "__array_interface__", None)
+    if iface is not None:
+        if iface["typestr"] != _NATIVE_I16 or iface.get("strides") is not None:
+            raise TypeError("numpy samples must be C-contiguous native int16")
+        count = 1
+        for dim in iface["shape"]:
+            count *= dim
+        return iface["data"][0], count, samples
+    view = memoryview(samples).cast("B")
+    if view.nbytes % 2:
+        raise ValueError("samples must hold whole 16-bit samples")
+    if view.nbytes == 0:
+        return 0, 0, view
+    if view.readonly:
+        raise TypeError("samples must be writable (bytearray, not bytes) "
+                        "to be passed without a copy")
+    raw = (ctypes.c_char * view.nbytes).from_buffer(view)
+    return ctypes.addressof(raw), view.nbytes // 2, raw
+
+
+class StreamDetector:
+    """
+    Heaps detector over a live stream of interleaved frames in blocks of any
+    length, e.g. a node's stream.wav read in whatever pieces the socket
+    returns. It wraps peak_stream.h: tap splitting, the per-channel detectors
+    and the refractory window all run in C, one call per block, and the
+    samples are read in place.
+
+        det = StreamDetector([cfg, cfg])          # stereo
+        for block in blocks:                      # numpy int16, bytearray...
+            for hit in det.feed(block):
+                print(hit.position, hit.channel)
+        det.finish()
+
+    Hits come out as soon as their group can no longer grow, and match what
+    detect_multi() finds over the whole recording.
+    """
+
+    def __init__(self, cfgs: Sequence[HeapCfg], hit_capacity: int = 64):
+        lib = library()
+        version = lib.peak_stream_abi_version()
+        if version != STREAM_ABI_VERSION:
+            raise RuntimeError(
+                f"libpeak stream ABI {version}, bindings expect "
+                f"{STREAM_ABI_VERSION}; rebuild or update peaklib.py"
+            )
+        self._lib = lib
+        self.channels = len(cfgs)
+        self._cfgs = (HeapCfg * self.channels)(*cfgs)
+        size = ctypes.c_size_t()
+        st = lib.peak_stream_size(self._cfgs, self.channels, ctypes.byref(size))
+        if st != 0:
+            raise ValueError(f"peak_stream_size failed with {st}")
+        # The state wants max_align_t alignment, which ctypes does not promise.
+        align = 64
+        self._mem = ctypes.create_string_buffer(size.value + align)
+        base = ctypes.addressof(self._mem)
+        self._state = ctypes.c_void_p()
+        st = lib.peak_stream_init(base + (-base) % align, size.value, self._cfgs,
+                                  self.channels, ctypes.byref(self._state))
+        if st != 0:
+            raise ValueError(f"peak_stream_init failed with {st}")
+        capacity = max(hit_capacity, 2 * self.channels)
+        self._hits = (StreamHit * capacity)()
+        self._capacity = capacity
+        self._consumed = ctypes.c_size_t()
+
+    def _collect(self, count: int) -> List[Hit]:
+        return [Hit(h.position, h.channel, h.level, h.merged)
+                for h in self._hits[:count]]
+
+    def feed(self, samples: Any) -> List[Hit]:
+        """
+        Detects over a block of interleaved int16 frames; an incomplete tap
+        at its end is kept for the next block. Returns the hits closed by it.
+        """
+        address, count, _exported = _i16_address(samples)
+        if count % self.channels:
+            raise ValueError("samples must hold a whole number of frames")
+        frames = count // self.channels
+        frame_bytes = 2 * self.channels
+        hits: List[Hit] = []
+        done = 0
+        while done < frames:
+            got = self._lib.peak_stream_feed_i16(
+                self._state, address + done * frame_bytes, frames - done,
+                self._hits, self._capacity, ctypes.byref(self._consumed),
+            )
+            if got < 0:
+                raise RuntimeError(f"peak_stream_feed_i16 failed with {got}")
+            hits.extend(self._collect(got))
+            done += self._consumed.value
+        return hits
+
+    def finish(self) -> List[Hit]:
+        """
+        Ends the stream: returns the groups still open. The detector then
+        starts over at position 0.
+        """
+        got = self._lib.peak_stream_finish(self._state, self._hits, self._capacity)
+        if got < 0:
+            raise RuntimeError(f"peak_stream_finish failed with {got}")
+        return self._collect(got)
+
+    def reset(self) -> None:
+        """Starts a new stream, dropping what the detector holds."""
+        self._lib.peak_stream_reset(self._state)
+
+    @property
+    def frames(self) -> int:
+        """Frames fed since the start of the stream."""
+        return int(self._lib.peak_stream_frames(self._state))